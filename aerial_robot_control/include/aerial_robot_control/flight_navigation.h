@@ -2,9 +2,12 @@
 
 #include <aerial_robot_estimation/sensor/base_plugin.h>
 #include <aerial_robot_estimation/sensor/gps.h>
+#include <aerial_robot_control/flight_state_machine.h>
+#include <aerial_robot_control/trajectory/polynomial_trajectory.h>
 #include <aerial_robot_estimation/state_estimation.h>
 #include <aerial_robot_msgs/FlightNav.h>
 #include <angles/angles.h>
+#include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/Vector3Stamped.h>
 #include <ros/ros.h>
 #include <sensor_msgs/Joy.h>
@@ -16,32 +19,6 @@
 
 namespace aerial_robot_navigation
 {
-  /* control mode */
-  enum control_mode
-    {
-      POS_CONTROL_MODE,
-      VEL_CONTROL_MODE,
-      ACC_CONTROL_MODE
-    };
-  /* control frame */
-  enum control_frame
-    {
-      WORLD_FRAME, /* global frame, e.g. NEU, mocap */
-      LOCAL_FRAME /* head frame which is identical with imu head direction */
-    };
-
-  // navi state
-  enum flight_state
-    {
-      ARM_OFF_STATE,
-      START_STATE,
-      ARM_ON_STATE,
-      TAKEOFF_STATE,
-      LAND_STATE,
-      HOVER_STATE,
-      STOP_STATE
-    };
-
   class BaseNavigator
   {
   public:
@@ -55,6 +32,7 @@ namespace aerial_robot_navigation
     virtual void update();
 
     ros::Publisher& getFlightConfigPublisher() { return flight_config_pub_; }
+    FlightStateMachine& getStateMachine() { return state_machine_; }
 
     inline uint8_t getNaviState(){  return navi_state_;}
     inline void setNaviState(const uint8_t  state){ navi_state_ = state;}
@@ -215,6 +193,7 @@ namespace aerial_robot_navigation
     ros::Subscriber joy_stick_sub_;
     ros::Subscriber flight_nav_sub_;
     ros::Subscriber stop_teleop_sub_;
+    ros::Subscriber waypoints_sub_;
 
     boost::shared_ptr<aerial_robot_model::RobotModel> robot_model_;
     boost::shared_ptr<aerial_robot_estimation::StateEstimator> estimator_;
@@ -234,6 +213,9 @@ namespace aerial_robot_navigation
     bool lock_teleop_;
     ros::Time force_landing_start_time_;
 
+    /* transitions of navi_state_ in update() */
+    FlightStateMachine state_machine_;
+
     double convergent_start_time_;
     double convergent_duration_;
     double z_convergent_thresh_;
@@ -251,6 +233,11 @@ namespace aerial_robot_navigation
     double vel_nav_threshold_; // the range (board) to siwtch between vel_nav and pos_nav
     double vel_nav_gain_;
 
+    /* polynomial trajectory for waypoint: min-jerk for the single waypoint from uav/nav, min-snap for uav/nav/waypoints */
+    bool trajectory_generation_; // instead of the step target and the auto vel nav
+    PolynomialTrajectory trajectory_;
+    double trajectory_start_time_;
+
     /* gps waypint */
     bool gps_waypoint_;
     geographic_msgs::GeoPoint target_wp_;
@@ -298,6 +285,16 @@ namespace aerial_robot_navigation
     void naviCallback(const aerial_robot_msgs::FlightNavConstPtr & msg);
     void joyStickControl(const sensor_msgs::JoyConstPtr & joy_msg);
     void batteryCheckCallback(const std_msgs::Float32ConstPtr &msg);
+    void waypointsCallback(const geometry_msgs::PoseArrayConstPtr & msg);
+    bool startTrajectory(const std::vector<Eigen::Vector3d>& waypoints);
+    void trajectoryUpdate();
+    void hoverNavigation();
+    void sendFlightConfigCmd(uint8_t cmd)
+    {
+      spinal::FlightConfigCmd flight_config_cmd;
+      flight_config_cmd.cmd = cmd;
+      flight_config_pub_.publish(flight_config_cmd);
+    }
 
     virtual void halt() {}
     virtual void reset()
@@ -476,8 +473,20 @@ namespace aerial_robot_navigation
         }
     }
 
+    void stopTrajectory()
+    {
+      if(trajectory_.empty()) return;
+
+      /* keep the last target position */
+      trajectory_.clear();
+      target_vel_.setValue(0, 0, 0);
+      target_acc_.setValue(0, 0, 0);
+    }
+
     void setTargetXyFromCurrentState()
     {
+      stopTrajectory();
+
       tf::Vector3 pos_cog = estimator_->getPos(Frame::COG, estimate_mode_);
       target_pos_.setX(pos_cog.x());
       target_pos_.setY(pos_cog.y());
@@ -0,0 +1,186 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace aerial_robot_navigation
+{
+  /* control mode */
+  enum control_mode
+    {
+      POS_CONTROL_MODE,
+      VEL_CONTROL_MODE,
+      ACC_CONTROL_MODE
+    };
+  /* control frame */
+  enum control_frame
+    {
+      WORLD_FRAME, /* global frame, e.g. NEU, mocap */
+      LOCAL_FRAME /* head frame which is identical with imu head direction */
+    };
+
+  // navi state
+  enum flight_state
+    {
+      ARM_OFF_STATE,
+      START_STATE,
+      ARM_ON_STATE,
+      TAKEOFF_STATE,
+      LAND_STATE,
+      HOVER_STATE,
+      STOP_STATE
+    };
+
+  /* requests from the state machine, executed by the navigator */
+  enum flight_action
+    {
+      ARM_ON_ACTION = 1 << 0, // send ARM_ON_CMD
+      ARM_OFF_ACTION = 1 << 1, // reset the estimator flags and send ARM_OFF_CMD
+      FORCE_LANDING_ACTION = 1 << 2, // send FORCE_LANDING_CMD
+      HALT_ACTION = 1 << 3, // halt() after the force landing
+      SENSOR_FUSION_ACTION = 1 << 4, // start the sensor fusion of the estimator
+      FLYING_ACTION = 1 << 5, // set the flying flag of the estimator
+      LANDING_MODE_ACTION = 1 << 6, // set the landing mode of the estimator
+      LAND_TARGET_ACTION = 1 << 7, // xy and yaw targets from the current state, z target to the landing height
+      HOLD_XY_TARGET_ACTION = 1 << 8, // xy and yaw targets from the current state
+      HOLD_Z_TARGET_ACTION = 1 << 9, // z target from the current state
+    };
+
+  enum flight_log_level
+    {
+      FLIGHT_LOG_NONE,
+      FLIGHT_LOG_INFO,
+      FLIGHT_LOG_WARN,
+      FLIGHT_LOG_ERROR
+    };
+
+  /* snapshot of the estimator, the battery and the joystick for one update */
+  struct FlightInput
+  {
+    bool xy_estimated = true; // x and y are fused in the current estimate mode
+    bool force_att_control = false;
+    bool sensor_unhealth = false; // Sensor::UNHEALTH_LEVEL3 of the estimator
+    bool low_voltage = false;
+    bool joy_heart_beat_check = false;
+    bool joy_heart_beat = false; // a joy message has been received
+    double joy_stick_prev_time = 0;
+    bool landed = false;
+    double delta_x = 0, delta_y = 0, delta_z = 0; // target - current position of CoG
+  };
+
+  struct FlightStateParams
+  {
+    double convergent_duration = 1.0;
+    double xy_convergent_thresh = 0.15;
+    double z_convergent_thresh = 0.05;
+    double joy_stick_heart_beat_du = 2.0;
+    bool force_landing_auto_stop = true;
+  };
+
+  /* the part of the navigator state written by the state machine (and by the callbacks of the navigator) */
+  struct FlightStatus
+  {
+    uint8_t state = ARM_OFF_STATE;
+    int xy_control_mode = POS_CONTROL_MODE;
+    int prev_xy_control_mode = ACC_CONTROL_MODE;
+    bool force_landing = false;
+    double convergent_start_time = 0;
+  };
+
+  struct FlightActions
+  {
+    uint32_t flags = 0;
+    std::vector<std::string> fired; // names of the fired transitions, in order
+
+    bool has(uint32_t action) const { return flags & action; }
+  };
+
+  struct FlightTransition
+  {
+    using Guard = std::function<bool(const FlightInput&, const FlightStatus&, double)>;
+    using Action = std::function<void(const FlightInput&, FlightStatus&, FlightActions&, double)>;
+
+    std::string name;
+    uint32_t from; // mask of the source states, see FlightStateMachine::stateMask()
+    Guard guard; // always true if empty
+    int to; // FlightStateMachine::KEEP_STATE to stay
+    Action action; // optional
+    int log_level;
+    std::string log;
+  };
+
+  /* table-driven flight state machine of BaseNavigator.
+     all transitions are evaluated in the table order, and each transition whose source state matches the state
+     at that point fires, so a transition can be followed by the transitions of the new state in the same update.
+     the time is given by the injected clock, the subclasses of the navigator can add their own states and transitions */
+  class FlightStateMachine
+  {
+  public:
+    static constexpr int KEEP_STATE = -1;
+    static constexpr uint32_t ANY_STATE = 0xffffffff;
+
+    using Clock = std::function<double()>;
+
+    explicit FlightStateMachine(Clock clock);
+    FlightStateMachine(const FlightStateMachine&) = delete; // the default transitions refer to params_
+    FlightStateMachine& operator=(const FlightStateMachine&) = delete;
+
+    FlightActions update(const FlightInput& input, FlightStatus& status) const;
+
+    void setClock(Clock clock) { clock_ = clock; }
+    FlightStateParams& params() { return params_; }
+    const FlightStateParams& params() const { return params_; }
+
+    const std::vector<FlightTransition>& getTransitions() const { return transitions_; }
+    void addTransition(const FlightTransition& transition) { transitions_.push_back(transition); }
+    bool insertTransition(const std::string& before, const FlightTransition& transition);
+    bool removeTransition(const std::string& name);
+
+    static uint32_t stateMask(std::initializer_list<uint8_t> states);
+
+  private:
+    Clock clock_;
+    FlightStateParams params_;
+    std::vector<FlightTransition> transitions_;
+
+    void defaultTransitions();
+  };
+};
@@ -0,0 +1,96 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <vector>
+
+namespace aerial_robot_navigation
+{
+  struct TrajectoryState
+  {
+    Eigen::Vector3d pos;
+    Eigen::Vector3d vel;
+    Eigen::Vector3d acc;
+  };
+
+  /* polynomial trajectory through the position waypoints, ending at rest:
+     - one waypoint: min-jerk (5th order polynomial) in closed form
+     - multiple waypoints: min-snap (7th order polynomial per segment), continuous up to the 6th derivative at the waypoints,
+       which is the optimal condition of the unconstrained problem and gives a banded linear system
+     the segment durations are scaled until the velocity and acceleration of each axis are within the limits */
+  class PolynomialTrajectory
+  {
+  public:
+    static constexpr int COEFF_NUM = 8; // 7th order
+    static constexpr double MIN_JERK_VEL_RATIO = 1.875; // peak velocity of the rest-to-rest min-jerk trajectory: 1.875 d / T
+    static constexpr double MIN_JERK_ACC_RATIO = 5.7735; // peak acceleration: 5.7735 d / T^2
+
+    PolynomialTrajectory();
+
+    void setLimits(const Eigen::Vector3d& max_vel, const Eigen::Vector3d& max_acc);
+    void setMinSegmentDuration(double duration) { min_segment_duration_ = duration; }
+
+    /* false if no waypoint is given or the solve fails, the limit violation is reported by withinLimits() */
+    bool generate(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints);
+    void clear();
+
+    /* t is clamped to [0, duration] */
+    TrajectoryState sample(double t) const;
+
+    bool empty() const { return durations_.empty(); }
+    bool withinLimits() const { return within_limits_; }
+    double getDuration() const;
+    const std::vector<double>& getSegmentDurations() const { return durations_; }
+
+  private:
+    Eigen::Vector3d max_vel_;
+    Eigen::Vector3d max_acc_;
+    double min_segment_duration_;
+    static constexpr int MAX_SCALE_ITERATION = 20;
+    static constexpr int CHECK_RESOLUTION = 50; // samples per segment for the limit check
+
+    std::vector<double> durations_;
+    Eigen::MatrixXd coeffs_; // 3 x (COEFF_NUM * segments), in the normalized time of each segment [0, 1]
+    bool within_limits_;
+
+    bool solve(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints);
+    void solveMinJerk(const TrajectoryState& start, const Eigen::Vector3d& end);
+    bool solveMinSnap(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints);
+    double limitRatio(const TrajectoryState& start) const;
+    void evaluate(int segment, double tau, TrajectoryState& state) const;
+  };
+};
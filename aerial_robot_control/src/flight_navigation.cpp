@@ -1,4 +1,5 @@
 #include "aerial_robot_control/flight_navigation.h"
+#include <algorithm>
 
 using namespace std;
 using namespace aerial_robot_navigation;
@@ -12,12 +13,16 @@ BaseNavigator::BaseNavigator():
   force_att_control_flag_(false),
   low_voltage_flag_(false),
   prev_xy_control_mode_(ACC_CONTROL_MODE),
+  state_machine_([]{ return ros::Time::now().toSec(); }),
+  convergent_start_time_(0),
   vel_control_flag_(false),
   pos_control_flag_(false),
   xy_control_flag_(false),
   z_control_flag_(false),
   yaw_control_flag_(false),
   vel_based_waypoint_(false),
+  trajectory_generation_(false),
+  trajectory_start_time_(0),
   gps_waypoint_(false),
   gps_waypoint_time_(0),
   joy_stick_heart_beat_(false),
@@ -40,6 +45,7 @@ void BaseNavigator::initialize(ros::NodeHandle nh, ros::NodeHandle nhp,
   estimator_ = estimator;
 
   navi_sub_ = nh_.subscribe("uav/nav", 1, &BaseNavigator::naviCallback, this, ros::TransportHints().tcpNoDelay());
+  waypoints_sub_ = nh_.subscribe("uav/nav/waypoints", 1, &BaseNavigator::waypointsCallback, this);
 
   battery_sub_ = nh_.subscribe("battery_voltage_status", 1, &BaseNavigator::batteryCheckCallback, this);
   flight_status_ack_sub_ = nh_.subscribe("flight_config_ack", 1, &BaseNavigator::flightStatusAckCallback, this, ros::TransportHints().tcpNoDelay());
@@ -135,6 +141,15 @@ void BaseNavigator::naviCallback(const aerial_robot_msgs::FlightNavConstPtr & ms
 
   if(force_att_control_flag_) return;
 
+  /* the step target of xy position is replaced by the trajectory from the current state */
+  bool trajectory_nav = trajectory_generation_ && getNaviState() == HOVER_STATE &&
+    msg->pos_xy_nav_mode == aerial_robot_msgs::FlightNav::POS_MODE;
+
+  /* other commands override the running trajectory */
+  if(!trajectory_nav && (msg->pos_xy_nav_mode != aerial_robot_msgs::FlightNav::NO_NAVIGATION ||
+                         msg->pos_z_nav_mode != aerial_robot_msgs::FlightNav::NO_NAVIGATION))
+    stopTrajectory();
+
   /* yaw */
   if(msg->yaw_nav_mode == aerial_robot_msgs::FlightNav::POS_MODE)
     {
@@ -161,6 +176,15 @@ void BaseNavigator::naviCallback(const aerial_robot_msgs::FlightNavConstPtr & ms
               * cog2baselink_tf.getOrigin();
           }
 
+        if(trajectory_nav)
+          {
+            double target_z = getTargetPos().z();
+            if(msg->pos_z_nav_mode == aerial_robot_msgs::FlightNav::POS_MODE) target_z = msg->target_pos_z;
+
+            if(startTrajectory(std::vector<Eigen::Vector3d>(1, Eigen::Vector3d(target_cog_pos.x(), target_cog_pos.y(), target_z))))
+              return;
+          }
+
         tf::Vector3 target_delta = getTargetPos() - target_cog_pos;
         target_delta.setZ(0);
 
@@ -279,6 +303,83 @@ void BaseNavigator::naviCallback(const aerial_robot_msgs::FlightNavConstPtr & ms
     }
 }
 
+void BaseNavigator::waypointsCallback(const geometry_msgs::PoseArrayConstPtr & msg)
+{
+  if(getNaviState() != HOVER_STATE || force_att_control_flag_)
+    {
+      ROS_WARN("[Flight nav] waypoints are only available in hover state");
+      return;
+    }
+
+  if(msg->poses.empty()) return;
+
+  /* CoG positions in world frame */
+  std::vector<Eigen::Vector3d> waypoints;
+  for(const auto& pose: msg->poses)
+    waypoints.push_back(Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z));
+
+  gps_waypoint_ = false;
+  startTrajectory(waypoints);
+}
+
+bool BaseNavigator::startTrajectory(const std::vector<Eigen::Vector3d>& waypoints)
+{
+  double now = ros::Time::now().toSec();
+
+  TrajectoryState start;
+  if(!trajectory_.empty())
+    {
+      /* continue from the current target of the running trajectory */
+      start = trajectory_.sample(now - trajectory_start_time_);
+    }
+  else
+    {
+      tf::Vector3 pos = estimator_->getPos(Frame::COG, estimate_mode_);
+      tf::Vector3 vel = estimator_->getVel(Frame::COG, estimate_mode_);
+      start.pos = Eigen::Vector3d(pos.x(), pos.y(), pos.z());
+      start.vel = Eigen::Vector3d(vel.x(), vel.y(), vel.z());
+      start.acc.setZero();
+    }
+
+  if(!trajectory_.generate(start, waypoints))
+    {
+      ROS_ERROR("[Flight nav] failed to generate the trajectory for %lu waypoints", waypoints.size());
+      return false;
+    }
+
+  if(!trajectory_.withinLimits())
+    ROS_WARN("[Flight nav] the trajectory exceeds the velocity / acceleration limits");
+
+  ROS_INFO("[Flight nav] start %s trajectory for %lu waypoints, duration: %f", (waypoints.size() == 1)?"min-jerk":"min-snap",
+           waypoints.size(), trajectory_.getDuration());
+
+  trajectory_start_time_ = now;
+  vel_based_waypoint_ = false;
+  xy_control_mode_ = POS_CONTROL_MODE;
+  trajectoryUpdate();
+
+  return true;
+}
+
+void BaseNavigator::trajectoryUpdate()
+{
+  if(trajectory_.empty()) return;
+
+  double t = ros::Time::now().toSec() - trajectory_start_time_;
+  TrajectoryState state = trajectory_.sample(t);
+  target_pos_.setValue(state.pos.x(), state.pos.y(), state.pos.z());
+  target_vel_.setValue(state.vel.x(), state.vel.y(), state.vel.z());
+  target_acc_.setValue(state.acc.x(), state.acc.y(), state.acc.z());
+
+  if(t > trajectory_.getDuration())
+    {
+      trajectory_.clear();
+      target_vel_.setValue(0, 0, 0);
+      target_acc_.setValue(0, 0, 0);
+      ROS_INFO("[Flight nav] finish the trajectory");
+    }
+}
+
 const sensor_msgs::Joy BaseNavigator::ps4joyToPs3joyConvert(const sensor_msgs::Joy& ps4_joy_msg)
 {
   /* hard coding */
@@ -565,262 +666,160 @@ void BaseNavigator::joyStickControl(const sensor_msgs::JoyConstPtr & joy_msg)
 
 void BaseNavigator::update()
 {
-  if(force_att_control_flag_)
+  FlightInput input;
+  input.xy_estimated = estimator_->getStateStatus(State::X_BASE, estimate_mode_) && estimator_->getStateStatus(State::Y_BASE, estimate_mode_);
+  input.force_att_control = force_att_control_flag_;
+  input.sensor_unhealth = (estimator_->getUnhealthLevel() == Sensor::UNHEALTH_LEVEL3);
+  input.low_voltage = low_voltage_flag_;
+  input.joy_heart_beat_check = check_joy_stick_heart_beat_;
+  input.joy_heart_beat = joy_stick_heart_beat_;
+  input.joy_stick_prev_time = joy_stick_prev_time_;
+  input.landed = estimator_->getLandedFlag();
+  tf::Vector3 delta = target_pos_ - estimator_->getPos(Frame::COG, estimate_mode_);
+  input.delta_x = delta.x();
+  input.delta_y = delta.y();
+  input.delta_z = delta.z();
+
+  /* the convergent params can be changed for the outdoor flight in motorArming() */
+  FlightStateParams& params = state_machine_.params();
+  params.convergent_duration = convergent_duration_;
+  params.xy_convergent_thresh = xy_convergent_thresh_;
+  params.z_convergent_thresh = z_convergent_thresh_;
+  params.joy_stick_heart_beat_du = joy_stick_heart_beat_du_;
+  params.force_landing_auto_stop = force_landing_auto_stop_flag_;
+
+  FlightStatus status;
+  status.state = getNaviState();
+  status.xy_control_mode = xy_control_mode_;
+  status.prev_xy_control_mode = prev_xy_control_mode_;
+  status.force_landing = force_landing_flag_;
+  status.convergent_start_time = convergent_start_time_;
+
+  FlightActions actions = state_machine_.update(input, status);
+
+  setNaviState(status.state);
+  xy_control_mode_ = status.xy_control_mode;
+  prev_xy_control_mode_ = status.prev_xy_control_mode;
+  force_landing_flag_ = status.force_landing;
+  convergent_start_time_ = status.convergent_start_time;
+
+  for(const auto& transition: state_machine_.getTransitions())
+    {
+      if(std::find(actions.fired.begin(), actions.fired.end(), transition.name) == actions.fired.end()) continue;
+      if(transition.log_level == FLIGHT_LOG_INFO) ROS_INFO_STREAM(transition.log);
+      else if(transition.log_level == FLIGHT_LOG_WARN) ROS_WARN_STREAM(transition.log);
+      else if(transition.log_level == FLIGHT_LOG_ERROR) ROS_ERROR_STREAM(transition.log);
+    }
+
+  /* execute the actions */
+  if(actions.has(FORCE_LANDING_ACTION)) sendFlightConfigCmd(spinal::FlightConfigCmd::FORCE_LANDING_CMD);
+  if(actions.has(SENSOR_FUSION_ACTION)) estimator_->setSensorFusionFlag(true);
+  if(actions.has(ARM_ON_ACTION)) sendFlightConfigCmd(spinal::FlightConfigCmd::ARM_ON_CMD);
+  if(actions.has(FLYING_ACTION) && !estimator_->getFlyingFlag()) estimator_->setFlyingFlag(true);
+  if(actions.has(LANDING_MODE_ACTION) && !estimator_->getLandingMode()) estimator_->setLandingMode(true);
+  if(actions.has(LAND_TARGET_ACTION))
     {
-      if(getNaviState() == LAND_STATE)
-        {
-          setTargetZFromCurrentState();
-          setNaviState(HOVER_STATE);
-        }
+      setTargetXyFromCurrentState();
+      setTargetYawFromCurrentState();
+      setTargetPosZ(estimator_->getLandingHeight());
     }
-  else
+  if(actions.has(HOLD_XY_TARGET_ACTION))
     {
-      /* check the xy estimation status, if not ready, change to att_control_mode */
-      if(!estimator_->getStateStatus(State::X_BASE, estimate_mode_) || !estimator_->getStateStatus(State::Y_BASE, estimate_mode_))
-        {
-          if(xy_control_mode_ == VEL_CONTROL_MODE ||
-             xy_control_mode_ == POS_CONTROL_MODE)
-            {
-              ROS_ERROR("No estimation for X, Y state, change to attitude control mode");
-              prev_xy_control_mode_ = xy_control_mode_;
-              xy_control_mode_ = ACC_CONTROL_MODE;
-            }
-        }
-      else
-        {
-          if(xy_control_mode_ == ACC_CONTROL_MODE &&
-             prev_xy_control_mode_ != ACC_CONTROL_MODE)
-            {
-              ROS_ERROR("Estimation for X, Y state is established, siwtch back to the xy control mode");
-              xy_control_mode_ = prev_xy_control_mode_;
-            }
-        }
+      setTargetXyFromCurrentState();
+      setTargetYawFromCurrentState();
     }
-
-  /* sensor health check */
-  if(estimator_->getUnhealthLevel() == Sensor::UNHEALTH_LEVEL3 && !force_landing_flag_)
+  if(actions.has(HOLD_Z_TARGET_ACTION)) setTargetZFromCurrentState();
+  if(actions.has(ARM_OFF_ACTION))
     {
-      if(getNaviState() == TAKEOFF_STATE || getNaviState() == HOVER_STATE  || getNaviState() == LAND_STATE)
-        ROS_WARN("Sensor Unhealth Level%d: force landing state", estimator_->getUnhealthLevel());
-      spinal::FlightConfigCmd flight_config_cmd;
-      flight_config_cmd.cmd = spinal::FlightConfigCmd::FORCE_LANDING_CMD;
-      flight_config_pub_.publish(flight_config_cmd);
-      force_landing_flag_ = true;
+      reset();
+      sendFlightConfigCmd(spinal::FlightConfigCmd::ARM_OFF_CMD);
     }
+  if(actions.has(HALT_ACTION)) halt();
 
-  if(getNaviState() == TAKEOFF_STATE || getNaviState() == HOVER_STATE)
-    {
-      bool normal_land = false;
-
-      /* joystick heartbeat check */
-      if(check_joy_stick_heart_beat_ && joy_stick_heart_beat_ &&
-         ros::Time::now().toSec() - joy_stick_prev_time_ > joy_stick_heart_beat_du_)
-        {
-          normal_land = true;
-          ROS_ERROR("Normal Landing: att control mode, because no joy control");
-        }
-
-      /* low voltage flag */
-      if(low_voltage_flag_)
-        {
-          normal_land = true;
-          ROS_ERROR("Normal Landing: low battery");
-        }
+  if(getNaviState() == HOVER_STATE && !force_att_control_flag_) hoverNavigation();
 
-      if(normal_land && !force_att_control_flag_)
-        {
-          setNaviState(LAND_STATE);
-          setTargetXyFromCurrentState();
-          setTargetYawFromCurrentState();
-          setTargetPosZ(estimator_->getLandingHeight());
-        }
-    }
+  /* publish the state */
+  std_msgs::UInt8 state_msg;
+  state_msg.data = getNaviState();
+  if(force_landing_flag_) state_msg.data = FORCE_LANDING_STATE;
+  else if(low_voltage_flag_) state_msg.data = LOW_BATTERY_STATE;
+  flight_state_pub_.publish(state_msg);
+}
 
+void BaseNavigator::hoverNavigation()
+{
   tf::Vector3 delta = target_pos_ - estimator_->getPos(Frame::COG, estimate_mode_);
 
-  /* check the hard landing in force_landing model */
-  if(force_landing_flag_)
-    {
-      if(!estimator_->getLandingMode()) estimator_->setLandingMode(true);
-      if(estimator_->getLandedFlag() && force_landing_auto_stop_flag_)
-        {
-          ROS_WARN("hard touch to the ground in force landing mode, disarm motor");
-          setNaviState(STOP_STATE);
-        }
-    }
+  if(xy_control_mode_ == POS_CONTROL_MODE) trajectoryUpdate();
+  else stopTrajectory();
 
-  switch(getNaviState())
+  if(gps_waypoint_)
     {
-    case START_STATE:
-      {
-        /* low voltage */
-        if(low_voltage_flag_)
-          {
-            setNaviState(ARM_OFF_STATE);
-            break;
-          }
-
-        estimator_->setSensorFusionFlag(true);
-        force_landing_flag_ = false;
-
-        spinal::FlightConfigCmd flight_config_cmd;
-        flight_config_cmd.cmd = spinal::FlightConfigCmd::ARM_ON_CMD;
-        flight_config_pub_.publish(flight_config_cmd);
-
-        break;
-      }
-    case TAKEOFF_STATE:
-      { //Takeoff Phase
-
-        /* set flying flag to true once */
-        if(!estimator_->getFlyingFlag())
-          estimator_->setFlyingFlag(true);
-
-        if(xy_control_mode_ == POS_CONTROL_MODE)
-          {
-            if (fabs(delta.z()) > z_convergent_thresh_ || fabs(delta.x()) > xy_convergent_thresh_ || fabs(delta.y()) > xy_convergent_thresh_)
-              convergent_start_time_ = ros::Time::now().toSec();
-          }
-        else
-          {
-            if (fabs(delta.z()) > z_convergent_thresh_) convergent_start_time_ = ros::Time::now().toSec();
-          }
-        if (ros::Time::now().toSec() - convergent_start_time_ > convergent_duration_)
-          {
-            convergent_start_time_ = ros::Time::now().toSec();
-            setNaviState(HOVER_STATE);
-            ROS_WARN("Hovering!");
-
-          }
-        break;
-      }
-    case LAND_STATE:
-      {
-        //for estimator landing mode
-        estimator_->setLandingMode(true);
-
-        if (getNaviState() > START_STATE)
-          {
-            if (fabs(delta.z()) > z_convergent_thresh_) convergent_start_time_ = ros::Time::now().toSec();
-
-            if (ros::Time::now().toSec() - convergent_start_time_ > convergent_duration_)
-              {
-                convergent_start_time_ = ros::Time::now().toSec();
-
-                ROS_ERROR("disarm motors");
-                setNaviState(STOP_STATE);
-
-                setTargetXyFromCurrentState();
-                setTargetYawFromCurrentState();
-              }
-          }
-        else
-          {
-            setNaviState(ARM_OFF_STATE);
-          }
-        break;
-      }
-    case HOVER_STATE:
-      {
-        if(force_att_control_flag_) break;
-
-        if(gps_waypoint_)
-          {
-            if(ros::Time::now().toSec() - gps_waypoint_time_ > gps_waypoint_check_du_)
-              {
-                auto base_wp = estimator_->getCurrGpsPoint();
-                tf::Matrix3x3 convert_frame; convert_frame.setRPY(M_PI, 0, 0); // NED -> XYZ
-                tf::Vector3 gps_waypoint_delta =  convert_frame * sensor_plugin::Gps::wgs84ToNedLocalFrame(base_wp, target_wp_);
-
-
-                if(gps_waypoint_delta.length() < gps_waypoint_threshold_)
-                  gps_waypoint_ = false;
-
-                xy_control_mode_ = POS_CONTROL_MODE;
+      if(ros::Time::now().toSec() - gps_waypoint_time_ > gps_waypoint_check_du_)
+        {
+          auto base_wp = estimator_->getCurrGpsPoint();
+          tf::Matrix3x3 convert_frame; convert_frame.setRPY(M_PI, 0, 0); // NED -> XYZ
+          tf::Vector3 gps_waypoint_delta =  convert_frame * sensor_plugin::Gps::wgs84ToNedLocalFrame(base_wp, target_wp_);
 
-                if(gps_waypoint_delta.length() > vel_nav_threshold_)
-                  {
-                    vel_based_waypoint_ = true;
-                    xy_control_mode_ = VEL_CONTROL_MODE;
-                  }
 
-                //ROS_INFO("gps_waypoint_delta: %f, %f", gps_waypoint_delta.x(), gps_waypoint_delta.y());
-                tf::Vector3 target_cog_pos = estimator_->getPos(Frame::COG, estimate_mode_) + gps_waypoint_delta;
-                setTargetPosX(target_cog_pos.x());
-                setTargetPosY(target_cog_pos.y());
+          if(gps_waypoint_delta.length() < gps_waypoint_threshold_)
+            gps_waypoint_ = false;
 
-                delta = gps_waypoint_delta;
-                gps_waypoint_time_ = ros::Time::now().toSec();
-              }
-          }
+          xy_control_mode_ = POS_CONTROL_MODE;
 
-        if(vel_based_waypoint_)
-          {
-            delta.setZ(0); // we do not need z
-            /* vel nav */
-            if(delta.length() > vel_nav_threshold_)
-              {
-                tf::Vector3 nav_vel = delta * vel_nav_gain_;
+          if(gps_waypoint_delta.length() > vel_nav_threshold_)
+            {
+              vel_based_waypoint_ = true;
+              xy_control_mode_ = VEL_CONTROL_MODE;
+            }
 
-                double speed = nav_vel.length();
-                if(speed  > nav_vel_limit_) nav_vel *= (nav_vel_limit_ / speed);
+          //ROS_INFO("gps_waypoint_delta: %f, %f", gps_waypoint_delta.x(), gps_waypoint_delta.y());
+          tf::Vector3 target_cog_pos = estimator_->getPos(Frame::COG, estimate_mode_) + gps_waypoint_delta;
+          setTargetPosX(target_cog_pos.x());
+          setTargetPosY(target_cog_pos.y());
 
-                setTargetVelX(nav_vel.x());
-                setTargetVelY(nav_vel.y());
-              }
-            else
-              {
-                if(gps_waypoint_)
-                  {
-                    auto base_wp = estimator_->getCurrGpsPoint();
-                    tf::Matrix3x3 convert_frame; convert_frame.setRPY(M_PI, 0, 0); // NED -> XYZ
-                    tf::Vector3 gps_waypoint_delta =  convert_frame * sensor_plugin::Gps::wgs84ToNedLocalFrame(base_wp, target_wp_);
+          delta = gps_waypoint_delta;
+          gps_waypoint_time_ = ros::Time::now().toSec();
+        }
+    }
 
-                    ROS_WARN("back to pos nav control for GPS way point, gps waypoint delta: %f, %f", gps_waypoint_delta.x(), gps_waypoint_delta.y());
-                    gps_waypoint_  = false;
-                  }
-                else
-                  {
-                    ROS_WARN("back to pos nav control for way point");
-                  }
+  if(vel_based_waypoint_)
+    {
+      delta.setZ(0); // we do not need z
+      /* vel nav */
+      if(delta.length() > vel_nav_threshold_)
+        {
+          tf::Vector3 nav_vel = delta * vel_nav_gain_;
 
-                xy_control_mode_ = POS_CONTROL_MODE;
-                vel_based_waypoint_ = false;
-                setTargetVelX(0);
-                setTargetVelY(0);
-                setTargetVelZ(0);
-              }
-          }
-        break;
-      }
-    case STOP_STATE:
-      {
-        reset();
+          double speed = nav_vel.length();
+          if(speed  > nav_vel_limit_) nav_vel *= (nav_vel_limit_ / speed);
 
-        spinal::FlightConfigCmd flight_config_cmd;
-        flight_config_cmd.cmd = spinal::FlightConfigCmd::ARM_OFF_CMD;
-        flight_config_pub_.publish(flight_config_cmd);
+          setTargetVelX(nav_vel.x());
+          setTargetVelY(nav_vel.y());
+        }
+      else
+        {
+          if(gps_waypoint_)
+            {
+              auto base_wp = estimator_->getCurrGpsPoint();
+              tf::Matrix3x3 convert_frame; convert_frame.setRPY(M_PI, 0, 0); // NED -> XYZ
+              tf::Vector3 gps_waypoint_delta =  convert_frame * sensor_plugin::Gps::wgs84ToNedLocalFrame(base_wp, target_wp_);
 
-        if(force_landing_flag_)
-          {
-            halt();
-            force_landing_flag_ = false;
-          }
+              ROS_WARN("back to pos nav control for GPS way point, gps waypoint delta: %f, %f", gps_waypoint_delta.x(), gps_waypoint_delta.y());
+              gps_waypoint_  = false;
+            }
+          else
+            {
+              ROS_WARN("back to pos nav control for way point");
+            }
 
-        break;
-      }
-    default:
-      {
-        break;
-      }
+          xy_control_mode_ = POS_CONTROL_MODE;
+          vel_based_waypoint_ = false;
+          setTargetVelX(0);
+          setTargetVelY(0);
+          setTargetVelZ(0);
+        }
     }
-
-  /* publish the state */
-  std_msgs::UInt8 state_msg;
-  state_msg.data = getNaviState();
-  if(force_landing_flag_) state_msg.data = FORCE_LANDING_STATE;
-  else if(low_voltage_flag_) state_msg.data = LOW_BATTERY_STATE;
-  flight_state_pub_.publish(state_msg);
 }
 
 
@@ -843,6 +842,16 @@ void BaseNavigator::rosParamInit()
   getParam<double>(nh, "vel_nav_threshold", vel_nav_threshold_, 0.4);
   getParam<double>(nh, "vel_nav_gain", vel_nav_gain_, 1.0);
 
+  //*** polynomial trajectory for waypoint
+  getParam<bool>(nh, "trajectory_generation", trajectory_generation_, false);
+  double traj_max_vel_xy, traj_max_vel_z, traj_max_acc_xy, traj_max_acc_z;
+  getParam<double>(nh, "trajectory_max_vel_xy", traj_max_vel_xy, nav_vel_limit_);
+  getParam<double>(nh, "trajectory_max_vel_z", traj_max_vel_z, 0.3);
+  getParam<double>(nh, "trajectory_max_acc_xy", traj_max_acc_xy, 0.5);
+  getParam<double>(nh, "trajectory_max_acc_z", traj_max_acc_z, 0.3);
+  trajectory_.setLimits(Eigen::Vector3d(traj_max_vel_xy, traj_max_vel_xy, traj_max_vel_z),
+                        Eigen::Vector3d(traj_max_acc_xy, traj_max_acc_xy, traj_max_acc_z));
+
   //*** gps waypoint
   getParam<double>(nh, "gps_waypoint_threshold", gps_waypoint_threshold_, 3.0);
   getParam<double>(nh, "gps_waypoint_check_du", gps_waypoint_check_du_, 1.0);
@@ -0,0 +1,242 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_control/flight_state_machine.h>
+#include <algorithm>
+#include <cmath>
+
+namespace aerial_robot_navigation
+{
+  constexpr int FlightStateMachine::KEEP_STATE;
+  constexpr uint32_t FlightStateMachine::ANY_STATE;
+
+  FlightStateMachine::FlightStateMachine(Clock clock): clock_(clock)
+  {
+    defaultTransitions();
+  }
+
+  uint32_t FlightStateMachine::stateMask(std::initializer_list<uint8_t> states)
+  {
+    uint32_t mask = 0;
+    for(const auto& state: states) mask |= (1 << state);
+    return mask;
+  }
+
+  bool FlightStateMachine::insertTransition(const std::string& before, const FlightTransition& transition)
+  {
+    auto it = std::find_if(transitions_.begin(), transitions_.end(),
+                           [&before](const FlightTransition& t) { return t.name == before; });
+    if(it == transitions_.end()) return false;
+    transitions_.insert(it, transition);
+    return true;
+  }
+
+  bool FlightStateMachine::removeTransition(const std::string& name)
+  {
+    auto it = std::find_if(transitions_.begin(), transitions_.end(),
+                           [&name](const FlightTransition& t) { return t.name == name; });
+    if(it == transitions_.end()) return false;
+    transitions_.erase(it);
+    return true;
+  }
+
+  FlightActions FlightStateMachine::update(const FlightInput& input, FlightStatus& status) const
+  {
+    FlightActions actions;
+    const double now = clock_();
+
+    for(const auto& transition: transitions_)
+      {
+        if(status.state >= 32 || !(transition.from & (1 << status.state))) continue;
+        if(transition.guard && !transition.guard(input, status, now)) continue;
+
+        if(transition.action) transition.action(input, status, actions, now);
+        if(transition.to != KEEP_STATE) status.state = transition.to;
+        actions.fired.push_back(transition.name);
+      }
+
+    return actions;
+  }
+
+  void FlightStateMachine::defaultTransitions()
+  {
+    const uint32_t flying = stateMask({TAKEOFF_STATE, HOVER_STATE});
+
+    auto set = [](uint32_t flags)
+      {
+        return [flags](const FlightInput&, FlightStatus&, FlightActions& actions, double) { actions.flags |= flags; };
+      };
+
+    /* landing command in the attitude control mode: hold the current altitude instead */
+    transitions_.push_back({"force_att_control_land", stateMask({LAND_STATE}),
+          [](const FlightInput& in, const FlightStatus&, double) { return in.force_att_control; },
+          HOVER_STATE, set(HOLD_Z_TARGET_ACTION), FLIGHT_LOG_WARN, "attitude control mode: hold the altitude instead of landing"});
+
+    /* xy estimation fallback */
+    transitions_.push_back({"xy_estimation_lost", ANY_STATE,
+          [](const FlightInput& in, const FlightStatus& st, double)
+          {
+            return !in.force_att_control && !in.xy_estimated &&
+              (st.xy_control_mode == VEL_CONTROL_MODE || st.xy_control_mode == POS_CONTROL_MODE);
+          },
+          KEEP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions&, double)
+          {
+            st.prev_xy_control_mode = st.xy_control_mode;
+            st.xy_control_mode = ACC_CONTROL_MODE;
+          },
+          FLIGHT_LOG_ERROR, "No estimation for X, Y state, change to attitude control mode"});
+
+    transitions_.push_back({"xy_estimation_recovered", ANY_STATE,
+          [](const FlightInput& in, const FlightStatus& st, double)
+          {
+            return !in.force_att_control && in.xy_estimated &&
+              st.xy_control_mode == ACC_CONTROL_MODE && st.prev_xy_control_mode != ACC_CONTROL_MODE;
+          },
+          KEEP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions&, double) { st.xy_control_mode = st.prev_xy_control_mode; },
+          FLIGHT_LOG_ERROR, "Estimation for X, Y state is established, siwtch back to the xy control mode"});
+
+    /* sensor health check */
+    transitions_.push_back({"sensor_unhealth", ANY_STATE,
+          [](const FlightInput& in, const FlightStatus& st, double) { return in.sensor_unhealth && !st.force_landing; },
+          KEEP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions& actions, double)
+          {
+            actions.flags |= FORCE_LANDING_ACTION;
+            st.force_landing = true;
+          },
+          FLIGHT_LOG_WARN, "Sensor Unhealth Level3: force landing state"});
+
+    /* normal landing, the convergence timer restarts with the landing target */
+    auto land = [](const FlightInput&, FlightStatus& st, FlightActions& actions, double now)
+      {
+        actions.flags |= LAND_TARGET_ACTION;
+        st.convergent_start_time = now;
+      };
+
+    transitions_.push_back({"joy_heart_beat_landing", flying,
+          [this](const FlightInput& in, const FlightStatus&, double now)
+          {
+            return !in.force_att_control && in.joy_heart_beat_check && in.joy_heart_beat &&
+              now - in.joy_stick_prev_time > params_.joy_stick_heart_beat_du;
+          },
+          LAND_STATE, land, FLIGHT_LOG_ERROR, "Normal Landing: att control mode, because no joy control"});
+
+    transitions_.push_back({"low_battery_landing", flying,
+          [](const FlightInput& in, const FlightStatus&, double) { return !in.force_att_control && in.low_voltage; },
+          LAND_STATE, land, FLIGHT_LOG_ERROR, "Normal Landing: low battery"});
+
+    /* force landing */
+    transitions_.push_back({"force_landing", ANY_STATE,
+          [](const FlightInput&, const FlightStatus& st, double) { return st.force_landing; },
+          KEEP_STATE, set(LANDING_MODE_ACTION), FLIGHT_LOG_NONE, ""});
+
+    transitions_.push_back({"force_landing_touchdown", ANY_STATE & ~stateMask({STOP_STATE}),
+          [this](const FlightInput& in, const FlightStatus& st, double)
+          {
+            return st.force_landing && in.landed && params_.force_landing_auto_stop;
+          },
+          STOP_STATE, nullptr, FLIGHT_LOG_WARN, "hard touch to the ground in force landing mode, disarm motor"});
+
+    /* start */
+    transitions_.push_back({"start_low_voltage", stateMask({START_STATE}),
+          [](const FlightInput& in, const FlightStatus&, double) { return in.low_voltage; },
+          ARM_OFF_STATE, nullptr, FLIGHT_LOG_ERROR, "low battery: can not arm motors"});
+
+    transitions_.push_back({"start_arming", stateMask({START_STATE}), nullptr, KEEP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions& actions, double)
+          {
+            actions.flags |= (SENSOR_FUSION_ACTION | ARM_ON_ACTION);
+            st.force_landing = false;
+          },
+          FLIGHT_LOG_NONE, ""});
+
+    /* takeoff */
+    transitions_.push_back({"takeoff", stateMask({TAKEOFF_STATE}), nullptr, KEEP_STATE,
+          [this](const FlightInput& in, FlightStatus& st, FlightActions& actions, double now)
+          {
+            actions.flags |= FLYING_ACTION;
+            bool z_error = fabs(in.delta_z) > params_.z_convergent_thresh;
+            bool xy_error = fabs(in.delta_x) > params_.xy_convergent_thresh || fabs(in.delta_y) > params_.xy_convergent_thresh;
+            if(z_error || (st.xy_control_mode == POS_CONTROL_MODE && xy_error)) st.convergent_start_time = now;
+          },
+          FLIGHT_LOG_NONE, ""});
+
+    transitions_.push_back({"takeoff_converged", stateMask({TAKEOFF_STATE}),
+          [this](const FlightInput&, const FlightStatus& st, double now)
+          {
+            return now - st.convergent_start_time > params_.convergent_duration;
+          },
+          HOVER_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions&, double now) { st.convergent_start_time = now; },
+          FLIGHT_LOG_WARN, "Hovering!"});
+
+    /* land */
+    transitions_.push_back({"landing", stateMask({LAND_STATE}), nullptr, KEEP_STATE,
+          [this](const FlightInput& in, FlightStatus& st, FlightActions& actions, double now)
+          {
+            actions.flags |= LANDING_MODE_ACTION;
+            if(fabs(in.delta_z) > params_.z_convergent_thresh) st.convergent_start_time = now;
+          },
+          FLIGHT_LOG_NONE, ""});
+
+    transitions_.push_back({"landed", stateMask({LAND_STATE}),
+          [this](const FlightInput&, const FlightStatus& st, double now)
+          {
+            return now - st.convergent_start_time > params_.convergent_duration;
+          },
+          STOP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions& actions, double now)
+          {
+            actions.flags |= HOLD_XY_TARGET_ACTION;
+            st.convergent_start_time = now;
+          },
+          FLIGHT_LOG_ERROR, "disarm motors"});
+
+    /* stop */
+    transitions_.push_back({"stop", stateMask({STOP_STATE}), nullptr, KEEP_STATE,
+          [](const FlightInput&, FlightStatus& st, FlightActions& actions, double)
+          {
+            actions.flags |= ARM_OFF_ACTION;
+            if(st.force_landing)
+              {
+                actions.flags |= HALT_ACTION;
+                st.force_landing = false;
+              }
+          },
+          FLIGHT_LOG_NONE, ""});
+  }
+};
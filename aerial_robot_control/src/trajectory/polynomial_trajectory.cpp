@@ -0,0 +1,297 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_control/trajectory/polynomial_trajectory.h>
+#include <Eigen/Sparse>
+#include <algorithm>
+
+namespace aerial_robot_navigation
+{
+  constexpr int PolynomialTrajectory::COEFF_NUM;
+  constexpr double PolynomialTrajectory::MIN_JERK_VEL_RATIO;
+  constexpr double PolynomialTrajectory::MIN_JERK_ACC_RATIO;
+  constexpr int PolynomialTrajectory::MAX_SCALE_ITERATION;
+  constexpr int PolynomialTrajectory::CHECK_RESOLUTION;
+
+  namespace
+  {
+    /* k! / (k - n)! */
+    double factorialRatio(int k, int n)
+    {
+      double ret = 1;
+      for(int i = k - n + 1; i <= k; i++) ret *= i;
+      return ret;
+    }
+  }
+
+  PolynomialTrajectory::PolynomialTrajectory():
+    max_vel_(1.0, 1.0, 0.5),
+    max_acc_(1.0, 1.0, 0.5),
+    min_segment_duration_(0.1),
+    within_limits_(false)
+  {
+  }
+
+  void PolynomialTrajectory::setLimits(const Eigen::Vector3d& max_vel, const Eigen::Vector3d& max_acc)
+  {
+    max_vel_ = max_vel;
+    max_acc_ = max_acc;
+  }
+
+  void PolynomialTrajectory::clear()
+  {
+    durations_.clear();
+    coeffs_.resize(3, 0);
+    within_limits_ = false;
+  }
+
+  double PolynomialTrajectory::getDuration() const
+  {
+    double duration = 0;
+    for(const auto& d: durations_) duration += d;
+    return duration;
+  }
+
+  bool PolynomialTrajectory::generate(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints)
+  {
+    clear();
+    if(waypoints.empty()) return false;
+
+    /* initial durations from the rest-to-rest min-jerk profile of each segment */
+    Eigen::Vector3d prev = start.pos;
+    for(const auto& waypoint: waypoints)
+      {
+        double duration = min_segment_duration_;
+        for(int i = 0; i < 3; i++)
+          {
+            double d = fabs(waypoint(i) - prev(i));
+            duration = std::max(duration, MIN_JERK_VEL_RATIO * d / max_vel_(i));
+            duration = std::max(duration, sqrt(MIN_JERK_ACC_RATIO * d / max_acc_(i)));
+          }
+        durations_.push_back(duration);
+        prev = waypoint;
+      }
+
+    /* stretch the time until the limits are satisfied, the initial velocity and acceleration are not changed by the scaling */
+    for(int i = 0; i < MAX_SCALE_ITERATION; i++)
+      {
+        if(!solve(start, waypoints))
+          {
+            clear();
+            return false;
+          }
+
+        double ratio = limitRatio(start);
+        if(ratio <= 1.0)
+          {
+            within_limits_ = true;
+            break;
+          }
+
+        double scale = std::min(std::max(ratio, 1.05), 2.0);
+        for(auto& d: durations_) d *= scale;
+      }
+
+    if(!within_limits_) return solve(start, waypoints);
+    return true;
+  }
+
+  bool PolynomialTrajectory::solve(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints)
+  {
+    coeffs_ = Eigen::MatrixXd::Zero(3, COEFF_NUM * waypoints.size());
+    if(waypoints.size() == 1)
+      {
+        solveMinJerk(start, waypoints.front());
+        return true;
+      }
+    return solveMinSnap(start, waypoints);
+  }
+
+  void PolynomialTrajectory::solveMinJerk(const TrajectoryState& start, const Eigen::Vector3d& end)
+  {
+    const double t = durations_.front();
+    Eigen::Vector3d c0 = start.pos;
+    Eigen::Vector3d c1 = start.vel * t;
+    Eigen::Vector3d c2 = start.acc * t * t / 2;
+
+    /* end at rest: x(1) = end, x'(1) = 0, x''(1) = 0 in the normalized time */
+    Eigen::Vector3d a = end - c0 - c1 - c2;
+    Eigen::Vector3d b = - c1 - 2 * c2;
+    Eigen::Vector3d c = - 2 * c2;
+
+    coeffs_.col(0) = c0;
+    coeffs_.col(1) = c1;
+    coeffs_.col(2) = c2;
+    coeffs_.col(3) = 10 * a - 4 * b + c / 2;
+    coeffs_.col(4) = -15 * a + 7 * b - c;
+    coeffs_.col(5) = 6 * a - 3 * b + c / 2;
+  }
+
+  bool PolynomialTrajectory::solveMinSnap(const TrajectoryState& start, const std::vector<Eigen::Vector3d>& waypoints)
+  {
+    const int segments = waypoints.size();
+    const int size = COEFF_NUM * segments;
+
+    std::vector<Eigen::Triplet<double> > triplets;
+    Eigen::MatrixXd rhs = Eigen::MatrixXd::Zero(size, 3);
+    int row = 0;
+
+    /* derivative n at the normalized time tau = 0 or 1 of a segment, multiplied by T^n */
+    auto derivative = [&](int segment, int n, bool end, double scale)
+      {
+        for(int k = n; k < COEFF_NUM; k++)
+          {
+            if(!end && k > n) break;
+            triplets.push_back(Eigen::Triplet<double>(row, COEFF_NUM * segment + k, scale * factorialRatio(k, n)));
+          }
+      };
+
+    /* start: position, velocity, acceleration, and zero jerk */
+    const double t0 = durations_.front();
+    for(int n = 0; n < 4; n++)
+      {
+        derivative(0, n, false, 1.0);
+        if(n == 0) rhs.row(row) = start.pos.transpose();
+        if(n == 1) rhs.row(row) = start.vel.transpose() * t0;
+        if(n == 2) rhs.row(row) = start.acc.transpose() * t0 * t0;
+        row++;
+      }
+
+    /* waypoints: position of both sides, continuity of the 1st - 6th derivatives */
+    for(int i = 1; i < segments; i++)
+      {
+        derivative(i - 1, 0, true, 1.0);
+        rhs.row(row++) = waypoints.at(i - 1).transpose();
+        derivative(i, 0, false, 1.0);
+        rhs.row(row++) = waypoints.at(i - 1).transpose();
+
+        const double ratio = durations_.at(i - 1) / durations_.at(i);
+        for(int n = 1; n < COEFF_NUM - 1; n++)
+          {
+            derivative(i - 1, n, true, 1.0);
+            derivative(i, n, false, -pow(ratio, n));
+            row++;
+          }
+      }
+
+    /* end at rest */
+    for(int n = 0; n < 4; n++)
+      {
+        derivative(segments - 1, n, true, 1.0);
+        if(n == 0) rhs.row(row) = waypoints.back().transpose();
+        row++;
+      }
+
+    /* block bidiagonal, each waypoint only couples the neighbouring segments */
+    Eigen::SparseMatrix<double> a(size, size);
+    a.setFromTriplets(triplets.begin(), triplets.end());
+    Eigen::SparseLU<Eigen::SparseMatrix<double> > solver;
+    solver.compute(a);
+    if(solver.info() != Eigen::Success) return false;
+
+    Eigen::MatrixXd x = solver.solve(rhs);
+    if(solver.info() != Eigen::Success) return false;
+
+    coeffs_ = x.transpose();
+    return true;
+  }
+
+  double PolynomialTrajectory::limitRatio(const TrajectoryState& start) const
+  {
+    /* the start state can not be changed by the time scaling */
+    Eigen::Vector3d max_vel = max_vel_.cwiseMax(start.vel.cwiseAbs());
+    Eigen::Vector3d max_acc = max_acc_.cwiseMax(start.acc.cwiseAbs());
+
+    double ratio = 0;
+    TrajectoryState state;
+    for(size_t segment = 0; segment < durations_.size(); segment++)
+      {
+        for(int j = 0; j <= CHECK_RESOLUTION; j++)
+          {
+            evaluate(segment, j / (double)CHECK_RESOLUTION, state);
+            for(int i = 0; i < 3; i++)
+              {
+                ratio = std::max(ratio, fabs(state.vel(i)) / max_vel(i));
+                ratio = std::max(ratio, sqrt(fabs(state.acc(i)) / max_acc(i))); // the acceleration scales with T^-2
+              }
+          }
+      }
+    return ratio;
+  }
+
+  void PolynomialTrajectory::evaluate(int segment, double tau, TrajectoryState& state) const
+  {
+    const double t = durations_.at(segment);
+    const auto c = coeffs_.middleCols<COEFF_NUM>(COEFF_NUM * segment);
+
+    /* horner's method */
+    state.pos = c.col(COEFF_NUM - 1);
+    state.vel = (COEFF_NUM - 1) * c.col(COEFF_NUM - 1);
+    state.acc = (COEFF_NUM - 1) * (COEFF_NUM - 2) * c.col(COEFF_NUM - 1);
+    for(int k = COEFF_NUM - 2; k >= 0; k--)
+      {
+        state.pos = state.pos * tau + c.col(k);
+        if(k >= 1) state.vel = state.vel * tau + k * c.col(k);
+        if(k >= 2) state.acc = state.acc * tau + k * (k - 1) * c.col(k);
+      }
+
+    state.vel /= t;
+    state.acc /= (t * t);
+  }
+
+  TrajectoryState PolynomialTrajectory::sample(double t) const
+  {
+    TrajectoryState state;
+    if(empty())
+      {
+        state.pos.setZero();
+        state.vel.setZero();
+        state.acc.setZero();
+        return state;
+      }
+
+    t = std::max(t, 0.0);
+    for(size_t segment = 0; segment < durations_.size(); segment++)
+      {
+        if(t <= durations_.at(segment) || segment == durations_.size() - 1)
+          {
+            evaluate(segment, std::min(t / durations_.at(segment), 1.0), state);
+            return state;
+          }
+        t -= durations_.at(segment);
+      }
+    return state;
+  }
+};
@@ -0,0 +1,436 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <aerial_robot_control/flight_state_machine.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace aerial_robot_navigation;
+
+namespace
+{
+  class FlightStateMachineTest : public testing::Test
+  {
+  protected:
+    FlightStateMachineTest(): now_(100.0), machine_([this]{ return now_; }) {}
+
+    FlightActions update(uint8_t state)
+    {
+      status_.state = state;
+      return machine_.update(input_, status_);
+    }
+
+    FlightActions update() { return machine_.update(input_, status_); }
+
+    static bool fired(const FlightActions& actions, const std::string& name)
+    {
+      return std::find(actions.fired.begin(), actions.fired.end(), name) != actions.fired.end();
+    }
+
+    double now_;
+    FlightStateMachine machine_;
+    FlightInput input_;
+    FlightStatus status_;
+  };
+}
+
+TEST_F(FlightStateMachineTest, ArmOffIsIdle)
+{
+  FlightActions actions = update(ARM_OFF_STATE);
+  EXPECT_EQ(actions.flags, 0u);
+  EXPECT_TRUE(actions.fired.empty());
+  EXPECT_EQ(status_.state, ARM_OFF_STATE);
+
+  update(ARM_ON_STATE);
+  EXPECT_EQ(status_.state, ARM_ON_STATE);
+}
+
+TEST_F(FlightStateMachineTest, StartArming)
+{
+  status_.force_landing = true;
+  FlightActions actions = update(START_STATE);
+  EXPECT_TRUE(actions.has(ARM_ON_ACTION));
+  EXPECT_TRUE(actions.has(SENSOR_FUSION_ACTION));
+  EXPECT_FALSE(status_.force_landing);
+  EXPECT_EQ(status_.state, START_STATE); // ARM_ON_STATE by the ack from spinal
+}
+
+TEST_F(FlightStateMachineTest, StartLowVoltage)
+{
+  input_.low_voltage = true;
+  FlightActions actions = update(START_STATE);
+  EXPECT_EQ(status_.state, ARM_OFF_STATE);
+  EXPECT_FALSE(actions.has(ARM_ON_ACTION));
+  EXPECT_FALSE(actions.has(SENSOR_FUSION_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, TakeoffConvergence)
+{
+  status_.convergent_start_time = now_;
+  input_.delta_z = 0.5;
+  FlightActions actions = update(TAKEOFF_STATE);
+  EXPECT_TRUE(actions.has(FLYING_ACTION));
+
+  /* not converged in z, the timer keeps restarting */
+  now_ += 2.0;
+  update();
+  EXPECT_EQ(status_.state, TAKEOFF_STATE);
+  EXPECT_DOUBLE_EQ(status_.convergent_start_time, now_);
+
+  /* converged, but not for the convergent duration yet */
+  input_.delta_z = 0.01;
+  now_ += 0.5;
+  update();
+  EXPECT_EQ(status_.state, TAKEOFF_STATE);
+
+  now_ += 0.6;
+  actions = update();
+  EXPECT_EQ(status_.state, HOVER_STATE);
+  EXPECT_TRUE(fired(actions, "takeoff_converged"));
+  EXPECT_DOUBLE_EQ(status_.convergent_start_time, now_);
+}
+
+TEST_F(FlightStateMachineTest, TakeoffXyConvergenceOnlyInPosMode)
+{
+  input_.delta_x = 0.5;
+  status_.convergent_start_time = now_;
+
+  status_.xy_control_mode = POS_CONTROL_MODE;
+  now_ += 2.0;
+  update(TAKEOFF_STATE);
+  EXPECT_EQ(status_.state, TAKEOFF_STATE);
+
+  status_.xy_control_mode = VEL_CONTROL_MODE;
+  now_ += 2.0;
+  update(TAKEOFF_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+}
+
+TEST_F(FlightStateMachineTest, ConvergentParams)
+{
+  machine_.params().convergent_duration = 3.0;
+  machine_.params().z_convergent_thresh = 0.2;
+  input_.delta_z = 0.1;
+  status_.convergent_start_time = now_;
+
+  now_ += 2.0;
+  update(TAKEOFF_STATE);
+  EXPECT_EQ(status_.state, TAKEOFF_STATE);
+
+  now_ += 1.5;
+  update();
+  EXPECT_EQ(status_.state, HOVER_STATE);
+}
+
+TEST_F(FlightStateMachineTest, JoyHeartBeatLanding)
+{
+  input_.joy_heart_beat_check = true;
+  input_.joy_heart_beat = true;
+  input_.joy_stick_prev_time = now_ - 1.0;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+
+  /* no heart beat check, or no joy message received yet */
+  input_.joy_stick_prev_time = now_ - 3.0;
+  input_.joy_heart_beat_check = false;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+  input_.joy_heart_beat_check = true;
+  input_.joy_heart_beat = false;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+
+  input_.joy_heart_beat = true;
+  input_.delta_z = 0.0; // the landing target is set by the navigator after the update
+  for(uint8_t state: {TAKEOFF_STATE, HOVER_STATE})
+    {
+      FlightActions actions = update(state);
+      EXPECT_EQ(status_.state, LAND_STATE);
+      EXPECT_TRUE(actions.has(LAND_TARGET_ACTION));
+      EXPECT_TRUE(actions.has(LANDING_MODE_ACTION));
+      EXPECT_TRUE(fired(actions, "joy_heart_beat_landing"));
+      EXPECT_DOUBLE_EQ(status_.convergent_start_time, now_);
+    }
+
+  /* only once */
+  EXPECT_FALSE(update().has(LAND_TARGET_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, LowBatteryLanding)
+{
+  input_.low_voltage = true;
+  for(uint8_t state: {TAKEOFF_STATE, HOVER_STATE})
+    {
+      FlightActions actions = update(state);
+      EXPECT_EQ(status_.state, LAND_STATE);
+      EXPECT_TRUE(actions.has(LAND_TARGET_ACTION));
+      EXPECT_TRUE(fired(actions, "low_battery_landing"));
+    }
+
+  /* both conditions, only one landing */
+  input_.joy_heart_beat_check = true;
+  input_.joy_heart_beat = true;
+  input_.joy_stick_prev_time = 0;
+  FlightActions actions = update(HOVER_STATE);
+  EXPECT_TRUE(fired(actions, "joy_heart_beat_landing"));
+  EXPECT_FALSE(fired(actions, "low_battery_landing"));
+
+  /* no landing in other states */
+  for(uint8_t state: {ARM_OFF_STATE, ARM_ON_STATE, STOP_STATE})
+    {
+      update(state);
+      EXPECT_NE(status_.state, LAND_STATE);
+    }
+}
+
+TEST_F(FlightStateMachineTest, NoLandingInAttControl)
+{
+  input_.force_att_control = true;
+  input_.low_voltage = true;
+  input_.joy_heart_beat_check = true;
+  input_.joy_heart_beat = true;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+
+  /* land command in the att control mode: hold the altitude */
+  FlightActions actions = update(LAND_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+  EXPECT_TRUE(actions.has(HOLD_Z_TARGET_ACTION));
+  EXPECT_FALSE(actions.has(LANDING_MODE_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, Landing)
+{
+  status_.convergent_start_time = now_ - 10.0;
+  input_.delta_z = -1.0;
+  FlightActions actions = update(LAND_STATE);
+  EXPECT_EQ(status_.state, LAND_STATE);
+  EXPECT_TRUE(actions.has(LANDING_MODE_ACTION));
+  EXPECT_DOUBLE_EQ(status_.convergent_start_time, now_);
+
+  /* the xy error is not considered for landing */
+  input_.delta_z = 0.0;
+  input_.delta_x = 1.0;
+  now_ += 0.5;
+  update();
+  EXPECT_EQ(status_.state, LAND_STATE);
+
+  now_ += 0.6;
+  actions = update();
+  EXPECT_EQ(status_.state, STOP_STATE);
+  EXPECT_TRUE(actions.has(HOLD_XY_TARGET_ACTION));
+  EXPECT_TRUE(fired(actions, "landed"));
+  EXPECT_TRUE(fired(actions, "stop")); // the following transition of the new state in the same update
+  EXPECT_TRUE(actions.has(ARM_OFF_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, Stop)
+{
+  FlightActions actions = update(STOP_STATE);
+  EXPECT_TRUE(actions.has(ARM_OFF_ACTION));
+  EXPECT_FALSE(actions.has(HALT_ACTION));
+  EXPECT_EQ(status_.state, STOP_STATE); // ARM_OFF_STATE by the ack from spinal
+
+  status_.force_landing = true;
+  actions = update(STOP_STATE);
+  EXPECT_TRUE(actions.has(ARM_OFF_ACTION));
+  EXPECT_TRUE(actions.has(HALT_ACTION));
+  EXPECT_FALSE(status_.force_landing);
+}
+
+TEST_F(FlightStateMachineTest, SensorUnhealth)
+{
+  input_.sensor_unhealth = true;
+  FlightActions actions = update(HOVER_STATE);
+  EXPECT_TRUE(actions.has(FORCE_LANDING_ACTION));
+  EXPECT_TRUE(actions.has(LANDING_MODE_ACTION));
+  EXPECT_TRUE(status_.force_landing);
+  EXPECT_EQ(status_.state, HOVER_STATE); // spinal lands by itself
+
+  /* the force landing command is sent only once */
+  actions = update();
+  EXPECT_FALSE(actions.has(FORCE_LANDING_ACTION));
+  EXPECT_TRUE(actions.has(LANDING_MODE_ACTION));
+
+  /* also before takeoff */
+  status_.force_landing = false;
+  EXPECT_TRUE(update(ARM_ON_STATE).has(FORCE_LANDING_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, ForceLandingTouchdown)
+{
+  status_.force_landing = true;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+
+  input_.landed = true;
+  FlightActions actions = update();
+  EXPECT_TRUE(fired(actions, "force_landing_touchdown"));
+  EXPECT_TRUE(actions.has(ARM_OFF_ACTION));
+  EXPECT_TRUE(actions.has(HALT_ACTION));
+  EXPECT_EQ(status_.state, STOP_STATE);
+  EXPECT_FALSE(status_.force_landing);
+
+  /* the force landing from the ack of spinal after the sensor unhealth */
+  input_.sensor_unhealth = true;
+  actions = update(LAND_STATE);
+  EXPECT_TRUE(actions.has(FORCE_LANDING_ACTION));
+  EXPECT_EQ(status_.state, STOP_STATE);
+  EXPECT_TRUE(actions.has(HALT_ACTION));
+}
+
+TEST_F(FlightStateMachineTest, ForceLandingWithoutAutoStop)
+{
+  machine_.params().force_landing_auto_stop = false;
+  status_.force_landing = true;
+  input_.landed = true;
+  FlightActions actions = update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+  EXPECT_TRUE(actions.has(LANDING_MODE_ACTION));
+  EXPECT_FALSE(actions.has(ARM_OFF_ACTION));
+  EXPECT_TRUE(status_.force_landing);
+}
+
+TEST_F(FlightStateMachineTest, XyEstimation)
+{
+  input_.xy_estimated = false;
+  for(int mode: {POS_CONTROL_MODE, VEL_CONTROL_MODE})
+    {
+      status_.xy_control_mode = mode;
+      status_.prev_xy_control_mode = ACC_CONTROL_MODE;
+      update(HOVER_STATE);
+      EXPECT_EQ(status_.xy_control_mode, ACC_CONTROL_MODE);
+      EXPECT_EQ(status_.prev_xy_control_mode, mode);
+
+      update();
+      EXPECT_EQ(status_.prev_xy_control_mode, mode);
+
+      input_.xy_estimated = true;
+      update();
+      EXPECT_EQ(status_.xy_control_mode, mode);
+      input_.xy_estimated = false;
+    }
+
+  /* started in the acc control mode */
+  status_.xy_control_mode = ACC_CONTROL_MODE;
+  status_.prev_xy_control_mode = ACC_CONTROL_MODE;
+  input_.xy_estimated = true;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.xy_control_mode, ACC_CONTROL_MODE);
+
+  /* no fallback in the att control mode */
+  input_.force_att_control = true;
+  input_.xy_estimated = false;
+  status_.xy_control_mode = POS_CONTROL_MODE;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.xy_control_mode, POS_CONTROL_MODE);
+}
+
+TEST_F(FlightStateMachineTest, FullFlight)
+{
+  update(START_STATE);
+  status_.state = ARM_ON_STATE; // ack from spinal
+  update();
+  status_.state = TAKEOFF_STATE; // takeoff command
+  status_.convergent_start_time = now_;
+  for(int i = 0; i < 300 && status_.state == TAKEOFF_STATE; i++)
+    {
+      now_ += 0.01;
+      input_.delta_z = std::max(0.0, 1.0 - i * 0.01);
+      update();
+    }
+  EXPECT_EQ(status_.state, HOVER_STATE);
+
+  input_.low_voltage = true;
+  input_.delta_z = 0;
+  update();
+  EXPECT_EQ(status_.state, LAND_STATE);
+  for(int i = 0; i < 300 && status_.state == LAND_STATE; i++)
+    {
+      now_ += 0.01;
+      input_.delta_z = std::min(0.0, -1.0 + i * 0.01);
+      update();
+    }
+  EXPECT_EQ(status_.state, STOP_STATE);
+}
+
+TEST_F(FlightStateMachineTest, CustomState)
+{
+  /* e.g. a transformation state of a subclass navigator, between hover and land */
+  const uint8_t TRANSFORM_STATE = 16;
+  int transform_cnt = 0;
+  FlightTransition transform{"transform", FlightStateMachine::stateMask({TRANSFORM_STATE}),
+      [](const FlightInput& in, const FlightStatus&, double) { return std::fabs(in.delta_z) < 0.1; },
+      LAND_STATE,
+      [&transform_cnt](const FlightInput&, FlightStatus&, FlightActions&, double) { transform_cnt++; },
+      FLIGHT_LOG_INFO, "finish transformation"};
+  EXPECT_TRUE(machine_.insertTransition("stop", transform));
+  EXPECT_FALSE(machine_.insertTransition("unknown", machine_.getTransitions().front()));
+
+  input_.delta_z = 0.5;
+  update(TRANSFORM_STATE);
+  EXPECT_EQ(status_.state, TRANSFORM_STATE);
+
+  input_.delta_z = 0.0;
+  FlightActions actions = update();
+  EXPECT_EQ(status_.state, LAND_STATE);
+  EXPECT_EQ(transform_cnt, 1);
+
+  /* the landing transitions are located before, so evaluated from the next update */
+  EXPECT_FALSE(actions.has(LANDING_MODE_ACTION));
+  EXPECT_TRUE(update().has(LANDING_MODE_ACTION));
+
+  /* the default transition can be removed */
+  EXPECT_TRUE(machine_.removeTransition("low_battery_landing"));
+  EXPECT_FALSE(machine_.removeTransition("low_battery_landing"));
+  input_.low_voltage = true;
+  update(HOVER_STATE);
+  EXPECT_EQ(status_.state, HOVER_STATE);
+}
+
+TEST_F(FlightStateMachineTest, StateMask)
+{
+  EXPECT_EQ(FlightStateMachine::stateMask({}), 0u);
+  EXPECT_EQ(FlightStateMachine::stateMask({ARM_OFF_STATE}), 1u);
+  EXPECT_EQ(FlightStateMachine::stateMask({TAKEOFF_STATE, HOVER_STATE}), (1u << TAKEOFF_STATE) | (1u << HOVER_STATE));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,189 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2021, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_control/trajectory/polynomial_trajectory.h>
+#include <gtest/gtest.h>
+
+using namespace aerial_robot_navigation;
+
+namespace
+{
+  const double EPS = 1e-6;
+
+  TrajectoryState restState(const Eigen::Vector3d& pos)
+  {
+    TrajectoryState state;
+    state.pos = pos;
+    state.vel.setZero();
+    state.acc.setZero();
+    return state;
+  }
+
+  void expectNear(const Eigen::Vector3d& a, const Eigen::Vector3d& b, double eps)
+  {
+    for(int i = 0; i < 3; i++) EXPECT_NEAR(a(i), b(i), eps) << "axis " << i;
+  }
+
+  /* dense sampling: max |v| / v_max and max |a| / a_max over all axes */
+  void maxRatio(const PolynomialTrajectory& traj, const Eigen::Vector3d& max_vel, const Eigen::Vector3d& max_acc,
+                double& vel_ratio, double& acc_ratio)
+  {
+    vel_ratio = 0;
+    acc_ratio = 0;
+    for(double t = 0; t <= traj.getDuration(); t += 0.001)
+      {
+        TrajectoryState s = traj.sample(t);
+        vel_ratio = std::max(vel_ratio, (s.vel.cwiseAbs().array() / max_vel.array()).maxCoeff());
+        acc_ratio = std::max(acc_ratio, (s.acc.cwiseAbs().array() / max_acc.array()).maxCoeff());
+      }
+  }
+}
+
+TEST(PolynomialTrajectoryTest, MinJerkBoundary)
+{
+  PolynomialTrajectory traj;
+  TrajectoryState start;
+  start.pos = Eigen::Vector3d(0.1, -0.2, 1.0);
+  start.vel = Eigen::Vector3d(0.2, 0.1, -0.05);
+  start.acc = Eigen::Vector3d(0.1, -0.1, 0.0);
+  Eigen::Vector3d goal(1.5, 0.5, 1.2);
+
+  ASSERT_TRUE(traj.generate(start, {goal}));
+  ASSERT_EQ(traj.getSegmentDurations().size(), 1u);
+
+  TrajectoryState s = traj.sample(0);
+  expectNear(s.pos, start.pos, EPS);
+  expectNear(s.vel, start.vel, EPS);
+  expectNear(s.acc, start.acc, EPS);
+
+  s = traj.sample(traj.getDuration());
+  expectNear(s.pos, goal, EPS);
+  expectNear(s.vel, Eigen::Vector3d::Zero(), EPS);
+  expectNear(s.acc, Eigen::Vector3d::Zero(), EPS);
+
+  /* clamped after the end */
+  expectNear(traj.sample(traj.getDuration() + 1.0).pos, goal, EPS);
+}
+
+TEST(PolynomialTrajectoryTest, MinJerkRestToRest)
+{
+  PolynomialTrajectory traj;
+  ASSERT_TRUE(traj.generate(restState(Eigen::Vector3d::Zero()), {Eigen::Vector3d(2.0, 0, 0)}));
+
+  /* symmetric profile with the peak velocity 1.875 d / T at the middle */
+  double t = traj.getDuration();
+  TrajectoryState s = traj.sample(t / 2);
+  EXPECT_NEAR(s.pos.x(), 1.0, EPS);
+  EXPECT_NEAR(s.vel.x(), PolynomialTrajectory::MIN_JERK_VEL_RATIO * 2.0 / t, 1e-3);
+  EXPECT_NEAR(s.acc.x(), 0, EPS);
+  EXPECT_NEAR(traj.sample(t * 0.3).pos.x() + traj.sample(t * 0.7).pos.x(), 2.0, EPS);
+}
+
+TEST(PolynomialTrajectoryTest, MinSnapWaypoints)
+{
+  PolynomialTrajectory traj;
+  TrajectoryState start = restState(Eigen::Vector3d(0, 0, 1.0));
+  start.vel = Eigen::Vector3d(0.1, 0, 0);
+  std::vector<Eigen::Vector3d> waypoints = {Eigen::Vector3d(1.0, 0, 1.0), Eigen::Vector3d(1.0, 1.0, 1.5),
+                                            Eigen::Vector3d(0, 1.0, 1.0), Eigen::Vector3d(0, 0, 1.0)};
+  ASSERT_TRUE(traj.generate(start, waypoints));
+  ASSERT_EQ(traj.getSegmentDurations().size(), waypoints.size());
+
+  TrajectoryState s = traj.sample(0);
+  expectNear(s.pos, start.pos, EPS);
+  expectNear(s.vel, start.vel, EPS);
+  expectNear(s.acc, start.acc, EPS);
+
+  /* pass through the waypoints, continuous velocity and acceleration */
+  double t = 0;
+  for(size_t i = 0; i < waypoints.size() - 1; i++)
+    {
+      t += traj.getSegmentDurations().at(i);
+      expectNear(traj.sample(t).pos, waypoints.at(i), EPS);
+      TrajectoryState before = traj.sample(t - 1e-7);
+      TrajectoryState after = traj.sample(t + 1e-7);
+      expectNear(before.vel, after.vel, 1e-4);
+      expectNear(before.acc, after.acc, 1e-4);
+    }
+
+  s = traj.sample(traj.getDuration());
+  expectNear(s.pos, waypoints.back(), EPS);
+  expectNear(s.vel, Eigen::Vector3d::Zero(), EPS);
+  expectNear(s.acc, Eigen::Vector3d::Zero(), EPS);
+}
+
+TEST(PolynomialTrajectoryTest, LimitCompliance)
+{
+  Eigen::Vector3d max_vel(0.5, 0.5, 0.2);
+  Eigen::Vector3d max_acc(0.8, 0.8, 0.3);
+  PolynomialTrajectory traj;
+  traj.setLimits(max_vel, max_acc);
+
+  double vel_ratio, acc_ratio;
+
+  /* min-jerk */
+  ASSERT_TRUE(traj.generate(restState(Eigen::Vector3d(0, 0, 1.0)), {Eigen::Vector3d(3.0, -1.0, 2.0)}));
+  EXPECT_TRUE(traj.withinLimits());
+  maxRatio(traj, max_vel, max_acc, vel_ratio, acc_ratio);
+  EXPECT_LE(vel_ratio, 1.0 + 1e-3);
+  EXPECT_LE(acc_ratio, 1.0 + 1e-3);
+
+  /* min-snap, starting with the velocity within the limits */
+  TrajectoryState start = restState(Eigen::Vector3d(0, 0, 1.0));
+  start.vel = Eigen::Vector3d(-0.4, 0.3, 0.1);
+  ASSERT_TRUE(traj.generate(start, {Eigen::Vector3d(2.0, 0, 1.0), Eigen::Vector3d(2.0, 2.0, 1.5), Eigen::Vector3d(0, 2.0, 1.0)}));
+  EXPECT_TRUE(traj.withinLimits());
+  maxRatio(traj, max_vel, max_acc, vel_ratio, acc_ratio);
+  EXPECT_LE(vel_ratio, 1.0 + 1e-3);
+  EXPECT_LE(acc_ratio, 1.0 + 1e-3);
+}
+
+TEST(PolynomialTrajectoryTest, Invalid)
+{
+  PolynomialTrajectory traj;
+  EXPECT_FALSE(traj.generate(restState(Eigen::Vector3d::Zero()), {}));
+  EXPECT_TRUE(traj.empty());
+
+  /* no motion: the minimum duration */
+  ASSERT_TRUE(traj.generate(restState(Eigen::Vector3d(1, 1, 1)), {Eigen::Vector3d(1, 1, 1)}));
+  EXPECT_GT(traj.getDuration(), 0);
+  expectNear(traj.sample(0.5 * traj.getDuration()).pos, Eigen::Vector3d(1, 1, 1), EPS);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
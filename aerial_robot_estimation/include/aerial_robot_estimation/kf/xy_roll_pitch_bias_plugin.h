@@ -0,0 +1,522 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <kalman_filter/kf_pos_vel_acc_plugin.h>
+
+namespace kf_plugin
+{
+  /*
+    state_dim_ = 6 : p_x, v_x, p_y, v_y, b_roll, b_pitch
+    input_dim_ = 5 : a_xb, a_yb, a_zb, d_b_roll(0), d_b_pitch(0)
+    measure_dim_ = 2:  p_x + p_y or v_x + v_y
+
+    fixed-size filter:
+    predictionWithHistory() and correctionWithHistory() run the filter with the compile-time-sized matrices
+    (no heap allocation at the imu rate), and the covariance is corrected in the Joseph form.
+    prediction() and correction() of the base class give the same filter with the dynamic matrices.
+
+    out-of-sequence measurement:
+    the state and covariance after each predictionWithHistory() are kept in a fixed-capacity ring with the input and the params.
+    a delayed correctionWithHistory() is applied to the last entry not later than its timestamp, then the following entries
+    are predicted again with the stored inputs in one pass, together with the corrections already applied in that interval.
+    the replay is capped by the budget (number of the predictions): an older measurement is applied to the oldest entry within the budget,
+    and a measurement older than the ring (or than the last reset) is rejected. the size of the ring and the budget are given by the imu plugin (rosparam).
+    the ring is cleared when the state is reset (setInitState(), resetState(), or any change of the state outside these functions),
+    so that a delayed measurement never replays the entries before the reset.
+    the state and the ring are guarded by the mutex of the base class.
+    the filter is in the header, since the sensor plugins call it without linking this plugin library.
+  */
+  class KalmanFilterXYBias : public kf_plugin::KalmanFilter
+  {
+  public:
+    KalmanFilterXYBias(): KalmanFilter(),
+                          history_head_(0), history_count_(0), reset_timestamp_(-1), history_step_(0),
+                          measure_head_(0), measure_count_(0),
+                          replay_budget_(DEFAULT_REPLAY_BUDGET), last_replay_size_(0)
+    {
+      published_state_.setZero();
+      setHistorySize(DEFAULT_HISTORY_SIZE);
+    }
+    ~KalmanFilterXYBias() {}
+
+    static constexpr int STATE_DIM = 6;
+    static constexpr int INPUT_DIM = 5;
+    static constexpr int MEASURE_DIM = 2;
+    static constexpr int PARAM_SIZE = 7;
+    static constexpr int DEFAULT_HISTORY_SIZE = 200; // 1 [s] of the imu at 200 [Hz]
+    static constexpr int DEFAULT_REPLAY_BUDGET = 100;
+
+    typedef Matrix<double, STATE_DIM, 1> StateVector;
+    typedef Matrix<double, STATE_DIM, STATE_DIM> StateMatrix;
+    typedef Matrix<double, INPUT_DIM, 1> InputVector;
+    typedef Matrix<double, STATE_DIM, INPUT_DIM> ControlMatrix;
+    typedef Matrix<double, MEASURE_DIM, 1> MeasureVector;
+    typedef Matrix<double, MEASURE_DIM, STATE_DIM> ObservationMatrix;
+
+    void initialize(string name, int id);
+
+    /* be sure that the first parameter should be timestamp */
+    /* core */
+    /* params:
+       0: dt
+       1: roll
+       2: pitch
+       3: yaw
+       4: a_xb
+       5: a_yb
+       6: a_zb
+     */
+    void getPredictModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& state_transition_model, MatrixXd& control_input_model) const;
+
+    /* params: correct mode (POS, VEL) */
+    void getCorrectModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& observation_model) const;
+
+    /* fixed-size model, params: PARAM_SIZE values as getPredictModel() */
+    static void predictModel(const double* params, const StateVector& estimate_state, StateMatrix& state_transition_model, ControlMatrix& control_input_model)
+    {
+      float dt = params[0];
+
+      /* roll + b_roll */
+      double S_phy_b = sin(params[1] + estimate_state[4]);
+      double C_phy_b = cos(params[1] + estimate_state[4]);
+      /* pitch + b_pitch */
+      double S_theta_b = sin(params[2] + estimate_state[5]);
+      double C_theta_b = cos(params[2] + estimate_state[5]);
+      /* yaw */
+      double S_psi = sin(params[3]); double C_psi = cos(params[3]);
+
+      /* acc */
+      Vector3d acc; acc << params[4], params[5], params[6];
+
+      /* R && dR */
+      double R1 = C_psi * C_theta_b; /* R1 */
+      double R2 = C_psi * S_theta_b * S_phy_b - S_psi * C_phy_b; /* R2 */
+      double R3 = C_psi * S_theta_b * C_phy_b + S_psi * S_phy_b; /* R3 */
+      double R4 = S_psi * C_theta_b; /* R4 */
+      double R5 = S_psi * S_theta_b * S_phy_b + C_psi * C_phy_b; /* R5 */
+      double R6 = S_psi * S_theta_b * C_phy_b - C_psi * S_phy_b; /* R6 */
+
+      Vector3d dR123_dr;
+      dR123_dr <<
+        0, /* dR1_dbp */
+        C_psi * S_theta_b * C_phy_b - S_psi * (-S_phy_b), /* dR2_dbr */
+        C_psi * S_theta_b * (-S_phy_b) + S_psi * C_phy_b; /* dR3_dbr */
+
+      Vector3d dR123_dp;
+      dR123_dp <<
+        C_psi * (-S_theta_b), /* dR1_dbp */
+        C_psi * C_theta_b * S_phy_b, /* dR2_dbp */
+        C_psi * C_theta_b * C_phy_b; /* dR3_dbp */
+
+      Vector3d dR456_dr;
+      dR456_dr <<
+        0, /* dR4_dbr */
+        S_psi * S_theta_b * C_phy_b + C_psi * (-S_phy_b), /* dR5_dbr */
+        S_psi * S_theta_b * (-S_phy_b) - C_psi * C_phy_b; /* dR6_dbr */
+
+      Vector3d dR456_dp;
+      dR456_dp <<
+        S_psi * (-S_theta_b), /* dR4_dbp */
+        S_psi * C_theta_b * S_phy_b, /* dR5_dbp */
+        S_psi * C_theta_b * C_phy_b; /* dR6_dbp */
+
+      state_transition_model = StateMatrix::Identity();
+      state_transition_model(0,1) = dt;
+      state_transition_model(2,3) = dt;
+
+      state_transition_model(0,4) = 0.5 * dt * dt  * dR123_dr.dot(acc);
+      state_transition_model(0,5) = 0.5 * dt * dt  * dR123_dp.dot(acc);
+
+      state_transition_model(1,4) = dt  * dR123_dr.dot(acc);
+      state_transition_model(1,5) = dt  * dR123_dp.dot(acc);
+
+      state_transition_model(2,4) = 0.5 * dt * dt  * dR456_dr.dot(acc);
+      state_transition_model(2,5) = 0.5 * dt * dt  * dR456_dp.dot(acc);
+
+      state_transition_model(3,4) = dt  * dR456_dr.dot(acc);
+      state_transition_model(3,5) = dt  * dR456_dp.dot(acc);
+
+      control_input_model = ControlMatrix::Zero();
+      control_input_model(0, 0) = 0.5 * dt * dt  * R1;
+      control_input_model(0, 1) = 0.5 * dt * dt  * R2;
+      control_input_model(0, 2) = 0.5 * dt * dt  * R3;
+      control_input_model(1, 0) = dt  * R1;
+      control_input_model(1, 1) = dt  * R2;
+      control_input_model(1, 2) = dt  * R3;
+
+      control_input_model(2, 0) = 0.5 * dt * dt  * R4;
+      control_input_model(2, 1) = 0.5 * dt * dt  * R5;
+      control_input_model(2, 2) = 0.5 * dt * dt  * R6;
+      control_input_model(3, 0) = dt  * R4;
+      control_input_model(3, 1) = dt  * R5;
+      control_input_model(3, 2) = dt  * R6;
+
+      control_input_model(4, 3) = 1;
+      control_input_model(5, 4) = 1;
+    }
+
+    static bool correctModel(int mode, ObservationMatrix& observation_model)
+    {
+      observation_model.setZero();
+      switch(mode)
+        {
+        case POS:
+          {
+            observation_model(0, 0) = 1;
+            observation_model(1, 2) = 1;
+            return true;
+          }
+        case VEL:
+          {
+            observation_model(0, 1) = 1;
+            observation_model(1, 3) = 1;
+            return true;
+          }
+        default:
+          {
+            return false;
+          }
+        }
+    }
+
+    /* the ring is cleared */
+    void setHistorySize(int size)
+    {
+      boost::lock_guard<boost::mutex> lock(kf_mutex_);
+      history_.assign(std::max(size, 1), HistoryEntry());
+      measures_.assign(std::max(size, 1), MeasureEntry());
+      replay_order_.clear();
+      replay_order_.reserve(measures_.size());
+      resetHistory();
+    }
+    void clearHistory()
+    {
+      boost::lock_guard<boost::mutex> lock(kf_mutex_);
+      resetHistory();
+    }
+    void setReplayBudget(int budget)
+    {
+      boost::lock_guard<boost::mutex> lock(kf_mutex_);
+      replay_budget_ = std::max(budget, 0);
+    }
+
+    /* the history before the reset is not replayed */
+    void setInitState(double state_value, int no)
+    {
+      KalmanFilter::setInitState(state_value, no);
+      clearHistory();
+    }
+    void setInitState(const VectorXd& state)
+    {
+      KalmanFilter::setInitState(state);
+      clearHistory();
+    }
+    void resetState()
+    {
+      KalmanFilter::resetState();
+      clearHistory();
+    }
+
+    int getHistoryCount() const { return history_count_; }
+    /* number of the predictions replayed by the last correctionWithHistory() */
+    int getLastReplaySize() const { return last_replay_size_; }
+
+    bool predictionWithHistory(const VectorXd& input, double timestamp, const vector<double>& params)
+    {
+      if(!getFilteringFlag()) return false;
+      assert(input.size() == INPUT_DIM && params.size() == PARAM_SIZE);
+
+      boost::lock_guard<boost::mutex> lock(kf_mutex_);
+      checkExternalReset();
+      state_ = estimate_state_;
+      covariance_ = estimate_covariance_;
+      predict(input, params.data());
+
+      if(history_count_ == (int)history_.size())
+        {
+          history_head_ = (history_head_ + 1) % history_.size();
+          history_count_--;
+        }
+      HistoryEntry& entry = history(history_count_++);
+      entry.step = history_step_++;
+      entry.timestamp = timestamp;
+      entry.input = input;
+      std::copy(params.begin(), params.end(), entry.params);
+      save(entry);
+      publish();
+      return true;
+    }
+
+    /* timestamp < 0: no delay */
+    bool correctionWithHistory(const VectorXd& measurement, const VectorXd& measure_sigma, double timestamp, const vector<double>& params, double outlier_thresh = 0)
+    {
+      if(!getFilteringFlag()) return false;
+      if(measurement.size() != MEASURE_DIM || measure_sigma.size() != MEASURE_DIM || params.size() != 1 || (params[0] != POS && params[0] != VEL))
+        {
+          ROS_ERROR("xy bias ekf: wrong measurement");
+          return false;
+        }
+
+      boost::lock_guard<boost::mutex> lock(kf_mutex_);
+      checkExternalReset();
+      last_replay_size_ = 0;
+      int mode = params[0];
+
+      /* taken before the reset */
+      if(timestamp >= 0 && timestamp <= reset_timestamp_)
+        {
+          ROS_WARN_THROTTLE(1.0, "xy bias ekf: the measurement is taken before the reset of the state");
+          return false;
+        }
+
+      /* in sequence */
+      if(timestamp < 0 || history_count_ == 0 || timestamp >= history(history_count_ - 1).timestamp)
+        {
+          state_ = estimate_state_;
+          covariance_ = estimate_covariance_;
+          correct(measurement, measure_sigma, mode, outlier_thresh);
+          if(history_count_ > 0)
+            {
+              pushMeasure(history(history_count_ - 1).step, measurement, measure_sigma, mode, outlier_thresh);
+              save(history(history_count_ - 1));
+            }
+          publish();
+          return true;
+        }
+
+      /* the last entry not later than the measurement */
+      int start = history_count_ - 1;
+      while(start >= 0 && history(start).timestamp > timestamp) start--;
+      if(start < 0)
+        {
+          ROS_WARN_THROTTLE(1.0, "xy bias ekf: the measurement is older than the history by %f [s]", history(0).timestamp - timestamp);
+          return false;
+        }
+      if(history_count_ - 1 - start > replay_budget_) start = history_count_ - 1 - replay_budget_;
+
+      HistoryEntry& start_entry = history(start);
+      state_ = start_entry.state;
+      covariance_ = start_entry.covariance;
+      correct(measurement, measure_sigma, mode, outlier_thresh);
+      pushMeasure(start_entry.step, measurement, measure_sigma, mode, outlier_thresh);
+      save(start_entry);
+
+      /* the corrections after the start entry, in the order of the predictions */
+      replay_order_.clear();
+      for(int i = 0; i < measure_count_; i++)
+        if(measure(i).step > start_entry.step) replay_order_.push_back(i);
+      std::stable_sort(replay_order_.begin(), replay_order_.end(),
+                       [this](int a, int b) { return measure(a).step < measure(b).step; });
+
+      auto next_measure = replay_order_.begin();
+      for(int i = start + 1; i < history_count_; i++)
+        {
+          HistoryEntry& entry = history(i);
+          predict(entry.input, entry.params);
+
+          for(; next_measure != replay_order_.end() && measure(*next_measure).step == entry.step; next_measure++)
+            {
+              const MeasureEntry& m = measure(*next_measure);
+              correct(m.measurement, m.sigma, m.mode, m.outlier_thresh);
+            }
+          save(entry);
+        }
+      last_replay_size_ = history_count_ - 1 - start;
+      publish();
+      return true;
+    }
+
+  private:
+    struct HistoryEntry
+    {
+      int64_t step;
+      double timestamp;
+      InputVector input;
+      double params[PARAM_SIZE];
+      StateVector state; // after the prediction and the corrections of this step
+      StateMatrix covariance;
+    };
+
+    struct MeasureEntry
+    {
+      int64_t step; // of the entry where the correction is applied
+      MeasureVector measurement;
+      MeasureVector sigma;
+      int mode;
+      double outlier_thresh;
+    };
+
+    std::vector<HistoryEntry, aligned_allocator<HistoryEntry> > history_;
+    int history_head_, history_count_;
+    double reset_timestamp_; // of the last prediction before the reset
+    int64_t history_step_;
+    std::vector<MeasureEntry, aligned_allocator<MeasureEntry> > measures_;
+    int measure_head_, measure_count_;
+    int replay_budget_, last_replay_size_;
+    std::vector<int> replay_order_; // preallocated
+
+    /* working state of the fixed-size filter */
+    StateVector state_;
+    StateMatrix covariance_;
+    StateVector published_state_; // the last estimate_state_ given by this filter
+
+    /* index from the oldest */
+    HistoryEntry& history(int index) { return history_[(history_head_ + index) % history_.size()]; }
+    const MeasureEntry& measure(int index) const { return measures_[(measure_head_ + index) % measures_.size()]; }
+
+    void predict(const InputVector& input, const double* params)
+    {
+      StateMatrix state_transition_model;
+      ControlMatrix control_input_model;
+      predictModel(params, state_, state_transition_model, control_input_model);
+
+      /* the input noise is diagonal */
+      InputVector input_noise_variance = input_sigma_.cwiseProduct(input_sigma_);
+      state_ = state_transition_model * state_ + control_input_model * input;
+      covariance_ = state_transition_model * covariance_ * state_transition_model.transpose()
+        + control_input_model * input_noise_variance.asDiagonal() * control_input_model.transpose();
+    }
+
+    /* outlier_thresh > 0: reject by the squared mahalanobis distance of the innovation */
+    bool correct(const MeasureVector& measurement, const MeasureVector& measure_sigma, int mode, double outlier_thresh)
+    {
+      ObservationMatrix observation_model;
+      correctModel(mode, observation_model);
+
+      Matrix<double, MEASURE_DIM, MEASURE_DIM> measurement_noise = measure_sigma.cwiseProduct(measure_sigma).asDiagonal();
+      Matrix<double, MEASURE_DIM, MEASURE_DIM> inverse_innovation_covariance =
+        (observation_model * covariance_ * observation_model.transpose() + measurement_noise).inverse();
+      MeasureVector innovation = measurement - observation_model * state_;
+      if(outlier_thresh > 0 && innovation.dot(inverse_innovation_covariance * innovation) > outlier_thresh) return false;
+
+      Matrix<double, STATE_DIM, MEASURE_DIM> kalman_gain = covariance_ * observation_model.transpose() * inverse_innovation_covariance;
+      state_ += kalman_gain * innovation;
+
+      /* Joseph form: symmetric and positive semi-definite against the rounding */
+      StateMatrix i_kh = StateMatrix::Identity() - kalman_gain * observation_model;
+      covariance_ = i_kh * covariance_ * i_kh.transpose() + kalman_gain * measurement_noise * kalman_gain.transpose();
+      return true;
+    }
+
+    void save(HistoryEntry& entry)
+    {
+      entry.state = state_;
+      entry.covariance = covariance_;
+    }
+
+    /* the working state to the base class */
+    void publish()
+    {
+      estimate_state_ = state_;
+      estimate_covariance_ = covariance_;
+      published_state_ = state_;
+    }
+
+    /* with kf_mutex_ */
+    void resetHistory()
+    {
+      if(history_count_ > 0) reset_timestamp_ = history(history_count_ - 1).timestamp;
+      history_head_ = 0; history_count_ = 0;
+      measure_head_ = 0; measure_count_ = 0;
+    }
+
+    /* the state is changed through the base class (e.g. setInitState() by the pointer of KalmanFilter), with kf_mutex_ */
+    void checkExternalReset()
+    {
+      if(history_count_ == 0) return;
+      if(estimate_state_.size() == STATE_DIM && StateVector(estimate_state_) == published_state_) return;
+      resetHistory();
+    }
+
+    void pushMeasure(int64_t step, const MeasureVector& measurement, const MeasureVector& measure_sigma, int mode, double outlier_thresh)
+    {
+      if(measure_count_ == (int)measures_.size())
+        {
+          measure_head_ = (measure_head_ + 1) % measures_.size();
+          measure_count_--;
+        }
+      MeasureEntry& entry = measures_[(measure_head_ + measure_count_++) % measures_.size()];
+      entry.step = step;
+      entry.measurement = measurement;
+      entry.sigma = measure_sigma;
+      entry.mode = mode;
+      entry.outlier_thresh = outlier_thresh;
+    }
+
+    /*
+    //dynamic reconfigure
+    dynamic_reconfigure::Server<aerial_robot_base::KalmanFilterXYBiasConfig>* server_;
+    dynamic_reconfigure::Server<aerial_robot_base::KalmanFilterXYBiasConfig>::CallbackType dynamic_reconf_func_;
+    void cfgCallback(aerial_robot_base::KalmanFilterXYBiasConfig &config, uint32_t level)
+    {
+      if(config.kalman_filter_flag == true)
+        {
+          printf("cfg update, node: %s ", (nhp_.getNamespace()).c_str());
+
+          switch(level)
+            {
+            case 1:  // INPUT_SIGMA_ACC = 1
+              input_sigma_(0) = config.acc_sigma;
+              input_sigma_(1) = config.acc_sigma;
+              input_sigma_(2) = config.acc_sigma;
+              setPredictionNoiseCovariance();
+              printf("change the input(acc) sigma\n");
+              break;
+            case 2:  // BIAS_SIGMA_ACC = 1
+              input_sigma_(3) = config.bias_sigma;
+              input_sigma_(4) = config.bias_sigma;
+              setPredictionNoiseCovariance();
+              printf("change the input(roll pitch bais) sigma\n");
+              break;
+            case 3:  // MEASURE_SIGMA = 3
+              measure_sigma_(0)  = config.measure_sigma;
+              measure_sigma_(1)  = config.measure_sigma;
+              setMeasurementNoiseCovariance();
+              printf("change the measure sigma\n");
+              break;
+            default :
+              printf("\n");
+              break;
+            }
+        }
+    }
+    */
+  };
+};
@@ -0,0 +1,80 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <kalman_filter/kf_base_plugin.h>
+
+namespace kf_plugin
+{
+  /*
+    coupled x, y, z filter driven by the body frame acceleration:
+    state_dim_ = 9 : p_x, v_x, p_y, v_y, p_z, v_z, b_x, b_y, b_z (acc bias in world frame)
+    input_dim_ = 6 : a_xb, a_yb, a_zb (gravity removed), d_b_x(0), d_b_y(0), d_b_z(0)
+    the input noise of body frame is rotated to world frame by the control input model,
+    so the cross-axis correlation of the world frame acceleration is kept.
+  */
+  class KalmanFilterXYZPosVelAcc : public kf_plugin::KalmanFilter
+  {
+  public:
+    KalmanFilterXYZPosVelAcc(): KalmanFilter() {}
+    ~KalmanFilterXYZPosVelAcc() {}
+
+    static constexpr int STATE_DIM = 9;
+    static constexpr int INPUT_DIM = 6;
+
+    /* state index of each axis (0: x, 1: y, 2: z) */
+    static inline int posIndex(int axis) { return 2 * axis; }
+    static inline int velIndex(int axis) { return 2 * axis + 1; }
+    static inline int biasIndex(int axis) { return 6 + axis; }
+
+    void initialize(string name, int id);
+
+    /* params:
+       0: dt
+       1: roll
+       2: pitch
+       3: yaw
+    */
+    void getPredictModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& state_transition_model, MatrixXd& control_input_model) const;
+
+    /* params:
+       0: correct mode (POS, VEL, POS_VEL)
+       1: measured axes, bit0: x, bit1: y, bit2: z (default: all)
+       measurement order: positions of the measured axes, then velocities
+    */
+    void getCorrectModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& observation_model) const;
+  };
+};
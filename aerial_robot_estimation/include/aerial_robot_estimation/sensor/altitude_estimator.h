@@ -0,0 +1,149 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Core>
+#include <cmath>
+
+namespace aerial_robot_estimation
+{
+  /* vertical estimate with the terrain under the range sensor and the barometer bias:
+     state: [z, vz, terrain, baro_bias], z is the height of the baselink in the world frame
+     prediction: vertical acc in the world frame without gravity (imu)
+     range: range = z - terrain (vertical distance from the baselink to the ground)
+     baro:  baro = z - baro_bias
+
+     a range inconsistent with the estimate is either an outlier (spike, edge of a table, multipath of sonar)
+     or a step of the terrain. two hypotheses are kept during the check: the current one which rejects the range,
+     and the step one whose terrain is re-anchored to the range. the climb of the vehicle is explained by the imu
+     and the barometer in both of them, so only the terrain change makes the step hypothesis more likely.
+     the likelihood ratio (with a uniform outlier floor) decides the hypothesis: the outlier is decided at once,
+     the step only after min_check_time, and the more likely one is taken after max_check_time.
+     after no valid range for dropout_time (out of range or no sample), the terrain is re-anchored to the first range. */
+  class AltitudeEstimator
+  {
+  public:
+    enum Index {Z = 0, VZ = 1, TERRAIN = 2, BARO_BIAS = 3};
+    enum RangeState {RANGE_NONE = 0, RANGE_NORMAL = 1, RANGE_CHECK = 2, RANGE_LOST = 3};
+
+    typedef Eigen::Matrix<double, 4, 1> StateVector;
+    typedef Eigen::Matrix<double, 4, 4> StateMatrix;
+
+    struct Result
+    {
+      bool valid; // consistent with the estimate, to be fused
+      double height; // z measured by the sensor: range + terrain or baro + baro_bias
+      double sigma;
+      double nis; // normalized innovation squared, negative if not checked
+      bool terrain_step; // a step of the terrain is accepted by this range
+    };
+
+    /* chi-square at 99.9% for 1 dof */
+    static constexpr double CHI2_GATE_1D = 10.828;
+
+    AltitudeEstimator();
+
+    void setRangeNoise(double sigma); // [m]
+    void setBaroNoise(double sigma, double bias_sigma); // [m], [m/sqrt(s)]
+    void setAccNoise(double sigma); // [m/s^2]
+    void setTerrainNoise(double sigma); // [m/sqrt(s)], slow slope of the ground
+    void setRangeLimits(double min_range, double max_range);
+    /* min_residual: the residual below it is always consistent [m], ratio: of the likelihoods to decide the hypothesis */
+    void setTerrainCheck(bool enable, double min_residual, double min_check_time, double max_check_time, double ratio);
+    void setDropoutTime(double dropout_time);
+
+    /* start with the height and the terrain, the baro bias is anchored by the next baro */
+    void reset(double z, double terrain, double stamp);
+    /* the bookkeeping of sensor_plugin::Alt: z = range + height_offset, so the height offset is the terrain */
+    void resetFromRange(double range, double height_offset, double stamp) { reset(range + height_offset, height_offset, stamp); }
+    void resetBaro() { baro_initialized_ = false; }
+    bool initialized() const { return initialized_; }
+
+    void predict(double acc, double stamp);
+    Result updateRange(double range, double stamp);
+    Result updateBaro(double baro, double stamp);
+
+    const StateVector& getState() const { return current_.x; }
+    const StateMatrix& getCovariance() const { return current_.p; }
+    double getHeight() const { return current_.x(Z); }
+    double getVelocity() const { return current_.x(VZ); }
+    double getTerrainHeight() const { return current_.x(TERRAIN); }
+    double getHeightOffset() const { return current_.x(TERRAIN); }
+    double rangeToHeight(double range) const { return range + getHeightOffset(); }
+    double getBaroBias() const { return current_.x(BARO_BIAS); }
+
+    RangeState getRangeState() const { return range_state_; }
+    bool rangeAvailable() const { return range_state_ == RANGE_NORMAL; }
+    double getLikelihoodRatio() const { return log_ratio_; } // log(step / current) during the check
+    int getStepCount() const { return step_count_; }
+    int getOutlierCount() const { return outlier_count_; }
+    int getBaroRejectCount() const { return baro_reject_count_; }
+
+  private:
+    struct Hypothesis
+    {
+      StateVector x;
+      StateMatrix p;
+
+      void predict(double acc, double dt, const StateMatrix& q_rate, double acc_var);
+      /* scalar measurement h * x, joseph form */
+      void innovation(const StateVector& h, double meas, double var, double& y, double& s) const;
+      void correct(const StateVector& h, double y, double s, double var);
+      /* the terrain (or the baro bias) is set as z - meas: the covariance follows z */
+      void anchor(int index, double meas, double var);
+    };
+
+    double range_var_, baro_var_, baro_bias_var_, acc_var_, terrain_var_;
+    double min_range_, max_range_;
+    bool terrain_check_;
+    double min_residual_, min_check_time_, max_check_time_, log_decide_ratio_;
+    double dropout_time_;
+
+    bool initialized_, baro_initialized_;
+    double stamp_, range_stamp_;
+    Hypothesis current_, step_;
+    RangeState range_state_;
+    double check_start_, log_ratio_;
+
+    /* statistics */
+    int step_count_, outlier_count_, baro_reject_count_;
+
+    StateMatrix processRate() const;
+    bool consistent(double y, double s) const { return y * y <= CHI2_GATE_1D * s || fabs(y) <= min_residual_; }
+    double logLikelihood(double y, double s) const;
+  };
+
+} //namespace aerial_robot_estimation
@@ -35,6 +35,7 @@
 
 #pragma once
 
+#include <aerial_robot_estimation/sensor/extrinsic_calibrator.h>
 #include <aerial_robot_estimation/state_estimation.h>
 #include <aerial_robot_msgs/States.h>
 #include <Eigen/Core>
@@ -46,6 +47,7 @@
 #include <std_srvs/Empty.h>
 #include <std_srvs/SetBool.h>
 #include <tf/LinearMath/Transform.h>
+#include <tf_conversions/tf_eigen.h>
 #include <tf_conversions/tf_kdl.h>
 
 using namespace Eigen;
@@ -61,7 +63,7 @@ namespace sensor_plugin
   class SensorBase
   {
   public:
-    SensorBase(): sensor_hz_(0), get_sensor_tf_(false)
+    SensorBase(): sensor_hz_(0), get_sensor_tf_(false), extrinsic_initialized_(false), extrinsic_applied_(false)
     {
       sensor_tf_.setIdentity();
       sensor_status_ = Status::INACTIVE;
@@ -104,6 +106,33 @@ namespace sensor_plugin
       getParam<bool>("time_sync", time_sync_, false);
       getParam<double>("delay", delay_, 0.0);
 
+      /* online calibration of the extrinsic against the imu */
+      getParam<bool>("extrinsic_calibration", extrinsic_calibration_, false);
+      if(extrinsic_calibration_ && variable_sensor_tf_flag_)
+        {
+          /* the joint or servo system changes the extrinsic, which is reloaded from the kinematics every time */
+          ROS_WARN("%s: no extrinsic calibration for the variable sensor tf", indexed_nhp_.getNamespace().c_str());
+          extrinsic_calibration_ = false;
+        }
+      if(extrinsic_calibration_)
+        {
+          double min_rotation, max_interval, rotation_sigma, translation_sigma;
+          int max_pairs, min_pairs;
+          getParam<int>("extrinsic_reference_mode", extrinsic_reference_mode_, -1); // estimate mode for the baselink position, -1: rotation only
+          getParam<double>("extrinsic_min_rotation", min_rotation, 0.2); // [rad]
+          getParam<double>("extrinsic_max_interval", max_interval, 1.0); // [s]
+          getParam<int>("extrinsic_max_pairs", max_pairs, 1000);
+          getParam<double>("extrinsic_rotation_sigma", rotation_sigma, 0.005); // [rad], for the convergence
+          getParam<double>("extrinsic_translation_sigma", translation_sigma, 0.005); // [m], for the convergence
+          getParam<int>("extrinsic_min_pairs", min_pairs, 20);
+          getParam<bool>("apply_extrinsic_calibration", apply_extrinsic_calibration_, false);
+
+          extrinsic_calibrator_.setPairThreshold(min_rotation, max_interval);
+          extrinsic_calibrator_.setMaxPairs(max_pairs);
+          extrinsic_calibrator_.setConvergence(rotation_sigma, translation_sigma, min_pairs);
+          extrinsic_calibrator_.setEstimateTranslation(extrinsic_reference_mode_ >= 0);
+        }
+
       health_check_timer_ = indexed_nhp_.createTimer(ros::Duration(1.0 / health_check_rate_), &SensorBase::healthCheck,this);
     }
 
@@ -176,6 +205,13 @@ namespace sensor_plugin
     /* the transformation between sensor frame and baselink frame */
     tf::Transform sensor_tf_;
 
+    /* online calibration of sensor_tf_ */
+    bool extrinsic_calibration_;
+    bool apply_extrinsic_calibration_;
+    bool extrinsic_initialized_, extrinsic_applied_;
+    int extrinsic_reference_mode_;
+    aerial_robot_estimation::ExtrinsicCalibrator extrinsic_calibrator_;
+
     /* status */
     int sensor_status_;
     int prev_status_;
@@ -300,6 +336,71 @@ namespace sensor_plugin
       return true;
     }
 
+    /* sensor_pose: the sensor frame in its own world at the stamp.
+       the baselink attitude at the stamp is from the queue of the imu, and the baselink position (if used) is
+       from the reference estimate mode. true if the calibrated value is applied to sensor_tf_ in this call */
+    bool extrinsicCalibrationProcess(double stamp, const tf::Transform& sensor_pose)
+    {
+      if(!extrinsic_calibration_ || extrinsic_applied_) return false;
+
+      /* the nominal value (e.g. urdf) */
+      if(!extrinsic_initialized_)
+        {
+          Eigen::Quaterniond q; Eigen::Vector3d t;
+          tf::quaternionTFToEigen(sensor_tf_.getRotation(), q);
+          tf::vectorTFToEigen(sensor_tf_.getOrigin(), t);
+          extrinsic_calibrator_.setInitialValue(q, t);
+          extrinsic_initialized_ = true;
+        }
+
+      tf::Matrix3x3 body_r; tf::Vector3 body_omega;
+      if(!estimator_->findRotOmega(stamp, aerial_robot_estimation::EGOMOTION_ESTIMATE, body_r, body_omega, false)) return false;
+
+      /* the position at the stamp of the sensor */
+      tf::Vector3 body_pos(0, 0, 0);
+      if(extrinsic_reference_mode_ >= 0 && !estimator_->findPos(stamp, extrinsic_reference_mode_, body_pos, false)) return false;
+
+      tf::Quaternion body_q; body_r.getRotation(body_q);
+      Eigen::Quaterniond eigen_body_q, sensor_q;
+      Eigen::Vector3d eigen_body_pos, sensor_pos;
+      tf::quaternionTFToEigen(body_q, eigen_body_q);
+      tf::vectorTFToEigen(body_pos, eigen_body_pos);
+      tf::quaternionTFToEigen(sensor_pose.getRotation(), sensor_q);
+      tf::vectorTFToEigen(sensor_pose.getOrigin(), sensor_pos);
+
+      if(!extrinsic_calibrator_.add(stamp, eigen_body_q, eigen_body_pos, sensor_q, sensor_pos)) return false;
+      if(!extrinsic_calibrator_.solve()) return false;
+
+      tf::Transform calibrated_tf;
+      tf::Quaternion calibrated_q;
+      tf::Vector3 calibrated_pos;
+      tf::quaternionEigenToTF(extrinsic_calibrator_.getRotation(), calibrated_q);
+      tf::vectorEigenToTF(extrinsic_calibrator_.getTranslation(), calibrated_pos);
+      calibrated_tf.setRotation(calibrated_q);
+      calibrated_tf.setOrigin(calibrated_pos);
+
+      double r, p, y; calibrated_tf.getBasis().getRPY(r, p, y);
+      const Eigen::Vector3d& rot_sigma = extrinsic_calibrator_.getRotationSigma();
+      const Eigen::Vector3d& trans_sigma = extrinsic_calibrator_.getTranslationSigma();
+      ROS_INFO_THROTTLE(5.0, "%s: extrinsic calibration, pairs: %d/%d, [%f, %f, %f] +- [%f, %f, %f], [%f, %f, %f] +- [%f, %f, %f]%s",
+                        indexed_nhp_.getNamespace().c_str(),
+                        extrinsic_calibrator_.getInlierCount(), extrinsic_calibrator_.getPairCount(),
+                        calibrated_pos.x(), calibrated_pos.y(), calibrated_pos.z(), trans_sigma(0), trans_sigma(1), trans_sigma(2),
+                        r, p, y, rot_sigma(0), rot_sigma(1), rot_sigma(2),
+                        extrinsic_calibrator_.converged() ? ", converged" : "");
+
+      if(!apply_extrinsic_calibration_ || !extrinsic_calibrator_.converged()) return false;
+
+      if(!extrinsic_calibrator_.getEstimateTranslation()) calibrated_tf.setOrigin(sensor_tf_.getOrigin());
+      sensor_tf_ = calibrated_tf;
+      extrinsic_applied_ = true;
+      ROS_WARN("%s: apply the calibrated tf from %s to %s, [%f, %f, %f], [%f, %f, %f]",
+               indexed_nhp_.getNamespace().c_str(),
+               robot_model_->getBaselinkName().c_str(), sensor_frame_.c_str(),
+               sensor_tf_.getOrigin().x(), sensor_tf_.getOrigin().y(), sensor_tf_.getOrigin().z(), r, p, y);
+      return true;
+    }
+
     template<class T> void getParam(std::string param_name, T& param, T default_value)
     {
       nhp_.param<T>(param_name, param, default_value);
@@ -0,0 +1,125 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <deque>
+
+namespace aerial_robot_estimation
+{
+  /* online calibration of the extrinsic (baselink -> sensor frame) of a pose sensor (e.g. vo, mocap) against the imu:
+     the relative motions of the baselink A (attitude of the imu, and the position if available) and of the sensor B
+     between two timestamp-aligned samples give A X = X B, X is the extrinsic (hand-eye calibration).
+     rotation: alpha = R_X beta with the rotation vectors of A and B, solved by the svd of sum(beta alpha^T).
+     translation: (R_A - I) t_X = R_X t_B - t_A, solved by the normal equation.
+     a motion pair is made when the baselink rotates more than min_rotation (excitation), or after max_interval (hover).
+     the pairs far from the median residual are rejected. the confidence is the 1 sigma of the estimate by the
+     residual and the information of the pairs, which is infinite about the axis without the rotation. */
+  class ExtrinsicCalibrator
+  {
+  public:
+    ExtrinsicCalibrator();
+
+    void setPairThreshold(double min_rotation, double max_interval); // [rad], [s]
+    void setMaxPairs(int size);
+    void setEstimateTranslation(bool flag);
+    void setConvergence(double rotation_sigma, double translation_sigma, int min_pairs); // [rad], [m]
+    /* nominal extrinsic (e.g. urdf), which is the result until the first solution */
+    void setInitialValue(const Eigen::Quaterniond& q, const Eigen::Vector3d& t);
+
+    void reset();
+    /* body: baselink in the world by the imu, the position is used only with the translation estimate.
+       sensor: sensor frame in its own world, at the same stamp as the body. true if a new motion pair is made */
+    bool add(double stamp, const Eigen::Quaterniond& body_q, const Eigen::Vector3d& body_p,
+             const Eigen::Quaterniond& sensor_q, const Eigen::Vector3d& sensor_p);
+    /* false if not enough pairs */
+    bool solve();
+
+    const Eigen::Quaterniond& getRotation() const { return q_; } // baselink -> sensor
+    const Eigen::Vector3d& getTranslation() const { return t_; } // sensor origin in baselink
+    const Eigen::Vector3d& getRotationSigma() const { return rotation_sigma_; } // [rad], about the baselink axes
+    const Eigen::Vector3d& getTranslationSigma() const { return translation_sigma_; } // [m]
+    double getRotationResidual() const { return rotation_residual_; } // rms of the inliers [rad]
+    double getTranslationResidual() const { return translation_residual_; } // rms of the inliers [m]
+    int getPairCount() const { return pairs_.size(); }
+    int getInlierCount() const { return inlier_count_; }
+    bool getEstimateTranslation() const { return estimate_translation_; }
+    bool converged() const;
+
+  private:
+    struct MotionPair
+    {
+      Eigen::Vector3d alpha, beta; // rotation vector of the baselink and the sensor
+      Eigen::Matrix3d rot_a;
+      Eigen::Vector3d trans_a, trans_b;
+      bool inlier;
+    };
+
+    struct Sample
+    {
+      double stamp;
+      Eigen::Quaterniond body_q, sensor_q;
+      Eigen::Vector3d body_p, sensor_p;
+    };
+
+    static constexpr double OUTLIER_RATIO = 4.0; // of the median residual
+    static constexpr double ROTATION_RESIDUAL_FLOOR = 0.005; // [rad]
+    static constexpr double TRANSLATION_RESIDUAL_FLOOR = 0.005; // [m]
+    static constexpr double PRIOR_WEIGHT = 1e-3; // of the initial value in the rotation, for the axis without the rotation
+
+    double min_rotation_, max_interval_;
+    size_t max_pairs_;
+    bool estimate_translation_;
+    double convergence_rotation_sigma_, convergence_translation_sigma_;
+    int min_pairs_;
+
+    bool has_key_;
+    Sample key_; // start of the next pair
+    std::deque<MotionPair> pairs_;
+
+    Eigen::Quaterniond initial_q_, q_;
+    Eigen::Vector3d initial_t_, t_;
+    Eigen::Vector3d rotation_sigma_, translation_sigma_;
+    double rotation_residual_, translation_residual_;
+    int inlier_count_;
+
+    Eigen::Matrix3d solveRotation() const;
+    /* 1 sigma of each axis of the estimate with the information matrix, infinite if not observable */
+    static Eigen::Vector3d sigma(const Eigen::Matrix3d& information, double variance);
+  };
+
+} //namespace aerial_robot_estimation
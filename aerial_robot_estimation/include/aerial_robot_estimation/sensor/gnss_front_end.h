@@ -0,0 +1,163 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Core>
+
+namespace aerial_robot_estimation
+{
+  /* one gnss fix normalized from spinal::Gps(Full), sensor_msgs::NavSatFix and the rtk pose */
+  struct GnssFix
+  {
+    enum Source {SPINAL = 0, NAV_SAT_FIX = 1, RTK_POSE = 2};
+
+    GnssFix(): source(SPINAL), stamp(0), fix(false), sat_num(0),
+               has_geodetic(false), latitude(0), longitude(0), altitude(0),
+               has_local_position(false), local_position(Eigen::Vector3d::Zero()),
+               has_velocity(false), velocity(Eigen::Vector3d::Zero()),
+               pos_sigma(0), vel_sigma(0) {}
+
+    Source source;
+    double stamp; // [s]
+    bool fix; // receiver fix status
+    int sat_num;
+
+    /* wgs84: [deg], [m] */
+    bool has_geodetic;
+    double latitude, longitude, altitude;
+
+    /* position already in the local frame (rtk pose) */
+    bool has_local_position;
+    Eigen::Vector3d local_position;
+
+    /* east, north, up with the geodetic position, otherwise in the local frame */
+    bool has_velocity;
+    Eigen::Vector3d velocity;
+
+    /* accuracy from the receiver: [m], [m/s], 0: unknown */
+    double pos_sigma, vel_sigma;
+  };
+
+  /* east-north-up plane tangent to the wgs84 ellipsoid at the origin:
+     the rotation from ecef and the ecef origin are cached, so the conversion is exact without the utm projection */
+  class LocalTangentPlane
+  {
+  public:
+    LocalTangentPlane(): initialized_(false) {}
+
+    void setOrigin(double latitude, double longitude, double altitude = 0);
+    bool initialized() const { return initialized_; }
+    void reset() { initialized_ = false; }
+
+    Eigen::Vector3d toEnu(double latitude, double longitude, double altitude = 0) const;
+    void toGeodetic(const Eigen::Vector3d& enu, double& latitude, double& longitude, double& altitude) const;
+
+    static Eigen::Vector3d geodeticToEcef(double latitude, double longitude, double altitude);
+
+  private:
+    bool initialized_;
+    Eigen::Vector3d origin_ecef_;
+    Eigen::Matrix3d ecef_to_enu_;
+  };
+
+  /* consistency check of the gnss fixes before the fusion:
+     the position is predicted from the last consistent fix with the mean of the velocities
+     (or with the difference of the consistent positions without velocity, then with the speed bound),
+     and the innovation of the new fix is gated by the chi-square of the horizontal (geodetic) or the 3d (local) position.
+     the velocity is rejected by the jump beyond the acceleration bound and by the speed bound.
+     the rejected fix does not move the reference, which is dead-reckoned by the velocity, and it is re-anchored after the rejection
+     continues for max_reject_time. after a dropout or a re-anchoring, the fixes are used again once they are consistent
+     with each other for reacquire_count fixes. */
+  class GnssFrontEnd
+  {
+  public:
+    struct Result
+    {
+      bool pos_valid, vel_valid;
+      Eigen::Vector3d pos, vel; // enu with the geodetic position, otherwise in the local frame
+      double pos_sigma, vel_sigma;
+      double chi2; // of the position innovation, negative if not checked
+    };
+
+    /* chi-square at 99.9% for 2 and 3 dof */
+    static constexpr double CHI2_GATE_2D = 13.816;
+    static constexpr double CHI2_GATE_3D = 16.266;
+
+    GnssFrontEnd();
+
+    void setNoise(double pos_sigma, double vel_sigma); // when the receiver gives no accuracy
+    void setBounds(double max_speed, double max_acc);
+    void setTimeout(double dropout_time, double max_reject_time, int reacquire_count);
+    void setGateScale(double scale); // multiplied to the chi-square gate
+
+    LocalTangentPlane& getTangentPlane() { return plane_; }
+    const LocalTangentPlane& getTangentPlane() const { return plane_; }
+
+    /* the reference is cleared, the tangent plane is kept */
+    void reset();
+    Result update(const GnssFix& fix);
+
+    int getRejectCount() const { return reject_count_; }
+    int getVelRejectCount() const { return vel_reject_count_; }
+
+  private:
+    LocalTangentPlane plane_;
+
+    double pos_sigma_, vel_sigma_;
+    double max_speed_, max_acc_;
+    double dropout_time_, max_reject_time_;
+    int reacquire_count_;
+    double gate_scale_;
+
+    /* reference of the prediction */
+    bool ref_valid_, ref_vel_valid_;
+    double ref_stamp_;
+    Eigen::Vector3d ref_pos_, ref_vel_;
+    double ref_pos_var_, ref_vel_var_;
+    bool ref_measured_; // not dead-reckoned
+    bool diff_vel_valid_;
+    Eigen::Vector3d diff_vel_;
+    double diff_vel_var_;
+    double reject_start_, vel_reject_start_;
+    int consistent_count_;
+
+    /* statistics */
+    int reject_count_, vel_reject_count_;
+
+    void anchor(const GnssFix& fix, const Eigen::Vector3d& pos, double pos_var, bool vel_valid, double vel_var);
+  };
+
+} //namespace aerial_robot_estimation
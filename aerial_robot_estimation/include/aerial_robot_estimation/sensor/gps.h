@@ -36,6 +36,7 @@
 #pragma once
 
 #include <aerial_robot_estimation/sensor/base_plugin.h>
+#include <aerial_robot_estimation/sensor/gnss_front_end.h>
 #include <geodesy/utm.h>
 #include <geometry_msgs/PoseWithCovarianceStamped.h>
 #include <kalman_filter/kf_pos_vel_acc_plugin.h>
@@ -94,6 +95,10 @@ namespace sensor_plugin
 
       aerial_robot_msgs::States gps_state_;
 
+      /* consistency check before the fusion */
+      aerial_robot_estimation::GnssFrontEnd front_end_;
+      bool pos_valid_, vel_valid_;
+
       geographic_msgs::GeoPoint base_wgs84_point_, curr_wgs84_point_;
 
       tf::Vector3 pos_, raw_pos_, prev_raw_pos_;
@@ -104,6 +109,7 @@ namespace sensor_plugin
       void gpsFullCallback(const spinal::GpsFull::ConstPtr & gps_full_msg);
       void gpsRosCallback(const sensor_msgs::NavSatFix::ConstPtr & gps_msg);
       void rtkGpsCallback(const geometry_msgs::PoseWithCovarianceStamped::ConstPtr & gps_msg);
+      void fixProcess(const aerial_robot_estimation::GnssFix& fix); /* the three gps inputs are normalized to GnssFix */
       void estimateProcess();
       void rosParamInit();
       void activate();
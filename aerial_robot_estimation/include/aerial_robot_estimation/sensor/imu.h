@@ -37,9 +37,11 @@
 
 #include <aerial_robot_msgs/Acc.h>
 #include <aerial_robot_estimation/sensor/base_plugin.h>
+#include <aerial_robot_estimation/sensor/imu_batch_unpacker.h>
 #include <geometry_msgs/Vector3.h>
 #include <sensor_msgs/Imu.h>
 #include <spinal/Imu.h>
+#include <spinal/ImuBatch.h>
 
 
 using namespace Eigen;
@@ -67,6 +69,7 @@ namespace sensor_plugin
     ros::Publisher  acc_pub_;
     ros::Publisher  imu_pub_;
     ros::Subscriber imu_sub_;
+    ros::Subscriber imu_batch_sub_;
 
     /* rosparam */
     string imu_topic_name_;
@@ -75,6 +78,7 @@ namespace sensor_plugin
     int calib_count_;
     double acc_scale_, gyro_scale_, mag_scale_; /* the scale of sensor value */
     double level_acc_noise_sigma_, z_acc_noise_sigma_, level_acc_bias_noise_sigma_, z_acc_bias_noise_sigma_, angle_bias_noise_sigma_; /* sigma for kf */
+    int xy_bias_history_size_, xy_bias_replay_budget_; /* of the xy roll pitch bias kf */
     double landing_shock_force_thre_;     /* force */
 
     /* sensor internal */
@@ -98,14 +102,67 @@ namespace sensor_plugin
     aerial_robot_msgs::States state_; /* for debug */
 
     double calib_time_;
+    int bias_calib_;
 
     ros::Time imu_stamp_;
+    ros::Time prev_time_;
+
+    /* kalman filters predicted by imu: the plugin type is resolved once at the end of the bias calibration */
+    enum FuserType {POS_VEL_ACC, XY_ROLL_PITCH_BIAS, XYZ_POS_VEL_ACC};
+    struct ImuFuser
+    {
+      FuserType type;
+      int axis; /* X_BASE, Y_BASE or Z_BASE for POS_VEL_ACC */
+      boost::shared_ptr<kf_plugin::KalmanFilter> kf;
+    };
+    std::array<std::vector<ImuFuser>, 2> fusers_; /* 0: egomotion, 1: experiment */
+
+    /* buffers for the kalman filter interface, allocated once */
+    VectorXd pos_vel_acc_input_, xy_bias_input_, xyz_input_;
+    vector<double> pos_vel_acc_params_, xy_bias_params_, xyz_params_;
+
+    /* states of one imu sample: read from the estimator at once, and written back in one batch */
+    std::array<AxisState, State::TOTAL_NUM> states_;
+    vector<aerial_robot_estimation::StateElement> state_batch_;
+
+    /* samples of spinal::ImuBatch at their own time */
+    aerial_robot_estimation::ImuBatchUnpacker batch_unpacker_;
 
     virtual void ImuCallback(const spinal::ImuConstPtr& imu_msg);
+    /* every sample at its own time, the attitude is interpolated from the last sample of the previous batch */
+    virtual void ImuBatchCallback(const spinal::ImuBatchConstPtr& imu_msg);
     virtual void estimateProcess();
+    /* the filters and the states by one sample, true if the states are fused (after the bias calibration) */
+    bool updateState();
+    /* acc, ros imu and the state of the last sample */
+    void publishState();
     void publishAccData();
     void publishRosImuData();
     void rosParamInit();
+    void resolveFusers();
+
+    inline void batchState(uint8_t axis, uint8_t estimate_mode, uint8_t state_mode, double value)
+    {
+      (states_[axis][estimate_mode].second)[state_mode] = value;
+      state_batch_.push_back({axis, estimate_mode, state_mode, value});
+    }
+    /* first_axis: X_COG / ROLL_COG + frame * 3 */
+    inline void batchVector(uint8_t first_axis, uint8_t estimate_mode, uint8_t state_mode, const tf::Vector3& value)
+    {
+      for(int i = 0; i < 3; i++) batchState(first_axis + i, estimate_mode, state_mode, value[i]);
+    }
+    inline tf::Vector3 batchedVector(uint8_t first_axis, uint8_t estimate_mode, uint8_t state_mode) const
+    {
+      return tf::Vector3((states_[first_axis][estimate_mode].second)[state_mode],
+                         (states_[first_axis + 1][estimate_mode].second)[state_mode],
+                         (states_[first_axis + 2][estimate_mode].second)[state_mode]);
+    }
+    inline tf::Matrix3x3 batchedOrientation(int frame, uint8_t estimate_mode) const
+    {
+      tf::Vector3 euler = batchedVector(State::ROLL_COG + frame * 3, estimate_mode, 0);
+      tf::Matrix3x3 r; r.setRPY(euler.x(), euler.y(), euler.z());
+      return r;
+    }
   };
 };
 
@@ -0,0 +1,78 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Core>
+#include <stdint.h>
+#include <vector>
+
+namespace aerial_robot_estimation
+{
+  /* samples of spinal::ImuBatch at their own time:
+     the time of the k-th sample is stamp + sum(tick_delta[0:k+1]) [ms], the gyro and acc are dequantized by the shared scale.
+     the attitude is sent only at the last sample, so it is interpolated along the shortest rotation of each angle
+     from the last sample of the previous batch. at the first batch or after a gap longer than MAX_GAP,
+     the attitude of the last sample is held over the batch. */
+  class ImuBatchUnpacker
+  {
+  public:
+    static constexpr double MAX_GAP = 0.1; // [sec]
+
+    struct Sample
+    {
+      uint32_t tick; // [ms] from the stamp of the batch
+      Eigen::Vector3d gyro, acc, euler;
+    };
+
+    ImuBatchUnpacker();
+
+    void reset();
+
+    /* stamp: [sec] of the first sample, euler: [rad] at the last sample. false if the sizes of the data are inconsistent */
+    bool unpack(double stamp, const std::vector<uint8_t>& tick_delta,
+                float gyro_scale, const std::vector<int16_t>& gyro_data,
+                float acc_scale, const std::vector<int16_t>& acc_data,
+                const Eigen::Vector3d& euler);
+
+    const std::vector<Sample>& getSamples() const { return samples_; }
+
+  private:
+    bool initialized_;
+    double last_stamp_; // [sec] of the last sample of the previous batch
+    Eigen::Vector3d last_euler_;
+    std::vector<Sample> samples_;
+  };
+};
@@ -0,0 +1,112 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+
+namespace aerial_robot_estimation
+{
+  /* one frame of the motion capture */
+  struct MocapFrame
+  {
+    MocapFrame(): stamp(0), receive_stamp(0), pos(Eigen::Vector3d::Zero()), q(Eigen::Quaterniond::Identity()) {}
+
+    double stamp; // capture time (header stamp) [s]
+    double receive_stamp; // arrival at the plugin [s]
+    Eigen::Vector3d pos; // world frame
+    Eigen::Quaterniond q; // body -> world
+  };
+
+  /* short history of the timestamped mocap frames:
+     the velocity and the angular velocity are the derivative at the newest frame of the polynomial fitted by least squares
+     to the frames within the window, i.e. a savitzky-golay differentiator on the actual (uneven) capture stamps without the lag
+     of a low pass filter. the frame with the same stamp as the newest one is a duplicate, and the older one is out of order,
+     neither of them enters the history. the frames missing between two frames are counted by the frame period,
+     which is the mean of the regular intervals unless the nominal rate is given.
+     the latency (arrival - capture) is averaged over the history for the compensation at the arrival. */
+  class MocapTracker
+  {
+  public:
+    enum Status {NEW = 0, DUPLICATE = 1, OUT_OF_ORDER = 2};
+
+    struct Result
+    {
+      Status status;
+      int dropped; // missing frames just before this frame
+      double stamp; // capture time of the newest frame
+      Eigen::Vector3d pos, vel; // world frame
+      Eigen::Quaterniond q;
+      Eigen::Vector3d omega; // body frame
+      bool vel_valid; // enough frames in the window
+      double latency; // of this frame
+    };
+
+    MocapTracker();
+
+    void setHistorySize(int size);
+    void setWindow(double window, int order); // [s], order of the polynomial: 1 or 2
+    void setNominalRate(double rate); // [Hz], 0: estimated from the stamps
+
+    void reset();
+    Result add(const MocapFrame& frame);
+
+    int size() const { return count_; }
+    double getPeriod() const { return period_; }
+    double getLatency() const; // mean in the history
+    double getMaxLatency() const;
+    int getDuplicateCount() const { return duplicate_count_; }
+    int getOutOfOrderCount() const { return out_of_order_count_; }
+    int getDropCount() const { return drop_count_; }
+
+  private:
+    std::vector<MocapFrame> history_; // ring buffer
+    int head_, count_; // head_: the newest
+    double window_;
+    int order_;
+    double nominal_period_, period_;
+    Result last_;
+
+    /* statistics */
+    int duplicate_count_, out_of_order_count_, drop_count_;
+
+    const MocapFrame& frame(int age) const { return history_[(head_ - age + history_.size()) % history_.size()]; }
+    /* derivative of the position and the rotation vector at the newest frame, false if not enough frames */
+    bool differentiate(Eigen::Vector3d& vel, Eigen::Vector3d& omega) const;
+  };
+
+} //namespace aerial_robot_estimation
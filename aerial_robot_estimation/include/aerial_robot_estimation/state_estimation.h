@@ -119,6 +119,15 @@ namespace aerial_robot_estimation
 
   static constexpr float G = 9.797;
 
+  /* one element of the state, for the batched update from the sensor plugins */
+  struct StateElement
+  {
+    uint8_t axis;
+    uint8_t estimate_mode;
+    uint8_t state_mode;
+    double value;
+  };
+
   class StateEstimator: public boost::enable_shared_from_this<StateEstimator>
   {
 
@@ -127,12 +136,18 @@ namespace aerial_robot_estimation
 
     virtual ~StateEstimator()
     {
+      if(!update_thread_.joinable()) return;
       update_thread_.interrupt();
       update_thread_.join();
     }
 
     void initialize(ros::NodeHandle nh, ros::NodeHandle nh_private, boost::shared_ptr<aerial_robot_model::RobotModel> robot_model);
 
+    /* the owner calls statePublish() at estimation/update_rate on its own clock instead of the update thread
+       (e.g. the lockstep simulation). call before initialize() */
+    void setExternalUpdate(bool flag) { external_update_flag_ = flag; }
+    void statePublish();
+
     int getStateStatus(uint8_t axis, uint8_t estimate_mode)
     {
       boost::lock_guard<boost::mutex> lock(state_mutex_);
@@ -188,6 +203,24 @@ namespace aerial_robot_estimation
       (state_[axis][estimate_mode].second)[state_mode] = value;
     }
 
+    /* all states under one lock */
+    array<AxisState, State::TOTAL_NUM> getStates()
+    {
+      boost::lock_guard<boost::mutex> lock(state_mutex_);
+      return state_;
+    }
+
+    /* write the states of one sensor sample under one lock */
+    void setStates(const vector<StateElement>& elements)
+    {
+      boost::lock_guard<boost::mutex> lock(state_mutex_);
+      for(const auto& element: elements)
+        {
+          assert(element.axis < State::TOTAL_NUM);
+          (state_[element.axis][element.estimate_mode].second)[element.state_mode] = element.value;
+        }
+    }
+
     tf::Vector3 getPos(int frame, int estimate_mode)
     {
       boost::lock_guard<boost::mutex> lock(state_mutex_);
@@ -267,7 +300,14 @@ namespace aerial_robot_estimation
       r_ee.setRPY(roll, pitch, (getState(State::YAW_BASE, EGOMOTION_ESTIMATE))[0]);
       r_ex.setRPY(roll, pitch, (getState(State::YAW_BASE, EXPERIMENT_ESTIMATE))[0]);
       r_gt.setRPY(roll, pitch, (getState(State::YAW_BASE, GROUND_TRUTH))[0]);
+      updateQueue(timestamp, r_ee, r_ex, r_gt, omega,
+                  getPos(Frame::BASELINK, EGOMOTION_ESTIMATE), getPos(Frame::BASELINK, EXPERIMENT_ESTIMATE), getPos(Frame::BASELINK, GROUND_TRUTH));
+    }
 
+    /* the rotations and the baselink positions of egomotion, experiment and ground truth are given by the caller */
+    void updateQueue(const double timestamp, const tf::Matrix3x3& r_ee, const tf::Matrix3x3& r_ex, const tf::Matrix3x3& r_gt, const tf::Vector3& omega,
+                     const tf::Vector3& pos_ee, const tf::Vector3& pos_ex, const tf::Vector3& pos_gt)
+    {
       {
         boost::lock_guard<boost::mutex> lock(queue_mutex_);
         timestamp_qu_.push_back(timestamp);
@@ -275,6 +315,9 @@ namespace aerial_robot_estimation
         rot_ex_qu_.push_back(r_ex);
         rot_gt_qu_.push_back(r_gt);
         omega_qu_.push_back(omega);
+        pos_ee_qu_.push_back(pos_ee);
+        pos_ex_qu_.push_back(pos_ex);
+        pos_gt_qu_.push_back(pos_gt);
 
         if(timestamp_qu_.size() > qu_size_)
           {
@@ -283,6 +326,9 @@ namespace aerial_robot_estimation
             rot_ex_qu_.pop_front();
             rot_gt_qu_.pop_front();
             omega_qu_.pop_front();
+            pos_ee_qu_.pop_front();
+            pos_ex_qu_.pop_front();
+            pos_gt_qu_.pop_front();
           }
       }
     }
@@ -291,76 +337,47 @@ namespace aerial_robot_estimation
     {
       boost::lock_guard<boost::mutex> lock(queue_mutex_);
 
-      if(timestamp_qu_.size() == 0)
-        {
-          ROS_WARN_COND(verbose, "estimation: no valid queue for timestamp to find proper r and omega");
-
-          return false;
-        }
+      size_t candidate_index;
+      if(!findQueueIndex(timestamp, candidate_index, verbose)) return false;
 
-      if(timestamp < timestamp_qu_.front())
-        {
-          ROS_WARN_COND(verbose, "estimation: sensor timestamp %f is earlier than the oldest timestamp %f in queue",
-                        timestamp, timestamp_qu_.front());
-          return false;
-        }
-
-      if(timestamp > timestamp_qu_.back())
+      omega = omega_qu_.at(candidate_index);
+      switch(mode)
         {
-          ROS_WARN_COND(verbose, "estimation: sensor timestamp %f is later than the latest timestamp %f in queue",
-                        timestamp, timestamp_qu_.back());
-
+        case EGOMOTION_ESTIMATE:
+          r = rot_ee_qu_.at(candidate_index);
+          break;
+        case EXPERIMENT_ESTIMATE:
+          r = rot_ex_qu_.at(candidate_index);
+          break;
+        case GROUND_TRUTH:
+          r = rot_gt_qu_.at(candidate_index);
+          break;
+        default:
+          ROS_ERROR("estimation search state with timestamp: wrong mode %d", mode);
           return false;
         }
 
-      size_t candidate_index = (timestamp_qu_.size() - 1) * (timestamp - timestamp_qu_.front()) / (timestamp_qu_.back() - timestamp_qu_.front());
-
-      if(timestamp > timestamp_qu_.at(candidate_index))
-        {
-          for(auto it = timestamp_qu_.begin() + candidate_index; it != timestamp_qu_.end(); ++it)
-            {
-              /* future timestamp, escape */
-              if(*it > timestamp)
-                {
-                  if (fabs(*it - timestamp) < fabs(*(it - 1) - timestamp))
-                    candidate_index = std::distance(timestamp_qu_.begin(), it);
-                  else
-                    candidate_index = std::distance(timestamp_qu_.begin(), it-1);
+      return true;
+    }
 
-                  //ROS_INFO("find timestamp sensor vs imu: [%f, %f], candidate: %d", timestamp, timestamp_qu_.at(candidate_index), candidate_index);
-                  break;
-                }
-            }
-        }
-      else
-        {
-          for(auto it = timestamp_qu_.rbegin() + (timestamp_qu_.size() - 1 - candidate_index); it != timestamp_qu_.rend(); ++it)
-            {
-              /* future timestamp, escape */
-              if(*it < timestamp)
-                {
-                  if (fabs(*it - timestamp) < fabs(*(it - 1) - timestamp))
-                    candidate_index = timestamp_qu_.size() - 1 - std::distance(timestamp_qu_.rbegin(), it);
-                  else
-                    candidate_index = timestamp_qu_.size() - 1 - std::distance(timestamp_qu_.rbegin(), it-1);
+    /* the baselink position at the imu sample closest to the timestamp */
+    bool findPos(const double timestamp, const int mode, tf::Vector3& pos, bool verbose = true)
+    {
+      boost::lock_guard<boost::mutex> lock(queue_mutex_);
 
-                  //ROS_INFO("reverse find timestamp sensor vs imu: [%f, %f], %d", timestamp, timestamp_qu_.at(candidate_index) , candidate_index);
-                  break;
-                }
-            }
-        }
+      size_t candidate_index;
+      if(!findQueueIndex(timestamp, candidate_index, verbose)) return false;
 
-      omega = omega_qu_.at(candidate_index);
       switch(mode)
         {
         case EGOMOTION_ESTIMATE:
-          r = rot_ee_qu_.at(candidate_index);
+          pos = pos_ee_qu_.at(candidate_index);
           break;
         case EXPERIMENT_ESTIMATE:
-          r = rot_ex_qu_.at(candidate_index);
+          pos = pos_ex_qu_.at(candidate_index);
           break;
         case GROUND_TRUTH:
-          r = rot_gt_qu_.at(candidate_index);
+          pos = pos_gt_qu_.at(candidate_index);
           break;
         default:
           ROS_ERROR("estimation search state with timestamp: wrong mode %d", mode);
@@ -437,12 +454,84 @@ namespace aerial_robot_estimation
 
   protected:
 
+    /* with queue_mutex_ */
+    bool findQueueIndex(const double timestamp, size_t& candidate_index, bool verbose)
+    {
+      if(timestamp_qu_.size() == 0)
+        {
+          ROS_WARN_COND(verbose, "estimation: no valid queue for timestamp to find proper r and omega");
+
+          return false;
+        }
+
+      if(timestamp < timestamp_qu_.front())
+        {
+          ROS_WARN_COND(verbose, "estimation: sensor timestamp %f is earlier than the oldest timestamp %f in queue",
+                        timestamp, timestamp_qu_.front());
+          return false;
+        }
+
+      if(timestamp > timestamp_qu_.back())
+        {
+          ROS_WARN_COND(verbose, "estimation: sensor timestamp %f is later than the latest timestamp %f in queue",
+                        timestamp, timestamp_qu_.back());
+
+          return false;
+        }
+
+      candidate_index = (timestamp_qu_.size() - 1) * (timestamp - timestamp_qu_.front()) / (timestamp_qu_.back() - timestamp_qu_.front());
+
+      if(timestamp > timestamp_qu_.at(candidate_index))
+        {
+          for(auto it = timestamp_qu_.begin() + candidate_index; it != timestamp_qu_.end(); ++it)
+            {
+              /* future timestamp, escape */
+              if(*it > timestamp)
+                {
+                  if (fabs(*it - timestamp) < fabs(*(it - 1) - timestamp))
+                    candidate_index = std::distance(timestamp_qu_.begin(), it);
+                  else
+                    candidate_index = std::distance(timestamp_qu_.begin(), it-1);
+
+                  //ROS_INFO("find timestamp sensor vs imu: [%f, %f], candidate: %d", timestamp, timestamp_qu_.at(candidate_index), candidate_index);
+                  break;
+                }
+            }
+        }
+      else
+        {
+          for(auto it = timestamp_qu_.rbegin() + (timestamp_qu_.size() - 1 - candidate_index); it != timestamp_qu_.rend(); ++it)
+            {
+              /* future timestamp, escape */
+              if(*it < timestamp)
+                {
+                  if (fabs(*it - timestamp) < fabs(*(it - 1) - timestamp))
+                    candidate_index = timestamp_qu_.size() - 1 - std::distance(timestamp_qu_.rbegin(), it);
+                  else
+                    candidate_index = timestamp_qu_.size() - 1 - std::distance(timestamp_qu_.rbegin(), it-1);
+
+                  //ROS_INFO("reverse find timestamp sensor vs imu: [%f, %f], %d", timestamp, timestamp_qu_.at(candidate_index) , candidate_index);
+                  break;
+                }
+            }
+        }
+
+      return true;
+    }
+
     ros::NodeHandle nh_;
     ros::NodeHandle nhp_;
-    ros::Publisher full_state_pub_, baselink_odom_pub_, cog_odom_pub_;
+    ros::Publisher full_state_pub_, full_state_throttle_pub_, baselink_odom_pub_, cog_odom_pub_;
     tf::TransformBroadcaster br_;
 
+    /* preallocated messages for statePublish(), the ids and frame names are set once in initialize() */
+    aerial_robot_msgs::States full_state_msg_;
+    nav_msgs::Odometry baselink_odom_msg_, cog_odom_msg_;
+    int full_state_decimation_; /* uav/full_state_throttle is published every n cycles of uav/full_state */
+    int publish_cnt_;
+
     boost::thread update_thread_;
+    bool external_update_flag_;
 
     vector< boost::shared_ptr<sensor_plugin::SensorBase> > sensors_;
     boost::shared_ptr< pluginlib::ClassLoader<sensor_plugin::SensorBase> > sensor_plugin_ptr_;
@@ -459,6 +548,7 @@ namespace aerial_robot_estimation
     bool param_verbose_;
     int estimate_mode_; /* main estimte mode */
     double update_rate_;
+    double full_state_rate_;
 
     /* robot model (kinematics)  */
     boost::shared_ptr<aerial_robot_model::RobotModel> robot_model_;
@@ -472,6 +562,7 @@ namespace aerial_robot_estimation
     deque<double> timestamp_qu_;
     deque<tf::Matrix3x3> rot_ee_qu_, rot_ex_qu_, rot_gt_qu_;
     deque<tf::Vector3> omega_qu_;
+    deque<tf::Vector3> pos_ee_qu_, pos_ex_qu_, pos_gt_qu_;
 
     /* sensor fusion */
     boost::shared_ptr< pluginlib::ClassLoader<kf_plugin::KalmanFilter> > sensor_fusion_loader_ptr_;
@@ -492,7 +583,7 @@ namespace aerial_robot_estimation
     /* latitude & longitude point */
     geographic_msgs::GeoPoint curr_wgs84_poiont_;
 
-    void statePublish();
+    void fillOdom(const array<AxisState, State::TOTAL_NUM>& states, int frame, nav_msgs::Odometry& odom);
     void rosParamInit();
 
     void update()
@@ -0,0 +1,108 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef AERIAL_ROBOT_ESTIMATION_FLOW_TRACKER_H_
+#define AERIAL_ROBOT_ESTIMATION_FLOW_TRACKER_H_
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/video/video.hpp"
+#include <vector>
+
+namespace aerial_robot_estimation
+{
+  /* sparse optical flow of the downward camera:
+     the features are kept across the frames, and are re-detected only when the tracked ones are not enough.
+     the camera velocity is the robust mean of the feature velocities, compensated for the rotation rate. */
+  class FlowTracker
+  {
+  public:
+    FlowTracker();
+    ~FlowTracker(){}
+
+    void setCamera(double f, double cx, double cy, int cut_pixel);
+    void setFeatureParams(int max_count, int min_count, double quality_level, double min_distance);
+    void setLKParams(int win_size, int max_level, int max_iter);
+    void setOutlierParams(double outlier_scale, double min_outlier_thresh);
+    void reset();
+
+    /* track the features from the previous image to the new grayscale image.
+       return false if there is no previous image. */
+    bool track(const cv::Mat& gray);
+
+    /* camera velocity in camera frame from the tracked features.
+       ang_vel: rotation rate in camera frame, height: distance to the ground plane, height_vel: velocity toward the ground.
+       the features regarded as the outlier are removed from the tracked ones.
+       return the number of the inlier features. */
+    int estimateVelocity(double dt, const cv::Vec3d& ang_vel, double height, double height_vel, cv::Vec3d& vel);
+
+    const std::vector<cv::Point2f>& getPrevPoints() const { return prev_points_; }
+    const std::vector<cv::Point2f>& getCurrPoints() const { return curr_points_; }
+    bool getRedetected() const { return redetected_; }
+
+  private:
+    /* camera */
+    double camera_f_, camera_cx_, camera_cy_;
+    int image_cut_pixel_;
+
+    /* feature detection */
+    int max_count_, min_count_;
+    double quality_level_, min_distance_;
+
+    /* lucas-kanade */
+    cv::Size win_size_;
+    int max_level_;
+    cv::TermCriteria termcrit_;
+
+    /* outlier: |v - median(v)| > max(outlier_scale * 1.4826 * MAD, min_outlier_thresh) */
+    double outlier_scale_, min_outlier_thresh_;
+
+    /* buffers reused over the frames */
+    std::vector<cv::Mat> prev_pyr_, curr_pyr_;
+    std::vector<cv::Point2f> prev_points_, curr_points_, new_points_;
+    std::vector<uchar> status_;
+    std::vector<float> err_;
+    std::vector<double> vel_x_, vel_y_, sorted_;
+    cv::Mat mask_;
+    bool redetected_;
+
+    void detect(const cv::Mat& gray);
+    double median(const std::vector<double>& values);
+  };
+
+} //namespace aerial_robot_estimation
+
+#endif
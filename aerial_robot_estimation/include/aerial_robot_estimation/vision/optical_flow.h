@@ -37,6 +37,7 @@
 #ifndef AERIAL_ROBOT_ESTIMATION_OPTICAL_FLOW_H_
 #define AERIAL_ROBOT_ESTIMATION_OPTICAL_FLOW_H_
 
+#include <aerial_robot_estimation/vision/flow_tracker.h>
 #include <cv_bridge/cv_bridge.h>
 #include <geometry_msgs/Quaternion.h>
 #include <geometry_msgs/Vector3Stamped.h>
@@ -46,9 +47,6 @@
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/video/video.hpp"
-#if USE_GPU
-#include "opencv2/gpu/gpu.hpp"
-#endif
 #include <ros/ros.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/Imu.h>
@@ -108,18 +106,14 @@ namespace aerial_robot_estimation
     double camera_f_, camera_cx_, camera_cy_;
     double sonar_, sonar_vel_, sonar_offset_;
     tf::Vector3 ang_vel_;
-    cv::Mat prev_gray_img_;
-    std::vector<cv::Point2f> points_[2];
-    int max_count_;
+    cv::Mat gray_img_, debug_img_;
+    FlowTracker tracker_;
     ros::Time prev_stamp_;
     ros::Time sonar_prev_stamp_;
     tf::Matrix3x3 camera_rotation_mat_, camera_rotation_mat_inv_;
     double camera_roll_, camera_pitch_, camera_yaw_;
     double image_crop_scale_;
     int image_cut_pixel_;
-#if USE_GPU
-    cv::gpu::GpuMat d_frame0Gray, d_frame1Gray;
-#endif
   };
 
 } //namespace aerial_robot_estimation
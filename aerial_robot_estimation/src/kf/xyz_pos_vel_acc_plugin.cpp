@@ -0,0 +1,105 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/kf/xyz_pos_vel_acc_plugin.h>
+
+namespace kf_plugin
+{
+  void KalmanFilterXYZPosVelAcc::initialize(string name, int id)
+  {
+    state_dim_ = STATE_DIM;
+    state_names_ = {"p_x", "v_x", "p_y", "v_y", "p_z", "v_z", "b_x", "b_y", "b_z"};
+    input_names_ = {"a_xb", "a_yb", "a_zb", "d_b_x", "d_b_y", "d_b_z"};
+    measure_names_ = {"p_x", "p_y", "p_z", "v_x", "v_y", "v_z"};
+
+    KalmanFilter::initialize(name, id);
+  }
+
+  void KalmanFilterXYZPosVelAcc::getPredictModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& state_transition_model, MatrixXd& control_input_model) const
+  {
+    assert(params.size() == 4);
+
+    double dt = params[0];
+    double half_dt2 = 0.5 * dt * dt;
+
+    /* body to world */
+    Matrix3d r;
+    r = AngleAxisd(params[3], Vector3d::UnitZ()) * AngleAxisd(params[2], Vector3d::UnitY()) * AngleAxisd(params[1], Vector3d::UnitX());
+
+    Matrix<double, STATE_DIM, STATE_DIM> f = Matrix<double, STATE_DIM, STATE_DIM>::Identity();
+    Matrix<double, STATE_DIM, INPUT_DIM> g = Matrix<double, STATE_DIM, INPUT_DIM>::Zero();
+    for(int i = 0; i < 3; i++)
+      {
+        f(posIndex(i), velIndex(i)) = dt;
+        f(posIndex(i), biasIndex(i)) = -half_dt2;
+        f(velIndex(i), biasIndex(i)) = -dt;
+
+        g.block<1, 3>(posIndex(i), 0) = half_dt2 * r.row(i);
+        g.block<1, 3>(velIndex(i), 0) = dt * r.row(i);
+        g(biasIndex(i), 3 + i) = 1;
+      }
+
+    state_transition_model = f;
+    control_input_model = g;
+  }
+
+  void KalmanFilterXYZPosVelAcc::getCorrectModel(const vector<double>& params, const VectorXd& estimate_state, MatrixXd& observation_model) const
+  {
+    assert(params.size() >= 1);
+
+    int mode = (int)params[0];
+    int axes = (params.size() > 1)?(int)params[1]:0x07;
+
+    Matrix<double, 6, STATE_DIM> h = Matrix<double, 6, STATE_DIM>::Zero();
+    int rows = 0;
+    if(mode == POS || mode == POS_VEL)
+      {
+        for(int i = 0; i < 3; i++)
+          if(axes & (1 << i)) h(rows++, posIndex(i)) = 1;
+      }
+    if(mode == VEL || mode == POS_VEL)
+      {
+        for(int i = 0; i < 3; i++)
+          if(axes & (1 << i)) h(rows++, velIndex(i)) = 1;
+      }
+
+    if(rows == 0) ROS_ERROR("xyz pos vel acc kf: wrong correct mode %d, axes %d", mode, axes);
+
+    observation_model = h.topRows(rows);
+  }
+};
+
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(kf_plugin::KalmanFilterXYZPosVelAcc, kf_plugin::KalmanFilter);
@@ -34,6 +34,8 @@
  *********************************************************************/
 
 
+#include <aerial_robot_estimation/kf/xyz_pos_vel_acc_plugin.h>
+#include <aerial_robot_estimation/sensor/altitude_estimator.h>
 #include <aerial_robot_estimation/sensor/base_plugin.h>
 #include <kalman_filter/kf_pos_vel_acc_plugin.h>
 #include <sensor_msgs/Range.h>
@@ -61,15 +63,16 @@ namespace sensor_plugin
       SensorBase::initialize(nh, robot_model, estimator, sensor_name, index);
       rosParamInit();
 
-      kf_loader_ptr_ = boost::shared_ptr< pluginlib::ClassLoader<kf_plugin::KalmanFilter> >(new pluginlib::ClassLoader<kf_plugin::KalmanFilter>("kalman_filter", "kf_plugin::KalmanFilter"));
-      baro_bias_kf_  = kf_loader_ptr_->createInstance("aerial_robot_base/kf_baro_bias");
-      baro_bias_kf_->initialize(string(""), 0);
-
       baro_lpf_filter_ = IirFilter(sample_freq_, cutoff_freq_);
       baro_lpf_high_filter_ = IirFilter(sample_freq_, high_cutoff_freq_);
 
-      /* terrain check */
-      if(!terrain_check_with_baro_) state_on_terrain_ = NORMAL;
+      /* terrain, range outlier and baro bias */
+      alt_estimator_.setRangeNoise(range_noise_sigma_);
+      alt_estimator_.setBaroNoise(baro_noise_sigma_, baro_bias_noise_sigma_);
+      alt_estimator_.setAccNoise(acc_noise_sigma_);
+      alt_estimator_.setTerrainNoise(terrain_noise_sigma_);
+      alt_estimator_.setTerrainCheck(terrain_check_with_baro_, outlier_threshold_, check_du1_, check_du2_, check_likelihood_ratio_);
+      alt_estimator_.setDropoutTime(range_dropout_time_);
 
       /* range sensor */
       std::string topic_name;
@@ -109,11 +112,8 @@ namespace sensor_plugin
       high_filtered_baro_vel_z_(0),
       /* terrain state */
       alt_estimate_mode_(ONLY_BARO_MODE),
-      state_on_terrain_(NORMAL),
+      range_available_(false),
       inflight_state_(false),
-      first_outlier_val_(0),
-      t_ab_(0),
-      t_ab_incre_(0),
       height_offset_(0)
     {
       alt_state_.states.resize(2);
@@ -127,7 +127,15 @@ namespace sensor_plugin
     }
 
     int getRangeSensorSanity(){return range_sensor_sanity_;}
-    int getStateOnTerrain(){return state_on_terrain_;}
+    int getStateOnTerrain()
+    {
+      switch(alt_estimator_.getRangeState())
+        {
+        case aerial_robot_estimation::AltitudeEstimator::RANGE_CHECK: return ABNORMAL;
+        case aerial_robot_estimation::AltitudeEstimator::RANGE_LOST: return MAX_EXCEED;
+        default: return NORMAL;
+        }
+    }
 
     /* the height estimation related function */
     static constexpr uint8_t ONLY_BARO_MODE = 0; //we estimate the height only based the baro, but the bias of baro is constexprant(keep the last eistamted value)
@@ -178,9 +186,6 @@ namespace sensor_plugin
     int range_sensor_sanity_; /* for the (initial) sanity of the senser in terms of the attachment hardware */
 
     /* barometer */
-    /* the kalman filter for the baro bias estimation */
-    boost::shared_ptr< pluginlib::ClassLoader<kf_plugin::KalmanFilter> > kf_loader_ptr_;
-    boost::shared_ptr<kf_plugin::KalmanFilter> baro_bias_kf_;
     IirFilter baro_lpf_filter_, baro_lpf_high_filter_;
     bool inflight_state_; //the flag for the inflight state
     double raw_baro_pos_z_, baro_pos_z_, prev_raw_baro_pos_z_, prev_baro_pos_z_;
@@ -192,16 +197,16 @@ namespace sensor_plugin
     double max_flight_height_;
 
     /* for terrain check */
+    aerial_robot_estimation::AltitudeEstimator alt_estimator_; // terrain height, range outlier and baro bias
     int alt_estimate_mode_;
+    bool range_available_;
     bool terrain_check_with_baro_; // the flag to enable or disable the terrain check
-    double outlier_threshold_; // the check threshold between the estimated value and sensor value: e.g. 10 times
-    double inlier_threshold_; // the check threshold between the estimated value and sensor value: e.g. 5 times
-    double check_du1_; // the duration to check the sensor value in terms of the big noise, short time(e.g. 0.1s)
-    double check_du2_; // the duration to check the sensor value in terms of the new flat terrain, long time(e.g. 1s)
-    uint8_t state_on_terrain_; // the sensor state(normal or abnormal)
-    double t_ab_; // the time when the state becomes abnormal.
-    double t_ab_incre_; // the increment time from  t_ab_.
-    double first_outlier_val_; // the first sensor value during the check_du2_;
+    double outlier_threshold_; // the difference between the estimated value and sensor value always consistent
+    double check_du1_; // the min duration to accept the new terrain, the spike shorter than it is an outlier (e.g. 0.1s)
+    double check_du2_; // the max duration to check the new terrain (e.g. 1s)
+    double check_likelihood_ratio_; // between the new terrain and the outlier to decide
+    double range_dropout_time_; // the terrain is re-anchored after the range is lost for it
+    double acc_noise_sigma_, terrain_noise_sigma_;
     float height_offset_; /* general offset between esimated height and range sensor value, maybe change beacause of the terrain */
 
     aerial_robot_msgs::States alt_state_;
@@ -287,23 +292,10 @@ namespace sensor_plugin
                   range_sensor_offset_ = 0;
                 }
 
-              /* fuser for 0: egomotion, 1: experiment */
-              for(int mode = 0; mode < 2; mode++)
-                {
-                  if(!getFuserActivate(mode)) continue;
-
-                  for(auto& fuser : estimator_->getFuser(mode))
-                    {
-                      boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                      int id = kf->getId();
-
-                      if(id & (1 << State::Z_BASE))
-                        {
-                          kf->setMeasureFlag();
-                          kf->setInitState(raw_range_sensor_value_ + height_offset_, 0);
-                        }
-                    }
-                }
+              alt_estimator_.setRangeLimits(min_range_, max_range_);
+              alt_estimator_.resetFromRange(raw_range_sensor_value_, height_offset_, current_secs);
+              range_available_ = true;
+              initFusers(raw_range_sensor_value_ + height_offset_);
 
               /* change the alt estimate mode */
               alt_estimate_mode_ = WITHOUT_BARO_MODE;
@@ -340,21 +332,7 @@ namespace sensor_plugin
               /* this is for the repeat mode */
               if(!estimator_->getSensorFusionFlag()) calibrate_cnt = 0;
 
-              for(int mode = 0; mode < 2; mode++)
-                {
-                  if(!getFuserActivate(mode)) continue;
-
-                  for(auto& fuser : estimator_->getFuser(mode))
-                    {
-                      boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                      int id = kf->getId();
-                      if(id & (1 << State::Z_BASE))
-                        {
-                          kf->setMeasureFlag(false);
-                          kf->resetState();
-                        }
-                    }
-                }
+              resetFusers();
               return;
             }
 
@@ -370,22 +348,9 @@ namespace sensor_plugin
               /* release the non-descending mode, use the range sensor for z(alt) estimation */
               estimator_->setUnDescendMode(false);
 
-              for(int mode = 0; mode < 2; mode++)
-                {
-                  if(!getFuserActivate(mode)) continue;
-
-                  for(auto& fuser : estimator_->getFuser(mode))
-                    {
-                      ROS_INFO("debug sonar: init test:");
-                      boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                      int id = kf->getId();
-                      if(id & (1 << State::Z_BASE))
-                        {
-                          kf->setInitState(raw_range_pos_z_, 0);
-                          kf->setMeasureFlag();
-                        }
-                    }
-                }
+              alt_estimator_.resetFromRange(raw_range_sensor_value_, height_offset_, current_secs);
+              range_available_ = true;
+              initFusers(raw_range_pos_z_);
 
               range_sensor_sanity_ = POTENTIALLY_INSANE;
             }
@@ -410,7 +375,7 @@ namespace sensor_plugin
       /* terrain check and height estimate */
       alt_state_.header.stamp.fromSec(range_msg->header.stamp.toSec());
       if(terrainProcess(current_secs))
-        rangeEstimateProcess();
+        correctFusers(raw_range_pos_z_, range_noise_sigma_, time_sync_?current_secs:-1);
 
       /* publish phase */
       alt_state_.states[0].state[0].x = raw_range_pos_z_;
@@ -424,162 +389,147 @@ namespace sensor_plugin
       prev_raw_range_pos_z_ = raw_range_pos_z_;
     }
 
-    void rangeEstimateProcess()
+    /* index of the z position in the estimate state of the fuser */
+    int zPosIndex(const string& plugin_name)
     {
-      if(getStatus() == Status::INVALID) return;
-
-      Matrix<double, 1, 1> temp = MatrixXd::Zero(1, 1);
+      if(plugin_name == "aerial_robot_base/kf_xyz_pos_vel_acc")
+        return kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(2);
+      return 0;
+    }
 
+    /* the range sensor is the reference of z: the fusers start from the height */
+    void initFusers(double z)
+    {
+      /* fuser for 0: egomotion, 1: experiment */
       for(int mode = 0; mode < 2; mode++)
         {
           if(!getFuserActivate(mode)) continue;
 
           for(auto& fuser : estimator_->getFuser(mode))
             {
-              string plugin_name = fuser.first;
               boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-              int id = kf->getId();
-              if(id & (1 << State::Z_BASE))
+              if(kf->getId() & (1 << State::Z_BASE))
                 {
-                  if(plugin_name == "kalman_filter/kf_pos_vel_acc")
-                    {
-                      /* correction */
-                      VectorXd measure_sigma(1); measure_sigma << range_noise_sigma_;
-                      VectorXd meas(1); meas <<  raw_range_pos_z_;
-                      vector<double> params = {kf_plugin::POS};
-
-                      kf->correction(meas, measure_sigma,
-                                     time_sync_?(alt_state_.header.stamp.toSec()):-1, params);
-                    }
+                  kf->setInitState(z, zPosIndex(fuser.first));
+                  kf->setMeasureFlag();
                 }
             }
         }
     }
 
-    bool terrainProcess(double current_secs)
+    void resetFusers()
     {
-      if(getStatus() == Status::INVALID) return false;
-
-      boost::shared_ptr<kf_plugin::KalmanFilter> kf = nullptr;
-      if(!getFuserActivate(aerial_robot_estimation::EGOMOTION_ESTIMATE))
+      for(int mode = 0; mode < 2; mode++)
         {
-          ROS_ERROR("range sensor is not used in EGOMOTION_ESTIMATE mode");
-          return false;
-        }
+          if(!getFuserActivate(mode)) continue;
 
-      for(auto& fuser : estimator_->getFuser(aerial_robot_estimation::EGOMOTION_ESTIMATE))
-        {
-          if(fuser.second->getId() & (1 << State::Z_BASE))
+          for(auto& fuser : estimator_->getFuser(mode))
             {
-              if(!kf) kf = fuser.second;
-              else
+              boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
+              if(kf->getId() & (1 << State::Z_BASE))
                 {
-                  ROS_ERROR("more than one kaman filter estimating z axis is detected");
-                  return false;
+                  kf->setMeasureFlag(false);
+                  if(fuser.first == "aerial_robot_base/kf_xyz_pos_vel_acc")
+                    {
+                      /* only reset z, the level states are corrected by other sensors */
+                      kf->setInitState(0, kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(2));
+                      kf->setInitState(0, kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(2));
+                    }
+                  else
+                    kf->resetState();
                 }
             }
         }
+    }
 
-      if(terrain_check_with_baro_)
+    /* correct z of the fusers by the height from the range sensor or the baro */
+    void correctFusers(double z, double sigma, double stamp)
+    {
+      if(getStatus() == Status::INVALID) return;
+
+      for(int mode = 0; mode < 2; mode++)
         {
-          switch(state_on_terrain_)
+          if(!getFuserActivate(mode)) continue;
+
+          for(auto& fuser : estimator_->getFuser(mode))
             {
-            case NORMAL:
-              /* flow chat 1 */
-              /* check the height of the range sensor when height exceeds limitation */
-              if(raw_range_sensor_value_ < min_range_ || raw_range_sensor_value_ > max_range_)
+              string plugin_name = fuser.first;
+              boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
+              if(!(kf->getId() & (1 << State::Z_BASE))) continue;
+
+              VectorXd measure_sigma(1); measure_sigma << sigma;
+              VectorXd meas(1); meas << z;
+              if(plugin_name == "kalman_filter/kf_pos_vel_acc")
                 {
-                  state_on_terrain_ = MAX_EXCEED;
-                  alt_estimate_mode_ = ONLY_BARO_MODE;
-                  ROS_WARN("exceed the range of the sensor, change to only baro estimate mode");
-                  //break;
-                  return false;
+                  vector<double> params = {kf_plugin::POS};
+                  kf->correction(meas, measure_sigma, stamp, params);
                 }
 
-              /* flow chat 2 */
-              /* check the difference between the estimated value and raw range value */
-              if(fabs((kf->getEstimateState())(0) - raw_range_pos_z_) > outlier_threshold_)
+              if(plugin_name == "aerial_robot_base/kf_xyz_pos_vel_acc")
                 {
-                  t_ab_ = current_secs;
-                  t_ab_incre_ = current_secs;
-                  first_outlier_val_ = raw_range_sensor_value_;
-                  state_on_terrain_ = ABNORMAL;
-                  ROS_WARN("range sensor: we find the outlier value in NORMAL mode, switch to ABNORMAL mode, the sensor value is %f, the estimator value is %f, the first outlier value is %f", raw_range_pos_z_, (kf->getEstimateState())(0), first_outlier_val_);
-                  //break;
-                  return false;
+                  vector<double> params = {kf_plugin::POS, 1 << 2}; // z only
+                  kf->correction(meas, measure_sigma, stamp, params);
                 }
+            }
+        }
+    }
 
-              //break;
-              return true;
-            case ABNORMAL:
+    bool terrainProcess(double current_secs)
+    {
+      if(getStatus() == Status::INVALID) return false;
 
-              /* update the t_ab_incre_ for the second level oulier check */
-              if(fabs(raw_range_sensor_value_ - first_outlier_val_) > outlier_threshold_)
-                {
-                  ROS_WARN("range sensor: update the t_ab_incre and first_outlier_val_, since the sensor value is vibrated, sensor value:%f, first outlier value: %f", raw_range_sensor_value_, first_outlier_val_);
-                  t_ab_incre_ = current_secs;
-                  first_outlier_val_ = raw_range_sensor_value_;
-                }
+      /* the vertical acc of the imu in the world frame since the last measurement */
+      alt_estimator_.predict((estimator_->getState(State::Z_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE))[2], current_secs);
+      aerial_robot_estimation::AltitudeEstimator::Result result = alt_estimator_.updateRange(raw_range_sensor_value_, current_secs);
 
-              if(current_secs - t_ab_ < check_du1_)
-                {
-                  /* the first level to check the outlier: recover to the last normal mode */
-                  /* we don't have to update the height_offset */
-                  if(fabs((kf->getEstimateState())(0) - raw_range_pos_z_) < inlier_threshold_)
-                    {
-                      state_on_terrain_ = NORMAL;
-                      return true;
-                    }
-                }
-              else
-                {
-                  /* the second level to check the outlier: find new terrain */
-                  if(current_secs - t_ab_incre_ > check_du2_)
-                    {
-                      state_on_terrain_ = NORMAL;
-                      height_offset_ = (kf->getEstimateState())(0) - raw_range_sensor_value_;
-                      /* also update the landing height */
-                      estimator_->setLandingHeight(height_offset_ - range_sensor_offset_);
-                      ROS_WARN("We we find the new terrain, the new height_offset is %f", height_offset_);
-                    }
-                }
-              break;
-            case MAX_EXCEED:
-              /* the sensor value is below the max value ath the MAX_EXCEED state */
-              /*we first turn back to ABNORMAL mode to verify the validity of the value */
-              if(raw_range_sensor_value_ < max_range_ && raw_range_sensor_value_ > min_range_) state_on_terrain_ = ABNORMAL;
-              return false;
-            default:
-              return false;
+      if(terrain_check_with_baro_)
+        {
+          /* the height w.r.t. the estimated terrain */
+          height_offset_ = alt_estimator_.getHeightOffset();
+          raw_range_pos_z_ = result.height;
+
+          if(result.terrain_step)
+            {
+              /* also update the landing height */
+              estimator_->setLandingHeight(height_offset_ - range_sensor_offset_);
+              ROS_WARN("range sensor: find the new terrain, the new height_offset is %f", height_offset_);
+            }
+
+          /* only baro while the range sensor is lost */
+          if(range_available_ != alt_estimator_.rangeAvailable())
+            {
+              range_available_ = alt_estimator_.rangeAvailable();
+              alt_estimate_mode_ = range_available_ ? WITHOUT_BARO_MODE : ONLY_BARO_MODE;
+              ROS_WARN("range sensor: %s, change to estimate mode %d", range_available_?"available":"lost", alt_estimate_mode_);
             }
+
+          return result.valid;
         }
-      else
-        {
-          if(estimator_->getForceAttControlFlag()) return true;
 
-          /*
-            heuristic check method:
-            check the validity of visual odometry by range sensor, with the assumption that there is no terrain change
-          */
-          if(estimator_->getVoHandlers().size() > 0 && raw_range_pos_z_ > max_flight_height_)
+      if(estimator_->getForceAttControlFlag()) return true;
+
+      /*
+        heuristic check method:
+        check the validity of visual odometry by range sensor, with the assumption that there is no terrain change
+      */
+      if(estimator_->getVoHandlers().size() > 0 && raw_range_pos_z_ > max_flight_height_)
+        {
+          bool vo_active = false;
+          for(const auto& handler: estimator_->getVoHandlers())
             {
-              bool vo_active = false;
-              for(const auto& handler: estimator_->getVoHandlers())
-                {
-                  if(handler->getStatus() == Status::ACTIVE)
-                    vo_active = true;
-                }
+              if(handler->getStatus() == Status::ACTIVE)
+                vo_active = true;
+            }
 
-              if(vo_active)
-                {
-                  /* TODO: find the invalid vo sensor, and only reset the invalid one */
-                  ROS_WARN("reset all vo sensor, because the value of range sensor exceeds the max flight height: %f, prev raw range pos z: %f, kf pos z: %f", raw_range_sensor_value_, prev_raw_range_pos_z_, (kf->getEstimateState())(0));
-                  for(const auto& handler: estimator_->getVoHandlers()) handler->reset();
-                  return true;
-                }
+          if(vo_active)
+            {
+              /* TODO: find the invalid vo sensor, and only reset the invalid one */
+              ROS_WARN("reset all vo sensor, because the value of range sensor exceeds the max flight height: %f, prev raw range pos z: %f, estimated pos z: %f", raw_range_sensor_value_, prev_raw_range_pos_z_, (estimator_->getState(State::Z_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE))[0]);
+              for(const auto& handler: estimator_->getVoHandlers()) handler->reset();
+              return true;
             }
-          return true;
         }
+      return true;
     }
 
     void baroCallback(const spinal::BarometerConstPtr & baro_msg)
@@ -608,12 +558,8 @@ namespace sensor_plugin
           inflight_state_ = true;
           ROS_WARN("barometer: start the inflight barometer height estimation");
 
-          /* the initialization of the baro bias kf filter */
-          VectorXd input_sigma(1); input_sigma << baro_bias_noise_sigma_;
-          baro_bias_kf_->setPredictionNoiseCovariance(input_sigma);
-          baro_bias_kf_->setInputFlag();
-          baro_bias_kf_->setMeasureFlag();
-          baro_bias_kf_->setInitState(-baro_pos_z_, 0);
+          /* the baro bias is anchored again by the next baro */
+          alt_estimator_.resetBaro();
         }
       /* reset */
       if(estimator_->getLandedFlag()) inflight_state_ = false;
@@ -644,63 +590,15 @@ namespace sensor_plugin
 
       if(!inflight_state_) return;
 
-      switch(alt_estimate_mode_)
-        {
-        case ONLY_BARO_MODE :
-          for(int mode = 0; mode < 2; mode++)
-            {
-              if(!getFuserActivate(mode)) continue;
+      /* the bias is estimated with the range sensor, and holds the height without it */
+      alt_estimator_.predict((estimator_->getState(State::Z_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE))[2], stamp.toSec());
+      aerial_robot_estimation::AltitudeEstimator::Result result = alt_estimator_.updateBaro(baro_pos_z_, stamp.toSec());
+      alt_state_.states[0].state[1].z = alt_estimator_.getBaroBias();
 
-              for(auto& fuser : estimator_->getFuser(mode))
-                {
-                  string plugin_name = fuser.first;
-                  boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                  int id = kf->getId();
-                  if(id & (1 << State::Z_BASE))
-                    {
-                      if(!kf->getFilteringFlag())
-                        {
-                          //ROS_FATAL("baro: can not estiamte the height by baro(ONLY_BARO_MODE), because the filtering flag is not activated");
-                          return;
-                        }
-                      /* We should set the sigma every time, since we may have several different sensors to correct the kalman filter(e.g. vo + opti, laser + baro) */
-
-                      if(plugin_name == "kalman_filter/kf_pos_vel_acc")
-                        {
-                          /* correction */
-                          VectorXd measure_sigma(1); measure_sigma << baro_noise_sigma_;
-                          VectorXd meas(1); meas <<  baro_pos_z_ + (baro_bias_kf_->getEstimateState())(0);
-                          vector<double> params = {kf_plugin::POS};
-                          kf->correction(meas, measure_sigma, -1, params);
-
-                        }
-
-                      /* set the state */
-                      // VectorXd state = kf->getEstimateState();
-                      // estimator_->setState(State::Z_BASE, mode, 0, state(0));
-                      // estimator_->setState(State::Z_BASE, mode, 1, state(1));
-                      //alt_state_.states[0].state[1].x = state(0);
-                      //alt_state_.states[0].state[1].y = state(1);
-                      alt_state_.states[0].state[1].z = (baro_bias_kf_->getEstimateState())(0);
-
-                    }
-                }
-            }
-          break;
-        case WITHOUT_BARO_MODE:
-          {
-            baro_bias_kf_->prediction(VectorXd::Zero(1), stamp.toSec());
-            VectorXd meas(1);  meas << (estimator_->getState(State::Z_BASE, 0))[0] - baro_pos_z_;
-            baro_bias_kf_->correction(meas, VectorXd::Zero(1), -1);
-          }
-          break;
-        case WITH_BARO_MODE:
-          //TODO: this is another part, maybe we have to use another package:
-          //http://wiki.ros.org/ethzasl_sensor_fusion
-          break;
-        default:
-          break;
-        }
+      //TODO: WITH_BARO_MODE, maybe we have to use another package:
+      //http://wiki.ros.org/ethzasl_sensor_fusion
+      if(alt_estimate_mode_ == ONLY_BARO_MODE && result.valid)
+        correctFusers(result.height, baro_noise_sigma_, -1);
     }
 
     /* force to change the estimate mode */
@@ -726,11 +624,14 @@ namespace sensor_plugin
       getParam<double>("max_flight_height", max_flight_height_, -1); // [m]
 
       /* for terrain and outlier check */
-      getParam<double>("outlier_threshold", outlier_threshold_, 1.0); // [m]
-      getParam<double>("inlier_threshold", inlier_threshold_, 0.5); // [m]
+      getParam<double>("outlier_threshold", outlier_threshold_, 0.05); // [m]
       getParam<bool>("terrain_check_with_baro", terrain_check_with_baro_, false);
       getParam<double>("check_du1", check_du1_, 0.1); // [sec]
       getParam<double>("check_du2", check_du2_, 1.0); // [sec]
+      getParam<double>("check_likelihood_ratio", check_likelihood_ratio_, 100.0);
+      getParam<double>("range_dropout_time", range_dropout_time_, 0.5); // [sec]
+      getParam<double>("acc_noise_sigma", acc_noise_sigma_, 0.2); // [m/s^2]
+      getParam<double>("terrain_noise_sigma", terrain_noise_sigma_, 0.001); // [m/sqrt(s)]
 
       /* barometer */
       getParam<std::string>("barometer_sub_name", barometer_sub_name_, string("/baro"));
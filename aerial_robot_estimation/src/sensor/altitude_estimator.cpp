@@ -0,0 +1,314 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/sensor/altitude_estimator.h>
+#include <algorithm>
+
+namespace
+{
+  inline double sq(double x) { return x * x; }
+}
+
+namespace aerial_robot_estimation
+{
+  constexpr double AltitudeEstimator::CHI2_GATE_1D;
+
+  void AltitudeEstimator::Hypothesis::predict(double acc, double dt, const StateMatrix& q_rate, double acc_var)
+  {
+    StateMatrix f = StateMatrix::Identity();
+    f(Z, VZ) = dt;
+    StateVector g = StateVector::Zero();
+    g(Z) = 0.5 * dt * dt;
+    g(VZ) = dt;
+
+    x = f * x + g * acc;
+    p = f * p * f.transpose() + g * g.transpose() * acc_var + q_rate * dt;
+  }
+
+  void AltitudeEstimator::Hypothesis::innovation(const StateVector& h, double meas, double var, double& y, double& s) const
+  {
+    y = meas - h.dot(x);
+    s = h.dot(p * h) + var;
+  }
+
+  void AltitudeEstimator::Hypothesis::correct(const StateVector& h, double y, double s, double var)
+  {
+    StateVector k = p * h / s;
+    StateMatrix i_kh = StateMatrix::Identity() - k * h.transpose();
+    x += k * y;
+    p = i_kh * p * i_kh.transpose() + k * var * k.transpose();
+  }
+
+  void AltitudeEstimator::Hypothesis::anchor(int index, double meas, double var)
+  {
+    x(index) = x(Z) - meas;
+    p.row(index) = p.row(Z);
+    p.col(index) = p.col(Z);
+    p(index, index) = p(Z, Z) + var;
+  }
+
+  AltitudeEstimator::AltitudeEstimator():
+    range_var_(sq(0.01)), baro_var_(sq(0.05)), baro_bias_var_(sq(0.001)),
+    acc_var_(sq(0.2)), terrain_var_(sq(0.001)),
+    min_range_(0), max_range_(40.0),
+    terrain_check_(true),
+    min_residual_(0.05), min_check_time_(0.1), max_check_time_(1.0), log_decide_ratio_(log(100.0)),
+    dropout_time_(0.5),
+    initialized_(false), baro_initialized_(false),
+    stamp_(0), range_stamp_(0),
+    range_state_(RANGE_NONE),
+    check_start_(0), log_ratio_(0),
+    step_count_(0), outlier_count_(0), baro_reject_count_(0)
+  {
+    current_.x.setZero();
+    current_.p.setZero();
+    step_ = current_;
+  }
+
+  void AltitudeEstimator::setRangeNoise(double sigma)
+  {
+    range_var_ = sq(sigma);
+  }
+
+  void AltitudeEstimator::setBaroNoise(double sigma, double bias_sigma)
+  {
+    baro_var_ = sq(sigma);
+    baro_bias_var_ = sq(bias_sigma);
+  }
+
+  void AltitudeEstimator::setAccNoise(double sigma)
+  {
+    acc_var_ = sq(sigma);
+  }
+
+  void AltitudeEstimator::setTerrainNoise(double sigma)
+  {
+    terrain_var_ = sq(sigma);
+  }
+
+  void AltitudeEstimator::setRangeLimits(double min_range, double max_range)
+  {
+    min_range_ = min_range;
+    max_range_ = max_range;
+  }
+
+  void AltitudeEstimator::setTerrainCheck(bool enable, double min_residual, double min_check_time, double max_check_time, double ratio)
+  {
+    terrain_check_ = enable;
+    min_residual_ = min_residual;
+    min_check_time_ = min_check_time;
+    max_check_time_ = max_check_time;
+    log_decide_ratio_ = log(ratio);
+  }
+
+  void AltitudeEstimator::setDropoutTime(double dropout_time)
+  {
+    dropout_time_ = dropout_time;
+  }
+
+  void AltitudeEstimator::reset(double z, double terrain, double stamp)
+  {
+    current_.x << z, 0, terrain, 0;
+    current_.p.setZero();
+    current_.p(Z, Z) = range_var_;
+    current_.p(VZ, VZ) = sq(0.1);
+    current_.p(Z, TERRAIN) = current_.p(TERRAIN, Z) = range_var_; // the terrain is the reference of z
+    current_.p(TERRAIN, TERRAIN) = range_var_;
+    step_ = current_;
+
+    initialized_ = true;
+    baro_initialized_ = false;
+    stamp_ = stamp;
+    range_stamp_ = stamp;
+    range_state_ = RANGE_NORMAL;
+    log_ratio_ = 0;
+  }
+
+  AltitudeEstimator::StateMatrix AltitudeEstimator::processRate() const
+  {
+    StateMatrix q = StateMatrix::Zero();
+    q(TERRAIN, TERRAIN) = terrain_var_;
+    q(BARO_BIAS, BARO_BIAS) = baro_bias_var_;
+    return q;
+  }
+
+  double AltitudeEstimator::logLikelihood(double y, double s) const
+  {
+    /* uniform density of the outlier within the range */
+    double outlier = -log(std::max(max_range_ - min_range_, 1e-3));
+    return std::max(-0.5 * (log(2 * M_PI * s) + y * y / s), outlier);
+  }
+
+  void AltitudeEstimator::predict(double acc, double stamp)
+  {
+    if(!initialized_) return;
+
+    double dt = stamp - stamp_;
+    if(dt <= 0) return; // the measurement is already predicted to
+    stamp_ = stamp;
+
+    StateMatrix q_rate = processRate();
+    current_.predict(acc, dt, q_rate, acc_var_);
+    if(range_state_ == RANGE_CHECK) step_.predict(acc, dt, q_rate, acc_var_);
+
+    if(stamp - range_stamp_ > dropout_time_) range_state_ = RANGE_LOST;
+  }
+
+  AltitudeEstimator::Result AltitudeEstimator::updateRange(double range, double stamp)
+  {
+    Result result;
+    result.valid = false;
+    result.height = range + current_.x(TERRAIN);
+    result.sigma = sqrt(range_var_);
+    result.nis = -1;
+    result.terrain_step = false;
+
+    if(!initialized_) return result;
+
+    /* a short out of range (e.g. a spike below the min range) is an outlier */
+    if(stamp - range_stamp_ > dropout_time_) range_state_ = RANGE_LOST;
+    if(range < min_range_ || range > max_range_) return result;
+
+    /* the terrain under the sensor is unknown after the range is lost */
+    bool lost = range_state_ == RANGE_LOST;
+    range_stamp_ = stamp;
+    if(lost)
+      {
+        current_.anchor(TERRAIN, range, range_var_);
+        range_state_ = RANGE_NORMAL;
+        result.height = range + current_.x(TERRAIN);
+        return result;
+      }
+
+    StateVector h(1, 0, -1, 0);
+    double y, s;
+    current_.innovation(h, range, range_var_, y, s);
+    result.nis = y * y / s;
+
+    if(!terrain_check_ || (range_state_ == RANGE_NORMAL && consistent(y, s)))
+      {
+        current_.correct(h, y, s, range_var_);
+        result.valid = true;
+        result.height = range + current_.x(TERRAIN);
+        return result;
+      }
+
+    if(range_state_ != RANGE_CHECK)
+      {
+        /* start the check with the step hypothesis anchored to this range */
+        outlier_count_++;
+        step_ = current_;
+        step_.anchor(TERRAIN, range, range_var_);
+        range_state_ = RANGE_CHECK;
+        check_start_ = stamp;
+        log_ratio_ = 0;
+        return result;
+      }
+
+    double y_step, s_step;
+    step_.innovation(h, range, range_var_, y_step, s_step);
+    log_ratio_ += logLikelihood(y_step, s_step) - logLikelihood(y, s);
+
+    bool current_consistent = consistent(y, s);
+    if(current_consistent) current_.correct(h, y, s, range_var_);
+    if(consistent(y_step, s_step)) step_.correct(h, y_step, s_step, range_var_);
+
+    double elapsed = stamp - check_start_;
+    if(log_ratio_ < -log_decide_ratio_ || (elapsed >= max_check_time_ && log_ratio_ <= 0))
+      {
+        /* outlier: the current hypothesis is kept */
+        range_state_ = RANGE_NORMAL;
+      }
+    else if((log_ratio_ > log_decide_ratio_ && elapsed >= min_check_time_) || elapsed >= max_check_time_)
+      {
+        /* step of the terrain */
+        current_ = step_;
+        range_state_ = RANGE_NORMAL;
+        step_count_++;
+        result.terrain_step = true;
+        current_consistent = true;
+      }
+
+    if(!current_consistent) outlier_count_++;
+    result.valid = current_consistent;
+    result.height = range + current_.x(TERRAIN);
+    return result;
+  }
+
+  AltitudeEstimator::Result AltitudeEstimator::updateBaro(double baro, double /* stamp */)
+  {
+    Result result;
+    result.valid = false;
+    result.height = baro + current_.x(BARO_BIAS);
+    result.sigma = sqrt(baro_var_);
+    result.nis = -1;
+    result.terrain_step = false;
+
+    if(!initialized_) return result;
+
+    if(!baro_initialized_)
+      {
+        current_.anchor(BARO_BIAS, baro, baro_var_);
+        if(range_state_ == RANGE_CHECK) step_.anchor(BARO_BIAS, baro, baro_var_);
+        baro_initialized_ = true;
+        result.height = baro + current_.x(BARO_BIAS);
+        return result;
+      }
+
+    StateVector h(1, 0, 0, -1);
+    double y, s;
+    current_.innovation(h, baro, baro_var_, y, s);
+    result.nis = y * y / s;
+    result.sigma = sqrt(baro_var_ + current_.p(BARO_BIAS, BARO_BIAS));
+
+    /* the rejected baro does not shrink the bias variance, so the gate widens by the drift */
+    if(result.nis > CHI2_GATE_1D)
+      {
+        baro_reject_count_++;
+        return result;
+      }
+
+    current_.correct(h, y, s, baro_var_);
+    if(range_state_ == RANGE_CHECK)
+      {
+        step_.innovation(h, baro, baro_var_, y, s);
+        step_.correct(h, y, s, baro_var_);
+      }
+
+    result.valid = true;
+    return result;
+  }
+
+} //namespace aerial_robot_estimation
@@ -0,0 +1,342 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/sensor/extrinsic_calibrator.h>
+#include <Eigen/Eigenvalues>
+#include <Eigen/SVD>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+  Eigen::Vector3d rotationVector(const Eigen::Quaterniond& q)
+  {
+    Eigen::AngleAxisd aa(q.normalized());
+    return aa.angle() * aa.axis();
+  }
+
+  Eigen::Matrix3d skew(const Eigen::Vector3d& v)
+  {
+    Eigen::Matrix3d m;
+    m << 0, -v.z(), v.y(),
+      v.z(), 0, -v.x(),
+      -v.y(), v.x(), 0;
+    return m;
+  }
+
+  double median(std::vector<double> values)
+  {
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values.at(values.size() / 2);
+  }
+}
+
+namespace aerial_robot_estimation
+{
+  constexpr double ExtrinsicCalibrator::OUTLIER_RATIO;
+  constexpr double ExtrinsicCalibrator::ROTATION_RESIDUAL_FLOOR;
+  constexpr double ExtrinsicCalibrator::TRANSLATION_RESIDUAL_FLOOR;
+  constexpr double ExtrinsicCalibrator::PRIOR_WEIGHT;
+
+  ExtrinsicCalibrator::ExtrinsicCalibrator():
+    min_rotation_(0.2), max_interval_(1.0),
+    max_pairs_(1000),
+    estimate_translation_(true),
+    convergence_rotation_sigma_(0.005), convergence_translation_sigma_(0.005), min_pairs_(20),
+    initial_q_(Eigen::Quaterniond::Identity()), initial_t_(Eigen::Vector3d::Zero())
+  {
+    reset();
+  }
+
+  void ExtrinsicCalibrator::setPairThreshold(double min_rotation, double max_interval)
+  {
+    min_rotation_ = min_rotation;
+    max_interval_ = max_interval;
+  }
+
+  void ExtrinsicCalibrator::setMaxPairs(int size)
+  {
+    max_pairs_ = std::max(size, 3);
+    while(pairs_.size() > max_pairs_) pairs_.pop_front();
+  }
+
+  void ExtrinsicCalibrator::setEstimateTranslation(bool flag)
+  {
+    estimate_translation_ = flag;
+  }
+
+  void ExtrinsicCalibrator::setConvergence(double rotation_sigma, double translation_sigma, int min_pairs)
+  {
+    convergence_rotation_sigma_ = rotation_sigma;
+    convergence_translation_sigma_ = translation_sigma;
+    min_pairs_ = min_pairs;
+  }
+
+  void ExtrinsicCalibrator::setInitialValue(const Eigen::Quaterniond& q, const Eigen::Vector3d& t)
+  {
+    initial_q_ = q.normalized();
+    initial_t_ = t;
+    if(inlier_count_ == 0)
+      {
+        q_ = initial_q_;
+        t_ = initial_t_;
+      }
+  }
+
+  void ExtrinsicCalibrator::reset()
+  {
+    has_key_ = false;
+    pairs_.clear();
+
+    q_ = initial_q_;
+    t_ = initial_t_;
+    rotation_sigma_.setConstant(std::numeric_limits<double>::infinity());
+    translation_sigma_.setConstant(std::numeric_limits<double>::infinity());
+    rotation_residual_ = 0;
+    translation_residual_ = 0;
+    inlier_count_ = 0;
+  }
+
+  bool ExtrinsicCalibrator::add(double stamp, const Eigen::Quaterniond& body_q, const Eigen::Vector3d& body_p,
+                                const Eigen::Quaterniond& sensor_q, const Eigen::Vector3d& sensor_p)
+  {
+    Sample sample;
+    sample.stamp = stamp;
+    sample.body_q = body_q.normalized();
+    sample.body_p = body_p;
+    sample.sensor_q = sensor_q.normalized();
+    sample.sensor_p = sensor_p;
+
+    if(!has_key_)
+      {
+        key_ = sample;
+        has_key_ = true;
+        return false;
+      }
+
+    double dt = stamp - key_.stamp;
+    if(dt <= 0) return false; // out of order
+
+    /* the attitude of the imu drifts in yaw over a long gap */
+    if(dt > 2 * max_interval_)
+      {
+        key_ = sample;
+        return false;
+      }
+
+    Eigen::Quaterniond rot_a = key_.body_q.conjugate() * sample.body_q;
+    if(Eigen::AngleAxisd(rot_a).angle() < min_rotation_ && dt < max_interval_) return false;
+
+    MotionPair pair;
+    pair.alpha = rotationVector(rot_a);
+    pair.beta = rotationVector(key_.sensor_q.conjugate() * sample.sensor_q);
+    pair.rot_a = rot_a.toRotationMatrix();
+    pair.trans_a = key_.body_q.conjugate() * (sample.body_p - key_.body_p);
+    pair.trans_b = key_.sensor_q.conjugate() * (sample.sensor_p - key_.sensor_p);
+    pair.inlier = true;
+
+    pairs_.push_back(pair);
+    if(pairs_.size() > max_pairs_) pairs_.pop_front();
+
+    key_ = sample;
+    return true;
+  }
+
+  Eigen::Matrix3d ExtrinsicCalibrator::solveRotation() const
+  {
+    /* max tr(R M), M = sum(beta alpha^T) + w R_0^T */
+    Eigen::Matrix3d m = Eigen::Matrix3d::Zero();
+    double scale = 0;
+    for(const auto& pair: pairs_)
+      {
+        if(!pair.inlier) continue;
+        m += pair.beta * pair.alpha.transpose();
+        scale += pair.beta.squaredNorm();
+      }
+    m += PRIOR_WEIGHT * scale * initial_q_.toRotationMatrix().transpose();
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(m, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Matrix3d d = Eigen::Matrix3d::Identity();
+    d(2, 2) = (svd.matrixV() * svd.matrixU().transpose()).determinant() > 0 ? 1 : -1;
+    return svd.matrixV() * d * svd.matrixU().transpose();
+  }
+
+  Eigen::Vector3d ExtrinsicCalibrator::sigma(const Eigen::Matrix3d& information, double variance)
+  {
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(information);
+    const Eigen::Vector3d& lambda = solver.eigenvalues(); // increasing order
+    const Eigen::Matrix3d& v = solver.eigenvectors();
+    double threshold = std::max(lambda(2), 1e-12) * 1e-6;
+
+    Eigen::Vector3d result;
+    for(int i = 0; i < 3; i++)
+      {
+        double var = 0;
+        for(int j = 0; j < 3; j++)
+          {
+            if(v(i, j) * v(i, j) < 1e-6) continue;
+            if(lambda(j) < threshold)
+              {
+                var = std::numeric_limits<double>::infinity();
+                break;
+              }
+            var += v(i, j) * v(i, j) / lambda(j);
+          }
+        result(i) = std::sqrt(var * variance);
+      }
+    return result;
+  }
+
+  bool ExtrinsicCalibrator::solve()
+  {
+    if(pairs_.size() < 3) return false;
+
+    /* rotation with the rejection of the outliers */
+    for(auto& pair: pairs_) pair.inlier = true;
+    Eigen::Matrix3d r = Eigen::Matrix3d::Identity();
+    std::vector<double> residuals(pairs_.size());
+    int inlier_count = 0;
+    for(int iteration = 0; iteration < 3; iteration++)
+      {
+        r = solveRotation();
+
+        std::vector<double> inlier_residuals;
+        for(size_t k = 0; k < pairs_.size(); k++)
+          {
+            residuals[k] = (pairs_[k].alpha - r * pairs_[k].beta).norm();
+            if(pairs_[k].inlier) inlier_residuals.push_back(residuals[k]);
+          }
+        double threshold = std::max(OUTLIER_RATIO * median(inlier_residuals), ROTATION_RESIDUAL_FLOOR);
+
+        inlier_count = 0;
+        for(size_t k = 0; k < pairs_.size(); k++)
+          {
+            pairs_[k].inlier = residuals[k] < threshold;
+            if(pairs_[k].inlier) inlier_count++;
+          }
+        if(inlier_count < 3) return false;
+      }
+
+    /* alpha - R beta = - [R beta]x dtheta */
+    Eigen::Matrix3d information = Eigen::Matrix3d::Zero();
+    double square_sum = 0;
+    for(size_t k = 0; k < pairs_.size(); k++)
+      {
+        if(!pairs_[k].inlier) continue;
+        Eigen::Matrix3d j = skew(r * pairs_[k].beta);
+        information += j.transpose() * j;
+        square_sum += residuals[k] * residuals[k];
+      }
+    q_ = Eigen::Quaterniond(r);
+    rotation_residual_ = std::sqrt(square_sum / inlier_count);
+    rotation_sigma_ = sigma(information, square_sum / std::max(3 * inlier_count - 3, 1));
+    inlier_count_ = inlier_count;
+
+    if(!estimate_translation_) return true;
+
+    /* translation: (R_A - I) t = R t_B - t_A, the rotation outliers are excluded */
+    std::vector<bool> translation_inlier(pairs_.size());
+    for(size_t k = 0; k < pairs_.size(); k++) translation_inlier[k] = pairs_[k].inlier;
+    Eigen::Vector3d t = initial_t_;
+    for(int iteration = 0; iteration < 3; iteration++)
+      {
+        Eigen::Matrix3d c = Eigen::Matrix3d::Zero();
+        Eigen::Vector3d d = Eigen::Vector3d::Zero();
+        for(size_t k = 0; k < pairs_.size(); k++)
+          {
+            if(!translation_inlier[k]) continue;
+            Eigen::Matrix3d a = pairs_[k].rot_a - Eigen::Matrix3d::Identity();
+            c += a.transpose() * a;
+            d += a.transpose() * (r * pairs_[k].trans_b - pairs_[k].trans_a);
+          }
+
+        /* the initial value remains along the axis without the rotation */
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(c);
+        double threshold = std::max(solver.eigenvalues()(2), 1e-12) * 1e-6;
+        Eigen::Vector3d delta = d - c * initial_t_;
+        t = initial_t_;
+        for(int j = 0; j < 3; j++)
+          {
+            if(solver.eigenvalues()(j) < threshold) continue;
+            t += solver.eigenvectors().col(j) * solver.eigenvectors().col(j).dot(delta) / solver.eigenvalues()(j);
+          }
+
+        std::vector<double> inlier_residuals;
+        for(size_t k = 0; k < pairs_.size(); k++)
+          {
+            residuals[k] = ((pairs_[k].rot_a - Eigen::Matrix3d::Identity()) * t - (r * pairs_[k].trans_b - pairs_[k].trans_a)).norm();
+            if(translation_inlier[k]) inlier_residuals.push_back(residuals[k]);
+          }
+        if(iteration == 2) break;
+
+        double outlier_threshold = std::max(OUTLIER_RATIO * median(inlier_residuals), TRANSLATION_RESIDUAL_FLOOR);
+        int count = 0;
+        for(size_t k = 0; k < pairs_.size(); k++)
+          {
+            translation_inlier[k] = pairs_[k].inlier && residuals[k] < outlier_threshold;
+            if(translation_inlier[k]) count++;
+          }
+        if(count < 3) return false;
+      }
+
+    Eigen::Matrix3d c = Eigen::Matrix3d::Zero();
+    square_sum = 0;
+    int count = 0;
+    for(size_t k = 0; k < pairs_.size(); k++)
+      {
+        if(!translation_inlier[k]) continue;
+        Eigen::Matrix3d a = pairs_[k].rot_a - Eigen::Matrix3d::Identity();
+        c += a.transpose() * a;
+        square_sum += residuals[k] * residuals[k];
+        count++;
+      }
+    t_ = t;
+    translation_residual_ = std::sqrt(square_sum / count);
+    translation_sigma_ = sigma(c, square_sum / std::max(3 * count - 3, 1));
+
+    return true;
+  }
+
+  bool ExtrinsicCalibrator::converged() const
+  {
+    if(inlier_count_ < min_pairs_) return false;
+    if(rotation_sigma_.maxCoeff() > convergence_rotation_sigma_) return false;
+    if(estimate_translation_ && translation_sigma_.maxCoeff() > convergence_translation_sigma_) return false;
+    return true;
+  }
+
+} //namespace aerial_robot_estimation
@@ -0,0 +1,309 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/sensor/gnss_front_end.h>
+#include <cmath>
+
+namespace
+{
+  /* wgs84 */
+  const double SEMI_MAJOR_AXIS = 6378137.0; // [m]
+  const double FLATTENING = 1 / 298.257223563;
+  const double ECCENTRICITY2 = FLATTENING * (2 - FLATTENING);
+  const double DEG2RAD = M_PI / 180.0;
+
+  inline double sq(double x) { return x * x; }
+}
+
+namespace aerial_robot_estimation
+{
+  constexpr double GnssFrontEnd::CHI2_GATE_2D;
+  constexpr double GnssFrontEnd::CHI2_GATE_3D;
+
+  Eigen::Vector3d LocalTangentPlane::geodeticToEcef(double latitude, double longitude, double altitude)
+  {
+    double s_lat = sin(latitude * DEG2RAD), c_lat = cos(latitude * DEG2RAD);
+    double s_lon = sin(longitude * DEG2RAD), c_lon = cos(longitude * DEG2RAD);
+    double n = SEMI_MAJOR_AXIS / sqrt(1 - ECCENTRICITY2 * s_lat * s_lat); // prime vertical radius
+    return Eigen::Vector3d((n + altitude) * c_lat * c_lon,
+                           (n + altitude) * c_lat * s_lon,
+                           (n * (1 - ECCENTRICITY2) + altitude) * s_lat);
+  }
+
+  void LocalTangentPlane::setOrigin(double latitude, double longitude, double altitude)
+  {
+    double s_lat = sin(latitude * DEG2RAD), c_lat = cos(latitude * DEG2RAD);
+    double s_lon = sin(longitude * DEG2RAD), c_lon = cos(longitude * DEG2RAD);
+
+    origin_ecef_ = geodeticToEcef(latitude, longitude, altitude);
+    ecef_to_enu_ <<
+      -s_lon, c_lon, 0,
+      -s_lat * c_lon, -s_lat * s_lon, c_lat,
+      c_lat * c_lon, c_lat * s_lon, s_lat;
+    initialized_ = true;
+  }
+
+  Eigen::Vector3d LocalTangentPlane::toEnu(double latitude, double longitude, double altitude) const
+  {
+    return ecef_to_enu_ * (geodeticToEcef(latitude, longitude, altitude) - origin_ecef_);
+  }
+
+  void LocalTangentPlane::toGeodetic(const Eigen::Vector3d& enu, double& latitude, double& longitude, double& altitude) const
+  {
+    Eigen::Vector3d ecef = origin_ecef_ + ecef_to_enu_.transpose() * enu;
+
+    /* fixed point iteration of the latitude, converged to sub-mm in a few steps near the surface */
+    double p = hypot(ecef.x(), ecef.y());
+    double lat = atan2(ecef.z(), p * (1 - ECCENTRICITY2));
+    double h = 0;
+    for(int i = 0; i < 5; i++)
+      {
+        double s_lat = sin(lat);
+        double n = SEMI_MAJOR_AXIS / sqrt(1 - ECCENTRICITY2 * s_lat * s_lat);
+        h = p / cos(lat) - n;
+        lat = atan2(ecef.z(), p * (1 - ECCENTRICITY2 * n / (n + h)));
+      }
+
+    latitude = lat / DEG2RAD;
+    longitude = atan2(ecef.y(), ecef.x()) / DEG2RAD;
+    altitude = h;
+  }
+
+  GnssFrontEnd::GnssFrontEnd():
+    pos_sigma_(1.0), vel_sigma_(0.1),
+    max_speed_(15.0), max_acc_(5.0),
+    dropout_time_(1.0), max_reject_time_(5.0), reacquire_count_(3),
+    gate_scale_(1.0),
+    reject_count_(0), vel_reject_count_(0)
+  {
+    reset();
+  }
+
+  void GnssFrontEnd::setNoise(double pos_sigma, double vel_sigma)
+  {
+    pos_sigma_ = pos_sigma;
+    vel_sigma_ = vel_sigma;
+  }
+
+  void GnssFrontEnd::setBounds(double max_speed, double max_acc)
+  {
+    max_speed_ = max_speed;
+    max_acc_ = max_acc;
+  }
+
+  void GnssFrontEnd::setTimeout(double dropout_time, double max_reject_time, int reacquire_count)
+  {
+    dropout_time_ = dropout_time;
+    max_reject_time_ = max_reject_time;
+    reacquire_count_ = reacquire_count;
+  }
+
+  void GnssFrontEnd::setGateScale(double scale)
+  {
+    gate_scale_ = scale;
+  }
+
+  void GnssFrontEnd::reset()
+  {
+    ref_valid_ = false;
+    ref_vel_valid_ = false;
+    ref_stamp_ = 0;
+    ref_pos_.setZero();
+    ref_vel_.setZero();
+    ref_pos_var_ = 0;
+    ref_vel_var_ = 0;
+    ref_measured_ = false;
+    diff_vel_valid_ = false;
+    diff_vel_.setZero();
+    diff_vel_var_ = 0;
+    reject_start_ = -1;
+    vel_reject_start_ = -1;
+    consistent_count_ = 0;
+  }
+
+  void GnssFrontEnd::anchor(const GnssFix& fix, const Eigen::Vector3d& pos, double pos_var, bool vel_valid, double vel_var)
+  {
+    ref_valid_ = true;
+    ref_stamp_ = fix.stamp;
+    ref_pos_ = pos;
+    ref_pos_var_ = pos_var;
+    ref_vel_valid_ = vel_valid;
+    ref_vel_ = vel_valid ? fix.velocity : Eigen::Vector3d::Zero();
+    ref_vel_var_ = vel_var;
+    ref_measured_ = true;
+    diff_vel_valid_ = false;
+    reject_start_ = -1;
+    vel_reject_start_ = -1;
+    consistent_count_ = 1;
+  }
+
+  GnssFrontEnd::Result GnssFrontEnd::update(const GnssFix& fix)
+  {
+    Result result;
+    result.pos_valid = false;
+    result.vel_valid = false;
+    result.pos = Eigen::Vector3d::Zero();
+    result.vel = fix.velocity;
+    result.chi2 = -1;
+
+    if(!fix.fix) return result;
+
+    /* the altitude of the geodetic fix is not gated */
+    int dims = 3;
+    if(fix.has_local_position) result.pos = fix.local_position;
+    else if(fix.has_geodetic && plane_.initialized())
+      {
+        result.pos = plane_.toEnu(fix.latitude, fix.longitude, fix.altitude);
+        dims = 2;
+      }
+    else return result;
+
+    double pos_var = sq(fix.pos_sigma > 0 ? fix.pos_sigma : pos_sigma_);
+    double vel_var = sq(fix.vel_sigma > 0 ? fix.vel_sigma : vel_sigma_);
+    result.pos_sigma = sqrt(pos_var);
+    result.vel_sigma = sqrt(vel_var);
+
+    bool vel_valid = fix.has_velocity && fix.velocity.head(dims).norm() <= max_speed_;
+
+    double dt = fix.stamp - ref_stamp_;
+    if(ref_valid_ && dt <= 0) return result; // duplicated or out of order
+
+    /* first fix or dropout */
+    if(!ref_valid_ || dt > dropout_time_)
+      {
+        anchor(fix, result.pos, pos_var, vel_valid, vel_var);
+        result.pos_valid = consistent_count_ >= reacquire_count_;
+        result.vel_valid = vel_valid && result.pos_valid;
+        return result;
+      }
+
+    /* velocity jump beyond the acceleration bound */
+    if(vel_valid && ref_vel_valid_ &&
+       (fix.velocity - ref_vel_).head(dims).norm() > max_acc_ * dt + 3 * sqrt(vel_var + ref_vel_var_))
+      vel_valid = false;
+
+    /* prediction from the reference by the mean velocity */
+    Eigen::Vector3d vel = Eigen::Vector3d::Zero();
+    double process_var = sq(max_speed_ * dt);
+    if(ref_vel_valid_ && vel_valid)
+      {
+        vel = (ref_vel_ + fix.velocity) / 2;
+        process_var = (ref_vel_var_ + vel_var) / 4 * sq(dt) + sq(0.25 * max_acc_ * dt * dt);
+      }
+    else if(ref_vel_valid_ || vel_valid)
+      {
+        vel = ref_vel_valid_ ? ref_vel_ : fix.velocity;
+        process_var = (ref_vel_valid_ ? ref_vel_var_ : vel_var) * sq(dt) + sq(0.5 * max_acc_ * dt * dt);
+      }
+    else if(diff_vel_valid_)
+      {
+        /* without the velocity from the receiver, e.g. NavSatFix and the rtk pose */
+        vel = diff_vel_;
+        process_var = diff_vel_var_ * sq(dt) + sq(0.5 * max_acc_ * dt * dt);
+      }
+    Eigen::Vector3d predicted_pos = ref_pos_ + vel * dt;
+    double predicted_var = ref_pos_var_ + process_var;
+
+    /* chi-square gate of the position innovation */
+    result.chi2 = (result.pos - predicted_pos).head(dims).squaredNorm() / (predicted_var + pos_var);
+    bool pos_consistent = result.chi2 <= gate_scale_ * (dims == 2 ? CHI2_GATE_2D : CHI2_GATE_3D);
+
+    if(pos_consistent)
+      {
+        /* velocity by the difference of the consistent positions */
+        if(ref_measured_)
+          {
+            diff_vel_ = (result.pos - ref_pos_) / dt;
+            diff_vel_var_ = (pos_var + ref_pos_var_) / sq(dt);
+            diff_vel_valid_ = diff_vel_.head(dims).norm() <= max_speed_;
+          }
+        ref_pos_ = result.pos;
+        ref_pos_var_ = pos_var;
+        ref_measured_ = true;
+        reject_start_ = -1;
+        consistent_count_++;
+      }
+    else
+      {
+        reject_count_++;
+
+        /* not consistent with each other before the reacquisition, or rejected for too long: the new fix is the reference */
+        if(reject_start_ < 0) reject_start_ = fix.stamp;
+        if(consistent_count_ < reacquire_count_ || fix.stamp - reject_start_ >= max_reject_time_)
+          {
+            anchor(fix, result.pos, pos_var, vel_valid, vel_var);
+            result.pos_valid = consistent_count_ >= reacquire_count_;
+            result.vel_valid = vel_valid && result.pos_valid;
+            return result;
+          }
+
+        /* dead reckoning */
+        ref_pos_ = predicted_pos;
+        ref_pos_var_ = predicted_var;
+        ref_measured_ = false;
+      }
+
+    if(vel_valid)
+      {
+        ref_vel_valid_ = true;
+        ref_vel_ = fix.velocity;
+        ref_vel_var_ = vel_var;
+        vel_reject_start_ = -1;
+      }
+    else if(fix.has_velocity)
+      {
+        vel_reject_count_++;
+        if(vel_reject_start_ < 0) vel_reject_start_ = fix.stamp;
+        if(fix.stamp - vel_reject_start_ >= max_reject_time_)
+          {
+            /* persistent: the new velocity is the reference */
+            ref_vel_valid_ = fix.velocity.head(dims).norm() <= max_speed_;
+            ref_vel_ = fix.velocity;
+            ref_vel_var_ = vel_var;
+            vel_reject_start_ = -1;
+          }
+        else ref_vel_var_ += sq(max_acc_ * dt);
+      }
+    else if(ref_vel_valid_) ref_vel_var_ += sq(max_acc_ * dt);
+
+    ref_stamp_ = fix.stamp;
+
+    bool reacquired = consistent_count_ >= reacquire_count_;
+    result.pos_valid = pos_consistent && reacquired;
+    result.vel_valid = vel_valid && reacquired;
+    return result;
+  }
+
+} //namespace aerial_robot_estimation
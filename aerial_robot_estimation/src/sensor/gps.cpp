@@ -78,7 +78,9 @@ namespace sensor_plugin
     prev_raw_pos_(0, 0, 0),
     vel_(0, 0, 0),
     raw_vel_(0, 0, 0),
-    pos_offset_(0, 0, 0)
+    pos_offset_(0, 0, 0),
+    pos_valid_(false),
+    vel_valid_(false)
   {
     gps_state_.states.resize(2);
     gps_state_.states[0].id = "x";
@@ -137,11 +139,39 @@ namespace sensor_plugin
 
     if(is_rtk_gps_) only_use_pos_ = true;
     else only_use_pos_ = false;
+
+    double max_speed, max_acc, dropout_time, max_reject_time, gate_scale;
+    int reacquire_count;
+    getParam<double>("max_speed", max_speed, 15.0);
+    getParam<double>("max_acc", max_acc, 5.0);
+    getParam<double>("dropout_time", dropout_time, 1.0);
+    getParam<double>("max_reject_time", max_reject_time, 5.0);
+    getParam<int>("reacquire_count", reacquire_count, 3);
+    getParam<double>("gate_scale", gate_scale, 1.0);
+    front_end_.setNoise(pos_noise_sigma_, vel_noise_sigma_);
+    front_end_.setBounds(max_speed, max_acc);
+    front_end_.setTimeout(dropout_time, max_reject_time, reacquire_count);
+    front_end_.setGateScale(gate_scale);
   }
 
   void Gps::gpsCallback(const spinal::Gps::ConstPtr & gps_msg)
   {
+    aerial_robot_estimation::GnssFix fix;
+    fix.source = aerial_robot_estimation::GnssFix::SPINAL;
+    fix.stamp = gps_msg->stamp.toSec();
+    fix.fix = true; // by the satellite number
+    fix.sat_num = gps_msg->sat_num;
+    fix.has_geodetic = true;
+    fix.latitude = gps_msg->location[0];
+    fix.longitude = gps_msg->location[1];
+    fix.has_velocity = true;
+    fix.velocity = Vector3d(gps_msg->velocity[1], gps_msg->velocity[0], 0); // NED -> ENU
+
+    fixProcess(fix);
+  }
 
+  void Gps::fixProcess(const aerial_robot_estimation::GnssFix& fix)
+  {
     if(!updateBaseLink2SensorTransform()) return;
 
     /* check other gps modules */
@@ -160,14 +190,12 @@ namespace sensor_plugin
       }
 
     /* temporal update */
-    double curr_timestamp = gps_msg->stamp.toSec() + delay_;
+    double curr_timestamp = fix.stamp + delay_;
 
-    /* assignment lat/lon, velocity */
-    curr_wgs84_point_ = geodesy::toMsg(gps_msg->location[0], gps_msg->location[1]);
+    /* assignment lat/lon */
+    curr_wgs84_point_ = geodesy::toMsg(fix.latitude, fix.longitude);
     if(!has_rtk_gps || is_rtk_gps_) estimator_->setCurrGpsPoint(curr_wgs84_point_);
 
-    raw_vel_ = tf::Vector3(gps_msg->velocity[0], -gps_msg->velocity[1], 0); // NED frame -> XYZ frame
-
     /* to get the correction rotation and omega of baselink with the consideration of time delay */
     bool imu_initialized = false;
     for(const auto& handler: estimator_->getImuHandlers())
@@ -186,13 +214,13 @@ namespace sensor_plugin
 
     /* fusion process */
     /* quit if the satellite number is too low */
-    if(gps_msg->sat_num >= min_est_sat_num_)
+    if(fix.sat_num >= min_est_sat_num_)
       {
         if(getStatus() == Status::INVALID) setStatus(prev_status_);
       }
-    if(gps_msg->sat_num < min_est_sat_num_)
+    if(fix.sat_num < min_est_sat_num_)
       {
-        if(getStatus() == Status::ACTIVE) ROS_WARN_THROTTLE(1, "the satellite is not enough: %d", gps_msg->sat_num);
+        if(getStatus() == Status::ACTIVE) ROS_WARN_THROTTLE(1, "the satellite is not enough: %d", fix.sat_num);
         setStatus(Status::INVALID);
       }
 
@@ -204,12 +232,19 @@ namespace sensor_plugin
 
         /* set base position */
         base_wgs84_point_ = curr_wgs84_point_;
+        front_end_.getTangentPlane().setOrigin(fix.latitude, fix.longitude, 0);
         ROS_WARN("base lat/lon: [%f, %f] deg for %s GPS", base_wgs84_point_.latitude, base_wgs84_point_.longitude, is_rtk_gps_?std::string("RTK").c_str():std::string("normal").c_str());
         return;
       }
 
     if(is_rtk_gps_) return; // do not do esimation
 
+    /* consistency of the antenna position and velocity in the tangent plane at the base point */
+    aerial_robot_estimation::GnssFrontEnd::Result result = front_end_.update(fix);
+    pos_valid_ = result.pos_valid;
+    vel_valid_ = result.vel_valid;
+    if(!pos_valid_ && result.chi2 >= 0) ROS_WARN_THROTTLE(1, "gps: reject the position, chi2: %f", result.chi2);
+
     /* get the position and velocity  w.r.t. the local frame (the origin is the initial takeoff place) */
     tf::Matrix3x3 r; r.setIdentity();
     tf::Vector3 omega(0,0,0);
@@ -217,15 +252,15 @@ namespace sensor_plugin
     if(!estimator_->findRotOmega(curr_timestamp, mode, r, omega) && estimator_->getFlyingFlag())
       ROS_WARN_STREAM("gps: the omega is not updated from findRotOmega");
 
+    raw_vel_ = tf::Vector3(result.vel.y(), -result.vel.x(), 0); // ENU -> XYZ
     raw_vel_ += r * (- omega.cross(sensor_tf_.getOrigin())); //offset from gps to baselink
 
-    tf::Matrix3x3 convert_frame; convert_frame.setRPY(M_PI, 0, 0); // NED -> XYZ
-    raw_pos_ = convert_frame * Gps::wgs84ToNedLocalFrame(base_wgs84_point_, curr_wgs84_point_) - r * sensor_tf_.getOrigin();
+    raw_pos_ = tf::Vector3(result.pos.y(), -result.pos.x(), 0) - r * sensor_tf_.getOrigin(); // ENU -> XYZ
 
     /* update timestamp for estimation */
     curr_timestamp_ = curr_timestamp;
 
-    estimateProcess();
+    if(pos_valid_ || vel_valid_) estimateProcess();
 
     /* update the timestamp */
     gps_state_.header.stamp.fromSec(curr_timestamp);
@@ -266,28 +301,38 @@ namespace sensor_plugin
 
     ROS_DEBUG("gps utc time %f; spinal time: %f", fix_ros_time.toSec(), gps_full_msg->stamp.toSec() + delay_);
 
-    spinal::Gps::Ptr gps_msg(new spinal::Gps());
-    gps_msg->stamp = gps_full_msg->stamp;
-    gps_msg->location[0] = gps_full_msg->location[0];
-    gps_msg->location[1] = gps_full_msg->location[1];
-    gps_msg->velocity[0] = gps_full_msg->velocity[0];
-    gps_msg->velocity[1] = gps_full_msg->velocity[1];
-    gps_msg->sat_num = gps_full_msg->sat_num;
-
-    gpsCallback(boost::const_pointer_cast<const spinal::Gps>(gps_msg));
+    aerial_robot_estimation::GnssFix fix;
+    fix.source = aerial_robot_estimation::GnssFix::SPINAL;
+    fix.stamp = gps_full_msg->stamp.toSec();
+    fix.fix = gps_full_msg->status >= spinal::GpsFull::FIX_TYPE_2D && gps_full_msg->status <= spinal::GpsFull::FIX_TYPE_GNSS_DEAD_RECKONING_COMBINED;
+    fix.sat_num = gps_full_msg->sat_num;
+    fix.has_geodetic = true;
+    fix.latitude = gps_full_msg->location[0];
+    fix.longitude = gps_full_msg->location[1];
+    fix.has_velocity = true;
+    fix.velocity = Vector3d(gps_full_msg->velocity[1], gps_full_msg->velocity[0], 0); // NED -> ENU
+    fix.pos_sigma = gps_full_msg->h_acc * 1e-3; // [mm] -> [m]
+    fix.vel_sigma = gps_full_msg->v_acc * 1e-3;
+
+    fixProcess(fix);
   }
 
   void Gps::gpsRosCallback(const sensor_msgs::NavSatFix::ConstPtr & gps_msg)
   {
     /* TODO: add velocity */
-    spinal::Gps::Ptr spinal_gps_msg(new spinal::Gps());
-    spinal_gps_msg->stamp = gps_msg->header.stamp;
-    spinal_gps_msg->location[0] = gps_msg->latitude;
-    spinal_gps_msg->location[1] = gps_msg->longitude;
-
-    if(gps_msg->status.status >= sensor_msgs::NavSatStatus::STATUS_FIX)
-      spinal_gps_msg->sat_num = min_est_sat_num_; // temporarily
-    gpsCallback(boost::const_pointer_cast<const spinal::Gps>(spinal_gps_msg));
+    aerial_robot_estimation::GnssFix fix;
+    fix.source = aerial_robot_estimation::GnssFix::NAV_SAT_FIX;
+    fix.stamp = gps_msg->header.stamp.toSec();
+    fix.fix = gps_msg->status.status >= sensor_msgs::NavSatStatus::STATUS_FIX;
+    if(fix.fix) fix.sat_num = min_est_sat_num_; // temporarily, no satellite number in NavSatFix
+    fix.has_geodetic = true;
+    fix.latitude = gps_msg->latitude;
+    fix.longitude = gps_msg->longitude;
+    fix.altitude = gps_msg->altitude;
+    if(gps_msg->position_covariance_type != sensor_msgs::NavSatFix::COVARIANCE_TYPE_UNKNOWN)
+      fix.pos_sigma = sqrt(std::max(gps_msg->position_covariance[0], gps_msg->position_covariance[4]));
+
+    fixProcess(fix);
   }
 
 
@@ -325,13 +370,26 @@ namespace sensor_plugin
     if(rtk_offset_) raw_pos_ -= pos_offset_;
     // TODO: add offset for z axis if we use altitude from RTK GPS
 
+    /* consistency of the local position */
+    aerial_robot_estimation::GnssFix fix;
+    fix.source = aerial_robot_estimation::GnssFix::RTK_POSE;
+    fix.stamp = rtk_gps_msg->header.stamp.toSec();
+    fix.fix = true;
+    fix.has_local_position = true;
+    fix.local_position = Vector3d(raw_pos_.x(), raw_pos_.y(), raw_pos_.z());
+    fix.pos_sigma = pos_noise_sigma_;
+    aerial_robot_estimation::GnssFrontEnd::Result result = front_end_.update(fix);
+    pos_valid_ = result.pos_valid;
+    vel_valid_ = false;
+
     if(getStatus() == Status::INIT)
       {
         activate();
         setStatus(Status::ACTIVE);
       }
 
-    estimateProcess();
+    if(pos_valid_) estimateProcess();
+    else ROS_WARN_THROTTLE(1, "RTK GPS: reject the position, chi2: %f", result.chi2);
 
     /* update the timestamp */
     gps_state_.header.stamp.fromSec(curr_timestamp_);
@@ -363,6 +421,11 @@ namespace sensor_plugin
           }
       }
 
+    /* the measurements passing the front-end */
+    bool use_pos = pos_valid_ && !only_use_vel_;
+    bool use_vel = vel_valid_ && !only_use_pos_;
+    if(!use_pos && !use_vel) return;
+
     /* fuser for 0: egomotion, 1: experiment */
     for(int mode = 0; mode < 2; mode++)
       {
@@ -384,7 +447,7 @@ namespace sensor_plugin
 
                     int index = id >> (State::X_BASE + 1);
 
-                    if(only_use_pos_)
+                    if(!use_vel)
                       {
                         VectorXd meas(1); meas <<  raw_pos_[index];
                         vector<double> params = {kf_plugin::POS};
@@ -393,7 +456,7 @@ namespace sensor_plugin
                         kf->correction(meas, measure_sigma,
                                        time_sync_?(curr_timestamp_):-1, params);
                       }
-                    else if(only_use_vel_)
+                    else if(!use_pos)
                       {
                         VectorXd meas(1); meas <<  raw_vel_[index];
                         vector<double> params = {kf_plugin::VEL};
@@ -34,12 +34,8 @@
  *********************************************************************/
 
 #include <aerial_robot_estimation/sensor/imu.h>
-
-namespace
-{
-  int bias_calib = 0;
-  ros::Time prev_time;
-}
+#include <aerial_robot_estimation/kf/xy_roll_pitch_bias_plugin.h>
+#include <aerial_robot_estimation/kf/xyz_pos_vel_acc_plugin.h>
 
 namespace sensor_plugin
 {
@@ -57,8 +53,17 @@ namespace sensor_plugin
     acc_bias_l_(0, 0, 0),
     acc_bias_w_(0, 0, 0),
     sensor_dt_(0),
-    treat_imu_as_ground_truth_(true)
+    treat_imu_as_ground_truth_(true),
+    bias_calib_(0),
+    pos_vel_acc_input_(1),
+    xy_bias_input_(5),
+    xyz_input_(6),
+    pos_vel_acc_params_(1),
+    xy_bias_params_(7),
+    xyz_params_(4)
   {
+    state_batch_.reserve(64);
+
     state_.states.resize(3);
     state_.states[0].id = "x";
     state_.states[0].state.resize(2);
@@ -79,6 +84,8 @@ namespace sensor_plugin
     std::string topic_name;
     getParam<std::string>("imu_topic_name", topic_name, string("imu"));
     imu_sub_ = nh_.subscribe<spinal::Imu>(topic_name, 10, &Imu::ImuCallback, this);
+    getParam<std::string>("imu_batch_topic_name", topic_name, string("imu_batch"));
+    imu_batch_sub_ = nh_.subscribe<spinal::ImuBatch>(topic_name, 10, &Imu::ImuBatchCallback, this);
     imu_pub_ = indexed_nhp_.advertise<sensor_msgs::Imu>(string("ros_converted"), 1);
     acc_pub_ = indexed_nhp_.advertise<aerial_robot_msgs::Acc>("acc_only", 2);
   }
@@ -106,19 +113,62 @@ namespace sensor_plugin
     updateHealthStamp();
   }
 
+  void Imu::ImuBatchCallback(const spinal::ImuBatchConstPtr& imu_msg)
+  {
+    for(int i = 0; i < 3; i++)
+      {
+        if(std::isnan(imu_msg->gyro_scale) || std::isnan(imu_msg->acc_scale) ||
+           std::isnan(imu_msg->angles[i]) || std::isnan(imu_msg->mag_data[i]))
+          {
+            ROS_ERROR_THROTTLE(1.0, "IMU sensor publishes Nan value!");
+            return;
+          }
+      }
+
+    if(!batch_unpacker_.unpack(imu_msg->stamp.toSec(), imu_msg->tick_delta,
+                               imu_msg->gyro_scale, imu_msg->gyro_data, imu_msg->acc_scale, imu_msg->acc_data,
+                               Eigen::Vector3d(imu_msg->angles[0], imu_msg->angles[1], imu_msg->angles[2])))
+      {
+        ROS_ERROR_THROTTLE(1.0, "IMU: invalid batch, %d samples, %d gyro data, %d acc data", (int)imu_msg->tick_delta.size(),
+                           (int)imu_msg->gyro_data.size(), (int)imu_msg->acc_data.size());
+        return;
+      }
+
+    /* the filters are updated by every sample, the results are published once at the last sample */
+    bool updated = false;
+    for(const auto& sample: batch_unpacker_.getSamples())
+      {
+        imu_stamp_ = imu_msg->stamp + ros::Duration(sample.tick * 1e-3);
+        for(int i = 0; i < 3; i++)
+          {
+            omega_[i] = sample.gyro(i);
+            acc_b_[i] = sample.acc(i);
+            euler_[i] = sample.euler(i);
+          }
+        updated = updateState();
+      }
+
+    for(int i = 0; i < 3; i++) mag_[i] = imu_msg->mag_data[i];
+    if(updated) publishState();
+    updateHealthStamp();
+  }
+
   void Imu::estimateProcess()
   {
-    if(imu_stamp_.toSec() <= prev_time.toSec())
+    if(updateState()) publishState();
+  }
+
+  bool Imu::updateState()
+  {
+    if(imu_stamp_.toSec() <= prev_time_.toSec())
       {
         ROS_WARN("IMU: bad timestamp. curr time stamp: %f, prev time stamp: %f",
-                 imu_stamp_.toSec(), prev_time.toSec());
-        return;
+                 imu_stamp_.toSec(), prev_time_.toSec());
+        return false;
       }
 
     /* set the time internal */
-    sensor_dt_ = imu_stamp_.toSec() - prev_time.toSec();
-
-    tf::Matrix3x3 r; r.setRPY(euler_[0], euler_[1], euler_[2]);
+    sensor_dt_ = imu_stamp_.toSec() - prev_time_.toSec();
 
     /* project acc onto level frame using body frame value */
     tf::Matrix3x3 orientation;
@@ -138,58 +188,58 @@ namespace sensor_plugin
         estimator_->setLandedFlag(true);
       }
 
-    /* base link */
-    /* roll & pitch */
-    estimator_->setState(State::ROLL_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE, 0, euler_[0]);
-    estimator_->setState(State::PITCH_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE, 0, euler_[1]);
-    estimator_->setState(State::ROLL_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 0, euler_[0]);
-    estimator_->setState(State::PITCH_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 0, euler_[1]);
-
-    /* yaw */
-    if(!estimator_->getStateStatus(State::YAW_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE))
-      estimator_->setState(State::YAW_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE, 0, euler_[2]);
+    /* all the states of this sample are written back in one batch at the end */
+    states_ = estimator_->getStates();
+    state_batch_.clear();
 
-    if(!estimator_->getStateStatus(State::YAW_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE))
-      estimator_->setState(State::YAW_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 0, euler_[2]);
-
-    estimator_->setAngularVel(Frame::BASELINK, aerial_robot_estimation::EGOMOTION_ESTIMATE, omega_);
-    estimator_->setAngularVel(Frame::BASELINK, aerial_robot_estimation::EXPERIMENT_ESTIMATE, omega_);
-
-    /* COG */
-    /* TODO: only imu can assign to cog state for estimate mode and experiment mode */
     tf::Transform cog2baselink_tf;
     tf::transformKDLToTF(robot_model_->getCog2Baselink<KDL::Frame>(), cog2baselink_tf);
+    tf::Vector3 cog_omega = cog2baselink_tf.getBasis() * omega_;
 
-    double roll, pitch, yaw;
-    (estimator_->getOrientation(Frame::BASELINK, aerial_robot_estimation::EGOMOTION_ESTIMATE) * cog2baselink_tf.inverse().getBasis()).getRPY(roll, pitch, yaw);
-    estimator_->setEuler(Frame::COG, aerial_robot_estimation::EGOMOTION_ESTIMATE, tf::Vector3(roll, pitch, yaw));
-    estimator_->setAngularVel(Frame::COG, aerial_robot_estimation::EGOMOTION_ESTIMATE, cog2baselink_tf.getBasis() * omega_);
-
-    (estimator_->getOrientation(Frame::BASELINK, aerial_robot_estimation::EXPERIMENT_ESTIMATE) * cog2baselink_tf.inverse().getBasis()).getRPY(roll, pitch, yaw);
-    estimator_->setEuler(Frame::COG, aerial_robot_estimation::EXPERIMENT_ESTIMATE, tf::Vector3(roll, pitch, yaw));
-    estimator_->setAngularVel(Frame::COG, aerial_robot_estimation::EXPERIMENT_ESTIMATE, cog2baselink_tf.getBasis() * omega_);
+    for(int mode = aerial_robot_estimation::EGOMOTION_ESTIMATE; mode <= aerial_robot_estimation::EXPERIMENT_ESTIMATE; mode++)
+      {
+        /* base link */
+        /* roll & pitch */
+        batchState(State::ROLL_BASE, mode, 0, euler_[0]);
+        batchState(State::PITCH_BASE, mode, 0, euler_[1]);
+
+        /* yaw */
+        if(!states_[State::YAW_BASE][mode].first)
+          batchState(State::YAW_BASE, mode, 0, euler_[2]);
+
+        batchVector(State::ROLL_BASE, mode, 1, omega_);
+
+        /* COG */
+        /* TODO: only imu can assign to cog state for estimate mode and experiment mode */
+        double roll, pitch, yaw;
+        (batchedOrientation(Frame::BASELINK, mode) * cog2baselink_tf.inverse().getBasis()).getRPY(roll, pitch, yaw);
+        batchVector(State::ROLL_COG, mode, 0, tf::Vector3(roll, pitch, yaw));
+        batchVector(State::ROLL_COG, mode, 1, cog_omega);
+      }
 
     /* Ground Truth if necessary */
     if(treat_imu_as_ground_truth_)
       {
+        int mode = aerial_robot_estimation::GROUND_TRUTH;
         /* set baselink angles for roll and pitch, yaw is obtained from mocap */
-        estimator_->setState(State::ROLL_BASE, aerial_robot_estimation::GROUND_TRUTH, 0, euler_[0]);
-        estimator_->setState(State::PITCH_BASE, aerial_robot_estimation::GROUND_TRUTH, 0, euler_[1]);
+        batchState(State::ROLL_BASE, mode, 0, euler_[0]);
+        batchState(State::PITCH_BASE, mode, 0, euler_[1]);
         /* set cog angles for all axes */
-        (estimator_->getOrientation(Frame::BASELINK, aerial_robot_estimation::GROUND_TRUTH) * cog2baselink_tf.inverse().getBasis()).getRPY(roll, pitch, yaw);
-        estimator_->setEuler(Frame::COG, aerial_robot_estimation::GROUND_TRUTH, tf::Vector3(roll, pitch, yaw));
+        double roll, pitch, yaw;
+        (batchedOrientation(Frame::BASELINK, mode) * cog2baselink_tf.inverse().getBasis()).getRPY(roll, pitch, yaw);
+        batchVector(State::ROLL_COG, mode, 0, tf::Vector3(roll, pitch, yaw));
         /* set baselink angular velocity for all axes using imu omega */
-        estimator_->setAngularVel(Frame::BASELINK, aerial_robot_estimation::GROUND_TRUTH, omega_);
+        batchVector(State::ROLL_BASE, mode, 1, omega_);
         /* set cog angular velocity for all axes using imu omega */
-        estimator_->setAngularVel(Frame::COG, aerial_robot_estimation::GROUND_TRUTH, cog2baselink_tf.getBasis() * omega_);
+        batchVector(State::ROLL_COG, mode, 1, cog_omega);
       }
 
     /* bais calibration */
-    if(bias_calib < calib_count_)
+    if(bias_calib_ < calib_count_)
       {
-        bias_calib ++;
+        bias_calib_ ++;
 
-        if(bias_calib == 100) // warm up for callback to be stable subscribe
+        if(bias_calib_ == 100) // warm up for callback to be stable subscribe
           {
             calib_count_ = calib_time_ / sensor_dt_;
             ROS_WARN("calib count is %d", calib_count_);
@@ -200,7 +250,7 @@ namespace sensor_plugin
         /* acc bias */
         acc_bias_l_ += acc_l_;
 
-        if(bias_calib == calib_count_)
+        if(bias_calib_ == calib_count_)
           {
             acc_bias_l_ /= calib_count_;
             ROS_WARN("accX bias is %f, accY bias is %f, accZ bias is %f, dt is %f[sec]", acc_bias_l_.x(), acc_bias_l_.y(), acc_bias_l_.z(), sensor_dt_);
@@ -209,220 +259,282 @@ namespace sensor_plugin
 
             setStatus(Status::ACTIVE);
 
-            /* fuser for 0: egomotion, 1: experiment */
-            for(int mode = 0; mode < 2; mode++)
-              {
-                if(!getFuserActivate(mode)) continue;
-
-                tf::Matrix3x3 orientation;
-                orientation.setRPY(0, 0, (estimator_->getState(State::YAW_BASE, mode))[0]);
-                acc_bias_w_ = orientation * acc_bias_l_;
-
-                for(auto& fuser : estimator_->getFuser(mode))
-                  {
-                    string plugin_name = fuser.first;
-                    boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                    int id = kf->getId();
-
-                    bool start_predict = false;
-
-                    if(plugin_name == "kalman_filter/kf_pos_vel_acc")
-                      {
-                        VectorXd input_noise_sigma(2);
-                        if((id & (1 << State::X_BASE)) || (id & (1 << State::Y_BASE)))
-                          {
-                            input_noise_sigma << level_acc_noise_sigma_, level_acc_bias_noise_sigma_;
-                            kf->setPredictionNoiseCovariance(input_noise_sigma);
-                            if(level_acc_bias_noise_sigma_ > 0)
-                              {
-                                if(id & (1 << State::X_BASE)) kf->setInitState(acc_bias_w_.x(),2);
-                                if(id & (1 << State::Y_BASE)) kf->setInitState(acc_bias_w_.y(),2);
-                              }
-                          }
-                        if(id & (1 << State::Z_BASE))
-                          {
-                            input_noise_sigma << z_acc_noise_sigma_, z_acc_bias_noise_sigma_;
-                            kf->setPredictionNoiseCovariance(input_noise_sigma);
-                            if(z_acc_bias_noise_sigma_ > 0) kf->setInitState(acc_bias_w_.z(), 2);
-                          }
-                        start_predict = true;
-                      }
-
-                    if(plugin_name == "aerial_robot_base/kf_xy_roll_pitch_bias")
-                      {
-                        if((id & (1 << State::X_BASE)) && (id & (1 << State::Y_BASE)))
-                          {
-                            VectorXd input_noise_sigma(5);
-                            input_noise_sigma <<
-                              level_acc_noise_sigma_,
-                              level_acc_noise_sigma_,
-                              level_acc_noise_sigma_,
-                              angle_bias_noise_sigma_,
-                              angle_bias_noise_sigma_;
-                            kf->setPredictionNoiseCovariance(input_noise_sigma);
-                            start_predict = true;
-                          }
-                      }
-                    if(start_predict)
-                      {
-                        kf->setPredictBufSize(1/sensor_dt_); //set the prediction handler buffer size
-                        kf->setInputFlag();
-                      }
-                  }
-              }
+            resolveFusers();
           }
       }
 
-    if(bias_calib == calib_count_)
+    if(bias_calib_ == calib_count_)
       {
         /* fuser for 0: egomotion, 1: experiment */
         for(int mode = 0; mode < 2; mode++)
           {
-            if(getFuserActivate(mode))
-              {
-                tf::Matrix3x3 orientation;
-                orientation.setRPY(0, 0, (estimator_->getState(State::YAW_BASE, mode))[0]);
+            if(!getFuserActivate(mode)) continue;
 
-                acc_w_ = orientation * acc_l_;
-                acc_non_bias_w_ = orientation * (acc_l_ - acc_bias_l_);
+            tf::Matrix3x3 orientation;
+            orientation.setRPY(0, 0, (states_[State::YAW_BASE][mode].second)[0]);
 
-                for(auto& fuser : estimator_->getFuser(mode))
-                  {
-                    string plugin_name = fuser.first;
-                    boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
-                    int id = kf->getId();
-                    vector<double> params = {sensor_dt_};
-
-                    int axis;
-                    bool predict = false;
+            acc_w_ = orientation * acc_l_;
+            acc_non_bias_w_ = orientation * (acc_l_ - acc_bias_l_);
 
-                    if(plugin_name == "kalman_filter/kf_pos_vel_acc")
-                      {
-                        VectorXd input_val(1);
-                        if(id & (1 << State::X_BASE))
-                          {
-                            input_val << ((level_acc_bias_noise_sigma_ > 0)?acc_w_.x(): acc_non_bias_w_.x());
-                            axis = State::X_BASE;
-                          }
-                        else if(id & (1 << State::Y_BASE))
-                          {
-                            input_val << ((level_acc_bias_noise_sigma_ > 0)?acc_w_.y(): acc_non_bias_w_.y());
-                            axis = State::Y_BASE;
-                          }
-                        else if(id & (1 << State::Z_BASE))
-                          {
-                            input_val << ((z_acc_bias_noise_sigma_ > 0)?acc_w_.z(): acc_non_bias_w_.z());
-                            axis = State::Z_BASE;
-
-                            /* considering the undescend mode, such as the phase of takeoff, the velocity should not below than 0 */
-                            if(estimator_->getUnDescendMode() && (kf->getEstimateState())(1) < 0)
-                              kf->resetState();
-
-                            /* get the estiamted offset(bias) */
-                            if(z_acc_bias_noise_sigma_ > 0) acc_bias_b_.setZ((kf->getEstimateState())(2));
-                          }
-
-                        kf->prediction(input_val, imu_stamp_.toSec(), params);
-                        VectorXd estimate_state = kf->getEstimateState();
-                        estimator_->setState(axis, mode, 0, estimate_state(0));
-                        estimator_->setState(axis, mode, 1, estimate_state(1));
-                      }
+            for(const auto& fuser : fusers_[mode])
+              {
+                const boost::shared_ptr<kf_plugin::KalmanFilter>& kf = fuser.kf;
 
-                    if(plugin_name == "aerial_robot_base/kf_xy_roll_pitch_bias")
-                      {
-                        if(id & (1 << State::X_BASE) && (id & (1 << State::Y_BASE)))
-                          {
-                            params.push_back(euler_[0]);
-                            params.push_back(euler_[1]);
-                            params.push_back(euler_[2]);
-                            params.push_back(acc_b_[0]);
-                            params.push_back(acc_b_[1]);
-                            params.push_back(acc_b_[2] - acc_bias_b_.z());
-
-                            VectorXd input_val(5);
-                            input_val <<
-                              acc_b_[0],
-                              acc_b_[1],
-                              acc_b_[2] - acc_bias_b_.z(),
-                              0,
-                              0;
-
-                            kf->prediction(input_val, imu_stamp_.toSec(), params);
-                            VectorXd estimate_state = kf->getEstimateState();
-                            estimator_->setState(State::X_BASE, mode, 0, estimate_state(0));
-                            estimator_->setState(State::X_BASE, mode, 1, estimate_state(1));
-                            estimator_->setState(State::Y_BASE, mode, 0, estimate_state(2));
-                            estimator_->setState(State::Y_BASE, mode, 1, estimate_state(3));
-                          }
-                      }
+                switch(fuser.type)
+                  {
+                  case POS_VEL_ACC:
+                    {
+                      switch(fuser.axis)
+                        {
+                        case State::X_BASE:
+                          pos_vel_acc_input_(0) = (level_acc_bias_noise_sigma_ > 0)?acc_w_.x(): acc_non_bias_w_.x();
+                          break;
+                        case State::Y_BASE:
+                          pos_vel_acc_input_(0) = (level_acc_bias_noise_sigma_ > 0)?acc_w_.y(): acc_non_bias_w_.y();
+                          break;
+                        case State::Z_BASE:
+                          pos_vel_acc_input_(0) = (z_acc_bias_noise_sigma_ > 0)?acc_w_.z(): acc_non_bias_w_.z();
+
+                          /* considering the undescend mode, such as the phase of takeoff, the velocity should not below than 0 */
+                          if(estimator_->getUnDescendMode() && (kf->getEstimateState())(1) < 0)
+                            kf->resetState();
+
+                          /* get the estiamted offset(bias) */
+                          if(z_acc_bias_noise_sigma_ > 0) acc_bias_b_.setZ((kf->getEstimateState())(2));
+                          break;
+                        }
+
+                      pos_vel_acc_params_[0] = sensor_dt_;
+                      kf->prediction(pos_vel_acc_input_, imu_stamp_.toSec(), pos_vel_acc_params_);
+                      const VectorXd estimate_state = kf->getEstimateState();
+                      batchState(fuser.axis, mode, 0, estimate_state(0));
+                      batchState(fuser.axis, mode, 1, estimate_state(1));
+                      break;
+                    }
+                  case XY_ROLL_PITCH_BIAS:
+                    {
+                      xy_bias_params_[0] = sensor_dt_;
+                      xy_bias_params_[1] = euler_[0];
+                      xy_bias_params_[2] = euler_[1];
+                      xy_bias_params_[3] = euler_[2];
+                      xy_bias_params_[4] = acc_b_[0];
+                      xy_bias_params_[5] = acc_b_[1];
+                      xy_bias_params_[6] = acc_b_[2] - acc_bias_b_.z();
+
+                      xy_bias_input_ <<
+                        acc_b_[0],
+                        acc_b_[1],
+                        acc_b_[2] - acc_bias_b_.z(),
+                        0,
+                        0;
+
+                      /* keep the history for the delayed corrections */
+                      boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf)->predictionWithHistory(xy_bias_input_, imu_stamp_.toSec(), xy_bias_params_);
+                      const VectorXd estimate_state = kf->getEstimateState();
+                      batchState(State::X_BASE, mode, 0, estimate_state(0));
+                      batchState(State::X_BASE, mode, 1, estimate_state(1));
+                      batchState(State::Y_BASE, mode, 0, estimate_state(2));
+                      batchState(State::Y_BASE, mode, 1, estimate_state(3));
+                      break;
+                    }
+                  case XYZ_POS_VEL_ACC:
+                    {
+                      typedef kf_plugin::KalmanFilterXYZPosVelAcc XYZFilter;
+
+                      /* considering the undescend mode, such as the phase of takeoff, the velocity should not below than 0 */
+                      if(estimator_->getUnDescendMode() && (kf->getEstimateState())(XYZFilter::velIndex(2)) < 0)
+                        kf->setInitState(0, XYZFilter::velIndex(2));
+
+                      /* get the estiamted offset(bias) */
+                      if(z_acc_bias_noise_sigma_ > 0) acc_bias_b_.setZ((kf->getEstimateState())(XYZFilter::biasIndex(2)));
+
+                      /* the world frame acc is rotated back to the body frame, where the noise is given */
+                      tf::Vector3 acc((level_acc_bias_noise_sigma_ > 0)?acc_w_.x(): acc_non_bias_w_.x(),
+                                      (level_acc_bias_noise_sigma_ > 0)?acc_w_.y(): acc_non_bias_w_.y(),
+                                      (z_acc_bias_noise_sigma_ > 0)?acc_w_.z(): acc_non_bias_w_.z());
+                      tf::Matrix3x3 r;
+                      r.setRPY(euler_[0], euler_[1], (states_[State::YAW_BASE][mode].second)[0]);
+                      acc = r.transpose() * acc;
+                      xyz_input_ << acc.x(), acc.y(), acc.z(), 0, 0, 0;
+
+                      xyz_params_[0] = sensor_dt_;
+                      xyz_params_[1] = euler_[0];
+                      xyz_params_[2] = euler_[1];
+                      xyz_params_[3] = (states_[State::YAW_BASE][mode].second)[0];
+
+                      kf->prediction(xyz_input_, imu_stamp_.toSec(), xyz_params_);
+                      const VectorXd estimate_state = kf->getEstimateState();
+                      for(int i = 0; i < 3; i++)
+                        {
+                          batchState(State::X_BASE + i, mode, 0, estimate_state(XYZFilter::posIndex(i)));
+                          batchState(State::X_BASE + i, mode, 1, estimate_state(XYZFilter::velIndex(i)));
+                        }
+                      break;
+                    }
                   }
               }
           }
 
         /* TODO: set z acc: should use kf reuslt? */
-        estimator_->setState(State::Z_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE, 2, acc_non_bias_w_.z());
-        estimator_->setState(State::Z_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 2, acc_non_bias_w_.z());
+        batchState(State::Z_BASE, aerial_robot_estimation::EGOMOTION_ESTIMATE, 2, acc_non_bias_w_.z());
+        batchState(State::Z_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 2, acc_non_bias_w_.z());
 
         /* set the rotation and angular velocity for the temporal queue for other sensor with time delay */
-        estimator_->updateQueue(imu_stamp_.toSec(), euler_[0], euler_[1], omega_);
         /* TODO: we ignore yaw becuase it is relatively slower than other axes in the case of under -actuated system */
+        tf::Matrix3x3 r_ee, r_ex, r_gt;
+        r_ee.setRPY(euler_[0], euler_[1], (states_[State::YAW_BASE][aerial_robot_estimation::EGOMOTION_ESTIMATE].second)[0]);
+        r_ex.setRPY(euler_[0], euler_[1], (states_[State::YAW_BASE][aerial_robot_estimation::EXPERIMENT_ESTIMATE].second)[0]);
+        r_gt.setRPY(euler_[0], euler_[1], (states_[State::YAW_BASE][aerial_robot_estimation::GROUND_TRUTH].second)[0]);
+        tf::Vector3 pos[3];
+        for(int mode = aerial_robot_estimation::EGOMOTION_ESTIMATE; mode <= aerial_robot_estimation::GROUND_TRUTH; mode++)
+          pos[mode].setValue((states_[State::X_BASE][mode].second)[0], (states_[State::Y_BASE][mode].second)[0], (states_[State::Z_BASE][mode].second)[0]);
+        estimator_->updateQueue(imu_stamp_.toSec(), r_ee, r_ex, r_gt, omega_,
+                                pos[aerial_robot_estimation::EGOMOTION_ESTIMATE], pos[aerial_robot_estimation::EXPERIMENT_ESTIMATE], pos[aerial_robot_estimation::GROUND_TRUTH]);
 
         /* 2017.7.25: calculate the state in COG frame using the Baselink frame */
         /* pos_cog = pos_baselink - R * pos_cog2baselink */
-        int estimate_mode = aerial_robot_estimation::EGOMOTION_ESTIMATE;
-        estimator_->setPos(Frame::COG, estimate_mode,
-                           estimator_->getPos(Frame::BASELINK, estimate_mode)
-                           + estimator_->getOrientation(Frame::BASELINK, estimate_mode)
-                           * cog2baselink_tf.inverse().getOrigin());
-        estimator_->setVel(Frame::COG, estimate_mode,
-                           estimator_->getVel(Frame::BASELINK, estimate_mode)
-                           + estimator_->getOrientation(Frame::BASELINK, estimate_mode)
-                           * (estimator_->getAngularVel(Frame::BASELINK, estimate_mode).cross(cog2baselink_tf.inverse().getOrigin())));
-
-
-        estimate_mode = aerial_robot_estimation::EXPERIMENT_ESTIMATE;
-        estimator_->setPos(Frame::COG, estimate_mode,
-                           estimator_->getPos(Frame::BASELINK, estimate_mode)
-                           + estimator_->getOrientation(Frame::BASELINK, estimate_mode)
-                           * cog2baselink_tf.inverse().getOrigin());
-        estimator_->setVel(Frame::COG, estimate_mode,
-                           estimator_->getVel(Frame::BASELINK, estimate_mode)
-                           + estimator_->getOrientation(Frame::BASELINK, estimate_mode)
-                           * (estimator_->getAngularVel(Frame::BASELINK, estimate_mode).cross(cog2baselink_tf.inverse().getOrigin())));
+        for(int mode = aerial_robot_estimation::EGOMOTION_ESTIMATE; mode <= aerial_robot_estimation::EXPERIMENT_ESTIMATE; mode++)
+          {
+            tf::Matrix3x3 r = batchedOrientation(Frame::BASELINK, mode);
+            batchVector(State::X_COG, mode, 0,
+                        batchedVector(State::X_BASE, mode, 0) + r * cog2baselink_tf.inverse().getOrigin());
+            batchVector(State::X_COG, mode, 1,
+                        batchedVector(State::X_BASE, mode, 1)
+                        + r * (batchedVector(State::ROLL_BASE, mode, 1).cross(cog2baselink_tf.inverse().getOrigin())));
+          }
 
         /* no acc, we do not have the angular acceleration */
+      }
+
+    estimator_->setStates(state_batch_);
+
+    prev_time_ = imu_stamp_;
+    return bias_calib_ == calib_count_;
+  }
+
+  void Imu::publishState()
+  {
+    publishAccData();
+    publishRosImuData();
+
+    /* publish state date */
+    state_.header.stamp = imu_stamp_;
+    for(int mode = 0; mode < 2; mode++)
+      {
+        tf::Vector3 pos = batchedVector(State::X_BASE, mode, 0);
+        tf::Vector3 vel = batchedVector(State::X_BASE, mode, 1);
+        for(int i = 0; i < 3; i++)
+          {
+            state_.states[i].state[mode].x = pos[i];
+            state_.states[i].state[mode].y = vel[i];
+            state_.states[i].state[mode].z = acc_w_[i];
+          }
+      }
+
+    state_pub_.publish(state_);
+  }
+
+  void Imu::resolveFusers()
+  {
+    /* fuser for 0: egomotion, 1: experiment */
+    for(int mode = 0; mode < 2; mode++)
+      {
+        fusers_[mode].clear();
+        if(!getFuserActivate(mode)) continue;
+
+        tf::Matrix3x3 orientation;
+        orientation.setRPY(0, 0, (states_[State::YAW_BASE][mode].second)[0]);
+        acc_bias_w_ = orientation * acc_bias_l_;
+
+        for(const auto& fuser : estimator_->getFuser(mode))
+          {
+            const string& plugin_name = fuser.first;
+            boost::shared_ptr<kf_plugin::KalmanFilter> kf = fuser.second;
+            int id = kf->getId();
 
-        publishAccData();
-        publishRosImuData();
-
-        /* publish state date */
-        state_.header.stamp = imu_stamp_;
-        tf::Vector3 pos = estimator_->getPos(Frame::BASELINK, aerial_robot_estimation::EGOMOTION_ESTIMATE);
-        tf::Vector3 vel = estimator_->getVel(Frame::BASELINK, aerial_robot_estimation::EGOMOTION_ESTIMATE);
-        state_.states[0].state[0].x = pos.x();
-        state_.states[1].state[0].x = pos.y();
-        state_.states[2].state[0].x = pos.z();
-        state_.states[0].state[0].y = vel.x();
-        state_.states[1].state[0].y = vel.y();
-        state_.states[2].state[0].y = vel.z();
-        state_.states[0].state[0].z = acc_w_.x();
-        state_.states[1].state[0].z = acc_w_.y();
-        state_.states[2].state[0].z = acc_w_.z();
-        pos = estimator_->getPos(Frame::BASELINK, aerial_robot_estimation::EXPERIMENT_ESTIMATE);
-        vel = estimator_->getVel(Frame::BASELINK, aerial_robot_estimation::EXPERIMENT_ESTIMATE);
-        state_.states[0].state[1].x = pos.x();
-        state_.states[1].state[1].x = pos.y();
-        state_.states[2].state[1].x = pos.z();
-        state_.states[0].state[1].y = vel.x();
-        state_.states[1].state[1].y = vel.y();
-        state_.states[2].state[1].y = vel.z();
-        state_.states[0].state[1].z = acc_w_.x();
-        state_.states[1].state[1].z = acc_w_.y();
-        state_.states[2].state[1].z = acc_w_.z();
-
-        state_pub_.publish(state_);
+            if(plugin_name == "kalman_filter/kf_pos_vel_acc")
+              {
+                VectorXd input_noise_sigma(2);
+                if((id & (1 << State::X_BASE)) || (id & (1 << State::Y_BASE)))
+                  {
+                    input_noise_sigma << level_acc_noise_sigma_, level_acc_bias_noise_sigma_;
+                    kf->setPredictionNoiseCovariance(input_noise_sigma);
+                    if(level_acc_bias_noise_sigma_ > 0)
+                      {
+                        if(id & (1 << State::X_BASE)) kf->setInitState(acc_bias_w_.x(),2);
+                        if(id & (1 << State::Y_BASE)) kf->setInitState(acc_bias_w_.y(),2);
+                      }
+                  }
+                if(id & (1 << State::Z_BASE))
+                  {
+                    input_noise_sigma << z_acc_noise_sigma_, z_acc_bias_noise_sigma_;
+                    kf->setPredictionNoiseCovariance(input_noise_sigma);
+                    if(z_acc_bias_noise_sigma_ > 0) kf->setInitState(acc_bias_w_.z(), 2);
+                  }
+
+                /* the estimated state is assigned to one axis with the priority of x, y, z */
+                int axis;
+                if(id & (1 << State::X_BASE)) axis = State::X_BASE;
+                else if(id & (1 << State::Y_BASE)) axis = State::Y_BASE;
+                else if(id & (1 << State::Z_BASE)) axis = State::Z_BASE;
+                else
+                  {
+                    ROS_ERROR("imu: kf_pos_vel_acc with id %d has no translational axis", id);
+                    continue;
+                  }
+
+                fusers_[mode].push_back({POS_VEL_ACC, axis, kf});
+              }
+            else if(plugin_name == "aerial_robot_base/kf_xy_roll_pitch_bias")
+              {
+                if(!(id & (1 << State::X_BASE)) || !(id & (1 << State::Y_BASE))) continue;
+
+                VectorXd input_noise_sigma(5);
+                input_noise_sigma <<
+                  level_acc_noise_sigma_,
+                  level_acc_noise_sigma_,
+                  level_acc_noise_sigma_,
+                  angle_bias_noise_sigma_,
+                  angle_bias_noise_sigma_;
+                kf->setPredictionNoiseCovariance(input_noise_sigma);
+
+                /* for the delayed corrections */
+                auto xy_bias_kf = boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf);
+                xy_bias_kf->setHistorySize(xy_bias_history_size_);
+                xy_bias_kf->setReplayBudget(xy_bias_replay_budget_);
+
+                fusers_[mode].push_back({XY_ROLL_PITCH_BIAS, State::X_BASE, kf});
+              }
+            else if(plugin_name == "aerial_robot_base/kf_xyz_pos_vel_acc")
+              {
+                typedef kf_plugin::KalmanFilterXYZPosVelAcc XYZFilter;
+
+                /* body frame acc noise, rotated to the world frame in the prediction model */
+                VectorXd input_noise_sigma(6);
+                input_noise_sigma <<
+                  level_acc_noise_sigma_,
+                  level_acc_noise_sigma_,
+                  z_acc_noise_sigma_,
+                  level_acc_bias_noise_sigma_,
+                  level_acc_bias_noise_sigma_,
+                  z_acc_bias_noise_sigma_;
+                kf->setPredictionNoiseCovariance(input_noise_sigma);
+
+                if(level_acc_bias_noise_sigma_ > 0)
+                  {
+                    kf->setInitState(acc_bias_w_.x(), XYZFilter::biasIndex(0));
+                    kf->setInitState(acc_bias_w_.y(), XYZFilter::biasIndex(1));
+                  }
+                if(z_acc_bias_noise_sigma_ > 0) kf->setInitState(acc_bias_w_.z(), XYZFilter::biasIndex(2));
+
+                fusers_[mode].push_back({XYZ_POS_VEL_ACC, State::X_BASE, kf});
+              }
+            else continue;
+
+            kf->setPredictBufSize(1/sensor_dt_); //set the prediction handler buffer size
+            kf->setInputFlag();
+          }
       }
-    prev_time = imu_stamp_;
   }
 
   void Imu::publishAccData()
@@ -456,6 +568,8 @@ namespace sensor_plugin
     getParam<double>("level_acc_bias_noise_sigma", level_acc_bias_noise_sigma_, 0.01 );
     getParam<double>("z_acc_bias_noise_sigma", z_acc_bias_noise_sigma_, 0.0);
     getParam<double>("angle_bias_noise_sigma", angle_bias_noise_sigma_, 0.001 );
+    getParam<int>("xy_bias_history_size", xy_bias_history_size_, kf_plugin::KalmanFilterXYBias::DEFAULT_HISTORY_SIZE); // predictions kept for the delayed corrections
+    getParam<int>("xy_bias_replay_budget", xy_bias_replay_budget_, kf_plugin::KalmanFilterXYBias::DEFAULT_REPLAY_BUDGET); // max predictions replayed by a delayed correction
     getParam<double>("calib_time", calib_time_, 2.0 );
     getParam<double>("landing_shock_force_thre", landing_shock_force_thre_, 5.0 );
 
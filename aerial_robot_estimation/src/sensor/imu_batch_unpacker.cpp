@@ -0,0 +1,109 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/sensor/imu_batch_unpacker.h>
+#include <cmath>
+#include <sensors/imu/imu_batch.h> /* spinal */
+
+namespace aerial_robot_estimation
+{
+  constexpr double ImuBatchUnpacker::MAX_GAP;
+
+  ImuBatchUnpacker::ImuBatchUnpacker()
+  {
+    samples_.reserve(64);
+    reset();
+  }
+
+  void ImuBatchUnpacker::reset()
+  {
+    initialized_ = false;
+    last_stamp_ = 0;
+    last_euler_.setZero();
+    samples_.clear();
+  }
+
+  bool ImuBatchUnpacker::unpack(double stamp, const std::vector<uint8_t>& tick_delta,
+                                float gyro_scale, const std::vector<int16_t>& gyro_data,
+                                float acc_scale, const std::vector<int16_t>& acc_data,
+                                const Eigen::Vector3d& euler)
+  {
+    samples_.clear();
+    size_t sample_num = tick_delta.size();
+    if(sample_num == 0 || gyro_data.size() != 3 * sample_num || acc_data.size() != 3 * sample_num) return false;
+
+    uint32_t span = 0;
+    for(size_t k = 1; k < sample_num; k++) span += tick_delta[k];
+    double end_time = stamp + span * 1e-3;
+
+    Eigen::Vector3d start_euler = last_euler_;
+    double start_time = last_stamp_;
+    if(!initialized_ || end_time - start_time > MAX_GAP) // first or after a gap
+      {
+        start_euler = euler;
+        start_time = stamp;
+      }
+
+    uint32_t tick = 0;
+    samples_.resize(sample_num);
+    for(size_t k = 0; k < sample_num; k++)
+      {
+        Sample& sample = samples_[k];
+        tick += tick_delta[k];
+        sample.tick = tick;
+
+        float gyro[3], acc[3];
+        imu_batch::dequantize(&gyro_data[3 * k], 3, gyro_scale, gyro);
+        imu_batch::dequantize(&acc_data[3 * k], 3, acc_scale, acc);
+
+        double rate = 1.0;
+        if(end_time > start_time) rate = (stamp + tick * 1e-3 - start_time) / (end_time - start_time);
+        for(int i = 0; i < 3; i++)
+          {
+            sample.gyro(i) = gyro[i];
+            sample.acc(i) = acc[i];
+            double diff = euler(i) - start_euler(i);
+            double angle = start_euler(i) + std::atan2(std::sin(diff), std::cos(diff)) * rate;
+            sample.euler(i) = std::atan2(std::sin(angle), std::cos(angle));
+          }
+      }
+    samples_.back().euler = euler;
+
+    initialized_ = true;
+    last_stamp_ = end_time;
+    last_euler_ = euler;
+    return true;
+  }
+};
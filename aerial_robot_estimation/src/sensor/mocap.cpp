@@ -33,8 +33,11 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 
+#include <aerial_robot_estimation/kf/xy_roll_pitch_bias_plugin.h>
+#include <aerial_robot_estimation/kf/xyz_pos_vel_acc_plugin.h>
 #include <aerial_robot_estimation/sensor/base_plugin.h>
 #include <aerial_robot_estimation/sensor/imu.h>
+#include <aerial_robot_estimation/sensor/mocap_tracker.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <kalman_filter/kf_pos_vel_acc_plugin.h>
 #include <nav_msgs/Odometry.h>
@@ -47,7 +50,6 @@ namespace
 {
   bool first_flag = true;
   bool ground_truth_first_flag = true;
-  ros::Time previous_time;
 };
 
 namespace sensor_plugin
@@ -65,16 +67,22 @@ namespace sensor_plugin
 
       //low pass filter
       lpf_pos_ = IirFilter(sample_freq_, cutoff_pos_freq_, 3);
-      lpf_vel_ = IirFilter(sample_freq_, cutoff_vel_freq_, 3);
       lpf_angular_ = IirFilter(sample_freq_, cutoff_vel_freq_, 3);
 
+      /* history of the frames for the velocity, the duplicated / dropped frames and the latency */
+      tracker_.setHistorySize(history_size_);
+      tracker_.setWindow(vel_window_, vel_fit_order_);
+      tracker_.setNominalRate(nominal_rate_);
+
       std::string topic_name;
       getParam<std::string>("mocap_sub_name", topic_name, std::string("pose"));
 
+      /* only the latest value without time_sync mode, every frame is fused at its capture time with time_sync mode */
+      int queue_size = time_sync_ ? 10 : 1;
 #ifdef ARM_MELODIC //https://github.com/ros/ros_comm/issues/1404
-      mocap_sub_ = nh_.subscribe(topic_name, 1, &Mocap::poseCallback, this); // since we do not use time_sync mode for mocap, so only need the latest value.
+      mocap_sub_ = nh_.subscribe(topic_name, queue_size, &Mocap::poseCallback, this, ros::TransportHints().tcpNoDelay());
 #else
-      mocap_sub_ = nh_.subscribe(topic_name, 1, &Mocap::poseCallback, this, ros::TransportHints().udp()); // since we do not use time_sync mode for mocap, so only need the latest value.
+      mocap_sub_ = nh_.subscribe(topic_name, queue_size, &Mocap::poseCallback, this, ros::TransportHints().udp().tcpNoDelay());
       ROS_INFO("use UDP for mocap topic subscriber in ground truth mode");
 #endif
       nhp_.param("ground_truth_sub_name", topic_name, std::string("ground_truth"));
@@ -88,10 +96,6 @@ namespace sensor_plugin
       raw_pos_(0, 0, 0),
       raw_vel_(0, 0, 0),
       pos_(0, 0, 0),
-      vel_(0, 0, 0),
-      prev_raw_pos_(0, 0, 0),
-      prev_raw_vel_(0, 0, 0),
-      prev_raw_q_(0, 0, 0, 1),
       receive_groundtruth_odom_(false)
     {
       ground_truth_pose_.states.resize(6);
@@ -122,15 +126,20 @@ namespace sensor_plugin
 
     double pos_noise_sigma_, angle_noise_sigma_, acc_bias_noise_sigma_;
 
+    int history_size_;
+    double vel_window_; // of the polynomial fit for the velocity
+    int vel_fit_order_;
+    double nominal_rate_;
+    bool latency_compensation_; // extrapolate the ground truth to the arrival by the latency
+    double max_latency_;
+
     IirFilter lpf_pos_; /* x, y, z */
-    IirFilter lpf_vel_; /* x, y, z */
     IirFilter lpf_angular_; /* yaw angular velocity */
 
-    tf::Vector3 raw_pos_, raw_vel_;
-    tf::Vector3 pos_, vel_;
+    aerial_robot_estimation::MocapTracker tracker_;
 
-    tf::Vector3 prev_raw_pos_, prev_raw_vel_;
-    tf::Quaternion prev_raw_q_;
+    tf::Vector3 raw_pos_, raw_vel_;
+    tf::Vector3 pos_;
 
     bool receive_groundtruth_odom_;
 
@@ -139,6 +148,26 @@ namespace sensor_plugin
 
     void poseCallback(const geometry_msgs::PoseStampedConstPtr & msg)
     {
+      aerial_robot_estimation::MocapFrame frame;
+      frame.stamp = msg->header.stamp.toSec();
+      frame.receive_stamp = ros::Time::now().toSec();
+      frame.pos = Eigen::Vector3d(msg->pose.position.x, msg->pose.position.y, msg->pose.position.z);
+      frame.q = Eigen::Quaterniond(msg->pose.orientation.w, msg->pose.orientation.x, msg->pose.orientation.y, msg->pose.orientation.z);
+
+      aerial_robot_estimation::MocapTracker::Result result = tracker_.add(frame);
+
+      /* consider the remote wirleess transmission, we use the local time server */
+      updateHealthStamp();
+
+      if(result.status != aerial_robot_estimation::MocapTracker::NEW)
+        {
+          ROS_WARN_THROTTLE(1, "mocap: skip the %s frame, stamp: %f",
+                            result.status == aerial_robot_estimation::MocapTracker::DUPLICATE ? "duplicated" : "out of order", frame.stamp);
+          return;
+        }
+      if(result.dropped > 0)
+        ROS_DEBUG("mocap: %d frames are dropped before the stamp: %f, total: %d", result.dropped, frame.stamp, tracker_.getDropCount());
+
       tf::pointMsgToTF(msg->pose.position, raw_pos_);
 
       tf::Quaternion q;
@@ -149,22 +178,12 @@ namespace sensor_plugin
 
       if(!first_flag)
         {
-          float delta_t = msg->header.stamp.toSec() - previous_time.toSec();
-          raw_vel_ = (raw_pos_ - prev_raw_pos_) / delta_t;
-
-          /* TODO: not working
-          tf::Quaternion q_delta = prev_raw_q_.inverse() * q;
-          tf::Vector3 raw_omega = q_delta.getAxis() * q_delta.getAngle() / delta_t;
-          */
-
-          tf::Matrix3x3 r_delta(prev_raw_q_.inverse() * q);
-          r_delta.getRPY(r, p, y);
-          tf::Vector3 raw_omega(r/delta_t, p/delta_t, y/delta_t);
+          /* derivative at the capture time of this frame */
+          raw_vel_.setValue(result.vel.x(), result.vel.y(), result.vel.z());
+          tf::Vector3 raw_omega(result.omega.x(), result.omega.y(), result.omega.z());
 
           /* lpf */
           pos_ = lpf_pos_.filterFunction(raw_pos_);
-          vel_ = lpf_vel_.filterFunction(raw_vel_);
-
 
           /* euler and omega */
           tf::Vector3 omega = raw_omega;
@@ -185,7 +204,7 @@ namespace sensor_plugin
                   ground_truth_pose_.states[i].state[0].x = raw_pos_[i];
                   ground_truth_pose_.states[i].state[0].y = raw_vel_[i];
                   ground_truth_pose_.states[i].state[1].x = pos_[i];
-                  ground_truth_pose_.states[i].state[1].y = vel_[i];
+                  ground_truth_pose_.states[i].state[1].y = raw_vel_[i];
                 }
               else
                 {
@@ -195,8 +214,12 @@ namespace sensor_plugin
                 }
             }
 
+          /* the markers w.r.t. the baselink, only reported since the mocap frame is treated as the baselink */
+          tf::Transform raw_sensor_tf(q, raw_pos_);
+          extrinsicCalibrationProcess(frame.stamp, raw_sensor_tf);
+
           /* estimation */
-          estimateProcess(msg->header.stamp);
+          estimateProcess(msg->header.stamp, result.latency);
           state_pub_.publish(ground_truth_pose_);
         }
 
@@ -206,15 +229,6 @@ namespace sensor_plugin
           init(raw_pos_);
           first_flag = false;
         }
-
-
-      prev_raw_pos_ = raw_pos_;
-      prev_raw_vel_ = raw_vel_;
-      prev_raw_q_ = q;
-
-      previous_time = msg->header.stamp;
-      /* consider the remote wirleess transmission, we use the local time server */
-      updateHealthStamp();
     }
 
     void setGroundTruthPosVel(tf::Vector3 baselink_pos, tf::Vector3 baselink_vel)
@@ -295,6 +309,13 @@ namespace sensor_plugin
       getParam<double>("sample_freq", sample_freq_, 100.0);
       getParam<double>("cutoff_pos_freq", cutoff_pos_freq_, 20.0);
       getParam<double>("cutoff_vel_freq", cutoff_vel_freq_, 20.0);
+
+      getParam<int>("history_size", history_size_, 32);
+      getParam<double>("vel_window", vel_window_, 0.1); // [s]
+      getParam<int>("vel_fit_order", vel_fit_order_, 2);
+      getParam<double>("nominal_rate", nominal_rate_, 0.0); // [Hz], 0: estimated from the stamps
+      getParam<bool>("latency_compensation", latency_compensation_, false); // the clocks should be synchronized
+      getParam<double>("max_latency", max_latency_, 0.05); // [s]
     }
 
     void init(tf::Vector3 init_pos)
@@ -333,23 +354,34 @@ namespace sensor_plugin
                     {
                       VectorXd init_state(6);
                       init_state << init_pos[0], 0, init_pos[1], 0, 0, 0;
-                      kf->setInitState(init_state);
+                      boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf)->setInitState(init_state); // also clear the history
                     }
                 }
+
+              if(plugin_name == "aerial_robot_base/kf_xyz_pos_vel_acc")
+                {
+                  for(int i = 0; i < 3; i++)
+                    kf->setInitState(init_pos[i], kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(i));
+                }
               kf->setMeasureFlag();
             }
         }
     }
 
-    void estimateProcess(ros::Time stamp)
+    void estimateProcess(ros::Time stamp, double latency)
     {
       if(sensor_status_ == Status::INVALID) return;
 
       if((estimate_mode_ & (1 << aerial_robot_estimation::GROUND_TRUTH)) && !receive_groundtruth_odom_)
         {
-          setGroundTruthPosVel(pos_, vel_);
+          /* the lag of the lpf is not allowed for the ground truth, the transport latency is compensated by the velocity */
+          double compensation = latency_compensation_ ? std::min(std::max(latency, 0.0), max_latency_) : 0;
+          setGroundTruthPosVel(raw_pos_ + raw_vel_ * compensation, raw_vel_);
         }
 
+      /* fuse at the capture time of the frame with time_sync mode */
+      double timestamp = time_sync_ ? stamp.toSec() : -1;
+
       /* start experiment estimation */
       if(!(estimate_mode_ & (1 << aerial_robot_estimation::EXPERIMENT_ESTIMATE))) return;
 
@@ -384,7 +416,7 @@ namespace sensor_plugin
                   measure_sigma << pos_noise_sigma_;
                   VectorXd meas(1); meas << raw_pos_[index];
                   vector<double> params = {kf_plugin::POS};
-                  kf->correction(meas, measure_sigma, -1, params); //no time sync
+                  kf->correction(meas, measure_sigma, timestamp, params);
                   // VectorXd state = kf->getEstimateState();
                   // estimator_->setState(index + 3, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 0, state(0));
                   // estimator_->setState(index + 3, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 1, state(1));
@@ -399,8 +431,8 @@ namespace sensor_plugin
                       measure_sigma << pos_noise_sigma_, pos_noise_sigma_;
                       VectorXd meas(2); meas <<  raw_pos_[0], raw_pos_[1];
                       vector<double> params = {kf_plugin::POS};
-                      /* time sync and delay process: get from kf time stamp */
-                      kf->correction(meas, measure_sigma, -1, params); // no time sync
+                      /* the delayed measurement is applied at its time in the history of the filter */
+                      boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf)->correctionWithHistory(meas, measure_sigma, timestamp, params);
 
                       VectorXd state = kf->getEstimateState();
                       /* temp */
@@ -410,6 +442,16 @@ namespace sensor_plugin
                       estimator_->setState(State::Y_BASE, aerial_robot_estimation::EXPERIMENT_ESTIMATE, 1, state(3));
                     }
                 }
+
+              if(plugin_name == "aerial_robot_base/kf_xyz_pos_vel_acc")
+                {
+                  /* correction of the three axes at once */
+                  VectorXd measure_sigma(3);
+                  measure_sigma << pos_noise_sigma_, pos_noise_sigma_, pos_noise_sigma_;
+                  VectorXd meas(3); meas << raw_pos_[0], raw_pos_[1], raw_pos_[2];
+                  vector<double> params = {kf_plugin::POS};
+                  kf->correction(meas, measure_sigma, timestamp, params);
+                }
             }
         }
     }
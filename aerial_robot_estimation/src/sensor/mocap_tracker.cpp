@@ -0,0 +1,194 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/sensor/mocap_tracker.h>
+#include <Eigen/Cholesky>
+#include <algorithm>
+#include <cmath>
+
+namespace aerial_robot_estimation
+{
+  MocapTracker::MocapTracker():
+    history_(32),
+    window_(0.1), order_(2),
+    nominal_period_(0)
+  {
+    reset();
+  }
+
+  void MocapTracker::setHistorySize(int size)
+  {
+    history_.assign(std::max(size, 2), MocapFrame());
+    reset();
+  }
+
+  void MocapTracker::setWindow(double window, int order)
+  {
+    window_ = window;
+    order_ = std::min(std::max(order, 1), 2);
+  }
+
+  void MocapTracker::setNominalRate(double rate)
+  {
+    nominal_period_ = rate > 0 ? 1 / rate : 0;
+    period_ = nominal_period_;
+  }
+
+  void MocapTracker::reset()
+  {
+    head_ = 0;
+    count_ = 0;
+    period_ = nominal_period_;
+
+    last_.status = NEW;
+    last_.dropped = 0;
+    last_.stamp = 0;
+    last_.pos.setZero();
+    last_.vel.setZero();
+    last_.q.setIdentity();
+    last_.omega.setZero();
+    last_.vel_valid = false;
+    last_.latency = 0;
+
+    duplicate_count_ = 0;
+    out_of_order_count_ = 0;
+    drop_count_ = 0;
+  }
+
+  MocapTracker::Result MocapTracker::add(const MocapFrame& new_frame)
+  {
+    Result result = last_;
+    result.status = NEW;
+    result.dropped = 0;
+    result.latency = new_frame.receive_stamp - new_frame.stamp;
+
+    if(count_ > 0)
+      {
+        double dt = new_frame.stamp - frame(0).stamp;
+        if(fabs(dt) < 1e-6)
+          {
+            duplicate_count_++;
+            result.status = DUPLICATE;
+            return result;
+          }
+        if(dt < 0)
+          {
+            out_of_order_count_++;
+            result.status = OUT_OF_ORDER;
+            return result;
+          }
+
+        if(period_ > 0 && dt > 1.5 * period_)
+          {
+            result.dropped = static_cast<int>(std::lround(dt / period_)) - 1;
+            drop_count_ += result.dropped;
+          }
+        else if(nominal_period_ <= 0)
+          {
+            /* mean of the regular intervals */
+            period_ = period_ > 0 ? 0.95 * period_ + 0.05 * dt : dt;
+          }
+      }
+
+    head_ = (head_ + 1) % history_.size();
+    history_[head_] = new_frame;
+    count_ = std::min<int>(count_ + 1, history_.size());
+
+    result.stamp = new_frame.stamp;
+    result.pos = new_frame.pos;
+    result.q = new_frame.q;
+    result.vel_valid = differentiate(result.vel, result.omega);
+    if(!result.vel_valid)
+      {
+        result.vel.setZero();
+        result.omega.setZero();
+      }
+
+    last_ = result;
+    return result;
+  }
+
+  bool MocapTracker::differentiate(Eigen::Vector3d& vel, Eigen::Vector3d& omega) const
+  {
+    if(count_ < 2) return false;
+
+    /* the frames in the window, at least the two newest */
+    const MocapFrame& newest = frame(0);
+    int n = 2;
+    while(n < count_ && newest.stamp - frame(n).stamp <= window_) n++;
+    int order = std::min(order_, n - 1);
+
+    /* the time is normalized by the window for the conditioning */
+    Eigen::MatrixXd a(n, order + 1);
+    Eigen::Matrix<double, Eigen::Dynamic, 6> y(n, 6);
+    Eigen::Quaterniond q_inv = newest.q.conjugate();
+    for(int i = 0; i < n; i++)
+      {
+        const MocapFrame& f = frame(i);
+        double tau = (f.stamp - newest.stamp) / window_;
+        double power = 1;
+        for(int k = 0; k <= order; k++, power *= tau) a(i, k) = power;
+
+        /* rotation vector in the body frame of the newest frame */
+        Eigen::AngleAxisd delta(q_inv * f.q);
+        double angle = delta.angle();
+        if(angle > M_PI) angle -= 2 * M_PI;
+        y.block<1, 3>(i, 0) = (f.pos - newest.pos).transpose();
+        y.block<1, 3>(i, 3) = (angle * delta.axis()).transpose();
+      }
+
+    Eigen::MatrixXd coeff = (a.transpose() * a).ldlt().solve(a.transpose() * y);
+    vel = coeff.block<1, 3>(1, 0).transpose() / window_;
+    omega = coeff.block<1, 3>(1, 3).transpose() / window_;
+    return true;
+  }
+
+  double MocapTracker::getLatency() const
+  {
+    if(count_ == 0) return 0;
+
+    double sum = 0;
+    for(int i = 0; i < count_; i++) sum += frame(i).receive_stamp - frame(i).stamp;
+    return sum / count_;
+  }
+
+  double MocapTracker::getMaxLatency() const
+  {
+    double max_latency = 0;
+    for(int i = 0; i < count_; i++) max_latency = std::max(max_latency, frame(i).receive_stamp - frame(i).stamp);
+    return max_latency;
+  }
+
+} //namespace aerial_robot_estimation
@@ -35,6 +35,7 @@
 
 /* base class */
 #include <aerial_robot_estimation/sensor/vo.h>
+#include <aerial_robot_estimation/kf/xy_roll_pitch_bias_plugin.h>
 
 namespace
 {
@@ -309,7 +310,7 @@ namespace sensor_plugin
                       {
                         VectorXd init_state(6);
                         init_state << init_pos[0], 0, init_pos[1], 0, 0, 0;
-                        kf->setInitState(init_state);
+                        boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf)->setInitState(init_state); // also clear the history
                         std::cout << ", init state x/y with pos mode";
                       }
                     else
@@ -342,6 +343,10 @@ namespace sensor_plugin
 
     baselink_tf_ = world_offset_tf_ * raw_sensor_tf * sensor_tf_.inverse();
 
+    /* keep the baselink pose continuous with the calibrated extrinsic */
+    if(extrinsicCalibrationProcess(curr_timestamp_, raw_sensor_tf))
+      world_offset_tf_ = baselink_tf_ * sensor_tf_ * raw_sensor_tf.inverse();
+
     tf::Vector3 raw_pos;
     tf::pointMsgToTF(vo_msg->pose.pose.position, raw_pos);
     tf::Quaternion raw_q;
@@ -585,7 +590,8 @@ namespace sensor_plugin
                     ROS_WARN("POS_VEL_MODE for xy_roll_pitch_bias is not supported");
                   }
 
-                kf->correction(meas, measure_sigma, time_sync_?(timestamp):-1, params);
+                /* the delayed measurement is applied at its time in the history of the filter */
+                boost::static_pointer_cast<kf_plugin::KalmanFilterXYBias>(kf)->correctionWithHistory(meas, measure_sigma, time_sync_?(timestamp):-1, params);
               }
           }
       }
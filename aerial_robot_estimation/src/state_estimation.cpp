@@ -47,6 +47,7 @@ StateEstimator::StateEstimator()
     un_descend_flag_(false),
     landing_height_(0),
     force_att_control_flag_(false),
+    external_update_flag_(false),
     imu_handlers_(0), alt_handlers_(0), vo_handlers_(0), gps_handlers_(0), plane_detection_handlers_(0)
 {
   fuser_[0].resize(0);
@@ -76,9 +77,29 @@ void StateEstimator::initialize(ros::NodeHandle nh, ros::NodeHandle nh_private,
   baselink_odom_pub_ = nh_.advertise<nav_msgs::Odometry>("uav/baselink/odom", 1);
   cog_odom_pub_ = nh_.advertise<nav_msgs::Odometry>("uav/cog/odom", 1);
   full_state_pub_ = nh_.advertise<aerial_robot_msgs::States>("uav/full_state", 1);
+  full_state_throttle_pub_ = nh_.advertise<aerial_robot_msgs::States>("uav/full_state_throttle", 1);
 
   nhp_.param("tf_prefix", tf_prefix_, std::string(""));
   nh_.param ("estimation/update_rate", update_rate_, 100.0);
+  nh_.param ("estimation/full_state_rate", full_state_rate_, update_rate_);
+  full_state_decimation_ = std::max(1, (int)std::round(update_rate_ / full_state_rate_));
+  publish_cnt_ = 0;
+
+  /* the string fields of the published messages are fixed */
+  const std::vector<std::string> state_ids = {"x_cog", "y_cog", "z_cog", "x_b", "y_b", "z_b",
+                                              "roll_cog", "pitch_cog", "yaw_cog", "roll_b", "pitch_b", "yaw_b"};
+  full_state_msg_.states.resize(State::TOTAL_NUM);
+  for(int axis = 0; axis < State::TOTAL_NUM; axis++)
+    {
+      full_state_msg_.states[axis].id = state_ids.at(axis);
+      full_state_msg_.states[axis].state.resize(3);
+    }
+  baselink_odom_msg_.header.frame_id = std::string("/world");
+  baselink_odom_msg_.child_frame_id = tf::resolve(tf_prefix_, robot_model_->getBaselinkName());
+  cog_odom_msg_.header.frame_id = std::string("/world");
+  cog_odom_msg_.child_frame_id = tf::resolve(tf_prefix_, std::string("cog"));
+
+  if(external_update_flag_) return;
 
   update_thread_ = boost::thread([this]()
                                  {
@@ -93,78 +114,14 @@ void StateEstimator::initialize(ros::NodeHandle nh, ros::NodeHandle nh_private,
 
 void StateEstimator::statePublish()
 {
-  aerial_robot_msgs::States full_state;
-  full_state.header.stamp = ros::Time::now();
-
-  for(int axis = 0; axis < State::TOTAL_NUM; axis++)
-    {
-      aerial_robot_msgs::State r_state;
-      AxisState state = getState(axis);
-
-      switch(axis)
-        {
-        case State::X_COG:
-          r_state.id = "x_cog";
-          break;
-        case State::Y_COG:
-          r_state.id = "y_cog";
-          break;
-        case State::Z_COG:
-          r_state.id = "z_cog";
-          break;
-        case State::X_BASE:
-          r_state.id = "x_b";
-          break;
-        case State::Y_BASE:
-          r_state.id = "y_b";
-          break;
-        case State::Z_BASE:
-          r_state.id = "z_b";
-          break;
-        case State::ROLL_COG:
-          r_state.id = "roll_cog";
-          break;
-        case State::PITCH_COG:
-          r_state.id = "pitch_cog";
-          break;
-        case State::YAW_COG:
-          r_state.id = "yaw_cog";
-          break;
-        case State::ROLL_BASE:
-          r_state.id = "roll_b";
-          break;
-        case State::PITCH_BASE:
-          r_state.id = "pitch_b";
-          break;
-        case State::YAW_BASE:
-          r_state.id = "yaw_b";
-          break;
-        default:
-          break;
-        }
-      r_state.state.resize(3);
-      for(int mode = 0; mode < 3; mode++)
-        tf::vector3TFToMsg(state[mode].second, r_state.state[mode]);
-
-      full_state.states.push_back(r_state);
-    }
-  full_state_pub_.publish(full_state);
-
-  nav_msgs::Odometry odom_state;
-  odom_state.header.stamp = ros::Time::now();
-  odom_state.header.frame_id = std::string("/world");
+  /* one consistent snapshot of all axes */
+  const array<AxisState, State::TOTAL_NUM> states = getStates();
+  const ros::Time now = ros::Time::now();
 
   /* Baselink */
-  /* Rotation */
-  tf::Quaternion q; getOrientation(Frame::BASELINK, estimate_mode_).getRotation(q);
-  tf::quaternionTFToMsg(q, odom_state.pose.pose.orientation);
-  tf::vector3TFToMsg(getAngularVel(Frame::BASELINK, estimate_mode_), odom_state.twist.twist.angular);
-
-  /* Translation */
-  odom_state.child_frame_id = tf::resolve(tf_prefix_, robot_model_->getBaselinkName());
-  tf::pointTFToMsg(getPos(Frame::BASELINK, estimate_mode_), odom_state.pose.pose.position);
-  tf::vector3TFToMsg(getVel(Frame::BASELINK, estimate_mode_), odom_state.twist.twist.linear);
-  baselink_odom_pub_.publish(odom_state);
+  baselink_odom_msg_.header.stamp = now;
+  fillOdom(states, Frame::BASELINK, baselink_odom_msg_);
+  baselink_odom_pub_.publish(baselink_odom_msg_);
 
   /* TF broadcast from world frame */
   tf::Transform root2baselink_tf;
@@ -175,22 +132,51 @@ void StateEstimator::statePublish()
     root2baselink_tf.setIdentity(); // not initialized
 
   tf::Transform world2baselink_tf;
-  tf::poseMsgToTF(odom_state.pose.pose, world2baselink_tf);
-  br_.sendTransform(tf::StampedTransform(world2baselink_tf * root2baselink_tf.inverse(), ros::Time::now(), "world", tf::resolve(tf_prefix_, std::string("root"))));
-
+  tf::poseMsgToTF(baselink_odom_msg_.pose.pose, world2baselink_tf);
+  br_.sendTransform(tf::StampedTransform(world2baselink_tf * root2baselink_tf.inverse(), now, "world", tf::resolve(tf_prefix_, std::string("root"))));
 
   /* COG */
-  /* Rotation */
-  getOrientation(Frame::COG, estimate_mode_).getRotation(q);
-  tf::quaternionTFToMsg(q, odom_state.pose.pose.orientation);
-  tf::vector3TFToMsg(getAngularVel(Frame::COG, estimate_mode_), odom_state.twist.twist.angular);
-  /* Translation */
-  odom_state.child_frame_id = tf::resolve(tf_prefix_, std::string("cog"));
-  tf::pointTFToMsg(getPos(Frame::COG, estimate_mode_), odom_state.pose.pose.position);
-  tf::vector3TFToMsg(getVel(Frame::COG, estimate_mode_), odom_state.twist.twist.linear);
-  cog_odom_pub_.publish(odom_state);
+  cog_odom_msg_.header.stamp = now;
+  fillOdom(states, Frame::COG, cog_odom_msg_);
+  cog_odom_pub_.publish(cog_odom_msg_);
 
+  /* Full state */
+  full_state_msg_.header.stamp = now;
+  for(int axis = 0; axis < State::TOTAL_NUM; axis++)
+    {
+      for(int mode = 0; mode < 3; mode++)
+        tf::vector3TFToMsg(states[axis][mode].second, full_state_msg_.states[axis].state[mode]);
+    }
+  full_state_pub_.publish(full_state_msg_);
+
+  /* decimated full state for the logging over the slow link */
+  if(full_state_decimation_ > 1 && publish_cnt_++ % full_state_decimation_ == 0)
+    full_state_throttle_pub_.publish(full_state_msg_);
+}
 
+void StateEstimator::fillOdom(const array<AxisState, State::TOTAL_NUM>& states, int frame, nav_msgs::Odometry& odom)
+{
+  /* Rotation */
+  tf::Matrix3x3 r;
+  r.setRPY(states[State::ROLL_COG + frame * 3][estimate_mode_].second[0],
+           states[State::PITCH_COG + frame * 3][estimate_mode_].second[0],
+           states[State::YAW_COG + frame * 3][estimate_mode_].second[0]);
+  tf::Quaternion q; r.getRotation(q);
+  tf::quaternionTFToMsg(q, odom.pose.pose.orientation);
+  tf::vector3TFToMsg(tf::Vector3(states[State::ROLL_COG + frame * 3][estimate_mode_].second[1],
+                                 states[State::PITCH_COG + frame * 3][estimate_mode_].second[1],
+                                 states[State::YAW_COG + frame * 3][estimate_mode_].second[1]),
+                     odom.twist.twist.angular);
+
+  /* Translation */
+  tf::pointTFToMsg(tf::Vector3(states[State::X_COG + frame * 3][estimate_mode_].second[0],
+                               states[State::Y_COG + frame * 3][estimate_mode_].second[0],
+                               states[State::Z_COG + frame * 3][estimate_mode_].second[0]),
+                   odom.pose.pose.position);
+  tf::vector3TFToMsg(tf::Vector3(states[State::X_COG + frame * 3][estimate_mode_].second[1],
+                                 states[State::Y_COG + frame * 3][estimate_mode_].second[1],
+                                 states[State::Z_COG + frame * 3][estimate_mode_].second[1]),
+                     odom.twist.twist.linear);
 }
 
 
@@ -0,0 +1,202 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <aerial_robot_estimation/vision/flow_tracker.h>
+#include <algorithm>
+#include <cmath>
+
+namespace aerial_robot_estimation
+{
+  FlowTracker::FlowTracker():
+    camera_f_(1.0), camera_cx_(0), camera_cy_(0), image_cut_pixel_(10),
+    max_count_(100), min_count_(50), quality_level_(0.01), min_distance_(10),
+    win_size_(31, 31), max_level_(3),
+    termcrit_(cv::TermCriteria::MAX_ITER + cv::TermCriteria::EPS, 20, 0.03),
+    outlier_scale_(3.0), min_outlier_thresh_(0.01),
+    redetected_(false)
+  {
+  }
+
+  void FlowTracker::setCamera(double f, double cx, double cy, int cut_pixel)
+  {
+    camera_f_ = f;
+    camera_cx_ = cx;
+    camera_cy_ = cy;
+    image_cut_pixel_ = cut_pixel;
+  }
+
+  void FlowTracker::setFeatureParams(int max_count, int min_count, double quality_level, double min_distance)
+  {
+    max_count_ = max_count;
+    min_count_ = std::min(min_count, max_count);
+    quality_level_ = quality_level;
+    min_distance_ = min_distance;
+  }
+
+  void FlowTracker::setLKParams(int win_size, int max_level, int max_iter)
+  {
+    win_size_ = cv::Size(win_size, win_size);
+    max_level_ = max_level;
+    termcrit_ = cv::TermCriteria(cv::TermCriteria::MAX_ITER + cv::TermCriteria::EPS, max_iter, 0.03);
+  }
+
+  void FlowTracker::setOutlierParams(double outlier_scale, double min_outlier_thresh)
+  {
+    outlier_scale_ = outlier_scale;
+    min_outlier_thresh_ = min_outlier_thresh;
+  }
+
+  void FlowTracker::reset()
+  {
+    prev_pyr_.clear();
+    prev_points_.clear();
+    curr_points_.clear();
+  }
+
+  bool FlowTracker::track(const cv::Mat& gray)
+  {
+    redetected_ = false;
+
+    /* the pyramid of the previous image is kept, and the buffers are reused for the next image */
+    cv::buildOpticalFlowPyramid(gray, curr_pyr_, win_size_, max_level_, true);
+
+    bool first = prev_pyr_.empty();
+    if(!first)
+      {
+        /* the features in the previous image: tracked ones, and the new ones if not enough */
+        if((int)curr_points_.size() < min_count_) detect(prev_pyr_.at(0));
+        prev_points_.swap(curr_points_);
+
+        if(!prev_points_.empty())
+          cv::calcOpticalFlowPyrLK(prev_pyr_, curr_pyr_, prev_points_, curr_points_, status_, err_, win_size_, max_level_, termcrit_, 0, 0.001);
+        else
+          curr_points_.clear();
+
+        /* remove the lost features and the features near the image edge */
+        size_t valid = 0;
+        for(size_t i = 0; i < curr_points_.size(); i++)
+          {
+            if(!status_[i]) continue;
+            const cv::Point2f& p = curr_points_[i];
+            if(p.x < image_cut_pixel_ || p.x >= gray.cols - image_cut_pixel_ ||
+               p.y < image_cut_pixel_ || p.y >= gray.rows - image_cut_pixel_) continue;
+
+            prev_points_[valid] = prev_points_[i];
+            curr_points_[valid] = p;
+            valid++;
+          }
+        prev_points_.resize(valid);
+        curr_points_.resize(valid);
+      }
+
+    std::swap(prev_pyr_, curr_pyr_);
+
+    return !first;
+  }
+
+  void FlowTracker::detect(const cv::Mat& gray)
+  {
+    int count = max_count_ - (int)curr_points_.size();
+    if(count <= 0) return;
+
+    /* avoid the neighborhood of the tracked features */
+    mask_.create(gray.size(), CV_8UC1);
+    mask_.setTo(cv::Scalar(255));
+    for(const auto& p: curr_points_) cv::circle(mask_, p, min_distance_, cv::Scalar(0), -1);
+
+    cv::goodFeaturesToTrack(gray, new_points_, count, quality_level_, min_distance_, mask_, 3, false, 0.04);
+    if(new_points_.empty()) return;
+
+    cv::cornerSubPix(gray, new_points_, cv::Size(10, 10), cv::Size(-1, -1), termcrit_);
+    curr_points_.insert(curr_points_.end(), new_points_.begin(), new_points_.end());
+    redetected_ = true;
+  }
+
+  int FlowTracker::estimateVelocity(double dt, const cv::Vec3d& ang_vel, double height, double height_vel, cv::Vec3d& vel)
+  {
+    vel = cv::Vec3d(0, 0, 0);
+    size_t n = curr_points_.size();
+    if(n == 0 || dt <= 0) return 0;
+
+    /* velocity of each feature on the ground plane, with the rotation compensation */
+    vel_x_.resize(n);
+    vel_y_.resize(n);
+    for(size_t i = 0; i < n; i++)
+      {
+        double x = curr_points_[i].x - camera_cx_, prev_x = prev_points_[i].x - camera_cx_;
+        double y = curr_points_[i].y - camera_cy_, prev_y = prev_points_[i].y - camera_cy_;
+
+        vel_x_[i] = height_vel * x / camera_f_ + (-(x - prev_x) / dt - ang_vel[1] * camera_f_ + ang_vel[2] * y + (ang_vel[0] * x * y - ang_vel[1] * x * x) / camera_f_) * height / camera_f_;
+        vel_y_[i] = height_vel * y / camera_f_ + (-(y - prev_y) / dt + ang_vel[0] * camera_f_ - ang_vel[2] * x + (ang_vel[0] * y * y - ang_vel[1] * x * y) / camera_f_) * height / camera_f_;
+      }
+
+    /* median and the median absolute deviation, robust against the moving objects and the wrong matches */
+    double median_x = median(vel_x_);
+    double median_y = median(vel_y_);
+    sorted_.resize(n);
+    for(size_t i = 0; i < n; i++) sorted_[i] = fabs(vel_x_[i] - median_x);
+    double thresh_x = std::max(outlier_scale_ * 1.4826 * median(sorted_), min_outlier_thresh_);
+    for(size_t i = 0; i < n; i++) sorted_[i] = fabs(vel_y_[i] - median_y);
+    double thresh_y = std::max(outlier_scale_ * 1.4826 * median(sorted_), min_outlier_thresh_);
+
+    /* mean of the inliers, and the outliers are not tracked anymore */
+    double sum_x = 0, sum_y = 0;
+    size_t inlier = 0;
+    for(size_t i = 0; i < n; i++)
+      {
+        if(fabs(vel_x_[i] - median_x) > thresh_x || fabs(vel_y_[i] - median_y) > thresh_y) continue;
+
+        sum_x += vel_x_[i];
+        sum_y += vel_y_[i];
+        prev_points_[inlier] = prev_points_[i];
+        curr_points_[inlier] = curr_points_[i];
+        inlier++;
+      }
+    prev_points_.resize(inlier);
+    curr_points_.resize(inlier);
+
+    if(inlier > 0) vel = cv::Vec3d(sum_x / inlier, sum_y / inlier, height_vel);
+    return inlier;
+  }
+
+  double FlowTracker::median(const std::vector<double>& values)
+  {
+    /* the values can be sorted_ itself */
+    if(&values != &sorted_) sorted_.assign(values.begin(), values.end());
+    size_t mid = sorted_.size() / 2;
+    std::nth_element(sorted_.begin(), sorted_.begin() + mid, sorted_.end());
+    return sorted_[mid];
+  }
+
+} //namespace aerial_robot_estimation
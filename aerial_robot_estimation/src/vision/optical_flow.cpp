@@ -1,23 +1,5 @@
 #include <aerial_robot_estimation/vision/optical_flow.h>
 
-namespace {
-#if USE_GPU
-  void download(const cv::gpu::GpuMat& d_mat, std::vector<cv::Point2f>& vec)
-  {
-    vec.resize(d_mat.cols);
-    cv::Mat mat(1, d_mat.cols, CV_32FC2, (void*)&vec[0]);
-    d_mat.download(mat);
-  }
-  
-  void download(const cv::gpu::GpuMat& d_mat, std::vector<uchar>& vec)
-  {
-    vec.resize(d_mat.cols);
-    cv::Mat mat(1, d_mat.cols, CV_8UC1, (void*)&vec[0]);
-    d_mat.download(mat);
-  }
-#endif
-}
-
 namespace aerial_robot_estimation
 {
   void OpticalFlow::onInit()
@@ -44,12 +26,27 @@ namespace aerial_robot_estimation
     nhp_.param("camera_pitch_offset", camera_pitch_, 0.0);
     nhp_.param("camera_yaw_offset", camera_yaw_, -M_PI / 2);
     nhp_.param("verbose", verbose_, false);
-    nhp_.param("max_count", max_count_, 100);
     nhp_.param("use_sonar", use_sonar_, false);
     nhp_.param("sonar_offset", sonar_offset_, 0.0);
     nhp_.param("image_crop_scale", image_crop_scale_, 1.0);
     nhp_.param("image_cut_pixel", image_cut_pixel_, 10);
 
+    /* feature tracking: re-detect the features only when the tracked ones are less than min_count */
+    int max_count, min_count, win_size, max_level, max_iter;
+    double quality_level, min_distance, outlier_scale, min_outlier_thresh;
+    nhp_.param("max_count", max_count, 100);
+    nhp_.param("min_count", min_count, 50);
+    nhp_.param("quality_level", quality_level, 0.01);
+    nhp_.param("min_distance", min_distance, 10.0);
+    nhp_.param("win_size", win_size, 31);
+    nhp_.param("max_level", max_level, 3);
+    nhp_.param("max_iter", max_iter, 20);
+    nhp_.param("outlier_scale", outlier_scale, 3.0); // scale of the median absolute deviation
+    nhp_.param("min_outlier_thresh", min_outlier_thresh, 0.01); // [m/s]
+    tracker_.setFeatureParams(max_count, min_count, quality_level, min_distance);
+    tracker_.setLKParams(win_size, max_level, max_iter);
+    tracker_.setOutlierParams(outlier_scale, min_outlier_thresh);
+
     /* subscriber */
     downward_camera_image_sub_ = nh_.subscribe(downward_camera_image_topic_name_, 1, &OpticalFlow::downwardCameraImageCallback, this);
     downward_camera_info_sub_ = nh_.subscribe(downward_camera_info_topic_name_, 1, &OpticalFlow::downwardCameraInfoCallback, this);
@@ -65,12 +62,6 @@ namespace aerial_robot_estimation
 
     camera_rotation_mat_.setRPY(camera_roll_, camera_pitch_, camera_yaw_); //imu->camera
     camera_rotation_mat_inv_ = camera_rotation_mat_.inverse(); //camera->imu
-
-#if USE_GPU
-    ROS_WARN("optical flow gpu mode");
-#else
-    ROS_WARN("optical flow no gpu mode");
-#endif
   }
 
   void OpticalFlow::downwardCameraImageCallback(const sensor_msgs::ImageConstPtr& msg)
@@ -81,109 +72,47 @@ namespace aerial_robot_estimation
       return;
     }
     tf::Vector3 ang_vel = camera_rotation_mat_inv_ * ang_vel_;
-    cv::Mat src_img = cv_bridge::toCvCopy(msg, msg->encoding)->image;
+
+    /* no copy of the image message, the crop is also the reference of the shared image */
+    cv_bridge::CvImageConstPtr src_ptr = cv_bridge::toCvShare(msg);
+    cv::Mat src_img = src_ptr->image;
 
     if (image_crop_scale_ != 1.0) {
       src_img = src_img(cv::Range(src_img.rows * (1 - image_crop_scale_) / 2, src_img.rows * (1 + image_crop_scale_) / 2), cv::Range(src_img.cols * (1 - image_crop_scale_) / 2, src_img.cols * (1 + image_crop_scale_) / 2));
     }
-    std::vector<cv::Point2f> points[2];
 
-    //calc features
-#if USE_GPU
-    cv::gpu::GpuMat d_src_img(src_img);
+    const cv::Mat* gray_img = &src_img;
     if (src_img.channels() > 1) {
-      cv::gpu::cvtColor(d_src_img, d_frame1Gray, cv::COLOR_BGR2GRAY);
-    } else {
-      d_frame1Gray = d_src_img;
+      cv::cvtColor(src_img, gray_img_, cv::COLOR_BGR2GRAY);
+      gray_img = &gray_img_;
     }
 
-    if (d_frame0Gray.empty()) d_frame1Gray.copyTo(d_frame0Gray);
-    cv::gpu::GoodFeaturesToTrackDetector_GPU detector(max_count_, 0.01, 10, 5, false, 0.04);
-    cv::gpu::GpuMat d_prevPts;
-    detector(d_frame0Gray, d_prevPts);
-#else
-    cv::Mat gray_img;
-    if (src_img.channels() > 1) {
-      cv::cvtColor(src_img, gray_img, cv::COLOR_BGR2GRAY);
-    } else {
-      src_img.copyTo(gray_img);
-    }
-    if(prev_gray_img_.empty()) gray_img.copyTo(prev_gray_img_);
-
-    cv::TermCriteria termcrit(cv::TermCriteria::MAX_ITER + cv::TermCriteria::EPS, 20, 0.03);
-    cv::Size subPixWinSize(10,10), winSize(31,31);
-    cv::goodFeaturesToTrack(gray_img, points[0], max_count_, 0.01, 10, cv::Mat(), 3, false, 0.04);
-    cv::cornerSubPix(gray_img, points[0], subPixWinSize, cv::Size(-1,-1), termcrit);
-#endif
-
     double time = (msg->header.stamp - prev_stamp_).toSec();
     prev_stamp_ = msg->header.stamp;
 
-    std::vector<uchar> status;
-
     //calc optical flow
-#if USE_GPU
-    cv::gpu::PyrLKOpticalFlow d_pyrLK;
-
-    d_pyrLK.winSize.width = 31;
-    d_pyrLK.winSize.height = 31;
-    d_pyrLK.maxLevel = 3;
-    d_pyrLK.iters = 30;
-
-    cv::gpu::GpuMat d_nextPts, d_status;
-
-    d_pyrLK.sparse(d_frame0Gray, d_frame1Gray, d_prevPts, d_nextPts, d_status);
-
-    points[0].resize(d_prevPts.cols);
-    download(d_prevPts, points[0]);
-
-    points[1].resize(d_nextPts.cols);
-    download(d_nextPts, points[1]);
-
-    status.resize(d_status.cols);
-    download(d_status, status);
-#else
-    std::vector<float> err;
-    if (!points[0].empty())
-      cv::calcOpticalFlowPyrLK(prev_gray_img_, gray_img, points[0], points[1], status, err, winSize, 3, termcrit, 0, 0.001);
-#endif
-    tf::Vector3 camera_vel;
-    double camera_x_vel = 0.0, camera_y_vel = 0.0;
-    size_t valid_point = 0;
-    for(size_t i = 0; i < points[0].size(); i++) {
-      if(!status[i]) continue;
-
-      double x = points[1][i].x - camera_cx_, prev_x = points[0][i].x - camera_cx_;
-      double y = points[1][i].y - camera_cy_, prev_y = points[0][i].y - camera_cy_;
-
-      if(fabs(x) > (camera_cx_ - image_cut_pixel_)  || fabs(y) > (camera_cy_ - image_cut_pixel_)) continue;
-
-      camera_x_vel += sonar_vel_ * x / camera_f_ + (-(x - prev_x) / time - ang_vel.y() * camera_f_ + ang_vel.z() * y + (ang_vel.x() * x * y - ang_vel.y() * x * x) / camera_f_) * sonar_ / camera_f_;
-      camera_y_vel += sonar_vel_ * y / camera_f_ + (-(y - prev_y) / time + ang_vel.x() * camera_f_ - ang_vel.z() * x + (ang_vel.x() * y * y - ang_vel.y() * x * y) / camera_f_) * sonar_ / camera_f_;
-      valid_point++;
-      if (verbose_) {
-	cv::circle(src_img, points[0][i], 3, cv::Scalar(0,255,0), -1, 8);
-	cv::line(src_img, points[1][i], points[0][i], cv::Scalar(0,255,0), 1, 8, 0);
+    cv::Vec3d camera_vel(0, 0, 0);
+    if (tracker_.track(*gray_img))
+      tracker_.estimateVelocity(time, cv::Vec3d(ang_vel.x(), ang_vel.y(), ang_vel.z()), sonar_, sonar_vel_, camera_vel);
+
+    tf::Vector3 vel = camera_rotation_mat_ * tf::Vector3(camera_vel[0], camera_vel[1], camera_vel[2]);
+
+    if (verbose_) {
+      src_img.copyTo(debug_img_);
+      const std::vector<cv::Point2f>& prev_points = tracker_.getPrevPoints();
+      const std::vector<cv::Point2f>& curr_points = tracker_.getCurrPoints();
+      for(size_t i = 0; i < curr_points.size(); i++) {
+        cv::circle(debug_img_, prev_points[i], 3, cv::Scalar(0,255,0), -1, 8);
+        cv::line(debug_img_, curr_points[i], prev_points[i], cv::Scalar(0,255,0), 1, 8, 0);
       }
+      optical_flow_image_pub_.publish(cv_bridge::CvImage(msg->header, msg->encoding, debug_img_).toImageMsg());
     }
 
-    if (valid_point != 0) camera_vel.setValue(camera_x_vel / valid_point, camera_y_vel / valid_point, sonar_vel_);
-    else camera_vel.setValue(0.0, 0.0, 0.0);
-
-    camera_vel = camera_rotation_mat_ * camera_vel;
-
-    if (verbose_)
-      optical_flow_image_pub_.publish(cv_bridge::CvImage(msg->header, msg->encoding, src_img).toImageMsg());
-#if USE_GPU
-    d_frame0Gray.swap(d_frame1Gray);
-#else
-    cv::swap(prev_gray_img_, gray_img);
-#endif
     geometry_msgs::Vector3Stamped camera_vel_msg;
     camera_vel_msg.header = msg->header;
-    camera_vel_msg.vector.x = camera_vel.x();
-    camera_vel_msg.vector.y = camera_vel.y();
-    camera_vel_msg.vector.z = camera_vel.z();
+    camera_vel_msg.vector.x = vel.x();
+    camera_vel_msg.vector.y = vel.y();
+    camera_vel_msg.vector.z = vel.z();
     camera_vel_pub_.publish(camera_vel_msg);
   }
 
@@ -194,6 +123,7 @@ namespace aerial_robot_estimation
     camera_cx_ = msg->K[2] * image_crop_scale_;
     camera_cy_ = msg->K[5] * image_crop_scale_;
     if (msg->K[0] > 0) {
+      tracker_.setCamera(camera_f_, camera_cx_, camera_cy_, image_cut_pixel_);
       camera_info_update_ = true;
     }
   }
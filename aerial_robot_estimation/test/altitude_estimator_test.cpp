@@ -0,0 +1,320 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of aerial_robot_estimation::AltitudeEstimator with synthetic imu (200Hz), range (40Hz) and baro (25Hz) streams:
+       the stairs and the table under the hovering vehicle, the climb over the flat ground and over a ledge,
+       the spikes of the range sensor, the dropout of the range with a terrain change and the convergence of the baro bias.
+       The table is also flown without the terrain check (the former behaviour of sensor_plugin::Alt without baro).
+       The height offset of sensor_plugin::Alt (z = range + height_offset) is followed from the takeoff over a step.
+*/
+
+#include <aerial_robot_estimation/sensor/altitude_estimator.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <functional>
+#include <random>
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const double INIT_HEIGHT = 1.0; // [m]
+  const double RANGE_SIGMA = 0.01, BARO_SIGMA = 0.05, ACC_SIGMA = 0.1;
+  const double BARO_OFFSET = 12.3, BARO_DRIFT = 0.002; // [m], [m/s]
+  const double ACC_BIAS = 0.02; // [m/s^2], residual of the imu bias estimation
+  const double MAX_RANGE = 40.0;
+
+  struct Flight
+  {
+    double duration;
+    std::function<double(double)> acc; // vertical acc of the vehicle
+    std::function<double(double)> terrain;
+    /* the measured range is modified, false: no sample */
+    std::function<bool(double, double&)> range_fault;
+
+    Flight(double duration): duration(duration),
+                             acc([](double){ return 0.0; }), terrain([](double){ return 0.0; }),
+                             range_fault([](double, double&){ return true; }) {}
+  };
+
+  struct Log
+  {
+    double max_z_error, rms_z_error;
+    double final_terrain, true_terrain;
+    double final_bias, true_bias;
+  };
+
+  /* climb (or descend) by the height in the duration from the start, zero velocity at both ends */
+  double smoothClimb(double t, double start, double duration, double height)
+  {
+    if(t < start || t > start + duration) return 0;
+    return 2 * M_PI * height / (duration * duration) * sin(2 * M_PI * (t - start) / duration);
+  }
+
+  double steps(double t, const std::vector<double>& times, double height)
+  {
+    double terrain = 0;
+    for(double time : times) if(t >= time) terrain += height;
+    return terrain;
+  }
+
+  AltitudeEstimator createEstimator()
+  {
+    AltitudeEstimator estimator;
+    estimator.setRangeNoise(RANGE_SIGMA);
+    estimator.setBaroNoise(BARO_SIGMA, 0.001);
+    estimator.setAccNoise(0.2);
+    estimator.setRangeLimits(0.05, MAX_RANGE);
+    return estimator;
+  }
+
+  /* truth at 1kHz, imu every 5 ticks, range every 25 ticks, baro every 40 ticks */
+  Log fly(const Flight& flight, AltitudeEstimator& estimator, unsigned int seed = 1)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    const double dt = 1e-3;
+    double z = INIT_HEIGHT, vz = 0;
+    estimator.reset(z, flight.terrain(0), 0);
+
+    Log log;
+    log.max_z_error = 0;
+    double square_sum = 0;
+    int count = 0;
+    for(int k = 1; k <= flight.duration / dt; k++)
+      {
+        double t = k * dt;
+        double acc = flight.acc(t);
+        z += vz * dt + 0.5 * acc * dt * dt;
+        vz += acc * dt;
+
+        if(k % 5 == 0) estimator.predict(acc + ACC_BIAS + ACC_SIGMA * normal(engine), t);
+
+        if(k % 25 == 0)
+          {
+            double range = z - flight.terrain(t) + RANGE_SIGMA * normal(engine);
+            if(flight.range_fault(t, range)) estimator.updateRange(range, t);
+          }
+
+        if(k % 40 == 0)
+          estimator.updateBaro(z + BARO_OFFSET + BARO_DRIFT * t + BARO_SIGMA * normal(engine), t);
+
+        if(k % 5 == 0)
+          {
+            double error = fabs(estimator.getHeight() - z);
+            if(error > log.max_z_error) log.max_z_error = error;
+            square_sum += error * error;
+            count++;
+          }
+      }
+
+    log.rms_z_error = sqrt(square_sum / count);
+    log.final_terrain = estimator.getTerrainHeight();
+    log.true_terrain = flight.terrain(flight.duration);
+    log.final_bias = estimator.getBaroBias();
+    log.true_bias = -BARO_OFFSET - BARO_DRIFT * flight.duration;
+    return log;
+  }
+}
+
+TEST(AltitudeEstimatorTest, Stairs)
+{
+  /* the vehicle goes up the stairs at the same height */
+  Flight flight(10.0);
+  flight.terrain = [](double t) { return steps(t, {2.0, 3.0, 4.0, 5.0, 6.0}, 0.18); };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 5);
+  EXPECT_LT(log.max_z_error, 0.05);
+  EXPECT_NEAR(log.final_terrain, log.true_terrain, 0.03);
+  RecordProperty("max_z_error_mm", static_cast<int>(log.max_z_error * 1000));
+}
+
+TEST(AltitudeEstimatorTest, Table)
+{
+  Flight flight(8.0);
+  flight.terrain = [](double t) { return (t >= 3.0 && t < 5.0) ? 0.75 : 0.0; };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 2);
+  EXPECT_LT(log.max_z_error, 0.05);
+  EXPECT_NEAR(log.final_terrain, 0.0, 0.03);
+
+  /* without the terrain check, the table is the descent of the vehicle */
+  AltitudeEstimator legacy = createEstimator();
+  legacy.setTerrainCheck(false, 0, 0, 0, 1);
+  Log legacy_log = fly(flight, legacy);
+  EXPECT_GT(legacy_log.max_z_error, 0.5);
+
+  RecordProperty("max_z_error_mm", static_cast<int>(log.max_z_error * 1000));
+  RecordProperty("legacy_max_z_error_mm", static_cast<int>(legacy_log.max_z_error * 1000));
+}
+
+TEST(AltitudeEstimatorTest, HeightOffset)
+{
+  /* the sensor is 0.1m above the ground on the landing gear: the offset is calibrated on the ground as in sensor_plugin::Alt */
+  const double mount = 0.1, step = 0.3;
+  std::mt19937 engine(5);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  auto acc = [](double t) { return smoothClimb(t, 1.0, 3.0, 1.0); };
+  auto terrain = [&](double t) { return t >= 6.0 ? step : 0.0; };
+
+  const double range_sensor_offset = -mount;
+  double height_offset = range_sensor_offset;
+  AltitudeEstimator estimator = createEstimator();
+  estimator.resetFromRange(mount, height_offset, 0);
+  EXPECT_NEAR(estimator.getHeight(), 0.0, 1e-9);
+
+  const double dt = 1e-3;
+  double z = 0, vz = 0, max_z_error = 0, landing_height = 0;
+  bool checked_before_step = false;
+  for(int k = 1; k <= 10.0 / dt; k++)
+    {
+      double t = k * dt;
+      z += vz * dt + 0.5 * acc(t) * dt * dt;
+      vz += acc(t) * dt;
+      if(k % 5 == 0) estimator.predict(acc(t) + ACC_SIGMA * normal(engine), t);
+      if(k % 25 == 0)
+        {
+          double range = z + mount - terrain(t) + RANGE_SIGMA * normal(engine);
+          AltitudeEstimator::Result result = estimator.updateRange(range, t);
+          height_offset = estimator.getHeightOffset();
+          if(t < 6.0 && estimator.getRangeState() != AltitudeEstimator::RANGE_NORMAL) checked_before_step = true;
+          if(result.terrain_step) landing_height = height_offset - range_sensor_offset;
+          if(result.valid) max_z_error = std::max(max_z_error, fabs(estimator.rangeToHeight(range) - z));
+        }
+      if(k % 40 == 0) estimator.updateBaro(z + BARO_OFFSET + BARO_SIGMA * normal(engine), t);
+    }
+
+  /* the first range is consistent, the step moves the offset and the landing height up */
+  EXPECT_FALSE(checked_before_step);
+  EXPECT_EQ(estimator.getStepCount(), 1);
+  EXPECT_NEAR(height_offset, range_sensor_offset + step, 0.03);
+  EXPECT_NEAR(landing_height, step, 0.03);
+  EXPECT_LT(max_z_error, 0.05);
+}
+
+TEST(AltitudeEstimatorTest, Climb)
+{
+  /* up and down by 1.5m over the flat ground: no step */
+  Flight flight(12.0);
+  flight.acc = [](double t) { return smoothClimb(t, 1.0, 4.0, 1.5) + smoothClimb(t, 6.0, 3.0, -1.5); };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 0);
+  EXPECT_EQ(estimator.getOutlierCount(), 0);
+  EXPECT_LT(log.max_z_error, 0.05);
+  EXPECT_NEAR(log.final_terrain, 0.0, 0.03);
+}
+
+TEST(AltitudeEstimatorTest, ClimbOverLedge)
+{
+  /* the ground drops by 0.4m during the climb: only the terrain change is the step */
+  Flight flight(10.0);
+  flight.acc = [](double t) { return smoothClimb(t, 2.0, 4.0, 1.0); };
+  flight.terrain = [](double t) { return steps(t, {4.0}, -0.4); };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 1);
+  EXPECT_LT(log.max_z_error, 0.05);
+  EXPECT_NEAR(log.final_terrain, log.true_terrain, 0.03);
+}
+
+TEST(AltitudeEstimatorTest, Spikes)
+{
+  /* 3% of the range hits the obstacles (e.g. the legs, the dust) between the sensor and the ground */
+  std::mt19937 engine(3);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  Flight flight(20.0);
+  flight.acc = [](double t) { return smoothClimb(t, 5.0, 5.0, 1.0); };
+  flight.range_fault = [&](double, double& range)
+    {
+      if(uniform(engine) < 0.03) range *= uniform(engine);
+      return true;
+    };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 0);
+  EXPECT_GT(estimator.getOutlierCount(), 10);
+  EXPECT_LT(log.max_z_error, 0.05);
+  EXPECT_NEAR(log.final_terrain, 0.0, 0.03);
+  RecordProperty("outlier_count", estimator.getOutlierCount());
+}
+
+TEST(AltitudeEstimatorTest, Dropout)
+{
+  /* out of range for 3s, the terrain rises by 0.4m meanwhile: the baro keeps the height, the terrain is re-anchored */
+  Flight flight(10.0);
+  flight.terrain = [](double t) { return steps(t, {4.5}, 0.4); };
+  flight.range_fault = [](double t, double& range)
+    {
+      if(t >= 3.0 && t < 6.0) range = 2 * MAX_RANGE;
+      return true;
+    };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_EQ(estimator.getStepCount(), 0);
+  EXPECT_TRUE(estimator.rangeAvailable());
+  EXPECT_LT(log.max_z_error, 0.15);
+  EXPECT_NEAR(log.final_terrain, log.true_terrain, 0.1);
+  RecordProperty("max_z_error_mm", static_cast<int>(log.max_z_error * 1000));
+
+  /* no sample at all (e.g. the driver stops) */
+  flight.range_fault = [](double t, double&) { return t < 3.0 || t >= 6.0; };
+  AltitudeEstimator silent = createEstimator();
+  Log silent_log = fly(flight, silent);
+  EXPECT_EQ(silent.getStepCount(), 0);
+  EXPECT_LT(silent_log.max_z_error, 0.15);
+  EXPECT_NEAR(silent_log.final_terrain, silent_log.true_terrain, 0.1);
+}
+
+TEST(AltitudeEstimatorTest, BaroBias)
+{
+  Flight flight(30.0);
+  flight.acc = [](double t) { return smoothClimb(t, 5.0, 5.0, 2.0) + smoothClimb(t, 15.0, 5.0, -1.0); };
+
+  AltitudeEstimator estimator = createEstimator();
+  Log log = fly(flight, estimator);
+  EXPECT_NEAR(log.final_bias, log.true_bias, 0.05);
+  EXPECT_LT(log.rms_z_error, 0.02);
+  EXPECT_LE(estimator.getBaroRejectCount(), 5); // 0.1% of the gaussian noise
+}
@@ -0,0 +1,162 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Software License Agreement (BSD License)
+
+# Copyright (c) 2019, JSK Robotics Laboratory, The University of Tokyo
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in the
+#       documentation and/or other materials provided with the distribution.
+#     * Neither the name of the Willow Garage, Inc. nor the names of its
+#       contributors may be used to endorse or promote products derived from
+#       this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+
+# synthetic dataset for state_estimator_replay: imu (spinal/Imu) and mocap (geometry_msgs/PoseStamped) streams
+# with the reference track of baselink. the robot keeps hovering during the imu calibration, then moves along
+# a smooth 3D curve with yaw rotation.
+#
+# csv rows (stamp, type, topic, values...):
+#   imu: acc_x, acc_y, acc_z, gyro_x, gyro_y, gyro_z, roll, pitch, yaw
+#   pose: x, y, z, qx, qy, qz, qw
+#   reference: x, y, z, vx, vy, vz, roll, pitch, yaw, wx, wy, wz
+#              (baselink in world frame, angular velocity in baselink frame)
+#
+# usage: generate_dataset.py [output.csv]
+
+import argparse
+import math
+import random
+
+G = 9.797  # same with aerial_robot_estimation::G
+
+
+def trajectory(t, static_duration):
+    """ position and attitude (roll, pitch, yaw) of baselink """
+    s = max(0.0, t - static_duration)
+    pos = [0.4 * (1 - math.cos(2 * math.pi * 0.2 * s)),
+           0.3 * math.sin(2 * math.pi * 0.1 * s) ** 2,
+           1.0 + 0.2 * (1 - math.cos(2 * math.pi * 0.15 * s))]
+    rpy = [0.05 * math.sin(2 * math.pi * 0.3 * s),
+           0.05 * math.sin(2 * math.pi * 0.25 * s) ** 2,
+           0.3 * math.sin(2 * math.pi * 0.05 * s) ** 2]
+    return pos, rpy
+
+
+def derivative(func, t, dt=1e-4):
+    p, q = func(t + dt), func(t - dt)
+    return [(a - b) / (2 * dt) for a, b in zip(p, q)]
+
+
+def rotation(rpy):
+    """ body to world, same with tf::Matrix3x3::setRPY """
+    sr, cr = math.sin(rpy[0]), math.cos(rpy[0])
+    sp, cp = math.sin(rpy[1]), math.cos(rpy[1])
+    sy, cy = math.sin(rpy[2]), math.cos(rpy[2])
+    return [[cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr],
+            [sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr],
+            [-sp, cp * sr, cp * cr]]
+
+
+def quaternion(rpy):
+    cr, sr = math.cos(rpy[0] / 2), math.sin(rpy[0] / 2)
+    cp, sp = math.cos(rpy[1] / 2), math.sin(rpy[1] / 2)
+    cy, sy = math.cos(rpy[2] / 2), math.sin(rpy[2] / 2)
+    return [sr * cp * cy - cr * sp * sy,
+            cr * sp * cy + sr * cp * sy,
+            cr * cp * sy - sr * sp * cy,
+            cr * cp * cy + sr * sp * sy]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('output', nargs='?', default='circle_mocap.csv')
+    parser.add_argument('--duration', type=float, default=12.0)
+    parser.add_argument('--static_duration', type=float, default=3.0)  # warm up (100 samples) + calib_time (2.0 sec)
+    parser.add_argument('--imu_rate', type=float, default=200.0)
+    parser.add_argument('--mocap_rate', type=float, default=100.0)
+    parser.add_argument('--reference_rate', type=float, default=50.0)
+    parser.add_argument('--acc_noise', type=float, default=0.05)
+    parser.add_argument('--acc_bias', type=float, nargs=3, default=[0.05, -0.03, 0.02])
+    parser.add_argument('--gyro_noise', type=float, default=0.005)
+    parser.add_argument('--angle_noise', type=float, default=0.002)
+    parser.add_argument('--mocap_pos_noise', type=float, default=0.001)
+    parser.add_argument('--mocap_rot_noise', type=float, default=0.002)
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rand = random.Random(args.seed)
+    start = 1.0  # ros::Time can not be zero
+    traj = lambda t: trajectory(t, args.static_duration)
+    pos_func = lambda t: traj(t)[0]
+    rpy_func = lambda t: traj(t)[1]
+    vel_func = lambda t: derivative(pos_func, t)
+
+    def angular(t):
+        """ euler rate to body angular velocity """
+        rpy, drpy = rpy_func(t), derivative(rpy_func, t)
+        sr, cr = math.sin(rpy[0]), math.cos(rpy[0])
+        sp, cp = math.sin(rpy[1]), math.cos(rpy[1])
+        return [drpy[0] - sp * drpy[2],
+                cr * drpy[1] + sr * cp * drpy[2],
+                -sr * drpy[1] + cr * cp * drpy[2]]
+
+    rows = []
+
+    # imu
+    for i in range(int(args.duration * args.imu_rate)):
+        t = i / args.imu_rate
+        pos, rpy = traj(t)
+        acc_w = derivative(vel_func, t, 1e-3)
+        acc_w[2] += G
+        r = rotation(rpy)
+        acc_b = [sum(r[j][i_] * acc_w[j] for j in range(3)) + args.acc_bias[i_] + rand.gauss(0, args.acc_noise) for i_ in range(3)]
+
+        gyro = [w + rand.gauss(0, args.gyro_noise) for w in angular(t)]
+        angles = [a + rand.gauss(0, args.angle_noise) for a in rpy]
+        rows.append((start + t, 0, 'imu', 'imu', acc_b + gyro + angles))
+
+    # mocap
+    for i in range(int(args.duration * args.mocap_rate)):
+        t = i / args.mocap_rate
+        pos, rpy = traj(t)
+        pos = [p + rand.gauss(0, args.mocap_pos_noise) for p in pos]
+        q = quaternion([a + rand.gauss(0, args.mocap_rot_noise) for a in rpy])
+        rows.append((start + t, 1, 'pose', 'mocap/pose', pos + q))
+
+    # reference, evaluated after the sensor rows with the same stamp
+    for i in range(int(args.duration * args.reference_rate)):
+        t = i / args.reference_rate
+        pos, rpy = traj(t)
+        rows.append((start + t, 2, 'reference', '', pos + vel_func(t) + rpy + angular(t)))
+
+    rows.sort(key=lambda row: (row[0], row[1]))
+
+    with open(args.output, 'w') as f:
+        f.write('# generated by generate_dataset.py, seed %d\n' % args.seed)
+        f.write('# stamp,type,topic,values\n')
+        for stamp, _, row_type, topic, values in rows:
+            f.write('%.4f,%s,%s,%s\n' % (stamp, row_type, topic, ','.join('%.6g' % v for v in values)))
+
+
+if __name__ == '__main__':
+    main()
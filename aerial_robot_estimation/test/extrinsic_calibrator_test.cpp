@@ -0,0 +1,239 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of aerial_robot_estimation::ExtrinsicCalibrator with the synthetic hover and excitation flights:
+       the extrinsic of the sensor is the nominal value (urdf) with the injected mounting offset, the baselink attitude
+       by the imu and the sensor pose have the noise, and the sensor has its own world frame.
+*/
+
+#include <aerial_robot_estimation/sensor/extrinsic_calibrator.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const double RATE = 30.0; // [Hz], of the sensor
+  const double ROT_NOISE = 0.002; // [rad]
+  const double POS_NOISE = 0.003; // [m]
+
+  Eigen::Quaterniond rpy(double r, double p, double y)
+  {
+    return Eigen::AngleAxisd(y, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(p, Eigen::Vector3d::UnitY()) * Eigen::AngleAxisd(r, Eigen::Vector3d::UnitX());
+  }
+
+  /* downward camera in front of the baselink */
+  const Eigen::Quaterniond NOMINAL_Q = rpy(M_PI, 0, -M_PI / 2);
+  const Eigen::Vector3d NOMINAL_T(0.1, 0.0, -0.05);
+  /* mounting error */
+  const Eigen::Quaterniond TRUE_Q = rpy(0.03, -0.02, 0.05) * NOMINAL_Q;
+  const Eigen::Vector3d TRUE_T = NOMINAL_T + Eigen::Vector3d(0.02, -0.015, 0.03);
+
+  struct Flight
+  {
+    double duration; // [s]
+    double roll, pitch, yaw; // amplitude of the excitation [rad]
+    double outlier_ratio; // glitch of the sensor
+  };
+
+  Eigen::Quaterniond noise(std::normal_distribution<double>& dist, std::mt19937& engine, double sigma)
+  {
+    Eigen::Vector3d v(dist(engine), dist(engine), dist(engine));
+    v *= sigma;
+    return Eigen::Quaterniond(Eigen::AngleAxisd(v.norm(), v.norm() > 0 ? Eigen::Vector3d(v.normalized()) : Eigen::Vector3d::UnitX()));
+  }
+
+  void fly(ExtrinsicCalibrator& calibrator, const Flight& flight, unsigned int seed)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> dist(0, 1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    /* world of the sensor (e.g. the origin of the vo) */
+    Eigen::Quaterniond world_q = rpy(0, 0, 1.0);
+    Eigen::Vector3d world_p(3.0, -2.0, 0.5);
+
+    for(double t = 0; t < flight.duration; t += 1 / RATE)
+      {
+        /* hover with the attitude excitation and the slow drift */
+        Eigen::Quaterniond body_q = rpy(flight.roll * sin(2 * M_PI * 0.5 * t),
+                                        flight.pitch * sin(2 * M_PI * 0.37 * t + 1.0),
+                                        flight.yaw * sin(2 * M_PI * 0.1 * t));
+        Eigen::Vector3d body_p(0.1 * sin(0.3 * t), 0.1 * cos(0.2 * t), 1.0 + 0.05 * sin(0.5 * t));
+
+        Eigen::Quaterniond sensor_q = world_q * body_q * TRUE_Q;
+        Eigen::Vector3d sensor_p = world_q * (body_q * TRUE_T + body_p) + world_p;
+
+        /* measurement */
+        Eigen::Quaterniond imu_q = body_q * noise(dist, engine, ROT_NOISE);
+        Eigen::Vector3d ref_p = body_p + POS_NOISE * Eigen::Vector3d(dist(engine), dist(engine), dist(engine));
+        sensor_q = sensor_q * noise(dist, engine, ROT_NOISE);
+        sensor_p += POS_NOISE * Eigen::Vector3d(dist(engine), dist(engine), dist(engine));
+        if(uniform(engine) < flight.outlier_ratio)
+          {
+            sensor_q = sensor_q * noise(dist, engine, 0.2);
+            sensor_p += 0.1 * Eigen::Vector3d(dist(engine), dist(engine), dist(engine));
+          }
+
+        if(calibrator.add(t, imu_q, ref_p, sensor_q, sensor_p)) calibrator.solve();
+      }
+  }
+
+  double rotationError(const Eigen::Quaterniond& q)
+  {
+    return Eigen::AngleAxisd(q.conjugate() * TRUE_Q).angle();
+  }
+
+  /* about the baselink axes */
+  Eigen::Vector3d rotationErrorVector(const Eigen::Quaterniond& q)
+  {
+    Eigen::AngleAxisd aa(TRUE_Q * q.conjugate());
+    return aa.angle() * aa.axis();
+  }
+}
+
+TEST(ExtrinsicCalibratorTest, InjectedOffset)
+{
+  ExtrinsicCalibrator calibrator;
+  calibrator.setInitialValue(NOMINAL_Q, NOMINAL_T);
+  EXPECT_FALSE(calibrator.converged());
+
+  Flight flight = {60.0, 0.25, 0.25, 0.6, 0.0};
+  fly(calibrator, flight, 1);
+
+  ASSERT_TRUE(calibrator.converged());
+  double rot_error = rotationError(calibrator.getRotation());
+  double trans_error = (calibrator.getTranslation() - TRUE_T).norm();
+  EXPECT_LT(rot_error, 0.005);
+  EXPECT_LT(trans_error, 0.008);
+
+  /* the confidence covers the error */
+  Eigen::Vector3d rot_error_vector = rotationErrorVector(calibrator.getRotation());
+  for(int i = 0; i < 3; i++)
+    {
+      EXPECT_LT(fabs(rot_error_vector(i)), 4 * calibrator.getRotationSigma()(i));
+      EXPECT_LT(fabs(calibrator.getTranslation()(i) - TRUE_T(i)), 4 * calibrator.getTranslationSigma()(i));
+    }
+
+  RecordProperty("pairs", calibrator.getPairCount());
+  RecordProperty("nominal_rot_error_mrad", static_cast<int>(rotationError(NOMINAL_Q) * 1000));
+  RecordProperty("nominal_trans_error_mm", static_cast<int>((NOMINAL_T - TRUE_T).norm() * 1000));
+  RecordProperty("rot_error_urad", static_cast<int>(rot_error * 1e6));
+  RecordProperty("trans_error_um", static_cast<int>(trans_error * 1e6));
+  RecordProperty("rot_sigma_urad", static_cast<int>(calibrator.getRotationSigma().maxCoeff() * 1e6));
+  RecordProperty("trans_sigma_um", static_cast<int>(calibrator.getTranslationSigma().maxCoeff() * 1e6));
+}
+
+TEST(ExtrinsicCalibratorTest, YawOnlyHover)
+{
+  ExtrinsicCalibrator calibrator;
+  calibrator.setInitialValue(NOMINAL_Q, NOMINAL_T);
+
+  /* no rotation about the roll and pitch axes */
+  Flight flight = {60.0, 0.0, 0.0, 0.6, 0.0};
+  fly(calibrator, flight, 2);
+
+  EXPECT_FALSE(calibrator.converged());
+  EXPECT_GT(calibrator.getInlierCount(), 20);
+
+  /* the tilt is observable, the yaw and the height are only by the noise of the attitude */
+  const Eigen::Vector3d& rot_sigma = calibrator.getRotationSigma();
+  const Eigen::Vector3d& trans_sigma = calibrator.getTranslationSigma();
+  EXPECT_LT(rot_sigma(0), 0.005);
+  EXPECT_LT(rot_sigma(1), 0.005);
+  EXPECT_GT(rot_sigma(2), 10 * std::max(rot_sigma(0), rot_sigma(1)));
+  EXPECT_LT(trans_sigma(0), 0.01);
+  EXPECT_LT(trans_sigma(1), 0.01);
+  EXPECT_GT(trans_sigma(2), 10 * std::max(trans_sigma(0), trans_sigma(1)));
+  /* the error of the yaw leaks into the horizontal translation */
+  EXPECT_NEAR(calibrator.getTranslation()(0), TRUE_T(0), 0.02);
+  EXPECT_NEAR(calibrator.getTranslation()(1), TRUE_T(1), 0.02);
+
+  RecordProperty("yaw_sigma_mrad", static_cast<int>(rot_sigma(2) * 1000));
+  RecordProperty("height_sigma_mm", static_cast<int>(trans_sigma(2) * 1000));
+}
+
+TEST(ExtrinsicCalibratorTest, Outliers)
+{
+  ExtrinsicCalibrator calibrator;
+  calibrator.setInitialValue(NOMINAL_Q, NOMINAL_T);
+
+  Flight flight = {60.0, 0.25, 0.25, 0.6, 0.05};
+  fly(calibrator, flight, 3);
+
+  EXPECT_TRUE(calibrator.converged());
+  EXPECT_LT(calibrator.getInlierCount(), calibrator.getPairCount());
+  double rot_error = rotationError(calibrator.getRotation());
+  double trans_error = (calibrator.getTranslation() - TRUE_T).norm();
+  EXPECT_LT(rot_error, 0.005);
+  EXPECT_LT(trans_error, 0.008);
+
+  RecordProperty("outlier_pairs", calibrator.getPairCount() - calibrator.getInlierCount());
+  RecordProperty("rot_error_urad", static_cast<int>(rot_error * 1e6));
+  RecordProperty("trans_error_um", static_cast<int>(trans_error * 1e6));
+}
+
+TEST(ExtrinsicCalibratorTest, RotationOnly)
+{
+  /* without the position of the baselink */
+  ExtrinsicCalibrator calibrator;
+  calibrator.setInitialValue(NOMINAL_Q, NOMINAL_T);
+  calibrator.setEstimateTranslation(false);
+
+  Flight flight = {60.0, 0.25, 0.25, 0.6, 0.0};
+  fly(calibrator, flight, 4);
+
+  EXPECT_TRUE(calibrator.converged());
+  EXPECT_LT(rotationError(calibrator.getRotation()), 0.005);
+  EXPECT_EQ(calibrator.getTranslation(), NOMINAL_T);
+}
+
+TEST(ExtrinsicCalibratorTest, Reset)
+{
+  ExtrinsicCalibrator calibrator;
+  calibrator.setInitialValue(NOMINAL_Q, NOMINAL_T);
+  Flight flight = {10.0, 0.25, 0.25, 0.6, 0.0};
+  fly(calibrator, flight, 5);
+  EXPECT_GT(calibrator.getPairCount(), 0);
+
+  calibrator.reset();
+  EXPECT_EQ(calibrator.getPairCount(), 0);
+  EXPECT_FALSE(calibrator.converged());
+  EXPECT_LT(Eigen::AngleAxisd(calibrator.getRotation().conjugate() * NOMINAL_Q).angle(), 1e-9);
+  EXPECT_EQ(calibrator.getTranslation(), NOMINAL_T);
+}
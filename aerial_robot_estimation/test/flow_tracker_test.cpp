@@ -0,0 +1,220 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of aerial_robot_estimation::FlowTracker with synthetic image sequences of the downward camera.
+       A random texture on the ground plane is rendered by the plane induced homography of the camera motion,
+       and the estimated camera velocity is compared with the ground truth in camera frame.
+       The processing rate with the persistent tracking is also compared with the detection on every frame.
+*/
+
+#include <aerial_robot_estimation/vision/flow_tracker.h>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const int WIDTH = 640;
+  const int HEIGHT = 480;
+  const double F = 400.0;
+  const double RATE = 30.0;
+  const double GROUND_HEIGHT = 1.0; // [m]
+
+  struct Frame
+  {
+    cv::Mat image;
+    cv::Vec3d vel; // ground truth in camera frame
+    cv::Vec3d ang_vel; // camera frame
+    double height; // along the optical axis
+  };
+
+  struct Result
+  {
+    double mean_error; // [m/s]
+    double max_error;
+    int redetect;
+    double fps;
+  };
+
+  cv::Mat texture()
+  {
+    /* larger than the view for the translation */
+    cv::Mat tex(HEIGHT * 3, WIDTH * 3, CV_8UC1);
+    cv::RNG rng(1);
+    rng.fill(tex, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(tex, tex, cv::Size(0, 0), 2.0);
+    cv::normalize(tex, tex, 0, 255, cv::NORM_MINMAX);
+    return tex;
+  }
+
+  /* constant velocity (world frame of the first camera pose) and rotation rate (camera frame) */
+  std::vector<Frame> generateSequence(const cv::Vec3d& vel, const cv::Vec3d& ang_vel, int size)
+  {
+    cv::Mat tex = texture();
+    cv::Matx33d k(F, 0, WIDTH / 2.0, 0, F, HEIGHT / 2.0, 0, 0, 1);
+    /* texture pixel to the image pixel of the first camera pose */
+    cv::Matx33d offset(1, 0, -WIDTH, 0, 1, -HEIGHT, 0, 0, 1);
+    cv::Matx13d n(0, 0, 1);
+
+    std::vector<Frame> frames;
+    for(int i = 0; i < size; i++)
+      {
+        double t = i / RATE;
+        cv::Matx33d r;
+        cv::Rodrigues(ang_vel * t, r); // constant rate in the rotating frame
+        cv::Vec3d c = vel * t;
+
+        /* x_t ~ K R^T (I - c n^T / Z) K^-1 x_0 */
+        cv::Matx33d h = k * r.t() * (cv::Matx33d::eye() - cv::Matx31d(c) * n * (1 / GROUND_HEIGHT)) * k.inv() * offset;
+
+        Frame frame;
+        cv::warpPerspective(tex, frame.image, h, cv::Size(WIDTH, HEIGHT), cv::INTER_LINEAR);
+        frame.vel = r.t() * vel;
+        frame.ang_vel = ang_vel;
+        frame.height = (GROUND_HEIGHT - c[2]) / (r * cv::Vec3d(0, 0, 1))[2];
+        frames.push_back(frame);
+      }
+    return frames;
+  }
+
+  Result run(FlowTracker& tracker, const std::vector<Frame>& frames, bool compensate = true)
+  {
+    Result result = {0, 0, 0, 0};
+    int count = 0;
+    std::chrono::nanoseconds elapsed(0);
+
+    for(const auto& frame: frames)
+      {
+        auto start = std::chrono::steady_clock::now();
+        cv::Vec3d vel;
+        bool tracked = tracker.track(frame.image);
+        if(tracked) tracker.estimateVelocity(1 / RATE, compensate?frame.ang_vel:cv::Vec3d(0, 0, 0), frame.height, 0, vel);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        if(tracker.getRedetected()) result.redetect++;
+        if(!tracked) continue;
+
+        double error = cv::norm(cv::Vec2d(vel[0] - frame.vel[0], vel[1] - frame.vel[1]));
+        result.mean_error += error;
+        result.max_error = std::max(result.max_error, error);
+        count++;
+      }
+
+    if(count > 0) result.mean_error /= count;
+    result.fps = frames.size() / (elapsed.count() * 1e-9);
+    return result;
+  }
+
+  FlowTracker createTracker()
+  {
+    FlowTracker tracker;
+    tracker.setCamera(F, WIDTH / 2.0, HEIGHT / 2.0, 10);
+    return tracker;
+  }
+
+  void report(const std::string& name, const Result& r)
+  {
+    printf("%s: mean error %f [m/s], max error %f [m/s], %d re-detections, %f [fps]\n",
+           name.c_str(), r.mean_error, r.max_error, r.redetect, r.fps);
+  }
+}
+
+TEST(FlowTrackerTest, Translation)
+{
+  std::vector<Frame> frames = generateSequence(cv::Vec3d(0.3, -0.2, 0), cv::Vec3d(0, 0, 0), 60);
+  FlowTracker tracker = createTracker();
+  Result result = run(tracker, frames);
+  report("translation", result);
+
+  EXPECT_LT(result.mean_error, 0.02);
+  EXPECT_LT(result.max_error, 0.05);
+  /* the features are kept across the frames */
+  EXPECT_LT(result.redetect, (int)frames.size() / 2);
+}
+
+TEST(FlowTrackerTest, Rotation)
+{
+  std::vector<Frame> frames = generateSequence(cv::Vec3d(0, 0, 0), cv::Vec3d(0.2, -0.2, 0.5), 30);
+
+  FlowTracker tracker = createTracker();
+  Result result = run(tracker, frames);
+  report("rotation", result);
+  EXPECT_LT(result.mean_error, 0.02);
+  EXPECT_LT(result.max_error, 0.05);
+
+  /* the apparent velocity without the rotation compensation */
+  FlowTracker uncompensated = createTracker();
+  Result uncompensated_result = run(uncompensated, frames, false);
+  report("rotation without compensation", uncompensated_result);
+  EXPECT_GT(uncompensated_result.mean_error, 0.1);
+}
+
+TEST(FlowTrackerTest, TranslationAndRotation)
+{
+  std::vector<Frame> frames = generateSequence(cv::Vec3d(0.2, 0.3, 0), cv::Vec3d(0.05, -0.05, 0.5), 60);
+  FlowTracker tracker = createTracker();
+  Result result = run(tracker, frames);
+  report("translation and rotation", result);
+
+  EXPECT_LT(result.mean_error, 0.05);
+  EXPECT_LT(result.max_error, 0.1);
+}
+
+TEST(FlowTrackerTest, FrameRate)
+{
+  std::vector<Frame> frames = generateSequence(cv::Vec3d(0.3, -0.2, 0), cv::Vec3d(0, 0, 0.3), 90);
+
+  FlowTracker tracker = createTracker();
+  Result result = run(tracker, frames);
+  report("persistent tracking", result);
+
+  /* detection on every frame, as the previous implementation */
+  FlowTracker detect_every_frame = createTracker();
+  detect_every_frame.setFeatureParams(100, 100, 0.01, 10);
+  Result every_frame_result = run(detect_every_frame, frames);
+  report("detection on every frame", every_frame_result);
+
+  /* faster than the camera, the speedup depends on the machine and is only reported */
+  EXPECT_GT(result.fps, RATE);
+  EXPECT_LT(result.redetect, every_frame_result.redetect);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
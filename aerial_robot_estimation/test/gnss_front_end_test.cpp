@@ -0,0 +1,354 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of aerial_robot_estimation::GnssFrontEnd with recorded-style synthetic gnss tracks:
+       a figure-eight flight at 5Hz with the slowly varying position error of a single receiver,
+       and the multipath jumps, the velocity spikes, the dropouts and the persistent offset.
+       The local tangent plane is compared with the round trip and with the mercator scaling of sensor_plugin::Gps.
+*/
+
+#include <aerial_robot_estimation/sensor/gnss_front_end.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const double RATE = 5.0;
+  const double DURATION = 120.0;
+  const double BASE_LAT = 35.7128, BASE_LON = 139.7621, BASE_ALT = 40.0; // hongo campus
+  const double POS_SIGMA = 1.0; // [m], the parameter of sensor_plugin::Gps
+  const double VEL_SIGMA = 0.1; // [m/s]
+
+  struct Sample
+  {
+    GnssFix fix;
+    Eigen::Vector3d pos; // ground truth in enu
+    bool corrupted; // position with the injected error
+  };
+
+  /* the same scaling as the anonymous functions in gps.cpp */
+  double mDegLat(double lat)
+  {
+    double lat_rad = lat * M_PI / 180.0;
+    return 111132.09 - 566.05 * cos(2.0 * lat_rad) + 1.20 * cos(4.0 * lat_rad) - 0.002 * cos(6.0 * lat_rad);
+  }
+
+  double mDegLon(double lat)
+  {
+    double lat_rad = lat * M_PI/ 180.0;
+    return 111415.13 * cos(lat_rad) - 94.55 * cos(3.0 * lat_rad) - 0.12 * cos(5.0 * lat_rad);
+  }
+
+  /* figure-eight at 5 [m/s] with the gauss-markov position error (0.7 [m], 20 [s]) and the white noise */
+  std::vector<Sample> generateTrack(const LocalTangentPlane& plane, unsigned int seed = 1)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    const double radius = 40.0;
+    const double w = 5.0 / radius;
+    const double tau = 20.0, bias_sigma = 0.7, white_sigma = 0.2;
+    double dt = 1 / RATE;
+    double decay = exp(-dt / tau);
+    Eigen::Vector2d bias(bias_sigma * normal(engine), bias_sigma * normal(engine));
+
+    std::vector<Sample> samples;
+    for(int i = 0; i < DURATION * RATE; i++)
+      {
+        double t = i * dt;
+        Sample s;
+        s.pos << radius * sin(w * t), radius * sin(w * t) * cos(w * t), 0;
+        Eigen::Vector3d vel(radius * w * cos(w * t), radius * w * cos(2 * w * t), 0);
+        s.corrupted = false;
+
+        bias = decay * bias + bias_sigma * sqrt(1 - decay * decay) * Eigen::Vector2d(normal(engine), normal(engine));
+        Eigen::Vector3d measured = s.pos;
+        measured.head<2>() += bias + white_sigma * Eigen::Vector2d(normal(engine), normal(engine));
+
+        s.fix.source = GnssFix::SPINAL;
+        s.fix.stamp = 1000.0 + t;
+        s.fix.fix = true;
+        s.fix.sat_num = 12;
+        s.fix.has_geodetic = true;
+        plane.toGeodetic(measured, s.fix.latitude, s.fix.longitude, s.fix.altitude);
+        s.fix.altitude = 0; // spinal::Gps has no altitude
+        s.fix.has_velocity = true;
+        s.fix.velocity = vel + 0.05 * Eigen::Vector3d(normal(engine), normal(engine), 0);
+        samples.push_back(s);
+      }
+    return samples;
+  }
+
+  /* shift the position of the fixes in [start, end) [s] from the beginning */
+  void shift(std::vector<Sample>& samples, const LocalTangentPlane& plane, double start, double end, const Eigen::Vector3d& offset)
+  {
+    for(auto& s: samples)
+      {
+        double t = s.fix.stamp - samples.front().fix.stamp;
+        if(t < start || t >= end) continue;
+        Eigen::Vector3d enu = plane.toEnu(s.fix.latitude, s.fix.longitude, s.fix.altitude) + offset;
+        plane.toGeodetic(enu, s.fix.latitude, s.fix.longitude, s.fix.altitude);
+        s.fix.altitude = 0;
+        s.corrupted = true;
+      }
+  }
+
+  void drop(std::vector<Sample>& samples, double start, double end)
+  {
+    double t0 = samples.front().fix.stamp;
+    std::vector<Sample> kept;
+    for(const auto& s: samples)
+      if(s.fix.stamp - t0 < start || s.fix.stamp - t0 >= end) kept.push_back(s);
+    samples = kept;
+  }
+
+  GnssFrontEnd createFrontEnd()
+  {
+    GnssFrontEnd front_end;
+    front_end.setNoise(POS_SIGMA, VEL_SIGMA);
+    front_end.getTangentPlane().setOrigin(BASE_LAT, BASE_LON, 0);
+    return front_end;
+  }
+
+  struct Count
+  {
+    int clean, clean_accepted, corrupted, corrupted_accepted;
+    double max_accepted_error; // [m]
+  };
+
+  Count run(GnssFrontEnd& front_end, const std::vector<Sample>& samples, std::vector<GnssFrontEnd::Result>* results = nullptr)
+  {
+    Count count = {0, 0, 0, 0, 0};
+    for(const auto& s: samples)
+      {
+        GnssFrontEnd::Result result = front_end.update(s.fix);
+        if(results) results->push_back(result);
+        if(s.corrupted)
+          {
+            count.corrupted++;
+            if(result.pos_valid) count.corrupted_accepted++;
+          }
+        else
+          {
+            count.clean++;
+            if(result.pos_valid) count.clean_accepted++;
+          }
+        if(result.pos_valid)
+          count.max_accepted_error = std::max(count.max_accepted_error, (result.pos - s.pos).head<2>().norm());
+      }
+    return count;
+  }
+}
+
+TEST(GnssFrontEndTest, TangentPlane)
+{
+  LocalTangentPlane plane;
+  plane.setOrigin(BASE_LAT, BASE_LON, BASE_ALT);
+
+  /* round trip */
+  for(const auto& enu: {Eigen::Vector3d(100, 0, 0), Eigen::Vector3d(-1000, 1000, 30), Eigen::Vector3d(3000, -4000, -20)})
+    {
+      double lat, lon, alt;
+      plane.toGeodetic(enu, lat, lon, alt);
+      EXPECT_LT((plane.toEnu(lat, lon, alt) - enu).norm(), 1e-6);
+    }
+  Eigen::Vector3d origin = plane.toEnu(BASE_LAT, BASE_LON, BASE_ALT);
+  EXPECT_LT(origin.norm(), 1e-6);
+
+  /* the mercator scaling of sensor_plugin::Gps near the base: 1 [km] north and east */
+  Eigen::Vector3d north = plane.toEnu(BASE_LAT + 1000 / mDegLat(BASE_LAT), BASE_LON, BASE_ALT);
+  Eigen::Vector3d east = plane.toEnu(BASE_LAT, BASE_LON + 1000 / mDegLon(BASE_LAT), BASE_ALT);
+  EXPECT_NEAR(north.y(), 1000, 0.05);
+  EXPECT_NEAR(north.x(), 0, 1e-6);
+  EXPECT_NEAR(east.x(), 1000, 0.05);
+  EXPECT_NEAR(east.y(), 1000 * 1000 * tan(BASE_LAT * M_PI / 180) / (2 * 6378137.0), 0.01); // the parallel bends to the north
+  EXPECT_LT(fabs(east.z() + 1000 * 1000 / (2 * 6378137.0)), 0.01); // the curvature of the earth
+
+  /* processing time */
+  const int number = 100000;
+  double sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < number; i++) sum += plane.toEnu(BASE_LAT + i * 1e-9, BASE_LON, 0).y();
+  double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / number;
+  EXPECT_GT(sum, 0);
+  RecordProperty("to_enu_ns", static_cast<int>(ns));
+}
+
+TEST(GnssFrontEndTest, CleanTrack)
+{
+  GnssFrontEnd front_end = createFrontEnd();
+  std::vector<Sample> samples = generateTrack(front_end.getTangentPlane());
+
+  std::vector<GnssFrontEnd::Result> results;
+  Count count = run(front_end, samples, &results);
+
+  /* only the reacquisition at the beginning */
+  EXPECT_GE(count.clean_accepted, count.clean - 2);
+  EXPECT_LT(count.max_accepted_error, 4 * 0.75);
+  int vel_valid = 0;
+  for(const auto& r: results) if(r.vel_valid) vel_valid++;
+  EXPECT_GE(vel_valid, count.clean - 2);
+  RecordProperty("accepted_permille", static_cast<int>(1000 * count.clean_accepted / count.clean));
+}
+
+TEST(GnssFrontEndTest, MultipathJump)
+{
+  GnssFrontEnd front_end = createFrontEnd();
+  std::vector<Sample> samples = generateTrack(front_end.getTangentPlane(), 2);
+  shift(samples, front_end.getTangentPlane(), 30.0, 32.0, Eigen::Vector3d(15, 0, 0));
+  shift(samples, front_end.getTangentPlane(), 60.0, 61.0, Eigen::Vector3d(-6, 5, 0));
+  shift(samples, front_end.getTangentPlane(), 90.0, 90.2, Eigen::Vector3d(0, 30, 0)); // single fix
+
+  std::vector<GnssFrontEnd::Result> results;
+  Count count = run(front_end, samples, &results);
+  EXPECT_EQ(count.corrupted, 16);
+  EXPECT_EQ(count.corrupted_accepted, 0);
+  EXPECT_GE(count.clean_accepted, count.clean - 2);
+  EXPECT_LT(count.max_accepted_error, 4 * 0.75);
+
+  /* the doppler velocity is still fused */
+  for(size_t i = 0; i < samples.size(); i++)
+    {
+      if(samples[i].corrupted) { EXPECT_TRUE(results[i].vel_valid) << "t: " << samples[i].fix.stamp; }
+    }
+}
+
+TEST(GnssFrontEndTest, VelocitySpike)
+{
+  GnssFrontEnd front_end = createFrontEnd();
+  std::vector<Sample> samples = generateTrack(front_end.getTangentPlane(), 3);
+  const size_t spike = 200;
+  samples[spike].fix.velocity += Eigen::Vector3d(8, -6, 0);
+  samples[spike + 50].fix.velocity = Eigen::Vector3d(30, 0, 0); // beyond the speed bound
+
+  std::vector<GnssFrontEnd::Result> results;
+  run(front_end, samples, &results);
+  EXPECT_FALSE(results[spike].vel_valid);
+  EXPECT_TRUE(results[spike].pos_valid);
+  EXPECT_TRUE(results[spike + 1].vel_valid);
+  EXPECT_FALSE(results[spike + 50].vel_valid);
+  EXPECT_TRUE(results[spike + 51].vel_valid);
+  EXPECT_EQ(front_end.getVelRejectCount(), 2);
+}
+
+TEST(GnssFrontEndTest, Dropout)
+{
+  GnssFrontEnd front_end = createFrontEnd();
+  std::vector<Sample> samples = generateTrack(front_end.getTangentPlane(), 4);
+  drop(samples, 40.0, 43.0);
+  drop(samples, 80.0, 90.0);
+  shift(samples, front_end.getTangentPlane(), 90.0, 90.2, Eigen::Vector3d(20, 0, 0)); // multipath at the reacquisition
+
+  std::vector<GnssFrontEnd::Result> results;
+  Count count = run(front_end, samples, &results);
+  EXPECT_EQ(count.corrupted_accepted, 0);
+  EXPECT_LT(count.max_accepted_error, 4 * 0.75);
+
+  /* the first two fixes after each gap (and the beginning) wait for the consistency */
+  for(size_t i = 0; i < samples.size(); i++)
+    {
+      bool after_gap = (i == 0) || (samples[i].fix.stamp - samples[i - 1].fix.stamp > 1.0);
+      if(!after_gap) continue;
+      EXPECT_FALSE(results[i].pos_valid);
+      EXPECT_FALSE(results[i + 1].pos_valid);
+      if(!samples[i].corrupted)
+        {
+          EXPECT_TRUE(results[i + 2].pos_valid) << "t: " << samples[i].fix.stamp;
+        }
+      else
+        {
+          EXPECT_TRUE(results[i + 3].pos_valid) << "t: " << samples[i].fix.stamp;
+        }
+    }
+  EXPECT_GE(count.clean_accepted, count.clean - 8);
+}
+
+TEST(GnssFrontEndTest, PersistentOffset)
+{
+  GnssFrontEnd front_end = createFrontEnd();
+  std::vector<Sample> samples = generateTrack(front_end.getTangentPlane(), 5);
+  shift(samples, front_end.getTangentPlane(), 50.0, DURATION, Eigen::Vector3d(0, -20, 0));
+
+  std::vector<GnssFrontEnd::Result> results;
+  run(front_end, samples, &results);
+
+  /* rejected until max_reject_time (5 [s]), then followed after the reacquisition */
+  int first_valid = -1;
+  for(size_t i = 50 * RATE; i < samples.size(); i++)
+    if(results[i].pos_valid)
+      {
+        first_valid = i;
+        break;
+      }
+  ASSERT_GT(first_valid, 0);
+  EXPECT_NEAR((first_valid - 50 * RATE) / RATE, 5.0 + 2 / RATE, 0.01);
+  EXPECT_TRUE(results.back().pos_valid);
+}
+
+TEST(GnssFrontEndTest, RtkPose)
+{
+  /* the local position in 3d */
+  GnssFrontEnd front_end;
+  front_end.setNoise(0.02, 0.05);
+  int rejected = 0;
+  for(int i = 0; i < 100; i++)
+    {
+      GnssFix fix;
+      fix.source = GnssFix::RTK_POSE;
+      fix.stamp = i * 0.1;
+      fix.fix = true;
+      fix.has_local_position = true;
+      fix.local_position = Eigen::Vector3d(0.5 * fix.stamp, 0, 1.0);
+      if(i == 50) fix.local_position.z() += 0.5; // vertical jump
+      GnssFrontEnd::Result result = front_end.update(fix);
+      if(i >= 2 && !result.pos_valid) rejected++;
+      if(i == 50)
+        {
+          EXPECT_FALSE(result.pos_valid);
+        }
+    }
+  EXPECT_EQ(rejected, 1);
+
+  /* no fix */
+  GnssFix fix;
+  fix.stamp = 10.0;
+  fix.has_local_position = true;
+  EXPECT_FALSE(front_end.update(fix).pos_valid);
+}
@@ -0,0 +1,207 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: test of aerial_robot_estimation::ImuBatchUnpacker with the synthetic batches of spinal (1kHz samples, published at 100Hz):
+       the time of each sample with the irregular tick, the dequantized values, the attitude interpolated from
+       the previous batch, the hold after a gap and the first batch, and the interpolation over the wrap of the yaw.
+*/
+
+#include <aerial_robot_estimation/sensor/imu_batch_unpacker.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sensors/imu/imu_batch.h> /* spinal */
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const int SAMPLE_NUM = 10; // 1kHz in the 100Hz publish
+
+  struct Batch
+  {
+    double stamp; // [sec] of the first sample
+    std::vector<uint8_t> tick_delta;
+    float gyro_scale, acc_scale;
+    std::vector<int16_t> gyro_data, acc_data;
+    Eigen::Vector3d euler; // at the last sample
+    std::vector<float> gyro, acc; // before the quantization
+  };
+
+  /* the k-th sample has gyro = (k, -k, 0.5) * 0.01 and acc = (0.1k, 0, 9.8) */
+  Batch makeBatch(double stamp, const Eigen::Vector3d& euler, int sample_num = SAMPLE_NUM)
+  {
+    Batch batch;
+    batch.stamp = stamp;
+    batch.euler = euler;
+    for(int k = 0; k < sample_num; k++)
+      {
+        batch.tick_delta.push_back(k == 0 ? 0 : 1);
+        batch.gyro.insert(batch.gyro.end(), {k * 0.01f, -k * 0.01f, 0.005f});
+        batch.acc.insert(batch.acc.end(), {k * 0.1f, 0.0f, 9.8f});
+      }
+    batch.gyro_data.resize(batch.gyro.size());
+    batch.acc_data.resize(batch.acc.size());
+    batch.gyro_scale = imu_batch::quantize(batch.gyro.data(), batch.gyro.size(), batch.gyro_data.data(), imu_batch::GYRO_MIN_SCALE);
+    batch.acc_scale = imu_batch::quantize(batch.acc.data(), batch.acc.size(), batch.acc_data.data(), imu_batch::ACC_MIN_SCALE);
+    return batch;
+  }
+
+  bool unpack(ImuBatchUnpacker& unpacker, const Batch& batch)
+  {
+    return unpacker.unpack(batch.stamp, batch.tick_delta, batch.gyro_scale, batch.gyro_data,
+                           batch.acc_scale, batch.acc_data, batch.euler);
+  }
+
+  double sampleTime(const Batch& batch, const ImuBatchUnpacker::Sample& sample)
+  {
+    return batch.stamp + sample.tick * 1e-3;
+  }
+}
+
+TEST(ImuBatchUnpackerTest, Stamp)
+{
+  ImuBatchUnpacker unpacker;
+  Batch batch = makeBatch(10.0, Eigen::Vector3d::Zero());
+  batch.tick_delta.at(5) = 3; // a sample lost in spinal
+  ASSERT_TRUE(unpack(unpacker, batch));
+
+  const auto& samples = unpacker.getSamples();
+  ASSERT_EQ(samples.size(), SAMPLE_NUM);
+  uint32_t tick = 0;
+  for(int k = 0; k < SAMPLE_NUM; k++)
+    {
+      tick += batch.tick_delta.at(k);
+      EXPECT_EQ(samples.at(k).tick, tick) << k;
+      for(int i = 0; i < 3; i++)
+        {
+          EXPECT_NEAR(samples.at(k).gyro(i), batch.gyro.at(3 * k + i), batch.gyro_scale) << k;
+          EXPECT_NEAR(samples.at(k).acc(i), batch.acc.at(3 * k + i), batch.acc_scale) << k;
+        }
+    }
+  EXPECT_EQ(samples.front().tick, 0);
+  EXPECT_EQ(samples.back().tick, SAMPLE_NUM + 1);
+}
+
+TEST(ImuBatchUnpackerTest, Interpolation)
+{
+  ImuBatchUnpacker unpacker;
+
+  /* the first batch: the attitude of the last sample is held */
+  Batch first = makeBatch(10.0, Eigen::Vector3d(0.1, -0.2, 0.3));
+  ASSERT_TRUE(unpack(unpacker, first));
+  for(const auto& sample: unpacker.getSamples())
+    EXPECT_TRUE(sample.euler.isApprox(first.euler)) << sample.tick;
+
+  /* linear from the last sample of the previous batch to the last sample */
+  Batch second = makeBatch(10.010, Eigen::Vector3d(0.2, -0.1, 0.1));
+  ASSERT_TRUE(unpack(unpacker, second));
+  const double start_time = first.stamp + (SAMPLE_NUM - 1) * 1e-3;
+  const double end_time = second.stamp + (SAMPLE_NUM - 1) * 1e-3;
+  double prev_time = start_time;
+  for(const auto& sample: unpacker.getSamples())
+    {
+      double t = sampleTime(second, sample);
+      EXPECT_GT(t, prev_time);
+      prev_time = t;
+      Eigen::Vector3d expected = first.euler + (second.euler - first.euler) * (t - start_time) / (end_time - start_time);
+      for(int i = 0; i < 3; i++) EXPECT_NEAR(sample.euler(i), expected(i), 1e-9) << sample.tick;
+    }
+  EXPECT_EQ(unpacker.getSamples().back().euler, second.euler);
+
+  /* the invalid batch is rejected without the effect on the next one */
+  Batch invalid = makeBatch(10.020, Eigen::Vector3d::Zero());
+  invalid.acc_data.pop_back();
+  EXPECT_FALSE(unpack(unpacker, invalid));
+  EXPECT_TRUE(unpacker.getSamples().empty());
+
+  Batch third = makeBatch(10.020, Eigen::Vector3d(0.3, 0.0, -0.1));
+  ASSERT_TRUE(unpack(unpacker, third));
+  const auto& front = unpacker.getSamples().front();
+  double rate = (sampleTime(third, front) - end_time) / (third.stamp + (SAMPLE_NUM - 1) * 1e-3 - end_time);
+  EXPECT_TRUE(front.euler.isApprox(second.euler + (third.euler - second.euler) * rate));
+}
+
+TEST(ImuBatchUnpackerTest, Gap)
+{
+  /* after a gap longer than MAX_GAP (e.g. lost messages), the attitude is not interpolated over the gap */
+  ImuBatchUnpacker unpacker;
+  ASSERT_TRUE(unpack(unpacker, makeBatch(10.0, Eigen::Vector3d(0.1, 0.1, 0.1))));
+
+  Batch after_gap = makeBatch(10.0 + 2 * ImuBatchUnpacker::MAX_GAP, Eigen::Vector3d(-0.2, 0.3, 1.0));
+  ASSERT_TRUE(unpack(unpacker, after_gap));
+  for(const auto& sample: unpacker.getSamples())
+    EXPECT_TRUE(sample.euler.isApprox(after_gap.euler)) << sample.tick;
+
+  /* the next batch is interpolated again */
+  Batch next = makeBatch(after_gap.stamp + SAMPLE_NUM * 1e-3, Eigen::Vector3d(-0.1, 0.3, 1.0));
+  ASSERT_TRUE(unpack(unpacker, next));
+  EXPECT_LT(unpacker.getSamples().front().euler.x(), -0.1);
+  EXPECT_GT(unpacker.getSamples().front().euler.x(), -0.2);
+
+  /* reset: same with the first batch */
+  unpacker.reset();
+  Batch after_reset = makeBatch(next.stamp + SAMPLE_NUM * 1e-3, Eigen::Vector3d(0.5, 0.5, 0.5));
+  ASSERT_TRUE(unpack(unpacker, after_reset));
+  for(const auto& sample: unpacker.getSamples())
+    EXPECT_TRUE(sample.euler.isApprox(after_reset.euler)) << sample.tick;
+}
+
+TEST(ImuBatchUnpackerTest, AngleWrap)
+{
+  /* the yaw over +-pi: along the shortest rotation (0.08 rad), in the range of [-pi, pi] */
+  ImuBatchUnpacker unpacker;
+  ASSERT_TRUE(unpack(unpacker, makeBatch(10.0, Eigen::Vector3d(0, 0, M_PI - 0.04))));
+  Batch batch = makeBatch(10.010, Eigen::Vector3d(0, 0, -M_PI + 0.04));
+  ASSERT_TRUE(unpack(unpacker, batch));
+
+  double prev_yaw = M_PI - 0.04;
+  int wrap = 0;
+  for(const auto& sample: unpacker.getSamples())
+    {
+      double yaw = sample.euler.z();
+      EXPECT_LE(std::fabs(yaw), M_PI) << sample.tick;
+      double step = yaw - prev_yaw;
+      if(step < -M_PI)
+        {
+          step += 2 * M_PI;
+          wrap++;
+        }
+      EXPECT_GT(step, 0) << sample.tick;
+      EXPECT_LT(step, 0.08 / (SAMPLE_NUM - 1) * 1.5) << sample.tick;
+      prev_yaw = yaw;
+    }
+  EXPECT_EQ(wrap, 1);
+  EXPECT_EQ(unpacker.getSamples().back().euler.z(), -M_PI + 0.04);
+}
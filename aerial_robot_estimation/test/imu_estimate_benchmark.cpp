@@ -0,0 +1,155 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: micro benchmark of sensor_plugin::Imu::estimateProcess with a 1kHz imu stream.
+       The same stream is replayed to the current plugin and to the plugin of the baseline commit
+       (legacy_sensor_plugin::Imu, the source is taken from git at the configuration, see CMakeLists.txt),
+       and the average processing time per sample after the bias calibration is reported.
+*/
+
+#include <aerial_robot_estimation/sensor/imu.h>
+#include <gtest/gtest.h>
+#include <legacy_imu.h>
+
+namespace
+{
+  const double RATE = 1000.0;
+
+  class ImuReplay : public sensor_plugin::Imu
+  {
+  public:
+    void replay(const spinal::ImuConstPtr& msg) { ImuCallback(msg); }
+    bool calibrated() { return getStatus() == Status::ACTIVE; }
+  };
+
+  /* the imu plugin of the baseline commit, generated from git by CMakeLists.txt */
+  class LegacyImuReplay : public legacy_sensor_plugin::Imu
+  {
+  public:
+    void replay(const spinal::ImuConstPtr& msg) { ImuCallback(msg); }
+    bool calibrated() { return getStatus() == Status::ACTIVE; }
+  };
+
+  struct ReplayResult
+  {
+    double ns_per_sample;
+    int samples;
+  };
+
+  template<class Replay> ReplayResult replay(Replay& imu, double duration)
+  {
+    boost::shared_ptr<spinal::Imu> msg(new spinal::Imu);
+    ReplayResult result = {0, 0};
+    ros::WallDuration elapsed(0);
+
+    for(int i = 0; i < duration * RATE; i++)
+      {
+        double t = i / RATE;
+        msg->stamp = ros::Time(1.0 + t);
+        msg->angles[0] = 0.1 * sin(2 * M_PI * 0.5 * t);
+        msg->angles[1] = 0.1 * cos(2 * M_PI * 0.3 * t);
+        msg->angles[2] = 0.5;
+        msg->gyro_data[0] = 0.1 * M_PI * cos(2 * M_PI * 0.5 * t);
+        msg->gyro_data[1] = -0.06 * M_PI * sin(2 * M_PI * 0.3 * t);
+        msg->gyro_data[2] = 0;
+        msg->acc_data[0] = -aerial_robot_estimation::G * sin(msg->angles[1]) + 0.05;
+        msg->acc_data[1] = aerial_robot_estimation::G * sin(msg->angles[0]) - 0.03;
+        msg->acc_data[2] = aerial_robot_estimation::G * cos(msg->angles[0]) * cos(msg->angles[1]) + 0.02;
+        msg->mag_data[0] = 0.3;
+        msg->mag_data[1] = 0;
+        msg->mag_data[2] = -0.4;
+
+        bool calibrated = imu.calibrated();
+        ros::WallTime start = ros::WallTime::now();
+        imu.replay(msg);
+        if(calibrated)
+          {
+            elapsed += ros::WallTime::now() - start;
+            result.samples++;
+          }
+      }
+
+    if(result.samples > 0) result.ns_per_sample = elapsed.toNSec() / (double)result.samples;
+    return result;
+  }
+}
+
+TEST(ImuEstimateBenchmark, Replay)
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle nhp("~");
+  double duration;
+  nhp.param("duration", duration, 10.0);
+
+  boost::shared_ptr<aerial_robot_model::RobotModel> robot_model(new aerial_robot_model::RobotModel());
+
+  boost::shared_ptr<aerial_robot_estimation::StateEstimator> legacy_estimator(new aerial_robot_estimation::StateEstimator());
+  legacy_estimator->initialize(nh, nhp, robot_model);
+  LegacyImuReplay legacy_imu;
+  legacy_imu.initialize(nh, robot_model, legacy_estimator, "sensor_plugin/imu", 1);
+
+  boost::shared_ptr<aerial_robot_estimation::StateEstimator> estimator(new aerial_robot_estimation::StateEstimator());
+  estimator->initialize(nh, nhp, robot_model);
+  ImuReplay imu;
+  imu.initialize(nh, robot_model, estimator, "sensor_plugin/imu", 2);
+
+  ReplayResult legacy_result = replay(legacy_imu, duration);
+  ReplayResult result = replay(imu, duration);
+
+  ROS_INFO("imu estimate process: %f [ns/sample] (previous: %f [ns/sample]) in %d samples",
+           result.ns_per_sample, legacy_result.ns_per_sample, result.samples);
+
+  ASSERT_GT(result.samples, 0);
+  EXPECT_EQ(result.samples, legacy_result.samples);
+
+  /* same estimation result */
+  for(int axis = 0; axis < State::TOTAL_NUM; axis++)
+    {
+      AxisState state = estimator->getState(axis);
+      AxisState legacy_state = legacy_estimator->getState(axis);
+      for(int mode = 0; mode < 3; mode++)
+        {
+          for(int i = 0; i < 3; i++)
+            EXPECT_NEAR(state[mode].second[i], legacy_state[mode].second[i], 1e-4) << "axis: " << axis << ", mode: " << mode;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "imu_estimate_benchmark");
+  return RUN_ALL_TESTS();
+}
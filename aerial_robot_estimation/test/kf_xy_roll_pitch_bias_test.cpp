@@ -0,0 +1,431 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: out-of-sequence measurement test of aerial_robot_base/kf_xy_roll_pitch_bias.
+       The delayed position (e.g. visual odometry) is given with its timestamp by correctionWithHistory() after several delays,
+       together with the velocity on time. The filter should be equal to the oracle filter which receives the position on time,
+       once the delayed measurements arrive, and closer to the ground truth than the filter applying them at the arrival.
+       The replay budget and the capacity of the history are also checked.
+       The history should be cleared by the reset of the state, also through the base class.
+       The fixed-size filter (with the history) is compared with the dynamic filter of the base class on the same streams,
+       and the processing time per imu sample is reported.
+*/
+
+#include <aerial_robot_estimation/kf/xy_roll_pitch_bias_plugin.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+
+using namespace Eigen;
+
+namespace
+{
+  const double IMU_RATE = 200.0;
+  const int POS_INTERVAL = 10; // 20Hz
+  const int VEL_INTERVAL = 7;
+  const double DURATION = 30.0;
+  const double SETTLE = 5.0;
+  const double GRAVITY = 9.797;
+  const double ACC_NOISE = 0.05; // [m/s^2]
+  const double BIAS_NOISE = 0.0005; // [rad], per imu sample
+  const double POS_NOISE = 0.01; // [m]
+  const double VEL_NOISE = 0.05; // [m/s]
+  const Vector2d BIAS(0.02, -0.03); // [rad], roll, pitch
+
+  struct Sample
+  {
+    double t;
+    Vector3d acc_b; // specific force in body frame
+    Vector3d rpy; // estimated attitude, with the bias
+    Vector2d pos, vel; // ground truth
+    Vector2d meas_pos, meas_vel;
+  };
+
+  std::vector<Sample> generateTrajectory(unsigned int seed = 1)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    const Vector2d amplitude(1.0, 0.8);
+    const Vector2d frequency(0.2, 0.15);
+
+    std::vector<Sample> samples;
+    int size = DURATION * IMU_RATE;
+    samples.reserve(size);
+    for(int i = 0; i < size; i++)
+      {
+        Sample s;
+        s.t = 100.0 + i / IMU_RATE;
+
+        Vector3d acc_w(0, 0, GRAVITY);
+        for(int j = 0; j < 2; j++)
+          {
+            double w = 2 * M_PI * frequency(j);
+            s.pos(j) = amplitude(j) * sin(w * s.t);
+            s.vel(j) = amplitude(j) * w * cos(w * s.t);
+            acc_w(j) = -amplitude(j) * w * w * sin(w * s.t);
+          }
+
+        /* the tilt follows the horizontal acc */
+        Vector3d rpy(-atan2(acc_w.y(), GRAVITY), atan2(acc_w.x(), GRAVITY), 0.2 * sin(0.1 * s.t));
+        Matrix3d r = (AngleAxisd(rpy.z(), Vector3d::UnitZ()) * AngleAxisd(rpy.y(), Vector3d::UnitY()) * AngleAxisd(rpy.x(), Vector3d::UnitX())).toRotationMatrix();
+        s.acc_b = r.transpose() * acc_w + ACC_NOISE * Vector3d(normal(engine), normal(engine), normal(engine));
+        s.rpy = rpy - Vector3d(BIAS.x(), BIAS.y(), 0);
+
+        s.meas_pos = s.pos + POS_NOISE * Vector2d(normal(engine), normal(engine));
+        s.meas_vel = s.vel + VEL_NOISE * Vector2d(normal(engine), normal(engine));
+        samples.push_back(s);
+      }
+    return samples;
+  }
+
+  /* the fixed-size filter */
+  class Fuser
+  {
+  public:
+    Fuser(): input_(5), params_(7)
+    {
+      kf_.initialize("xy_bias", (1 << 3) | (1 << 4));
+      VectorXd input_noise_sigma(5);
+      input_noise_sigma << ACC_NOISE, ACC_NOISE, ACC_NOISE, BIAS_NOISE, BIAS_NOISE;
+      kf_.setPredictionNoiseCovariance(input_noise_sigma);
+      kf_.setInputFlag();
+      kf_.setMeasureFlag();
+    }
+
+    /* as sensor_plugin::Imu */
+    void predict(const Sample& s)
+    {
+      params_ = {1 / IMU_RATE, s.rpy.x(), s.rpy.y(), s.rpy.z(), s.acc_b.x(), s.acc_b.y(), s.acc_b.z()};
+      input_ << s.acc_b, 0, 0;
+      kf_.predictionWithHistory(input_, s.t, params_);
+    }
+
+    /* timestamp < 0: on time */
+    bool correctPos(const Sample& s, double timestamp)
+    {
+      VectorXd meas = s.meas_pos;
+      return kf_.correctionWithHistory(meas, VectorXd::Constant(2, POS_NOISE), timestamp, {kf_plugin::POS});
+    }
+
+    void correctVel(const Sample& s)
+    {
+      VectorXd meas = s.meas_vel;
+      kf_.correctionWithHistory(meas, VectorXd::Constant(2, VEL_NOISE), -1, {kf_plugin::VEL});
+    }
+
+    Vector2d getPos() { VectorXd state = kf_.getEstimateState(); return Vector2d(state(0), state(2)); }
+
+    kf_plugin::KalmanFilterXYBias kf_;
+
+  private:
+    VectorXd input_;
+    std::vector<double> params_;
+  };
+
+  /* the dynamic filter of the base class */
+  class DynamicFuser
+  {
+  public:
+    DynamicFuser(): input_(5), params_(7)
+    {
+      kf_.initialize("xy_bias_dynamic", (1 << 3) | (1 << 4));
+      VectorXd input_noise_sigma(5);
+      input_noise_sigma << ACC_NOISE, ACC_NOISE, ACC_NOISE, BIAS_NOISE, BIAS_NOISE;
+      kf_.setPredictionNoiseCovariance(input_noise_sigma);
+      kf_.setInputFlag();
+      kf_.setMeasureFlag();
+    }
+
+    void predict(const Sample& s)
+    {
+      params_ = {1 / IMU_RATE, s.rpy.x(), s.rpy.y(), s.rpy.z(), s.acc_b.x(), s.acc_b.y(), s.acc_b.z()};
+      input_ << s.acc_b, 0, 0;
+      kf_.prediction(input_, s.t, params_);
+    }
+
+    void correctPos(const Sample& s)
+    {
+      VectorXd meas = s.meas_pos;
+      kf_.correction(meas, VectorXd::Constant(2, POS_NOISE), -1, {kf_plugin::POS});
+    }
+
+    void correctVel(const Sample& s)
+    {
+      VectorXd meas = s.meas_vel;
+      kf_.correction(meas, VectorXd::Constant(2, VEL_NOISE), -1, {kf_plugin::VEL});
+    }
+
+    kf_plugin::KalmanFilterXYBias kf_;
+
+  private:
+    VectorXd input_;
+    std::vector<double> params_;
+  };
+
+  struct Result
+  {
+    double max_state_diff; // to the oracle after the last arrival
+    double max_covariance_diff;
+    double pos_rms; // to the ground truth
+    int max_replay_size;
+  };
+
+  /* delay: [imu samples], the position is applied at the arrival if time_sync is false */
+  Result run(Fuser& fuser, Fuser& oracle, const std::vector<Sample>& samples, int delay, bool time_sync = true)
+  {
+    Result result = {0, 0, 0, 0};
+    int count = 0;
+    int last = samples.size() - 1;
+    for(int i = 0; i <= last; i++)
+      {
+        const Sample& s = samples[i];
+        fuser.predict(s);
+        oracle.predict(s);
+
+        if(i % VEL_INTERVAL == 0)
+          {
+            fuser.correctVel(s);
+            oracle.correctVel(s);
+          }
+
+        /* no measurement in flight at the end */
+        bool taken = (i % POS_INTERVAL == 0) && (i + delay <= last - POS_INTERVAL);
+        if(taken) oracle.correctPos(s, -1);
+        if(i >= delay && (i - delay) % POS_INTERVAL == 0 && i <= last - POS_INTERVAL)
+          {
+            const Sample& delayed = samples[i - delay];
+            EXPECT_TRUE(fuser.correctPos(delayed, time_sync ? delayed.t : -1));
+            if(fuser.kf_.getLastReplaySize() > result.max_replay_size) result.max_replay_size = fuser.kf_.getLastReplaySize();
+          }
+
+        if(s.t - samples[0].t < SETTLE) continue;
+        result.pos_rms += (fuser.getPos() - s.pos).squaredNorm();
+        count++;
+      }
+    result.pos_rms = sqrt(result.pos_rms / count);
+    result.max_state_diff = (fuser.kf_.getEstimateState() - oracle.kf_.getEstimateState()).cwiseAbs().maxCoeff();
+    result.max_covariance_diff = (fuser.kf_.getEstimateCovariance() - oracle.kf_.getEstimateCovariance()).cwiseAbs().maxCoeff();
+    return result;
+  }
+}
+
+TEST(KalmanFilterXYBiasTest, PredictModel)
+{
+  typedef kf_plugin::KalmanFilterXYBias Filter;
+
+  /* the body frame acc is rotated to the world frame by the attitude with the bias */
+  double dt = 0.005;
+  Vector3d rpy(0.1, -0.2, 1.0);
+  Vector2d bias(0.02, -0.03);
+  Vector3d acc_b(0.3, -0.5, GRAVITY);
+  double params[Filter::PARAM_SIZE] = {dt, rpy.x(), rpy.y(), rpy.z(), acc_b.x(), acc_b.y(), acc_b.z()};
+  Filter::StateVector state = Filter::StateVector::Zero();
+  state.tail<2>() = bias;
+
+  Filter::StateMatrix f;
+  Filter::ControlMatrix g;
+  Filter::predictModel(params, state, f, g);
+  Filter::InputVector input;
+  input << acc_b, 0, 0;
+  Filter::StateVector next = g * input;
+
+  Matrix3d r = (AngleAxisd(rpy.z(), Vector3d::UnitZ()) * AngleAxisd(rpy.y() + bias.y(), Vector3d::UnitY()) * AngleAxisd(rpy.x() + bias.x(), Vector3d::UnitX())).toRotationMatrix();
+  Vector3d acc_w = r * acc_b;
+  EXPECT_NEAR(next(1), dt * acc_w.x(), 1e-7); // dt is float in the model
+  EXPECT_NEAR(next(3), dt * acc_w.y(), 1e-7);
+
+  /* the jacobian of the bias */
+  const double delta = 1e-6;
+  for(int i = 0; i < 2; i++)
+    {
+      Filter::StateVector shifted = state;
+      shifted(4 + i) += delta;
+      Matrix3d r_shifted = (AngleAxisd(rpy.z(), Vector3d::UnitZ()) * AngleAxisd(rpy.y() + shifted(5), Vector3d::UnitY()) * AngleAxisd(rpy.x() + shifted(4), Vector3d::UnitX())).toRotationMatrix();
+      Vector3d d_acc_w = (r_shifted * acc_b - acc_w) / delta;
+      EXPECT_NEAR(f(1, 4 + i), dt * d_acc_w.x(), 1e-6) << "bias " << i;
+      EXPECT_NEAR(f(3, 4 + i), dt * d_acc_w.y(), 1e-6) << "bias " << i;
+    }
+
+  /* the dynamic model of the base class interface is the same */
+  Filter kf;
+  kf.initialize("model", (1 << 3) | (1 << 4));
+  MatrixXd f_dynamic, g_dynamic;
+  kf.getPredictModel(std::vector<double>(params, params + Filter::PARAM_SIZE), state, f_dynamic, g_dynamic);
+  EXPECT_EQ((f_dynamic - f).cwiseAbs().maxCoeff(), 0);
+  EXPECT_EQ((g_dynamic - g).cwiseAbs().maxCoeff(), 0);
+}
+
+TEST(KalmanFilterXYBiasTest, FixedSize)
+{
+  std::vector<Sample> samples = generateTrajectory(4);
+
+  Fuser fixed;
+  DynamicFuser dynamic;
+  std::chrono::nanoseconds fixed_elapsed(0), dynamic_elapsed(0);
+  double max_state_diff = 0, max_covariance_diff = 0, max_asymmetry = 0;
+  for(size_t i = 0; i < samples.size(); i++)
+    {
+      const Sample& s = samples[i];
+      auto start = std::chrono::steady_clock::now();
+      fixed.predict(s);
+      if(i % VEL_INTERVAL == 0) fixed.correctVel(s);
+      if(i % POS_INTERVAL == 0) fixed.correctPos(s, -1);
+      fixed_elapsed += std::chrono::steady_clock::now() - start;
+
+      start = std::chrono::steady_clock::now();
+      dynamic.predict(s);
+      if(i % VEL_INTERVAL == 0) dynamic.correctVel(s);
+      if(i % POS_INTERVAL == 0) dynamic.correctPos(s);
+      dynamic_elapsed += std::chrono::steady_clock::now() - start;
+
+      MatrixXd covariance = fixed.kf_.getEstimateCovariance();
+      max_state_diff = std::max(max_state_diff, (fixed.kf_.getEstimateState() - dynamic.kf_.getEstimateState()).cwiseAbs().maxCoeff());
+      max_covariance_diff = std::max(max_covariance_diff, (covariance - dynamic.kf_.getEstimateCovariance()).cwiseAbs().maxCoeff());
+      max_asymmetry = std::max(max_asymmetry, (covariance - covariance.transpose()).cwiseAbs().maxCoeff());
+    }
+
+  double fixed_ns = (double)fixed_elapsed.count() / samples.size();
+  double dynamic_ns = (double)dynamic_elapsed.count() / samples.size();
+  ROS_INFO("fixed-size: %f [ns], dynamic: %f [ns] per imu sample, state diff %e, covariance diff %e, asymmetry %e",
+           fixed_ns, dynamic_ns, max_state_diff, max_covariance_diff, max_asymmetry);
+
+  /* the Joseph form differs only by the rounding */
+  EXPECT_LT(max_state_diff, 1e-9);
+  EXPECT_LT(max_covariance_diff, 1e-9);
+  EXPECT_LT(max_asymmetry, 1e-12);
+}
+
+TEST(KalmanFilterXYBiasTest, Oracle)
+{
+  std::vector<Sample> samples = generateTrajectory();
+
+  for(int delay : {0, 4, 10, 20, 60}) // 0, 20, 50, 100, 300 [ms]
+    {
+      Fuser fuser, oracle;
+      Result result = run(fuser, oracle, samples, delay);
+      ROS_INFO("delay %d [ms]: state diff %e, covariance diff %e, pos rms %f, replay %d",
+               (int)(delay * 1000 / IMU_RATE), result.max_state_diff, result.max_covariance_diff, result.pos_rms, result.max_replay_size);
+
+      EXPECT_LT(result.max_state_diff, 1e-9) << "delay " << delay;
+      EXPECT_LT(result.max_covariance_diff, 1e-9) << "delay " << delay;
+      EXPECT_EQ(result.max_replay_size, delay) << "delay " << delay;
+
+      /* the delay costs only the information in flight */
+      EXPECT_LT(result.pos_rms, 2 * POS_NOISE) << "delay " << delay;
+    }
+}
+
+TEST(KalmanFilterXYBiasTest, ApplyAtArrival)
+{
+  std::vector<Sample> samples = generateTrajectory(2);
+  const int delay = 20;
+
+  Fuser fuser, oracle;
+  Result result = run(fuser, oracle, samples, delay);
+
+  Fuser naive, naive_oracle;
+  Result naive_result = run(naive, naive_oracle, samples, delay, false);
+  ROS_INFO("delay %d [ms]: pos rms %f with the history, %f at the arrival",
+           (int)(delay * 1000 / IMU_RATE), result.pos_rms, naive_result.pos_rms);
+
+  EXPECT_LT(result.pos_rms, naive_result.pos_rms);
+  EXPECT_GT(naive_result.max_state_diff, 1e-3);
+}
+
+TEST(KalmanFilterXYBiasTest, ReplayBudget)
+{
+  std::vector<Sample> samples = generateTrajectory(3);
+  const int budget = 20;
+  const int history_size = 50;
+
+  Fuser fuser;
+  fuser.kf_.setHistorySize(history_size);
+  fuser.kf_.setReplayBudget(budget);
+  for(int i = 0; i < 100; i++) fuser.predict(samples[i]);
+  EXPECT_EQ(fuser.kf_.getHistoryCount(), history_size);
+
+  /* within the budget */
+  EXPECT_TRUE(fuser.correctPos(samples[90], samples[90].t));
+  EXPECT_EQ(fuser.kf_.getLastReplaySize(), 9);
+
+  /* beyond the budget: applied at the oldest entry within the budget */
+  EXPECT_TRUE(fuser.correctPos(samples[60], samples[60].t));
+  EXPECT_EQ(fuser.kf_.getLastReplaySize(), budget);
+
+  /* older than the history */
+  EXPECT_FALSE(fuser.correctPos(samples[30], samples[30].t));
+  EXPECT_EQ(fuser.kf_.getLastReplaySize(), 0);
+
+  /* newer than the last prediction: as it is */
+  EXPECT_TRUE(fuser.correctPos(samples[99], samples[99].t + 0.1));
+  EXPECT_EQ(fuser.kf_.getLastReplaySize(), 0);
+}
+
+TEST(KalmanFilterXYBiasTest, Reset)
+{
+  std::vector<Sample> samples = generateTrajectory(4);
+
+  Fuser fuser;
+  for(int i = 0; i < 100; i++) fuser.predict(samples[i]);
+  EXPECT_EQ(fuser.kf_.getHistoryCount(), 100);
+
+  VectorXd init_state = VectorXd::Zero(kf_plugin::KalmanFilterXYBias::STATE_DIM);
+  init_state(0) = 1.0;
+  fuser.kf_.setInitState(init_state);
+  EXPECT_EQ(fuser.kf_.getHistoryCount(), 0);
+
+  /* taken before the reset: the state is kept */
+  for(int i = 100; i < 110; i++) fuser.predict(samples[i]);
+  VectorXd state = fuser.kf_.getEstimateState();
+  EXPECT_FALSE(fuser.correctPos(samples[95], samples[95].t));
+  EXPECT_EQ((fuser.kf_.getEstimateState() - state).cwiseAbs().maxCoeff(), 0.0);
+  EXPECT_TRUE(fuser.correctPos(samples[105], samples[105].t));
+  EXPECT_EQ(fuser.kf_.getLastReplaySize(), 4);
+
+  /* reset through the base class */
+  kf_plugin::KalmanFilter& base = fuser.kf_;
+  base.setInitState(init_state);
+  fuser.predict(samples[110]);
+  EXPECT_EQ(fuser.kf_.getHistoryCount(), 1);
+  EXPECT_FALSE(fuser.correctPos(samples[108], samples[108].t));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "kf_xy_roll_pitch_bias_test");
+  return RUN_ALL_TESTS();
+}
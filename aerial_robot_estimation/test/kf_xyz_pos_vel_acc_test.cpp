@@ -0,0 +1,341 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: synthetic trajectory test of the coupled x, y, z filter (aerial_robot_base/kf_xyz_pos_vel_acc)
+       against the three kalman_filter/kf_pos_vel_acc filters, with the same imu and mocap streams.
+       The body frame acc noise is anisotropic (larger along the thrust axis because of the vibration),
+       so the world frame acc noise is correlated between the axes under the tilt and the yaw rotation.
+       The rms errors and the processing time per imu sample are reported.
+*/
+
+#include <aerial_robot_estimation/kf/xyz_pos_vel_acc_plugin.h>
+#include <gtest/gtest.h>
+#include <kalman_filter/kf_pos_vel_acc_plugin.h>
+#include <chrono>
+#include <random>
+
+using namespace Eigen;
+
+namespace
+{
+  const double IMU_RATE = 500.0;
+  const int MOCAP_INTERVAL = 5; // 100Hz
+  const double DURATION = 60.0;
+  const double SETTLE = 10.0;
+  const double LEVEL_ACC_NOISE = 0.05; // [m/s^2], body frame x, y
+  const double Z_ACC_NOISE = 0.5; // [m/s^2], body frame z
+  const double POS_NOISE = 0.005; // [m]
+
+  struct Sample
+  {
+    double t;
+    Vector3d acc_b; // linear acc in body frame without gravity
+    Vector3d rpy;
+    Vector3d pos, vel; // ground truth
+    Vector3d meas_pos; // mocap
+    bool mocap;
+  };
+
+  struct Result
+  {
+    Vector3d pos_rms;
+    Vector3d vel_rms;
+    double ns_per_update;
+  };
+
+  Matrix3d rotation(const Vector3d& rpy)
+  {
+    return (AngleAxisd(rpy.z(), Vector3d::UnitZ()) * AngleAxisd(rpy.y(), Vector3d::UnitY()) * AngleAxisd(rpy.x(), Vector3d::UnitX())).toRotationMatrix();
+  }
+
+  std::vector<Sample> generateTrajectory(unsigned int seed = 1)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    const Vector3d amplitude(1.0, 0.8, 0.3);
+    const Vector3d frequency(0.2, 0.15, 0.1);
+    const Vector3d tilt(0.3, 0.3, 0.0);
+    const Vector3d tilt_frequency(0.5, 0.37, 0.0);
+    const double yaw_rate = 0.3;
+
+    std::vector<Sample> samples;
+    int size = DURATION * IMU_RATE;
+    samples.reserve(size);
+    for(int i = 0; i < size; i++)
+      {
+        Sample s;
+        s.t = i / IMU_RATE;
+
+        Vector3d acc_w;
+        for(int j = 0; j < 3; j++)
+          {
+            double w = 2 * M_PI * frequency(j);
+            s.pos(j) = amplitude(j) * sin(w * s.t);
+            s.vel(j) = amplitude(j) * w * cos(w * s.t);
+            acc_w(j) = -amplitude(j) * w * w * sin(w * s.t);
+            s.rpy(j) = tilt(j) * sin(2 * M_PI * tilt_frequency(j) * s.t);
+          }
+        s.rpy.z() = yaw_rate * s.t;
+
+        s.acc_b = rotation(s.rpy).transpose() * acc_w
+          + Vector3d(LEVEL_ACC_NOISE * normal(engine), LEVEL_ACC_NOISE * normal(engine), Z_ACC_NOISE * normal(engine));
+
+        s.mocap = (i % MOCAP_INTERVAL == 0);
+        s.meas_pos = s.pos + POS_NOISE * Vector3d(normal(engine), normal(engine), normal(engine));
+
+        samples.push_back(s);
+      }
+    return samples;
+  }
+
+  /* the coupled filter: the body frame acc and the attitude in one prediction */
+  class CoupledFuser
+  {
+  public:
+    CoupledFuser(): input_(6), params_(4)
+    {
+      kf_.initialize("coupled", (1 << 3) | (1 << 4) | (1 << 5));
+      VectorXd input_noise_sigma(6);
+      input_noise_sigma << LEVEL_ACC_NOISE, LEVEL_ACC_NOISE, Z_ACC_NOISE, 0, 0, 0;
+      kf_.setPredictionNoiseCovariance(input_noise_sigma);
+      kf_.setInputFlag();
+      kf_.setMeasureFlag();
+    }
+
+    void predict(const Sample& s)
+    {
+      input_ << s.acc_b, 0, 0, 0;
+      params_ = {1 / IMU_RATE, s.rpy.x(), s.rpy.y(), s.rpy.z()};
+      kf_.prediction(input_, s.t, params_);
+    }
+
+    void correct(const Sample& s)
+    {
+      VectorXd measure_sigma = VectorXd::Constant(3, POS_NOISE);
+      VectorXd meas = s.meas_pos;
+      kf_.correction(meas, measure_sigma, -1, {kf_plugin::POS});
+    }
+
+    void getState(Vector3d& pos, Vector3d& vel)
+    {
+      const VectorXd state = kf_.getEstimateState();
+      for(int i = 0; i < 3; i++)
+        {
+          pos(i) = state(kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(i));
+          vel(i) = state(kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(i));
+        }
+    }
+
+  private:
+    kf_plugin::KalmanFilterXYZPosVelAcc kf_;
+    VectorXd input_;
+    std::vector<double> params_;
+  };
+
+  /* the three filter setup of sensor_plugin::Imu: the world frame acc of each axis with diagonal noise */
+  class SeparateFuser
+  {
+  public:
+    SeparateFuser(): input_(2), params_(1)
+    {
+      for(int i = 0; i < 3; i++)
+        {
+          kf_[i].initialize("axis" + std::to_string(i), 1 << (3 + i));
+          VectorXd input_noise_sigma(2);
+          input_noise_sigma << ((i < 2)?LEVEL_ACC_NOISE:Z_ACC_NOISE), 0;
+          kf_[i].setPredictionNoiseCovariance(input_noise_sigma);
+          kf_[i].setInputFlag();
+          kf_[i].setMeasureFlag();
+        }
+    }
+
+    void predict(const Sample& s)
+    {
+      Vector3d acc_w = rotation(s.rpy) * s.acc_b;
+      params_[0] = 1 / IMU_RATE;
+      for(int i = 0; i < 3; i++)
+        {
+          input_ << acc_w(i), 0;
+          kf_[i].prediction(input_, s.t, params_);
+        }
+    }
+
+    void correct(const Sample& s)
+    {
+      VectorXd measure_sigma = VectorXd::Constant(1, POS_NOISE);
+      for(int i = 0; i < 3; i++)
+        {
+          VectorXd meas = VectorXd::Constant(1, s.meas_pos(i));
+          kf_[i].correction(meas, measure_sigma, -1, {kf_plugin::POS});
+        }
+    }
+
+    void getState(Vector3d& pos, Vector3d& vel)
+    {
+      for(int i = 0; i < 3; i++)
+        {
+          const VectorXd state = kf_[i].getEstimateState();
+          pos(i) = state(0);
+          vel(i) = state(1);
+        }
+    }
+
+  private:
+    kf_plugin::KalmanFilterPosVelAcc kf_[3];
+    VectorXd input_;
+    std::vector<double> params_;
+  };
+
+  template<class Fuser> Result run(Fuser& fuser, const std::vector<Sample>& samples)
+  {
+    Result result;
+    result.pos_rms.setZero();
+    result.vel_rms.setZero();
+    std::chrono::nanoseconds elapsed(0);
+    int count = 0;
+
+    for(const auto& s: samples)
+      {
+        auto start = std::chrono::steady_clock::now();
+        fuser.predict(s);
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        if(s.mocap) fuser.correct(s);
+
+        if(s.t < SETTLE) continue;
+        Vector3d pos, vel;
+        fuser.getState(pos, vel);
+        result.pos_rms += (pos - s.pos).cwiseAbs2();
+        result.vel_rms += (vel - s.vel).cwiseAbs2();
+        count++;
+      }
+
+    result.pos_rms = (result.pos_rms / count).cwiseSqrt();
+    result.vel_rms = (result.vel_rms / count).cwiseSqrt();
+    result.ns_per_update = (double)elapsed.count() / samples.size();
+    return result;
+  }
+
+  void report(const std::string& name, const Result& r)
+  {
+    ROS_INFO("%s: pos rms [%f, %f, %f], vel rms [%f, %f, %f], %f [ns] per imu sample", name.c_str(),
+             r.pos_rms.x(), r.pos_rms.y(), r.pos_rms.z(), r.vel_rms.x(), r.vel_rms.y(), r.vel_rms.z(), r.ns_per_update);
+  }
+}
+
+TEST(KalmanFilterXYZPosVelAccTest, PredictModel)
+{
+  kf_plugin::KalmanFilterXYZPosVelAcc kf;
+  kf.initialize("model", (1 << 3) | (1 << 4) | (1 << 5));
+
+  /* the body frame input is rotated to the world frame */
+  MatrixXd f, g;
+  double dt = 0.01;
+  Vector3d rpy(0.1, -0.2, 1.0);
+  kf.getPredictModel({dt, rpy.x(), rpy.y(), rpy.z()}, kf.getEstimateState(), f, g);
+  ASSERT_EQ(f.rows(), 9);
+  ASSERT_EQ(g.cols(), 6);
+
+  VectorXd state = VectorXd::Zero(9);
+  VectorXd input = VectorXd::Zero(6);
+  Vector3d acc_b(0.3, -0.5, 1.0);
+  input.head<3>() = acc_b;
+  state = f * state + g * input;
+  Vector3d acc_w = rotation(rpy) * acc_b;
+  for(int i = 0; i < 3; i++)
+    {
+      EXPECT_NEAR(state(kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(i)), 0.5 * dt * dt * acc_w(i), 1e-12);
+      EXPECT_NEAR(state(kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(i)), dt * acc_w(i), 1e-12);
+    }
+
+  /* the bias is subtracted from the world frame acc */
+  state.setZero();
+  state.tail<3>() = Vector3d(0.1, 0.2, 0.3);
+  state = f * state;
+  for(int i = 0; i < 3; i++)
+    EXPECT_NEAR(state(kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(i)), -dt * 0.1 * (i + 1), 1e-12);
+}
+
+TEST(KalmanFilterXYZPosVelAccTest, CorrectModel)
+{
+  kf_plugin::KalmanFilterXYZPosVelAcc kf;
+  kf.initialize("model", (1 << 3) | (1 << 4) | (1 << 5));
+
+  MatrixXd h;
+  kf.getCorrectModel({kf_plugin::POS}, kf.getEstimateState(), h);
+  ASSERT_EQ(h.rows(), 3);
+  for(int i = 0; i < 3; i++) EXPECT_EQ(h(i, kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(i)), 1);
+
+  /* only z */
+  kf.getCorrectModel({kf_plugin::POS, 1 << 2}, kf.getEstimateState(), h);
+  ASSERT_EQ(h.rows(), 1);
+  EXPECT_EQ(h(0, kf_plugin::KalmanFilterXYZPosVelAcc::posIndex(2)), 1);
+
+  /* x, y position and velocity */
+  kf.getCorrectModel({kf_plugin::POS_VEL, 0x03}, kf.getEstimateState(), h);
+  ASSERT_EQ(h.rows(), 4);
+  EXPECT_EQ(h(2, kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(0)), 1);
+  EXPECT_EQ(h(3, kf_plugin::KalmanFilterXYZPosVelAcc::velIndex(1)), 1);
+}
+
+TEST(KalmanFilterXYZPosVelAccTest, SyntheticTrajectory)
+{
+  std::vector<Sample> samples = generateTrajectory();
+
+  CoupledFuser coupled;
+  Result coupled_result = run(coupled, samples);
+  report("xyz_pos_vel_acc", coupled_result);
+
+  SeparateFuser separate;
+  Result separate_result = run(separate, samples);
+  report("3 x pos_vel_acc", separate_result);
+
+  for(int i = 0; i < 3; i++)
+    {
+      EXPECT_LT(coupled_result.pos_rms(i), 2 * POS_NOISE) << "axis " << i;
+      EXPECT_LT(coupled_result.vel_rms(i), 0.1) << "axis " << i;
+    }
+
+  /* the correlated world frame noise is modeled only by the coupled filter */
+  EXPECT_LT(coupled_result.vel_rms.norm(), separate_result.vel_rms.norm());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "kf_xyz_pos_vel_acc_test");
+  return RUN_ALL_TESTS();
+}
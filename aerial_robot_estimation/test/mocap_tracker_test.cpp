@@ -0,0 +1,347 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of aerial_robot_estimation::MocapTracker with synthetic mocap streams at 100Hz:
+       a circle with the vertical wave and the rotation, the uneven capture intervals, the transport latency,
+       the dropped, the duplicated and the reordered frames.
+       The velocity error and the lag are compared with the former differentiator of sensor_plugin::Mocap
+       (difference of the consecutive frames and the second order butterworth lpf at 20Hz).
+*/
+
+#include <aerial_robot_estimation/sensor/mocap_tracker.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace aerial_robot_estimation;
+
+namespace
+{
+  const double RATE = 100.0; // [Hz]
+  const double DURATION = 20.0; // [s]
+  const double POS_NOISE = 0.0003; // [m]
+  const double RADIUS = 1.0, OMEGA = 1.5; // [m], [rad/s]
+
+  struct Truth
+  {
+    Eigen::Vector3d pos, vel;
+    Eigen::Quaterniond q;
+    Eigen::Vector3d omega; // body frame
+  };
+
+  Eigen::Quaterniond attitude(double t)
+  {
+    return Eigen::AngleAxisd(0.8 * t, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(0.2 * sin(3 * t), Eigen::Vector3d::UnitX());
+  }
+
+  Truth truth(double t)
+  {
+    Truth s;
+    s.pos << RADIUS * cos(OMEGA * t), RADIUS * sin(OMEGA * t), 1.0 + 0.2 * sin(2 * OMEGA * t);
+    s.vel << -RADIUS * OMEGA * sin(OMEGA * t), RADIUS * OMEGA * cos(OMEGA * t), 0.4 * OMEGA * cos(2 * OMEGA * t);
+    s.q = attitude(t);
+    const double h = 1e-5;
+    Eigen::AngleAxisd delta(attitude(t - h).conjugate() * attitude(t + h));
+    s.omega = delta.angle() * delta.axis() / (2 * h);
+    return s;
+  }
+
+  struct StreamConfig
+  {
+    double interval_jitter; // uniform +- [s] of the capture interval
+    double latency_min, latency_mean_extra; // [s], exponential extra
+    double drop_rate, duplicate_rate;
+  };
+
+  /* frames in the arrival order */
+  std::vector<MocapFrame> generate(const StreamConfig& config, unsigned int seed = 1)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::exponential_distribution<double> extra(1.0 / std::max(config.latency_mean_extra, 1e-9));
+
+    std::vector<MocapFrame> frames;
+    double t = 0;
+    while(t < DURATION)
+      {
+        t += 1 / RATE + config.interval_jitter * (2 * uniform(engine) - 1);
+        if(uniform(engine) < config.drop_rate) continue;
+
+        MocapFrame frame;
+        Truth s = truth(t);
+        frame.stamp = t;
+        frame.receive_stamp = t + config.latency_min + (config.latency_mean_extra > 0 ? extra(engine) : 0);
+        frame.pos = s.pos + POS_NOISE * Eigen::Vector3d(normal(engine), normal(engine), normal(engine));
+        frame.q = s.q;
+        frames.push_back(frame);
+
+        if(uniform(engine) < config.duplicate_rate)
+          {
+            frame.receive_stamp += 0.001;
+            frames.push_back(frame);
+          }
+      }
+
+    std::stable_sort(frames.begin(), frames.end(),
+                     [](const MocapFrame& a, const MocapFrame& b) { return a.receive_stamp < b.receive_stamp; });
+    return frames;
+  }
+
+  /* the former velocity of sensor_plugin::Mocap: difference and IirFilter(100, 20) */
+  class FormerDifferentiator
+  {
+  public:
+    FormerDifferentiator(): first_(true), prev_pos_(Eigen::Vector3d::Zero()), prev_stamp_(0)
+    {
+      /* second order butterworth by the bilinear transform */
+      double k = tan(M_PI * 20.0 / RATE);
+      double norm = 1 / (1 + sqrt(2.0) * k + k * k);
+      b_[0] = k * k * norm; b_[1] = 2 * b_[0]; b_[2] = b_[0];
+      a_[0] = 2 * (k * k - 1) * norm; a_[1] = (1 - sqrt(2.0) * k + k * k) * norm;
+      x_[0] = x_[1] = y_[0] = y_[1] = Eigen::Vector3d::Zero();
+    }
+
+    Eigen::Vector3d update(const MocapFrame& frame)
+    {
+      Eigen::Vector3d raw = Eigen::Vector3d::Zero();
+      if(!first_) raw = (frame.pos - prev_pos_) / (frame.stamp - prev_stamp_);
+      first_ = false;
+      prev_pos_ = frame.pos;
+      prev_stamp_ = frame.stamp;
+
+      Eigen::Vector3d out = b_[0] * raw + b_[1] * x_[0] + b_[2] * x_[1] - a_[0] * y_[0] - a_[1] * y_[1];
+      x_[1] = x_[0]; x_[0] = raw;
+      y_[1] = y_[0]; y_[0] = out;
+      return out;
+    }
+
+  private:
+    bool first_;
+    Eigen::Vector3d prev_pos_;
+    double prev_stamp_;
+    double b_[3], a_[2];
+    Eigen::Vector3d x_[2], y_[2];
+  };
+
+  struct Estimate
+  {
+    double stamp;
+    Eigen::Vector3d vel;
+  };
+
+  double rmsError(const std::vector<Estimate>& estimates, double lag = 0)
+  {
+    double sum = 0;
+    int count = 0;
+    for(const auto& e : estimates)
+      {
+        if(e.stamp < 1.0) continue; // convergence of the filters
+        sum += (e.vel - truth(e.stamp - lag).vel).squaredNorm();
+        count++;
+      }
+    return sqrt(sum / count);
+  }
+
+  /* the delay of the estimate which fits the truth best */
+  double lag(const std::vector<Estimate>& estimates)
+  {
+    double best_lag = 0, best_error = rmsError(estimates);
+    for(double d = 0.0005; d <= 0.03; d += 0.0005)
+      {
+        double error = rmsError(estimates, d);
+        if(error < best_error)
+          {
+            best_error = error;
+            best_lag = d;
+          }
+      }
+    return best_lag;
+  }
+
+  void run(const std::vector<MocapFrame>& frames, MocapTracker& tracker,
+           std::vector<Estimate>& tracked, std::vector<Estimate>& former)
+  {
+    FormerDifferentiator differentiator;
+    for(const auto& frame : frames)
+      {
+        MocapTracker::Result result = tracker.add(frame);
+        if(result.status != MocapTracker::NEW) continue; // the former one gives inf with the duplicate
+        if(result.vel_valid) tracked.push_back(Estimate{result.stamp, result.vel});
+        former.push_back(Estimate{frame.stamp, differentiator.update(frame)});
+      }
+  }
+}
+
+TEST(MocapTrackerTest, VelocityAndLag)
+{
+  StreamConfig config = {0.0005, 0.004, 0.0, 0.0, 0.0};
+  std::vector<MocapFrame> frames = generate(config);
+
+  MocapTracker tracker;
+  std::vector<Estimate> tracked, former;
+  run(frames, tracker, tracked, former);
+
+  double tracked_error = rmsError(tracked), former_error = rmsError(former);
+  double tracked_lag = lag(tracked), former_lag = lag(former);
+  EXPECT_LT(tracked_error, 0.7 * former_error);
+  EXPECT_LT(tracked_error, 0.03);
+  EXPECT_LE(tracked_lag, 0.002);
+  EXPECT_GT(former_lag, 0.005);
+  EXPECT_NEAR(tracker.getPeriod(), 1 / RATE, 2e-4);
+
+  RecordProperty("tracked_vel_rms_mm_s", static_cast<int>(tracked_error * 1000));
+  RecordProperty("former_vel_rms_mm_s", static_cast<int>(former_error * 1000));
+  RecordProperty("tracked_lag_us", static_cast<int>(tracked_lag * 1e6));
+  RecordProperty("former_lag_us", static_cast<int>(former_lag * 1e6));
+}
+
+TEST(MocapTrackerTest, UnevenStamps)
+{
+  /* the capture interval varies from 5ms to 15ms */
+  StreamConfig config = {0.005, 0.004, 0.0, 0.0, 0.0};
+  std::vector<MocapFrame> frames = generate(config, 2);
+
+  MocapTracker tracker;
+  std::vector<Estimate> tracked, former;
+  run(frames, tracker, tracked, former);
+
+  /* the same frames on the nominal stamps, i.e. the stamps are ignored */
+  std::vector<MocapFrame> nominal = frames;
+  for(size_t i = 0; i < nominal.size(); i++) nominal[i].stamp = (i + 1) / RATE;
+  MocapTracker nominal_tracker;
+  std::vector<Estimate> nominal_tracked, nominal_former;
+  run(nominal, nominal_tracker, nominal_tracked, nominal_former);
+  for(size_t i = 0; i < nominal_tracked.size(); i++) nominal_tracked[i].stamp = frames[i + 1].stamp; // back to the capture time
+
+  double error = rmsError(tracked), nominal_error = rmsError(nominal_tracked);
+  EXPECT_LT(error, 0.05);
+  EXPECT_LT(error, 0.2 * nominal_error);
+  RecordProperty("vel_rms_mm_s", static_cast<int>(error * 1000));
+  RecordProperty("nominal_stamp_vel_rms_mm_s", static_cast<int>(nominal_error * 1000));
+}
+
+TEST(MocapTrackerTest, DuplicateDropAndReorder)
+{
+  /* the latency up to ~30ms reorders the frames */
+  StreamConfig config = {0.0005, 0.004, 0.006, 0.03, 0.02};
+  std::vector<MocapFrame> frames = generate(config, 3);
+
+  /* expected counts from the stream */
+  int duplicates = 0, reordered = 0;
+  double newest = -1;
+  for(const auto& frame : frames)
+    {
+      if(fabs(frame.stamp - newest) < 1e-6) duplicates++;
+      else if(frame.stamp < newest) reordered++;
+      else newest = frame.stamp;
+    }
+  ASSERT_GT(duplicates, 0);
+  ASSERT_GT(reordered, 0);
+
+  MocapTracker tracker;
+  tracker.setNominalRate(RATE);
+  std::vector<Estimate> tracked, former;
+  double max_error = 0;
+  for(const auto& frame : frames)
+    {
+      MocapTracker::Result result = tracker.add(frame);
+      if(result.status != MocapTracker::NEW || result.stamp < 1.0) continue;
+      max_error = std::max(max_error, (result.vel - truth(result.stamp).vel).norm());
+    }
+
+  EXPECT_EQ(tracker.getDuplicateCount(), duplicates);
+  EXPECT_EQ(tracker.getOutOfOrderCount(), reordered);
+  /* the frames lost in the stream and the reordered ones skipped by the newer frame */
+  int expected_drops = static_cast<int>(std::lround(DURATION * RATE)) - (static_cast<int>(frames.size()) - duplicates);
+  EXPECT_NEAR(tracker.getDropCount(), expected_drops + reordered, 0.02 * DURATION * RATE);
+  EXPECT_LT(max_error, 0.15); // no spike by the duplicate or the gap
+  RecordProperty("max_vel_error_mm_s", static_cast<int>(max_error * 1000));
+  RecordProperty("drop_count", tracker.getDropCount());
+}
+
+TEST(MocapTrackerTest, AngularVelocity)
+{
+  StreamConfig config = {0.002, 0.004, 0.0, 0.0, 0.0};
+  std::vector<MocapFrame> frames = generate(config, 4);
+
+  MocapTracker tracker;
+  double sum = 0;
+  int count = 0;
+  for(const auto& frame : frames)
+    {
+      MocapTracker::Result result = tracker.add(frame);
+      if(!result.vel_valid || result.stamp < 1.0) continue;
+      sum += (result.omega - truth(result.stamp).omega).squaredNorm();
+      count++;
+    }
+  double error = sqrt(sum / count);
+  EXPECT_LT(error, 0.01); // [rad/s]
+  RecordProperty("omega_rms_mrad_s", static_cast<int>(error * 1000));
+}
+
+TEST(MocapTrackerTest, Latency)
+{
+  /* 4ms + exponential 6ms of the transport */
+  StreamConfig config = {0.0005, 0.004, 0.006, 0.0, 0.0};
+  std::vector<MocapFrame> frames = generate(config, 5);
+
+  MocapTracker tracker;
+  double latency_sum = 0, compensated_sum = 0, arrival_sum = 0;
+  int count = 0;
+  for(const auto& frame : frames)
+    {
+      MocapTracker::Result result = tracker.add(frame);
+      if(result.status != MocapTracker::NEW || result.stamp < 1.0) continue;
+
+      /* the position at the arrival: the frame as it is, or extrapolated from the capture time */
+      Eigen::Vector3d truth_pos = truth(frame.receive_stamp).pos;
+      arrival_sum += (result.pos - truth_pos).squaredNorm();
+      compensated_sum += (result.pos + result.vel * result.latency - truth_pos).squaredNorm();
+      latency_sum += result.latency;
+      count++;
+    }
+
+  EXPECT_NEAR(tracker.getLatency(), latency_sum / count, 0.004); // mean over the short history
+  EXPECT_NEAR(latency_sum / count, 0.010, 0.003); // the late frames are reordered and skipped
+  EXPECT_GE(tracker.getMaxLatency(), tracker.getLatency());
+
+  double arrival_error = sqrt(arrival_sum / count), compensated_error = sqrt(compensated_sum / count);
+  EXPECT_LT(compensated_error, 0.1 * arrival_error);
+  RecordProperty("arrival_pos_rms_um", static_cast<int>(arrival_error * 1e6));
+  RecordProperty("compensated_pos_rms_um", static_cast<int>(compensated_error * 1e6));
+}
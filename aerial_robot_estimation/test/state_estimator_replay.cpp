@@ -0,0 +1,483 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: deterministic replay of recorded sensor streams to StateEstimator and its sensor plugins.
+       The messages are published in the timestamp order with the simulated time (ros::Time::setNow),
+       and the global callback queue is drained after each message, so the result does not depend on the wall clock.
+       The estimated states of baselink and CoG are compared with the reference track,
+       and the RMSE / max error tables and the cpu time per callback are reported.
+
+       dataset (~dataset):
+       - csv: "stamp,type,topic,values..." generated by estimator_replay/generate_dataset.py
+         imu: acc[3], gyro[3], angles[3] (, mag[3]) as spinal/Imu
+         pose: position[3], quaternion[4] as geometry_msgs/PoseStamped
+         range: range, min_range, max_range as sensor_msgs/Range
+         odom: position[3], quaternion[4], linear velocity[3], angular velocity[3] as nav_msgs/Odometry
+         reference: baselink position[3], velocity[3] in world frame, rpy[3], angular velocity[3] in baselink frame
+       - rosbag: all topics are replayed with the record time, except ~reference_topic (nav_msgs/Odometry)
+
+       thresholds (negative value to skip):
+       - ~<egomotion|experiment>/<cog|baselink>/<rms|max>_threshold: [pos_xy, pos_z, vel_xy, vel_z, roll_pitch, yaw]
+       - ~latency_threshold/<topic>: average cpu time per callback [sec]
+*/
+
+#include <aerial_robot_estimation/state_estimation.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <gtest/gtest.h>
+#include <nav_msgs/Odometry.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Range.h>
+#include <spinal/Imu.h>
+#include <tf_conversions/tf_kdl.h>
+#include <topic_tools/shape_shifter.h>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <time.h>
+
+namespace
+{
+  enum Metric {POS_XY, POS_Z, VEL_XY, VEL_Z, ROLL_PITCH, YAW, METRIC_NUM};
+  const char* METRIC_NAMES[METRIC_NUM] = {"pos_xy", "pos_z", "vel_xy", "vel_z", "roll_pitch", "yaw"};
+  const char* MODE_NAMES[2] = {"egomotion", "experiment"};
+  const char* FRAME_NAMES[2] = {"cog", "baselink"};
+
+  struct Reference
+  {
+    tf::Vector3 pos; // world frame
+    tf::Vector3 vel; // world frame
+    tf::Matrix3x3 rot;
+    tf::Vector3 omega; // baselink frame
+  };
+
+  struct Record
+  {
+    ros::Time stamp;
+    std::string topic;
+    std::function<void()> publish; // empty for the reference
+    Reference reference;
+  };
+
+  struct ErrorStat
+  {
+    double sum_sq[METRIC_NUM] = {};
+    double max[METRIC_NUM] = {};
+    int samples = 0;
+
+    void add(const double (&err)[METRIC_NUM])
+    {
+      for(int i = 0; i < METRIC_NUM; i++)
+        {
+          sum_sq[i] += err[i] * err[i];
+          max[i] = std::max(max[i], fabs(err[i]));
+        }
+      samples++;
+    }
+
+    double rms(int i) const { return samples > 0 ? sqrt(sum_sq[i] / samples): 0; }
+  };
+
+  struct CpuTime
+  {
+    double total = 0;
+    double max = 0;
+    int count = 0;
+
+    double mean() const { return count > 0 ? total / count: 0; }
+  };
+
+  double threadCpuTime()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  double wrapAngle(double angle)
+  {
+    return atan2(sin(angle), cos(angle));
+  }
+
+  class Dataset
+  {
+  public:
+    Dataset(ros::NodeHandle nh): nh_(nh) {}
+
+    bool load(const std::string& file, const std::string& reference_topic)
+    {
+      bool ret = false;
+      if(file.size() > 4 && file.substr(file.size() - 4) == ".bag") ret = loadBag(file, reference_topic);
+      else ret = loadCsv(file);
+      if(!ret) return false;
+
+      /* the reference after the sensor messages with the same stamp */
+      std::stable_sort(records_.begin(), records_.end(), [](const Record& a, const Record& b)
+                       {
+                         if(a.stamp != b.stamp) return a.stamp < b.stamp;
+                         return a.publish && !b.publish;
+                       });
+      return !records_.empty();
+    }
+
+    const std::vector<Record>& records() const { return records_; }
+
+  private:
+    ros::NodeHandle nh_;
+    std::map<std::string, ros::Publisher> publishers_;
+    std::vector<Record> records_;
+
+    template<class T> ros::Publisher& advertise(const std::string& topic)
+    {
+      auto it = publishers_.find(topic);
+      if(it == publishers_.end()) it = publishers_.emplace(topic, nh_.advertise<T>(topic, 10)).first;
+      return it->second;
+    }
+
+    template<class T> void addMessage(const ros::Time& stamp, const std::string& topic, const boost::shared_ptr<T>& msg)
+    {
+      ros::Publisher pub = advertise<T>(topic);
+      Record record;
+      record.stamp = stamp;
+      record.topic = topic;
+      record.publish = [pub, msg]() { pub.publish(msg); };
+      records_.push_back(record);
+    }
+
+    void addReference(const ros::Time& stamp, const Reference& reference)
+    {
+      Record record;
+      record.stamp = stamp;
+      record.reference = reference;
+      records_.push_back(record);
+    }
+
+    bool loadCsv(const std::string& file)
+    {
+      std::ifstream ifs(file);
+      if(!ifs) return false;
+
+      std::string line;
+      int line_num = 0;
+      while(std::getline(ifs, line))
+        {
+          line_num++;
+          if(line.empty() || line[0] == '#') continue;
+
+          std::vector<std::string> cols;
+          std::stringstream ss(line);
+          std::string col;
+          while(std::getline(ss, col, ',')) cols.push_back(col);
+          if(cols.size() < 3)
+            {
+              ROS_ERROR("%s:%d: too few columns", file.c_str(), line_num);
+              return false;
+            }
+
+          std::vector<double> v;
+          for(size_t i = 3; i < cols.size(); i++) v.push_back(std::stod(cols.at(i)));
+
+          ros::Time stamp(std::stod(cols.at(0)));
+          const std::string& type = cols.at(1);
+          const std::string& topic = cols.at(2);
+
+          if(type == "imu" && v.size() >= 9)
+            {
+              boost::shared_ptr<spinal::Imu> msg(new spinal::Imu);
+              msg->stamp = stamp;
+              for(int i = 0; i < 3; i++)
+                {
+                  msg->acc_data[i] = v.at(i);
+                  msg->gyro_data[i] = v.at(3 + i);
+                  msg->angles[i] = v.at(6 + i);
+                  if(v.size() >= 12) msg->mag_data[i] = v.at(9 + i);
+                }
+              addMessage(stamp, topic, msg);
+            }
+          else if(type == "pose" && v.size() >= 7)
+            {
+              boost::shared_ptr<geometry_msgs::PoseStamped> msg(new geometry_msgs::PoseStamped);
+              msg->header.stamp = stamp;
+              msg->header.frame_id = "world";
+              tf::pointTFToMsg(tf::Vector3(v.at(0), v.at(1), v.at(2)), msg->pose.position);
+              tf::quaternionTFToMsg(tf::Quaternion(v.at(3), v.at(4), v.at(5), v.at(6)), msg->pose.orientation);
+              addMessage(stamp, topic, msg);
+            }
+          else if(type == "range" && v.size() >= 3)
+            {
+              boost::shared_ptr<sensor_msgs::Range> msg(new sensor_msgs::Range);
+              msg->header.stamp = stamp;
+              msg->range = v.at(0);
+              msg->min_range = v.at(1);
+              msg->max_range = v.at(2);
+              addMessage(stamp, topic, msg);
+            }
+          else if(type == "odom" && v.size() >= 13)
+            {
+              boost::shared_ptr<nav_msgs::Odometry> msg(new nav_msgs::Odometry);
+              msg->header.stamp = stamp;
+              msg->header.frame_id = "world";
+              tf::pointTFToMsg(tf::Vector3(v.at(0), v.at(1), v.at(2)), msg->pose.pose.position);
+              tf::quaternionTFToMsg(tf::Quaternion(v.at(3), v.at(4), v.at(5), v.at(6)), msg->pose.pose.orientation);
+              tf::vector3TFToMsg(tf::Vector3(v.at(7), v.at(8), v.at(9)), msg->twist.twist.linear);
+              tf::vector3TFToMsg(tf::Vector3(v.at(10), v.at(11), v.at(12)), msg->twist.twist.angular);
+              addMessage(stamp, topic, msg);
+            }
+          else if(type == "reference" && v.size() >= 12)
+            {
+              Reference reference;
+              reference.pos.setValue(v.at(0), v.at(1), v.at(2));
+              reference.vel.setValue(v.at(3), v.at(4), v.at(5));
+              reference.rot.setRPY(v.at(6), v.at(7), v.at(8));
+              reference.omega.setValue(v.at(9), v.at(10), v.at(11));
+              addReference(stamp, reference);
+            }
+          else
+            {
+              ROS_ERROR("%s:%d: invalid row of type %s", file.c_str(), line_num, type.c_str());
+              return false;
+            }
+        }
+      return true;
+    }
+
+    bool loadBag(const std::string& file, const std::string& reference_topic)
+    {
+      rosbag::Bag bag;
+      try
+        {
+          bag.open(file, rosbag::bagmode::Read);
+        }
+      catch(rosbag::BagException& e)
+        {
+          ROS_ERROR("can not open %s: %s", file.c_str(), e.what());
+          return false;
+        }
+
+      rosbag::View view(bag);
+      for(const rosbag::MessageInstance& m: view)
+        {
+          if(m.getTopic() == reference_topic)
+            {
+              nav_msgs::OdometryConstPtr odom = m.instantiate<nav_msgs::Odometry>();
+              if(!odom) continue;
+              Reference reference;
+              tf::pointMsgToTF(odom->pose.pose.position, reference.pos);
+              tf::vector3MsgToTF(odom->twist.twist.linear, reference.vel); // world frame, same as the ground truth of mocap
+              tf::Quaternion q;
+              tf::quaternionMsgToTF(odom->pose.pose.orientation, q);
+              reference.rot.setRotation(q);
+              tf::vector3MsgToTF(odom->twist.twist.angular, reference.omega);
+              addReference(m.getTime(), reference);
+              continue;
+            }
+
+          topic_tools::ShapeShifter::ConstPtr msg = m.instantiate<topic_tools::ShapeShifter>();
+          auto it = publishers_.find(m.getTopic());
+          if(it == publishers_.end())
+            it = publishers_.emplace(m.getTopic(), msg->advertise(nh_, m.getTopic(), 10)).first;
+          ros::Publisher pub = it->second;
+
+          Record record;
+          record.stamp = m.getTime();
+          record.topic = m.getTopic();
+          record.publish = [pub, msg]() { pub.publish(msg); };
+          records_.push_back(record);
+        }
+      return true;
+    }
+  };
+
+  /* the reference of CoG, in the same manner as sensor_plugin::Imu */
+  void errors(const array<AxisState, State::TOTAL_NUM>& states, int mode, int frame,
+              const Reference& reference, const tf::Transform& cog2baselink, double (&err)[METRIC_NUM])
+  {
+    tf::Vector3 pos = reference.pos;
+    tf::Vector3 vel = reference.vel;
+    tf::Matrix3x3 rot = reference.rot;
+    if(frame == Frame::COG)
+      {
+        tf::Transform baselink2cog = cog2baselink.inverse();
+        pos += reference.rot * baselink2cog.getOrigin();
+        vel += reference.rot * reference.omega.cross(baselink2cog.getOrigin());
+        rot *= baselink2cog.getBasis();
+      }
+    tfScalar r, p, y;
+    rot.getRPY(r, p, y);
+
+    tf::Vector3 est_pos, est_vel, est_rpy;
+    for(int i = 0; i < 3; i++)
+      {
+        est_pos[i] = states.at(State::X_COG + frame * 3 + i)[mode].second[0];
+        est_vel[i] = states.at(State::X_COG + frame * 3 + i)[mode].second[1];
+        est_rpy[i] = states.at(State::ROLL_COG + frame * 3 + i)[mode].second[0];
+      }
+
+    err[POS_XY] = hypot(est_pos.x() - pos.x(), est_pos.y() - pos.y());
+    err[POS_Z] = est_pos.z() - pos.z();
+    err[VEL_XY] = hypot(est_vel.x() - vel.x(), est_vel.y() - vel.y());
+    err[VEL_Z] = est_vel.z() - vel.z();
+    err[ROLL_PITCH] = hypot(wrapAngle(est_rpy.x() - r), wrapAngle(est_rpy.y() - p));
+    err[YAW] = wrapAngle(est_rpy.z() - y);
+  }
+
+  void printTable(const std::string& title, const ErrorStat (&stats)[2][2], bool rms)
+  {
+    printf("\n%s\n%10s %9s |", title.c_str(), "mode", "frame");
+    for(int i = 0; i < METRIC_NUM; i++) printf(" %10s", METRIC_NAMES[i]);
+    printf("\n");
+    for(int mode = 0; mode < 2; mode++)
+      {
+        for(int frame = 0; frame < 2; frame++)
+          {
+            printf("%10s %9s |", MODE_NAMES[mode], FRAME_NAMES[frame]);
+            for(int i = 0; i < METRIC_NUM; i++)
+              printf(" %10.5f", rms ? stats[mode][frame].rms(i): stats[mode][frame].max[i]);
+            printf("\n");
+          }
+      }
+  }
+}
+
+TEST(StateEstimatorReplay, Dataset)
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle nhp("~");
+
+  std::string file, reference_topic;
+  double settle;
+  ASSERT_TRUE(nhp.getParam("dataset", file)) << "no dataset is given";
+  nhp.param("reference_topic", reference_topic, std::string("reference"));
+  nhp.param("settle", settle, 0.0); // [sec] from the beginning of the dataset, e.g. imu calibration
+
+  Dataset dataset(nh);
+  ASSERT_TRUE(dataset.load(file, reference_topic)) << "can not load " << file;
+  const std::vector<Record>& records = dataset.records();
+  ros::Time start = records.front().stamp;
+
+  /* the sensor plugins take the time of the dataset from the beginning */
+  ros::Time::setNow(start);
+  boost::shared_ptr<aerial_robot_model::RobotModel> robot_model(new aerial_robot_model::RobotModel());
+  boost::shared_ptr<aerial_robot_estimation::StateEstimator> estimator(new aerial_robot_estimation::StateEstimator());
+  estimator->initialize(nh, nhp, robot_model);
+  ros::getGlobalCallbackQueue()->callAvailable();
+
+  tf::Transform cog2baselink;
+  tf::transformKDLToTF(robot_model->getCog2Baselink<KDL::Frame>(), cog2baselink);
+
+  ErrorStat stats[2][2];
+  std::map<std::string, CpuTime> cpu_times;
+
+  for(const auto& record: records)
+    {
+      ros::Time::setNow(record.stamp);
+
+      if(record.publish)
+        {
+          record.publish();
+          double cpu_start = threadCpuTime();
+          ros::getGlobalCallbackQueue()->callAvailable();
+          double cpu_time = threadCpuTime() - cpu_start;
+
+          CpuTime& t = cpu_times[record.topic];
+          t.total += cpu_time;
+          t.max = std::max(t.max, cpu_time);
+          t.count++;
+          continue;
+        }
+
+      if((record.stamp - start).toSec() < settle) continue;
+
+      array<AxisState, State::TOTAL_NUM> states = estimator->getStates();
+      for(int mode = 0; mode < 2; mode++)
+        {
+          for(int frame = 0; frame < 2; frame++)
+            {
+              double err[METRIC_NUM];
+              errors(states, mode, frame, record.reference, cog2baselink, err);
+              stats[mode][frame].add(err);
+            }
+        }
+    }
+
+  printf("\n%s: %lu records, %d reference samples after %.1f [sec]\n", file.c_str(),
+         records.size(), stats[0][0].samples, settle);
+  printTable("RMSE [m, m/s, rad]", stats, true);
+  printTable("max error [m, m/s, rad]", stats, false);
+  printf("\n%20s | %8s %12s %12s\n", "topic", "count", "mean [us]", "max [us]");
+  for(const auto& t: cpu_times)
+    printf("%20s | %8d %12.2f %12.2f\n", t.first.c_str(), t.second.count, t.second.mean() * 1e6, t.second.max * 1e6);
+
+  ASSERT_GT(stats[0][0].samples, 0);
+
+  for(int mode = 0; mode < 2; mode++)
+    {
+      for(int frame = 0; frame < 2; frame++)
+        {
+          std::string ns = std::string(MODE_NAMES[mode]) + "/" + FRAME_NAMES[frame] + "/";
+          std::vector<double> rms_threshold, max_threshold;
+          nhp.getParam(ns + "rms_threshold", rms_threshold);
+          nhp.getParam(ns + "max_threshold", max_threshold);
+
+          for(int i = 0; i < METRIC_NUM; i++)
+            {
+              if((size_t)i < rms_threshold.size() && rms_threshold.at(i) >= 0)
+                EXPECT_LT(stats[mode][frame].rms(i), rms_threshold.at(i)) << ns << METRIC_NAMES[i];
+              if((size_t)i < max_threshold.size() && max_threshold.at(i) >= 0)
+                EXPECT_LT(stats[mode][frame].max[i], max_threshold.at(i)) << ns << METRIC_NAMES[i];
+            }
+        }
+    }
+
+  for(const auto& t: cpu_times)
+    {
+      std::string topic = t.first;
+      if(!topic.empty() && topic[0] == '/') topic = topic.substr(1);
+      double threshold;
+      if(nhp.getParam("latency_threshold/" + topic, threshold))
+        EXPECT_LT(t.second.mean(), threshold) << topic;
+    }
+
+  /* the update thread of the estimator waits for the simulated time, which is not advanced anymore */
+  ros::shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "state_estimator_replay");
+  return RUN_ALL_TESTS();
+}
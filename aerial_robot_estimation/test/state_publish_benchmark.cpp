@@ -0,0 +1,262 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: micro benchmark of StateEstimator::statePublish.
+       The current implementation (one snapshot of all axes, preallocated messages) and the previous one
+       (fresh messages with the string ids and one state lock per accessor) fill and publish the same states,
+       and the average time per cycle is reported. There is no subscriber, so the serialization is not included.
+*/
+
+#include <aerial_robot_estimation/state_estimation.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+  class StatePublishReplay : public aerial_robot_estimation::StateEstimator
+  {
+  public:
+    virtual void publish() { statePublish(); }
+    virtual const aerial_robot_msgs::States& fullState() const { return full_state_msg_; }
+    virtual const nav_msgs::Odometry& baselinkOdom() const { return baselink_odom_msg_; }
+    virtual const nav_msgs::Odometry& cogOdom() const { return cog_odom_msg_; }
+  };
+
+  /* the previous implementation, for reference */
+  class LegacyStatePublish : public StatePublishReplay
+  {
+  public:
+    void publish() override
+    {
+      aerial_robot_msgs::States full_state;
+      full_state.header.stamp = ros::Time::now();
+
+      for(int axis = 0; axis < State::TOTAL_NUM; axis++)
+        {
+          aerial_robot_msgs::State r_state;
+          AxisState state = getState(axis);
+
+          switch(axis)
+            {
+            case State::X_COG:
+              r_state.id = "x_cog";
+              break;
+            case State::Y_COG:
+              r_state.id = "y_cog";
+              break;
+            case State::Z_COG:
+              r_state.id = "z_cog";
+              break;
+            case State::X_BASE:
+              r_state.id = "x_b";
+              break;
+            case State::Y_BASE:
+              r_state.id = "y_b";
+              break;
+            case State::Z_BASE:
+              r_state.id = "z_b";
+              break;
+            case State::ROLL_COG:
+              r_state.id = "roll_cog";
+              break;
+            case State::PITCH_COG:
+              r_state.id = "pitch_cog";
+              break;
+            case State::YAW_COG:
+              r_state.id = "yaw_cog";
+              break;
+            case State::ROLL_BASE:
+              r_state.id = "roll_b";
+              break;
+            case State::PITCH_BASE:
+              r_state.id = "pitch_b";
+              break;
+            case State::YAW_BASE:
+              r_state.id = "yaw_b";
+              break;
+            default:
+              break;
+            }
+          r_state.state.resize(3);
+          for(int mode = 0; mode < 3; mode++)
+            tf::vector3TFToMsg(state[mode].second, r_state.state[mode]);
+
+          full_state.states.push_back(r_state);
+        }
+      full_state_pub_.publish(full_state);
+      legacy_full_state_ = full_state;
+
+      nav_msgs::Odometry odom_state;
+      odom_state.header.stamp = ros::Time::now();
+      odom_state.header.frame_id = std::string("/world");
+
+      /* Baselink */
+      /* Rotation */
+      tf::Quaternion q; getOrientation(Frame::BASELINK, estimate_mode_).getRotation(q);
+      tf::quaternionTFToMsg(q, odom_state.pose.pose.orientation);
+      tf::vector3TFToMsg(getAngularVel(Frame::BASELINK, estimate_mode_), odom_state.twist.twist.angular);
+
+      /* Translation */
+      odom_state.child_frame_id = tf::resolve(tf_prefix_, robot_model_->getBaselinkName());
+      tf::pointTFToMsg(getPos(Frame::BASELINK, estimate_mode_), odom_state.pose.pose.position);
+      tf::vector3TFToMsg(getVel(Frame::BASELINK, estimate_mode_), odom_state.twist.twist.linear);
+      baselink_odom_pub_.publish(odom_state);
+      legacy_baselink_odom_ = odom_state;
+
+      /* TF broadcast from world frame */
+      tf::Transform root2baselink_tf;
+      const auto segments_tf = robot_model_->getSegmentsTf();
+      if(segments_tf.size() > 0) // kinemtiacs is initialized
+        tf::transformKDLToTF(segments_tf.at(robot_model_->getBaselinkName()), root2baselink_tf);
+      else
+        root2baselink_tf.setIdentity(); // not initialized
+
+      tf::Transform world2baselink_tf;
+      tf::poseMsgToTF(odom_state.pose.pose, world2baselink_tf);
+      br_.sendTransform(tf::StampedTransform(world2baselink_tf * root2baselink_tf.inverse(), ros::Time::now(), "world", tf::resolve(tf_prefix_, std::string("root"))));
+
+      /* COG */
+      /* Rotation */
+      getOrientation(Frame::COG, estimate_mode_).getRotation(q);
+      tf::quaternionTFToMsg(q, odom_state.pose.pose.orientation);
+      tf::vector3TFToMsg(getAngularVel(Frame::COG, estimate_mode_), odom_state.twist.twist.angular);
+      /* Translation */
+      odom_state.child_frame_id = tf::resolve(tf_prefix_, std::string("cog"));
+      tf::pointTFToMsg(getPos(Frame::COG, estimate_mode_), odom_state.pose.pose.position);
+      tf::vector3TFToMsg(getVel(Frame::COG, estimate_mode_), odom_state.twist.twist.linear);
+      cog_odom_pub_.publish(odom_state);
+      legacy_cog_odom_ = odom_state;
+    }
+
+    const aerial_robot_msgs::States& fullState() const override { return legacy_full_state_; }
+    const nav_msgs::Odometry& baselinkOdom() const override { return legacy_baselink_odom_; }
+    const nav_msgs::Odometry& cogOdom() const override { return legacy_cog_odom_; }
+
+  private:
+    aerial_robot_msgs::States legacy_full_state_;
+    nav_msgs::Odometry legacy_baselink_odom_, legacy_cog_odom_;
+  };
+
+  void setStates(StatePublishReplay& estimator)
+  {
+    for(int axis = 0; axis < State::TOTAL_NUM; axis++)
+      {
+        for(int mode = 0; mode < 3; mode++)
+          estimator.setState(axis, mode, tf::Vector3(0.1 * axis + 0.01 * mode, -0.2 * axis, 0.05 * mode));
+      }
+  }
+
+  double benchmark(StatePublishReplay& estimator, int iteration)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    for(int i = 0; i < iteration; i++) estimator.publish();
+    return (ros::WallTime::now() - start).toNSec() / (double)iteration;
+  }
+
+  void expectEqual(const nav_msgs::Odometry& odom, const nav_msgs::Odometry& legacy_odom)
+  {
+    EXPECT_EQ(odom.header.frame_id, legacy_odom.header.frame_id);
+    EXPECT_EQ(odom.child_frame_id, legacy_odom.child_frame_id);
+    EXPECT_DOUBLE_EQ(odom.pose.pose.position.x, legacy_odom.pose.pose.position.x);
+    EXPECT_DOUBLE_EQ(odom.pose.pose.position.y, legacy_odom.pose.pose.position.y);
+    EXPECT_DOUBLE_EQ(odom.pose.pose.position.z, legacy_odom.pose.pose.position.z);
+    EXPECT_NEAR(odom.pose.pose.orientation.x, legacy_odom.pose.pose.orientation.x, 1e-9);
+    EXPECT_NEAR(odom.pose.pose.orientation.y, legacy_odom.pose.pose.orientation.y, 1e-9);
+    EXPECT_NEAR(odom.pose.pose.orientation.z, legacy_odom.pose.pose.orientation.z, 1e-9);
+    EXPECT_NEAR(odom.pose.pose.orientation.w, legacy_odom.pose.pose.orientation.w, 1e-9);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.linear.x, legacy_odom.twist.twist.linear.x);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.linear.y, legacy_odom.twist.twist.linear.y);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.linear.z, legacy_odom.twist.twist.linear.z);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.angular.x, legacy_odom.twist.twist.angular.x);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.angular.y, legacy_odom.twist.twist.angular.y);
+    EXPECT_DOUBLE_EQ(odom.twist.twist.angular.z, legacy_odom.twist.twist.angular.z);
+  }
+}
+
+TEST(StatePublishBenchmark, Publish)
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle nhp("~");
+  int iteration;
+  nhp.param("iteration", iteration, 10000);
+
+  boost::shared_ptr<aerial_robot_model::RobotModel> robot_model(new aerial_robot_model::RobotModel());
+
+  boost::shared_ptr<LegacyStatePublish> legacy_estimator(new LegacyStatePublish());
+  legacy_estimator->initialize(nh, nhp, robot_model);
+  setStates(*legacy_estimator);
+
+  boost::shared_ptr<StatePublishReplay> estimator(new StatePublishReplay());
+  estimator->initialize(nh, nhp, robot_model);
+  setStates(*estimator);
+
+  /* wait for the first cycle of the update threads, which run at a low rate (estimation/update_rate) in this test */
+  ros::WallDuration(0.1).sleep();
+
+  double legacy_ns = benchmark(*legacy_estimator, iteration);
+  double ns = benchmark(*estimator, iteration);
+
+  ROS_INFO("state publish: %f [ns/cycle] (previous: %f [ns/cycle]) in %d cycles", ns, legacy_ns, iteration);
+
+  /* same messages */
+  estimator->publish();
+  legacy_estimator->publish();
+  expectEqual(estimator->baselinkOdom(), legacy_estimator->baselinkOdom());
+  expectEqual(estimator->cogOdom(), legacy_estimator->cogOdom());
+
+  const aerial_robot_msgs::States& full_state = estimator->fullState();
+  const aerial_robot_msgs::States& legacy_full_state = legacy_estimator->fullState();
+  ASSERT_EQ(full_state.states.size(), legacy_full_state.states.size());
+  for(size_t axis = 0; axis < full_state.states.size(); axis++)
+    {
+      EXPECT_EQ(full_state.states[axis].id, legacy_full_state.states[axis].id);
+      ASSERT_EQ(full_state.states[axis].state.size(), legacy_full_state.states[axis].state.size());
+      for(size_t mode = 0; mode < full_state.states[axis].state.size(); mode++)
+        {
+          EXPECT_DOUBLE_EQ(full_state.states[axis].state[mode].x, legacy_full_state.states[axis].state[mode].x);
+          EXPECT_DOUBLE_EQ(full_state.states[axis].state[mode].y, legacy_full_state.states[axis].state[mode].y);
+          EXPECT_DOUBLE_EQ(full_state.states[axis].state[mode].z, legacy_full_state.states[axis].state[mode].z);
+        }
+    }
+
+  /* stop the update threads of the estimators */
+  ros::shutdown();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "state_publish_benchmark");
+  return RUN_ALL_TESTS();
+}
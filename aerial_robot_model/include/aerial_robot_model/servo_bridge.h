@@ -59,6 +59,7 @@
 
 /* util */
 #include <string>
+#include <unordered_map>
 #include <boost/algorithm/clamp.hpp>
 
 using namespace std;
@@ -188,6 +189,14 @@ private:
 using SingleServoHandlePtr= boost::shared_ptr<SingleServoHandle>;
 using ServoGroupHandler= vector<SingleServoHandlePtr>;
 
+/* built once at load time, the callbacks only look up and update in place */
+struct ServoGroupIndex
+{
+  vector<int> id_to_index; // servo id -> index in the group handler, -1 if not assigned
+  unordered_map<string, int> name_to_index; // joint name -> index in the group handler
+  spinal::ServoControlCmd ctrl_msg; // reserved for all the servos in the group
+};
+
 class ServoBridge
 {
 protected:
@@ -203,6 +212,8 @@ protected:
   map<string, vector<ros::Publisher> > servo_ctrl_sim_pubs_; // TODO: should be actionlib, trajectory controller
 
   map<string, ServoGroupHandler> servos_handler_;
+  map<string, ServoGroupIndex> servos_index_;
+  sensor_msgs::JointState servo_states_msg_; // all the groups in the order of servos_handler_
   double moving_check_rate_;
   double moving_angle_thresh_;
   bool send_init_joint_pose_;
@@ -212,6 +223,7 @@ protected:
   void servoStatesCallback(const spinal::ServoStatesConstPtr& state_msg, const std::string& servo_group_name);
   void servoCtrlCallback(const sensor_msgs::JointStateConstPtr& joints_ctrl_msg, const std::string& servo_group_name);
   bool servoTorqueCtrlCallback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res, const std::string& servo_group_name);
+  void buildServoIndex(const std::string& servo_group_name);
 
 public:
   ServoBridge(ros::NodeHandle nh, ros::NodeHandle nhp);
@@ -157,6 +157,7 @@ ServoBridge::ServoBridge(ros::NodeHandle nh, ros::NodeHandle nhp): nh_(nh),nhp_(
         }
 
       servos_handler_.insert(make_pair(servo_group_params.first, servo_group_handler));
+      buildServoIndex(servo_group_params.first);
 
       /* ros pub/sub, service */
       /* Get servo states (i.e. joint angles) from real machine, if necessary */
@@ -179,96 +180,137 @@ ServoBridge::ServoBridge(ros::NodeHandle nh, ros::NodeHandle nhp): nh_(nh),nhp_(
   if(!simulation_mode_) servo_states_pub_ = nh_.advertise<sensor_msgs::JointState>("joint_states", 1);
 }
 
+void ServoBridge::buildServoIndex(const string& servo_group_name)
+{
+  ServoGroupIndex& group_index = servos_index_[servo_group_name];
+  const ServoGroupHandler& servos = servos_handler_.at(servo_group_name);
+
+  int max_id = -1;
+  for(const auto& servo_handler : servos) max_id = std::max(max_id, servo_handler->getId());
+  group_index.id_to_index.assign(max_id + 1, -1);
+  group_index.name_to_index.clear();
+
+  for(int i = 0; i < servos.size(); i++)
+    {
+      if(servos.at(i)->getId() < 0)
+        ROS_ERROR("[servo bridge]: invalid servo id %d for %s", servos.at(i)->getId(), servos.at(i)->getName().c_str());
+      else
+        group_index.id_to_index.at(servos.at(i)->getId()) = i;
+      group_index.name_to_index[servos.at(i)->getName()] = i;
+    }
+
+  group_index.ctrl_msg.index.reserve(servos.size());
+  group_index.ctrl_msg.angles.reserve(servos.size());
+
+  /* joint states of all the groups in the order of servos_handler_ */
+  servo_states_msg_.name.clear();
+  for(const auto& servo_group : servos_handler_)
+    for(const auto& servo_handler : servo_group.second)
+      servo_states_msg_.name.push_back(servo_handler->getName());
+  servo_states_msg_.position.resize(servo_states_msg_.name.size());
+  servo_states_msg_.effort.resize(servo_states_msg_.name.size());
+}
+
 void ServoBridge::servoStatesCallback(const spinal::ServoStatesConstPtr& state_msg, const string& servo_group_name)
 {
-  if(state_msg->servos.size() != servos_handler_[servo_group_name].size())
+  ServoGroupHandler& servos = servos_handler_[servo_group_name];
+  const vector<int>& id_to_index = servos_index_[servo_group_name].id_to_index;
+
+  if(state_msg->servos.size() != servos.size())
     {
-      ROS_ERROR("[servo bridge, servo state callback]: the joint num from rosparam %d is not equal with ros msgs %d", (int)servos_handler_[servo_group_name].size(), (int)state_msg->servos.size());
+      ROS_ERROR("[servo bridge, servo state callback]: the joint num from rosparam %d is not equal with ros msgs %d", (int)servos.size(), (int)state_msg->servos.size());
       return;
     }
 
-  for(auto it: state_msg->servos)
+  for(const auto& it: state_msg->servos)
     {
-      auto servo_handler = find_if(servos_handler_[servo_group_name].begin(),
-                                   servos_handler_[servo_group_name].end(),
-                                   [&](SingleServoHandlePtr s) {return it.index == s->getId();} );
-
-      if(servo_handler == servos_handler_[servo_group_name].end())
+      int index = (it.index < id_to_index.size())?id_to_index[it.index]:-1;
+      if(index < 0)
         {
           ROS_ERROR("[servo bridge, servo state callback]: no matching joint handler for servo index %d", it.index);
           return;
         }
-      (*servo_handler)->setCurrAngleVal((double)it.angle, ValueType::BIT); // angle (position)
-      (*servo_handler)->setCurrTorqueVal((double)it.load); // torque (effort)
+      const SingleServoHandlePtr& servo_handler = servos[index];
+      servo_handler->setCurrAngleVal((double)it.angle, ValueType::BIT); // angle (position)
+      servo_handler->setCurrTorqueVal((double)it.load); // torque (effort)
     }
 
-  sensor_msgs::JointState servo_states_msg;
-  servo_states_msg.header.stamp = state_msg->stamp;
-
-  for(auto servo_group : servos_handler_)
+  /* the names are assigned at load time */
+  servo_states_msg_.header.stamp = state_msg->stamp;
+  int i = 0;
+  for(const auto& servo_group : servos_handler_)
     {
-      for(auto servo_handler: servo_group.second)
+      for(const auto& servo_handler: servo_group.second)
         {
-          servo_states_msg.name.push_back(servo_handler->getName());
-          servo_states_msg.position.push_back(servo_handler->getCurrAngleVal(ValueType::RADIAN));
-          servo_states_msg.effort.push_back(servo_handler->getCurrTorqueVal());
+          servo_states_msg_.position[i] = servo_handler->getCurrAngleVal(ValueType::RADIAN);
+          servo_states_msg_.effort[i] = servo_handler->getCurrTorqueVal();
+          i++;
         }
     }
-  servo_states_pub_.publish(servo_states_msg);
+  servo_states_pub_.publish(servo_states_msg_);
 }
 
 void ServoBridge::servoCtrlCallback(const sensor_msgs::JointStateConstPtr& servo_ctrl_msg, const string& servo_group_name)
 {
-  spinal::ServoControlCmd target_angle_msg;
+  ServoGroupHandler& servos = servos_handler_[servo_group_name];
+  ServoGroupIndex& group_index = servos_index_[servo_group_name];
+  spinal::ServoControlCmd& target_angle_msg = group_index.ctrl_msg;
+  target_angle_msg.index.clear();
+  target_angle_msg.angles.clear();
 
   if(servo_ctrl_msg->name.size() > 0)
     {
+      if(servo_ctrl_msg->position.size() !=  servo_ctrl_msg->name.size())
+        {
+          ROS_ERROR("[servo bridge, servo control control]: the servo position num and name num are different in ros msgs [%d vs %d]",
+                    (int)servo_ctrl_msg->position.size(), (int)servo_ctrl_msg->name.size());
+          return;
+        }
+
       for(int i = 0; i < servo_ctrl_msg->name.size(); i++)
         {/* servo name is assigned */
 
-          if(servo_ctrl_msg->position.size() !=  servo_ctrl_msg->name.size())
+          /* the names are usually in the predefined order, otherwise use the index of the name */
+          const string& name = servo_ctrl_msg->name[i];
+          int index = i;
+          if(i >= servos.size() || servos[i]->getName() != name)
             {
-              ROS_ERROR("[servo bridge, servo control control]: the servo position num and name num are different in ros msgs [%d vs %d]",
-                        (int)servo_ctrl_msg->position.size(), (int)servo_ctrl_msg->name.size());
-              return;
+              auto it = group_index.name_to_index.find(name);
+              if(it == group_index.name_to_index.end())
+                {
+                  ROS_ERROR("[servo bridge, servo control callback]: no matching servo handler for %s", name.c_str());
+                  return;
+                }
+              index = it->second;
             }
 
-          // use servo_name to search the servo_handler
-          auto servo_handler = find_if(servos_handler_[servo_group_name].begin(), servos_handler_[servo_group_name].end(),
-                                       [&](SingleServoHandlePtr s) {return servo_ctrl_msg->name.at(i)  == s->getName();});
-
-          if(servo_handler == servos_handler_[servo_group_name].end())
-          {
-            ROS_ERROR("[servo bridge, servo control callback]: no matching servo handler for %s", servo_ctrl_msg->name.at(i).c_str());
-            return;
-          }
-
-          (*servo_handler)->setTargetAngleVal(servo_ctrl_msg->position[i], ValueType::RADIAN);
-          target_angle_msg.index.push_back((*servo_handler)->getId());
-          target_angle_msg.angles.push_back((*servo_handler)->getTargetAngleVal(ValueType::BIT));
+          const SingleServoHandlePtr& servo_handler = servos[index];
+          servo_handler->setTargetAngleVal(servo_ctrl_msg->position[i], ValueType::RADIAN);
+          target_angle_msg.index.push_back(servo_handler->getId());
+          target_angle_msg.angles.push_back(servo_handler->getTargetAngleVal(ValueType::BIT));
 
           if(simulation_mode_)
             {
               std_msgs::Float64 msg;
               msg.data = servo_ctrl_msg->position[i];
-              servo_ctrl_sim_pubs_[servo_group_name].at(distance(servos_handler_[servo_group_name].begin(), servo_handler)).publish(msg);
+              servo_ctrl_sim_pubs_[servo_group_name].at(index).publish(msg);
             }
         }
     }
   else
     { /* for fast tranmission: no searching process, in the predefine order */
 
-      if(servo_ctrl_msg->position.size() != servos_handler_[servo_group_name].size())
+      if(servo_ctrl_msg->position.size() != servos.size())
         {
           ROS_ERROR("[servo bridge, servo control control]: the joint num from rosparam %d is not equal with ros msgs %d",
-                    (int)servos_handler_[servo_group_name].size(), (int)servo_ctrl_msg->position.size());
+                    (int)servos.size(), (int)servo_ctrl_msg->position.size());
           return;
         }
 
       for(int i = 0; i < servo_ctrl_msg->position.size(); i++)
         {
           /*  use the kinematics order (e.g. joint1 ~ joint N, gimbal_roll -> gimbal_pitch) */
-          SingleServoHandlePtr servo_handler = servos_handler_[servo_group_name].at(i);
+          const SingleServoHandlePtr& servo_handler = servos[i];
           servo_handler->setTargetAngleVal(servo_ctrl_msg->position[i], ValueType::RADIAN);
           target_angle_msg.index.push_back(servo_handler->getId());
           target_angle_msg.angles.push_back(servo_handler->getTargetAngleVal(ValueType::BIT));
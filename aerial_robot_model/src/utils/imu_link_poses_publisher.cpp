@@ -0,0 +1,139 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+  publish the poses of the neuron imus in the board frame of spinal (baselink) to spinal (imu_link_poses),
+  from the joint angles and the kinematic model, for the multi imu fusion on spinal.
+  the i-th frame of ~imu_link_names is the board of the i-th neuron (default: link1, link2, ...).
+  the pose is sent at ~rate on the joint states. spinal drops a pose older than 200 ms, so ~rate is
+  raised to MIN_RATE, and the neuron imus are not fused while the joint states stop.
+*/
+
+#include <aerial_robot_model/transformable_aerial_robot_model.h>
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/JointState.h>
+#include <spinal/ImuLinkPoses.h>
+
+using namespace std;
+
+namespace
+{
+  constexpr double MIN_RATE = 10; // [Hz], twice the pose timeout of spinal
+}
+
+class ImuLinkPosesPublisher {
+public:
+  ImuLinkPosesPublisher(ros::NodeHandle nh, ros::NodeHandle nhp): nh_(nh), nhp_(nhp)
+  {
+    robot_model_ = boost::make_shared<aerial_robot_model::RobotModel>();
+
+    if(!nhp_.getParam("imu_link_names", imu_link_names_))
+      {
+        for(int i = 0; i < robot_model_->getRotorNum(); i++)
+          imu_link_names_.push_back(string("link") + to_string(i + 1));
+      }
+    nhp_.param("rate", rate_, 20.0);
+    if(rate_ < MIN_RATE)
+      {
+        ROS_WARN("imu link poses publisher: rate %f is slower than the pose timeout of spinal, use %f", rate_, MIN_RATE);
+        rate_ = MIN_RATE;
+      }
+
+    /* the root segment is not in the forward kinematics */
+    const auto seg_tf_map = robot_model_->fullForwardKinematics(KDL::JntArray(robot_model_->getTree().getNrOfJoints()));
+    for(const auto& name: imu_link_names_)
+      {
+        if(seg_tf_map.find(name) == seg_tf_map.end() && name != robot_model_->getRootFrameName())
+          ROS_ERROR("imu link poses publisher: no link named %s in the robot model", name.c_str());
+      }
+
+    imu_link_poses_pub_ = nh_.advertise<spinal::ImuLinkPoses>("imu_link_poses", 1);
+    joint_state_sub_ = nh_.subscribe("joint_states", 1, &ImuLinkPosesPublisher::jointStateCallback, this);
+  }
+
+  ~ImuLinkPosesPublisher(){}
+
+private:
+  ros::NodeHandle nh_, nhp_;
+  ros::Publisher imu_link_poses_pub_;
+  ros::Subscriber joint_state_sub_;
+  boost::shared_ptr<aerial_robot_model::RobotModel> robot_model_;
+  vector<string> imu_link_names_;
+  double rate_;
+  ros::Time last_pub_time_;
+
+  KDL::Frame segmentFrame(const std::map<std::string, KDL::Frame>& seg_tf_map, const string& name)
+  {
+    auto itr = seg_tf_map.find(name);
+    if(itr == seg_tf_map.end()) return KDL::Frame::Identity(); // root
+    return itr->second;
+  }
+
+  void jointStateCallback(const sensor_msgs::JointStateConstPtr& state)
+  {
+    ros::Time now = ros::Time::now();
+    if(now.toSec() - last_pub_time_.toSec() < 1 / rate_) return;
+    last_pub_time_ = now;
+
+    const auto seg_tf_map = robot_model_->fullForwardKinematics(*state);
+    KDL::Frame baselink_inv = segmentFrame(seg_tf_map, robot_model_->getBaselinkName()).Inverse();
+
+    spinal::ImuLinkPoses msg;
+    for(const auto& name: imu_link_names_)
+      {
+        if(seg_tf_map.find(name) == seg_tf_map.end() && name != robot_model_->getRootFrameName())
+          break; // the following imus are not fused on spinal, since the index is the order of the neurons
+
+        KDL::Frame f = baselink_inv * segmentFrame(seg_tf_map, name);
+        double x, y, z, w;
+        f.M.GetQuaternion(x, y, z, w);
+        msg.orientation.insert(msg.orientation.end(), {(float)x, (float)y, (float)z, (float)w});
+        msg.position.insert(msg.position.end(), {(float)f.p.x(), (float)f.p.y(), (float)f.p.z()});
+      }
+    imu_link_poses_pub_.publish(msg);
+  }
+};
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "imu_link_poses_publisher");
+  ros::NodeHandle nh;
+  ros::NodeHandle nhp("~");
+
+  ImuLinkPosesPublisher imu_link_poses_publisher(nh, nhp);
+  ros::spin();
+
+  return 0;
+}
@@ -0,0 +1,316 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2018, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/o2r other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: callback time of ServoBridge with 64 synthetic servos (two groups of 32),
+       compared with the previous implementation (linear search of the handler by id / name,
+       and the joint state message built from scratch in every callback).
+       The servo ids and the joint names in the messages are shuffled.
+*/
+
+#include <aerial_robot_model/servo_bridge.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+namespace
+{
+  const int GROUP_SIZE = 32;
+  const std::vector<std::string> GROUPS = {"gimbals", "joints"};
+  const int ITERATION = 10000;
+
+  std::string jointName(const std::string& group, int i)
+  {
+    return group + std::to_string(i + 1);
+  }
+
+  /* serial chain with all the joints of the groups */
+  std::string generateUrdf()
+  {
+    std::stringstream ss;
+    ss << "<robot name=\"servo_bridge_benchmark\"><link name=\"root\"/>";
+    std::string parent = "root";
+    for(const auto& group: GROUPS)
+      {
+        for(int i = 0; i < GROUP_SIZE; i++)
+          {
+            std::string name = jointName(group, i);
+            ss << "<link name=\"" << name << "_link\"/>"
+               << "<joint name=\"" << name << "\" type=\"revolute\">"
+               << "<parent link=\"" << parent << "\"/><child link=\"" << name << "_link\"/>"
+               << "<axis xyz=\"0 0 1\"/><limit lower=\"-1.57\" upper=\"1.57\" effort=\"1\" velocity=\"1\"/>"
+               << "</joint>";
+            parent = name + "_link";
+          }
+      }
+    ss << "</robot>";
+    return ss.str();
+  }
+
+  void setServoParams(ros::NodeHandle& nh)
+  {
+    nh.setParam("robot_description", generateUrdf());
+
+    XmlRpc::XmlRpcValue all_servos_params;
+    for(const auto& group: GROUPS)
+      {
+        XmlRpc::XmlRpcValue group_params;
+        group_params["angle_sgn"] = 1;
+        group_params["zero_point_offset"] = 2047;
+        group_params["angle_scale"] = 0.00153;
+        group_params["state_sub_topic"] = group + "/servo_states";
+        group_params["ctrl_pub_topic"] = group + "/servo_target";
+        for(int i = 0; i < GROUP_SIZE; i++)
+          {
+            XmlRpc::XmlRpcValue servo_params;
+            servo_params["id"] = i;
+            servo_params["name"] = jointName(group, i);
+            group_params["controller" + std::to_string(i + 1)] = servo_params;
+          }
+        all_servos_params[group] = group_params;
+      }
+    nh.setParam("servo_controller", all_servos_params);
+  }
+
+  class ServoBridgeReplay : public ServoBridge
+  {
+  public:
+    ServoBridgeReplay(ros::NodeHandle nh, ros::NodeHandle nhp): ServoBridge(nh, nhp) {}
+
+    virtual void states(const spinal::ServoStatesConstPtr& msg, const std::string& group) { servoStatesCallback(msg, group); }
+    virtual void ctrl(const sensor_msgs::JointStateConstPtr& msg, const std::string& group) { servoCtrlCallback(msg, group); }
+
+    const sensor_msgs::JointState& getStatesMsg() { return servo_states_msg_; }
+    const spinal::ServoControlCmd& getCtrlMsg(const std::string& group) { return servos_index_[group].ctrl_msg; }
+    ServoGroupHandler& getServos(const std::string& group) { return servos_handler_[group]; }
+  };
+
+  /* the previous implementation, for reference */
+  class LegacyServoBridge : public ServoBridgeReplay
+  {
+  public:
+    LegacyServoBridge(ros::NodeHandle nh, ros::NodeHandle nhp): ServoBridgeReplay(nh, nhp) {}
+
+    void states(const spinal::ServoStatesConstPtr& state_msg, const std::string& servo_group_name) override
+    {
+      if(state_msg->servos.size() != servos_handler_[servo_group_name].size())
+        {
+          ROS_ERROR("[servo bridge, servo state callback]: the joint num from rosparam %d is not equal with ros msgs %d", (int)servos_handler_[servo_group_name].size(), (int)state_msg->servos.size());
+          return;
+        }
+
+      for(auto it: state_msg->servos)
+        {
+          auto servo_handler = find_if(servos_handler_[servo_group_name].begin(),
+                                       servos_handler_[servo_group_name].end(),
+                                       [&](SingleServoHandlePtr s) {return it.index == s->getId();} );
+
+          if(servo_handler == servos_handler_[servo_group_name].end())
+            {
+              ROS_ERROR("[servo bridge, servo state callback]: no matching joint handler for servo index %d", it.index);
+              return;
+            }
+          (*servo_handler)->setCurrAngleVal((double)it.angle, ValueType::BIT); // angle (position)
+          (*servo_handler)->setCurrTorqueVal((double)it.load); // torque (effort)
+        }
+
+      sensor_msgs::JointState servo_states_msg;
+      servo_states_msg.header.stamp = state_msg->stamp;
+
+      for(auto servo_group : servos_handler_)
+        {
+          for(auto servo_handler: servo_group.second)
+            {
+              servo_states_msg.name.push_back(servo_handler->getName());
+              servo_states_msg.position.push_back(servo_handler->getCurrAngleVal(ValueType::RADIAN));
+              servo_states_msg.effort.push_back(servo_handler->getCurrTorqueVal());
+            }
+        }
+      servo_states_pub_.publish(servo_states_msg);
+      legacy_states_msg_ = servo_states_msg;
+    }
+
+    void ctrl(const sensor_msgs::JointStateConstPtr& servo_ctrl_msg, const std::string& servo_group_name) override
+    {
+      spinal::ServoControlCmd target_angle_msg;
+
+      for(int i = 0; i < servo_ctrl_msg->name.size(); i++)
+        {/* servo name is assigned */
+
+          if(servo_ctrl_msg->position.size() !=  servo_ctrl_msg->name.size())
+            {
+              ROS_ERROR("[servo bridge, servo control control]: the servo position num and name num are different in ros msgs [%d vs %d]",
+                        (int)servo_ctrl_msg->position.size(), (int)servo_ctrl_msg->name.size());
+              return;
+            }
+
+          // use servo_name to search the servo_handler
+          auto servo_handler = find_if(servos_handler_[servo_group_name].begin(), servos_handler_[servo_group_name].end(),
+                                       [&](SingleServoHandlePtr s) {return servo_ctrl_msg->name.at(i)  == s->getName();});
+
+          if(servo_handler == servos_handler_[servo_group_name].end())
+            {
+              ROS_ERROR("[servo bridge, servo control callback]: no matching servo handler for %s", servo_ctrl_msg->name.at(i).c_str());
+              return;
+            }
+
+          (*servo_handler)->setTargetAngleVal(servo_ctrl_msg->position[i], ValueType::RADIAN);
+          target_angle_msg.index.push_back((*servo_handler)->getId());
+          target_angle_msg.angles.push_back((*servo_handler)->getTargetAngleVal(ValueType::BIT));
+        }
+
+      servo_ctrl_pubs_[servo_group_name].publish(target_angle_msg);
+      legacy_ctrl_msg_ = target_angle_msg;
+    }
+
+    sensor_msgs::JointState legacy_states_msg_;
+    spinal::ServoControlCmd legacy_ctrl_msg_;
+  };
+
+  struct Stream
+  {
+    std::vector<spinal::ServoStatesConstPtr> states;
+    std::vector<sensor_msgs::JointStateConstPtr> ctrls;
+  };
+
+  Stream generateStream(int size)
+  {
+    std::mt19937 engine(1);
+    std::uniform_int_distribution<int> angle(1500, 2500);
+    std::uniform_real_distribution<double> position(-1.0, 1.0);
+
+    std::vector<int> order(GROUP_SIZE);
+    for(int i = 0; i < GROUP_SIZE; i++) order[i] = i;
+
+    Stream stream;
+    for(int n = 0; n < size; n++)
+      {
+        std::shuffle(order.begin(), order.end(), engine);
+        spinal::ServoStatesPtr state_msg(new spinal::ServoStates);
+        state_msg->stamp = ros::Time(1.0 + n * 0.01);
+        for(int i: order)
+          {
+            spinal::ServoState servo;
+            servo.index = i;
+            servo.angle = angle(engine);
+            servo.load = angle(engine) - 2000;
+            state_msg->servos.push_back(servo);
+          }
+        stream.states.push_back(state_msg);
+
+        std::shuffle(order.begin(), order.end(), engine);
+        sensor_msgs::JointStatePtr ctrl_msg(new sensor_msgs::JointState);
+        for(int i: order)
+          {
+            ctrl_msg->name.push_back(jointName(GROUPS.at(n % GROUPS.size()), i));
+            ctrl_msg->position.push_back(position(engine));
+          }
+        stream.ctrls.push_back(ctrl_msg);
+      }
+    return stream;
+  }
+
+  struct Cost
+  {
+    double states; // [ns] per callback
+    double ctrl;
+  };
+
+  Cost replay(ServoBridgeReplay& bridge, const Stream& stream)
+  {
+    std::chrono::nanoseconds states_elapsed(0), ctrl_elapsed(0);
+    for(int n = 0; n < stream.states.size(); n++)
+      {
+        const std::string& group = GROUPS.at(n % GROUPS.size());
+
+        auto start = std::chrono::steady_clock::now();
+        bridge.states(stream.states.at(n), group);
+        auto middle = std::chrono::steady_clock::now();
+        bridge.ctrl(stream.ctrls.at(n), group);
+        auto end = std::chrono::steady_clock::now();
+
+        states_elapsed += middle - start;
+        ctrl_elapsed += end - middle;
+      }
+
+    Cost cost;
+    cost.states = (double)states_elapsed.count() / stream.states.size();
+    cost.ctrl = (double)ctrl_elapsed.count() / stream.ctrls.size();
+    return cost;
+  }
+}
+
+TEST(ServoBridgeBenchmark, Callback)
+{
+  ros::NodeHandle nh, nhp("~");
+  setServoParams(nh);
+
+  ServoBridgeReplay bridge(nh, nhp);
+  LegacyServoBridge legacy(nh, nhp);
+  ASSERT_EQ(bridge.getStatesMsg().name.size(), GROUPS.size() * GROUP_SIZE);
+
+  Stream stream = generateStream(ITERATION);
+  Cost cost = replay(bridge, stream);
+  Cost legacy_cost = replay(legacy, stream);
+
+  ROS_INFO("%d servos, servo states callback: %f [ns] (previous %f [ns]), servo ctrl callback: %f [ns] (previous %f [ns])",
+           (int)(GROUPS.size() * GROUP_SIZE), cost.states, legacy_cost.states, cost.ctrl, legacy_cost.ctrl);
+
+  /* same result */
+  EXPECT_EQ(bridge.getStatesMsg().header.stamp, legacy.legacy_states_msg_.header.stamp);
+  EXPECT_EQ(bridge.getStatesMsg().name, legacy.legacy_states_msg_.name);
+  EXPECT_EQ(bridge.getStatesMsg().position, legacy.legacy_states_msg_.position);
+  EXPECT_EQ(bridge.getStatesMsg().effort, legacy.legacy_states_msg_.effort);
+
+  const std::string& last_group = GROUPS.at((ITERATION - 1) % GROUPS.size());
+  EXPECT_EQ(bridge.getCtrlMsg(last_group).index, legacy.legacy_ctrl_msg_.index);
+  EXPECT_EQ(bridge.getCtrlMsg(last_group).angles, legacy.legacy_ctrl_msg_.angles);
+  for(const auto& group: GROUPS)
+    for(int i = 0; i < GROUP_SIZE; i++)
+      EXPECT_EQ(bridge.getServos(group).at(i)->getTargetAngleVal(ValueType::RADIAN),
+                legacy.getServos(group).at(i)->getTargetAngleVal(ValueType::RADIAN));
+
+  EXPECT_LT(cost.states, legacy_cost.states);
+  EXPECT_LT(cost.ctrl, legacy_cost.ctrl);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "servo_bridge_benchmark");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,107 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <motor_test/spsc_queue.h>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace motor_test
+{
+  namespace Phase
+  {
+    enum {NONE = 0, RAISE = 1, VALID = 2, BRAKE = 3,};
+  };
+
+  struct Sample
+  {
+    double stamp; // [sec] from the start of the test
+    float force[3];
+    float force_norm;
+    float torque[3];
+    float currency;
+    uint16_t pwm;
+    uint8_t phase;
+  };
+
+  const char* phaseName(uint8_t phase);
+  uint8_t phaseFromName(const std::string& name);
+
+  /* the force sensor callback only pushes the sample to the lock-free queue,
+     and the background thread writes the file.
+     CSV: pwm, force_x, force_y, force_z, force_norm, torque_x, torque_y, torque_z, currency, phase, stamp
+          (the same columns with the old text log, which is also readable by loadLog)
+     BINARY: "MTLG", version, record size, then the raw Sample records */
+  class SampleLogger
+  {
+  public:
+    enum Format {CSV = 0, BINARY = 1,};
+
+    SampleLogger(size_t queue_size = 8192);
+    ~SampleLogger();
+
+    bool open(const std::string& file_name, Format format);
+    void close();
+    bool isOpen() const { return running_.load(); }
+
+    /* non-blocking, return false and count the drop if the writer can not keep up */
+    bool push(const Sample& sample);
+    uint64_t getDropCount() const { return drop_count_.load(); }
+    uint64_t getWriteCount() const { return write_count_.load(); }
+
+    static const uint32_t BINARY_VERSION = 1;
+
+  private:
+    SpscQueue<Sample> queue_;
+    std::thread writer_thread_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> drop_count_;
+    std::atomic<uint64_t> write_count_;
+    std::ofstream ofs_;
+    Format format_;
+
+    void writerFunc();
+    size_t drain();
+    void write(const Sample& sample);
+  };
+
+  /* read both the CSV (including the old text log) and the binary log */
+  bool loadLog(const std::string& file_name, std::vector<Sample>& samples);
+};
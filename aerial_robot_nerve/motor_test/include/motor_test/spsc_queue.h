@@ -0,0 +1,87 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace motor_test
+{
+  /* lock-free queue for one producer thread and one consumer thread.
+     the capacity is rounded up to the power of two, and push() fails instead of blocking when the queue is full */
+  template<class T> class SpscQueue
+  {
+  public:
+    explicit SpscQueue(size_t capacity = 4096): head_(0), tail_(0)
+    {
+      size_t size = 2;
+      while(size < capacity) size <<= 1;
+      buf_.resize(size);
+      mask_ = size - 1;
+    }
+
+    /* producer side */
+    bool push(const T& item)
+    {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if(tail - head_.load(std::memory_order_acquire) > mask_) return false;
+      buf_[tail & mask_] = item;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /* consumer side */
+    bool pop(T& item)
+    {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if(head == tail_.load(std::memory_order_acquire)) return false;
+      item = buf_[head & mask_];
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    size_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask_ + 1; }
+
+  private:
+    std::vector<T> buf_;
+    size_t mask_;
+    /* separate cache lines, otherwise the producer and the consumer invalidate each other */
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+  };
+};
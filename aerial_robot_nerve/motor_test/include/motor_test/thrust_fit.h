@@ -0,0 +1,121 @@
+// -*- mode: c++ -*-
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#pragma once
+
+#include <motor_test/sample_logger.h>
+#include <Eigen/Dense>
+#include <ostream>
+#include <vector>
+
+namespace motor_test
+{
+  /* same with spinal::MotorInfo */
+  namespace PwmConversion
+  {
+    enum {SQRT_MODE = 0, POLYNOMINAL_MODE = 1,};
+  };
+
+  /* the max order of polynominal in spinal::MotorInfo */
+  const int MAX_POLYNOMINAL_ORDER = 4;
+
+  /* least squares fit of y = c0 + c1 x + ... + cn x^n */
+  struct PolynomialFit
+  {
+    Eigen::VectorXd coeff;
+    Eigen::VectorXd std_error;
+    Eigen::VectorXd bound; // half width of the confidence interval of each coefficient
+    Eigen::MatrixXd covariance;
+    double confidence;
+    double t_value;
+    double residual_rms;
+    double residual_max;
+    double r_squared;
+    int dof;
+
+    int order() const { return coeff.size() - 1; }
+    double evaluate(double x) const;
+    /* half width of the confidence interval of the fitted curve at x */
+    double curveBound(double x) const;
+  };
+
+  bool fitPolynomial(const std::vector<double>& x, const std::vector<double>& y, int order, double confidence, PolynomialFit& fit);
+
+  /* two-sided quantile of the student's t distribution, e.g. 0.95 -> 12.71 for dof = 1 */
+  double studentT(double confidence, int dof);
+
+  /* average of the samples in each pwm step. in the one-shot log, only the valid phase is used */
+  struct StepPoint
+  {
+    double pwm; // [%]
+    double thrust; // [N]
+    double torque; // [Nm], around the rotor axis
+    double currency; // [A]
+    int samples;
+  };
+
+  std::vector<StepPoint> averageSteps(const std::vector<Sample>& samples, double pwm_range, int min_samples = 1);
+
+  /* SQRT_MODE: thrust = c0 + c1 pwm + c2 pwm^2 (order is 2)
+     POLYNOMINAL_MODE: pwm = c0 + c1 (thrust / 10) + ... (order is up to 4)
+     pwm is [%], the same unit with AttitudeController::pwmConversion in spinal */
+  bool fitThrustCurve(const std::vector<StepPoint>& points, int mode, int order, double confidence, PolynomialFit& fit);
+
+  /* torque = c0 + c1 thrust + ..., c1 is m_f_rate */
+  bool fitTorqueCurve(const std::vector<StepPoint>& points, int order, double confidence, PolynomialFit& fit);
+
+  /* coefficients (or their bounds) in the decimal order shift of motor_info/refN/polynominalX */
+  std::vector<double> toPolynominalParam(const Eigen::VectorXd& coeff, int mode);
+
+  struct MotorInfoRef
+  {
+    double voltage;
+    double max_thrust;
+    PolynomialFit thrust_fit;
+  };
+
+  struct MotorInfoParams
+  {
+    double min_pwm; // [0, 1]
+    double max_pwm;
+    double min_thrust;
+    double force_landing_thrust;
+    int mode;
+  };
+
+  /* rosparam yaml which ControlBase loads in motor_info namespace */
+  void writeMotorInfo(std::ostream& os, const MotorInfoParams& params, const std::vector<MotorInfoRef>& refs, const PolynomialFit& torque_fit);
+  void writeFitReport(std::ostream& os, const std::string& name, const PolynomialFit& fit);
+};
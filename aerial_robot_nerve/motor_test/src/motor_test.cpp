@@ -1,6 +1,6 @@
 #include <ros/ros.h>
-#include <fstream>
 #include <geometry_msgs/WrenchStamped.h>
+#include <motor_test/sample_logger.h>
 #include <string>
 #include <std_msgs/UInt16.h>
 #include <std_msgs/Float32.h>
@@ -33,6 +33,11 @@ public:
     nhp_.param("raise_duration", raise_duration_, 1.0);
     nhp_.param("brake_duration", brake_duration_, 1.0);
 
+    /* csv or binary */
+    std::string log_format;
+    nhp_.param("log_format", log_format, std::string("csv"));
+    log_format_ = (log_format == "binary") ? motor_test::SampleLogger::BINARY : motor_test::SampleLogger::CSV;
+
     std::string topic_name;
     nhp_.param("force_sensor_sub_name", topic_name, std::string("forces"));
     force_snesor_sub_ = nh_.subscribe(topic_name, 1, &MotorTest::forceSensorCallback, this, ros::TransportHints().tcpNoDelay());
@@ -90,13 +95,21 @@ private:
 
   float currency_;
   ros::Time init_time_;
+  ros::Time start_time_;
 
-  std::ofstream ofs_;
+  /* the file is written in the background thread, not to block the force sensor callback */
+  motor_test::SampleLogger logger_;
+  motor_test::SampleLogger::Format log_format_;
 
   void startCallback(const std_msgs::EmptyConstPtr & msg)
   {
-    std::string file_name  = std::string("motor_test_") + std::to_string((int)ros::Time::now().toSec()) + std::string(".txt");
-    ofs_.open(file_name, std::ios::out);
+    std::string file_name  = std::string("motor_test_") + std::to_string((int)ros::Time::now().toSec())
+      + std::string(log_format_ == motor_test::SampleLogger::BINARY ? ".bin" : ".csv");
+    if(!logger_.open(file_name, log_format_))
+      {
+        ROS_ERROR("can not open %s", file_name.c_str());
+        return;
+      }
 
     pwm_value_ = min_pwm_value_;
 
@@ -104,6 +117,7 @@ private:
     cmd_msg.data = pwm_value_  / pwm_range_;
     motor_pwm_pub_.publish(cmd_msg);
     init_time_ = ros::Time::now();
+    start_time_ = init_time_;
     ROS_INFO("start pwm test");
     start_flag_ = true;
   }
@@ -121,36 +135,39 @@ private:
                              msg->wrench.force.y * msg->wrench.force.y +
                              msg->wrench.force.z * msg->wrench.force.z);
 
-    ofs_ << pwm_value_ << " "
-        << msg->wrench.force.x << " "
-        << msg->wrench.force.y << " "
-        << msg->wrench.force.z << " "
-        << force_norm << " "
-        << msg->wrench.torque.x << " "
-        << msg->wrench.torque.y << " "
-        << msg->wrench.torque.z << " "
-        << currency_;
+    motor_test::Sample sample;
+    sample.stamp = (ros::Time::now() - start_time_).toSec();
+    sample.pwm = pwm_value_;
+    sample.force[0] = msg->wrench.force.x;
+    sample.force[1] = msg->wrench.force.y;
+    sample.force[2] = msg->wrench.force.z;
+    sample.force_norm = force_norm;
+    sample.torque[0] = msg->wrench.torque.x;
+    sample.torque[1] = msg->wrench.torque.y;
+    sample.torque[2] = msg->wrench.torque.z;
+    sample.currency = currency_;
+    sample.phase = motor_test::Phase::NONE;
 
     if(test_mode_ == Mode::ONESHOT)
       {
         if(ros::Time::now().toSec() - init_time_.toSec() < raise_duration_)
           {
-            ofs_ << " " << std::string("raise");
+            sample.phase = motor_test::Phase::RAISE;
           }
         else
           {
             if(ros::Time::now().toSec() - init_time_.toSec() < raise_duration_ + run_duration_)
               {
-                ofs_ << " " << std::string("valid");
+                sample.phase = motor_test::Phase::VALID;
               }
             else
               {
-                ofs_ << " " << std::string("brake");
+                sample.phase = motor_test::Phase::BRAKE;
               }
           }
       }
 
-    ofs_ << std::endl;
+    logger_.push(sample);
   }
 
   void pwmFunc(const ros::TimerEvent & e)
@@ -211,8 +228,10 @@ private:
             motor_pwm_pub_.publish(cmd_msg);
 
             ROS_WARN("finish pwm test");
-            ofs_ << "done" << std::endl;
-            ofs_.close();
+            logger_.close();
+            if(logger_.getDropCount() > 0)
+              ROS_WARN("%lu samples are dropped in logging", logger_.getDropCount());
+            ROS_INFO("%lu samples are logged", logger_.getWriteCount());
 
             return;
           }
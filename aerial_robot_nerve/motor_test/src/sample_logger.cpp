@@ -0,0 +1,218 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <motor_test/sample_logger.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+  const char BINARY_MAGIC[4] = {'M', 'T', 'L', 'G'};
+  const std::chrono::milliseconds WRITER_INTERVAL(5);
+}
+
+namespace motor_test
+{
+  const char* phaseName(uint8_t phase)
+  {
+    switch(phase)
+      {
+      case Phase::RAISE: return "raise";
+      case Phase::VALID: return "valid";
+      case Phase::BRAKE: return "brake";
+      default: return "none";
+      }
+  }
+
+  uint8_t phaseFromName(const std::string& name)
+  {
+    if(name == "raise") return Phase::RAISE;
+    if(name == "valid") return Phase::VALID;
+    if(name == "brake") return Phase::BRAKE;
+    return Phase::NONE;
+  }
+
+  SampleLogger::SampleLogger(size_t queue_size):
+    queue_(queue_size), running_(false), drop_count_(0), write_count_(0), format_(CSV)
+  {
+  }
+
+  SampleLogger::~SampleLogger()
+  {
+    close();
+  }
+
+  bool SampleLogger::open(const std::string& file_name, Format format)
+  {
+    close();
+
+    /* discard the samples pushed after the last close */
+    Sample sample;
+    while(queue_.pop(sample));
+
+    ofs_.open(file_name, std::ios::out | std::ios::binary);
+    if(!ofs_) return false;
+
+    format_ = format;
+    drop_count_ = 0;
+    write_count_ = 0;
+
+    if(format_ == BINARY)
+      {
+        uint32_t header[2] = {BINARY_VERSION, sizeof(Sample)};
+        ofs_.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        ofs_.write(reinterpret_cast<const char*>(header), sizeof(header));
+      }
+    else
+      {
+        ofs_ << "# pwm,force_x,force_y,force_z,force_norm,torque_x,torque_y,torque_z,currency,phase,stamp\n";
+      }
+
+    running_ = true;
+    writer_thread_ = std::thread(&SampleLogger::writerFunc, this);
+    return true;
+  }
+
+  void SampleLogger::close()
+  {
+    if(!running_) return;
+
+    running_ = false;
+    writer_thread_.join();
+
+    if(format_ == CSV) ofs_ << "# done\n";
+    ofs_.close();
+  }
+
+  bool SampleLogger::push(const Sample& sample)
+  {
+    if(!running_) return false;
+
+    if(!queue_.push(sample))
+      {
+        drop_count_++;
+        return false;
+      }
+    return true;
+  }
+
+  void SampleLogger::writerFunc()
+  {
+    while(running_)
+      {
+        if(drain() == 0) std::this_thread::sleep_for(WRITER_INTERVAL);
+      }
+
+    /* write the rest */
+    drain();
+  }
+
+  size_t SampleLogger::drain()
+  {
+    size_t count = 0;
+    Sample sample;
+    while(queue_.pop(sample))
+      {
+        write(sample);
+        count++;
+      }
+
+    if(count > 0)
+      {
+        /* flush once per batch, instead of once per line */
+        ofs_.flush();
+        write_count_ += count;
+      }
+    return count;
+  }
+
+  void SampleLogger::write(const Sample& sample)
+  {
+    if(format_ == BINARY)
+      {
+        ofs_.write(reinterpret_cast<const char*>(&sample), sizeof(Sample));
+        return;
+      }
+
+    ofs_ << sample.pwm << ","
+         << sample.force[0] << "," << sample.force[1] << "," << sample.force[2] << ","
+         << sample.force_norm << ","
+         << sample.torque[0] << "," << sample.torque[1] << "," << sample.torque[2] << ","
+         << sample.currency << ","
+         << phaseName(sample.phase) << ","
+         << sample.stamp << "\n";
+  }
+
+  bool loadLog(const std::string& file_name, std::vector<Sample>& samples)
+  {
+    std::ifstream ifs(file_name, std::ios::in | std::ios::binary);
+    if(!ifs) return false;
+
+    char magic[sizeof(BINARY_MAGIC)] = {0};
+    ifs.read(magic, sizeof(magic));
+    if(ifs.gcount() == sizeof(magic) && std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0)
+      {
+        uint32_t header[2];
+        ifs.read(reinterpret_cast<char*>(header), sizeof(header));
+        if(!ifs || header[0] != SampleLogger::BINARY_VERSION || header[1] != sizeof(Sample)) return false;
+
+        Sample sample;
+        while(ifs.read(reinterpret_cast<char*>(&sample), sizeof(Sample))) samples.push_back(sample);
+        return !samples.empty();
+      }
+
+    /* text: the new csv or the old space separated log (without stamp, and with phase only in one-shot mode) */
+    ifs.clear();
+    ifs.seekg(0);
+    std::string line;
+    while(std::getline(ifs, line))
+      {
+        if(line.empty() || line[0] == '#' || line.compare(0, 4, "done") == 0) continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream iss(line);
+        Sample sample;
+        if(!(iss >> sample.pwm >> sample.force[0] >> sample.force[1] >> sample.force[2] >> sample.force_norm
+             >> sample.torque[0] >> sample.torque[1] >> sample.torque[2] >> sample.currency))
+          return false;
+
+        std::string phase;
+        sample.phase = (iss >> phase) ? phaseFromName(phase) : (uint8_t)Phase::NONE;
+        if(!(iss >> sample.stamp)) sample.stamp = 0;
+        samples.push_back(sample);
+      }
+    return !samples.empty();
+  }
+};
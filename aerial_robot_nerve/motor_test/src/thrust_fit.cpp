@@ -0,0 +1,288 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <motor_test/thrust_fit.h>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+
+namespace
+{
+  /* continued fraction of the regularized incomplete beta function (Numerical Recipes) */
+  double betaContinuedFraction(double a, double b, double x)
+  {
+    const double eps = 1e-14, fpmin = 1e-300;
+    double qab = a + b, qap = a + 1, qam = a - 1;
+    double c = 1, d = 1 - qab * x / qap;
+    if(std::fabs(d) < fpmin) d = fpmin;
+    d = 1 / d;
+    double h = d;
+    for(int m = 1; m <= 300; m++)
+      {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+        d = 1 + aa * d;
+        if(std::fabs(d) < fpmin) d = fpmin;
+        c = 1 + aa / c;
+        if(std::fabs(c) < fpmin) c = fpmin;
+        d = 1 / d;
+        h *= d * c;
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+        d = 1 + aa * d;
+        if(std::fabs(d) < fpmin) d = fpmin;
+        c = 1 + aa / c;
+        if(std::fabs(c) < fpmin) c = fpmin;
+        d = 1 / d;
+        double del = d * c;
+        h *= del;
+        if(std::fabs(del - 1) < eps) break;
+      }
+    return h;
+  }
+
+  double incompleteBeta(double a, double b, double x)
+  {
+    if(x <= 0) return 0;
+    if(x >= 1) return 1;
+    double bt = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x));
+    if(x < (a + 1) / (a + b + 2)) return bt * betaContinuedFraction(a, b, x) / a;
+    return 1 - bt * betaContinuedFraction(b, a, 1 - x) / b;
+  }
+
+  /* P(|T| < t) */
+  double studentTwoSided(double t, int dof)
+  {
+    return 1 - incompleteBeta(dof / 2.0, 0.5, dof / (dof + t * t));
+  }
+}
+
+namespace motor_test
+{
+  double PolynomialFit::evaluate(double x) const
+  {
+    /* horner */
+    double y = 0;
+    for(int i = coeff.size() - 1; i >= 0; i--) y = y * x + coeff(i);
+    return y;
+  }
+
+  double PolynomialFit::curveBound(double x) const
+  {
+    Eigen::VectorXd v(coeff.size());
+    double p = 1;
+    for(int i = 0; i < v.size(); i++, p *= x) v(i) = p;
+    return t_value * std::sqrt(v.dot(covariance * v));
+  }
+
+  double studentT(double confidence, int dof)
+  {
+    if(dof < 1) return std::numeric_limits<double>::infinity();
+
+    /* bisection, since the two-sided probability is monotonic */
+    double low = 0, high = 1;
+    while(studentTwoSided(high, dof) < confidence) high *= 2;
+    for(int i = 0; i < 100; i++)
+      {
+        double mid = 0.5 * (low + high);
+        if(studentTwoSided(mid, dof) < confidence) low = mid;
+        else high = mid;
+      }
+    return 0.5 * (low + high);
+  }
+
+  bool fitPolynomial(const std::vector<double>& x, const std::vector<double>& y, int order, double confidence, PolynomialFit& fit)
+  {
+    int n = x.size();
+    if(order < 0 || y.size() != x.size() || n < order + 1) return false;
+
+    Eigen::MatrixXd a(n, order + 1);
+    Eigen::VectorXd b(n);
+    for(int i = 0; i < n; i++)
+      {
+        double p = 1;
+        for(int j = 0; j <= order; j++, p *= x.at(i)) a(i, j) = p;
+        b(i) = y.at(i);
+      }
+
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(a);
+    if(qr.rank() < order + 1) return false;
+    fit.coeff = qr.solve(b);
+
+    Eigen::VectorXd residual = b - a * fit.coeff;
+    fit.dof = n - (order + 1);
+    fit.residual_rms = std::sqrt(residual.squaredNorm() / n);
+    fit.residual_max = residual.cwiseAbs().maxCoeff();
+    double total = (b.array() - b.mean()).matrix().squaredNorm();
+    fit.r_squared = total > 0 ? 1 - residual.squaredNorm() / total : 1;
+
+    /* cov = sigma^2 (A^T A)^-1, with the unbiased residual variance */
+    double sigma2 = fit.dof > 0 ? residual.squaredNorm() / fit.dof : 0;
+    Eigen::MatrixXd ata = a.transpose() * a;
+    fit.covariance = sigma2 * ata.ldlt().solve(Eigen::MatrixXd::Identity(order + 1, order + 1));
+    fit.std_error = fit.covariance.diagonal().cwiseSqrt();
+    fit.confidence = confidence;
+    fit.t_value = fit.dof > 0 ? studentT(confidence, fit.dof) : 0;
+    fit.bound = fit.t_value * fit.std_error;
+
+    return true;
+  }
+
+  std::vector<StepPoint> averageSteps(const std::vector<Sample>& samples, double pwm_range, int min_samples)
+  {
+    bool oneshot = false;
+    for(const auto& sample: samples)
+      {
+        if(sample.phase != Phase::NONE)
+          {
+            oneshot = true;
+            break;
+          }
+      }
+
+    std::map<uint16_t, StepPoint> steps;
+    for(const auto& sample: samples)
+      {
+        if(oneshot && sample.phase != Phase::VALID) continue;
+
+        StepPoint& point = steps[sample.pwm]; // zero initialized
+        point.thrust += sample.force_norm;
+        point.torque += sample.torque[2];
+        point.currency += sample.currency;
+        point.samples++;
+      }
+
+    std::vector<StepPoint> points;
+    for(auto& step: steps)
+      {
+        StepPoint point = step.second;
+        if(point.samples < min_samples) continue;
+        point.pwm = step.first / pwm_range * 100;
+        point.thrust /= point.samples;
+        point.torque /= point.samples;
+        point.currency /= point.samples;
+        points.push_back(point);
+      }
+    return points;
+  }
+
+  bool fitThrustCurve(const std::vector<StepPoint>& points, int mode, int order, double confidence, PolynomialFit& fit)
+  {
+    std::vector<double> x, y;
+    for(const auto& point: points)
+      {
+        if(mode == PwmConversion::SQRT_MODE)
+          {
+            x.push_back(point.pwm);
+            y.push_back(point.thrust);
+          }
+        else
+          {
+            x.push_back(point.thrust / 10); // special decimal order shift (x0.1) in spinal
+            y.push_back(point.pwm);
+          }
+      }
+
+    if(mode == PwmConversion::SQRT_MODE && order != 2) return false;
+    if(mode == PwmConversion::POLYNOMINAL_MODE && order > MAX_POLYNOMINAL_ORDER) return false;
+    if(mode != PwmConversion::SQRT_MODE && mode != PwmConversion::POLYNOMINAL_MODE) return false;
+
+    return fitPolynomial(x, y, order, confidence, fit);
+  }
+
+  bool fitTorqueCurve(const std::vector<StepPoint>& points, int order, double confidence, PolynomialFit& fit)
+  {
+    std::vector<double> x, y;
+    for(const auto& point: points)
+      {
+        x.push_back(point.thrust);
+        y.push_back(point.torque);
+      }
+    return fitPolynomial(x, y, order, confidence, fit);
+  }
+
+  std::vector<double> toPolynominalParam(const Eigen::VectorXd& coeff, int mode)
+  {
+    std::vector<double> param(coeff.data(), coeff.data() + coeff.size());
+
+    /* special decimal order shift in the sqrt mode of spinal: thrust = p0 + 0.1 p1 pwm + 0.1 p2 pwm^2 */
+    if(mode == PwmConversion::SQRT_MODE)
+      for(int i = 1; i < param.size(); i++) param.at(i) *= 10;
+
+    return param;
+  }
+
+  void writeMotorInfo(std::ostream& os, const MotorInfoParams& params, const std::vector<MotorInfoRef>& refs, const PolynomialFit& torque_fit)
+  {
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed;
+
+    os << "motor_info:\n";
+    os << "        min_pwm: " << std::setprecision(4) << params.min_pwm << "\n";
+    os << "        max_pwm: " << params.max_pwm << "\n";
+    os << "        min_thrust: " << std::setprecision(2) << params.min_thrust << " # [N]\n";
+    os << "        force_landing_thrust: " << params.force_landing_thrust << " # [N]\n";
+    if(torque_fit.coeff.size() > 1)
+      os << "        m_f_rate: " << std::setprecision(4) << torque_fit.coeff(1) << " # +- " << std::setprecision(6) << torque_fit.bound(1) << "\n";
+    os << "        pwm_conversion_mode: " << params.mode
+       << (params.mode == PwmConversion::SQRT_MODE ? " # SQRT Mode" : " # Polynominal Mode") << "\n";
+    os << "        vel_ref_num: " << refs.size() << "\n";
+
+    for(int i = 0; i < refs.size(); i++)
+      {
+        const MotorInfoRef& ref = refs.at(i);
+        std::vector<double> param = toPolynominalParam(ref.thrust_fit.coeff, params.mode);
+        std::vector<double> bound = toPolynominalParam(ref.thrust_fit.bound, params.mode);
+
+        os << "        ref" << i + 1 << ":\n";
+        os << "                voltage: " << std::setprecision(1) << ref.voltage << "\n";
+        os << "                max_thrust: " << std::setprecision(2) << ref.max_thrust << " # N\n";
+        for(int j = param.size() - 1; j >= 0; j--)
+          os << "                polynominal" << j << ": " << std::setprecision(9) << param.at(j)
+             << " # +- " << std::setprecision(6) << bound.at(j) << "\n";
+      }
+
+    os.flags(flags);
+  }
+
+  void writeFitReport(std::ostream& os, const std::string& name, const PolynomialFit& fit)
+  {
+    os << name << ": order " << fit.order() << ", dof " << fit.dof
+       << ", residual rms " << fit.residual_rms << ", max " << fit.residual_max
+       << ", r^2 " << fit.r_squared << "\n";
+    for(int i = 0; i < fit.coeff.size(); i++)
+      os << "  c" << i << ": " << fit.coeff(i) << " +- " << fit.bound(i)
+         << " (" << fit.confidence * 100 << "%, std error " << fit.std_error(i) << ")\n";
+  }
+};
@@ -0,0 +1,171 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: fit the thrust curves from the motor_test logs, and print the motor_info rosparam.
+       usage: thrust_fit [--mode 0|1] [--order n] [--torque_order n] [--confidence 0.95]
+                         [--pwm_range 2000] [--min_samples 10] [--min_thrust 0] [--force_landing_thrust 0]
+                         [--output MotorInfo.yaml] voltage:log [voltage:log ...]
+       e.g. thrust_fit --mode 1 25.2:motor_test_1600000000.txt 22.2:motor_test_1600001000.txt
+       the fitting report is printed to stderr.
+*/
+
+#include <motor_test/thrust_fit.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace motor_test;
+
+namespace
+{
+  void usage()
+  {
+    std::cerr << "usage: thrust_fit [--mode 0|1] [--order n] [--torque_order n] [--confidence 0.95] "
+              << "[--pwm_range 2000] [--min_samples 10] [--min_thrust 0] [--force_landing_thrust 0] "
+              << "[--output file] voltage:log [voltage:log ...]" << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  MotorInfoParams params{0, 0, 0, 0, PwmConversion::POLYNOMINAL_MODE};
+  int order = -1, torque_order = 1, min_samples = 10;
+  double confidence = 0.95, pwm_range = 2000;
+  std::string output;
+  std::vector<std::pair<double, std::string> > logs;
+
+  for(int i = 1; i < argc; i++)
+    {
+      std::string arg(argv[i]);
+      if(arg.compare(0, 2, "--") == 0)
+        {
+          if(i + 1 >= argc)
+            {
+              usage();
+              return 1;
+            }
+          std::string value(argv[++i]);
+          if(arg == "--mode") params.mode = std::stoi(value);
+          else if(arg == "--order") order = std::stoi(value);
+          else if(arg == "--torque_order") torque_order = std::stoi(value);
+          else if(arg == "--confidence") confidence = std::stod(value);
+          else if(arg == "--pwm_range") pwm_range = std::stod(value);
+          else if(arg == "--min_samples") min_samples = std::stoi(value);
+          else if(arg == "--min_thrust") params.min_thrust = std::stod(value);
+          else if(arg == "--force_landing_thrust") params.force_landing_thrust = std::stod(value);
+          else if(arg == "--output") output = value;
+          else
+            {
+              usage();
+              return 1;
+            }
+          continue;
+        }
+
+      size_t pos = arg.find(':');
+      if(pos == std::string::npos)
+        {
+          usage();
+          return 1;
+        }
+      logs.push_back(std::make_pair(std::stod(arg.substr(0, pos)), arg.substr(pos + 1)));
+    }
+
+  if(logs.empty())
+    {
+      usage();
+      return 1;
+    }
+  if(order < 0) order = (params.mode == PwmConversion::SQRT_MODE) ? 2 : MAX_POLYNOMINAL_ORDER;
+
+  /* higher voltage first, as the existing MotorInfo.yaml */
+  std::sort(logs.begin(), logs.end(), [](const std::pair<double, std::string>& a, const std::pair<double, std::string>& b) { return a.first > b.first; });
+
+  std::vector<MotorInfoRef> refs;
+  std::vector<StepPoint> all_points;
+  params.min_pwm = 1;
+  params.max_pwm = 0;
+  for(const auto& log: logs)
+    {
+      std::vector<Sample> samples;
+      if(!loadLog(log.second, samples))
+        {
+          std::cerr << "can not load the log: " << log.second << std::endl;
+          return 1;
+        }
+
+      std::vector<StepPoint> points = averageSteps(samples, pwm_range, min_samples);
+      MotorInfoRef ref;
+      ref.voltage = log.first;
+      if(!fitThrustCurve(points, params.mode, order, confidence, ref.thrust_fit))
+        {
+          std::cerr << "can not fit the thrust curve of " << log.second << " in mode " << params.mode
+                    << " with order " << order << " from " << points.size() << " steps" << std::endl;
+          return 1;
+        }
+      ref.max_thrust = points.back().thrust;
+      params.min_pwm = std::min(params.min_pwm, points.front().pwm / 100);
+      params.max_pwm = std::max(params.max_pwm, points.back().pwm / 100);
+
+      std::stringstream name;
+      name << log.second << " (" << ref.voltage << "V)";
+      writeFitReport(std::cerr, name.str(), ref.thrust_fit);
+      refs.push_back(ref);
+      all_points.insert(all_points.end(), points.begin(), points.end());
+    }
+
+  /* m_f_rate does not depend on the voltage */
+  PolynomialFit torque_fit;
+  if(!fitTorqueCurve(all_points, torque_order, confidence, torque_fit))
+    {
+      std::cerr << "can not fit the torque curve with order " << torque_order << std::endl;
+      return 1;
+    }
+  writeFitReport(std::cerr, "torque/thrust", torque_fit);
+
+  if(output.empty())
+    {
+      writeMotorInfo(std::cout, params, refs, torque_fit);
+    }
+  else
+    {
+      std::ofstream ofs(output);
+      writeMotorInfo(ofs, params, refs, torque_fit);
+    }
+
+  return 0;
+}
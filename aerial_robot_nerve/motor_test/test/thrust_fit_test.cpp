@@ -0,0 +1,375 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK Lab
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the JSK Lab nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: offline test of the thrust curve fitting and the sample logger.
+       The synthetic logs are generated from the known polynomials (the motor_info of hydrus and dragon)
+       with the force sensor noise, and the fitted coefficients are compared with the true ones.
+*/
+
+#include <motor_test/thrust_fit.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <sstream>
+
+using namespace motor_test;
+
+namespace
+{
+  const double PWM_RANGE = 2000;
+  const double FORCE_NOISE = 0.05; // [N]
+  const double TORQUE_NOISE = 0.002; // [Nm]
+  const double M_F_RATE = -0.0172;
+
+  /* motor_info/ref1 of hydrus (sqrt mode), thrust = c0 + c1 pwm + c2 pwm^2, pwm is [%] */
+  const std::vector<double> SQRT_COEFF = {12.3593793002, -0.6627443098, 0.007983707};
+  /* motor_info/ref1 of dragon (polynominal mode), pwm = c0 + c1 (f / 10) + ... */
+  const std::vector<double> POLYNOMINAL_COEFF = {58.697129, 13.882688, -8.8434316, 15.577885, -5.7063259};
+
+  double polynomial(const std::vector<double>& coeff, double x)
+  {
+    double y = 0;
+    for(int i = coeff.size() - 1; i >= 0; i--) y = y * x + coeff.at(i);
+    return y;
+  }
+
+  /* thrust from pwm [%] of the polynominal mode by bisection, the curve is monotonic until max_thrust (18N) */
+  double inversePolynominal(double pwm)
+  {
+    double low = 0, high = 18;
+    for(int i = 0; i < 100; i++)
+      {
+        double mid = 0.5 * (low + high);
+        if(polynomial(POLYNOMINAL_COEFF, mid / 10) < pwm) low = mid;
+        else high = mid;
+      }
+    return 0.5 * (low + high);
+  }
+
+  /* one-shot log: raise, valid, brake phases in each pwm step */
+  template<class ThrustFunc> std::vector<Sample> generateLog(ThrustFunc thrust_func, int min_pwm, int max_pwm, int step,
+                                                             unsigned int seed, int samples_per_phase = 100)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    std::vector<Sample> samples;
+    double t = 0;
+    for(int pwm = min_pwm; pwm <= max_pwm; pwm += step)
+      {
+        double thrust = thrust_func(pwm / PWM_RANGE * 100);
+        for(uint8_t phase: {Phase::RAISE, Phase::VALID, Phase::BRAKE})
+          {
+            for(int i = 0; i < samples_per_phase; i++, t += 0.001)
+              {
+                /* the transient phases are far from the steady state */
+                double scale = (phase == Phase::VALID) ? 1.0 : 0.5;
+                Sample sample;
+                sample.stamp = t;
+                sample.pwm = pwm;
+                sample.force[0] = FORCE_NOISE * normal(engine);
+                sample.force[1] = FORCE_NOISE * normal(engine);
+                sample.force[2] = scale * thrust + FORCE_NOISE * normal(engine);
+                sample.force_norm = std::sqrt(sample.force[0] * sample.force[0] + sample.force[1] * sample.force[1] + sample.force[2] * sample.force[2]);
+                sample.torque[0] = TORQUE_NOISE * normal(engine);
+                sample.torque[1] = TORQUE_NOISE * normal(engine);
+                sample.torque[2] = M_F_RATE * scale * thrust + TORQUE_NOISE * normal(engine);
+                sample.currency = 0.5 * scale * thrust;
+                sample.phase = phase;
+                samples.push_back(sample);
+              }
+          }
+      }
+    return samples;
+  }
+
+  std::string tempFile(const std::string& name)
+  {
+    return std::string(P_tmpdir) + "/" + name;
+  }
+}
+
+TEST(ThrustFitTest, StudentT)
+{
+  EXPECT_NEAR(studentT(0.95, 1), 12.706, 1e-3);
+  EXPECT_NEAR(studentT(0.95, 4), 2.776, 1e-3);
+  EXPECT_NEAR(studentT(0.99, 10), 3.169, 1e-3);
+  EXPECT_NEAR(studentT(0.95, 100000), 1.960, 1e-3);
+}
+
+TEST(ThrustFitTest, Polynomial)
+{
+  std::vector<double> coeff = {1.0, -2.0, 0.5, 0.1};
+  std::mt19937 engine(1);
+  std::normal_distribution<double> normal(0.0, 0.1);
+
+  std::vector<double> x, y;
+  for(int i = 0; i < 200; i++)
+    {
+      x.push_back(-3.0 + 6.0 * i / 199);
+      y.push_back(polynomial(coeff, x.back()) + normal(engine));
+    }
+
+  PolynomialFit fit;
+  ASSERT_TRUE(fitPolynomial(x, y, 3, 0.95, fit));
+  EXPECT_EQ(fit.dof, 196);
+  EXPECT_NEAR(fit.residual_rms, 0.1, 0.02);
+  EXPECT_GT(fit.r_squared, 0.99);
+  for(int i = 0; i < 4; i++)
+    {
+      EXPECT_NEAR(fit.coeff(i), coeff.at(i), 3 * fit.std_error(i)) << "c" << i;
+      EXPECT_NEAR(fit.bound(i), fit.t_value * fit.std_error(i), 1e-12);
+    }
+  EXPECT_NEAR(fit.evaluate(1.0), polynomial(coeff, 1.0), 3 * fit.curveBound(1.0));
+
+  /* under-determined */
+  EXPECT_FALSE(fitPolynomial(std::vector<double>(x.begin(), x.begin() + 3), std::vector<double>(y.begin(), y.begin() + 3), 3, 0.95, fit));
+}
+
+TEST(ThrustFitTest, ConfidenceCoverage)
+{
+  /* few points: the t value is much larger than the normal quantile, and the coverage should be still kept */
+  std::vector<double> coeff = {0.5, 1.5, -0.3};
+  std::mt19937 engine(2);
+  std::normal_distribution<double> normal(0.0, 0.2);
+
+  int trials = 1000, covered = 0;
+  for(int n = 0; n < trials; n++)
+    {
+      std::vector<double> x, y;
+      for(int i = 0; i < 6; i++)
+        {
+          x.push_back(i * 0.5);
+          y.push_back(polynomial(coeff, x.back()) + normal(engine));
+        }
+      PolynomialFit fit;
+      ASSERT_TRUE(fitPolynomial(x, y, 2, 0.95, fit));
+      if(std::fabs(fit.coeff(1) - coeff.at(1)) < fit.bound(1)) covered++;
+    }
+
+  EXPECT_NEAR((double)covered / trials, 0.95, 0.02);
+}
+
+TEST(ThrustFitTest, SqrtMode)
+{
+  std::vector<Sample> samples = generateLog([](double pwm) { return polynomial(SQRT_COEFF, pwm); }, 1200, 1880, 20, 3);
+  std::vector<StepPoint> points = averageSteps(samples, PWM_RANGE);
+  ASSERT_EQ(points.size(), 35);
+  EXPECT_EQ(points.front().samples, 100); // only the valid phase
+  EXPECT_DOUBLE_EQ(points.front().pwm, 60.0);
+
+  PolynomialFit fit;
+  EXPECT_FALSE(fitThrustCurve(points, PwmConversion::SQRT_MODE, 3, 0.95, fit));
+  ASSERT_TRUE(fitThrustCurve(points, PwmConversion::SQRT_MODE, 2, 0.95, fit));
+  for(int i = 0; i < 3; i++) EXPECT_NEAR(fit.coeff(i), SQRT_COEFF.at(i), 3 * fit.std_error(i)) << "c" << i;
+
+  /* the same conversion as AttitudeController::pwmConversion in spinal */
+  std::vector<double> p = toPolynominalParam(fit.coeff, PwmConversion::SQRT_MODE);
+  ASSERT_EQ(p.size(), 3);
+  EXPECT_NEAR(p.at(2), 10 * SQRT_COEFF.at(2), 10 * 3 * fit.std_error(2));
+  for(double thrust: {3.0, 8.0, 15.0})
+    {
+      double sqrt_tmp = p.at(1) * p.at(1) - 4 * 10 * p.at(2) * (p.at(0) - thrust);
+      double pwm = (-p.at(1) + std::sqrt(sqrt_tmp)) / (2 * p.at(2));
+      EXPECT_NEAR(polynomial(SQRT_COEFF, pwm), thrust, 0.05) << "thrust " << thrust;
+    }
+
+  PolynomialFit torque_fit;
+  ASSERT_TRUE(fitTorqueCurve(points, 1, 0.95, torque_fit));
+  EXPECT_NEAR(torque_fit.coeff(1), M_F_RATE, 3 * torque_fit.std_error(1));
+  EXPECT_LT(torque_fit.bound(1), 0.001);
+}
+
+TEST(ThrustFitTest, PolynominalMode)
+{
+  std::vector<Sample> samples = generateLog(inversePolynominal, 1200, 1680, 20, 4);
+  std::vector<StepPoint> points = averageSteps(samples, PWM_RANGE);
+  ASSERT_EQ(points.size(), 25);
+
+  PolynomialFit fit;
+  EXPECT_FALSE(fitThrustCurve(points, PwmConversion::POLYNOMINAL_MODE, 5, 0.95, fit));
+  ASSERT_TRUE(fitThrustCurve(points, PwmConversion::POLYNOMINAL_MODE, 4, 0.95, fit));
+  for(int i = 0; i < 5; i++) EXPECT_NEAR(fit.coeff(i), POLYNOMINAL_COEFF.at(i), 3 * fit.std_error(i)) << "c" << i;
+
+  /* the high order coefficients are correlated, but the curve itself is well determined */
+  for(double thrust: {2.0, 8.0, 15.0})
+    {
+      EXPECT_NEAR(fit.evaluate(thrust / 10), polynomial(POLYNOMINAL_COEFF, thrust / 10), 3 * fit.curveBound(thrust / 10));
+      EXPECT_LT(fit.curveBound(thrust / 10), 0.1); // [%]
+    }
+
+  /* lower order with the systematic error */
+  PolynomialFit fit2;
+  ASSERT_TRUE(fitThrustCurve(points, PwmConversion::POLYNOMINAL_MODE, 2, 0.95, fit2));
+  EXPECT_GT(fit2.residual_rms, fit.residual_rms);
+}
+
+TEST(ThrustFitTest, MotorInfoYaml)
+{
+  std::vector<Sample> samples = generateLog(inversePolynominal, 1200, 1680, 20, 5);
+  std::vector<StepPoint> points = averageSteps(samples, PWM_RANGE);
+
+  MotorInfoRef ref;
+  ref.voltage = 25.2;
+  ref.max_thrust = points.back().thrust;
+  ASSERT_TRUE(fitThrustCurve(points, PwmConversion::POLYNOMINAL_MODE, 4, 0.95, ref.thrust_fit));
+  PolynomialFit torque_fit;
+  ASSERT_TRUE(fitTorqueCurve(points, 1, 0.95, torque_fit));
+
+  MotorInfoParams params{0.6, 0.86, 0, 12, PwmConversion::POLYNOMINAL_MODE};
+  std::stringstream ss;
+  writeMotorInfo(ss, params, std::vector<MotorInfoRef>{ref, ref}, torque_fit);
+
+  /* the keys which ControlBase reads */
+  std::map<std::string, double> values;
+  std::string line, ref_name;
+  std::getline(ss, line);
+  EXPECT_EQ(line, "motor_info:");
+  while(std::getline(ss, line))
+    {
+      line = line.substr(0, line.find('#'));
+      size_t colon = line.find(':');
+      ASSERT_NE(colon, std::string::npos) << line;
+      size_t indent = line.find_first_not_of(' ');
+      std::string key = line.substr(indent, colon - indent);
+      std::string value = line.substr(colon + 1);
+      if(value.find_first_not_of(' ') == std::string::npos)
+        {
+          EXPECT_EQ(indent, 8);
+          ref_name = key + "/";
+          continue;
+        }
+      values[(indent > 8 ? ref_name : "") + key] = std::stod(value);
+    }
+
+  EXPECT_DOUBLE_EQ(values["min_pwm"], 0.6);
+  EXPECT_DOUBLE_EQ(values["max_pwm"], 0.86);
+  EXPECT_DOUBLE_EQ(values["force_landing_thrust"], 12);
+  EXPECT_EQ(values["pwm_conversion_mode"], PwmConversion::POLYNOMINAL_MODE);
+  EXPECT_EQ(values["vel_ref_num"], 2);
+  EXPECT_NEAR(values["m_f_rate"], M_F_RATE, 1e-3);
+  for(std::string name: {"ref1/", "ref2/"})
+    {
+      EXPECT_DOUBLE_EQ(values[name + "voltage"], 25.2);
+      EXPECT_NEAR(values[name + "max_thrust"], ref.max_thrust, 0.01);
+      for(int i = 0; i <= 4; i++)
+        EXPECT_NEAR(values[name + "polynominal" + std::to_string(i)], ref.thrust_fit.coeff(i), 1e-6);
+    }
+}
+
+TEST(SampleLoggerTest, RoundTrip)
+{
+  std::vector<Sample> samples = generateLog([](double pwm) { return polynomial(SQRT_COEFF, pwm); }, 1200, 1400, 20, 6);
+
+  for(auto format: {SampleLogger::CSV, SampleLogger::BINARY})
+    {
+      std::string file = tempFile(std::string("motor_test_logger_") + std::to_string(format));
+      SampleLogger logger(256);
+      ASSERT_TRUE(logger.open(file, format));
+      for(const auto& sample: samples)
+        {
+          /* the small queue: wait for the writer, instead of dropping */
+          while(!logger.push(sample)) std::this_thread::yield();
+        }
+      logger.close();
+      EXPECT_FALSE(logger.push(samples.front()));
+      EXPECT_EQ(logger.getWriteCount(), samples.size());
+
+      std::vector<Sample> loaded;
+      ASSERT_TRUE(loadLog(file, loaded));
+      ASSERT_EQ(loaded.size(), samples.size());
+      double tolerance = (format == SampleLogger::BINARY) ? 0 : 1e-4;
+      for(int i = 0; i < samples.size(); i++)
+        {
+          EXPECT_EQ(loaded.at(i).pwm, samples.at(i).pwm);
+          EXPECT_EQ(loaded.at(i).phase, samples.at(i).phase);
+          EXPECT_NEAR(loaded.at(i).stamp, samples.at(i).stamp, tolerance);
+          EXPECT_NEAR(loaded.at(i).force_norm, samples.at(i).force_norm, tolerance);
+          EXPECT_NEAR(loaded.at(i).torque[2], samples.at(i).torque[2], tolerance);
+        }
+      std::remove(file.c_str());
+    }
+}
+
+TEST(SampleLoggerTest, Drop)
+{
+  /* the writer can not consume without the open file */
+  SampleLogger logger(16);
+  EXPECT_FALSE(logger.push(Sample()));
+  EXPECT_EQ(logger.getDropCount(), 0);
+
+  SpscQueue<int> queue(10);
+  EXPECT_EQ(queue.capacity(), 16);
+  for(int i = 0; i < 16; i++) EXPECT_TRUE(queue.push(i));
+  EXPECT_FALSE(queue.push(16));
+  int value;
+  for(int i = 0; i < 16; i++)
+    {
+      ASSERT_TRUE(queue.pop(value));
+      EXPECT_EQ(value, i);
+    }
+  EXPECT_FALSE(queue.pop(value));
+}
+
+TEST(SampleLoggerTest, LegacyLog)
+{
+  /* the text log before the csv format */
+  std::string file = tempFile("motor_test_legacy.txt");
+  {
+    std::ofstream ofs(file);
+    ofs << "1200 0.01 -0.02 3.5 3.50006 0.001 0.002 -0.06 1.2 raise\n";
+    ofs << "1200 0.01 -0.02 7.0 7.00003 0.001 0.002 -0.12 2.4 valid\n";
+    ofs << "1220 0.01 -0.02 7.5 7.50003 0.001 0.002 -0.13 2.5\n";
+    ofs << "done\n";
+  }
+
+  std::vector<Sample> samples;
+  ASSERT_TRUE(loadLog(file, samples));
+  ASSERT_EQ(samples.size(), 3);
+  EXPECT_EQ(samples.at(0).phase, Phase::RAISE);
+  EXPECT_EQ(samples.at(1).phase, Phase::VALID);
+  EXPECT_EQ(samples.at(2).phase, Phase::NONE);
+  EXPECT_EQ(samples.at(2).pwm, 1220);
+  EXPECT_FLOAT_EQ(samples.at(1).force_norm, 7.00003);
+  EXPECT_FLOAT_EQ(samples.at(1).torque[2], -0.12);
+  std::remove(file.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -34,24 +34,45 @@ void Servo::sendData()
 	}
 }
 
+void Servo::setTargetAngle(unsigned int index, const uint8_t* data)
+{
+	ServoData& s = servo_handler_.getServo()[index];
+	//convert int15 to int32
+	int sign = data[1] & 0x40;
+	int32_t goal_pos = ((data[1]  & 0x7F) << 8) | data[0];
+	if (sign != 0) {
+		goal_pos = 0xFFFF8000 | goal_pos;
+	}
+	s.setGoalPosition(goal_pos);
+	bool torque_enable = (((data[1] >> 7) & 0x01) != 0) ? true : false;
+	if (s.torque_enable_ != torque_enable) {
+		s.torque_enable_ = torque_enable;
+		servo_handler_.setTorque(index);
+	}
+}
+
 void Servo::receiveDataCallback(uint8_t message_id, uint32_t DLC, uint8_t* data)
 {
 	switch (message_id) {
 		case CAN::MESSAGEID_RECEIVE_SERVO_ANGLE:
 		{
 			for (unsigned int i = 0; i < servo_handler_.getServoNum(); i++) {
-				ServoData& s = servo_handler_.getServo()[i];
-				//convert int15 to int32
-				int sign = data[i * 2 + 1] & 0x40;
-				int32_t goal_pos = ((data[i * 2 + 1]  & 0x7F) << 8) | data[i * 2];
-				if (sign != 0) {
-					goal_pos = 0xFFFF8000 | goal_pos;
-				}
-				s.setGoalPosition(goal_pos);
-				bool torque_enable = (((data[i * 2 + 1] >> 7) & 0x01) != 0) ? true : false;
-				if (s.torque_enable_ != torque_enable) {
-					s.torque_enable_ = torque_enable;
-					servo_handler_.setTorque(i);
+				setTargetAngle(i, data + i * 2);
+			}
+			break;
+		}
+		case CAN::MESSAGEID_RECEIVE_SERVO_ANGLE_MUX:
+		{
+			//groups of [slave id(4bit) | servo mask(4bit)] and the target angles of the servos in the mask
+			unsigned int i = 0;
+			while (i < DLC) {
+				uint8_t slave_id = data[i] >> 4;
+				uint8_t mask = data[i] & 0x0F;
+				i++;
+				for (unsigned int j = 0; j < 4 && i + 2 <= DLC; j++) {
+					if (!(mask & (1 << j))) continue;
+					if (slave_id == m_slave_id && j < servo_handler_.getServoNum()) setTargetAngle(j, data + i);
+					i += 2;
 				}
 			}
 			break;
@@ -36,6 +36,7 @@ private:
 	};
 
 	DynamixelSerial servo_handler_;
+	void setTargetAngle(unsigned int index, const uint8_t* data);
 	friend class Initializer;
 };
 
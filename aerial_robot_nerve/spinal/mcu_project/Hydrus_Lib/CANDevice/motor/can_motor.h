@@ -33,6 +33,7 @@ public:
 	void sendData() override;
 	void receiveDataCallback(uint8_t slave_id, uint8_t message_id, uint32_t DLC, uint8_t* data) override;
 	void addMotor(CANMotor& motor) {can_motor_.push_back(motor);}
+	unsigned int getMotorNum() const {return can_motor_.size();}
 };
 
 
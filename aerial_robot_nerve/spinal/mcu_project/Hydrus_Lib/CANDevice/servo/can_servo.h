@@ -45,6 +45,7 @@ public:
 	uint8_t getMoving() const {return moving_;}
 	uint8_t getError() const {return error_;}
 	bool getTorqueEnable() const {return torque_enable_;}
+	uint16_t getTargetAngle() const {return ((torque_enable_ ? 1 : 0) << 15) | (goal_position_ & 0x7FFF);}
 	void setIndex(uint8_t index) {index_ = index;}
 	void setGoalPosition(int16_t goal_position) {goal_position_ = goal_position;}
 	void setTorqueEnable(bool torque_enable) {torque_enable_ = torque_enable;}
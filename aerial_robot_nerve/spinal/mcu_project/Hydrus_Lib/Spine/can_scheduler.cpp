@@ -0,0 +1,281 @@
+/**
+******************************************************************************
+* File Name          : can_scheduler.cpp
+* Description        : bus load aware schedule of the spine side CAN frames
+******************************************************************************
+*/
+
+#include "can_scheduler.h"
+#include <algorithm>
+
+constexpr uint8_t CANScheduler::MAX_SERVO_NUM;
+constexpr uint16_t CANScheduler::MAX_TELEMETRY_RATE;
+
+CANScheduler::CANScheduler():
+	motor_(nullptr), tick_bits_(0), max_budget_(0), budget_(0), motor_bits_(0), motor_frame_num_(0), motor_period_(1), last_motor_time_(0),
+	telemetry_rate_(0), poll_per_tick_(0), poll_credit_(0), poll_index_(0), utilization_(0), servo_latency_bound_(0), deadline_miss_count_(0), started_(false)
+{
+}
+
+void CANScheduler::init(const Config& config, CANMotorSendDevice* motor)
+{
+	config_ = config;
+	motor_ = motor;
+	neuron_.clear();
+}
+
+void CANScheduler::addNeuron(CANServo& servo, uint8_t response_servo_num, bool imu_send)
+{
+	NeuronSchedule neuron;
+	neuron.servo = &servo;
+	/* servo target frame, servo states (8byte) and gyro / acc / mag (6byte) */
+	neuron.poll_bits = frameBits(std::min<unsigned int>(servo.servo_.size(), MAX_SERVO_NUM) * 2)
+		+ std::min<uint8_t>(response_servo_num, MAX_SERVO_NUM) * frameBits(8) + (imu_send ? 3 * frameBits(6) : 0);
+	neuron.pending = 0;
+	for (uint8_t i = 0; i < MAX_SERVO_NUM; i++) {
+		neuron.sent[i] = 0;
+		neuron.since[i] = 0;
+	}
+	neuron_.push_back(neuron);
+}
+
+void CANScheduler::estimateServoBurst(uint16_t& frame_num, uint32_t& bits) const
+{
+	frame_num = 0;
+	bits = 0;
+	uint8_t dlc = 8;
+	for (const auto& neuron : neuron_) {
+		unsigned int remain = std::min<unsigned int>(neuron.servo->servo_.size(), MAX_SERVO_NUM);
+		while (remain > 0) {
+			if (dlc + 3 > 8) {
+				if (frame_num > 0) bits += frameBits(dlc);
+				frame_num++;
+				dlc = 0;
+			}
+			unsigned int n = std::min<unsigned int>(remain, (8 - dlc - 1) / 2);
+			dlc += 1 + 2 * n;
+			remain -= n;
+		}
+	}
+	if (frame_num > 0) bits += frameBits(dlc);
+}
+
+void CANScheduler::dryRun(float telemetry_rate, uint16_t burst_frame_num, uint16_t burst_bits, float& poll_rate, uint16_t& servo_latency) const
+{
+	/* the rules of send() for one second: all targets change at the servo rate, and the average poll */
+	uint32_t poll_bits = 0;
+	for (const auto& neuron : neuron_) poll_bits += neuron.poll_bits;
+	if (!neuron_.empty()) poll_bits /= neuron_.size();
+	uint16_t frame_bits = burst_frame_num > 0 ? (burst_bits + burst_frame_num - 1) / burst_frame_num : 0;
+	uint16_t servo_period = config_.servo.rate > 0 ? std::max<uint16_t>(1000 / config_.servo.rate, config_.tick) : 1000;
+	float poll_per_tick = telemetry_rate * neuron_.size() * config_.tick / 1000.0f;
+
+	int32_t budget = 0;
+	float credit = 0;
+	int remain = 0;
+	uint32_t burst_start = 0;
+	uint32_t poll_num = 0;
+	servo_latency = 0;
+	for (uint32_t t = 0; t < 1000; t += config_.tick) {
+		budget = std::min(budget + tick_bits_, max_budget_);
+		int mailbox = config_.tx_mailbox_num;
+		if (motor_frame_num_ > 0 && t % motor_period_ == 0) {
+			mailbox -= motor_frame_num_;
+			budget -= motor_bits_;
+		}
+
+		if (t % servo_period == 0 && remain == 0) {
+			remain = burst_frame_num;
+			burst_start = t;
+		}
+		if (remain > 0) {
+			while (remain > 0 && mailbox > 0 && budget > 0) {
+				remain--;
+				mailbox--;
+				budget -= frame_bits;
+			}
+			/* changed just after the previous send(), and not drained before the next change is the miss of the rate */
+			if (remain == 0) servo_latency = std::max<uint16_t>(servo_latency, t - burst_start + config_.tick);
+			else if (t - burst_start >= servo_period) servo_latency = 1000;
+		}
+
+		if (neuron_.empty()) continue;
+		credit = std::min(credit + poll_per_tick, static_cast<float>(neuron_.size()));
+		while (credit >= 1.0f && mailbox > 0 && budget >= static_cast<int32_t>(poll_bits)) {
+			credit -= 1.0f;
+			mailbox--;
+			budget -= poll_bits;
+			poll_num++;
+		}
+	}
+	poll_rate = neuron_.empty() ? 0 : static_cast<float>(poll_num) / neuron_.size() * 1000.0f / (1000 / config_.tick * config_.tick);
+}
+
+bool CANScheduler::configure()
+{
+	float bus_bits = static_cast<float>(config_.bitrate) * config_.max_utilization; // [bit/s]
+	tick_bits_ = static_cast<int32_t>(bus_bits * config_.tick / 1000.0f);
+
+	/* motor */
+	motor_frame_num_ = 0;
+	if (motor_ != nullptr && motor_->getMotorNum() > 0) motor_frame_num_ = motor_->getMotorNum() > 6 ? 2 : 1;
+	motor_bits_ = motor_frame_num_ * frameBits(8);
+	motor_period_ = std::max(config_.tick, static_cast<uint8_t>(1));
+	if (config_.motor.rate > 0) motor_period_ = std::max<uint16_t>(motor_period_, 1000 / config_.motor.rate);
+	float motor_rate = motor_frame_num_ > 0 ? 1000.0f / motor_period_ : 0;
+	bool feasible = motor_frame_num_ == 0 || motor_period_ <= config_.motor.deadline;
+
+	/* servo: the worst case is the change of all targets at once */
+	uint16_t burst_frame_num;
+	uint32_t burst_bits;
+	estimateServoBurst(burst_frame_num, burst_bits);
+	float used_bits = motor_rate * motor_bits_ + static_cast<float>(config_.servo.rate) * burst_bits;
+	if (used_bits > bus_bits) feasible = false;
+
+	uint16_t max_poll_bits = 0;
+	float poll_bits = 0;
+	for (const auto& neuron : neuron_) {
+		max_poll_bits = std::max(max_poll_bits, neuron.poll_bits);
+		poll_bits += neuron.poll_bits;
+	}
+	max_budget_ = tick_bits_ + std::max<int32_t>(tick_bits_, max_poll_bits);
+
+	/* telemetry in the rest of the bandwidth, then as many polls as the mailboxes and the budget of each tick allow */
+	float rate = 0;
+	if (poll_bits > 0) rate = std::max(std::min<float>(config_.telemetry_rate, (bus_bits - used_bits) / poll_bits), 0.0f);
+	dryRun(rate, burst_frame_num, std::min<uint32_t>(burst_bits, 0xFFFF), telemetry_rate_, servo_latency_bound_);
+	if (servo_latency_bound_ > config_.servo.deadline) feasible = false;
+
+	poll_per_tick_ = telemetry_rate_ * neuron_.size() * config_.tick / 1000.0f;
+	utilization_ = config_.bitrate > 0 ? (used_bits + telemetry_rate_ * poll_bits) / config_.bitrate : 0;
+
+	budget_ = 0;
+	poll_credit_ = 0;
+	poll_index_ = 0;
+	deadline_miss_count_ = 0;
+	started_ = false;
+	return feasible;
+}
+
+void CANScheduler::send(uint32_t now)
+{
+	budget_ = std::min(budget_ + tick_bits_, max_budget_);
+	/* the frames of the last tick can be still pending, e.g. after the retransmission */
+	int mailbox = std::min(CAN::getFreeTxMailbox(), static_cast<int>(config_.tx_mailbox_num));
+
+	/* motor pwm first, which also wins the arbitration by the lowest identifier */
+	if (motor_frame_num_ > 0 && mailbox >= motor_frame_num_ && (!started_ || now - last_motor_time_ >= motor_period_)) {
+		motor_->sendData();
+		mailbox -= motor_frame_num_;
+		budget_ -= motor_bits_;
+		last_motor_time_ = now;
+	}
+
+	updatePending(now);
+	started_ = true;
+
+	/* changed targets, the earliest deadline first */
+	while (mailbox > 0 && budget_ > 0 && oldestPending(0) >= 0) {
+		sendServoMux(now);
+		mailbox--;
+	}
+
+	/* telemetry: poll the neurons in turn by their own servo target frame, the credit catches up after the motor ticks */
+	if (neuron_.empty()) return;
+	poll_credit_ = std::min(poll_credit_ + poll_per_tick_, static_cast<float>(neuron_.size()));
+	while (poll_credit_ >= 1.0f && mailbox > 0 && budget_ >= neuron_.at(poll_index_).poll_bits) {
+		sendPoll(now);
+		poll_credit_ -= 1.0f;
+		mailbox--;
+	}
+}
+
+void CANScheduler::updatePending(uint32_t now)
+{
+	for (auto& neuron : neuron_) {
+		for (unsigned int i = 0; i < neuron.servo->servo_.size() && i < MAX_SERVO_NUM; i++) {
+			uint16_t target = neuron.servo->servo_.at(i).getTargetAngle();
+			uint8_t bit = 1 << i;
+			if (!started_) {
+				/* the neurons have no target yet */
+				neuron.pending |= bit;
+				neuron.since[i] = now;
+			} else if (target == neuron.sent[i]) {
+				neuron.pending &= ~bit;
+			} else if (!(neuron.pending & bit)) {
+				neuron.pending |= bit;
+				neuron.since[i] = now;
+			}
+		}
+	}
+}
+
+int CANScheduler::oldestPending(uint32_t exclude) const
+{
+	int oldest = -1;
+	uint32_t oldest_since = 0;
+	for (unsigned int j = 0; j < neuron_.size(); j++) {
+		if (j < 32 && (exclude & (1u << j))) continue;
+		const NeuronSchedule& neuron = neuron_.at(j);
+		for (uint8_t i = 0; i < MAX_SERVO_NUM; i++) {
+			if (!(neuron.pending & (1 << i))) continue;
+			if (oldest < 0 || static_cast<int32_t>(neuron.since[i] - oldest_since) < 0) {
+				oldest = j;
+				oldest_since = neuron.since[i];
+			}
+		}
+	}
+	return oldest;
+}
+
+void CANScheduler::markSent(NeuronSchedule& neuron, uint8_t mask, uint32_t now)
+{
+	for (uint8_t i = 0; i < MAX_SERVO_NUM; i++) {
+		if (!(mask & (1 << i))) continue;
+		neuron.sent[i] = neuron.servo->servo_.at(i).getTargetAngle();
+		if ((neuron.pending & (1 << i)) && now - neuron.since[i] >= config_.servo.deadline) deadline_miss_count_++;
+	}
+	neuron.pending &= ~mask;
+}
+
+void CANScheduler::sendServoMux(uint32_t now)
+{
+	uint8_t data[8];
+	uint8_t dlc = 0;
+	uint32_t in_frame = 0;
+
+	/* one group per neuron, the rest of a split group waits for the next frame */
+	while (dlc + 3 <= 8) {
+		int j = oldestPending(in_frame);
+		if (j < 0) break;
+		if (j < 32) in_frame |= 1u << j;
+
+		NeuronSchedule& neuron = neuron_.at(j);
+		uint8_t header = dlc++;
+		uint8_t mask = 0;
+		for (uint8_t i = 0; i < MAX_SERVO_NUM && dlc + 2 <= 8; i++) {
+			if (!(neuron.pending & (1 << i))) continue;
+			uint16_t target = neuron.servo->servo_.at(i).getTargetAngle();
+			data[dlc++] = target & 0xFF;
+			data[dlc++] = (target >> 8) & 0xFF;
+			mask |= 1 << i;
+		}
+		data[header] = ((neuron.servo->getSlaveId() & ((1 << CAN::SLAVE_ID_LEN) - 1)) << 4) | mask;
+		markSent(neuron, mask, now);
+	}
+
+	CAN::setMessage(CAN::DEVICEID_SERVO, CAN::MESSAGEID_RECEIVE_SERVO_ANGLE_MUX, CAN::BROADCAST_ID, dlc, data);
+	CAN::sendMessage(0);
+	budget_ -= frameBits(dlc);
+}
+
+void CANScheduler::sendPoll(uint32_t now)
+{
+	NeuronSchedule& neuron = neuron_.at(poll_index_);
+	/* the frame also refreshes all targets of the neuron */
+	neuron.servo->sendData();
+	markSent(neuron, (1 << std::min<unsigned int>(neuron.servo->servo_.size(), MAX_SERVO_NUM)) - 1, now);
+	budget_ -= neuron.poll_bits;
+	poll_index_++;
+	if (poll_index_ == neuron_.size()) poll_index_ = 0;
+}
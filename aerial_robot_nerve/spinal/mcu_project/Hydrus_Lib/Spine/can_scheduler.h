@@ -0,0 +1,102 @@
+/**
+******************************************************************************
+* File Name          : can_scheduler.h
+* Description        : bus load aware schedule of the spine side CAN frames:
+*                      motor pwm first, the changed servo targets of all neurons
+*                      packed into the multiplexed frames, and the telemetry polls
+*                      (servo states and imu) in the remaining bandwidth
+******************************************************************************
+*/
+
+#ifndef APPLICATION_HYDRUS_LIB_SPINE_CAN_SCHEDULER_H_
+#define APPLICATION_HYDRUS_LIB_SPINE_CAN_SCHEDULER_H_
+
+#include "CAN/can_core.h"
+#include "CANDevice/motor/can_motor.h"
+#include "CANDevice/servo/can_servo.h"
+#include <vector>
+
+/* Multiplexed servo target frame (MESSAGEID_RECEIVE_SERVO_ANGLE_MUX, BROADCAST_ID):
+ * groups of [slave id (7~4bit) | servo mask (3~0bit)] followed by the target angle (2byte)
+ * of each servo in the mask, in the ascending order of the servo index.
+ * Unlike MESSAGEID_RECEIVE_SERVO_ANGLE, the neurons do not reply to this frame.
+ */
+
+class CANScheduler
+{
+public:
+	struct Requirement
+	{
+		uint16_t rate; // [Hz]
+		uint16_t deadline; // [ms]
+	};
+
+	static constexpr uint16_t MAX_TELEMETRY_RATE = 0xFFFF; // as high as the bus allows
+
+	struct Config
+	{
+		uint32_t bitrate = 1000000;
+		float max_utilization = 0.8f; // the rest is for the retransmission
+		uint8_t tick = 1; // [ms] period of send()
+		uint8_t tx_mailbox_num = 3;
+		Requirement motor = {500, 2};
+		Requirement servo = {100, 10}; // rate of the new targets, deadline from the change to the transmission
+		uint16_t telemetry_rate = MAX_TELEMETRY_RATE; // [Hz] per neuron, upper limit, 0: no telemetry
+	};
+
+	static constexpr uint8_t MAX_SERVO_NUM = 4;
+
+	CANScheduler();
+	void init(const Config& config, CANMotorSendDevice* motor);
+	/* the servos with the send data flag and the imu reply to the poll */
+	void addNeuron(CANServo& servo, uint8_t response_servo_num, bool imu_send);
+	/* admission: lower the telemetry rate to fit the bus, false if the motor or the servo deadline is not met */
+	bool configure();
+	void send(uint32_t now /* ms */);
+
+	float getTelemetryRate() const {return telemetry_rate_;}
+	float getUtilization() const {return utilization_;} // planned
+	uint16_t getServoLatencyBound() const {return servo_latency_bound_;} // [ms] all targets changed at once
+	uint32_t getDeadlineMissCount() const {return deadline_miss_count_;}
+
+	/* worst case length including the stuff bits and the interframe space */
+	static uint16_t frameBits(uint8_t dlc) {return 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4;}
+
+private:
+	struct NeuronSchedule
+	{
+		CANServo* servo;
+		uint16_t poll_bits; // poll and the response
+		uint16_t sent[MAX_SERVO_NUM]; // target on the bus
+		uint32_t since[MAX_SERVO_NUM]; // first unsent change
+		uint8_t pending; // mask of the changed targets
+	};
+
+	Config config_;
+	CANMotorSendDevice* motor_;
+	std::vector<NeuronSchedule> neuron_;
+
+	int32_t tick_bits_, max_budget_, budget_;
+	uint16_t motor_bits_;
+	uint8_t motor_frame_num_;
+	uint16_t motor_period_; // [ms]
+	uint32_t last_motor_time_;
+	float telemetry_rate_, poll_per_tick_, poll_credit_;
+	unsigned int poll_index_;
+	float utilization_;
+	uint16_t servo_latency_bound_;
+	uint32_t deadline_miss_count_;
+	bool started_;
+
+	void updatePending(uint32_t now);
+	int oldestPending(uint32_t exclude) const;
+	void markSent(NeuronSchedule& neuron, uint8_t mask, uint32_t now);
+	void sendServoMux(uint32_t now);
+	void sendPoll(uint32_t now);
+	/* number and bits of the multiplexed frames for the change of all targets */
+	void estimateServoBurst(uint16_t& frame_num, uint32_t& bits) const;
+	/* polls per neuron and the worst servo latency with the rules of send() */
+	void dryRun(float telemetry_rate, uint16_t burst_frame_num, uint16_t burst_bits, float& poll_rate, uint16_t& servo_latency) const;
+};
+
+#endif /* APPLICATION_HYDRUS_LIB_SPINE_CAN_SCHEDULER_H_ */
@@ -17,6 +17,8 @@ namespace Spine
     std::vector<std::reference_wrapper<Servo>> servo_;
     std::vector<std::reference_wrapper<Servo>> servo_with_send_flag_;
     CANInitializer can_initializer_(neuron_);
+    CANScheduler can_scheduler_;
+    bool can_schedule_feasible_ = true;
     std::vector<float> imu_weight_;
 
     uint8_t slave_num_;
@@ -154,6 +156,18 @@ namespace Spine
     }
     slave_num_ = neuron_.size();
 
+    /* CAN schedule: hcan1 is 1Mbps (54MHz / 6 / 9), the servo states and imu are polled in the rest of the bandwidth, up to TELEMETRY_RATE per neuron */
+    CANScheduler::Config can_schedule_config;
+    can_schedule_config.bitrate = 1000000;
+    can_schedule_config.telemetry_rate = TELEMETRY_RATE;
+    can_scheduler_.init(can_schedule_config, &can_motor_send_device_);
+    for (unsigned int i = 0; i < neuron_.size(); i++) {
+    	uint8_t response_servo_num = std::count_if(neuron_.at(i).can_servo_.servo_.begin(), neuron_.at(i).can_servo_.servo_.end(),
+    	                                           [](const Servo& s) {return s.getSendDataFlag();});
+    	can_scheduler_.addNeuron(neuron_.at(i).can_servo_, response_servo_num, neuron_.at(i).can_imu_.getSendDataFlag());
+    }
+    can_schedule_feasible_ = can_scheduler_.configure();
+
     if(slave_num_  == 0) return;
 
     /* uav model: special rule based on the number of gimbals (no send data flag servos) */
@@ -184,9 +198,8 @@ namespace Spine
     imu_weight_.resize(slave_num_ + 1);
 
     /* set IMU weights */
-    // no fusion
-    imu_weight_[0] = 1.0;
-    for (uint i = 1; i < imu_weight_.size(); i++) imu_weight_[i] = 0.0;
+    // the neuron imus are fused after the link poses from ros (imu_link_poses), weighted by the noise
+    for (uint i = 0; i < imu_weight_.size(); i++) imu_weight_[i] = 1.0;
 
     estimator_->getAttEstimator()->setImuWeight(0, imu_weight_[0]);
     for (int i = 0; i < slave_num_; i++) {
@@ -211,19 +224,11 @@ namespace Spine
 
   void send()
   {
-	static int send_board_index = 0;
 	if (can_idle_count_ > 0) {
 		can_idle_count_--;
 		return;
 	}
-	if(HAL_GetTick() % 2 == 0) {
-	  can_motor_send_device_.sendData();
-	  if (slave_num_ != 0) {
-		  neuron_.at(send_board_index).can_servo_.sendData();
-		  send_board_index++;
-		  if (send_board_index == slave_num_) send_board_index = 0;
-	  }
-    }
+	can_scheduler_.send(HAL_GetTick());
   }
 
   void update(void)
@@ -284,6 +289,12 @@ namespace Spine
 
    if(CANDeviceManager::connected()) last_connected_time_ = now_time;
 
+    if(!can_schedule_feasible_ && nh_->connected())
+    {
+    	nh_->logwarn("CAN schedule does not meet the motor / servo deadline");
+    	can_schedule_feasible_ = true;
+    }
+
     if(now_time - last_connected_time_ > 1000 /* ms */)
     {
     	if(nh_->connected()) nh_->logerror("CAN is not connected");
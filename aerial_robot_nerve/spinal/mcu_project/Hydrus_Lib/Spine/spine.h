@@ -13,6 +13,7 @@
 #include <CAN/can_device_manager.h>
 #include <sensors/imu/imu_ros_cmd.h>
 #include <Neuron/neuron.h>
+#include <Spine/can_scheduler.h>
 
 /* state estimate  */
 #include <state_estimate/state_estimate.h>
@@ -36,6 +37,7 @@
 #include <functional>
 
 #define SEND_GYRO 0
+#define TELEMETRY_RATE CANScheduler::MAX_TELEMETRY_RATE // [Hz] per neuron, upper limit of the servo states and imu polls
 
 // main subrutine for update enach instance
 namespace Spine
@@ -0,0 +1,290 @@
+/**
+******************************************************************************
+* File Name          : can_bus_sim.cpp
+* Description        : host (SIMULATION) back end of the CAN core
+******************************************************************************
+*/
+
+#include "can_bus_sim.h"
+#include <algorithm>
+#include <string.h>
+
+namespace can_sim {
+
+	namespace {
+		Bus* bus_ = nullptr;
+
+		/* stuffed part: SOF, ID, RTR, IDE, r0, DLC, DATA, CRC */
+		void appendBits(std::vector<bool>& bits, uint32_t value, int len)
+		{
+			for (int i = len - 1; i >= 0; i--) bits.push_back((value >> i) & 1);
+		}
+	}
+
+	int frameBits(const Frame& frame)
+	{
+		std::vector<bool> bits;
+		bits.reserve(34 + 64);
+		bits.push_back(0); // SOF
+		appendBits(bits, frame.std_id & 0x7FF, 11);
+		appendBits(bits, 0, 3); // RTR, IDE, r0
+		int dlc = std::min<int>(frame.dlc, 8);
+		appendBits(bits, dlc, 4);
+		for (int i = 0; i < dlc; i++) appendBits(bits, frame.data[i], 8);
+
+		uint16_t crc = 0;
+		for (bool bit : bits) {
+			bool crc_next = bit ^ ((crc >> 14) & 1);
+			crc = (crc << 1) & 0x7FFF;
+			if (crc_next) crc ^= 0x4599;
+		}
+		appendBits(bits, crc, 15);
+
+		/* a complementary bit after five consecutive identical bits, which also counts for the next run */
+		int stuff = 0, run = 0;
+		bool prev = true;
+		for (bool bit : bits) {
+			if (run > 0 && bit == prev) run++;
+			else run = 1;
+			prev = bit;
+			if (run == 5) {
+				stuff++;
+				prev = !bit;
+				run = 1;
+			}
+		}
+
+		/* CRC delimiter, ACK slot, ACK delimiter, EOF(7), interframe space(3) */
+		return static_cast<int>(bits.size()) + stuff + 13;
+	}
+
+	Bus::Bus(const BusConfig& config):
+		config_(config), event_seq_(0), now_(0), bit_time_(1000000000ULL / config.bitrate),
+		busy_(false), busy_time_(0), stat_start_(0), error_frames_(0), engine_(config.seed), uniform_(0.0, 1.0)
+	{
+	}
+
+	int Bus::addNode(RxCallback rx, const NodeConfig& config)
+	{
+		Node node;
+		node.config = config;
+		node.rx_callback = rx;
+		nodes_.push_back(node);
+		return static_cast<int>(nodes_.size()) - 1;
+	}
+
+	void Bus::addFilter(int node, uint32_t id, uint32_t mask)
+	{
+		nodes_.at(node).filters.push_back(std::make_pair(id, mask));
+	}
+
+	bool Bus::accept(const Node& node, uint32_t std_id) const
+	{
+		if (node.filters.empty()) return true;
+		uint32_t id = std_id << 21;
+		for (const auto& filter : node.filters) {
+			if (((id ^ filter.first) & filter.second) == 0) return true;
+		}
+		return false;
+	}
+
+	bool Bus::transmit(int node, const Frame& frame)
+	{
+		Node& n = nodes_.at(node);
+		n.stat.tx_request++;
+		if (static_cast<int>(n.mailbox.size()) >= n.config.tx_mailbox_num) {
+			n.stat.tx_no_mailbox++;
+			return false;
+		}
+
+		Mailbox mailbox;
+		mailbox.frame = frame;
+		mailbox.request_time = now_;
+		n.mailbox.push_back(mailbox);
+
+		if (!busy_) arbitrate();
+		return true;
+	}
+
+	void Bus::schedule(Time t, std::function<void()> event)
+	{
+		Event e;
+		e.t = std::max(t, now_);
+		e.seq = event_seq_++;
+		e.func = event;
+		events_.push(e);
+	}
+
+	void Bus::runUntil(Time t)
+	{
+		while (!events_.empty() && events_.top().t <= t) {
+			Event e = events_.top();
+			events_.pop();
+			now_ = e.t;
+			e.func();
+		}
+		now_ = std::max(now_, t);
+	}
+
+	void Bus::arbitrate()
+	{
+		/* the lowest identifier wins, also among the mailboxes of one node (TXFP = 0) */
+		int winner = -1;
+		size_t winner_mailbox = 0;
+		for (size_t i = 0; i < nodes_.size(); i++) {
+			const std::vector<Mailbox>& mailbox = nodes_.at(i).mailbox;
+			for (size_t j = 0; j < mailbox.size(); j++) {
+				if (winner < 0 || mailbox.at(j).frame.std_id < nodes_.at(winner).mailbox.at(winner_mailbox).frame.std_id) {
+					winner = i;
+					winner_mailbox = j;
+				}
+			}
+		}
+		if (winner < 0) return;
+
+		busy_ = true;
+		int bits = frameBits(nodes_.at(winner).mailbox.at(winner_mailbox).frame);
+		bool error = config_.error_rate > 0 && uniform_(engine_) < config_.error_rate;
+		if (error) {
+			/* error flag(6), error delimiter(8) and interframe space(3) after the corrupted bit */
+			bits = std::uniform_int_distribution<int>(1, bits - 13)(engine_) + 17;
+		}
+
+		Time start = now_;
+		Time duration = bits * bit_time_;
+		schedule(start + duration, [this, winner, winner_mailbox, error, duration]() {
+				busy_time_ += duration;
+				endOfFrame(winner, winner_mailbox, error);
+			});
+	}
+
+	void Bus::endOfFrame(int node, size_t mailbox, bool error)
+	{
+		Node& sender = nodes_.at(node);
+
+		if (error) {
+			error_frames_++;
+			if (!config_.auto_retransmission) {
+				sender.mailbox.erase(sender.mailbox.begin() + mailbox);
+				sender.stat.tx_error_lost++;
+			}
+			busy_ = false;
+			arbitrate();
+			return;
+		}
+
+		Mailbox done = sender.mailbox.at(mailbox);
+		sender.mailbox.erase(sender.mailbox.begin() + mailbox);
+		sender.stat.tx_done++;
+
+		DeviceStat& stat = device_stat_[(done.frame.std_id >> 8) & 0x07];
+		Time latency = now_ - done.request_time;
+		stat.frames++;
+		stat.latency_sum += latency;
+		stat.latency_max = std::max(stat.latency_max, latency);
+
+		/* still busy during the delivery, so that the responses in the callbacks compete in the next arbitration */
+		for (size_t i = 0; i < nodes_.size(); i++) {
+			if (static_cast<int>(i) == node) continue;
+			if (accept(nodes_.at(i), done.frame.std_id)) receive(i, done.frame);
+		}
+		if (sender.tx_callback) sender.tx_callback(done.frame, now_);
+
+		busy_ = false;
+		arbitrate();
+	}
+
+	void Bus::receive(int node, const Frame& frame)
+	{
+		Node& n = nodes_.at(node);
+		if (static_cast<int>(n.rx_fifo.size()) >= n.config.rx_fifo_depth) {
+			n.stat.rx_overrun++;
+			return;
+		}
+		n.rx_fifo.push_back(frame);
+		if (!n.rx_busy) serviceRx(node);
+	}
+
+	void Bus::serviceRx(int node)
+	{
+		Node& n = nodes_.at(node);
+		if (n.rx_fifo.empty()) {
+			n.rx_busy = false;
+			return;
+		}
+
+		/* the fifo slot is released at the beginning of the interrupt handler */
+		Frame frame = n.rx_fifo.front();
+		n.rx_fifo.pop_front();
+		n.stat.rx_frames++;
+		if (n.config.rx_service_time == 0) {
+			if (n.rx_callback) n.rx_callback(frame, now_);
+			serviceRx(node);
+			return;
+		}
+
+		n.rx_busy = true;
+		if (n.rx_callback) n.rx_callback(frame, now_);
+		schedule(now_ + n.config.rx_service_time, [this, node]() { serviceRx(node); });
+	}
+
+	void Bus::resetStat()
+	{
+		for (auto& node : nodes_) node.stat = NodeStat();
+		device_stat_.clear();
+		error_frames_ = 0;
+		busy_time_ = 0;
+		stat_start_ = now_;
+	}
+
+	void setBus(Bus* bus)
+	{
+		bus_ = bus;
+	}
+
+	Bus* getBus()
+	{
+		return bus_;
+	}
+};
+
+void HAL_CAN_Attach(CAN_HandleTypeDef* hcan, const can_sim::NodeConfig& config)
+{
+	hcan->node = can_sim::getBus()->addNode([hcan](const can_sim::Frame& frame, can_sim::Time /* t */) {
+			if (hcan->pRxMsg == nullptr) return;
+			hcan->pRxMsg->StdId = frame.std_id;
+			hcan->pRxMsg->IDE = CAN_ID_STD;
+			hcan->pRxMsg->RTR = CAN_RTR_DATA;
+			hcan->pRxMsg->DLC = frame.dlc;
+			memcpy(hcan->pRxMsg->Data, frame.data, sizeof(frame.data));
+			HAL_CAN_RxCpltCallback(hcan);
+		}, config);
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterConfTypeDef* sFilterConfig)
+{
+	if (sFilterConfig->FilterActivation != ENABLE) return HAL_OK;
+	uint32_t id = (sFilterConfig->FilterIdHigh << 16) | sFilterConfig->FilterIdLow;
+	uint32_t mask = (sFilterConfig->FilterMaskIdHigh << 16) | sFilterConfig->FilterMaskIdLow;
+	can_sim::getBus()->addFilter(hcan->node, id, mask);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Transmit(CAN_HandleTypeDef* hcan, uint32_t /* Timeout */)
+{
+	can_sim::Frame frame;
+	frame.std_id = hcan->pTxMsg->StdId & 0x7FF;
+	frame.dlc = std::min<uint32_t>(hcan->pTxMsg->DLC, 8);
+	memcpy(frame.data, hcan->pTxMsg->Data, sizeof(frame.data));
+	return can_sim::getBus()->transmit(hcan->node, frame) ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_CAN_Receive_IT(CAN_HandleTypeDef* /* hcan */, uint8_t /* FIFONumber */)
+{
+	return HAL_OK;
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+	if (GPIOx != nullptr) GPIOx->ODR ^= GPIO_Pin;
+}
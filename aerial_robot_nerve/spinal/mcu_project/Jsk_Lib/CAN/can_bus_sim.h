@@ -0,0 +1,235 @@
+/**
+******************************************************************************
+* File Name          : can_bus_sim.h
+* Description        : host (SIMULATION) back end of the CAN core: in-memory bus model
+*                      with bit timing, arbitration by ID, tx mailboxes, rx fifo and error injection,
+*                      and the subset of the HAL CAN api used by can_core / can_device_manager
+******************************************************************************
+*/
+
+#ifndef APPLICATION_CAN_CAN_BUS_SIM_H_
+#define APPLICATION_CAN_CAN_BUS_SIM_H_
+
+#ifndef SIMULATION
+#error "can_bus_sim.h is only for the host build"
+#endif
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace can_sim {
+	typedef uint64_t Time; // [ns]
+
+	struct Frame
+	{
+		uint32_t std_id;
+		uint8_t dlc;
+		uint8_t data[8];
+	};
+
+	/* number of bits on the wire of a standard data frame, including the stuff bits, the eof and the interframe space */
+	int frameBits(const Frame& frame);
+
+	struct BusConfig
+	{
+		uint32_t bitrate = 1000000; // hcan1 of spinal: 54MHz / 6 / (1 + 4 + 4)
+		double error_rate = 0.0; // probability that a transmission is destroyed by an error frame
+		bool auto_retransmission = true; // false: NART mode, the destroyed frame is lost
+		unsigned int seed = 1;
+	};
+
+	struct NodeConfig
+	{
+		int tx_mailbox_num = 3; // bxCAN
+		int rx_fifo_depth = 3;
+		Time rx_service_time = 0; // time of the rx interrupt handler, 0: immediate
+	};
+
+	struct DeviceStat
+	{
+		uint64_t frames = 0; // delivered on the bus
+		Time latency_sum = 0; // from the mailbox to the end of frame
+		Time latency_max = 0;
+	};
+
+	struct NodeStat
+	{
+		uint64_t tx_request = 0;
+		uint64_t tx_done = 0;
+		uint64_t tx_no_mailbox = 0; // dropped since all mailboxes are pending
+		uint64_t tx_error_lost = 0; // destroyed without retransmission
+		uint64_t rx_frames = 0;
+		uint64_t rx_overrun = 0; // dropped since the rx fifo is full
+	};
+
+	class Bus
+	{
+	public:
+		typedef std::function<void(const Frame&, Time)> RxCallback;
+		typedef std::function<void(const Frame&, Time)> TxCallback;
+
+		explicit Bus(const BusConfig& config = BusConfig());
+
+		int addNode(RxCallback rx, const NodeConfig& config = NodeConfig());
+		void setTxCallback(int node, TxCallback tx) { nodes_.at(node).tx_callback = tx; }
+		/* 32bit id/mask filter of bxCAN, the frame is accepted if any filter matches, or there is no filter */
+		void addFilter(int node, uint32_t id, uint32_t mask);
+
+		/* put the frame into an empty tx mailbox, false if no mailbox is available */
+		bool transmit(int node, const Frame& frame);
+		int pendingTx(int node) const { return static_cast<int>(nodes_.at(node).mailbox.size()); }
+		int getFreeTxMailbox(int node) const { return nodes_.at(node).config.tx_mailbox_num - pendingTx(node); }
+
+		/* the software of the nodes (e.g. the timer interrupt of spinal) is executed as events */
+		void schedule(Time t, std::function<void()> event);
+		void runUntil(Time t);
+		Time now() const { return now_; }
+
+		double getUtilization() const { return now_ > stat_start_ ? static_cast<double>(busy_time_) / (now_ - stat_start_) : 0.0; }
+		Time getBusyTime() const { return busy_time_; }
+		uint64_t getErrorFrames() const { return error_frames_; }
+		const NodeStat& getNodeStat(int node) const { return nodes_.at(node).stat; }
+		/* per device id (10~8bit of the standard id) */
+		const std::map<uint8_t, DeviceStat>& getDeviceStat() const { return device_stat_; }
+		void resetStat();
+
+		const BusConfig& getConfig() const { return config_; }
+
+	private:
+		struct Mailbox
+		{
+			Frame frame;
+			Time request_time;
+		};
+
+		struct Node
+		{
+			NodeConfig config;
+			RxCallback rx_callback;
+			TxCallback tx_callback;
+			std::vector<std::pair<uint32_t, uint32_t> > filters;
+			std::vector<Mailbox> mailbox;
+			std::deque<Frame> rx_fifo;
+			bool rx_busy = false;
+			NodeStat stat;
+		};
+
+		struct Event
+		{
+			Time t;
+			uint64_t seq;
+			std::function<void()> func;
+			bool operator>(const Event& e) const { return t > e.t || (t == e.t && seq > e.seq); }
+		};
+
+		BusConfig config_;
+		std::vector<Node> nodes_;
+		std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events_;
+		uint64_t event_seq_;
+		Time now_;
+		Time bit_time_;
+		bool busy_;
+		Time busy_time_;
+		Time stat_start_;
+		uint64_t error_frames_;
+		std::map<uint8_t, DeviceStat> device_stat_;
+		std::mt19937 engine_;
+		std::uniform_real_distribution<double> uniform_;
+
+		bool accept(const Node& node, uint32_t std_id) const;
+		void arbitrate();
+		void endOfFrame(int node, size_t mailbox, bool error);
+		void receive(int node, const Frame& frame);
+		void serviceRx(int node);
+	};
+
+	/* the bus for the HAL api below */
+	void setBus(Bus* bus);
+	Bus* getBus();
+};
+
+/* HAL CAN api on top of can_sim::Bus */
+typedef enum
+{
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef struct
+{
+	uint32_t StdId;
+	uint32_t ExtId;
+	uint32_t IDE;
+	uint32_t RTR;
+	uint32_t DLC;
+	uint8_t Data[8];
+} CanTxMsgTypeDef;
+
+typedef struct
+{
+	uint32_t StdId;
+	uint32_t ExtId;
+	uint32_t IDE;
+	uint32_t RTR;
+	uint32_t DLC;
+	uint8_t Data[8];
+	uint32_t FMI;
+	uint32_t FIFONumber;
+} CanRxMsgTypeDef;
+
+typedef struct
+{
+	uint32_t FilterIdHigh;
+	uint32_t FilterIdLow;
+	uint32_t FilterMaskIdHigh;
+	uint32_t FilterMaskIdLow;
+	uint32_t FilterFIFOAssignment;
+	uint32_t FilterNumber;
+	uint32_t FilterMode;
+	uint32_t FilterScale;
+	uint32_t FilterActivation;
+	uint32_t BankNumber;
+} CAN_FilterConfTypeDef;
+
+typedef struct
+{
+	CanTxMsgTypeDef* pTxMsg;
+	CanRxMsgTypeDef* pRxMsg;
+	int node; // node of can_sim::getBus()
+} CAN_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t ODR;
+} GPIO_TypeDef;
+
+#define CAN_ID_STD ((uint32_t)0x00000000)
+#define CAN_RTR_DATA ((uint32_t)0x00000000)
+#define CAN_FIFO0 ((uint8_t)0x00)
+#define CAN_FIFO1 ((uint8_t)0x01)
+#define CAN_FILTER_FIFO1 ((uint8_t)0x01)
+#define CAN_FILTERMODE_IDMASK ((uint8_t)0x00)
+#define CAN_FILTERSCALE_32BIT ((uint8_t)0x01)
+#define ENABLE 1
+
+#ifndef __weak
+#define __weak __attribute__((weak))
+#endif
+
+/* add the node of hcan to the bus: the received frames are passed to HAL_CAN_RxCpltCallback() */
+void HAL_CAN_Attach(CAN_HandleTypeDef* hcan, const can_sim::NodeConfig& config = can_sim::NodeConfig());
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterConfTypeDef* sFilterConfig);
+/* the timeout is not simulated, the frame is put into a mailbox and the call returns immediately */
+HAL_StatusTypeDef HAL_CAN_Transmit(CAN_HandleTypeDef* hcan, uint32_t Timeout);
+HAL_StatusTypeDef HAL_CAN_Receive_IT(CAN_HandleTypeDef* hcan, uint8_t FIFONumber);
+void HAL_CAN_RxCpltCallback(CAN_HandleTypeDef* hcan);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+#endif /* APPLICATION_CAN_CAN_BUS_SIM_H_ */
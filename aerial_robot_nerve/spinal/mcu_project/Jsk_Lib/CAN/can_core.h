@@ -9,7 +9,11 @@
 #define APPLICATION_CAN_CAN_CORE_H_
 
 #include "stdint.h"
+#ifdef SIMULATION
+#include "can_bus_sim.h"
+#else
 #include "can.h"
+#endif
 #include "string.h"
 #include <vector>
 #include "can_constants.h"
@@ -23,6 +27,16 @@ namespace CAN {
 		HAL_CAN_Transmit(getHcanInstance(), timeout);
 	}
 
+	inline int getFreeTxMailbox()
+	{
+#ifdef SIMULATION
+		return can_sim::getBus()->getFreeTxMailbox(getHcanInstance()->node);
+#else
+		uint32_t tsr = getHcanInstance()->Instance->TSR;
+		return ((tsr & CAN_TSR_TME0) ? 1 : 0) + ((tsr & CAN_TSR_TME1) ? 1 : 0) + ((tsr & CAN_TSR_TME2) ? 1 : 0);
+#endif
+	}
+
 	inline void Receive_IT()
 	{
 		HAL_CAN_Receive_IT(getHcanInstance(), CAN_FIFO1);
@@ -27,7 +27,7 @@ namespace CANDeviceManager
 
 	int makeCommunicationId(uint8_t device_id, uint8_t slave_id)
 	{
-		return static_cast<int>((device_id << CAN::DEVICE_ID_LEN) | slave_id);
+		return static_cast<int>((device_id << CAN::SLAVE_ID_LEN) | slave_id);
 	}
 
 	void addDevice(CANDevice& device)
@@ -50,6 +50,14 @@ namespace CANDeviceManager
 		}
 	}
 
+#ifdef SIMULATION
+	void reset()
+	{
+		can_device_list.clear();
+		can_timeout_count = 0;
+	}
+#endif
+
 	bool connected(void)
 	{
 		if(can_timeout_count > CAN_MAX_TIMEOUT_COUNT) return false;
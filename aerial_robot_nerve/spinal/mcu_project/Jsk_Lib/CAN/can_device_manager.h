@@ -21,6 +21,9 @@ namespace CANDeviceManager
 	void Receive_IT();
 	void userSendMessages();
 	void userReceiveMessagesCallback(uint8_t slave_id, uint8_t device_id, uint8_t message_id, uint32_t DLC, uint8_t* data);
+#ifdef SIMULATION
+	void reset(); // remove all devices for the next host simulation
+#endif
 }
 
 #endif /* APPLICATION_CAN_CAN_DEVICE_MANAGER_H_ */
@@ -15,6 +15,7 @@ namespace FlashMemory {
 			Data (void* ptr, size_t size):ptr(ptr), size(size){}
 		};
 		std::vector<Data> data;
+		std::vector<Data> tail_data; // after all the values of addValue, regardless of the order of the registration
 		uint32_t m_data_address, m_data_sector;
 		constexpr int FLASH_TIMEOUT_VALUE = 50000; //50s
 	}
@@ -29,6 +30,11 @@ namespace FlashMemory {
 		data.push_back(tmp_data);
 	}
 
+	void addTailValue(void* ptr, size_t size){
+		Data tmp_data(ptr, size);
+		tail_data.push_back(tmp_data);
+	}
+
 	void read(){
 		HAL_StatusTypeDef status = HAL_ERROR;
 		status = FLASH_WaitForLastOperation((uint32_t)FLASH_TIMEOUT_VALUE);
@@ -39,6 +45,19 @@ namespace FlashMemory {
 				memcpy(data[i].ptr, reinterpret_cast<void*>(data_address), data[i].size);
 				data_address += data[i].size;
 			}
+
+			for (unsigned int i = 0; i != tail_data.size(); i++){
+				/* erased (never written by the older layout): keep the default value */
+				bool erased = true;
+				for (unsigned int j = 0; j != tail_data[i].size; j++) {
+					if (*reinterpret_cast<uint8_t*>(data_address + j) != 0xFF) {
+						erased = false;
+						break;
+					}
+				}
+				if (!erased) memcpy(tail_data[i].ptr, reinterpret_cast<void*>(data_address), tail_data[i].size);
+				data_address += tail_data[i].size;
+			}
 		}
 
 		/* If the program operation is completed, disable the PG Bit */
@@ -76,6 +95,12 @@ namespace FlashMemory {
 			}
 			data_address += data[i].size;
 		}
+		for (unsigned int i = 0; i != tail_data.size(); i++){
+			for (unsigned int j = 0; j != tail_data[i].size; j++) {
+				HAL_FLASH_Program(FLASH_TYPEPROGRAM_BYTE, data_address + j, *(static_cast<uint8_t*>(tail_data[i].ptr) + j));
+			}
+			data_address += tail_data[i].size;
+		}
 		r = HAL_FLASH_Lock();
 	}
 }
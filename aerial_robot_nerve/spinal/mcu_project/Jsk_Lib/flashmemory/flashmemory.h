@@ -14,6 +14,9 @@
 namespace FlashMemory {
 	void init(uint32_t data_address, uint32_t data_sector);
 	void addValue(void* ptr, size_t size);
+	/* appended after all the values of addValue to keep their addresses in the older layout.
+	   the value is not overwritten by read() if the flash is erased there */
+	void addTailValue(void* ptr, size_t size);
 	void read();
 	void erase();
 	void write();
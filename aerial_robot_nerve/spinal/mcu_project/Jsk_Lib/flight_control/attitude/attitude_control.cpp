@@ -128,6 +128,7 @@ void AttitudeController::pwmsControl(void)
   if(HAL_GetTick() - control_term_pub_last_time_ > CONTROL_TERM_PUB_INTERVAL)
     {
       control_term_pub_last_time_ = HAL_GetTick();
+      updateControlTermMsg();
       control_term_pub_.publish(control_term_msg_);
     }
 
@@ -140,6 +141,7 @@ void AttitudeController::pwmsControl(void)
   if(HAL_GetTick() - pwm_pub_last_time_ > PWM_PUB_INTERVAL)
     {
       pwm_pub_last_time_ = HAL_GetTick();
+      updatePwmsMsg();
       pwms_pub_.publish(pwms_msg_);
     }
 
@@ -158,6 +160,7 @@ void AttitudeController::pwmsControl(void)
       if(HAL_GetTick() - control_term_pub_last_time_ > CONTROL_TERM_PUB_INTERVAL)
         {
           control_term_pub_last_time_ = HAL_GetTick();
+          updateControlTermMsg();
           control_term_pub_.publish(&control_term_msg_);
         }
     }
@@ -165,6 +168,7 @@ void AttitudeController::pwmsControl(void)
   if(HAL_GetTick() - pwm_pub_last_time_ > PWM_PUB_INTERVAL)
     {
       pwm_pub_last_time_ = HAL_GetTick();
+      updatePwmsMsg();
       pwms_pub_.publish(&pwms_msg_);
     }
 
@@ -178,27 +182,27 @@ void AttitudeController::pwmsControl(void)
     else
       Spine::setMotorPwm(0, i);
 #else
-    Spine::setMotorPwm(target_pwm_[i] * 2000 - 1000, i);
+    Spine::setMotorPwm(mixer_.target_pwm[i] * 2000 - 1000, i);
 #endif
   }
   return;
 #endif
 
   /* direct pwm type */
-  pwm_htim1_->Instance->CCR1 = (uint32_t)(target_pwm_[0] * MAX_PWM);
-  pwm_htim1_->Instance->CCR2 = (uint32_t)(target_pwm_[1] * MAX_PWM);
-  pwm_htim1_->Instance->CCR3 = (uint32_t)(target_pwm_[2] * MAX_PWM);
-  pwm_htim1_->Instance->CCR4 = (uint32_t)(target_pwm_[3] * MAX_PWM);
+  pwm_htim1_->Instance->CCR1 = (uint32_t)(mixer_.target_pwm[0] * MAX_PWM);
+  pwm_htim1_->Instance->CCR2 = (uint32_t)(mixer_.target_pwm[1] * MAX_PWM);
+  pwm_htim1_->Instance->CCR3 = (uint32_t)(mixer_.target_pwm[2] * MAX_PWM);
+  pwm_htim1_->Instance->CCR4 = (uint32_t)(mixer_.target_pwm[3] * MAX_PWM);
 
   if(motor_number_ > 4)
     {
-      pwm_htim2_->Instance->CCR1 =   (uint32_t)(target_pwm_[4] * MAX_PWM);
-      pwm_htim2_->Instance->CCR2 =  (uint32_t)(target_pwm_[5] * MAX_PWM);
+      pwm_htim2_->Instance->CCR1 =   (uint32_t)(mixer_.target_pwm[4] * MAX_PWM);
+      pwm_htim2_->Instance->CCR2 =  (uint32_t)(mixer_.target_pwm[5] * MAX_PWM);
     }
   if(motor_number_ > 6)
     {
-      pwm_htim2_->Instance->CCR3 = (uint32_t)(target_pwm_[6] * MAX_PWM);
-      pwm_htim2_->Instance->CCR4 =  (uint32_t)(target_pwm_[7] * MAX_PWM);
+      pwm_htim2_->Instance->CCR3 = (uint32_t)(mixer_.target_pwm[6] * MAX_PWM);
+      pwm_htim2_->Instance->CCR4 =  (uint32_t)(mixer_.target_pwm[7] * MAX_PWM);
     }
 
 #endif
@@ -266,7 +270,7 @@ void AttitudeController::update(void)
           target_angle_[Y] = 0;
           target_angle_[Z] = 0;
 
-          for(int i = 0; i < motor_number_; i++) extra_yaw_pi_term_[i] = 0;
+          for(int i = 0; i < motor_number_; i++) mixer_.extra_yaw_pi_term[i] = 0;
         }
 
       // linear control method
@@ -302,50 +306,11 @@ void AttitudeController::update(void)
               }
           }
 
-        float p_term = 0;
-        float i_term = 0;
-        float d_term = 0;
-        for(int i = 0; i < motor_number_; i++)
-          {
-            for(int axis = 0; axis < 3; axis++)
-              {
-                p_term = error_angle[axis] * thrust_p_gain_[i][axis];
-                i_term = error_angle_i_[axis] * thrust_i_gain_[i][axis];
-                d_term = -vel[axis] * thrust_d_gain_[i][axis];
-                if(axis == X)
-                  {
-                    roll_pitch_term_[i] = p_term + i_term + d_term; // [N]
-                    control_term_msg_.motors[i].roll_p = p_term * 1000;
-                    control_term_msg_.motors[i].roll_i= i_term * 1000;
-                    control_term_msg_.motors[i].roll_d = d_term * 1000;
-                  }
-                if(axis == Y)
-                  {
-                    roll_pitch_term_[i] += (p_term + i_term + d_term); // [N]
-                    control_term_msg_.motors[i].pitch_p = p_term * 1000;
-                    control_term_msg_.motors[i].pitch_i = i_term * 1000;
-                    control_term_msg_.motors[i].pitch_d = d_term * 1000;
-                  }
-                if(axis == Z)
-                  {
-                    yaw_term_[i] = extra_yaw_pi_term_[i] + d_term;
-                    control_term_msg_.motors[i].yaw_d = d_term * 1000; //d_term;
-                  }
-              }
-
-            /* gyro moment compensation */
-            float gyro_moment_compensate =
-              p_matrix_pseudo_inverse_[i][0] * gyro_moment.x +
-              p_matrix_pseudo_inverse_[i][1] * gyro_moment.y +
-              p_matrix_pseudo_inverse_[i][2] * gyro_moment.z;
-            roll_pitch_term_[i] += gyro_moment_compensate;
-
-#ifdef SIMULATION
-            anti_gyro_msg.data.push_back(gyro_moment_compensate);
-#endif
-          }
+        /* per motor pid terms and gyro moment compensation */
+        mixer_.controlTerms(error_angle, error_angle_i_, vel, gyro_moment);
 
 #ifdef SIMULATION
+        anti_gyro_msg.data.assign(mixer_.gyro_moment_compensation, mixer_.gyro_moment_compensation + motor_number_);
         anti_gyro_pub_.publish(anti_gyro_msg);
 #endif
       }
@@ -354,14 +319,14 @@ void AttitudeController::update(void)
         {
           float total_thrust = 0;
           /* sum */
-          for(int i = 0; i < motor_number_; i++) total_thrust += base_thrust_term_[i];
+          for(int i = 0; i < motor_number_; i++) total_thrust += mixer_.base_thrust_term[i];
           /* average */
           float average_thrust = total_thrust / motor_number_;
 
           if(average_thrust > force_landing_thrust_)
             {
               for(int i = 0; i < motor_number_; i++)
-                base_thrust_term_[i] -= (base_thrust_term_[i] / average_thrust * FORCE_LANDING_INTEGRAL);
+                mixer_.base_thrust_term[i] -= (mixer_.base_thrust_term[i] / average_thrust * FORCE_LANDING_INTEGRAL);
             }
         }
     }
@@ -373,23 +338,11 @@ void AttitudeController::update(void)
 
 void AttitudeController::reset(void)
 {
+  mixer_.reset(IDLE_DUTY);
+
   for(int i = 0; i < MAX_MOTOR_NUMBER; i++)
     {
-      target_thrust_[i] = 0;
-      target_pwm_[i] = IDLE_DUTY;
-
-      base_thrust_term_[i] = 0;
-      roll_pitch_term_[i] = 0;
-      yaw_term_[i] = 0;
-      extra_yaw_pi_term_[i] = 0;
-
-      for (int j = 0; j < 3; j++)
-        {
-          thrust_p_gain_[i][j] = 0;
-          thrust_i_gain_[i][j] = 0;
-          thrust_d_gain_[i][j] = 0;
-          torque_allocation_matrix_inv_[i][j] = 0.0;
-        }
+      for (int j = 0; j < 3; j++) torque_allocation_matrix_inv_[i][j] = 0.0;
     }
 
   for(int i = 0; i < 3; i++)
@@ -463,11 +416,11 @@ void AttitudeController::fourAxisCommandCallback( const spinal::FourAxisCommand
   for(int i = 0; i < motor_number_; i++)
     {
       // base thrust is about the z control
-      base_thrust_term_[i] = cmd_msg.base_thrust[i];
+      mixer_.base_thrust_term[i] = cmd_msg.base_thrust[i];
 
       // reconstruct the pi term for yaw (temporary measure for pwm saturation avoidance)
       if(max_yaw_term_index_ != -1)
-        extra_yaw_pi_term_[i] = cmd_msg.angles[Z] * thrust_d_gain_[i][Z] / thrust_d_gain_[max_yaw_term_index_][Z];
+        mixer_.extra_yaw_pi_term[i] = cmd_msg.angles[Z] * mixer_.thrust_d_gain[Z][i] / mixer_.thrust_d_gain[Z][max_yaw_term_index_];
     }
 }
 
@@ -495,6 +448,9 @@ void AttitudeController::pwmInfoCallback( const spinal::PwmInfo &info_msg)
 #ifdef SIMULATION
   if(sim_voltage_== 0) sim_voltage_ = motor_info_[0].voltage;
 #endif
+
+  if(motor_ref_index_ >= motor_info_.size()) motor_ref_index_ = 0;
+  updateConversion();
 }
 
 void AttitudeController::rpyGainCallback( const spinal::RollPitchYawTerms &gain_msg)
@@ -536,13 +492,13 @@ void AttitudeController::rpyGainCallback( const spinal::RollPitchYawTerms &gain_
     {
       for(int i = 0; i < motor_number_; i++)
         {
-          thrust_p_gain_[i][X] = gain_msg.motors[i].roll_p * 0.001f;
-          thrust_i_gain_[i][X] = gain_msg.motors[i].roll_i * 0.001f;
-          thrust_d_gain_[i][X] = gain_msg.motors[i].roll_d * 0.001f;
-          thrust_p_gain_[i][Y] = gain_msg.motors[i].pitch_p * 0.001f;
-          thrust_i_gain_[i][Y] = gain_msg.motors[i].pitch_i * 0.001f;
-          thrust_d_gain_[i][Y] = gain_msg.motors[i].pitch_d * 0.001f;
-          thrust_d_gain_[i][Z] = gain_msg.motors[i].yaw_d * 0.001f;
+          mixer_.thrust_p_gain[X][i] = gain_msg.motors[i].roll_p * 0.001f;
+          mixer_.thrust_i_gain[X][i] = gain_msg.motors[i].roll_i * 0.001f;
+          mixer_.thrust_d_gain[X][i] = gain_msg.motors[i].roll_d * 0.001f;
+          mixer_.thrust_p_gain[Y][i] = gain_msg.motors[i].pitch_p * 0.001f;
+          mixer_.thrust_i_gain[Y][i] = gain_msg.motors[i].pitch_i * 0.001f;
+          mixer_.thrust_d_gain[Y][i] = gain_msg.motors[i].pitch_d * 0.001f;
+          mixer_.thrust_d_gain[Z][i] = gain_msg.motors[i].yaw_d * 0.001f;
         }
     }
   maxYawGainIndex();
@@ -576,13 +532,13 @@ void AttitudeController::thrustGainMapping()
 {
   for(int i = 0; i < motor_number_; i++)
     {
-      thrust_p_gain_[i][X] = torque_allocation_matrix_inv_[i][X] * torque_p_gain_[X];
-      thrust_i_gain_[i][X] = torque_allocation_matrix_inv_[i][X] * torque_i_gain_[X];
-      thrust_d_gain_[i][X] = torque_allocation_matrix_inv_[i][X] * torque_d_gain_[X];
-      thrust_p_gain_[i][Y] = torque_allocation_matrix_inv_[i][Y] * torque_p_gain_[Y];
-      thrust_i_gain_[i][Y] = torque_allocation_matrix_inv_[i][Y] * torque_i_gain_[Y];
-      thrust_d_gain_[i][Y] = torque_allocation_matrix_inv_[i][Y] * torque_d_gain_[Y];
-      thrust_d_gain_[i][Z] = torque_allocation_matrix_inv_[i][Z] * torque_d_gain_[Z];
+      mixer_.thrust_p_gain[X][i] = torque_allocation_matrix_inv_[i][X] * torque_p_gain_[X];
+      mixer_.thrust_i_gain[X][i] = torque_allocation_matrix_inv_[i][X] * torque_i_gain_[X];
+      mixer_.thrust_d_gain[X][i] = torque_allocation_matrix_inv_[i][X] * torque_d_gain_[X];
+      mixer_.thrust_p_gain[Y][i] = torque_allocation_matrix_inv_[i][Y] * torque_p_gain_[Y];
+      mixer_.thrust_i_gain[Y][i] = torque_allocation_matrix_inv_[i][Y] * torque_i_gain_[Y];
+      mixer_.thrust_d_gain[Y][i] = torque_allocation_matrix_inv_[i][Y] * torque_d_gain_[Y];
+      mixer_.thrust_d_gain[Z][i] = torque_allocation_matrix_inv_[i][Z] * torque_d_gain_[Z];
     }
 }
 
@@ -594,9 +550,9 @@ void AttitudeController::maxYawGainIndex()
     {
       /* only find the maximum (positive) value */
       /* to avoid identical absolute value */
-      if(thrust_d_gain_[i][Z] > max_yaw_gain)
+      if(mixer_.thrust_d_gain[Z][i] > max_yaw_gain)
         {
-          max_yaw_gain = thrust_d_gain_[i][Z];
+          max_yaw_gain = mixer_.thrust_d_gain[Z][i];
           max_yaw_term_index_ = i;
         }
     }
@@ -623,6 +579,7 @@ void AttitudeController::setMotorNumber(uint8_t motor_number)
       if(motor_number_ != motor_number)
         {
           motor_number_ = 0;
+          mixer_.setMotorNumber(0);
 #ifdef SIMULATION
           ROS_ERROR("ATTENTION: motor number is 0");
 #else
@@ -647,6 +604,7 @@ void AttitudeController::setMotorNumber(uint8_t motor_number)
 
       /* the initialize order is important */
       motor_number_ = motor_number ;
+      mixer_.setMotorNumber(motor_number);
     }
 }
 
@@ -672,6 +630,7 @@ void  AttitudeController::setUavModel(int8_t uav_model)
       if(uav_model_ == spinal::UavInfo::DRAGON)
         {
           rotor_devider_ = 2; // dual-rotor
+          updateConversion();
 
           estimator_->getAttEstimator()->setPubAccGryoOnlyFlag(true); // speical imu publish for dragon
         }
@@ -696,9 +655,9 @@ void AttitudeController::pMatrixInertiaCallback(const spinal::PMatrixPseudoInver
 
   for(int i = 0; i < motor_number_; i ++)
     {
-      p_matrix_pseudo_inverse_[i][0] = msg.pseudo_inverse[i].r * 0.001f;
-      p_matrix_pseudo_inverse_[i][1] = msg.pseudo_inverse[i].p * 0.001f;
-      p_matrix_pseudo_inverse_[i][2] = msg.pseudo_inverse[i].y * 0.001f;
+      mixer_.p_matrix_pseudo_inverse[0][i] = msg.pseudo_inverse[i].r * 0.001f;
+      mixer_.p_matrix_pseudo_inverse[1][i] = msg.pseudo_inverse[i].p * 0.001f;
+      mixer_.p_matrix_pseudo_inverse[2][i] = msg.pseudo_inverse[i].y * 0.001f;
     }
 
   /* inertia */
@@ -714,47 +673,21 @@ bool AttitudeController::activated()
   else return false;
 }
 
-void AttitudeController::pwmConversion()
+void AttitudeController::updateConversion()
 {
-  auto convert = [this](float target_thrust)
-    {
-      float scaled_thrust = v_factor_ * target_thrust / rotor_devider_;
-      float target_pwm = 0;
-      if (scaled_thrust < 0) scaled_thrust = 0;
+  if(motor_info_.size() == 0) return;
 
-      switch(pwm_conversion_mode_)
-        {
-        case spinal::MotorInfo::SQRT_MODE:
-          {
-            /* pwm = F_inv[(V_ref / V)^2 f] */
-            float sqrt_tmp = motor_info_[motor_ref_index_].polynominal[1] * motor_info_[motor_ref_index_].polynominal[1] - 4 * 10 * motor_info_[motor_ref_index_].polynominal[2] * (motor_info_[motor_ref_index_].polynominal[0] - scaled_thrust); //special decimal order shift (x10)
-            target_pwm = (-motor_info_[motor_ref_index_].polynominal[1] + sqrt_tmp * ap::inv_sqrt(sqrt_tmp)) / (2 * motor_info_[motor_ref_index_].polynominal[2]);
-            break;
-          }
-        case spinal::MotorInfo::POLYNOMINAL_MODE:
-          {
-            /* pwm = F_inv[(V_ref / V)^1.5 f] */
-            float tenth_scaled_thrust = scaled_thrust * 0.1f; //special decimal order shift (x0.1)
-            /* 4 dimensional */
-            int max_dimenstional = 4;
-            target_pwm = motor_info_[motor_ref_index_].polynominal[max_dimenstional];
-            for (int j = max_dimenstional - 1; j >= 0; j--)
-              target_pwm = target_pwm * tenth_scaled_thrust + motor_info_[motor_ref_index_].polynominal[j];
-            break;
-          }
-        default:
-          {
-            break;
-          }
-        }
-      return target_pwm / 100; // target_pwm is [%]
-    };
+  mixer_.setConversion(pwm_conversion_mode_, &motor_info_[motor_ref_index_].polynominal[0],
+                       motor_info_[motor_ref_index_].max_thrust, v_factor_, rotor_devider_);
+}
 
+void AttitudeController::pwmConversion()
+{
   if(pwm_test_flag_) /* motor pwm test */
     {
       for(int i = 0; i < MAX_MOTOR_NUMBER; i++)
         {
-          target_pwm_[i] = pwm_test_value_;
+          mixer_.target_pwm[i] = pwm_test_value_;
         }
       return;
     }
@@ -802,107 +735,34 @@ void AttitudeController::pwmConversion()
           }
         }
 
-      if(min_thrust_> 0) min_duty_ = convert(min_thrust_);
+      /* coefficients and the thrust limit of the reference motor info */
+      updateConversion();
+
+      if(min_thrust_> 0) min_duty_ = mixer_.convert(min_thrust_);
 
       voltage_update_last_time_ = HAL_GetTick();
     }
 
-  /* pwm saturation avoidance */
-  /* get the decreasing rate for the thrust to avoid the devergence because of the pwm saturation */
-  float base_thrust_decreasing_rate = 0;
-  float yaw_decreasing_rate = 0;
-  float thrust_limit = motor_info_[motor_ref_index_].max_thrust / v_factor_;
+  /* pwm saturation avoidance, target thrust -> target pwm */
+  mixer_.mix(start_control_flag_, max_yaw_term_index_, min_thrust_, min_duty_, max_duty_);
+}
 
-  /* check saturation level 2: z control saturation */
-  float max_thrust = 0;
-  int max_thrust_index = 0;
+void AttitudeController::updateControlTermMsg()
+{
   for(int i = 0; i < motor_number_; i++)
     {
-      float thrust = base_thrust_term_[i] + roll_pitch_term_[i];
-      if(max_thrust < thrust)
-        {
-          max_thrust = thrust;
-          max_thrust_index = i;
-        }
+      control_term_msg_.motors[i].roll_p = mixer_.p_term[X][i] * 1000;
+      control_term_msg_.motors[i].roll_i = mixer_.i_term[X][i] * 1000;
+      control_term_msg_.motors[i].roll_d = mixer_.d_term[X][i] * 1000;
+      control_term_msg_.motors[i].pitch_p = mixer_.p_term[Y][i] * 1000;
+      control_term_msg_.motors[i].pitch_i = mixer_.i_term[Y][i] * 1000;
+      control_term_msg_.motors[i].pitch_d = mixer_.d_term[Y][i] * 1000;
+      control_term_msg_.motors[i].yaw_d = mixer_.d_term[Z][i] * 1000;
     }
+}
 
-  if(start_control_flag_)
-    {
-      float residual_term = thrust_limit - max_thrust / rotor_devider_;
-
-      if(residual_term < 0 && base_thrust_term_[max_thrust_index] > 0)
-        {
-          base_thrust_decreasing_rate = residual_term / (base_thrust_term_[max_thrust_index] / rotor_devider_);
-          yaw_decreasing_rate = -1; // also, we have to ignore the yaw control
-        }
-      else
-        {
-          if(max_yaw_term_index_ != -1 && base_thrust_term_[0] > 0 )
-            {
-              /* check saturation level1: yaw control saturation */
-              max_thrust = 0;
-              float min_thrust = 10000;
-              int min_thrust_index = 0;
-              for(int i = 0; i < motor_number_; i++)
-                {
-                  float thrust = base_thrust_term_[i] + roll_pitch_term_[i] + yaw_term_[i];
-                  if(max_thrust < thrust)
-                    {
-                      max_thrust = thrust;
-                      max_thrust_index = i;
-                    }
-                  if(min_thrust > thrust)
-                    {
-                      min_thrust = thrust;
-                      min_thrust_index = i;
-                    }
-                }
-
-              float residual_term_max =  thrust_limit - max_thrust / rotor_devider_;
-              float residual_term_min =  min_thrust / rotor_devider_ - min_thrust_;
-              int thrust_index = 0;
-              if (residual_term_min < residual_term_max)
-                {
-                  residual_term = residual_term_min;
-                  thrust_index = min_thrust_index;
-                }
-              else
-                {
-                  residual_term = residual_term_max;
-                  thrust_index = max_thrust_index;
-                }
-
-              if(residual_term < 0)
-                {
-                  yaw_decreasing_rate = residual_term / (fabs(yaw_term_[thrust_index]) / rotor_devider_);
-                }
-
-              if(yaw_decreasing_rate < -1) yaw_decreasing_rate = -1;
-              if(yaw_decreasing_rate > 0) yaw_decreasing_rate = 0;
-            }
-          else
-            {
-              yaw_decreasing_rate = -1;
-            }
-        }
-    }
-
-  for(int i = 0; i < motor_number_; i++)
-    target_thrust_[i] = roll_pitch_term_[i] + (1 + base_thrust_decreasing_rate) * base_thrust_term_[i] + (1 + yaw_decreasing_rate) * yaw_term_[i];
-
-  /* convert to target pwm */
+void AttitudeController::updatePwmsMsg()
+{
   for(int i = 0; i < motor_number_; i++)
-    {
-      if(start_control_flag_)
-        {
-          target_pwm_[i] = convert(target_thrust_[i]);
-
-          /* constraint */
-          if(target_pwm_[i] < min_duty_) target_pwm_[i]  = min_duty_;
-          else if(target_pwm_[i]  > max_duty_) target_pwm_[i]  = max_duty_;
-        }
-
-      /* for ros */
-      pwms_msg_.motor_value[i] = (target_pwm_[i] * 2000);
-    }
+    pwms_msg_.motor_value[i] = (mixer_.target_pwm[i] * 2000);
 }
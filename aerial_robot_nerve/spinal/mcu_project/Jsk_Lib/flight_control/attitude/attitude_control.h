@@ -30,6 +30,7 @@
 #include "battery_status/battery_status.h"
 #endif
 #include "state_estimate/state_estimate.h"
+#include "flight_control/attitude/motor_mixer.h"
 
 #include <std_msgs/UInt8.h>
 #include <std_msgs/Float32.h>
@@ -47,8 +48,6 @@
 #define IDLE_DUTY 0.5f
 #define FORCE_LANDING_INTEGRAL 0.0025f // 500Hz * 0.0025 = 1.25 N / sec
 
-#define MAX_MOTOR_NUMBER 10
-
 /* fail safe */
 #define FLIGHT_COMMAND_TIMEOUT 500 //500ms
 #define MAX_TILT_ANGLE 1.0f // rad
@@ -91,8 +90,9 @@ public:
   bool getForceLandingFlag() {return force_landing_flag_;}
 
   void setForceLandingFlag(bool force_landing_flag) { force_landing_flag_ = force_landing_flag; }
-  float getPwm(uint8_t index) {return target_pwm_[index];}
-  float getForce(uint8_t index) {return target_thrust_[index];}
+  float getPwm(uint8_t index) {return mixer_.target_pwm[index];}
+  const float* getPwms() {return mixer_.target_pwm;}
+  float getForce(uint8_t index) {return mixer_.target_thrust[index];}
 
   bool activated();
 
@@ -159,18 +159,13 @@ private:
   float torque_p_gain_[3];
   float torque_i_gain_[3];
   float torque_d_gain_[3];
-  float thrust_p_gain_[MAX_MOTOR_NUMBER][3];
-  float thrust_i_gain_[MAX_MOTOR_NUMBER][3];
-  float thrust_d_gain_[MAX_MOTOR_NUMBER][3];
   float torque_allocation_matrix_inv_[MAX_MOTOR_NUMBER][3];
-  float base_thrust_term_[MAX_MOTOR_NUMBER]; //[N]
-  float roll_pitch_term_[MAX_MOTOR_NUMBER]; //[N]
-  float yaw_term_[MAX_MOTOR_NUMBER]; //[N]
-  float extra_yaw_pi_term_[MAX_MOTOR_NUMBER]; //[N]
   int max_yaw_term_index_;
 
+  // Per motor gains, terms and the thrust pwm conversion
+  MotorMixer mixer_;
+
   // Gyro Moment Compensation
-  float p_matrix_pseudo_inverse_[MAX_MOTOR_NUMBER][4];
   ap::Matrix3f inertia_;
 
   // Failsafe
@@ -178,8 +173,6 @@ private:
   uint32_t flight_command_last_stamp_;
 
   // Thrust PWM Conversion
-  float target_thrust_[MAX_MOTOR_NUMBER];
-  float target_pwm_[MAX_MOTOR_NUMBER];
   float min_duty_;
   float max_duty_;
   float min_thrust_; // max thrust is variant according to the voltage
@@ -203,6 +196,9 @@ private:
   void maxYawGainIndex();
   void pwmTestCallback(const std_msgs::Float32& pwm_msg);
   void pwmConversion(void);
+  void updateConversion(void);
+  void updateControlTermMsg(void);
+  void updatePwmsMsg(void);
   void pwmsControl(void);
 
   void reset(void);
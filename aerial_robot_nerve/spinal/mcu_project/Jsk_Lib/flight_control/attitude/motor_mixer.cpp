@@ -0,0 +1,195 @@
+/*
+******************************************************************************
+* File Name          : motor_mixer.cpp
+* Description        : per motor part of the attitude control on structure of arrays
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#include "flight_control/attitude/motor_mixer.h"
+
+MotorMixer::MotorMixer():
+  motor_number_(0), mode_(-1), v_factor_(1), rotor_devider_(1), thrust_limit_(0),
+  sqrt_a_(0), sqrt_b_(0), sqrt_c_(0), sqrt_d_(0)
+{
+  for(int j = 0; j <= POLYNOMINAL_DIMENSION; j++) polynominal_[j] = 0;
+
+  for(int axis = 0; axis < 3; axis++)
+    for(int i = 0; i < MAX_MOTOR_NUMBER; i++)
+      p_matrix_pseudo_inverse[axis][i] = 0;
+
+  reset(0);
+}
+
+void MotorMixer::reset(float pwm)
+{
+  for(int i = 0; i < MAX_MOTOR_NUMBER; i++)
+    {
+      target_thrust[i] = 0;
+      target_pwm[i] = pwm;
+
+      base_thrust_term[i] = 0;
+      roll_pitch_term[i] = 0;
+      yaw_term[i] = 0;
+      extra_yaw_pi_term[i] = 0;
+      gyro_moment_compensation[i] = 0;
+
+      for(int axis = 0; axis < 3; axis++)
+        {
+          thrust_p_gain[axis][i] = 0;
+          thrust_i_gain[axis][i] = 0;
+          thrust_d_gain[axis][i] = 0;
+          d_term[axis][i] = 0;
+        }
+      for(int axis = 0; axis < 2; axis++)
+        {
+          p_term[axis][i] = 0;
+          i_term[axis][i] = 0;
+        }
+    }
+}
+
+void MotorMixer::setConversion(int8_t mode, const float* polynominal, float max_thrust, float v_factor, int8_t rotor_devider)
+{
+  mode_ = mode;
+  v_factor_ = v_factor;
+  rotor_devider_ = rotor_devider;
+  thrust_limit_ = max_thrust / v_factor;
+
+  for(int j = 0; j <= POLYNOMINAL_DIMENSION; j++) polynominal_[j] = polynominal[j];
+
+  sqrt_a_ = polynominal[1] * polynominal[1];
+  sqrt_b_ = 4 * 10 * polynominal[2]; //special decimal order shift (x10)
+  sqrt_c_ = -polynominal[1];
+  sqrt_d_ = 2 * polynominal[2];
+}
+
+void MotorMixer::controlTerms(const float error[3], const float error_i[3], const ap::Vector3f& vel, const ap::Vector3f& gyro_moment)
+{
+  for(int axis = 0; axis < 2; axis++)
+    {
+      const float error_p = error[axis];
+      const float error_i_axis = error_i[axis];
+      for(int i = 0; i < motor_number_; i++)
+        {
+          p_term[axis][i] = error_p * thrust_p_gain[axis][i];
+          i_term[axis][i] = error_i_axis * thrust_i_gain[axis][i];
+        }
+    }
+
+  for(int axis = 0; axis < 3; axis++)
+    {
+      const float error_d = -vel[axis];
+      for(int i = 0; i < motor_number_; i++)
+        d_term[axis][i] = error_d * thrust_d_gain[axis][i];
+    }
+
+  for(int i = 0; i < motor_number_; i++)
+    {
+      gyro_moment_compensation[i] =
+        p_matrix_pseudo_inverse[0][i] * gyro_moment.x +
+        p_matrix_pseudo_inverse[1][i] * gyro_moment.y +
+        p_matrix_pseudo_inverse[2][i] * gyro_moment.z;
+
+      roll_pitch_term[i] = (p_term[0][i] + i_term[0][i] + d_term[0][i]) + (p_term[1][i] + i_term[1][i] + d_term[1][i]) + gyro_moment_compensation[i];
+      yaw_term[i] = extra_yaw_pi_term[i] + d_term[2][i];
+    }
+}
+
+void MotorMixer::mix(bool start_control, int max_yaw_term_index, float min_thrust, float min_duty, float max_duty)
+{
+  /* get the decreasing rate for the thrust to avoid the devergence because of the pwm saturation */
+  float base_thrust_decreasing_rate = 0;
+  float yaw_decreasing_rate = 0;
+
+  if(start_control)
+    {
+      /* one pass for both saturation levels */
+      float max_thrust = 0, max_yaw_thrust = 0, min_yaw_thrust = 10000;
+      int max_thrust_index = 0, max_yaw_thrust_index = -1, min_yaw_thrust_index = 0;
+      for(int i = 0; i < motor_number_; i++)
+        {
+          float thrust = base_thrust_term[i] + roll_pitch_term[i];
+          float yaw_thrust = thrust + yaw_term[i];
+          if(max_thrust < thrust)
+            {
+              max_thrust = thrust;
+              max_thrust_index = i;
+            }
+          if(max_yaw_thrust < yaw_thrust)
+            {
+              max_yaw_thrust = yaw_thrust;
+              max_yaw_thrust_index = i;
+            }
+          if(min_yaw_thrust > yaw_thrust)
+            {
+              min_yaw_thrust = yaw_thrust;
+              min_yaw_thrust_index = i;
+            }
+        }
+      /* no positive thrust with yaw: keep the index of level 2 */
+      if(max_yaw_thrust_index < 0) max_yaw_thrust_index = max_thrust_index;
+
+      /* check saturation level 2: z control saturation */
+      float residual_term = thrust_limit_ - max_thrust / rotor_devider_;
+      if(residual_term < 0 && base_thrust_term[max_thrust_index] > 0)
+        {
+          base_thrust_decreasing_rate = residual_term / (base_thrust_term[max_thrust_index] / rotor_devider_);
+          yaw_decreasing_rate = -1; // also, we have to ignore the yaw control
+        }
+      else if(max_yaw_term_index != -1 && base_thrust_term[0] > 0)
+        {
+          /* check saturation level 1: yaw control saturation */
+          float residual_term_max = thrust_limit_ - max_yaw_thrust / rotor_devider_;
+          float residual_term_min = min_yaw_thrust / rotor_devider_ - min_thrust;
+          int thrust_index = 0;
+          if (residual_term_min < residual_term_max)
+            {
+              residual_term = residual_term_min;
+              thrust_index = min_yaw_thrust_index;
+            }
+          else
+            {
+              residual_term = residual_term_max;
+              thrust_index = max_yaw_thrust_index;
+            }
+
+          if(residual_term < 0)
+            yaw_decreasing_rate = residual_term / (fabs(yaw_term[thrust_index]) / rotor_devider_);
+
+          if(yaw_decreasing_rate < -1) yaw_decreasing_rate = -1;
+          if(yaw_decreasing_rate > 0) yaw_decreasing_rate = 0;
+        }
+      else
+        {
+          yaw_decreasing_rate = -1;
+        }
+    }
+
+  const float base_thrust_rate = 1 + base_thrust_decreasing_rate;
+  const float yaw_rate = 1 + yaw_decreasing_rate;
+  for(int i = 0; i < motor_number_; i++)
+    target_thrust[i] = roll_pitch_term[i] + base_thrust_rate * base_thrust_term[i] + yaw_rate * yaw_term[i];
+
+  if(!start_control) return;
+
+  /* convert to target pwm with constraint, the mode is resolved out of the loop */
+  switch(mode_)
+    {
+    case SQRT_MODE:
+      for(int i = 0; i < motor_number_; i++)
+        target_pwm[i] = constrain(sqrtPwm(scaledThrust(target_thrust[i])), min_duty, max_duty);
+      break;
+    case POLYNOMINAL_MODE:
+      for(int i = 0; i < motor_number_; i++)
+        target_pwm[i] = constrain(polynominalPwm(scaledThrust(target_thrust[i])), min_duty, max_duty);
+      break;
+    default:
+      for(int i = 0; i < motor_number_; i++)
+        target_pwm[i] = constrain(0, min_duty, max_duty);
+      break;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+******************************************************************************
+* File Name          : motor_mixer.h
+* Description        : per motor part of the attitude control on structure of arrays:
+*                      pid terms, pwm saturation avoidance and thrust to pwm conversion
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#ifndef __MOTOR_MIXER_H
+#define __MOTOR_MIXER_H
+
+#include <math/AP_Math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_MOTOR_NUMBER 10
+
+/* The arrays are [axis][motor], so that each loop runs over the contiguous motors.
+ * The evaluation order of every term is kept from the per motor implementation,
+ * so the results are bit-exact to it under the same floating point flags.
+ */
+class MotorMixer
+{
+public:
+  /* same as spinal::MotorInfo */
+  enum {SQRT_MODE = 0, POLYNOMINAL_MODE = 1};
+  static const int POLYNOMINAL_DIMENSION = 4;
+
+  MotorMixer();
+  void reset(float pwm); // terms, gains and the target thrust, the target pwm is set to pwm
+
+  void setMotorNumber(uint8_t motor_number) { motor_number_ = motor_number; }
+  uint8_t getMotorNumber() const { return motor_number_; }
+
+  /* precompute the conversion from the reference motor info, when it or the voltage factor changes */
+  void setConversion(int8_t mode, const float* polynominal, float max_thrust, float v_factor, int8_t rotor_devider);
+  float getThrustLimit() const { return thrust_limit_; }
+
+  /* thrust [N] -> pwm [0 ~ 1] */
+  float convert(float thrust) const
+  {
+    switch(mode_)
+      {
+      case SQRT_MODE: return sqrtPwm(scaledThrust(thrust));
+      case POLYNOMINAL_MODE: return polynominalPwm(scaledThrust(thrust));
+      default: return 0;
+      }
+  }
+
+  /* pid and gyro moment compensation -> roll_pitch_term, yaw_term */
+  void controlTerms(const float error[3], const float error_i[3], const ap::Vector3f& vel, const ap::Vector3f& gyro_moment);
+  /* saturation avoidance -> target_thrust, conversion and constraint -> target_pwm (only if start_control) */
+  void mix(bool start_control, int max_yaw_term_index, float min_thrust, float min_duty, float max_duty);
+
+  /* gains, written by the callbacks of AttitudeController */
+  float thrust_p_gain[3][MAX_MOTOR_NUMBER];
+  float thrust_i_gain[3][MAX_MOTOR_NUMBER];
+  float thrust_d_gain[3][MAX_MOTOR_NUMBER];
+  float p_matrix_pseudo_inverse[3][MAX_MOTOR_NUMBER];
+
+  /* inputs */
+  float base_thrust_term[MAX_MOTOR_NUMBER]; //[N]
+  float extra_yaw_pi_term[MAX_MOTOR_NUMBER]; //[N]
+
+  /* results, the p and i terms only for roll and pitch */
+  float p_term[2][MAX_MOTOR_NUMBER];
+  float i_term[2][MAX_MOTOR_NUMBER];
+  float d_term[3][MAX_MOTOR_NUMBER];
+  float gyro_moment_compensation[MAX_MOTOR_NUMBER];
+  float roll_pitch_term[MAX_MOTOR_NUMBER]; //[N]
+  float yaw_term[MAX_MOTOR_NUMBER]; //[N]
+  float target_thrust[MAX_MOTOR_NUMBER]; //[N]
+  float target_pwm[MAX_MOTOR_NUMBER];
+
+private:
+  uint8_t motor_number_;
+
+  int8_t mode_;
+  float v_factor_;
+  float rotor_devider_;
+  float thrust_limit_;
+  /* SQRT_MODE: pwm = (c + sqrt(a - b (p0 - f))) / d, POLYNOMINAL_MODE: Horner on polynominal_ */
+  float sqrt_a_, sqrt_b_, sqrt_c_, sqrt_d_;
+  float polynominal_[POLYNOMINAL_DIMENSION + 1];
+
+  float scaledThrust(float thrust) const
+  {
+    float scaled_thrust = v_factor_ * thrust / rotor_devider_;
+    return scaled_thrust < 0 ? 0 : scaled_thrust;
+  }
+
+  float sqrtPwm(float scaled_thrust) const
+  {
+    /* pwm = F_inv[(V_ref / V)^2 f] */
+    float sqrt_tmp = sqrt_a_ - sqrt_b_ * (polynominal_[0] - scaled_thrust);
+    return (sqrt_c_ + sqrt_tmp * invSqrt(sqrt_tmp)) / sqrt_d_ / 100; // [%]
+  }
+
+  float polynominalPwm(float scaled_thrust) const
+  {
+    /* pwm = F_inv[(V_ref / V)^1.5 f] */
+    float tenth_scaled_thrust = scaled_thrust * 0.1f; //special decimal order shift (x0.1)
+    float target_pwm = polynominal_[4];
+    target_pwm = target_pwm * tenth_scaled_thrust + polynominal_[3];
+    target_pwm = target_pwm * tenth_scaled_thrust + polynominal_[2];
+    target_pwm = target_pwm * tenth_scaled_thrust + polynominal_[1];
+    target_pwm = target_pwm * tenth_scaled_thrust + polynominal_[0];
+    return target_pwm / 100; // [%]
+  }
+
+  /* same arithmetic as ap::inv_sqrt, inline to keep the call out of the conversion loop */
+  static float invSqrt(float x)
+  {
+    float halfx = 0.5f * x;
+    float y = x;
+    int32_t i;
+    memcpy(&i, &y, sizeof(i));
+    i = 0x5f3759df - (i>>1);
+    memcpy(&y, &i, sizeof(y));
+    y = y * (1.5f - (halfx * y * y));
+    return y;
+  }
+
+  static float constrain(float pwm, float min_duty, float max_duty)
+  {
+    return pwm < min_duty ? min_duty : (pwm > max_duty ? max_duty : pwm);
+  }
+};
+
+#endif
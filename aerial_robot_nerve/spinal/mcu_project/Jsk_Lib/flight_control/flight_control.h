@@ -57,8 +57,6 @@ public:
     integrate_flag_ = false;
   }
 
-  inline AttitudeController& getAttController(){ return att_controller_;}
-
   void useGroundTruth(bool flag) { att_controller_.useGroundTruth(flag); }
 #else
   FlightControl():
@@ -96,6 +94,8 @@ public:
   }
 #endif
 
+  inline AttitudeController& getAttController(){ return att_controller_;}
+
   void update()
   {
     att_controller_.update();
@@ -42,10 +42,19 @@ void IMU::init()
   virtual_frame_ = false;
   raw_gyro_p_.zero();
   raw_acc_p_.zero();
+  gyro_notch_filter_.init(GYRO_SAMPLE_FREQ);
+  mag_soft_iron_.identity();
+  /* the diagonal of the soft iron is at the place of the former mag scale */
   for (int i = 0; i < 3; i++) {
     FlashMemory::addValue(&(acc_bias_[i]), sizeof(float));
     FlashMemory::addValue(&(mag_bias_[i]), sizeof(float));
-    FlashMemory::addValue(&(mag_scale_[i]), sizeof(float));
+    FlashMemory::addValue(&(mag_soft_iron_[i][i]), sizeof(float));
+  }
+  /* the off-diagonal terms after all the existing values, zero until the first calibration */
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (i != j) FlashMemory::addTailValue(&(mag_soft_iron_[i][j]), sizeof(float));
+    }
   }
 }
 
@@ -88,6 +97,9 @@ void IMU::process (void)
   else
     raw_gyro_ -= gyro_bias_;
 
+  /* dynamic notch on the blade pass harmonics, pass through until configured from ros */
+  raw_gyro_ = gyro_notch_filter_.apply(raw_gyro_);
+
   raw_gyro_p_ -= (raw_gyro_p_/GYRO_LPF_FACTOR);
   raw_gyro_p_ += raw_gyro_;
   gyro_ = (raw_gyro_p_/GYRO_LPF_FACTOR);
@@ -119,36 +131,23 @@ void IMU::process (void)
   if (calib_mag_)
     {
       /*
-        simple calibration algorithm:
-        https://github.com/kriswiner/MPU6050/wiki/Simple-and-Effective-Magnetometer-Calibration
-
-        (option) min-least-square algorithm:
+        least-squares ellipsoid fit (hard-iron offset and full soft-iron matrix):
         https://github.com/juancamilog/calibrate_imu/blob/master/nodes/calibrate_imu.py
-      */
-      for (int i = 0; i < 3; i++)
-        {
-          if (raw_mag_adc_[i] < mag_min_[i]) mag_min_[i] = raw_mag_adc_[i];
-          if (raw_mag_adc_[i] > mag_max_[i]) mag_max_[i] = raw_mag_adc_[i];
-        }
 
+        fallback to the simple calibration algorithm, if the samples do not make an ellipsoid:
+        https://github.com/kriswiner/MPU6050/wiki/Simple-and-Effective-Magnetometer-Calibration
+      */
+      mag_fit_.addSample(raw_mag_adc_);
 
       if (mag_calib_duration_ > 0 && HAL_GetTick() - mag_calib_time_ >= mag_calib_duration_)
         {
-          mag_bias_ = (mag_min_ + mag_max_) / 2;
-
-          Vector3f ellipsoid_rad = (mag_min_ - mag_max_) / 2;
-          float avg_rad = (ellipsoid_rad[0] + ellipsoid_rad[1] + ellipsoid_rad[2])  / 3;
-          mag_scale_[0] = avg_rad / ellipsoid_rad[0];
-          mag_scale_[1] = avg_rad / ellipsoid_rad[1];
-          mag_scale_[2] = avg_rad / ellipsoid_rad[2];
+          if(!mag_fit_.solve(mag_bias_, mag_soft_iron_))
+            mag_fit_.solveMinMax(mag_bias_, mag_soft_iron_);
           calib_mag_ = false;
         }
     }
   /* transform coordinate */
-  raw_mag_ = raw_mag_adc_ - mag_bias_; //bias
-  raw_mag_[0] *= mag_scale_[0];
-  raw_mag_[1] *= mag_scale_[1];
-  raw_mag_[2] *= mag_scale_[2];
+  raw_mag_ = mag_soft_iron_ * (raw_mag_adc_ - mag_bias_);
 
   /* filtering => because the magnetemeter generates too much outlier, not know the reason */
   if(mag_filtering_flag_)
@@ -225,9 +224,8 @@ void IMU::magCalib(bool flag, float duration)
   if(flag)
     { // start re-calib
       mag_bias_.zero();
-      mag_min_ = Vector3f(1000,1000,1000);
-      mag_max_ = Vector3f(-1000,-1000,-1000);
-      mag_scale_ = Vector3f(1,1,1);
+      mag_soft_iron_.identity();
+      mag_fit_.reset(MAG_GENERAL_THRESH);
       calib_mag_ = true;
       mag_calib_duration_ = duration * 1000;
       mag_calib_time_ = HAL_GetTick();
@@ -244,9 +242,8 @@ void IMU::resetCalib()
   gyro_bias_.zero();
   acc_bias_.zero();
   mag_bias_.zero();
-  mag_min_ = Vector3f(1000,1000,1000);
-  mag_max_ = Vector3f(-1000,-1000,-1000);
-  mag_scale_ = Vector3f(1,1,1);
+  mag_soft_iron_.identity();
+  mag_fit_.reset(MAG_GENERAL_THRESH);
 }
 
 
@@ -14,6 +14,8 @@
 #include <std_msgs/UInt8.h>
 #include "config.h"
 #include "math/definitions.h"
+#include "sensors/imu/notch_filter.h"
+#include "sensors/imu/mag_ellipsoid_fit.h"
 
 using namespace ap;
 
@@ -30,19 +32,22 @@ private:
 
   Vector3f raw_acc_, raw_gyro_, raw_mag_;
   Vector3f raw_gyro_p_, raw_acc_p_;
-  Vector3f mag_max_, mag_min_;
+  MagEllipsoidFit mag_fit_;
   bool mag_filtering_flag_;
   uint16_t mag_outlier_counter_;
   uint32_t gyro_calib_duration_, acc_calib_duration_, mag_calib_duration_; // ms
   uint32_t gyro_calib_time_, acc_calib_time_, mag_calib_time_; // ms
   uint32_t gyro_calib_cnt_, acc_calib_cnt_, mag_calib_cnt_;
-  Vector3f acc_bias_, gyro_bias_, mag_bias_, mag_scale_;
+  Vector3f acc_bias_, gyro_bias_, mag_bias_;
+  Matrix3f mag_soft_iron_; /* mag = mag_soft_iron_ * (raw - mag_bias_) */
+  NotchFilterBank gyro_notch_filter_; /* before the lpf, against the propeller vibration */
 
 
   static constexpr uint32_t GYRO_DEFAULT_CALIB_DURATION = 7000; // 7s
   static constexpr uint32_t ACC_DEFAULT_CALIB_DURATION = 5000; // 5s
   static constexpr uint32_t MAG_DEFAULT_CALIB_DURATION = 60000; // 60s
   static constexpr float MAG_GENERAL_THRESH = 20.0f;
+  static constexpr float GYRO_SAMPLE_FREQ = 1000.0f; // Hz, update() by systick
   void readCalibData(void);
   void writeCalibData(void);
   void process (void);
@@ -96,15 +101,22 @@ public:
   inline Vector3f getGyroBias() {return gyro_bias_;}
   inline Vector3f getAccBias() {return acc_bias_;}
   inline Vector3f getMagBias() {return mag_bias_;}
-  inline Vector3f getMagScale() {return mag_scale_;}
+  inline Vector3f getMagScale() {return Vector3f(mag_soft_iron_.a.x, mag_soft_iron_.b.y, mag_soft_iron_.c.z);} // diagonal
+  inline Matrix3f getMagSoftIron() {return mag_soft_iron_;}
   inline void setGyroBias(Vector3f data) { gyro_bias_ = data;}
   inline void setAccBias(Vector3f data) { acc_bias_ = data;}
   inline void setMagBias(Vector3f data) { mag_bias_ = data;}
-  inline void setMagScale(Vector3f data) { mag_scale_ = data;}
+  inline void setMagScale(Vector3f data) { mag_soft_iron_ = Matrix3f(Vector3f(data.x, 0, 0), Vector3f(0, data.y, 0), Vector3f(0, 0, data.z));}
+  inline void setMagSoftIron(Matrix3f data) { mag_soft_iron_ = data;}
   void gyroCalib(bool flag, float duration);
   void accCalib(bool flag, float duration);
   void magCalib(bool flag, float duration);
   void resetCalib() ;
+  /* the rotor speeds for the gyro notch filters, from the target pwm of the attitude control */
+  inline void setRotorPwm(const float* pwm, uint8_t rotor_number) { gyro_notch_filter_.setRotorPwm(pwm, rotor_number); }
+  /* taken by the next update(), so the coefficients are not rewritten during the filtering */
+  inline void setGyroNotchFilterConfig(const NotchFilterBank::Config& config) { gyro_notch_filter_.setConfig(config); }
+  inline const NotchFilterBank& getGyroNotchFilter() {return gyro_notch_filter_;}
   inline bool getVirtualFrame() {return virtual_frame_;}
   inline void setVirtualFrame(bool virtual_frame) { virtual_frame_ = virtual_frame;}
 };
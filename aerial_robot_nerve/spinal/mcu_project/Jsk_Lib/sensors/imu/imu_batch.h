@@ -0,0 +1,52 @@
+/*
+******************************************************************************
+* File Name          : imu_batch.h
+* Description        : quantization of the consecutive imu samples in spinal::ImuBatch,
+*                      shared by spinal (pack) and the imu plugin in ros (unpack)
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#ifndef __IMU_BATCH_H
+#define __IMU_BATCH_H
+
+#include <math.h>
+#include <stdint.h>
+
+namespace imu_batch
+{
+  static const int16_t QUANTIZE_MAX = 32767;
+  /* resolution floor, e.g. all the samples are zero */
+  static const float GYRO_MIN_SCALE = 1e-5f; // [rad/s / lsb]
+  static const float ACC_MIN_SCALE = 1e-4f; // [m/s^2 / lsb]
+
+  /* the scale is shared by the values, the largest magnitude maps to QUANTIZE_MAX: error <= scale / 2 */
+  inline float quantize(const float* values, int number, int16_t* quantized, float min_scale)
+  {
+    float max_abs = 0;
+    for(int i = 0; i < number; i++)
+      if(fabsf(values[i]) > max_abs) max_abs = fabsf(values[i]);
+
+    float scale = max_abs / QUANTIZE_MAX;
+    if(scale < min_scale) scale = min_scale;
+
+    for(int i = 0; i < number; i++)
+      {
+        long value = lroundf(values[i] / scale);
+        if(value > QUANTIZE_MAX) value = QUANTIZE_MAX; // rounding of the float division
+        if(value < -QUANTIZE_MAX) value = -QUANTIZE_MAX;
+        quantized[i] = static_cast<int16_t>(value);
+      }
+    return scale;
+  }
+
+  inline void dequantize(const int16_t* quantized, int number, float scale, float* values)
+  {
+    for(int i = 0; i < number; i++) values[i] = quantized[i] * scale;
+  }
+}
+
+#endif
@@ -130,7 +130,12 @@ namespace IMU_ROS_CMD
             case spinal::ImuCalib::Request::CALIB_MAG:
               {
                 imu_.at(imu_id)->setMagBias(Vector3f(req.data[2], req.data[3], req.data[4]));
-                imu_.at(imu_id)->setMagScale(Vector3f(req.data[5], req.data[6], req.data[7]));
+                if(req.data_length >= 14) // full soft iron matrix, row major
+                  imu_.at(imu_id)->setMagSoftIron(Matrix3f(Vector3f(req.data[5], req.data[6], req.data[7]),
+                                                           Vector3f(req.data[8], req.data[9], req.data[10]),
+                                                           Vector3f(req.data[11], req.data[12], req.data[13])));
+                else
+                  imu_.at(imu_id)->setMagScale(Vector3f(req.data[5], req.data[6], req.data[7]));
                 break;
               }
             default:
@@ -164,15 +169,34 @@ namespace IMU_ROS_CMD
       }
   }
 
+  void notchFilterConfigCallback(const spinal::NotchFilterConfig& config_msg)
+  {
+    NotchFilterBank::Config config;
+    config.enable = config_msg.enable;
+    config.harmonics = config_msg.harmonics;
+    config.blade_number = config_msg.blade_number;
+    config.rps_per_pwm = config_msg.rps_per_pwm;
+    config.pwm_offset = config_msg.pwm_offset;
+    config.q = config_msg.q;
+    config.min_freq = config_msg.min_freq;
+    config.max_freq = config_msg.max_freq;
+    config.peak_tracking = config_msg.peak_tracking;
+
+    for(unsigned int i = 0; i < imu_.size(); i++)
+      imu_.at(i)->setGyroNotchFilterConfig(config);
+  }
+
   namespace
   {
     ros::ServiceServer<spinal::ImuCalib::Request, spinal::ImuCalib::Response> imu_calib_srv_("imu_calib", imuCalibCallback);
+    ros::Subscriber<spinal::NotchFilterConfig> notch_filter_config_sub_("imu_notch_filter_config", notchFilterConfigCallback);
   }
 
   void init(ros::NodeHandle* nh)
   {
     nh_ = nh;
     nh_->advertiseService(imu_calib_srv_);
+    nh_->subscribe(notch_filter_config_sub_);
   }
 
   void addImu(IMU* imu)
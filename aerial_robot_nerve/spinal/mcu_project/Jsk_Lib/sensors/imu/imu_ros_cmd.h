@@ -10,6 +10,7 @@
 
 #include <ros.h>
 #include <spinal/ImuCalib.h>
+#include <spinal/NotchFilterConfig.h>
 #include "sensors/imu/imu_basic.h"
 
 namespace IMU_ROS_CMD {
@@ -0,0 +1,317 @@
+/*
+******************************************************************************
+* File Name          : mag_ellipsoid_fit.cpp
+* Description        : incremental least-squares ellipsoid fit for the magnetometer calibration
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#include "sensors/imu/mag_ellipsoid_fit.h"
+
+namespace
+{
+  const int N = MagEllipsoidFit::PARAM_NUMBER;
+  const int SOLVE_N = N - 1;
+
+  /* phi: [x^2, y^2, z^2, 2xy, 2xz, 2yz, 2x, 2y, 2z, 1] */
+  const int CROSS[3][3] = {{0, 3, 4}, {3, 1, 5}, {4, 5, 2}};
+  const int LINEAR = 6;
+  const int CONSTANT = 9;
+
+  /* in place cholesky solve of the symmetric positive definite a (n x n, row major), false if not positive definite */
+  bool choleskySolve(double* a, double* b, int n)
+  {
+    for(int j = 0; j < n; j++)
+      {
+        double d = a[j * n + j];
+        for(int k = 0; k < j; k++) d -= a[j * n + k] * a[j * n + k];
+        if(d <= 1e-12 * fabs(a[j * n + j]) || d <= 0) return false;
+        a[j * n + j] = sqrt(d);
+
+        for(int i = j + 1; i < n; i++)
+          {
+            double s = a[i * n + j];
+            for(int k = 0; k < j; k++) s -= a[i * n + k] * a[j * n + k];
+            a[i * n + j] = s / a[j * n + j];
+          }
+      }
+
+    for(int i = 0; i < n; i++)
+      {
+        for(int k = 0; k < i; k++) b[i] -= a[i * n + k] * b[k];
+        b[i] /= a[i * n + i];
+      }
+    for(int i = n - 1; i >= 0; i--)
+      {
+        for(int k = i + 1; k < n; k++) b[i] -= a[k * n + i] * b[k];
+        b[i] /= a[i * n + i];
+      }
+    return true;
+  }
+
+  /* cyclic jacobi for the symmetric 3 x 3: a = v diag(eigen) v^T */
+  void jacobiEigen(double a[3][3], double eigen[3], double v[3][3])
+  {
+    for(int i = 0; i < 3; i++)
+      for(int j = 0; j < 3; j++) v[i][j] = (i == j);
+
+    for(int sweep = 0; sweep < 20; sweep++)
+      {
+        double off = fabs(a[0][1]) + fabs(a[0][2]) + fabs(a[1][2]);
+        double diag = fabs(a[0][0]) + fabs(a[1][1]) + fabs(a[2][2]);
+        if(off <= 1e-15 * diag) break;
+
+        for(int p = 0; p < 2; p++)
+          for(int q = p + 1; q < 3; q++)
+            {
+              if(a[p][q] == 0) continue;
+              double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+              double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+              double c = 1 / sqrt(t * t + 1);
+              double s = t * c;
+
+              for(int k = 0; k < 3; k++)
+                {
+                  double akp = a[k][p], akq = a[k][q];
+                  a[k][p] = c * akp - s * akq;
+                  a[k][q] = s * akp + c * akq;
+                }
+              for(int k = 0; k < 3; k++)
+                {
+                  double apk = a[p][k], aqk = a[q][k];
+                  a[p][k] = c * apk - s * aqk;
+                  a[q][k] = s * apk + c * aqk;
+                }
+              for(int k = 0; k < 3; k++)
+                {
+                  double vkp = v[k][p], vkq = v[k][q];
+                  v[k][p] = c * vkp - s * vkq;
+                  v[k][q] = s * vkp + c * vkq;
+                }
+            }
+      }
+
+    for(int i = 0; i < 3; i++) eigen[i] = a[i][i];
+  }
+}
+
+MagEllipsoidFit::MagEllipsoidFit()
+{
+  reset(0);
+}
+
+void MagEllipsoidFit::reset(float outlier_thresh)
+{
+  for(int i = 0; i < N * (N + 1) / 2; i++) scatter_[i] = 0;
+  sample_number_ = 0;
+  outlier_number_ = 0;
+  outlier_count_ = 0;
+  outlier_thresh_ = outlier_thresh;
+  last_.zero();
+  reference_.zero();
+  min_ = ap::Vector3f(1e6f, 1e6f, 1e6f);
+  max_ = ap::Vector3f(-1e6f, -1e6f, -1e6f);
+}
+
+bool MagEllipsoidFit::addSample(const ap::Vector3f& mag)
+{
+  /* the raw mag may be 0 in the early stage */
+  if(mag.is_zero() || mag == last_) return false;
+  last_ = mag;
+
+  if(outlier_thresh_ > 0 && sample_number_ > 0)
+    {
+      bool outlier = false;
+      for(int i = 0; i < 3; i++)
+        if(fabsf(mag[i] - reference_[i]) > outlier_thresh_) outlier = true;
+
+      if(outlier)
+        {
+          outlier_number_++;
+          if(++outlier_count_ > MAX_OUTLIER_COUNT)
+            {
+              /* not a spike but a jump, e.g. the lost samples during a fast rotation */
+              reference_ = mag;
+              outlier_count_ = 0;
+            }
+          return false;
+        }
+    }
+  outlier_count_ = 0;
+  reference_ = mag;
+
+  for(int i = 0; i < 3; i++)
+    {
+      if(mag[i] < min_[i]) min_[i] = mag[i];
+      if(mag[i] > max_[i]) max_[i] = mag[i];
+    }
+
+  double x = mag.x, y = mag.y, z = mag.z;
+  double phi[N] = {x * x, y * y, z * z, 2 * x * y, 2 * x * z, 2 * y * z, 2 * x, 2 * y, 2 * z, 1};
+  double* s = scatter_;
+  for(int i = 0; i < N; i++)
+    for(int j = i; j < N; j++)
+      *(s++) += phi[i] * phi[j];
+
+  sample_number_++;
+  return true;
+}
+
+bool MagEllipsoidFit::solve(ap::Vector3f& offset, ap::Matrix3f& soft_iron) const
+{
+  if(sample_number_ < MIN_SAMPLE_NUMBER) return false;
+
+  /* the samples should spread in all directions, not only in a plane (e.g. only yaw rotation) */
+  double n = scatter_[index(CONSTANT, CONSTANT)];
+  double mean[3], covariance[3][3], coverage[3], axes[3][3];
+  for(int i = 0; i < 3; i++) mean[i] = scatter_[index(LINEAR + i, CONSTANT)] / 2 / n;
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+      covariance[i][j] = scatter_[index(LINEAR + i, LINEAR + j)] / 4 / n - mean[i] * mean[j];
+  jacobiEigen(covariance, coverage, axes);
+  double min_coverage = coverage[0], max_coverage = coverage[0];
+  for(int i = 1; i < 3; i++)
+    {
+      if(coverage[i] < min_coverage) min_coverage = coverage[i];
+      if(coverage[i] > max_coverage) max_coverage = coverage[i];
+    }
+  if(min_coverage < MIN_COVERAGE_RATIO * max_coverage) return false;
+
+  /* u = scale * (x - center) */
+  double center[3], half_range = 0;
+  for(int i = 0; i < 3; i++)
+    {
+      center[i] = (min_[i] + max_[i]) / 2.0;
+      half_range += (max_[i] - min_[i]) / 6.0;
+    }
+  if(half_range <= 0) return false;
+  double scale = 1 / half_range;
+
+  /* phi(u) = t phi(x) */
+  double t[N][N] = {};
+  double d[3];
+  for(int i = 0; i < 3; i++) d[i] = -scale * center[i];
+  for(int i = 0; i < 3; i++)
+    {
+      for(int j = i; j < 3; j++)
+        {
+          int row = CROSS[i][j];
+          t[row][row] = scale * scale;
+          if(i == j)
+            {
+              /* u_i^2 = s^2 x_i^2 + s d_i (2 x_i) + d_i^2 */
+              t[row][LINEAR + i] = scale * d[i];
+              t[row][CONSTANT] = d[i] * d[i];
+            }
+          else
+            {
+              /* 2 u_i u_j = s^2 (2 x_i x_j) + s d_j (2 x_i) + s d_i (2 x_j) + 2 d_i d_j */
+              t[row][LINEAR + i] = scale * d[j];
+              t[row][LINEAR + j] = scale * d[i];
+              t[row][CONSTANT] = 2 * d[i] * d[j];
+            }
+        }
+      t[LINEAR + i][LINEAR + i] = scale;
+      t[LINEAR + i][CONSTANT] = 2 * d[i];
+    }
+  t[CONSTANT][CONSTANT] = 1;
+
+  /* scatter of phi(u): t s t^T */
+  double ts[N][N];
+  for(int i = 0; i < N; i++)
+    for(int j = 0; j < N; j++)
+      {
+        double sum = 0;
+        for(int k = 0; k < N; k++)
+          if(t[i][k] != 0) sum += t[i][k] * scatter_[index(k, j)];
+        ts[i][j] = sum;
+      }
+  double normal[SOLVE_N * SOLVE_N], rhs[SOLVE_N];
+  for(int i = 0; i < SOLVE_N; i++)
+    {
+      for(int j = 0; j < N; j++)
+        {
+          double sum = 0;
+          for(int k = 0; k < N; k++) sum += ts[i][k] * t[j][k];
+          if(j < SOLVE_N) normal[i * SOLVE_N + j] = sum;
+          else rhs[i] = sum;
+        }
+    }
+
+  /* v^T phi(u)[0:9] = 1 */
+  if(!choleskySolve(normal, rhs, SOLVE_N)) return false;
+
+  double q[3][3], b[3];
+  for(int i = 0; i < 3; i++)
+    {
+      for(int j = 0; j < 3; j++) q[i][j] = rhs[CROSS[i][j]];
+      b[i] = rhs[LINEAR + i];
+    }
+
+  /* center u0 = -q^-1 b, then (u - u0)^T q (u - u0) = 1 + u0^T q u0 */
+  double det = q[0][0] * (q[1][1] * q[2][2] - q[1][2] * q[2][1])
+    - q[0][1] * (q[1][0] * q[2][2] - q[1][2] * q[2][0])
+    + q[0][2] * (q[1][0] * q[2][1] - q[1][1] * q[2][0]);
+  if(det <= 0) return false;
+  double inv[3][3];
+  inv[0][0] = (q[1][1] * q[2][2] - q[1][2] * q[2][1]) / det;
+  inv[0][1] = (q[0][2] * q[2][1] - q[0][1] * q[2][2]) / det;
+  inv[0][2] = (q[0][1] * q[1][2] - q[0][2] * q[1][1]) / det;
+  inv[1][1] = (q[0][0] * q[2][2] - q[0][2] * q[2][0]) / det;
+  inv[1][2] = (q[0][2] * q[1][0] - q[0][0] * q[1][2]) / det;
+  inv[2][2] = (q[0][0] * q[1][1] - q[0][1] * q[1][0]) / det;
+  inv[1][0] = inv[0][1];
+  inv[2][0] = inv[0][2];
+  inv[2][1] = inv[1][2];
+
+  double u0[3], k = 1;
+  for(int i = 0; i < 3; i++)
+    u0[i] = -(inv[i][0] * b[0] + inv[i][1] * b[1] + inv[i][2] * b[2]);
+  for(int i = 0; i < 3; i++) k -= u0[i] * b[i];
+  if(k <= 0) return false;
+
+  /* semi-axes: 1 / sqrt(eigen(q / k)) in u */
+  double p[3][3], eigen[3], v[3][3];
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++) p[i][j] = q[i][j] / k;
+  jacobiEigen(p, eigen, v);
+  double min_eigen = eigen[0], max_eigen = eigen[0];
+  for(int i = 1; i < 3; i++)
+    {
+      if(eigen[i] < min_eigen) min_eigen = eigen[i];
+      if(eigen[i] > max_eigen) max_eigen = eigen[i];
+    }
+  if(min_eigen <= 0 || max_eigen > MAX_AXIS_RATIO * MAX_AXIS_RATIO * min_eigen) return false;
+
+  /* soft_iron = radius * (q / k)^(1/2) in u, radius: geometric mean of the semi-axes */
+  double radius = 1 / cbrt(sqrt(eigen[0] * eigen[1] * eigen[2]));
+  for(int i = 0; i < 3; i++)
+    {
+      offset[i] = center[i] + u0[i] / scale;
+      for(int j = 0; j < 3; j++)
+        {
+          double w = 0;
+          for(int l = 0; l < 3; l++) w += v[i][l] * sqrt(eigen[l]) * v[j][l];
+          soft_iron[i][j] = radius * w; // the scale of u cancels between the radius and the root
+        }
+    }
+  return true;
+}
+
+bool MagEllipsoidFit::solveMinMax(ap::Vector3f& offset, ap::Matrix3f& soft_iron) const
+{
+  if(sample_number_ < 2) return false;
+
+  ap::Vector3f ellipsoid_rad = (max_ - min_) / 2;
+  if(ellipsoid_rad.x <= 0 || ellipsoid_rad.y <= 0 || ellipsoid_rad.z <= 0) return false;
+
+  float avg_rad = (ellipsoid_rad[0] + ellipsoid_rad[1] + ellipsoid_rad[2]) / 3;
+  offset = (min_ + max_) / 2;
+  soft_iron = ap::Matrix3f(ap::Vector3f(avg_rad / ellipsoid_rad[0], 0, 0),
+                           ap::Vector3f(0, avg_rad / ellipsoid_rad[1], 0),
+                           ap::Vector3f(0, 0, avg_rad / ellipsoid_rad[2]));
+  return true;
+}
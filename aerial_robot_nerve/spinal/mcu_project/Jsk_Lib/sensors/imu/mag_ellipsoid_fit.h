@@ -0,0 +1,65 @@
+/*
+******************************************************************************
+* File Name          : mag_ellipsoid_fit.h
+* Description        : incremental least-squares ellipsoid fit for the magnetometer calibration:
+*                      hard-iron offset and full soft-iron correction matrix
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#ifndef __MAG_ELLIPSOID_FIT_H
+#define __MAG_ELLIPSOID_FIT_H
+
+#include <math/AP_Math.h>
+#include <stdint.h>
+
+/* The samples are accumulated in the 10 x 10 scatter matrix of
+ * phi = [x^2, y^2, z^2, 2xy, 2xz, 2yz, 2x, 2y, 2z, 1] (upper triangle in double), so the memory is constant.
+ * At solve(), the scatter is moved to the coordinate centered at the midpoint of the min / max and normalized
+ * by their half range, where v^T phi[0:9] = 1 is a well posed least squares for any hard-iron offset.
+ * The corrected mag = soft_iron * (raw - offset) lies on the sphere of the geometric mean radius of the ellipsoid.
+ */
+class MagEllipsoidFit
+{
+public:
+  static constexpr int PARAM_NUMBER = 10;
+  static constexpr uint32_t MIN_SAMPLE_NUMBER = 100;
+
+  MagEllipsoidFit();
+
+  /* outlier_thresh: max change of an axis from the last accepted sample */
+  void reset(float outlier_thresh);
+
+  /* the same value as the last one is skipped, since the raw mag is held between the mag updates, true if accepted */
+  bool addSample(const ap::Vector3f& mag);
+
+  /* false if the samples do not make an ellipsoid, then offset and soft_iron are not changed */
+  bool solve(ap::Vector3f& offset, ap::Matrix3f& soft_iron) const;
+  /* the simple method (bias from the midpoint, diagonal scale from the averaged radii) on the accepted samples */
+  bool solveMinMax(ap::Vector3f& offset, ap::Matrix3f& soft_iron) const;
+
+  uint32_t getSampleNumber() const { return sample_number_; }
+  uint32_t getOutlierNumber() const { return outlier_number_; }
+  ap::Vector3f getMin() const { return min_; }
+  ap::Vector3f getMax() const { return max_; }
+
+private:
+  static constexpr uint8_t MAX_OUTLIER_COUNT = 5; // samples, then the reference jumps to the current sample
+  static constexpr double MAX_AXIS_RATIO = 3.0; // longest / shortest semi-axis of a plausible ellipsoid
+  static constexpr double MIN_COVERAGE_RATIO = 0.05; // smallest / largest variance of the samples
+
+  double scatter_[PARAM_NUMBER * (PARAM_NUMBER + 1) / 2];
+  uint32_t sample_number_;
+  uint32_t outlier_number_;
+  uint8_t outlier_count_;
+  float outlier_thresh_;
+  ap::Vector3f last_, reference_;
+  ap::Vector3f min_, max_;
+
+  static int index(int i, int j) { return i <= j ? i * PARAM_NUMBER - i * (i - 1) / 2 + j - i : index(j, i); }
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*
+******************************************************************************
+* File Name          : notch_filter.cpp
+* Description        : dynamic notch filter bank for the gyro
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#include "sensors/imu/notch_filter.h"
+
+FftPeakTracker::FftPeakTracker():
+  sample_freq_(1000.0f), min_freq_(0), max_freq_(0)
+{
+  init(sample_freq_);
+}
+
+void FftPeakTracker::init(float sample_freq)
+{
+  sample_freq_ = sample_freq;
+
+  for(int i = 0; i < FFT_SIZE; i++)
+    window_[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / FFT_SIZE);
+
+  for(int k = 0; k < FFT_SIZE / 2; k++)
+    {
+      twiddle_cos_[k] = cosf(2 * M_PI * k / FFT_SIZE);
+      twiddle_sin_[k] = sinf(2 * M_PI * k / FFT_SIZE);
+    }
+
+  reset();
+}
+
+void FftPeakTracker::reset()
+{
+  peak_freq_ = 0;
+  lost_count_ = 0;
+  stage_ = COLLECT;
+  sample_count_ = 0;
+}
+
+bool FftPeakTracker::update(const ap::Vector3f& value)
+{
+  switch(stage_)
+    {
+    case COLLECT:
+      {
+        samples_[0][sample_count_] = value.x;
+        samples_[1][sample_count_] = value.y;
+        samples_[2][sample_count_] = value.z;
+        if(++sample_count_ == FFT_SIZE) stage_ = FFT_X;
+        return false;
+      }
+    case FFT_X:
+    case FFT_Y:
+    case FFT_Z:
+      {
+        fft(stage_ - FFT_X);
+        stage_++;
+        return false;
+      }
+    default:
+      {
+        stage_ = COLLECT;
+        sample_count_ = 0;
+        return peak();
+      }
+    }
+}
+
+void FftPeakTracker::fft(int axis)
+{
+  /* remove the offset, then the hann window in the bit reversed order */
+  float mean = 0;
+  for(int i = 0; i < FFT_SIZE; i++) mean += samples_[axis][i];
+  mean /= FFT_SIZE;
+
+  for(int i = 0; i < FFT_SIZE; i++)
+    {
+      int j = 0;
+      for(int b = 0; b < LOG2_FFT_SIZE; b++)
+        if(i & (1 << b)) j |= 1 << (LOG2_FFT_SIZE - 1 - b);
+      re_[j] = (samples_[axis][i] - mean) * window_[i];
+      im_[j] = 0;
+    }
+
+  /* radix-2 decimation in time */
+  for(int size = 2; size <= FFT_SIZE; size *= 2)
+    {
+      int half = size / 2;
+      int step = FFT_SIZE / size;
+      for(int start = 0; start < FFT_SIZE; start += size)
+        {
+          for(int k = 0; k < half; k++)
+            {
+              float c = twiddle_cos_[k * step];
+              float s = twiddle_sin_[k * step];
+              int i = start + k;
+              int j = i + half;
+              float tr = c * re_[j] + s * im_[j];
+              float ti = c * im_[j] - s * re_[j];
+              re_[j] = re_[i] - tr;
+              im_[j] = im_[i] - ti;
+              re_[i] += tr;
+              im_[i] += ti;
+            }
+        }
+    }
+
+  /* power spectrum summed over the axes */
+  for(int k = 0; k <= FFT_SIZE / 2; k++)
+    {
+      float power = re_[k] * re_[k] + im_[k] * im_[k];
+      if(axis == 0) power_[k] = power;
+      else power_[k] += power;
+    }
+}
+
+bool FftPeakTracker::peak()
+{
+  float bin_freq = sample_freq_ / FFT_SIZE;
+  int min_bin = ceilf(min_freq_ / bin_freq);
+  int max_bin = floorf(max_freq_ / bin_freq);
+  if(min_bin < 1) min_bin = 1;
+  if(max_bin > FFT_SIZE / 2 - 1) max_bin = FFT_SIZE / 2 - 1;
+  if(min_bin > max_bin) return false;
+
+  int peak_bin = min_bin;
+  float mean_power = 0;
+  for(int k = min_bin; k <= max_bin; k++)
+    {
+      mean_power += power_[k];
+      if(power_[k] > power_[peak_bin]) peak_bin = k;
+    }
+  mean_power /= (max_bin - min_bin + 1);
+
+  if(power_[peak_bin] <= 0 || power_[peak_bin] < PEAK_SNR * mean_power)
+    {
+      /* hold the last peak for a while */
+      if(peak_freq_ > 0 && ++lost_count_ > MAX_LOST_COUNT)
+        {
+          peak_freq_ = 0;
+          return true;
+        }
+      return false;
+    }
+  lost_count_ = 0;
+
+  /* parabolic interpolation on the log power, which fits the main lobe of hann window */
+  float delta = 0;
+  if(peak_bin > 1 && peak_bin < FFT_SIZE / 2 - 1 && power_[peak_bin - 1] > 0 && power_[peak_bin + 1] > 0)
+    {
+      float l = logf(power_[peak_bin - 1]);
+      float c = logf(power_[peak_bin]);
+      float r = logf(power_[peak_bin + 1]);
+      float denominator = l - 2 * c + r;
+      if(denominator < 0) delta = 0.5f * (l - r) / denominator;
+    }
+
+  float freq = (peak_bin + delta) * bin_freq;
+  if(peak_freq_ == 0) peak_freq_ = freq;
+  else peak_freq_ += PEAK_SMOOTH_RATE * (freq - peak_freq_);
+  return true;
+}
+
+NotchFilterBank::NotchFilterBank():
+  sample_freq_(1000.0f), rotor_number_(0), rotor_updated_(false)
+{
+  init(sample_freq_);
+}
+
+void NotchFilterBank::init(float sample_freq)
+{
+  sample_freq_ = sample_freq;
+  peak_tracker_.init(sample_freq);
+  config_queue_.init();
+  applyConfig(config_);
+}
+
+void NotchFilterBank::setConfig(const Config& config)
+{
+  config_queue_.push(config);
+}
+
+void NotchFilterBank::applyConfig(const Config& config)
+{
+  config_ = config;
+  if(config_.harmonics > MAX_HARMONICS) config_.harmonics = MAX_HARMONICS;
+  if(config_.q <= 0) config_.q = Config().q;
+
+  /* start from the bypass, the centers come with the next pwm */
+  for(int i = 0; i < MAX_ROTOR_NUMBER; i++)
+    {
+      rotor_freq_[i] = 0;
+      for(int h = 0; h < MAX_HARMONICS; h++) rotor_notch_[i][h] = BiquadNotch();
+    }
+  peak_notch_ = BiquadNotch();
+  peak_tracker_.setRange(config_.min_freq, config_.max_freq);
+  peak_tracker_.reset();
+}
+
+void NotchFilterBank::setRotorPwm(const float* pwm, uint8_t rotor_number)
+{
+  if(rotor_number > MAX_ROTOR_NUMBER) rotor_number = MAX_ROTOR_NUMBER;
+
+  /* the removed rotors should not resume from the old state */
+  for(int i = rotor_number; i < rotor_number_; i++)
+    for(int h = 0; h < MAX_HARMONICS; h++) rotor_notch_[i][h] = BiquadNotch();
+  rotor_number_ = rotor_number;
+
+  for(int i = 0; i < rotor_number_; i++)
+    rotor_freq_[i] = config_.blade_number * config_.rps_per_pwm * (pwm[i] - config_.pwm_offset);
+  rotor_updated_ = true;
+}
+
+ap::Vector3f NotchFilterBank::apply(const ap::Vector3f& value)
+{
+  /* the latest config from setConfig() */
+  Config config;
+  bool config_updated = false;
+  while(config_queue_.pop(config)) config_updated = true;
+  if(config_updated) applyConfig(config);
+
+  if(!config_.enable) return value;
+
+  if(rotor_updated_)
+    {
+      updateRotorNotch();
+      rotor_updated_ = false;
+    }
+
+  float filtered[3] = {value.x, value.y, value.z};
+  for(int i = 0; i < rotor_number_; i++)
+    for(int h = 0; h < config_.harmonics; h++)
+      if(rotor_notch_[i][h].getCenter() > 0) rotor_notch_[i][h].apply(filtered);
+
+  if(config_.peak_tracking)
+    {
+      /* the residual peak after the rotor notches, e.g. frame resonance */
+      if(peak_tracker_.update(ap::Vector3f(filtered[0], filtered[1], filtered[2])))
+        updateNotch(peak_notch_, peak_tracker_.getPeakFreq());
+      if(peak_notch_.getCenter() > 0) peak_notch_.apply(filtered);
+    }
+
+  return ap::Vector3f(filtered[0], filtered[1], filtered[2]);
+}
+
+uint8_t NotchFilterBank::getActiveNotchNumber() const
+{
+  if(!config_.enable) return 0;
+
+  uint8_t active_number = 0;
+  for(int i = 0; i < rotor_number_; i++)
+    for(int h = 0; h < config_.harmonics; h++)
+      if(rotor_notch_[i][h].getCenter() > 0) active_number++;
+  if(config_.peak_tracking && peak_notch_.getCenter() > 0) active_number++;
+  return active_number;
+}
+
+void NotchFilterBank::updateRotorNotch()
+{
+  for(int i = 0; i < rotor_number_; i++)
+    for(int h = 0; h < config_.harmonics; h++)
+      updateNotch(rotor_notch_[i][h], (h + 1) * rotor_freq_[i]);
+}
+
+void NotchFilterBank::updateNotch(BiquadNotch& notch, float center_freq)
+{
+  float prev_center_freq = notch.getCenter();
+
+  if(!inRange(center_freq))
+    {
+      if(prev_center_freq > 0) notch = BiquadNotch();
+      return;
+    }
+
+  if(prev_center_freq == 0)
+    {
+      notch.setCenter(center_freq, config_.q, sample_freq_);
+      notch.reset();
+    }
+  else if(fabsf(center_freq - prev_center_freq) > FREQ_RESOLUTION * prev_center_freq)
+    notch.setCenter(center_freq, config_.q, sample_freq_);
+}
@@ -0,0 +1,176 @@
+/*
+******************************************************************************
+* File Name          : notch_filter.h
+* Description        : dynamic notch filter bank for the gyro: biquad notches on the
+*                      blade pass harmonics of the rotors and an optional fft peak tracker
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#ifndef __NOTCH_FILTER_H
+#define __NOTCH_FILTER_H
+
+#include <math/AP_Math.h>
+#include <stdint.h>
+#include "util/ring_buffer.h"
+
+/* second order notch (RBJ audio eq cookbook) shared by the three axes, transposed direct form II.
+ * After the normalization by a0, b2 = b0 and b1 = a1, so three coefficients are enough.
+ */
+class BiquadNotch
+{
+public:
+  BiquadNotch(): center_freq_(0), b0_(1), a1_(0), a2_(0) { reset(); }
+
+  void setCenter(float center_freq, float q, float sample_freq)
+  {
+    float omega = 2 * M_PI * center_freq / sample_freq;
+    float alpha = sinf(omega) / (2 * q);
+    float a0_inv = 1 / (1 + alpha);
+    b0_ = a0_inv;
+    a1_ = -2 * cosf(omega) * a0_inv;
+    a2_ = (1 - alpha) * a0_inv;
+    center_freq_ = center_freq;
+  }
+  float getCenter() const { return center_freq_; }
+
+  void reset()
+  {
+    for(int axis = 0; axis < 3; axis++)
+      {
+        s1_[axis] = 0;
+        s2_[axis] = 0;
+      }
+  }
+
+  void apply(float* value)
+  {
+    for(int axis = 0; axis < 3; axis++)
+      {
+        float x = value[axis];
+        float y = b0_ * x + s1_[axis];
+        s1_[axis] = a1_ * (x - y) + s2_[axis];
+        s2_[axis] = b0_ * x - a2_ * y;
+        value[axis] = y;
+      }
+  }
+
+private:
+  float center_freq_; // 0: not set
+  float b0_, a1_, a2_;
+  float s1_[3], s2_[3];
+};
+
+/* Peak of the gyro spectrum in [min_freq, max_freq], summed over the three axes.
+ * A hann windowed FFT_SIZE fft per axis, one fft in one update() to flatten the cost per sample,
+ * so the samples of FFT_SIZE + 4 updates give one peak (the samples during the ffts are skipped).
+ */
+class FftPeakTracker
+{
+public:
+  static constexpr int FFT_SIZE = 128;
+  static constexpr int LOG2_FFT_SIZE = 7;
+
+  FftPeakTracker();
+  void init(float sample_freq);
+  void setRange(float min_freq, float max_freq) { min_freq_ = min_freq; max_freq_ = max_freq; }
+  void reset();
+
+  /* true when a new peak is estimated */
+  bool update(const ap::Vector3f& value);
+  float getPeakFreq() const { return peak_freq_; } // 0: no peak
+
+private:
+  static constexpr float PEAK_SNR = 8.0f; // peak power / mean power in the range
+  static constexpr float PEAK_SMOOTH_RATE = 0.5f;
+  static constexpr uint8_t MAX_LOST_COUNT = 4; // windows
+
+  enum {COLLECT = 0, FFT_X = 1, FFT_Y = 2, FFT_Z = 3, PEAK = 4};
+
+  float sample_freq_;
+  float min_freq_, max_freq_;
+  float peak_freq_;
+  uint8_t lost_count_;
+
+  int stage_;
+  int sample_count_;
+  float samples_[3][FFT_SIZE];
+  float re_[FFT_SIZE], im_[FFT_SIZE];
+  float power_[FFT_SIZE / 2 + 1];
+  float window_[FFT_SIZE];
+  float twiddle_cos_[FFT_SIZE / 2], twiddle_sin_[FFT_SIZE / 2];
+
+  void fft(int axis);
+  bool peak();
+};
+
+/* Notches on the harmonics of the blade pass frequency of every rotor, before the lpf of the gyro.
+ * The rotor speed is linear to the target pwm of the attitude control: rps = rps_per_pwm * (pwm - pwm_offset).
+ * The coefficients are recomputed only when the center moves more than FREQ_RESOLUTION,
+ * a notch out of [min_freq, max_freq] (e.g. motor stop) is bypassed and starts from the zero state.
+ */
+class NotchFilterBank
+{
+public:
+  static constexpr uint8_t MAX_ROTOR_NUMBER = 10; // MAX_MOTOR_NUMBER of the attitude control
+  static constexpr uint8_t MAX_HARMONICS = 3;
+
+  /* same as spinal::NotchFilterConfig */
+  struct Config
+  {
+    bool enable;
+    uint8_t harmonics;
+    uint8_t blade_number;
+    float q;
+    float min_freq; // [Hz]
+    float max_freq; // [Hz]
+    float rps_per_pwm;
+    float pwm_offset;
+    bool peak_tracking;
+
+    Config(): enable(false), harmonics(2), blade_number(2), q(8.0f), min_freq(40.0f), max_freq(400.0f),
+              rps_per_pwm(0), pwm_offset(0.5f), peak_tracking(false) {}
+  };
+
+  NotchFilterBank();
+  /* not interrupt safe */
+  void init(float sample_freq);
+
+  /* from the ros callback while apply() runs in the interrupt: queued, and taken by the next apply() */
+  void setConfig(const Config& config);
+  const Config& getConfig() const { return config_; }
+
+  /* the latest target pwm [0 ~ 1] of the motors */
+  void setRotorPwm(const float* pwm, uint8_t rotor_number);
+
+  ap::Vector3f apply(const ap::Vector3f& value);
+
+  uint8_t getActiveNotchNumber() const;
+  float getRotorFreq(uint8_t index) const { return rotor_freq_[index]; } // blade pass [Hz]
+  float getPeakFreq() const { return peak_tracker_.getPeakFreq(); }
+
+private:
+  static constexpr float FREQ_RESOLUTION = 0.005f; // relative to the center
+  static constexpr float MAX_FREQ_RATE = 0.45f; // relative to the sample frequency
+
+  float sample_freq_;
+  Config config_;
+  RingBufferFiFo<Config, 4> config_queue_; // setConfig() -> apply()
+  uint8_t rotor_number_;
+  float rotor_freq_[MAX_ROTOR_NUMBER];
+  bool rotor_updated_;
+
+  BiquadNotch rotor_notch_[MAX_ROTOR_NUMBER][MAX_HARMONICS];
+  BiquadNotch peak_notch_;
+  FftPeakTracker peak_tracker_;
+
+  void applyConfig(const Config& config);
+  void updateRotorNotch();
+  void updateNotch(BiquadNotch& notch, float center_freq);
+  bool inRange(float freq) const { return freq >= config_.min_freq && freq <= config_.max_freq && freq < MAX_FREQ_RATE * sample_freq_; }
+};
+
+#endif
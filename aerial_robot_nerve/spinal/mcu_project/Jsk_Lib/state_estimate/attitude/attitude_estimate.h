@@ -24,7 +24,9 @@
 #endif
 
 #include <spinal/Imu.h>
+#include <spinal/ImuBatch.h>
 #include <spinal/DesireCoord.h>
+#include <spinal/ImuLinkPoses.h>
 #include <geometry_msgs/Vector3Stamped.h>
 
 /* sensors */
@@ -38,7 +40,9 @@
 
 /* estiamtor algorithm */
 #include "state_estimate/attitude/complementary_ahrs.h"
+#include "state_estimate/attitude/multi_imu_fusion.h"
 //#include "state_estimate/attitude/madgwick_ahrs.h"
+#include "sensors/imu/imu_batch.h"
 
 #include <vector>
 
@@ -49,6 +53,9 @@
 /* please change the algorithm type according to your application */
 #define ESTIMATE_TYPE COMPLEMENTARY
 
+/* samples of every update in a spinal::ImuBatch (imu_batch) instead of a spinal::Imu (imu) every IMU_PUB_INTERVAL, 0: spinal::Imu */
+#define IMU_BATCH_SIZE 0
+
 class AttitudeEstimate
 {
 public:
@@ -63,6 +70,9 @@ public:
   {
     nh_ = nh;
     imu_pub_ = nh_->advertise<spinal::Imu>("imu", 1);
+#if IMU_BATCH_SIZE
+    imu_batch_pub_ = nh_->advertise<spinal::ImuBatch>("imu_batch", 1);
+#endif
     attitude_pub_ = nh_->advertise<geometry_msgs::Vector3Stamped>("attitude", 1),
     desire_coord_sub_ = nh_->subscribe("desire_coordinate", 1, &AttitudeEstimate::desireCoordCallback, this);
 
@@ -95,23 +105,37 @@ public:
 #else
   AttitudeEstimate():
     imu_pub_("imu", &imu_msg_),
+#if IMU_BATCH_SIZE
+    imu_batch_pub_("imu_batch", &imu_batch_msg_),
+#endif
     attitude_pub_("attitude", &attitude_msg_),
     desire_coord_sub_("desire_coordinate", &AttitudeEstimate::desireCoordCallback, this ),
     mag_declination_srv_("mag_declination", &AttitudeEstimate::magDeclinationCallback,this),
+    imu_link_poses_sub_("imu_link_poses", &AttitudeEstimate::imuLinkPosesCallback, this),
     imu_list_(1),
-    imu_weights_(1,1),
 	pub_acc_gyro_only_flag_(false)
-  {}
+  {
+#if IMU_BATCH_SIZE
+    imu_batch_msg_.tick_delta = imu_batch_tick_delta_;
+    imu_batch_msg_.gyro_data = imu_batch_gyro_data_;
+    imu_batch_msg_.acc_data = imu_batch_acc_data_;
+#endif
+  }
 
   void init(IMU* imu, GPS* gps, ros::NodeHandle* nh)
   {
     nh_ = nh;
     nh_->advertise(imu_pub_);
+#if IMU_BATCH_SIZE
+    nh_->advertise(imu_batch_pub_);
+#endif
     nh_->advertise(attitude_pub_);
     nh_->subscribe< ros::Subscriber<spinal::DesireCoord, AttitudeEstimate> >(desire_coord_sub_);
     nh_->advertiseService(mag_declination_srv_);
+    nh_->subscribe< ros::Subscriber<spinal::ImuLinkPoses, AttitudeEstimate> >(imu_link_poses_sub_);
 
     imu_list_[0] = imu;
+    imu_fusion_.setImuNumber(1);
     gps_ = gps;
 
     last_imu_pub_time_ = HAL_GetTick();
@@ -155,27 +179,35 @@ public:
 
   void multiImuFusion(Vector3f& gyro, Vector3f& acc, Vector3f& mag )
   {
-	  /* only gyro method */
-	  Vector3f sum_gyro = Vector3f();
-	  for(unsigned int i = 0; i < imu_list_.size(); i++)
-	  {
-		 sum_gyro += (imu_list_[i]->getGyro() * imu_weights_[i]);
-	  }
-	  gyro = sum_gyro;
-	  acc = imu_list_[0]->getAcc();
-	  mag = imu_list_[0]->getMag();
+    /* gyro and acc of the imus on the links in the board frame, see MultiImuFusion */
+    Vector3f gyros[MultiImuFusion::MAX_IMU_NUMBER], accs[MultiImuFusion::MAX_IMU_NUMBER];
+    gyros[0] = imu_list_[0]->getGyro();
+    accs[0] = imu_list_[0]->getAcc();
+    for(unsigned int i = 1; i < imu_fusion_.getImuNumber(); i++)
+      {
+        gyros[i] = imu_list_[i]->getGyro(true);
+        accs[i] = imu_list_[i]->getAcc(true);
+      }
+    imu_fusion_.update(gyros, accs, DELTA_T, HAL_GetTick());
+
+    gyro = imu_fusion_.getGyro();
+    acc = imu_fusion_.getAcc();
+    mag = imu_list_[0]->getMag(); // the mags of the neurons are close to the motors
   }
 
   void addImu(IMU* imu, float weight)
   {
-	  imu_list_.push_back(imu);
-	  imu_weights_.push_back(weight);
+    imu_list_.push_back(imu);
+    imu_fusion_.setImuNumber(imu_list_.size());
+    imu_fusion_.setWeight(imu_list_.size() - 1, weight);
   }
 
   void setImuWeight(uint8_t index, float weight)
   {
-	  imu_weights_[index] = weight;
+    imu_fusion_.setWeight(index, weight);
   }
+
+  const MultiImuFusion& getImuFusion() { return imu_fusion_; }
 #endif
 
   /* send message via ros protocol */
@@ -183,6 +215,9 @@ public:
   {
     /* imu data (default: body/board frame */
     uint32_t now_time = HAL_GetTick();
+#if IMU_BATCH_SIZE
+    addImuBatchSample(now_time);
+#else
     if( now_time - last_imu_pub_time_ >= IMU_PUB_INTERVAL)
       {
         last_imu_pub_time_ = now_time;
@@ -213,6 +248,7 @@ public:
         imu_pub_.publish(&imu_msg_);
 #endif
       }
+#endif
 
     /* attitude data (default: cog/virtual frame) */
     if( now_time - last_attitude_pub_time_ >= ATTITUDE_PUB_INTERVAL)
@@ -259,6 +295,61 @@ private:
   geometry_msgs::Vector3Stamped attitude_msg_;
   bool pub_acc_gyro_only_flag_;
 
+#if IMU_BATCH_SIZE
+  ros::Publisher imu_batch_pub_;
+  spinal::ImuBatch imu_batch_msg_;
+  uint8_t imu_batch_number_ = 0;
+  uint32_t imu_batch_ticks_[IMU_BATCH_SIZE];
+  float imu_batch_gyro_[3 * IMU_BATCH_SIZE], imu_batch_acc_[3 * IMU_BATCH_SIZE];
+  uint8_t imu_batch_tick_delta_[IMU_BATCH_SIZE];
+  int16_t imu_batch_gyro_data_[3 * IMU_BATCH_SIZE], imu_batch_acc_data_[3 * IMU_BATCH_SIZE];
+
+  /* the sample of every update, published with the shared scale when IMU_BATCH_SIZE samples are stored */
+  void addImuBatchSample(uint32_t now_time)
+  {
+    if(imu_batch_number_ > 0 && now_time - imu_batch_ticks_[imu_batch_number_ - 1] > 255) imu_batch_number_ = 0; // gap, e.g. disconnection
+
+    uint8_t k = imu_batch_number_;
+    for(int i = 0; i < 3; i++)
+      {
+        imu_batch_gyro_[3 * k + i] = estimator_->getAngular(Frame::BODY)[i];
+        imu_batch_acc_[3 * k + i] = estimator_->getAcc(Frame::BODY)[i];
+      }
+    imu_batch_ticks_[k] = now_time;
+    if(++imu_batch_number_ < IMU_BATCH_SIZE) return;
+    imu_batch_number_ = 0;
+
+    imu_batch_tick_delta_[0] = 0;
+    for(k = 1; k < IMU_BATCH_SIZE; k++) imu_batch_tick_delta_[k] = imu_batch_ticks_[k] - imu_batch_ticks_[k - 1];
+    imu_batch_msg_.gyro_scale = imu_batch::quantize(imu_batch_gyro_, 3 * IMU_BATCH_SIZE, imu_batch_gyro_data_, imu_batch::GYRO_MIN_SCALE);
+    imu_batch_msg_.acc_scale = imu_batch::quantize(imu_batch_acc_, 3 * IMU_BATCH_SIZE, imu_batch_acc_data_, imu_batch::ACC_MIN_SCALE);
+    for(int i = 0; i < 3; i++)
+      {
+        imu_batch_msg_.mag_data[i] = estimator_->getMag(Frame::BODY)[i];
+#if ESTIMATE_TYPE == COMPLEMENTARY
+        imu_batch_msg_.angles[i] = estimator_->getAttitude(Frame::BODY)[i];
+#endif
+      }
+
+    /* the last sample is now */
+    uint32_t span = imu_batch_ticks_[IMU_BATCH_SIZE - 1] - imu_batch_ticks_[0];
+#ifdef SIMULATION
+    imu_batch_msg_.stamp = ros::Time::now() - ros::Duration(span / 1000, (span % 1000) * 1000000);
+    imu_batch_msg_.tick_delta.assign(imu_batch_tick_delta_, imu_batch_tick_delta_ + IMU_BATCH_SIZE);
+    imu_batch_msg_.gyro_data.assign(imu_batch_gyro_data_, imu_batch_gyro_data_ + 3 * IMU_BATCH_SIZE);
+    imu_batch_msg_.acc_data.assign(imu_batch_acc_data_, imu_batch_acc_data_ + 3 * IMU_BATCH_SIZE);
+    imu_batch_pub_.publish(imu_batch_msg_);
+#else
+    imu_batch_msg_.stamp = nh_->now();
+    imu_batch_msg_.stamp -= ros::Duration(span / 1000, (span % 1000) * 1000000);
+    imu_batch_msg_.tick_delta_length = IMU_BATCH_SIZE;
+    imu_batch_msg_.gyro_data_length = 3 * IMU_BATCH_SIZE;
+    imu_batch_msg_.acc_data_length = 3 * IMU_BATCH_SIZE;
+    imu_batch_pub_.publish(&imu_batch_msg_);
+#endif
+  }
+#endif
+
 #ifdef SIMULATION
   ros::Subscriber desire_coord_sub_;
 #else
@@ -269,7 +360,30 @@ private:
 #ifndef SIMULATION
   std::vector< IMU* > imu_list_;
   GPS* gps_;
-  std::vector< float > imu_weights_;
+  MultiImuFusion imu_fusion_;
+
+  /* link poses of the neuron imus */
+  ros::Subscriber<spinal::ImuLinkPoses, AttitudeEstimate> imu_link_poses_sub_;
+
+  void imuLinkPosesCallback(const spinal::ImuLinkPoses& poses_msg)
+  {
+    uint32_t now_time = HAL_GetTick();
+    for(unsigned int i = 1; i < imu_fusion_.getImuNumber(); i++)
+      {
+        unsigned int j = i - 1; // neuron
+        if(poses_msg.orientation_length < 4 * (j + 1) || poses_msg.position_length < 3 * (j + 1))
+          {
+            imu_fusion_.clearPose(i);
+            continue;
+          }
+
+        const float* q = &poses_msg.orientation[4 * j];
+        const float* p = &poses_msg.position[3 * j];
+        ap::Matrix3f rot;
+        ap::Quaternion(q[3], q[0], q[1], q[2]).rotation_matrix(rot);
+        imu_fusion_.setPose(i, rot, ap::Vector3f(p[0], p[1], p[2]), now_time);
+      }
+  }
 
   /* mag declination */
   ros::ServiceServer<spinal::MagDeclination::Request, spinal::MagDeclination::Response, AttitudeEstimate> mag_declination_srv_;
@@ -26,10 +26,25 @@
 class ComplementaryAHRS: public EstimatorAlgorithm
 {
 public:
-  ComplementaryAHRS():EstimatorAlgorithm(), est_g_(),  est_m_(){}
+  ComplementaryAHRS():EstimatorAlgorithm(), est_g_(),  est_m_(), acc_cnt_(0)
+  {
+    setGain(GYR_CMPF_FACTOR, GYR_CMPFM_FACTOR);
+  }
+
+  /* the weight of the gyro integration against the acc / mag correction */
+  void setGain(float gyr_cmpf_factor, float gyr_cmpfm_factor)
+  {
+    gyr_cmpf_factor_ = gyr_cmpf_factor;
+    gyr_cmpfm_factor_ = gyr_cmpfm_factor;
+    inv_gyr_cmpf_factor_ = 1.0f / (gyr_cmpf_factor + 1.0f);
+    inv_gyr_cmpfm_factor_ = 1.0f / (gyr_cmpfm_factor + 1.0f);
+  }
 
 private:
   std::array<ap::Vector3f, 2> est_g_,  est_m_;
+  int acc_cnt_;
+  float gyr_cmpf_factor_, gyr_cmpfm_factor_;
+  float inv_gyr_cmpf_factor_, inv_gyr_cmpfm_factor_;
 
   /* core esitmation process, using body frame */
   void estimation() 
@@ -37,7 +52,6 @@ private:
     EstimatorAlgorithm::estimation();
 
     int  valid_acc = 0;
-    static int cnt = 0;
 
     float acc_magnitude = acc_[Frame::BODY] * acc_[Frame::BODY]; //norm?
     ap::Vector3f est_g_b_tmp = est_g_[Frame::BODY];
@@ -62,14 +76,14 @@ private:
     est_m_b_tmp = est_m_[Frame::BODY];
 
     /* acc correction */
-    if ( valid_acc == 1 && cnt == 0)
-      est_g_[Frame::BODY] = (est_g_b_tmp * GYR_CMPF_FACTOR + acc_[Frame::BODY]) * INV_GYR_CMPF_FACTOR;
+    if ( valid_acc == 1 && acc_cnt_ == 0)
+      est_g_[Frame::BODY] = (est_g_b_tmp * gyr_cmpf_factor_ + acc_[Frame::BODY]) * inv_gyr_cmpf_factor_;
 
     /* mag correction */
     if ( prev_mag_ != mag_[Frame::BODY] )
       {
         prev_mag_ = mag_[Frame::BODY];
-        est_m_[Frame::BODY] = (est_m_b_tmp * GYR_CMPFM_FACTOR  + mag_[Frame::BODY]) * INV_GYR_CMPFM_FACTOR;
+        est_m_[Frame::BODY] = (est_m_b_tmp * gyr_cmpfm_factor_  + mag_[Frame::BODY]) * inv_gyr_cmpfm_factor_;
       }
 
     // Attitude of the estimated vector
@@ -98,8 +112,8 @@ private:
     //********************************************************************************
 
     /* update */
-    if(valid_acc) cnt++;
-    if(cnt == PRESCLAER_ACC) cnt = 0;
+    if(valid_acc) acc_cnt_++;
+    if(acc_cnt_ == PRESCLAER_ACC) acc_cnt_ = 0;
   }
 };
 
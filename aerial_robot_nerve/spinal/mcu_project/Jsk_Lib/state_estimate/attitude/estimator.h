@@ -44,15 +44,7 @@ public:
 
 
     /* IIR LPF */
-    rx_freq_ = 1000.0f;
-    cutoff_freq_ = 10.0f;
-    w0_ = tan(M_PI * cutoff_freq_ / rx_freq_);
-    a_  = sin(w0_) / 0.707;
-    a1_ = 2 * cos(w0_) / (1 + a_ );
-    a2_ = (a_ - 1) / (a_ + 1);
-    b0_ = (1 - cos(w0_)) / 2 / (1 + a_);
-    b1_ =  (1 - cos(w0_)) / (1 + a_);
-    b2_ = (1 - cos(w0_)) / 2 / (1 + a_);
+    setLpfCutoff(1000.0f, 10.0f);
 
 #ifdef SIMULATION
     prev_time = -1;
@@ -63,6 +55,20 @@ public:
 
   ~EstimatorAlgorithm(){}
 
+  /* IIR LPF for the angular velocity: sampling frequency and cutoff frequency [Hz] */
+  void setLpfCutoff(float rx_freq, float cutoff_freq)
+  {
+    rx_freq_ = rx_freq;
+    cutoff_freq_ = cutoff_freq;
+    w0_ = tan(M_PI * cutoff_freq_ / rx_freq_);
+    a_  = sin(w0_) / 0.707;
+    a1_ = 2 * cos(w0_) / (1 + a_ );
+    a2_ = (a_ - 1) / (a_ + 1);
+    b0_ = (1 - cos(w0_)) / 2 / (1 + a_);
+    b1_ =  (1 - cos(w0_)) / (1 + a_);
+    b2_ = (1 - cos(w0_)) / 2 / (1 + a_);
+  }
+
   /* coodrinate change  */
   void coordinateUpdate(float desire_attitude_roll, float desire_attitude_pitch, float desire_attitude_yaw)
   {
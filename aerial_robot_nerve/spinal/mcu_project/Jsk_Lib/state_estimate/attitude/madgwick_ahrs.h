@@ -24,23 +24,46 @@ public:
   MadgwickAHRS():EstimatorAlgorithm()
   {
     beta = betaDef; // 2 * proportional gain (Kp)
+    q_.initialise();
   }
 
+  void setGain(float gain) { beta = gain; }
+
   virtual void  estimation()
   {
-    if ( prev_mag_b_ == mag_b_ )
+    EstimatorAlgorithm::estimation();
+
+    const ap::Vector3f& gyro = gyro_[Frame::BODY];
+    const ap::Vector3f& acc = acc_[Frame::BODY];
+    const ap::Vector3f& mag = mag_[Frame::BODY];
+
+#if ESTIMATE_METHOD == ACC_GYRO_MAG
+    if ( prev_mag_ != mag )
       {
-        accGyroEstimate(gyro_b_[0], gyro_b_[1], gyro_b_[2], acc_b_[0], acc_b_[1], acc_b_[2]);
+        accGyroMagEstimate(gyro.x, gyro.y, gyro.z, acc.x, acc.y, acc.z, mag.x, mag.y, mag.z);
+        prev_mag_ = mag;
       }
     else
+#endif
       {
-        accGyroMagEstimate(gyro_b_[0], gyro_b_[1], gyro_b_[2], acc_b_[0], acc_b_[1], acc_b_[2], mag_b_[0], mag_b_[1], mag_b_[2]);
-        prev_mag_b_ = mag_b_;
+        accGyroEstimate(gyro.x, gyro.y, gyro.z, acc.x, acc.y, acc.z);
       }
+
+    /* body frame */
+    ap::Matrix3f rot;
+    q_.rotation_matrix(rot);
+    rot.to_euler(&rpy_[Frame::BODY].x, &rpy_[Frame::BODY].y, &rpy_[Frame::BODY].z);
+    rpy_[Frame::BODY].z += mag_declination_;
+
+    /* virtual(CoG) frame */
+    rot = rot * r_.transposed();
+    rot.to_euler(&rpy_[Frame::VIRTUAL].x, &rpy_[Frame::VIRTUAL].y, &rpy_[Frame::VIRTUAL].z);
+    rpy_[Frame::VIRTUAL].z += mag_declination_;
   }
 
 private:
   float beta;// algorithm gain
+  ap::Quaternion q_; // q_[0]: w
 
   void accGyroMagEstimate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz)
   {
@@ -66,13 +89,13 @@ private:
     if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
       // Normalise accelerometer measurement
-      recipNorm = inv_sqrt(ax * ax + ay * ay + az * az);
+      recipNorm = ap::inv_sqrt(ax * ax + ay * ay + az * az);
       ax *= recipNorm;
       ay *= recipNorm;
       az *= recipNorm;
 
       // Normalise magnetometer measurement
-      recipNorm = inv_sqrt(mx * mx + my * my + mz * mz);
+      recipNorm = ap::inv_sqrt(mx * mx + my * my + mz * mz);
       mx *= recipNorm;
       my *= recipNorm;
       mz *= recipNorm;
@@ -112,7 +135,7 @@ private:
       s1 = _2q3 * (2.0f * q1q3 - _2q0q2 - ax) + _2q0 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q_[1] * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + _2bz * q_[3] * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q_[2] + _2bz * q_[0]) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q_[3] - _4bz * q_[1]) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
       s2 = -_2q0 * (2.0f * q1q3 - _2q0q2 - ax) + _2q3 * (2.0f * q0q1 + _2q2q3 - ay) - 4.0f * q_[2] * (1 - 2.0f * q1q1 - 2.0f * q2q2 - az) + (-_4bx * q_[2] - _2bz * q_[0]) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (_2bx * q_[1] + _2bz * q_[3]) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + (_2bx * q_[0] - _4bz * q_[2]) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
       s3 = _2q1 * (2.0f * q1q3 - _2q0q2 - ax) + _2q2 * (2.0f * q0q1 + _2q2q3 - ay) + (-_4bx * q_[3] + _2bz * q_[1]) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) + (-_2bx * q_[0] + _2bz * q_[2]) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) + _2bx * q_[1] * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
-      recipNorm = inv_sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
+      recipNorm = ap::inv_sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
       s0 *= recipNorm;
       s1 *= recipNorm;
       s2 *= recipNorm;
@@ -132,7 +155,7 @@ private:
     q_[3] += qDot4 * DELTA_T;
 
     // Normalise quaternion
-    recipNorm = inv_sqrt(q_[0] * q_[0] + q_[1] * q_[1] + q_[2] * q_[2] + q_[3] * q_[3]);
+    recipNorm = ap::inv_sqrt(q_[0] * q_[0] + q_[1] * q_[1] + q_[2] * q_[2] + q_[3] * q_[3]);
     q_[0] *= recipNorm;
     q_[1] *= recipNorm;
     q_[2] *= recipNorm;
@@ -156,7 +179,7 @@ private:
     if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
 
       // Normalise accelerometer measurement
-      recipNorm = inv_sqrt(ax * ax + ay * ay + az * az);
+      recipNorm = ap::inv_sqrt(ax * ax + ay * ay + az * az);
       ax *= recipNorm;
       ay *= recipNorm;
       az *= recipNorm;   
@@ -181,7 +204,7 @@ private:
       s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q_[1] - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
       s2 = 4.0f * q0q0 * q_[2] + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
       s3 = 4.0f * q1q1 * q_[3] - _2q1 * ax + 4.0f * q2q2 * q_[3] - _2q2 * ay;
-      recipNorm = inv_sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
+      recipNorm = ap::inv_sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
       s0 *= recipNorm;
       s1 *= recipNorm;
       s2 *= recipNorm;
@@ -201,7 +224,7 @@ private:
     q_[3] += qDot4 * DELTA_T;
 
     // Normalise quaternion
-    recipNorm = inv_sqrt(q_[0] * q_[0] + q_[1] * q_[1] + q_[2] * q_[2] + q_[3] * q_[3]);
+    recipNorm = ap::inv_sqrt(q_[0] * q_[0] + q_[1] * q_[1] + q_[2] * q_[2] + q_[3] * q_[3]);
     q_[0] *= recipNorm;
     q_[1] *= recipNorm;
     q_[2] *= recipNorm;
@@ -0,0 +1,237 @@
+/*
+******************************************************************************
+* File Name          : multi_imu_fusion.cpp
+* Description        : fusion of the imus on the articulated body
+******************************************************************************
+*/
+
+#include "state_estimate/attitude/multi_imu_fusion.h"
+
+namespace
+{
+  /* median of the small array, the array is sorted */
+  float median(float* values, uint8_t number)
+  {
+    for(uint8_t i = 1; i < number; i++)
+      {
+        float value = values[i];
+        int8_t j = i - 1;
+        for(; j >= 0 && values[j] > value; j--) values[j + 1] = values[j];
+        values[j + 1] = value;
+      }
+    if(number % 2) return values[number / 2];
+    return (values[number / 2 - 1] + values[number / 2]) / 2;
+  }
+}
+
+MultiImuFusion::MultiImuFusion(): imu_number_(1)
+{
+  for(uint8_t i = 0; i < MAX_IMU_NUMBER; i++) static_weight_[i] = 1.0f;
+  reset();
+}
+
+void MultiImuFusion::reset()
+{
+  for(uint8_t i = 0; i < MAX_IMU_NUMBER; i++)
+    {
+      pose_valid_[i] = false;
+      rot_[i].identity();
+      pos_[i].zero();
+      link_angular_[i].zero();
+      link_vel_[i].zero();
+      pose_stamp_[i] = 0;
+      pose_queue_[i].init();
+      healthy_[i] = true;
+      fault_count_[i] = 0;
+      recover_count_[i] = 0;
+      gyro_var_[i] = GYRO_INIT_VAR;
+      acc_var_[i] = ACC_INIT_VAR;
+      gyro_weight_[i] = 0;
+      acc_weight_[i] = 0;
+    }
+  pose_valid_[0] = true;
+
+  gyro_.zero();
+  acc_.zero();
+  angular_acc_.zero();
+  smooth_gyro_.zero();
+  first_update_ = true;
+}
+
+void MultiImuFusion::setImuNumber(uint8_t imu_number)
+{
+  imu_number_ = imu_number < MAX_IMU_NUMBER ? imu_number : MAX_IMU_NUMBER;
+}
+
+void MultiImuFusion::setWeight(uint8_t index, float weight)
+{
+  if(index >= MAX_IMU_NUMBER) return;
+  static_weight_[index] = weight > 0 ? weight : 0;
+}
+
+void MultiImuFusion::setPose(uint8_t index, const ap::Matrix3f& rot, const ap::Vector3f& pos, uint32_t stamp)
+{
+  if(index >= MAX_IMU_NUMBER) return;
+  pose_queue_[index].push(PoseSample{rot, pos, stamp, true});
+}
+
+void MultiImuFusion::clearPose(uint8_t index)
+{
+  if(index == 0 || index >= MAX_IMU_NUMBER) return; // the body frame itself
+  PoseSample pose;
+  pose.stamp = 0;
+  pose.valid = false;
+  pose_queue_[index].push(pose);
+}
+
+void MultiImuFusion::applyPose(uint8_t index, const PoseSample& pose)
+{
+  if(!pose.valid)
+    {
+      pose_valid_[index] = false;
+      link_angular_[index].zero();
+      link_vel_[index].zero();
+      return;
+    }
+
+  /* angular velocity of the link in the body frame: exp([w]x dt) = R_new * R_old^T, and the velocity of the imu */
+  uint32_t interval = pose.stamp - pose_stamp_[index];
+  if(pose_valid_[index] && interval > 0 && interval <= POSE_TIMEOUT)
+    {
+      ap::Quaternion delta;
+      delta.from_rotation_matrix(pose.rot * rot_[index].transposed());
+      ap::Vector3f rotation;
+      delta.to_axis_angle(rotation);
+      link_angular_[index] = rotation / (interval * 0.001f);
+      link_vel_[index] = (pose.pos - pos_[index]) / (interval * 0.001f);
+    }
+  else
+    {
+      link_angular_[index].zero();
+      link_vel_[index].zero();
+    }
+
+  rot_[index] = pose.rot;
+  pos_[index] = pose.pos;
+  pose_stamp_[index] = pose.stamp;
+  pose_valid_[index] = true;
+}
+
+uint8_t MultiImuFusion::getFusedNumber() const
+{
+  uint8_t number = 0;
+  for(uint8_t i = 0; i < imu_number_; i++)
+    if(gyro_weight_[i] > 0) number++;
+  return number;
+}
+
+bool MultiImuFusion::fuse(const ap::Vector3f* body, float* var, float* weight, float min_var, float floor, bool* outside, ap::Vector3f& fused)
+{
+  /* median of each axis over the candidates, robust to a faulty imu */
+  float values[MAX_IMU_NUMBER];
+  ap::Vector3f reference;
+  uint8_t number = 0;
+  for(uint8_t axis = 0; axis < 3; axis++)
+    {
+      number = 0;
+      for(uint8_t i = 0; i < imu_number_; i++)
+        if(candidate(i)) values[number++] = body[i][axis];
+      if(number == 0) return false;
+      reference[axis] = median(values, number);
+    }
+
+  /* noise level of the healthy imus */
+  uint8_t healthy_number = 0;
+  for(uint8_t i = 0; i < imu_number_; i++)
+    if(candidate(i) && healthy_[i]) values[healthy_number++] = var[i];
+  float level = healthy_number > 0 ? sqrtf(median(values, healthy_number)) : 0;
+
+  float sum_weight = 0;
+  fused.zero();
+  for(uint8_t i = 0; i < imu_number_; i++)
+    {
+      weight[i] = 0;
+      if(!candidate(i)) continue;
+
+      /* variance per axis, the outlier by the norm */
+      float residual = (body[i] - reference).length_squared();
+      outside[i] = number >= 3 && sqrtf(residual) > FAULT_SIGMA * level + floor;
+      residual /= 3;
+      if(!healthy_[i] || outside[i]) continue;
+
+      var[i] += NOISE_GAIN * (residual - var[i]);
+      weight[i] = static_weight_[i] / (var[i] > min_var ? var[i] : min_var);
+      sum_weight += weight[i];
+      fused += body[i] * weight[i];
+    }
+
+  if(sum_weight > 0)
+    for(uint8_t i = 0; i < imu_number_; i++) weight[i] /= sum_weight;
+
+  /* every imu is rejected: the median, or the single imu as it is */
+  if(sum_weight <= 0 || number == 1) fused = reference;
+  else fused /= sum_weight;
+  return true;
+}
+
+void MultiImuFusion::update(const ap::Vector3f* gyro, const ap::Vector3f* acc, float dt, uint32_t now)
+{
+  ap::Vector3f body[MAX_IMU_NUMBER];
+  bool gyro_outside[MAX_IMU_NUMBER] = {}, acc_outside[MAX_IMU_NUMBER] = {};
+
+  /* the queued poses, and the expiry of the old pose */
+  PoseSample pose;
+  for(uint8_t i = 0; i < MAX_IMU_NUMBER; i++)
+    {
+      while(pose_queue_[i].pop(pose)) applyPose(i, pose);
+      if(i > 0 && pose_valid_[i] && now - pose_stamp_[i] > POSE_TIMEOUT)
+        {
+          pose_valid_[i] = false;
+          link_angular_[i].zero();
+          link_vel_[i].zero();
+        }
+    }
+
+  /* gyro */
+  for(uint8_t i = 0; i < imu_number_; i++)
+    if(candidate(i)) body[i] = rot_[i] * gyro[i] - link_angular_[i];
+  if(!fuse(body, gyro_var_, gyro_weight_, GYRO_MIN_VAR, GYRO_FAULT_FLOOR, gyro_outside, gyro_)) return;
+
+  /* angular acceleration of the body: difference of the filtered gyro, filtered again against the noise */
+  if(first_update_ || dt <= 0)
+    {
+      smooth_gyro_ = gyro_;
+      angular_acc_.zero();
+    }
+  else
+    {
+      ap::Vector3f prev_smooth_gyro = smooth_gyro_;
+      smooth_gyro_ += (gyro_ - smooth_gyro_) * ANGULAR_ACC_LPF;
+      angular_acc_ += ((smooth_gyro_ - prev_smooth_gyro) / dt - angular_acc_) * ANGULAR_ACC_LPF;
+    }
+  first_update_ = false;
+
+  /* acc at the origin of the body frame */
+  for(uint8_t i = 0; i < imu_number_; i++)
+    if(candidate(i)) body[i] = rot_[i] * acc[i] - (angular_acc_ % pos_[i]) - (gyro_ % (gyro_ % pos_[i])) - (gyro_ % link_vel_[i]) * 2;
+  fuse(body, acc_var_, acc_weight_, ACC_MIN_VAR, ACC_FAULT_FLOOR, acc_outside, acc_);
+
+  /* a persistent outlier is rejected, and fused again after a while in the noise level */
+  for(uint8_t i = 0; i < imu_number_; i++)
+    {
+      if(!candidate(i)) continue;
+      bool outside = gyro_outside[i] || acc_outside[i];
+      if(healthy_[i])
+        {
+          recover_count_[i] = 0;
+          if(!outside) fault_count_[i] = 0;
+          else if(++fault_count_[i] >= FAULT_COUNT) healthy_[i] = false;
+        }
+      else
+        {
+          fault_count_[i] = 0;
+          if(outside) recover_count_[i] = 0;
+          else if(++recover_count_[i] >= RECOVER_COUNT) healthy_[i] = true;
+        }
+    }
+}
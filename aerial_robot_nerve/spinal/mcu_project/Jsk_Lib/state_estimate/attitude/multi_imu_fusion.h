@@ -0,0 +1,117 @@
+/*
+******************************************************************************
+* File Name          : multi_imu_fusion.h
+* Description        : fusion of the imus on the articulated body (spinal and the neurons on the links):
+*                      rotation to the body frame by the link poses, lever arm compensation of the acc,
+*                      weighting by the online noise estimate and rejection of the faulty imus
+******************************************************************************
+*/
+
+#ifndef __cplusplus
+#error "Please define __cplusplus, because this is a c++ based file "
+#endif
+
+#ifndef __MULTI_IMU_FUSION_H
+#define __MULTI_IMU_FUSION_H
+
+#include <math/AP_Math.h>
+#include <stdint.h>
+#include "util/ring_buffer.h"
+
+/* The body frame is the board frame of the imu 0 (spinal). The imu i is on a link whose pose
+ * (rotation from the imu board frame to the body frame and position in the body frame) follows the joint angles
+ * and is given by setPose(). The links move slowly compared with the body, so the relative angular velocity of the link
+ * and the velocity of the imu are the difference of the successive poses, the acceleration of the imu on the link is ignored.
+ *
+ * gyro:  w = R_i * g_i - w_link_i
+ * acc:   a = R_i * f_i - dw x p_i - w x (w x p_i) - 2 w x v_i  (the specific force at the origin of the body frame)
+ *
+ * Each axis of an imu is compared with the median of the imus, the residual gives the noise estimate (vibration differs
+ * by the link), and the imu is weighted by the inverse of it. An imu is rejected while the residual is far from the
+ * noise level of the imus. The rejection needs at least 3 imus.
+ *
+ * The poses come from the main loop (rosserial) while update() runs in the interrupt, so setPose() and clearPose()
+ * only queue the pose, and update() takes it. A pose older than POSE_TIMEOUT (e.g. the stream from ros stops) is dropped
+ * and the imu is not fused until the next pose.
+ */
+class MultiImuFusion
+{
+public:
+  static constexpr uint8_t MAX_IMU_NUMBER = 10;
+
+  MultiImuFusion();
+
+  /* imu 0 is at the origin without rotation, the others are not fused until the first pose. not interrupt safe */
+  void reset();
+  void setImuNumber(uint8_t imu_number);
+  uint8_t getImuNumber() const { return imu_number_; }
+
+  /* static weight as the prior, 0: not fused */
+  void setWeight(uint8_t index, float weight);
+  /* rot: imu board frame -> body frame, pos: [m] in the body frame, stamp: [ms]. applied by the next update() */
+  void setPose(uint8_t index, const ap::Matrix3f& rot, const ap::Vector3f& pos, uint32_t stamp);
+  void clearPose(uint8_t index);
+
+  /* gyro [rad/s] and acc [m/s^2] in the board frame of each imu, dt: [s] from the last update, now: [ms] same clock as the pose stamp */
+  void update(const ap::Vector3f* gyro, const ap::Vector3f* acc, float dt, uint32_t now);
+
+  const ap::Vector3f& getGyro() const { return gyro_; }
+  const ap::Vector3f& getAcc() const { return acc_; }
+  const ap::Vector3f& getAngularAcc() const { return angular_acc_; }
+
+  bool getPoseValid(uint8_t index) const { return pose_valid_[index]; }
+  bool getHealthy(uint8_t index) const { return healthy_[index]; }
+  float getGyroNoise(uint8_t index) const { return sqrtf(gyro_var_[index]); } // [rad/s]
+  float getAccNoise(uint8_t index) const { return sqrtf(acc_var_[index]); } // [m/s^2]
+  float getGyroWeight(uint8_t index) const { return gyro_weight_[index]; } // normalized
+  float getAccWeight(uint8_t index) const { return acc_weight_[index]; } // normalized
+  uint8_t getFusedNumber() const;
+
+private:
+  static constexpr float NOISE_GAIN = 0.005f; // lpf of the residual square, per sample
+  static constexpr float GYRO_INIT_VAR = 0.01f; // [(rad/s)^2]
+  static constexpr float ACC_INIT_VAR = 0.25f; // [(m/s^2)^2]
+  static constexpr float GYRO_MIN_VAR = 1e-6f; // upper bound of the weight
+  static constexpr float ACC_MIN_VAR = 1e-4f;
+  static constexpr float FAULT_SIGMA = 6.0f; // norm of the residual / noise level (per axis) of the imus
+  static constexpr float GYRO_FAULT_FLOOR = 0.1f; // [rad/s]
+  static constexpr float ACC_FAULT_FLOOR = 1.5f; // [m/s^2]
+  static constexpr uint16_t FAULT_COUNT = 10; // consecutive samples to reject
+  static constexpr uint16_t RECOVER_COUNT = 500; // consecutive samples to fuse again
+  static constexpr float ANGULAR_ACC_LPF = 0.1f; // of the fused gyro and its difference, per sample
+  static constexpr uint32_t POSE_TIMEOUT = 200; // [ms], longer pose interval gives no link motion, and the pose expires
+  static constexpr size_t POSE_QUEUE_SIZE = 4; // poses between the updates
+
+  struct PoseSample
+  {
+    ap::Matrix3f rot;
+    ap::Vector3f pos;
+    uint32_t stamp;
+    bool valid; // false: clear
+  };
+
+  uint8_t imu_number_;
+  float static_weight_[MAX_IMU_NUMBER];
+  bool pose_valid_[MAX_IMU_NUMBER];
+  ap::Matrix3f rot_[MAX_IMU_NUMBER];
+  ap::Vector3f pos_[MAX_IMU_NUMBER];
+  ap::Vector3f link_angular_[MAX_IMU_NUMBER];
+  ap::Vector3f link_vel_[MAX_IMU_NUMBER];
+  uint32_t pose_stamp_[MAX_IMU_NUMBER];
+  RingBufferFiFo<PoseSample, POSE_QUEUE_SIZE> pose_queue_[MAX_IMU_NUMBER]; // main loop -> update()
+
+  bool healthy_[MAX_IMU_NUMBER];
+  uint16_t fault_count_[MAX_IMU_NUMBER], recover_count_[MAX_IMU_NUMBER];
+  float gyro_var_[MAX_IMU_NUMBER], acc_var_[MAX_IMU_NUMBER];
+  float gyro_weight_[MAX_IMU_NUMBER], acc_weight_[MAX_IMU_NUMBER];
+
+  ap::Vector3f gyro_, acc_, angular_acc_, smooth_gyro_;
+  bool first_update_;
+
+  void applyPose(uint8_t index, const PoseSample& pose);
+  bool candidate(uint8_t index) const { return index < imu_number_ && pose_valid_[index] && static_weight_[index] > 0; }
+  /* weighted mean of the candidates except the outliers to the median, false if no candidate */
+  bool fuse(const ap::Vector3f* body, float* var, float* weight, float min_var, float floor, bool* outside, ap::Vector3f& fused);
+};
+
+#endif
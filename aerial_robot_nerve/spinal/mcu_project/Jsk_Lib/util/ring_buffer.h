@@ -1,7 +1,8 @@
 /*
 ******************************************************************************
 * File Name          : ring_buffer.h
-* Description        : FIFO based on ring buffer
+* Description        : lock-free FIFO based on ring buffer for one producer
+*                      (e.g. rx interrupt, DMA callback) and one consumer (main loop)
 ******************************************************************************
 */
 
@@ -12,16 +13,26 @@
 #error "Please define __cplusplus, because this is a c++ based file "
 #endif
 
-#include "stm32f7xx_hal.h"
+#include <atomic>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
+#ifndef PACKED
 #define PACKED __attribute__((__packed__))
+#endif
 
+/* The indices run freely and are masked by SIZE - 1, so the whole SIZE is usable.
+ * The producer publishes the written data by the release store of tail_ and
+ * the consumer frees the read slots by the release store of head_, each side
+ * reads the other index with acquire (DMB on Cortex-M7).
+ * A push to the full buffer is rejected and counted, the unread data is never overwritten.
+ */
 template <typename T,  size_t SIZE>
 class RingBufferFiFo
 {
+  static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SIZE of RingBufferFiFo should be power of two");
+
 public:
   RingBufferFiFo()
   {
@@ -29,59 +40,130 @@ public:
   }
   ~RingBufferFiFo(){  }
 
+  /* not thread safe, call before the producer starts */
   void init()
   {
-    subscript_in_progress_ = 0;
-    subscript_to_add_ = 0;
-    buffer_length_ = (uint16_t)SIZE;
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    overflow_count_.store(0, std::memory_order_relaxed);
   }
 
-  bool pop(T& pop_value)
+  /* producer side */
+  bool push(const T& new_value)
   {
-    if (subscript_in_progress_ != subscript_to_add_)
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= SIZE)
       {
-        pop_value =  buf_[subscript_in_progress_];
+        countOverflow(1);
+        return false;
+      }
 
-        subscript_in_progress_++;
-        if (subscript_in_progress_ == buffer_length_)
-          subscript_in_progress_ = 0;
+    buf_[tail & MASK] = new_value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
 
-        return true;
-      }
-    return false;
+  /* as many as fit, the rest are counted as overflow */
+  size_t push(const T* data, size_t size)
+  {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    size_t free_size = SIZE - (tail - head_.load(std::memory_order_acquire));
+    size_t push_size = size < free_size ? size : free_size;
+
+    size_t first = SIZE - (tail & MASK);
+    if (first > push_size) first = push_size;
+    copy(&buf_[tail & MASK], data, first);
+    copy(&buf_[0], data + first, push_size - first);
+
+    tail_.store(tail + push_size, std::memory_order_release);
+    if (push_size < size) countOverflow(size - push_size);
+    return push_size;
   }
 
-  bool push(T new_value)
+  /* contiguous free area to be filled in place (e.g. by DMA), then commitPush() */
+  size_t getPushSpan(T*& data)
   {
-    // the process node should have higher priority than the rx it callback
-#if 0
-    if ((subscript_in_progress_ == (subscript_to_add_ + 1)) || ( (subscript_to_add_ == (buffer_length_ - 1) )&& (subscript_in_progress_ == 0)) ) return false;
-#endif
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    size_t free_size = SIZE - (tail - head_.load(std::memory_order_acquire));
+    size_t contiguous = SIZE - (tail & MASK);
 
-    buf_[subscript_to_add_] = new_value;
+    data = &buf_[tail & MASK];
+    return free_size < contiguous ? free_size : contiguous;
+  }
 
-    subscript_to_add_++;
+  void commitPush(size_t size)
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+  }
 
-    if (subscript_to_add_ == buffer_length_)
-      {
-        subscript_to_add_ = 0;
-      }
+  /* consumer side */
+  bool pop(T& pop_value)
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
 
+    pop_value = buf_[head & MASK];
+    head_.store(head + 1, std::memory_order_release);
     return true;
   }
 
-  uint16_t length()
+  size_t pop(T* data, size_t size)
   {
-    if(subscript_to_add_ - subscript_in_progress_ >= 0)
-      return (subscript_to_add_ - subscript_in_progress_);
-    else
-      return (subscript_to_add_ - (buffer_length_ - subscript_in_progress_));
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    size_t length = tail_.load(std::memory_order_acquire) - head;
+    size_t pop_size = size < length ? size : length;
+
+    size_t first = SIZE - (head & MASK);
+    if (first > pop_size) first = pop_size;
+    copy(data, &buf_[head & MASK], first);
+    copy(data + first, &buf_[0], pop_size - first);
+
+    head_.store(head + pop_size, std::memory_order_release);
+    return pop_size;
   }
 
+  /* contiguous unread area to be consumed in place (e.g. by DMA), then commitPop() */
+  size_t getPopSpan(const T*& data)
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    size_t length = tail_.load(std::memory_order_acquire) - head;
+    size_t contiguous = SIZE - (head & MASK);
+
+    data = &buf_[head & MASK];
+    return length < contiguous ? length : contiguous;
+  }
+
+  void commitPop(size_t size)
+  {
+    head_.store(head_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+  }
+
+  /* either side, a snapshot. head first: it never passes the tail loaded after it */
+  size_t length() const
+  {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+  size_t capacity() const { return SIZE; }
+  uint32_t getOverflowCount() const { return overflow_count_.load(std::memory_order_relaxed); }
+
 private:
+  static const uint32_t MASK = SIZE - 1;
+
   T buf_[SIZE];
-  int16_t subscript_in_progress_, subscript_to_add_;
-  uint16_t buffer_length_;
+  std::atomic<uint32_t> head_; // written only by the consumer
+  std::atomic<uint32_t> tail_; // written only by the producer
+  std::atomic<uint32_t> overflow_count_; // written only by the producer
+
+  void countOverflow(size_t size)
+  {
+    overflow_count_.store(overflow_count_.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+  }
+
+  static void copy(T* dst, const T* src, size_t size)
+  {
+    for (size_t i = 0; i < size; i++) dst[i] = src[i];
+  }
 };
 
 #endif //__RING_BUFFER_H__
@@ -159,6 +159,10 @@ void HAL_SYSTICK_Callback(void)
 
 #if FLIGHT_CONTROL_FLAG
   controller_.update();
+#if IMU_FLAG
+  /* rotor speeds for the gyro notch filters in the next cycle */
+  imu_.setRotorPwm(controller_.getAttController().getPwms(), controller_.getAttController().getMotorNumber());
+#endif
 #endif
 
 #if NERVE_COMM
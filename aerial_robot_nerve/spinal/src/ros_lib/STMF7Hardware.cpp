@@ -13,7 +13,7 @@
 namespace
 {
 uint8_t rx_value_[RX_PACKET_SIZE];
-RingBuffer<uint8_t, RX_BUFFER_SIZE>  rx_buf_;
+RingBufferFiFo<uint8_t, RX_BUFFER_SIZE>  rx_buf_;
 }
 
 namespace rx
@@ -39,8 +39,8 @@ namespace rx
 
 void Rosserial_RxCpltCallback(UART_HandleTypeDef *huart)
 {
-  for(int i = 0; i < RX_PACKET_SIZE; i++)
-    rx_buf_.push(rx_value_[i]);
+  /* the bytes which do not fit are dropped and counted, rosserial resyncs with the checksum */
+  rx_buf_.push(rx_value_, RX_PACKET_SIZE);
 }
 
 
@@ -12,73 +12,13 @@
 #include "stm32f7xx_hal.h"
 #include "stm32f7xx_hal_uart.h"
 #include "stm32f7xx_hal_dma.h"
+#include "util/ring_buffer.h"
 
 #define TX_BUFFER_SIZE 512
 #define TX_BUFFER_WIDTH 512
 #define RX_BUFFER_SIZE 512
 #define RX_PACKET_SIZE 16
 
-template <typename T,  int SIZE>
-class RingBuffer
-{
-public:
-  RingBuffer()
-  {
-    byte_in_progress_ = 0;
-    byte_to_add_ = 0;
-    buffer_length_ = (uint16_t)SIZE;
-  }
-  ~RingBuffer(){  }
-
-  bool pop(T& pop_value)
-  {
-    if (byte_in_progress_ != byte_to_add_)
-      {
-        pop_value =  buf_[byte_in_progress_];
-
-        byte_in_progress_++;
-        if (byte_in_progress_ == buffer_length_)
-          byte_in_progress_ = 0;
-
-        return true;
-      }
-    return false;
-  }
-
-  bool push(T new_value)
-  {
-    // the process node should have higher priority than the rx it callback
-#if 0
-    if ((byte_in_progress_ == (byte_to_add_ + 1)) || ( (byte_to_add_ == (buffer_length_ - 1) )&& (byte_in_progress_ == 0)) ) return false;
-#endif
-
-    buf_[byte_to_add_] = new_value;
-
-    byte_to_add_++;
-
-    if (byte_to_add_ == buffer_length_)
-      {
-        byte_to_add_ = 0;
-      }
-    return true;
-  }
-
-  uint16_t length()
-  {
-    if(byte_to_add_ - byte_in_progress_ >= 0)
-      return (byte_to_add_ - byte_in_progress_);
-    else 
-      return (byte_to_add_ - (buffer_length_ - byte_in_progress_));
-  }
-
-private:
-  T buf_[SIZE];
-  int16_t byte_in_progress_, byte_to_add_;
-  uint16_t buffer_length_;
-};
-
-
-
 /* RX */
 namespace rx
 {
@@ -86,7 +26,7 @@ namespace rx
   int read();
   bool available();
   uint8_t* getRxValueP();
-  RingBuffer<uint8_t, RX_PACKET_SIZE>* getRxBuffer();
+  RingBufferFiFo<uint8_t, RX_BUFFER_SIZE>* getRxBuffer();
   uint8_t getBurstSize();
 };
 
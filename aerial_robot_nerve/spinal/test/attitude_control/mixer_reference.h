@@ -0,0 +1,407 @@
+/*
+******************************************************************************
+* File Name          : mixer_reference.h
+* Description        : per motor implementation of AttitudeController::update / pwmConversion
+*                      before MotorMixer, as the reference of the bit-exactness,
+*                      and the random control ticks for both of them
+******************************************************************************
+*/
+
+#ifndef __MIXER_REFERENCE_H
+#define __MIXER_REFERENCE_H
+
+#include "flight_control/attitude/motor_mixer.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MIXER_REFERENCE_RDTSC 1
+#endif
+
+namespace mixer_reference
+{
+  enum {X = 0, Y = 1, Z = 2};
+
+  struct MotorInfo
+  {
+    float voltage;
+    float max_thrust;
+    float polynominal[5];
+  };
+
+  /* spinal::RollPitchYawTerm */
+  struct ControlTerm
+  {
+    int16_t roll_p, roll_i, roll_d;
+    int16_t pitch_p, pitch_i, pitch_d;
+    int16_t yaw_d;
+  };
+
+  /* the members of AttitudeController used by the per motor math, in the original layout */
+  struct PerMotorController
+  {
+    int motor_number = 0;
+    bool start_control_flag = true;
+    int8_t pwm_conversion_mode = -1;
+    int8_t rotor_devider = 1;
+    float v_factor = 1;
+    float min_thrust = 0;
+    float min_duty = 0;
+    float max_duty = 1;
+    int max_yaw_term_index = -1;
+    MotorInfo motor_info;
+    float base_thrust_decreasing_rate = 0; // of the last pwmConversion()
+    float yaw_decreasing_rate = 0;
+
+    float thrust_p_gain[MAX_MOTOR_NUMBER][3];
+    float thrust_i_gain[MAX_MOTOR_NUMBER][3];
+    float thrust_d_gain[MAX_MOTOR_NUMBER][3];
+    float p_matrix_pseudo_inverse[MAX_MOTOR_NUMBER][4];
+    float base_thrust_term[MAX_MOTOR_NUMBER];
+    float roll_pitch_term[MAX_MOTOR_NUMBER];
+    float yaw_term[MAX_MOTOR_NUMBER];
+    float extra_yaw_pi_term[MAX_MOTOR_NUMBER];
+    float target_thrust[MAX_MOTOR_NUMBER];
+    float target_pwm[MAX_MOTOR_NUMBER];
+    /* the messages were filled in every control tick */
+    ControlTerm control_term[MAX_MOTOR_NUMBER];
+    uint16_t motor_value[MAX_MOTOR_NUMBER];
+
+    PerMotorController()
+    {
+      memset(thrust_p_gain, 0, sizeof(thrust_p_gain));
+      memset(thrust_i_gain, 0, sizeof(thrust_i_gain));
+      memset(thrust_d_gain, 0, sizeof(thrust_d_gain));
+      memset(p_matrix_pseudo_inverse, 0, sizeof(p_matrix_pseudo_inverse));
+      memset(base_thrust_term, 0, sizeof(base_thrust_term));
+      memset(roll_pitch_term, 0, sizeof(roll_pitch_term));
+      memset(yaw_term, 0, sizeof(yaw_term));
+      memset(extra_yaw_pi_term, 0, sizeof(extra_yaw_pi_term));
+      memset(target_thrust, 0, sizeof(target_thrust));
+      memset(target_pwm, 0, sizeof(target_pwm));
+      memset(control_term, 0, sizeof(control_term));
+      memset(motor_value, 0, sizeof(motor_value));
+    }
+
+    /* linear control method of update() */
+    void controlTerms(const float error_angle[3], const float error_angle_i[3], const ap::Vector3f& vel, const ap::Vector3f& gyro_moment)
+    {
+      float p_term = 0;
+      float i_term = 0;
+      float d_term = 0;
+      for(int i = 0; i < motor_number; i++)
+        {
+          for(int axis = 0; axis < 3; axis++)
+            {
+              p_term = error_angle[axis] * thrust_p_gain[i][axis];
+              i_term = error_angle_i[axis] * thrust_i_gain[i][axis];
+              d_term = -vel[axis] * thrust_d_gain[i][axis];
+              if(axis == X)
+                {
+                  roll_pitch_term[i] = p_term + i_term + d_term; // [N]
+                  control_term[i].roll_p = p_term * 1000;
+                  control_term[i].roll_i= i_term * 1000;
+                  control_term[i].roll_d = d_term * 1000;
+                }
+              if(axis == Y)
+                {
+                  roll_pitch_term[i] += (p_term + i_term + d_term); // [N]
+                  control_term[i].pitch_p = p_term * 1000;
+                  control_term[i].pitch_i = i_term * 1000;
+                  control_term[i].pitch_d = d_term * 1000;
+                }
+              if(axis == Z)
+                {
+                  yaw_term[i] = extra_yaw_pi_term[i] + d_term;
+                  control_term[i].yaw_d = d_term * 1000;
+                }
+            }
+
+          /* gyro moment compensation */
+          float gyro_moment_compensate =
+            p_matrix_pseudo_inverse[i][0] * gyro_moment.x +
+            p_matrix_pseudo_inverse[i][1] * gyro_moment.y +
+            p_matrix_pseudo_inverse[i][2] * gyro_moment.z;
+          roll_pitch_term[i] += gyro_moment_compensate;
+        }
+    }
+
+    float convert(float target_thrust) const
+    {
+      float scaled_thrust = v_factor * target_thrust / rotor_devider;
+      float target_pwm = 0;
+      if (scaled_thrust < 0) scaled_thrust = 0;
+
+      switch(pwm_conversion_mode)
+        {
+        case MotorMixer::SQRT_MODE:
+          {
+            float sqrt_tmp = motor_info.polynominal[1] * motor_info.polynominal[1] - 4 * 10 * motor_info.polynominal[2] * (motor_info.polynominal[0] - scaled_thrust);
+            target_pwm = (-motor_info.polynominal[1] + sqrt_tmp * ap::inv_sqrt(sqrt_tmp)) / (2 * motor_info.polynominal[2]);
+            break;
+          }
+        case MotorMixer::POLYNOMINAL_MODE:
+          {
+            float tenth_scaled_thrust = scaled_thrust * 0.1f;
+            int max_dimenstional = 4;
+            target_pwm = motor_info.polynominal[max_dimenstional];
+            for (int j = max_dimenstional - 1; j >= 0; j--)
+              target_pwm = target_pwm * tenth_scaled_thrust + motor_info.polynominal[j];
+            break;
+          }
+        default:
+          {
+            break;
+          }
+        }
+      return target_pwm / 100;
+    }
+
+    /* pwmConversion() after the voltage update */
+    void pwmConversion()
+    {
+      base_thrust_decreasing_rate = 0;
+      yaw_decreasing_rate = 0;
+      float thrust_limit = motor_info.max_thrust / v_factor;
+
+      float max_thrust = 0;
+      int max_thrust_index = 0;
+      for(int i = 0; i < motor_number; i++)
+        {
+          float thrust = base_thrust_term[i] + roll_pitch_term[i];
+          if(max_thrust < thrust)
+            {
+              max_thrust = thrust;
+              max_thrust_index = i;
+            }
+        }
+
+      if(start_control_flag)
+        {
+          float residual_term = thrust_limit - max_thrust / rotor_devider;
+
+          if(residual_term < 0 && base_thrust_term[max_thrust_index] > 0)
+            {
+              base_thrust_decreasing_rate = residual_term / (base_thrust_term[max_thrust_index] / rotor_devider);
+              yaw_decreasing_rate = -1;
+            }
+          else
+            {
+              if(max_yaw_term_index != -1 && base_thrust_term[0] > 0 )
+                {
+                  max_thrust = 0;
+                  float min_thrust_tmp = 10000;
+                  int min_thrust_index = 0;
+                  for(int i = 0; i < motor_number; i++)
+                    {
+                      float thrust = base_thrust_term[i] + roll_pitch_term[i] + yaw_term[i];
+                      if(max_thrust < thrust)
+                        {
+                          max_thrust = thrust;
+                          max_thrust_index = i;
+                        }
+                      if(min_thrust_tmp > thrust)
+                        {
+                          min_thrust_tmp = thrust;
+                          min_thrust_index = i;
+                        }
+                    }
+
+                  float residual_term_max =  thrust_limit - max_thrust / rotor_devider;
+                  float residual_term_min =  min_thrust_tmp / rotor_devider - min_thrust;
+                  int thrust_index = 0;
+                  if (residual_term_min < residual_term_max)
+                    {
+                      residual_term = residual_term_min;
+                      thrust_index = min_thrust_index;
+                    }
+                  else
+                    {
+                      residual_term = residual_term_max;
+                      thrust_index = max_thrust_index;
+                    }
+
+                  if(residual_term < 0)
+                    {
+                      yaw_decreasing_rate = residual_term / (fabs(yaw_term[thrust_index]) / rotor_devider);
+                    }
+
+                  if(yaw_decreasing_rate < -1) yaw_decreasing_rate = -1;
+                  if(yaw_decreasing_rate > 0) yaw_decreasing_rate = 0;
+                }
+              else
+                {
+                  yaw_decreasing_rate = -1;
+                }
+            }
+        }
+
+      for(int i = 0; i < motor_number; i++)
+        target_thrust[i] = roll_pitch_term[i] + (1 + base_thrust_decreasing_rate) * base_thrust_term[i] + (1 + yaw_decreasing_rate) * yaw_term[i];
+
+      for(int i = 0; i < motor_number; i++)
+        {
+          if(start_control_flag)
+            {
+              target_pwm[i] = convert(target_thrust[i]);
+
+              if(target_pwm[i] < min_duty) target_pwm[i]  = min_duty;
+              else if(target_pwm[i]  > max_duty) target_pwm[i]  = max_duty;
+            }
+
+          motor_value[i] = (target_pwm[i] * 2000);
+        }
+    }
+  };
+
+  struct ControlInput
+  {
+    float error_angle[3];
+    float error_angle_i[3];
+    ap::Vector3f vel;
+    ap::Vector3f gyro_moment;
+  };
+
+  struct ScenarioConfig
+  {
+    int motor_number = 4;
+    int8_t mode = MotorMixer::SQRT_MODE;
+    int8_t rotor_devider = 1;
+    float v_factor = 1.1f;
+    float hover_thrust = 5.0f; // [N] per motor
+    float thrust_spread = 4.0f; // [N], large enough for the both saturation levels
+    float min_thrust = 1.0f;
+    unsigned int seed = 1;
+  };
+
+  /* the same random gains, motor info and base thrust to both implementations */
+  class Scenario
+  {
+  public:
+    Scenario(const ScenarioConfig& config): config_(config), engine_(config.seed), unit_(-1.0f, 1.0f) {}
+
+    void setup(PerMotorController& reference, MotorMixer& mixer)
+    {
+      MotorInfo& info = reference.motor_info;
+      info.voltage = 16.0f;
+      info.max_thrust = 12.0f;
+      if(config_.mode == MotorMixer::SQRT_MODE)
+        {
+          /* thrust[N] = p0 + p1 pwm[%] + p2 pwm[%]^2 / 10 */
+          info.polynominal[0] = -2.0f; info.polynominal[1] = 0.1f; info.polynominal[2] = 0.02f;
+          info.polynominal[3] = 0; info.polynominal[4] = 0;
+        }
+      else
+        {
+          /* pwm[%] = sum p_j (thrust[N] / 10)^j */
+          info.polynominal[0] = 20.0f; info.polynominal[1] = 65.0f; info.polynominal[2] = -35.0f;
+          info.polynominal[3] = 14.0f; info.polynominal[4] = -2.5f;
+        }
+
+      reference.motor_number = config_.motor_number;
+      reference.pwm_conversion_mode = config_.mode;
+      reference.rotor_devider = config_.rotor_devider;
+      reference.v_factor = config_.v_factor;
+      reference.min_thrust = config_.min_thrust;
+      reference.min_duty = 0.55f;
+      reference.max_duty = 0.95f;
+
+      mixer.setMotorNumber(config_.motor_number);
+      mixer.setConversion(config_.mode, info.polynominal, info.max_thrust, config_.v_factor, config_.rotor_devider);
+
+      for(int i = 0; i < config_.motor_number; i++)
+        {
+          for(int axis = 0; axis < 3; axis++)
+            {
+              float p = (axis == Z ? 0 : 2.0f * unit_(engine_));
+              float d = (axis == Z ? unit_(engine_) : 0.5f * unit_(engine_));
+              float i_gain = (axis == Z ? 0 : 0.2f * unit_(engine_));
+              reference.thrust_p_gain[i][axis] = mixer.thrust_p_gain[axis][i] = p;
+              reference.thrust_i_gain[i][axis] = mixer.thrust_i_gain[axis][i] = i_gain;
+              reference.thrust_d_gain[i][axis] = mixer.thrust_d_gain[axis][i] = d;
+              reference.p_matrix_pseudo_inverse[i][axis] = mixer.p_matrix_pseudo_inverse[axis][i] = 10.0f * unit_(engine_);
+            }
+        }
+
+      /* as maxYawGainIndex() */
+      float max_yaw_gain = 0;
+      reference.max_yaw_term_index = -1;
+      for(int i = 0; i < config_.motor_number; i++)
+        {
+          if(reference.thrust_d_gain[i][Z] > max_yaw_gain)
+            {
+              max_yaw_gain = reference.thrust_d_gain[i][Z];
+              reference.max_yaw_term_index = i;
+            }
+        }
+    }
+
+    /* new command and state of one control tick */
+    ControlInput next(PerMotorController& reference, MotorMixer& mixer)
+    {
+      for(int i = 0; i < config_.motor_number; i++)
+        {
+          float base_thrust = config_.hover_thrust + config_.thrust_spread * unit_(engine_);
+          float extra_yaw = 0.5f * unit_(engine_);
+          reference.base_thrust_term[i] = mixer.base_thrust_term[i] = base_thrust;
+          reference.extra_yaw_pi_term[i] = mixer.extra_yaw_pi_term[i] = extra_yaw;
+        }
+
+      ControlInput input;
+      for(int axis = 0; axis < 3; axis++)
+        {
+          input.error_angle[axis] = 0.3f * unit_(engine_);
+          input.error_angle_i[axis] = 0.1f * unit_(engine_);
+          input.vel[axis] = 2.0f * unit_(engine_);
+          input.gyro_moment[axis] = 0.05f * unit_(engine_);
+        }
+      return input;
+    }
+
+  private:
+    ScenarioConfig config_;
+    std::mt19937 engine_;
+    std::uniform_real_distribution<float> unit_;
+  };
+
+  inline uint64_t cycles()
+  {
+#ifdef MIXER_REFERENCE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  struct Cost
+  {
+    double ns_per_update;
+    double cycles_per_update;
+  };
+
+  /* cost of controlTerms and the saturation / conversion per control tick, the inputs are prepared beforehand,
+     the best of the repeats against the noise of the host */
+  template <class Update> Cost measure(int ticks, Update update, int repeat = 5)
+  {
+    Cost best;
+    for(int r = 0; r < repeat; r++)
+      {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t start_cycles = cycles();
+        for(int tick = 0; tick < ticks; tick++) update(tick);
+        uint64_t end_cycles = cycles();
+        auto end = std::chrono::steady_clock::now();
+
+        Cost cost;
+        cost.ns_per_update = std::chrono::duration<double, std::nano>(end - start).count() / ticks;
+        cost.cycles_per_update = static_cast<double>(end_cycles - start_cycles) / ticks;
+        if(r == 0 || cost.ns_per_update < best.ns_per_update) best = cost;
+      }
+    return best;
+  }
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+******************************************************************************
+* File Name          : attitude_control_benchmark.cpp
+* Description        : cost per control tick of the per motor math in AttitudeController,
+*                      MotorMixer vs the per motor implementation before it
+*                      usage: attitude_control_benchmark [ticks]
+******************************************************************************
+*/
+
+#include "attitude_control/mixer_reference.h"
+#include <cstdlib>
+#include <stdio.h>
+#include <vector>
+
+using namespace mixer_reference;
+
+namespace
+{
+  struct Tick
+  {
+    ControlInput input;
+    float base_thrust_term[MAX_MOTOR_NUMBER];
+    float extra_yaw_pi_term[MAX_MOTOR_NUMBER];
+  };
+
+  void printRow(const ScenarioConfig& config, int ticks)
+  {
+    PerMotorController reference;
+    MotorMixer mixer;
+    Scenario scenario(config);
+    scenario.setup(reference, mixer);
+
+    /* the random inputs are out of the measurement */
+    std::vector<Tick> inputs(ticks);
+    for(Tick& tick : inputs)
+      {
+        tick.input = scenario.next(reference, mixer);
+        memcpy(tick.base_thrust_term, reference.base_thrust_term, sizeof(tick.base_thrust_term));
+        memcpy(tick.extra_yaw_pi_term, reference.extra_yaw_pi_term, sizeof(tick.extra_yaw_pi_term));
+      }
+
+    volatile float sink = 0; // keep the results alive
+    Cost per_motor = measure(ticks, [&](int t) {
+        const Tick& tick = inputs[t];
+        memcpy(reference.base_thrust_term, tick.base_thrust_term, sizeof(tick.base_thrust_term));
+        memcpy(reference.extra_yaw_pi_term, tick.extra_yaw_pi_term, sizeof(tick.extra_yaw_pi_term));
+        reference.controlTerms(tick.input.error_angle, tick.input.error_angle_i, tick.input.vel, tick.input.gyro_moment);
+        reference.pwmConversion();
+        sink = reference.target_pwm[0];
+      });
+    Cost soa = measure(ticks, [&](int t) {
+        const Tick& tick = inputs[t];
+        memcpy(mixer.base_thrust_term, tick.base_thrust_term, sizeof(tick.base_thrust_term));
+        memcpy(mixer.extra_yaw_pi_term, tick.extra_yaw_pi_term, sizeof(tick.extra_yaw_pi_term));
+        mixer.controlTerms(tick.input.error_angle, tick.input.error_angle_i, tick.input.vel, tick.input.gyro_moment);
+        mixer.mix(true, reference.max_yaw_term_index, reference.min_thrust, reference.min_duty, reference.max_duty);
+        sink = mixer.target_pwm[0];
+      });
+
+    printf("%6d %12s %8d | %8.1f %8.1f | %8.1f %8.1f | %6.2f\n",
+           config.motor_number, config.mode == MotorMixer::SQRT_MODE ? "sqrt" : "polynominal", config.rotor_devider,
+           per_motor.ns_per_update, per_motor.cycles_per_update, soa.ns_per_update, soa.cycles_per_update,
+           per_motor.ns_per_update / soa.ns_per_update);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int ticks = 200000;
+  if (argc > 1) ticks = atoi(argv[1]);
+
+  printf("%d ticks per row (best of 5), ns and cycles per control tick (pid terms, saturation avoidance and pwm conversion)\n", ticks);
+  printf("%6s %12s %8s | %17s | %17s | %6s\n", "motor", "mode", "devider", "per motor", "MotorMixer", "ratio");
+
+  ScenarioConfig config;
+  for(int8_t mode : {MotorMixer::SQRT_MODE, MotorMixer::POLYNOMINAL_MODE})
+    {
+      config.mode = mode;
+      for(int motor_number : {4, 6, 8, MAX_MOTOR_NUMBER})
+        {
+          config.motor_number = motor_number;
+          config.rotor_devider = (motor_number == 8 ? 2 : 1); // dragon
+          printRow(config, ticks);
+        }
+    }
+
+  return 0;
+}
@@ -0,0 +1,158 @@
+/*
+******************************************************************************
+* File Name          : attitude_control_test.cpp
+* Description        : bit-exactness of MotorMixer against the per motor implementation
+*                      of AttitudeController, the cost table is given by attitude_control_benchmark
+******************************************************************************
+*/
+
+#include "attitude_control/mixer_reference.h"
+#include <gtest/gtest.h>
+
+using namespace mixer_reference;
+
+namespace
+{
+  const int TICKS = 2000;
+
+  uint32_t bits(float value)
+  {
+    uint32_t b;
+    memcpy(&b, &value, sizeof(b));
+    return b;
+  }
+
+  void expectBitExact(const float* expected, const float* actual, int motor_number, const char* name, int tick)
+  {
+    for(int i = 0; i < motor_number; i++)
+      EXPECT_EQ(bits(expected[i]), bits(actual[i])) << name << "[" << i << "] at tick " << tick << ": " << expected[i] << " vs " << actual[i];
+  }
+
+  /* count of the ticks in which the saturation avoidance takes effect */
+  struct Saturation
+  {
+    int base_thrust = 0; // level 2
+    int yaw = 0; // level 1, partially reduced yaw term
+  };
+
+  Saturation run(const ScenarioConfig& config, bool start_control = true)
+  {
+    PerMotorController reference;
+    MotorMixer mixer;
+    Scenario scenario(config);
+    scenario.setup(reference, mixer);
+    reference.start_control_flag = start_control;
+
+    /* min duty from min thrust at the voltage update */
+    EXPECT_EQ(bits(reference.convert(config.min_thrust)), bits(mixer.convert(config.min_thrust)));
+
+    Saturation saturation;
+    for(int tick = 0; tick < TICKS; tick++)
+      {
+        ControlInput input = scenario.next(reference, mixer);
+
+        reference.controlTerms(input.error_angle, input.error_angle_i, input.vel, input.gyro_moment);
+        reference.pwmConversion();
+        mixer.controlTerms(input.error_angle, input.error_angle_i, input.vel, input.gyro_moment);
+        mixer.mix(start_control, reference.max_yaw_term_index, reference.min_thrust, reference.min_duty, reference.max_duty);
+
+        expectBitExact(reference.roll_pitch_term, mixer.roll_pitch_term, config.motor_number, "roll_pitch_term", tick);
+        expectBitExact(reference.yaw_term, mixer.yaw_term, config.motor_number, "yaw_term", tick);
+        expectBitExact(reference.target_thrust, mixer.target_thrust, config.motor_number, "target_thrust", tick);
+        expectBitExact(reference.target_pwm, mixer.target_pwm, config.motor_number, "target_pwm", tick);
+
+        /* the messages filled at the publish */
+        for(int i = 0; i < config.motor_number; i++)
+          {
+            EXPECT_EQ(reference.control_term[i].roll_p, static_cast<int16_t>(mixer.p_term[X][i] * 1000));
+            EXPECT_EQ(reference.control_term[i].pitch_i, static_cast<int16_t>(mixer.i_term[Y][i] * 1000));
+            EXPECT_EQ(reference.control_term[i].yaw_d, static_cast<int16_t>(mixer.d_term[Z][i] * 1000));
+            EXPECT_EQ(reference.motor_value[i], static_cast<uint16_t>(mixer.target_pwm[i] * 2000));
+          }
+        if(::testing::Test::HasFailure()) break;
+
+        if(reference.base_thrust_decreasing_rate < 0) saturation.base_thrust++;
+        else if(reference.yaw_decreasing_rate < 0 && reference.yaw_decreasing_rate > -1) saturation.yaw++;
+      }
+    return saturation;
+  }
+}
+
+TEST(AttitudeControlTest, SqrtModeBitExact)
+{
+  ScenarioConfig config;
+  config.mode = MotorMixer::SQRT_MODE;
+  for(int motor_number = 1; motor_number <= MAX_MOTOR_NUMBER; motor_number++)
+    {
+      config.motor_number = motor_number;
+      config.seed = motor_number;
+      run(config);
+    }
+}
+
+TEST(AttitudeControlTest, PolynominalModeBitExact)
+{
+  ScenarioConfig config;
+  config.mode = MotorMixer::POLYNOMINAL_MODE;
+  config.v_factor = 0.93f;
+  for(int motor_number = 1; motor_number <= MAX_MOTOR_NUMBER; motor_number++)
+    {
+      config.motor_number = motor_number;
+      config.seed = motor_number;
+      run(config);
+    }
+}
+
+TEST(AttitudeControlTest, DualRotor)
+{
+  /* dragon: rotor_devider = 2 */
+  ScenarioConfig config;
+  config.motor_number = 8;
+  config.rotor_devider = 2;
+  config.hover_thrust = 12.0f;
+  config.thrust_spread = 8.0f;
+  for(int8_t mode : {MotorMixer::SQRT_MODE, MotorMixer::POLYNOMINAL_MODE})
+    {
+      config.mode = mode;
+      run(config);
+    }
+}
+
+TEST(AttitudeControlTest, SaturationLevels)
+{
+  /* both levels of the saturation avoidance are exercised by the bit-exact ticks */
+  ScenarioConfig config;
+  config.motor_number = 6;
+  config.hover_thrust = 9.0f;
+  config.thrust_spread = 5.0f;
+  Saturation saturation = run(config);
+  EXPECT_GT(saturation.base_thrust, TICKS / 40);
+  EXPECT_GT(saturation.yaw, TICKS / 40);
+}
+
+TEST(AttitudeControlTest, NegativeThrust)
+{
+  /* no positive thrust: neither saturation level, and the pwm is clamped to the min duty */
+  ScenarioConfig config;
+  config.motor_number = 4;
+  config.hover_thrust = -3.0f;
+  config.thrust_spread = 2.0f;
+  run(config);
+}
+
+TEST(AttitudeControlTest, NotStarted)
+{
+  /* only the target thrust is updated, the target pwm stays */
+  ScenarioConfig config;
+  config.motor_number = 4;
+  run(config, false);
+}
+
+TEST(AttitudeControlTest, UnknownConversionMode)
+{
+  /* pwm_conversion_mode_ before the motor info: the min duty */
+  ScenarioConfig config;
+  config.motor_number = 4;
+  config.mode = -1;
+  run(config);
+}
@@ -0,0 +1,214 @@
+/*
+******************************************************************************
+* File Name          : imu_replay.h
+* Description        : host replay of imu logs for the spinal attitude estimators,
+*                      attitude error against the ground truth and the cost per update
+******************************************************************************
+*/
+
+#ifndef __IMU_REPLAY_H
+#define __IMU_REPLAY_H
+
+/* the estimators take the time step from ros::Time::now() in SIMULATION */
+#include <ros/ros.h>
+#include "state_estimate/attitude/complementary_ahrs.h"
+#include "state_estimate/attitude/madgwick_ahrs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define IMU_REPLAY_RDTSC 1
+#endif
+
+namespace imu_replay
+{
+  const float G = 9.797f;
+
+  struct ImuSample
+  {
+    double t;
+    ap::Vector3f gyro; // [rad/s]
+    ap::Vector3f acc; // [m/s^2], [0, 0, G] at rest
+    ap::Vector3f mag; // held between the mag updates, as the spinal imu driver does
+    ap::Vector3f rpy; // ground truth
+  };
+
+  struct TrajectoryConfig
+  {
+    double duration = 60.0;
+    double rate = 1000.0;
+    double mag_rate = 100.0;
+    double static_duration = 10.0; // keep level at the beginning for the initial convergence
+    ap::Vector3f amplitude = ap::Vector3f(0.3f, 0.3f, 1.0f); // sinusoidal roll, pitch, yaw [rad]
+    ap::Vector3f frequency = ap::Vector3f(0.5f, 0.37f, 0.1f); // [Hz]
+    float gyro_noise = 0.005f; // [rad/s]
+    ap::Vector3f gyro_bias = ap::Vector3f(0.0f, 0.0f, 0.0f);
+    float acc_noise = 0.05f; // [m/s^2]
+    float mag_noise = 0.005f; // normalized
+    float mag_inclination = 0.87f; // [rad], downward in the north hemisphere
+    unsigned int seed = 1;
+  };
+
+  struct ReplayResult
+  {
+    ap::Vector3f rms; // [rad]
+    ap::Vector3f max;
+    float gyro_lpf_rms; // error between the filtered and the true angular velocity [rad/s]
+    double ns_per_update;
+    double cycles_per_update; // 0 if the cycle counter is not available
+    int samples;
+  };
+
+  /* synthetic rotation around the imu: no translation, so the acc only measures the gravity */
+  inline std::vector<ImuSample> generateTrajectory(const TrajectoryConfig& config)
+  {
+    std::mt19937 engine(config.seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    auto noise = [&](float sigma) { return ap::Vector3f(normal(engine), normal(engine), normal(engine)) * sigma; };
+
+    const ap::Vector3f gravity(0, 0, G);
+    const ap::Vector3f mag_world(cosf(config.mag_inclination), 0, -sinf(config.mag_inclination));
+
+    std::vector<ImuSample> samples;
+    int size = config.duration * config.rate;
+    int mag_interval = std::max(1, (int)(config.rate / config.mag_rate));
+    samples.reserve(size);
+    ap::Vector3f mag;
+
+    for(int i = 0; i < size; i++)
+      {
+        ImuSample sample;
+        sample.t = i / config.rate;
+
+        ap::Vector3f rpy, rpy_dot;
+        double t = sample.t - config.static_duration;
+        if(t > 0)
+          {
+            for(int j = 0; j < 3; j++)
+              {
+                float w = 2 * M_PI * config.frequency[j];
+                rpy[j] = config.amplitude[j] * sinf(w * t);
+                rpy_dot[j] = config.amplitude[j] * w * cosf(w * t);
+              }
+          }
+        sample.rpy = rpy;
+
+        /* euler rate to body angular velocity */
+        float sr = sinf(rpy.x), cr = cosf(rpy.x), sp = sinf(rpy.y), cp = cosf(rpy.y);
+        ap::Vector3f omega(rpy_dot.x - sp * rpy_dot.z,
+                           cr * rpy_dot.y + sr * cp * rpy_dot.z,
+                           -sr * rpy_dot.y + cr * cp * rpy_dot.z);
+        sample.gyro = omega + config.gyro_bias + noise(config.gyro_noise);
+
+        ap::Matrix3f r; // body to world
+        r.from_euler(rpy.x, rpy.y, rpy.z);
+        sample.acc = r.mul_transpose(gravity) + noise(config.acc_noise);
+        if(i % mag_interval == 0) mag = r.mul_transpose(mag_world) + noise(config.mag_noise);
+        sample.mag = mag;
+
+        samples.push_back(sample);
+      }
+
+    return samples;
+  }
+
+  /* csv log: t, gx, gy, gz, ax, ay, az, mx, my, mz, roll, pitch, yaw; lines starting with '#' are skipped */
+  inline bool loadCsv(const std::string& file, std::vector<ImuSample>& samples)
+  {
+    std::ifstream ifs(file);
+    if(!ifs) return false;
+
+    std::string line;
+    while(std::getline(ifs, line))
+      {
+        if(line.empty() || line[0] == '#') continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream iss(line);
+        ImuSample s;
+        if(!(iss >> s.t >> s.gyro.x >> s.gyro.y >> s.gyro.z >> s.acc.x >> s.acc.y >> s.acc.z
+             >> s.mag.x >> s.mag.y >> s.mag.z >> s.rpy.x >> s.rpy.y >> s.rpy.z))
+          return false;
+        samples.push_back(s);
+      }
+    return !samples.empty();
+  }
+
+  inline float wrapAngle(float angle)
+  {
+    return atan2f(sinf(angle), cosf(angle));
+  }
+
+  /* feed the samples to the estimator, and evaluate the body frame attitude after settle [sec] */
+  template<class Estimator> ReplayResult replay(Estimator& estimator, const std::vector<ImuSample>& samples, double settle,
+                                                const std::vector<ap::Vector3f>& true_gyro = std::vector<ap::Vector3f>())
+  {
+    ReplayResult result;
+    result.rms.zero();
+    result.max.zero();
+    result.gyro_lpf_rms = 0;
+    result.samples = 0;
+
+    uint64_t cycles = 0;
+    std::chrono::nanoseconds elapsed(0);
+
+    for(size_t i = 0; i < samples.size(); i++)
+      {
+        const ImuSample& sample = samples.at(i);
+        ros::Time::setNow(ros::Time(sample.t + 1.0)); // ros::Time can not be zero
+
+        auto start = std::chrono::steady_clock::now();
+#ifdef IMU_REPLAY_RDTSC
+        uint64_t start_cycle = __rdtsc();
+#endif
+        estimator.update(sample.gyro, sample.acc, sample.mag);
+#ifdef IMU_REPLAY_RDTSC
+        cycles += __rdtsc() - start_cycle;
+#endif
+        elapsed += std::chrono::steady_clock::now() - start;
+
+        if(sample.t < settle) continue;
+
+        ap::Vector3f rpy = estimator.getAttitude(Frame::BODY);
+        for(int j = 0; j < 3; j++)
+          {
+            float err = fabsf(wrapAngle(rpy[j] - sample.rpy[j]));
+            result.rms[j] += err * err;
+            result.max[j] = std::max(result.max[j], err);
+          }
+        if(i < true_gyro.size())
+          result.gyro_lpf_rms += (estimator.getSmoothAngular(Frame::BODY) - true_gyro.at(i)).length_squared();
+        result.samples++;
+      }
+
+    if(result.samples > 0)
+      {
+        for(int j = 0; j < 3; j++) result.rms[j] = sqrtf(result.rms[j] / result.samples);
+        result.gyro_lpf_rms = sqrtf(result.gyro_lpf_rms / result.samples);
+      }
+    result.ns_per_update = (double)elapsed.count() / samples.size();
+    result.cycles_per_update = (double)cycles / samples.size();
+
+    return result;
+  }
+
+  /* noise-free angular velocity of the synthetic trajectory, for the lpf evaluation */
+  inline std::vector<ap::Vector3f> trueAngular(TrajectoryConfig config)
+  {
+    config.gyro_noise = 0;
+    config.gyro_bias.zero();
+    std::vector<ImuSample> samples = generateTrajectory(config);
+    std::vector<ap::Vector3f> gyro;
+    gyro.reserve(samples.size());
+    for(const auto& s: samples) gyro.push_back(s.gyro);
+    return gyro;
+  }
+}
+
+#endif
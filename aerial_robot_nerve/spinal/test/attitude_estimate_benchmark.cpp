@@ -0,0 +1,94 @@
+/*
+******************************************************************************
+* File Name          : attitude_estimate_benchmark.cpp
+* Description        : accuracy vs cost tables of the spinal attitude estimators
+*                      usage: attitude_estimate_benchmark [log.csv]
+*                      without the csv log, the synthetic trajectory with gyro bias is used
+******************************************************************************
+*/
+
+#include "attitude_estimate/imu_replay.h"
+#include <iostream>
+
+using namespace imu_replay;
+
+namespace
+{
+  const double SETTLE = 20.0;
+  const float RAD2DEG = 180.0f / M_PI;
+
+  void printHeader(const std::string& title, const std::string& param)
+  {
+    printf("\n%s\n", title.c_str());
+    printf("%12s | %8s %8s %8s | %8s %8s %8s | %10s | %8s %8s\n", param.c_str(),
+           "rms_r", "rms_p", "rms_y", "max_r", "max_p", "max_y", "lpf_rms", "ns", "cycles");
+  }
+
+  void printRow(float param, const ReplayResult& r)
+  {
+    printf("%12.4f | %8.4f %8.4f %8.4f | %8.4f %8.4f %8.4f | %10.5f | %8.1f %8.1f\n", param,
+           r.rms.x * RAD2DEG, r.rms.y * RAD2DEG, r.rms.z * RAD2DEG,
+           r.max.x * RAD2DEG, r.max.y * RAD2DEG, r.max.z * RAD2DEG,
+           r.gyro_lpf_rms, r.ns_per_update, r.cycles_per_update);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init(); // the replay sets the simulated time
+
+  std::vector<ImuSample> samples;
+  std::vector<ap::Vector3f> true_gyro;
+
+  if(argc > 1)
+    {
+      if(!loadCsv(argv[1], samples))
+        {
+          std::cerr << "can not load the imu log: " << argv[1] << std::endl;
+          return 1;
+        }
+    }
+  else
+    {
+      TrajectoryConfig config;
+      config.gyro_bias = ap::Vector3f(0.005f, -0.005f, 0.002f);
+      samples = generateTrajectory(config);
+      true_gyro = trueAngular(config);
+    }
+
+  printf("%lu samples, attitude errors in [deg], lpf error in [rad/s], cost per update\n", samples.size());
+
+  printHeader("complementary: acc correction factor (mag factor 250)", "acc_factor");
+  for(float factor: {50.0f, 100.0f, 200.0f, 400.0f, 600.0f, 1000.0f, 2000.0f})
+    {
+      ComplementaryAHRS estimator;
+      estimator.setGain(factor, GYR_CMPFM_FACTOR);
+      printRow(factor, replay(estimator, samples, SETTLE, true_gyro));
+    }
+
+  printHeader("complementary: mag correction factor (acc factor 600)", "mag_factor");
+  for(float factor: {25.0f, 50.0f, 100.0f, 250.0f, 500.0f, 1000.0f})
+    {
+      ComplementaryAHRS estimator;
+      estimator.setGain(GYR_CMPF_FACTOR, factor);
+      printRow(factor, replay(estimator, samples, SETTLE, true_gyro));
+    }
+
+  printHeader("madgwick: beta", "beta");
+  for(float beta: {0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f, 0.5f})
+    {
+      MadgwickAHRS estimator;
+      estimator.setGain(beta);
+      printRow(beta, replay(estimator, samples, SETTLE, true_gyro));
+    }
+
+  printHeader("complementary: gyro lpf cutoff frequency [Hz] (rx 1000Hz)", "cutoff");
+  for(float cutoff: {5.0f, 10.0f, 20.0f, 40.0f, 80.0f, 160.0f})
+    {
+      ComplementaryAHRS estimator;
+      estimator.setLpfCutoff(1000.0f, cutoff);
+      printRow(cutoff, replay(estimator, samples, SETTLE, true_gyro));
+    }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*
+******************************************************************************
+* File Name          : attitude_estimate_test.cpp
+* Description        : pin the accuracy of the spinal attitude estimators on the synthetic trajectory,
+*                      the tables for tuning are given by attitude_estimate_benchmark
+******************************************************************************
+*/
+
+#include "attitude_estimate/imu_replay.h"
+#include <gtest/gtest.h>
+
+using namespace imu_replay;
+
+namespace
+{
+  const double SETTLE = 20.0;
+  const float DEG2RAD = M_PI / 180.0f;
+
+  void checkError(const ReplayResult& result, const ap::Vector3f& rms_threshold, const ap::Vector3f& max_threshold)
+  {
+    ASSERT_GT(result.samples, 0);
+    for(int i = 0; i < 3; i++)
+      {
+        EXPECT_LT(result.rms[i], rms_threshold[i] * DEG2RAD) << "axis " << i;
+        EXPECT_LT(result.max[i], max_threshold[i] * DEG2RAD) << "axis " << i;
+      }
+    EXPECT_GT(result.ns_per_update, 0);
+  }
+
+  TrajectoryConfig biasedTrajectory()
+  {
+    TrajectoryConfig config;
+    config.gyro_bias = ap::Vector3f(0.005f, -0.005f, 0.002f);
+    return config;
+  }
+}
+
+TEST(AttitudeEstimateTest, Complementary)
+{
+  ComplementaryAHRS estimator;
+  checkError(replay(estimator, generateTrajectory(TrajectoryConfig()), SETTLE),
+             ap::Vector3f(0.05f, 0.05f, 0.1f), ap::Vector3f(0.15f, 0.15f, 0.3f));
+}
+
+TEST(AttitudeEstimateTest, ComplementaryGyroBias)
+{
+  ComplementaryAHRS estimator;
+  checkError(replay(estimator, generateTrajectory(biasedTrajectory()), SETTLE),
+             ap::Vector3f(0.6f, 0.6f, 0.6f), ap::Vector3f(1.0f, 1.0f, 1.0f));
+}
+
+TEST(AttitudeEstimateTest, Madgwick)
+{
+  MadgwickAHRS estimator;
+  checkError(replay(estimator, generateTrajectory(TrajectoryConfig()), SETTLE),
+             ap::Vector3f(0.1f, 0.1f, 0.2f), ap::Vector3f(0.3f, 0.3f, 0.4f));
+}
+
+TEST(AttitudeEstimateTest, MadgwickGyroBias)
+{
+  MadgwickAHRS estimator;
+  checkError(replay(estimator, generateTrajectory(biasedTrajectory()), SETTLE),
+             ap::Vector3f(0.1f, 0.1f, 0.8f), ap::Vector3f(0.3f, 0.3f, 1.2f));
+}
+
+TEST(AttitudeEstimateTest, GyroLpfCutoff)
+{
+  TrajectoryConfig config;
+  std::vector<ImuSample> samples = generateTrajectory(config);
+  std::vector<ap::Vector3f> true_gyro = trueAngular(config);
+
+  /* default: 10Hz */
+  ComplementaryAHRS estimator;
+  ReplayResult result = replay(estimator, samples, SETTLE, true_gyro);
+  EXPECT_LT(result.gyro_lpf_rms, 0.25f);
+
+  /* less phase lag with the higher cutoff frequency, since the gyro noise is small */
+  ComplementaryAHRS estimator_high_cutoff;
+  estimator_high_cutoff.setLpfCutoff(1000.0f, 40.0f);
+  EXPECT_LT(replay(estimator_high_cutoff, samples, SETTLE, true_gyro).gyro_lpf_rms, 0.3f * result.gyro_lpf_rms);
+}
+
+TEST(AttitudeEstimateTest, IndependentInstances)
+{
+  /* the acc prescaler counter should be held in each instance */
+  std::vector<ImuSample> samples = generateTrajectory(TrajectoryConfig());
+  ComplementaryAHRS reference;
+  replay(reference, samples, SETTLE);
+
+  ComplementaryAHRS estimator, other;
+  for(const auto& sample: samples)
+    {
+      ros::Time::setNow(ros::Time(sample.t + 1.0));
+      estimator.update(sample.gyro, sample.acc, sample.mag);
+      other.update(sample.gyro, sample.acc, sample.mag);
+    }
+  ap::Vector3f rpy = estimator.getAttitude(Frame::BODY);
+  ap::Vector3f rpy_ref = reference.getAttitude(Frame::BODY);
+  for(int i = 0; i < 3; i++) EXPECT_FLOAT_EQ(rpy[i], rpy_ref[i]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init(); // the replay sets the simulated time
+  return RUN_ALL_TESTS();
+}
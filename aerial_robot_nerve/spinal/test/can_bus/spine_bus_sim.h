@@ -0,0 +1,605 @@
+/*
+******************************************************************************
+* File Name          : spine_bus_sim.h
+* Description        : host simulation of the spine / neuron CAN network:
+*                      CANDeviceManager and the spine side CAN devices on can_sim::Bus,
+*                      emulated neurons (motor, servo, imu) and the Spine::send() schedule:
+*                      CANScheduler, or the round robin of one neuron per 2ms before it
+******************************************************************************
+*/
+
+#ifndef __SPINE_BUS_SIM_H
+#define __SPINE_BUS_SIM_H
+
+#include "CAN/can_bus_sim.h"
+#include "CAN/can_device_manager.h"
+#include "CANDevice/motor/can_motor.h"
+#include "CANDevice/servo/can_servo.h"
+#include "Spine/can_scheduler.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string.h>
+#include <vector>
+
+namespace spine_bus_sim
+{
+  using can_sim::Time;
+
+  const Time MS = 1000000;
+  const Time US = 1000;
+
+  /* time stamp in the payload, for the latency of the data from the neurons */
+  inline uint16_t stamp(Time t) { return static_cast<uint16_t>((t / (10 * US)) & 0xFFFF); }
+  inline Time stampAge(Time now, uint16_t stamp)
+  {
+    return static_cast<Time>(static_cast<uint16_t>((now / (10 * US)) - stamp)) * 10 * US;
+  }
+
+  /* update interval and latency of one kind of data */
+  struct UpdateStat
+  {
+    uint64_t count = 0;
+    Time interval_sum = 0, interval_max = 0;
+    uint64_t interval_count = 0;
+    Time latency_sum = 0, latency_max = 0;
+
+    void addLatency(Time latency)
+    {
+      count++;
+      latency_sum += latency;
+      latency_max = std::max(latency_max, latency);
+    }
+
+    void addInterval(Time interval)
+    {
+      interval_count++;
+      interval_sum += interval;
+      interval_max = std::max(interval_max, interval);
+    }
+
+    void merge(const UpdateStat& s)
+    {
+      count += s.count;
+      latency_sum += s.latency_sum;
+      latency_max = std::max(latency_max, s.latency_max);
+      interval_count += s.interval_count;
+      interval_sum += s.interval_sum;
+      interval_max = std::max(interval_max, s.interval_max);
+    }
+
+    double latencyMean() const { return count > 0 ? static_cast<double>(latency_sum) / count / MS : 0; } // [ms]
+    double latencyMax() const { return static_cast<double>(latency_max) / MS; }
+    double intervalMean() const { return interval_count > 0 ? static_cast<double>(interval_sum) / interval_count / MS : 0; }
+    double intervalMax() const { return static_cast<double>(interval_max) / MS; }
+  };
+
+  /* interval between the updates, started from the reset of the statistics */
+  class IntervalTracker
+  {
+  public:
+    IntervalTracker(): last_(0), valid_(false) {}
+    void reset(Time t) { last_ = t; valid_ = true; }
+    void update(Time t, UpdateStat& stat)
+    {
+      if (valid_) stat.addInterval(t - last_);
+      last_ = t;
+      valid_ = true;
+    }
+    /* the pending interval at the end of the simulation also counts for the worst case */
+    void finish(Time t, UpdateStat& stat)
+    {
+      if (valid_) stat.interval_max = std::max(stat.interval_max, t - last_);
+    }
+  private:
+    Time last_;
+    bool valid_;
+  };
+
+  struct NeuronConfig
+  {
+    int servo_num = 2;
+    int servo_send_num = 1; // servos with the send data flag, e.g. the joint servo of hydrus / dragon
+    bool imu_send = true;
+    Time response_delay = 20 * US; // main loop of the neuron after the servo target reception
+    Time send_timeout = 2 * MS; // HAL_CAN_Transmit(hcan, 1) waits until the second tick at most
+  };
+
+  /* neuronlib on the bus: the same acceptance filter, motor pwm / servo target decoding,
+     and the servo states and the imu data sent back after each servo target */
+  class NeuronEmulator
+  {
+  public:
+    NeuronEmulator(can_sim::Bus& bus, uint8_t slave_id, const NeuronConfig& config, const can_sim::NodeConfig& node_config):
+      bus_(bus), slave_id_(slave_id), config_(config), pwm_(0), goal_(config.servo_num, 0), torque_(config.servo_num, false),
+      tx_index_(0), sending_(false), request_pending_(false), wait_seq_(0)
+    {
+      node_ = bus_.addNode([this](const can_sim::Frame& frame, Time t) { receive(frame, t); }, node_config);
+      bus_.setTxCallback(node_, [this](const can_sim::Frame& /* frame */, Time /* t */) { txComplete(); });
+
+      /* filters of neuronlib can_core: broadcast and own slave id */
+      bus_.addFilter(node_, (CAN::BROADCAST_ID << 5) << 16, (((1 << CAN::SLAVE_ID_LEN) - 1) << 5) << 16);
+      bus_.addFilter(node_, ((slave_id & ((1 << CAN::SLAVE_ID_LEN) - 1)) << 5) << 16, (((1 << CAN::SLAVE_ID_LEN) - 1) << 5) << 16);
+    }
+
+    uint8_t getSlaveId() const { return slave_id_; }
+    uint16_t getPwm() const { return pwm_; }
+    int32_t getGoalPosition(int i) const { return goal_.at(i); }
+    bool getTorqueEnable(int i) const { return torque_.at(i); }
+    int getNode() const { return node_; }
+
+    /* the goal position and the reception time of the servo targets, for the latency evaluation */
+    std::function<void(const NeuronEmulator&, Time)> servo_target_callback;
+    std::function<void(const NeuronEmulator&, Time)> motor_pwm_callback;
+
+  private:
+    can_sim::Bus& bus_;
+    int node_;
+    uint8_t slave_id_;
+    NeuronConfig config_;
+    uint16_t pwm_;
+    std::vector<int32_t> goal_;
+    std::vector<bool> torque_;
+
+    std::vector<can_sim::Frame> tx_queue_;
+    size_t tx_index_;
+    bool sending_;
+    bool request_pending_;
+    uint64_t wait_seq_;
+
+    static uint8_t getDeviceId(uint32_t std_id) { return (std_id >> (CAN::MESSAGE_ID_LEN + CAN::SLAVE_ID_LEN)) & ((1 << CAN::DEVICE_ID_LEN) - 1); }
+    static uint8_t getMessageId(uint32_t std_id) { return (std_id >> CAN::SLAVE_ID_LEN) & ((1 << CAN::MESSAGE_ID_LEN) - 1); }
+
+    can_sim::Frame makeFrame(uint8_t device_id, uint8_t message_id, uint8_t dlc, const uint8_t* data) const
+    {
+      can_sim::Frame frame;
+      frame.std_id = (device_id << (CAN::MESSAGE_ID_LEN + CAN::SLAVE_ID_LEN)) | (message_id << CAN::SLAVE_ID_LEN) | slave_id_;
+      frame.dlc = dlc;
+      memset(frame.data, 0, sizeof(frame.data));
+      memcpy(frame.data, data, dlc);
+      return frame;
+    }
+
+    void receive(const can_sim::Frame& frame, Time t)
+    {
+      uint8_t device_id = getDeviceId(frame.std_id);
+      uint8_t message_id = getMessageId(frame.std_id);
+      const uint8_t* data = frame.data;
+
+      if (device_id == CAN::DEVICEID_MOTOR)
+        {
+          /* Motor::receiveDataCallback */
+          int index = 0;
+          if (message_id == CAN::MESSAGEID_RECEIVE_PWM_0_5 && 1 <= slave_id_ && slave_id_ <= 6) index = slave_id_;
+          else if (message_id == CAN::MESSAGEID_RECEIVE_PWM_6_11 && 7 <= slave_id_ && slave_id_ <= 12) index = slave_id_ - 6;
+          else return;
+
+          switch (index)
+            {
+            case 1: pwm_ = ((data[1] << 8) & 0x300) | (data[0] & 0xFF); break;
+            case 2: pwm_ = ((data[2] << 6) & 0x3C0) | ((data[1] >> 2) & 0x3F); break;
+            case 3: pwm_ = ((data[3] << 4) & 0x3F0) | ((data[2] >> 4) & 0x0F); break;
+            case 4: pwm_ = ((data[5] << 8) & 0x300) | (data[4] & 0xFF); break;
+            case 5: pwm_ = ((data[6] << 6) & 0x3C0) | ((data[5] >> 2) & 0x3F); break;
+            case 6: pwm_ = ((data[7] << 4) & 0x3F0) | ((data[6] >> 4) & 0x0F); break;
+            }
+          if (motor_pwm_callback) motor_pwm_callback(*this, t);
+        }
+      else if (device_id == CAN::DEVICEID_SERVO && message_id == CAN::MESSAGEID_RECEIVE_SERVO_ANGLE)
+        {
+          /* Servo::receiveDataCallback */
+          for (int i = 0; i < config_.servo_num && 2 * i + 1 < frame.dlc; i++) setTargetAngle(i, data + i * 2);
+          if (servo_target_callback) servo_target_callback(*this, t);
+
+          /* receive_flag_ of the main loop */
+          if (sending_) request_pending_ = true;
+          else
+            {
+              sending_ = true;
+              bus_.schedule(t + config_.response_delay, [this]() { startResponse(); });
+            }
+        }
+      else if (device_id == CAN::DEVICEID_SERVO && message_id == CAN::MESSAGEID_RECEIVE_SERVO_ANGLE_MUX)
+        {
+          /* groups of [slave id | servo mask] and the targets, without the response */
+          bool received = false;
+          int i = 0;
+          while (i < frame.dlc)
+            {
+              uint8_t slave_id = data[i] >> 4;
+              uint8_t mask = data[i] & 0x0F;
+              i++;
+              for (int j = 0; j < 4 && i + 2 <= frame.dlc; j++)
+                {
+                  if (!(mask & (1 << j))) continue;
+                  if (slave_id == slave_id_ && j < config_.servo_num)
+                    {
+                      setTargetAngle(j, data + i);
+                      received = true;
+                    }
+                  i += 2;
+                }
+            }
+          if (received && servo_target_callback) servo_target_callback(*this, t);
+        }
+    }
+
+    void setTargetAngle(int i, const uint8_t* data)
+    {
+      int32_t goal_pos = ((data[1] & 0x7F) << 8) | data[0];
+      if (data[1] & 0x40) goal_pos = static_cast<int32_t>(0xFFFF8000 | goal_pos);
+      goal_[i] = goal_pos;
+      torque_[i] = ((data[1] >> 7) & 0x01) != 0;
+    }
+
+    /* servo_.sendData() and imu_.sendData() in the main loop of neuron */
+    void startResponse()
+    {
+      uint16_t now_stamp = stamp(bus_.now());
+      tx_queue_.clear();
+      for (int i = 0; i < config_.servo_send_num && i < 4; i++)
+        {
+          uint8_t data[8] = {};
+          memcpy(data, &now_stamp, 2); // angle
+          data[2] = 40; // temperature
+          tx_queue_.push_back(makeFrame(CAN::DEVICEID_SERVO, CAN::MESSAGEID_SEND_SERVO_LIST[i], 8, data));
+        }
+      if (config_.imu_send)
+        {
+          const uint8_t messages[3] = {CAN::MESSAGEID_SEND_GYRO, CAN::MESSAGEID_SEND_ACC, CAN::MESSAGEID_SEND_MAG};
+          for (uint8_t message_id : messages)
+            {
+              uint8_t data[6] = {};
+              memcpy(data, &now_stamp, 2);
+              tx_queue_.push_back(makeFrame(CAN::DEVICEID_IMU, message_id, 6, data));
+            }
+        }
+      tx_index_ = 0;
+      sendNext();
+    }
+
+    /* blocking HAL_CAN_Transmit(): wait for the completion or the timeout before the next frame */
+    void sendNext()
+    {
+      while (tx_index_ < tx_queue_.size())
+        {
+          const can_sim::Frame frame = tx_queue_.at(tx_index_++);
+          if (!bus_.transmit(node_, frame)) continue; // no empty mailbox, the frame is lost
+          uint64_t seq = ++wait_seq_;
+          bus_.schedule(bus_.now() + config_.send_timeout, [this, seq]() { if (seq == wait_seq_) { wait_seq_++; sendNext(); } });
+          return;
+        }
+
+      if (request_pending_)
+        {
+          request_pending_ = false;
+          bus_.schedule(bus_.now() + config_.response_delay, [this]() { startResponse(); });
+        }
+      else sending_ = false;
+    }
+
+    void txComplete()
+    {
+      if (!sending_) return;
+      wait_seq_++; // cancel the timeout
+      sendNext();
+    }
+  };
+
+  /* spine side stand-in of CANIMU, whose IMU base class depends on the spinal hal */
+  class HostCANIMU : public CANDevice
+  {
+  public:
+    HostCANIMU(uint8_t slave_id): CANDevice(CAN::DEVICEID_IMU, slave_id), stat_(nullptr)
+    {
+      memset(gyro_, 0, sizeof(gyro_));
+      memset(acc_, 0, sizeof(acc_));
+      memset(mag_, 0, sizeof(mag_));
+    }
+    void sendData() override {}
+    void receiveDataCallback(uint8_t /* slave_id */, uint8_t message_id, uint32_t /* DLC */, uint8_t* data) override
+    {
+      /* CANIMU::receiveDataCallback */
+      switch (message_id) {
+      case CAN::MESSAGEID_SEND_GYRO:
+        memcpy(gyro_, data, sizeof(uint8_t) * 6);
+        break;
+      case CAN::MESSAGEID_SEND_ACC:
+        memcpy(acc_, data, sizeof(uint8_t) * 6);
+        break;
+      case CAN::MESSAGEID_SEND_MAG:
+        memcpy(mag_, data, sizeof(uint8_t) * 6);
+        /* the last frame of one imu update */
+        if (stat_ != nullptr)
+          {
+            Time now = can_sim::getBus()->now();
+            stat_->addLatency(stampAge(now, static_cast<uint16_t>(mag_[0])));
+            interval_.update(now, *stat_);
+          }
+        break;
+      }
+    }
+    const int16_t* getGyro() const { return gyro_; }
+    void setStat(UpdateStat* stat, Time now) { stat_ = stat; interval_.reset(now); }
+    void finish(Time now) { if (stat_ != nullptr) interval_.finish(now, *stat_); }
+  private:
+    int16_t gyro_[3], acc_[3], mag_[3];
+    UpdateStat* stat_;
+    IntervalTracker interval_;
+  };
+
+  /* CANServo with the record of the servo states */
+  class RecordingCANServo : public CANServo
+  {
+  public:
+    RecordingCANServo(uint8_t slave_id, unsigned int servo_num): CANServo(slave_id, servo_num, false), stat_(nullptr) {}
+    void receiveDataCallback(uint8_t slave_id, uint8_t message_id, uint32_t DLC, uint8_t* data) override
+    {
+      CANServo::receiveDataCallback(slave_id, message_id, DLC, data);
+      if (stat_ != nullptr && message_id == 0)
+        {
+          Time now = can_sim::getBus()->now();
+          stat_->addLatency(stampAge(now, static_cast<uint16_t>(servo_.at(0).getPresentPosition())));
+          interval_.update(now, *stat_);
+        }
+    }
+    void setStat(UpdateStat* stat, Time now) { stat_ = stat; interval_.reset(now); }
+    void finish(Time now) { if (stat_ != nullptr) interval_.finish(now, *stat_); }
+  private:
+    UpdateStat* stat_;
+    IntervalTracker interval_;
+  };
+
+  struct SimConfig
+  {
+    int slave_num = 4;
+    NeuronConfig neuron;
+    can_sim::BusConfig bus;
+    can_sim::NodeConfig spine_node;
+    can_sim::NodeConfig neuron_node;
+    Time servo_command_period = 10 * MS; // servo/target_states from ros
+    int command_servo_num = 0; // servos of each neuron changed by one command, 0: all
+    bool round_robin = false; // Spine::send() before CANScheduler
+    CANScheduler::Config scheduler;
+    Time warmup = 100 * MS;
+    Time duration = 1000 * MS;
+  };
+
+  struct SimResult
+  {
+    int slave_num;
+    double utilization;
+    UpdateStat motor; // spine -> neuron, latency from the spine tick
+    UpdateStat servo_command; // spine -> neuron, latency from the change of the target
+    UpdateStat servo_state; // neuron -> spine, latency from the sampling on the neuron
+    UpdateStat imu; // neuron -> spine
+    uint64_t tx_request;
+    uint64_t lost; // no mailbox, destroyed without retransmission, or rx overrun
+    uint64_t tx_no_mailbox, tx_error_lost, rx_overrun;
+    uint64_t error_frames;
+    /* CANScheduler */
+    bool feasible;
+    float telemetry_rate;
+    uint16_t servo_latency_bound; // [ms]
+    uint32_t deadline_miss;
+
+    double lossRate() const { return tx_request > 0 ? static_cast<double>(lost) / tx_request : 0; }
+  };
+
+  /* the spine side network of Spine::init(), with the round robin schedule of Spine::send() */
+  class SpineBusSim
+  {
+  public:
+    explicit SpineBusSim(const SimConfig& config):
+      config_(config), bus_(config.bus), tick_(0), send_board_index_(0), servo_command_index_(0), stat_start_(0)
+    {
+      can_sim::setBus(&bus_);
+      CANDeviceManager::reset();
+      memset(&hcan_, 0, sizeof(hcan_));
+      memset(&gpio_, 0, sizeof(gpio_));
+      HAL_CAN_Attach(&hcan_, config.spine_node);
+      CANDeviceManager::init(&hcan_, &gpio_, 1);
+
+      int slave_num = config.slave_num;
+      for (int i = 0; i < slave_num; i++)
+        {
+          uint8_t slave_id = i + 1; // CAN::MASTER_ID = 0
+          motor_.emplace_back(new CANMotor(slave_id));
+          imu_.emplace_back(new HostCANIMU(slave_id));
+          servo_.emplace_back(new RecordingCANServo(slave_id, config.neuron.servo_num));
+          neuron_.emplace_back(new NeuronEmulator(bus_, slave_id, config.neuron, config.neuron_node));
+
+          CANDeviceManager::addDevice(*motor_.back());
+          motor_send_device_.addMotor(*motor_.back());
+          CANDeviceManager::addDevice(*imu_.back());
+          CANDeviceManager::addDevice(*servo_.back());
+          for (auto& s : servo_.back()->servo_) s.setGoalPosition(0);
+        }
+      CANDeviceManager::Receive_IT();
+
+      /* Spine::init() */
+      scheduler_.init(config.scheduler, &motor_send_device_);
+      for (auto& servo : servo_) scheduler_.addNeuron(*servo, config.neuron.servo_send_num, config.neuron.imu_send);
+      feasible_ = scheduler_.configure();
+
+      servo_command_pending_.resize(slave_num);
+      motor_interval_.resize(slave_num);
+      servo_interval_.resize(slave_num);
+      for (auto& neuron : neuron_)
+        {
+          neuron->motor_pwm_callback = [this](const NeuronEmulator& n, Time t) { motorReceived(n, t); };
+          neuron->servo_target_callback = [this](const NeuronEmulator& n, Time t) { servoTargetReceived(n, t); };
+        }
+    }
+
+    ~SpineBusSim()
+    {
+      CANDeviceManager::reset();
+      can_sim::setBus(nullptr);
+    }
+
+    SimResult run()
+    {
+      bus_.schedule(0, [this]() { tick(); });
+      if (config_.servo_command_period > 0) bus_.schedule(0, [this]() { servoCommand(); });
+
+      bus_.runUntil(config_.warmup);
+      startStat();
+      bus_.runUntil(config_.warmup + config_.duration);
+      return result();
+    }
+
+    can_sim::Bus& getBus() { return bus_; }
+    NeuronEmulator& getNeuron(int i) { return *neuron_.at(i); }
+    HostCANIMU& getImu(int i) { return *imu_.at(i); }
+    CANServo& getServo(int i) { return *servo_.at(i); }
+    CANMotor& getMotor(int i) { return *motor_.at(i); }
+    const CANScheduler& getScheduler() const { return scheduler_; }
+
+  private:
+    SimConfig config_;
+    can_sim::Bus bus_;
+    CAN_HandleTypeDef hcan_;
+    GPIO_TypeDef gpio_;
+    std::vector<std::unique_ptr<CANMotor> > motor_;
+    std::vector<std::unique_ptr<HostCANIMU> > imu_;
+    std::vector<std::unique_ptr<RecordingCANServo> > servo_;
+    std::vector<std::unique_ptr<NeuronEmulator> > neuron_;
+    CANMotorSendDevice motor_send_device_;
+    CANScheduler scheduler_;
+    bool feasible_;
+
+    uint32_t tick_; // HAL_GetTick() [ms]
+    int send_board_index_;
+    int servo_command_index_;
+    std::vector<std::deque<std::pair<int, Time> > > servo_command_pending_; // target and the time of the change
+    Time stat_start_;
+    std::vector<IntervalTracker> motor_interval_, servo_interval_;
+    UpdateStat motor_stat_, servo_command_stat_, servo_state_stat_, imu_stat_;
+
+    /* 1kHz timer of spinal */
+    void tick()
+    {
+      /* the pwm carries the tick for the latency evaluation */
+      for (auto& motor : motor_) motor->setPwm(tick_ % 1000);
+
+      /* Spine::send() */
+      if (!config_.round_robin) scheduler_.send(tick_);
+      else if (tick_ % 2 == 0)
+        {
+          motor_send_device_.sendData();
+          if (config_.slave_num != 0)
+            {
+              servo_.at(send_board_index_)->sendData();
+              send_board_index_++;
+              if (send_board_index_ == config_.slave_num) send_board_index_ = 0;
+            }
+        }
+      CANDeviceManager::tick(1);
+
+      tick_++;
+      bus_.schedule(static_cast<Time>(tick_) * MS, [this]() { tick(); });
+    }
+
+    /* new servo targets for all neurons */
+    void servoCommand()
+    {
+      servo_command_index_ = (servo_command_index_ + 1) % 0x4000; // int15
+      for (int i = 0; i < config_.slave_num; i++)
+        {
+          std::vector<Servo>& servo = servo_.at(i)->servo_;
+          int n = config_.command_servo_num > 0 ? std::min<int>(config_.command_servo_num, servo.size()) : servo.size();
+          for (int j = 0; j < n; j++) servo.at(j).setGoalPosition(servo_command_index_);
+          servo_command_pending_.at(i).push_back(std::make_pair(servo_command_index_, bus_.now()));
+        }
+      bus_.schedule(bus_.now() + config_.servo_command_period, [this]() { servoCommand(); });
+    }
+
+    void motorReceived(const NeuronEmulator& neuron, Time t)
+    {
+      int i = neuron.getSlaveId() - 1;
+      Time sent = (t / MS - ((t / MS) % 1000 + 1000 - neuron.getPwm()) % 1000) * MS;
+      motor_stat_.addLatency(t - sent);
+      motor_interval_.at(i).update(t, motor_stat_);
+    }
+
+    /* the latency of each target, until the arrival of the target or a newer one */
+    void servoTargetReceived(const NeuronEmulator& neuron, Time t)
+    {
+      int i = neuron.getSlaveId() - 1;
+      servo_interval_.at(i).update(t, servo_command_stat_);
+
+      std::deque<std::pair<int, Time> >& pending = servo_command_pending_.at(i);
+      auto it = std::find_if(pending.begin(), pending.end(),
+                             [&neuron](const std::pair<int, Time>& p) { return p.first == neuron.getGoalPosition(0); });
+      if (it == pending.end()) return;
+      for (auto p = pending.begin(); p != it + 1; p++)
+        {
+          if (p->second >= stat_start_) servo_command_stat_.addLatency(t - p->second);
+        }
+      pending.erase(pending.begin(), it + 1);
+    }
+
+    void startStat()
+    {
+      Time now = bus_.now();
+      stat_start_ = now;
+      bus_.resetStat();
+      motor_stat_ = UpdateStat();
+      servo_command_stat_ = UpdateStat();
+      servo_state_stat_ = UpdateStat();
+      imu_stat_ = UpdateStat();
+      for (int i = 0; i < config_.slave_num; i++)
+        {
+          motor_interval_.at(i).reset(now);
+          servo_interval_.at(i).reset(now);
+          imu_.at(i)->setStat(&imu_stat_, now);
+          servo_.at(i)->setStat(&servo_state_stat_, now);
+        }
+    }
+
+    SimResult result()
+    {
+      Time now = bus_.now();
+      for (int i = 0; i < config_.slave_num; i++)
+        {
+          motor_interval_.at(i).finish(now, motor_stat_);
+          servo_interval_.at(i).finish(now, servo_command_stat_);
+          imu_.at(i)->finish(now);
+          servo_.at(i)->finish(now);
+          /* the pending targets also count for the worst case */
+          for (const auto& p : servo_command_pending_.at(i))
+            servo_command_stat_.latency_max = std::max(servo_command_stat_.latency_max, now - p.second);
+        }
+
+      SimResult r;
+      r.slave_num = config_.slave_num;
+      r.utilization = bus_.getUtilization();
+      r.motor = motor_stat_;
+      r.servo_command = servo_command_stat_;
+      r.servo_state = servo_state_stat_;
+      r.imu = imu_stat_;
+      r.tx_request = r.tx_no_mailbox = r.tx_error_lost = r.rx_overrun = 0;
+      std::vector<int> nodes(1, hcan_.node);
+      for (auto& neuron : neuron_) nodes.push_back(neuron->getNode());
+      for (int node : nodes)
+        {
+          const can_sim::NodeStat& s = bus_.getNodeStat(node);
+          r.tx_request += s.tx_request;
+          r.tx_no_mailbox += s.tx_no_mailbox;
+          r.tx_error_lost += s.tx_error_lost;
+          r.rx_overrun += s.rx_overrun;
+        }
+      r.lost = r.tx_no_mailbox + r.tx_error_lost + r.rx_overrun;
+      r.error_frames = bus_.getErrorFrames();
+      r.feasible = feasible_;
+      r.telemetry_rate = scheduler_.getTelemetryRate();
+      r.servo_latency_bound = scheduler_.getServoLatencyBound();
+      r.deadline_miss = scheduler_.getDeadlineMissCount();
+      return r;
+    }
+  };
+}
+
+#endif
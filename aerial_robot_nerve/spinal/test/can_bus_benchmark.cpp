@@ -0,0 +1,104 @@
+/*
+******************************************************************************
+* File Name          : can_bus_benchmark.cpp
+* Description        : bus utilisation, update interval / latency and frame loss of the spine schedule,
+*                      CANScheduler and the round robin of one neuron per 2ms before it
+*                      usage: can_bus_benchmark [bitrate] [error_rate] [rx_service_time_us]
+******************************************************************************
+*/
+
+#include "can_bus/spine_bus_sim.h"
+#include <cstdlib>
+#include <stdio.h>
+#include <string>
+
+using namespace spine_bus_sim;
+
+namespace
+{
+  /* slave id is 4bit, 0 for spinal (CAN::MASTER_ID) and 15 for CAN::BROADCAST_ID */
+  const int MAX_SLAVE_NUM = 14;
+  /* CANMotorSendDevice packs 6 motors per frame into 2 frames */
+  const int MAX_MOTOR_NUM = 12;
+
+  void printTable(SimConfig config)
+  {
+    printf("%5s %6s | %11s %6s | %11s %7s | %11s %6s | %11s %6s | %7s %6s\n",
+           "slave", "load", "motor_itv", "lat", "servo_itv", "cmd_lat", "state_itv", "lat", "imu_itv", "lat", "loss", "errfr");
+
+    for (int slave_num = 1; slave_num <= 16; slave_num++)
+      {
+        if (slave_num > MAX_SLAVE_NUM)
+          {
+            printf("%5d  not addressable: slave id is %d bit\n", slave_num, CAN::SLAVE_ID_LEN);
+            continue;
+          }
+
+        config.slave_num = slave_num;
+        SimResult r = SpineBusSim(config).run();
+
+        printf("%5d %5.1f%% | %5.2f/%5.2f %6.3f | %5.2f/%5.2f %7.3f | %5.2f/%5.2f %6.3f | %5.2f/%5.2f %6.3f | %6.3f%% %6lu%s\n",
+               slave_num, r.utilization * 100,
+               r.motor.intervalMean(), r.motor.intervalMax(), r.motor.latencyMax(),
+               r.servo_command.intervalMean(), r.servo_command.intervalMax(), r.servo_command.latencyMax(),
+               r.servo_state.intervalMean(), r.servo_state.intervalMax(), r.servo_state.latencyMax(),
+               r.imu.intervalMean(), r.imu.intervalMax(), r.imu.latencyMax(),
+               r.lossRate() * 100, static_cast<unsigned long>(r.error_frames),
+               slave_num > MAX_MOTOR_NUM ? " (motor > 12 not sent)" : "");
+      }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  SimConfig config;
+  if (argc > 1) config.bus.bitrate = config.scheduler.bitrate = atoi(argv[1]);
+  if (argc > 2) config.bus.error_rate = atof(argv[2]);
+  if (argc > 3) config.spine_node.rx_service_time = atoi(argv[3]) * US;
+
+  printf("bitrate %u bps, error rate %.3f, spine rx service time %.1f us, %.1f s per row\n",
+         config.bus.bitrate, config.bus.error_rate, config.spine_node.rx_service_time / 1000.0, config.duration / 1e9);
+  printf("new targets of all servos every %.0f ms, update interval mean / max and latency max in [ms]\n",
+         config.servo_command_period / 1e6);
+
+  printf("\nCANScheduler: motor %d Hz, servo deadline %d ms, telemetry %s Hz per neuron, max utilization %.0f%%\n",
+         config.scheduler.motor.rate, config.scheduler.servo.deadline,
+         config.scheduler.telemetry_rate == CANScheduler::MAX_TELEMETRY_RATE ? "max" : std::to_string(config.scheduler.telemetry_rate).c_str(),
+         config.scheduler.max_utilization * 100);
+  printTable(config);
+
+  /* admission of CANScheduler for the numbers of neurons, also beyond the 4bit slave id */
+  printf("\n%5s %8s %10s %12s %12s %9s\n", "slave", "feasible", "telemetry", "cmd_lat_bound", "cmd_lat_sim", "deadline");
+  for (int slave_num : {4, 8, 14, 16})
+    {
+      std::vector<std::unique_ptr<CANServo> > servo;
+      CANMotorSendDevice motor_send_device;
+      std::vector<std::unique_ptr<CANMotor> > motor;
+      CANScheduler scheduler;
+      scheduler.init(config.scheduler, &motor_send_device);
+      for (int i = 0; i < slave_num; i++)
+        {
+          servo.emplace_back(new CANServo(i + 1, config.neuron.servo_num, false));
+          motor.emplace_back(new CANMotor(i + 1));
+          motor_send_device.addMotor(*motor.back());
+          scheduler.addNeuron(*servo.back(), config.neuron.servo_send_num, config.neuron.imu_send);
+        }
+      bool feasible = scheduler.configure();
+
+      char simulated[16] = "-";
+      if (slave_num <= MAX_SLAVE_NUM)
+        {
+          config.slave_num = slave_num;
+          snprintf(simulated, sizeof(simulated), "%.3f", SpineBusSim(config).run().servo_command.latencyMax());
+        }
+      printf("%5d %8s %7.1f Hz %9d ms %9s ms %6d ms%s\n", slave_num, feasible ? "yes" : "no",
+             scheduler.getTelemetryRate(), scheduler.getServoLatencyBound(), simulated, config.scheduler.servo.deadline,
+             slave_num > MAX_SLAVE_NUM ? "  (bound only: not addressable)" : "");
+    }
+
+  printf("\nround robin (Spine::send() before CANScheduler)\n");
+  config.round_robin = true;
+  printTable(config);
+
+  return 0;
+}
@@ -0,0 +1,421 @@
+/*
+******************************************************************************
+* File Name          : can_bus_test.cpp
+* Description        : host bus model and the spine / neuron network on top of it,
+*                      the tables of the schedule are given by can_bus_benchmark
+******************************************************************************
+*/
+
+#include "can_bus/spine_bus_sim.h"
+#include <gtest/gtest.h>
+
+using namespace spine_bus_sim;
+
+namespace
+{
+  can_sim::Frame makeFrame(uint32_t std_id, uint8_t dlc, uint8_t value = 0)
+  {
+    can_sim::Frame frame;
+    frame.std_id = std_id;
+    frame.dlc = dlc;
+    memset(frame.data, value, sizeof(frame.data));
+    return frame;
+  }
+
+  struct Received
+  {
+    uint32_t std_id;
+    Time t;
+  };
+}
+
+TEST(CANBusTest, FrameBits)
+{
+  /* 47 + 8 * dlc bits without stuffing, at most one stuff bit per 4 bits of the stuffed part */
+  for (int dlc = 0; dlc <= 8; dlc++)
+    {
+      for (uint8_t value : {0x00, 0x55, 0xFF})
+        {
+          int bits = can_sim::frameBits(makeFrame(0x123, dlc, value));
+          EXPECT_GE(bits, 47 + 8 * dlc);
+          EXPECT_LE(bits, 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4);
+        }
+    }
+
+  /* no stuffing for the alternating data, and the most for the constant data */
+  EXPECT_LT(can_sim::frameBits(makeFrame(0x555, 8, 0x55)), can_sim::frameBits(makeFrame(0x000, 8, 0x00)));
+}
+
+TEST(CANBusTest, Arbitration)
+{
+  can_sim::Bus bus;
+  std::vector<Received> received;
+  auto record = [&received](const can_sim::Frame& frame, Time t) { received.push_back({frame.std_id, t}); };
+  int a = bus.addNode(nullptr);
+  int b = bus.addNode(nullptr);
+  bus.addNode(record);
+  int blocker = bus.addNode(nullptr);
+
+  /* the frames queued during the transmission of the other frame compete by the identifier */
+  bus.schedule(0, [&]() { bus.transmit(blocker, makeFrame(0x700, 8)); });
+  bus.schedule(10 * US, [&]() {
+      bus.transmit(a, makeFrame(0x300, 8));
+      bus.transmit(a, makeFrame(0x200, 8));
+      bus.transmit(b, makeFrame(0x100, 8));
+    });
+  bus.runUntil(10 * MS);
+
+  ASSERT_EQ(received.size(), 4u);
+  EXPECT_EQ(received.at(0).std_id, 0x700u);
+  EXPECT_EQ(received.at(1).std_id, 0x100u);
+  EXPECT_EQ(received.at(2).std_id, 0x200u);
+  EXPECT_EQ(received.at(3).std_id, 0x300u);
+
+  /* back to back at 1Mbps */
+  EXPECT_EQ(received.at(0).t, can_sim::frameBits(makeFrame(0x700, 8)) * US);
+  EXPECT_EQ(received.at(1).t - received.at(0).t, can_sim::frameBits(makeFrame(0x100, 8)) * US);
+  EXPECT_NEAR(bus.getUtilization(), static_cast<double>(received.back().t) / (10 * MS), 1e-9);
+}
+
+TEST(CANBusTest, Mailbox)
+{
+  can_sim::Bus bus;
+  int node = bus.addNode(nullptr);
+  bus.addNode(nullptr);
+  for (int i = 0; i < 4; i++) bus.transmit(node, makeFrame(0x100 + i, 8));
+  EXPECT_EQ(bus.getNodeStat(node).tx_no_mailbox, 1u);
+  bus.runUntil(1 * MS);
+  EXPECT_EQ(bus.getNodeStat(node).tx_done, 3u);
+  EXPECT_EQ(bus.pendingTx(node), 0);
+}
+
+TEST(CANBusTest, RxOverrun)
+{
+  can_sim::Bus bus;
+  can_sim::NodeConfig slow;
+  slow.rx_service_time = 500 * US;
+  int rx_count = 0;
+  int tx = bus.addNode(nullptr);
+  int rx = bus.addNode([&rx_count](const can_sim::Frame&, Time) { rx_count++; }, slow);
+  for (int i = 0; i < 3; i++) bus.transmit(tx, makeFrame(0x100 + i, 0));
+  bus.schedule(300 * US, [&]() { for (int i = 0; i < 3; i++) bus.transmit(tx, makeFrame(0x200 + i, 0)); });
+  bus.runUntil(10 * MS);
+
+  /* the handler is busy for the first frame, and the fifo of 3 frames overflows */
+  EXPECT_EQ(bus.getNodeStat(rx).rx_overrun, 2u);
+  EXPECT_EQ(rx_count, 4);
+}
+
+TEST(CANBusTest, Filter)
+{
+  can_sim::Bus bus;
+  std::vector<Received> received;
+  int tx = bus.addNode(nullptr);
+  int rx = bus.addNode([&received](const can_sim::Frame& frame, Time t) { received.push_back({frame.std_id, t}); });
+  /* neuron with the slave id 3 */
+  bus.addFilter(rx, (CAN::BROADCAST_ID << 5) << 16, (0x0F << 5) << 16);
+  bus.addFilter(rx, (3 << 5) << 16, (0x0F << 5) << 16);
+
+  bus.transmit(tx, makeFrame((CAN::DEVICEID_SERVO << 8) | 3, 4));
+  bus.transmit(tx, makeFrame((CAN::DEVICEID_SERVO << 8) | 4, 4));
+  bus.transmit(tx, makeFrame((CAN::DEVICEID_MOTOR << 8) | CAN::BROADCAST_ID, 8));
+  bus.runUntil(1 * MS);
+
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received.at(0).std_id, static_cast<uint32_t>((CAN::DEVICEID_SERVO << 8) | 3)); // already started
+  EXPECT_EQ(received.at(1).std_id, static_cast<uint32_t>((CAN::DEVICEID_MOTOR << 8) | CAN::BROADCAST_ID));
+}
+
+TEST(CANBusTest, ErrorInjection)
+{
+  for (bool retransmission : {true, false})
+    {
+      can_sim::BusConfig config;
+      config.error_rate = 0.2;
+      config.auto_retransmission = retransmission;
+      can_sim::Bus bus(config);
+      int received = 0;
+      int tx = bus.addNode(nullptr);
+      bus.addNode([&received](const can_sim::Frame&, Time) { received++; });
+
+      for (int i = 0; i < 1000; i++)
+        bus.schedule(i * 200 * US, [&bus, tx]() { bus.transmit(tx, makeFrame(0x100, 8)); });
+      bus.runUntil(300 * MS);
+
+      EXPECT_GT(bus.getErrorFrames(), 100u);
+      EXPECT_LT(bus.getErrorFrames(), 300u);
+      if (retransmission)
+        {
+          EXPECT_EQ(received, 1000);
+        }
+      else
+        {
+          EXPECT_EQ(received + bus.getNodeStat(tx).tx_error_lost, 1000u);
+          EXPECT_EQ(bus.getNodeStat(tx).tx_error_lost, bus.getErrorFrames());
+        }
+    }
+}
+
+namespace
+{
+  /* targets in the multiplexed frames: slave id, servo index and the target angle */
+  std::vector<std::vector<int> > decodeServoMux(const std::vector<can_sim::Frame>& frames)
+  {
+    std::vector<std::vector<int> > targets;
+    for (const auto& frame : frames)
+      {
+        if (frame.std_id != static_cast<uint32_t>((CAN::DEVICEID_SERVO << 8) | (CAN::MESSAGEID_RECEIVE_SERVO_ANGLE_MUX << 4) | CAN::BROADCAST_ID)) continue;
+        int i = 0;
+        while (i < frame.dlc)
+          {
+            int slave_id = frame.data[i] >> 4;
+            int mask = frame.data[i] & 0x0F;
+            i++;
+            for (int j = 0; j < 4 && i + 2 <= frame.dlc; j++)
+              {
+                if (!(mask & (1 << j))) continue;
+                targets.push_back({slave_id, j, frame.data[i] | (frame.data[i + 1] << 8)});
+                i += 2;
+              }
+          }
+      }
+    return targets;
+  }
+}
+
+TEST(CANSchedulerTest, ChangedTargets)
+{
+  can_sim::Bus bus;
+  can_sim::setBus(&bus);
+  CANDeviceManager::reset();
+  CAN_HandleTypeDef hcan;
+  GPIO_TypeDef gpio;
+  memset(&hcan, 0, sizeof(hcan));
+  HAL_CAN_Attach(&hcan);
+  CANDeviceManager::init(&hcan, &gpio, 1);
+  std::vector<can_sim::Frame> received;
+  bus.addNode([&received](const can_sim::Frame& frame, Time) { received.push_back(frame); });
+
+  CANMotorSendDevice motor_send_device;
+  std::vector<std::unique_ptr<CANMotor> > motor;
+  std::vector<std::unique_ptr<CANServo> > servo;
+  CANScheduler::Config config;
+  config.telemetry_rate = 0;
+  CANScheduler scheduler;
+  scheduler.init(config, &motor_send_device);
+  for (int i = 0; i < 3; i++)
+    {
+      motor.emplace_back(new CANMotor(i + 1));
+      motor_send_device.addMotor(*motor.back());
+      servo.emplace_back(new CANServo(i + 1, 2, false));
+      for (auto& s : servo.back()->servo_) s.setGoalPosition(100 * i);
+      scheduler.addNeuron(*servo.back(), 1, true);
+    }
+  EXPECT_TRUE(scheduler.configure());
+
+  /* motor first, then all targets at the start */
+  scheduler.send(0);
+  bus.runUntil(1 * MS);
+  ASSERT_GE(received.size(), 2u);
+  EXPECT_EQ(received.at(0).std_id, static_cast<uint32_t>((CAN::DEVICEID_MOTOR << 8) | CAN::BROADCAST_ID));
+  std::vector<std::vector<int> > targets = decodeServoMux(received);
+  ASSERT_EQ(targets.size(), 6u);
+  for (const auto& target : targets) EXPECT_EQ(target.at(2), 0x8000 | (100 * (target.at(0) - 1))) << target.at(0);
+
+  /* nothing to send until the next motor period */
+  received.clear();
+  scheduler.send(1);
+  bus.runUntil(2 * MS);
+  EXPECT_TRUE(received.empty());
+
+  /* only the changed target */
+  servo.at(2)->servo_.at(1).setGoalPosition(-5);
+  scheduler.send(2);
+  bus.runUntil(3 * MS);
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received.at(1).dlc, 3);
+  targets = decodeServoMux(received);
+  ASSERT_EQ(targets.size(), 1u);
+  EXPECT_EQ(targets.at(0), std::vector<int>({3, 1, 0xFFFB})); // torque enable and int15
+  EXPECT_EQ(scheduler.getDeadlineMissCount(), 0u);
+
+  can_sim::setBus(nullptr);
+  CANDeviceManager::reset();
+}
+
+TEST(CANSchedulerTest, Admission)
+{
+  auto configure = [](int slave_num, uint32_t bitrate, CANScheduler& scheduler, uint16_t telemetry_rate = CANScheduler::MAX_TELEMETRY_RATE) {
+    static std::vector<std::unique_ptr<CANServo> > servo;
+    static std::vector<std::unique_ptr<CANMotor> > motor;
+    static CANMotorSendDevice motor_send_device;
+    motor_send_device = CANMotorSendDevice();
+    servo.clear();
+    motor.clear();
+    CANScheduler::Config config;
+    config.bitrate = bitrate;
+    config.telemetry_rate = telemetry_rate;
+    scheduler.init(config, &motor_send_device);
+    for (int i = 0; i < slave_num; i++)
+      {
+        motor.emplace_back(new CANMotor(i + 1));
+        motor_send_device.addMotor(*motor.back());
+        servo.emplace_back(new CANServo(i + 1, 2, false));
+        scheduler.addNeuron(*servo.back(), 1, true);
+      }
+    return scheduler.configure();
+  };
+
+  CANScheduler scheduler;
+  EXPECT_TRUE(configure(4, 1000000, scheduler, 100));
+  EXPECT_FLOAT_EQ(scheduler.getTelemetryRate(), 100);
+  EXPECT_LE(scheduler.getServoLatencyBound(), 2);
+
+  /* as high as feasible by default, faster than the round robin (500 / N Hz) */
+  EXPECT_TRUE(configure(4, 1000000, scheduler));
+  EXPECT_GT(scheduler.getTelemetryRate(), 500.0 / 4);
+  EXPECT_LE(scheduler.getServoLatencyBound(), 2);
+  EXPECT_LE(scheduler.getUtilization(), 0.8);
+
+  /* the telemetry gives way to the motor and the servo, but still faster than the round robin (500 / 14 Hz) */
+  EXPECT_TRUE(configure(14, 1000000, scheduler));
+  EXPECT_LT(scheduler.getTelemetryRate(), 100);
+  EXPECT_GT(scheduler.getTelemetryRate(), 500.0 / 14);
+  EXPECT_LE(scheduler.getServoLatencyBound(), 10);
+  EXPECT_LE(scheduler.getUtilization(), 0.8);
+
+  EXPECT_FALSE(configure(14, 125000, scheduler));
+}
+
+TEST(SpineBusSimTest, Scheduler)
+{
+  for (int slave_num : {4, 8, 14})
+    {
+      SimConfig config;
+      config.slave_num = slave_num;
+      SimResult result = SpineBusSim(config).run();
+      EXPECT_TRUE(result.feasible);
+
+      /* the worst servo latency is predicted by the admission, and far below the round robin (2ms per neuron) */
+      EXPECT_LT(result.servo_command.latencyMax(), result.servo_latency_bound + 0.5) << slave_num;
+      EXPECT_LT(result.servo_command.latencyMax(), 0.5 * slave_num) << slave_num;
+      EXPECT_EQ(result.deadline_miss, 0u);
+
+      if (slave_num <= 12)
+        {
+          EXPECT_LT(result.motor.intervalMax(), 2.2); // 2 frames of 6 motors
+        }
+      EXPECT_NEAR(result.imu.intervalMean(), 1000.0 / result.telemetry_rate, 0.1 * 1000.0 / result.telemetry_rate) << slave_num;
+      EXPECT_LT(result.utilization, 0.8);
+      EXPECT_EQ(result.lost, 0u);
+    }
+}
+
+TEST(SpineBusSimTest, SchedulerChangedOnly)
+{
+  SimConfig config;
+  config.slave_num = 8;
+  config.duration = 500 * MS;
+  SimResult all = SpineBusSim(config).run();
+
+  /* only one servo of each neuron moves */
+  config.command_servo_num = 1;
+  SimResult one = SpineBusSim(config).run();
+  EXPECT_LT(one.utilization, all.utilization);
+  EXPECT_LE(one.servo_command.latencyMax(), all.servo_command.latencyMax());
+
+  /* no target: motor and telemetry only */
+  config.servo_command_period = 0;
+  SimResult none = SpineBusSim(config).run();
+  EXPECT_LT(none.utilization, one.utilization);
+  EXPECT_EQ(none.servo_command.count, 0u);
+}
+
+TEST(SpineBusSimTest, RoundRobin)
+{
+  SimConfig config;
+  config.slave_num = 4;
+  config.round_robin = true;
+  SpineBusSim sim(config);
+  SimResult result = sim.run();
+
+  /* Spine::send() before CANScheduler: motor every 2ms, and the servo targets of one neuron per call */
+  EXPECT_NEAR(result.motor.intervalMean(), 2.0, 0.01);
+  EXPECT_LT(result.motor.intervalMax(), 2.05);
+  EXPECT_LT(result.motor.latencyMax(), 0.5);
+  EXPECT_NEAR(result.servo_command.intervalMax(), 2.0 * config.slave_num, 0.05);
+  EXPECT_NEAR(result.servo_state.intervalMax(), 2.0 * config.slave_num, 0.05);
+  EXPECT_NEAR(result.imu.intervalMax(), 2.0 * config.slave_num, 0.05);
+  EXPECT_LT(result.servo_command.latencyMax(), 2.0 * config.slave_num + 0.5);
+  EXPECT_GT(result.servo_command.count, 95u * config.slave_num);
+
+  /* motor, servo targets and the response of one neuron (servo state and imu) in every 2ms */
+  EXPECT_GT(result.utilization, 0.25);
+  EXPECT_LT(result.utilization, 0.4);
+  EXPECT_EQ(result.lost, 0u);
+
+  /* the payload reaches the devices: about 110 targets in 1.1s */
+  for (int i = 0; i < config.slave_num; i++)
+    {
+      EXPECT_NEAR(sim.getNeuron(i).getGoalPosition(0), 110, 1);
+      EXPECT_TRUE(sim.getNeuron(i).getTorqueEnable(0));
+      EXPECT_EQ(sim.getServo(i).servo_.at(0).getPresentTemperature(), 40);
+    }
+}
+
+TEST(SpineBusSimTest, RoundRobinScaleSlaveNum)
+{
+  /* the servo refresh degrades linearly with the number of neurons, while the bus load is almost constant */
+  for (int slave_num : {1, 4, 8, 12})
+    {
+      SimConfig config;
+      config.slave_num = slave_num;
+      config.round_robin = true;
+      config.duration = 500 * MS;
+      SimResult result = SpineBusSim(config).run();
+      EXPECT_NEAR(result.servo_command.intervalMax(), 2.0 * slave_num, 0.1) << slave_num;
+      EXPECT_NEAR(result.imu.intervalMax(), 2.0 * slave_num, 0.1) << slave_num;
+      EXPECT_GT(result.servo_command.latencyMax(), 2.0 * (slave_num - 1)) << slave_num;
+      EXPECT_GT(result.utilization, 0.25) << slave_num;
+      EXPECT_LT(result.utilization, 0.4) << slave_num;
+      EXPECT_EQ(result.lost, 0u);
+    }
+}
+
+TEST(SpineBusSimTest, CommunicationId)
+{
+  /* the imu of the 9th neuron and the servo of the 1st neuron used to share the communication id */
+  SimConfig config;
+  config.slave_num = 10;
+  config.duration = 200 * MS;
+  config.round_robin = true;
+  SpineBusSim sim(config);
+  SimResult result = sim.run();
+
+  EXPECT_NE(sim.getImu(8).getGyro()[0], 0);
+  EXPECT_GT(result.imu.interval_count, 0u);
+  EXPECT_NEAR(result.imu.intervalMax(), 2.0 * config.slave_num, 0.1);
+  EXPECT_EQ(sim.getServo(0).servo_.at(0).getPresentTemperature(), 40);
+}
+
+TEST(SpineBusSimTest, ErrorInjection)
+{
+  SimConfig config;
+  config.slave_num = 8;
+  config.duration = 500 * MS;
+  config.bus.error_rate = 0.05;
+  SimResult with_error = SpineBusSim(config).run();
+  EXPECT_GT(with_error.error_frames, 0u);
+  EXPECT_EQ(with_error.lost, 0u); // retransmitted
+
+  config.bus.auto_retransmission = false;
+  SimResult without_retransmission = SpineBusSim(config).run();
+  EXPECT_GT(without_retransmission.tx_error_lost, 0u);
+  EXPECT_NEAR(without_retransmission.lossRate(), 0.05, 0.02);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,176 @@
+/*
+******************************************************************************
+* File Name          : imu_batch_test.cpp
+* Description        : spinal::ImuBatch: round trip of the 1 kHz samples through the quantization and the serialization,
+*                      and the serial bandwidth against spinal::Imu at the same sample rate
+******************************************************************************
+*/
+
+#include "sensors/imu/imu_batch.h"
+#include <gtest/gtest.h>
+#include <ros/serialization.h>
+#include <spinal/Imu.h>
+#include <spinal/ImuBatch.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+  const float SAMPLE_FREQ = 1000.0f; // [Hz], update of the attitude estimate
+  const uint32_t ROSSERIAL_OVERHEAD = 8; // sync, protocol, length, length checksum, topic id, checksum [bytes]
+  const int IMU_PUB_INTERVAL = 5; // [ms], of AttitudeEstimate
+
+  struct Sample
+  {
+    float gyro[3]; // [rad/s]
+    float acc[3]; // [m/s^2]
+  };
+
+  /* flight with the vibration of the rotors */
+  std::vector<Sample> generate(int number, unsigned int seed)
+  {
+    std::mt19937 engine(seed);
+    std::normal_distribution<float> vibration(0, 1);
+    std::vector<Sample> samples;
+    for(int k = 0; k < number; k++)
+      {
+        float t = k / SAMPLE_FREQ;
+        Sample sample;
+        for(int i = 0; i < 3; i++)
+          {
+            sample.gyro[i] = 1.5f * sinf(2 * M_PI * (0.5f + i) * t) + 0.05f * vibration(engine);
+            sample.acc[i] = (i == 2 ? 9.8f : 0.0f) + 2.0f * cosf(2 * M_PI * (0.3f + i) * t) + 0.5f * vibration(engine);
+          }
+        samples.push_back(sample);
+      }
+    return samples;
+  }
+
+  /* as AttitudeEstimate::addImuBatchSample */
+  spinal::ImuBatch pack(const std::vector<Sample>& samples, size_t start, size_t number, const ros::Time& stamp)
+  {
+    std::vector<float> gyro, acc;
+    for(size_t k = start; k < start + number; k++)
+      {
+        gyro.insert(gyro.end(), samples[k].gyro, samples[k].gyro + 3);
+        acc.insert(acc.end(), samples[k].acc, samples[k].acc + 3);
+      }
+
+    spinal::ImuBatch msg;
+    msg.stamp = stamp;
+    msg.tick_delta.assign(number, 1);
+    msg.tick_delta[0] = 0;
+    msg.gyro_data.resize(3 * number);
+    msg.acc_data.resize(3 * number);
+    msg.gyro_scale = imu_batch::quantize(gyro.data(), gyro.size(), msg.gyro_data.data(), imu_batch::GYRO_MIN_SCALE);
+    msg.acc_scale = imu_batch::quantize(acc.data(), acc.size(), msg.acc_data.data(), imu_batch::ACC_MIN_SCALE);
+    return msg;
+  }
+
+  template<class M> M serializeRoundTrip(const M& msg)
+  {
+    uint32_t length = ros::serialization::serializationLength(msg);
+    std::vector<uint8_t> buffer(length);
+    ros::serialization::OStream out(buffer.data(), length);
+    ros::serialization::serialize(out, msg);
+
+    M result;
+    ros::serialization::IStream in(buffer.data(), length);
+    ros::serialization::deserialize(in, result);
+    return result;
+  }
+
+  /* bytes per second on the serial link for the sample rate */
+  template<class M> double bandwidth(const M& msg, double msg_rate)
+  {
+    return (ros::serialization::serializationLength(msg) + ROSSERIAL_OVERHEAD) * msg_rate;
+  }
+}
+
+TEST(ImuBatchTest, QuantizationRoundTrip)
+{
+  const int BATCH_SIZE = 10;
+  std::vector<Sample> samples = generate(5000, 1);
+
+  double max_gyro_error = 0, max_acc_error = 0;
+  for(size_t start = 0; start + BATCH_SIZE <= samples.size(); start += BATCH_SIZE)
+    {
+      ros::Time stamp(100.0 + start / SAMPLE_FREQ);
+      spinal::ImuBatch msg = serializeRoundTrip(pack(samples, start, BATCH_SIZE, stamp));
+      ASSERT_EQ(msg.tick_delta.size(), (size_t)BATCH_SIZE);
+      ASSERT_EQ(msg.gyro_data.size(), (size_t)(3 * BATCH_SIZE));
+
+      /* as Imu::ImuBatchCallback of aerial_robot_estimation */
+      uint32_t tick = 0;
+      for(int k = 0; k < BATCH_SIZE; k++)
+        {
+          tick += msg.tick_delta[k];
+          EXPECT_NEAR((msg.stamp + ros::Duration(tick * 1e-3)).toSec(), 100.0 + (start + k) / SAMPLE_FREQ, 1e-6);
+
+          float gyro[3], acc[3];
+          imu_batch::dequantize(&msg.gyro_data[3 * k], 3, msg.gyro_scale, gyro);
+          imu_batch::dequantize(&msg.acc_data[3 * k], 3, msg.acc_scale, acc);
+          for(int i = 0; i < 3; i++)
+            {
+              double gyro_error = fabs(gyro[i] - samples[start + k].gyro[i]);
+              double acc_error = fabs(acc[i] - samples[start + k].acc[i]);
+              EXPECT_LE(gyro_error, msg.gyro_scale * 0.501);
+              EXPECT_LE(acc_error, msg.acc_scale * 0.501);
+              if(gyro_error > max_gyro_error) max_gyro_error = gyro_error;
+              if(acc_error > max_acc_error) max_acc_error = acc_error;
+            }
+        }
+    }
+
+  /* far below the noise of the sensors */
+  EXPECT_LT(max_gyro_error, 1e-4);
+  EXPECT_LT(max_acc_error, 1e-3);
+  RecordProperty("max_gyro_error_urad", static_cast<int>(max_gyro_error * 1e6));
+  RecordProperty("max_acc_error_um", static_cast<int>(max_acc_error * 1e6));
+}
+
+TEST(ImuBatchTest, Scale)
+{
+  /* the largest magnitude is the full range */
+  float values[4] = {-3.0f, 1.0f, 0.5f, 2.0f};
+  int16_t quantized[4];
+  float scale = imu_batch::quantize(values, 4, quantized, imu_batch::GYRO_MIN_SCALE);
+  EXPECT_FLOAT_EQ(scale, 3.0f / imu_batch::QUANTIZE_MAX);
+  EXPECT_EQ(quantized[0], -imu_batch::QUANTIZE_MAX);
+
+  /* hovering still: the resolution floor */
+  float zeros[3] = {0, 0, 0};
+  scale = imu_batch::quantize(zeros, 3, quantized, imu_batch::GYRO_MIN_SCALE);
+  EXPECT_FLOAT_EQ(scale, imu_batch::GYRO_MIN_SCALE);
+  EXPECT_EQ(quantized[0], 0);
+}
+
+TEST(ImuBatchTest, Bandwidth)
+{
+  std::vector<Sample> samples = generate(100, 2);
+  spinal::Imu imu_msg;
+
+  /* current message: every sample (1 kHz) and every IMU_PUB_INTERVAL */
+  double imu_all = bandwidth(imu_msg, SAMPLE_FREQ);
+  double imu_current = bandwidth(imu_msg, SAMPLE_FREQ / IMU_PUB_INTERVAL);
+  RecordProperty("imu_1000hz_bytes_per_sec", static_cast<int>(imu_all));
+  RecordProperty("imu_200hz_bytes_per_sec", static_cast<int>(imu_current));
+
+  double previous = imu_all;
+  for(int batch_size : {1, 2, 5, 10, 20, 50})
+    {
+      double batch = bandwidth(pack(samples, 0, batch_size, ros::Time(1.0)), SAMPLE_FREQ / batch_size);
+      RecordProperty("batch_" + std::to_string(batch_size) + "_bytes_per_sec", static_cast<int>(batch));
+      if(batch_size > 1) EXPECT_LT(batch, previous);
+      previous = batch;
+
+      /* every sample in a third of the bandwidth, and close to the current message with a fifth of the samples */
+      if(batch_size == 10)
+        {
+          EXPECT_LT(batch, imu_all / 3);
+          EXPECT_LT(batch, imu_current * 1.6);
+        }
+    }
+}
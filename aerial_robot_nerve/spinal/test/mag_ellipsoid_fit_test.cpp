@@ -0,0 +1,207 @@
+/*
+******************************************************************************
+* File Name          : mag_ellipsoid_fit_test.cpp
+* Description        : magnetometer calibration of the spinal imu on the synthetic samples:
+*                      earth field rotated through random attitudes, distorted by hard and soft iron
+******************************************************************************
+*/
+
+#include "sensors/imu/mag_ellipsoid_fit.h"
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+  const float OUTLIER_THRESH = 20.0f; // MAG_GENERAL_THRESH of IMU [uT]
+
+  struct Distortion
+  {
+    ap::Vector3f hard_iron = ap::Vector3f(30.0f, -12.0f, 45.0f); // [uT]
+    /* symmetric soft iron with the cross-axis coupling */
+    ap::Matrix3f soft_iron = ap::Matrix3f(ap::Vector3f(1.10f, 0.08f, -0.05f),
+                                          ap::Vector3f(0.08f, 0.92f, 0.06f),
+                                          ap::Vector3f(-0.05f, 0.06f, 1.02f));
+    float noise = 0.3f; // [uT]
+  };
+
+  struct MagSample
+  {
+    ap::Vector3f raw;
+    ap::Vector3f distorted; // raw without the noise
+    ap::Vector3f body_field; // ground truth without distortion
+  };
+
+  /* earth field (north and down) in the body frame, rotated by hand through the attitudes of random rates at 100 Hz */
+  std::vector<MagSample> generate(const Distortion& distortion, int number, unsigned int seed, bool planar = false)
+  {
+    const ap::Vector3f earth_field(25.0f, 0.0f, -40.0f);
+    const float dt = 0.01f;
+    std::mt19937 engine(seed);
+    std::normal_distribution<float> gaussian(0, 1);
+    std::uniform_real_distribution<float> phase(-M_PI, M_PI);
+    std::uniform_real_distribution<float> rate(0.3f, 0.8f); // [rad/s]
+
+    float roll_phase = phase(engine), pitch_phase = phase(engine), yaw_phase = phase(engine);
+    float roll_rate = rate(engine), pitch_rate = rate(engine), yaw_rate = rate(engine);
+
+    std::vector<MagSample> samples;
+    for(int k = 0; k < number; k++)
+      {
+        float t = k * dt;
+        ap::Matrix3f r;
+        if(planar) r.from_euler(0, 0, yaw_rate * t + yaw_phase); // only yaw rotation: the ellipsoid is not observable
+        else r.from_euler(roll_rate * t + roll_phase, 1.4f * sinf(pitch_rate * t + pitch_phase), yaw_rate * t + yaw_phase);
+
+        MagSample sample;
+        sample.body_field = r.mul_transpose(earth_field);
+        sample.distorted = distortion.soft_iron * sample.body_field + distortion.hard_iron;
+        sample.raw = sample.distorted + ap::Vector3f(gaussian(engine), gaussian(engine), gaussian(engine)) * distortion.noise;
+        samples.push_back(sample);
+      }
+    return samples;
+  }
+
+  /* the largest angle between the corrected mag and the undistorted field [deg], without the noise */
+  float maxAngleError(const std::vector<MagSample>& samples, const ap::Vector3f& offset, const ap::Matrix3f& soft_iron)
+  {
+    float max_error = 0;
+    for(const MagSample& sample : samples)
+      {
+        ap::Vector3f corrected = soft_iron * (sample.distorted - offset);
+        float cos_angle = corrected * sample.body_field / (corrected.length() * sample.body_field.length());
+        float error = acosf(cos_angle > 1 ? 1 : cos_angle) * 180 / M_PI;
+        if(error > max_error) max_error = error;
+      }
+    return max_error;
+  }
+
+  /* spread of the corrected magnitude: std / mean, without the noise */
+  float radiusSpread(const std::vector<MagSample>& samples, const ap::Vector3f& offset, const ap::Matrix3f& soft_iron)
+  {
+    double sum = 0, square_sum = 0;
+    for(const MagSample& sample : samples)
+      {
+        double radius = (soft_iron * (sample.distorted - offset)).length();
+        sum += radius;
+        square_sum += radius * radius;
+      }
+    double mean = sum / samples.size();
+    return sqrt(square_sum / samples.size() - mean * mean) / mean;
+  }
+
+  struct Calibration
+  {
+    bool ellipsoid_valid, min_max_valid;
+    ap::Vector3f ellipsoid_offset, min_max_offset;
+    ap::Matrix3f ellipsoid_soft_iron, min_max_soft_iron;
+  };
+
+  Calibration calibrate(MagEllipsoidFit& fit, const std::vector<MagSample>& samples)
+  {
+    fit.reset(OUTLIER_THRESH);
+    for(const MagSample& sample : samples) fit.addSample(sample.raw);
+
+    Calibration calibration;
+    calibration.ellipsoid_soft_iron.identity();
+    calibration.min_max_soft_iron.identity();
+    calibration.ellipsoid_valid = fit.solve(calibration.ellipsoid_offset, calibration.ellipsoid_soft_iron);
+    calibration.min_max_valid = fit.solveMinMax(calibration.min_max_offset, calibration.min_max_soft_iron);
+    return calibration;
+  }
+}
+
+TEST(MagEllipsoidFitTest, SoftIronCoupling)
+{
+  Distortion distortion;
+  std::vector<MagSample> samples = generate(distortion, 6000, 1);
+  MagEllipsoidFit fit;
+  Calibration calibration = calibrate(fit, samples);
+  ASSERT_TRUE(calibration.ellipsoid_valid);
+  ASSERT_TRUE(calibration.min_max_valid);
+
+  for(int i = 0; i < 3; i++) EXPECT_NEAR(calibration.ellipsoid_offset[i], distortion.hard_iron[i], 0.5f);
+  EXPECT_LT(radiusSpread(samples, calibration.ellipsoid_offset, calibration.ellipsoid_soft_iron), 0.01f);
+
+  /* the symmetric soft iron is inverted up to the scale, the min / max method can not see the coupling */
+  float ellipsoid_error = maxAngleError(samples, calibration.ellipsoid_offset, calibration.ellipsoid_soft_iron);
+  float min_max_error = maxAngleError(samples, calibration.min_max_offset, calibration.min_max_soft_iron);
+  EXPECT_LT(ellipsoid_error, 0.5f);
+  EXPECT_GT(min_max_error, 4 * ellipsoid_error);
+  RecordProperty("ellipsoid_max_angle_error_mdeg", static_cast<int>(ellipsoid_error * 1000));
+  RecordProperty("min_max_max_angle_error_mdeg", static_cast<int>(min_max_error * 1000));
+}
+
+TEST(MagEllipsoidFitTest, LargeHardIron)
+{
+  /* the origin of the raw mag on the ellipsoid: the fit is centered at solve() */
+  Distortion distortion;
+  distortion.hard_iron = ap::Vector3f(47.0f, 0.0f, 0.0f);
+  std::vector<MagSample> samples = generate(distortion, 6000, 2);
+  MagEllipsoidFit fit;
+  Calibration calibration = calibrate(fit, samples);
+  ASSERT_TRUE(calibration.ellipsoid_valid);
+  for(int i = 0; i < 3; i++) EXPECT_NEAR(calibration.ellipsoid_offset[i], distortion.hard_iron[i], 0.5f);
+  EXPECT_LT(maxAngleError(samples, calibration.ellipsoid_offset, calibration.ellipsoid_soft_iron), 0.5f);
+}
+
+TEST(MagEllipsoidFitTest, Outlier)
+{
+  Distortion distortion;
+  std::vector<MagSample> samples = generate(distortion, 6000, 3);
+  std::vector<MagSample> corrupted = samples;
+  for(int k = 100; k < (int)corrupted.size(); k += 500) corrupted[k].raw[k % 3] += 300.0f; // single spikes
+
+  MagEllipsoidFit fit;
+  Calibration calibration = calibrate(fit, corrupted);
+  ASSERT_TRUE(calibration.ellipsoid_valid);
+  EXPECT_GE(fit.getOutlierNumber(), 10u);
+  EXPECT_GT(fit.getSampleNumber(), 5900u);
+
+  /* the spikes are rejected before both of the min / max and the fit */
+  EXPECT_LT(maxAngleError(samples, calibration.ellipsoid_offset, calibration.ellipsoid_soft_iron), 0.5f);
+  for(int i = 0; i < 3; i++) EXPECT_NEAR(calibration.min_max_offset[i], distortion.hard_iron[i], 5.0f);
+
+  /* without the rejection, a single spike spoils the min / max */
+  MagEllipsoidFit no_rejection;
+  no_rejection.reset(0);
+  for(const MagSample& sample : corrupted) no_rejection.addSample(sample.raw);
+  ap::Vector3f offset;
+  ap::Matrix3f soft_iron;
+  ASSERT_TRUE(no_rejection.solveMinMax(offset, soft_iron));
+  EXPECT_GT((offset - distortion.hard_iron).length(), 50.0f);
+}
+
+TEST(MagEllipsoidFitTest, HeldSample)
+{
+  /* the raw mag is held between the mag updates of the 1 kHz process */
+  Distortion distortion;
+  std::vector<MagSample> samples = generate(distortion, 200, 4);
+  MagEllipsoidFit fit;
+  fit.reset(OUTLIER_THRESH);
+  EXPECT_FALSE(fit.addSample(ap::Vector3f(0, 0, 0)));
+  for(const MagSample& sample : samples)
+    for(int k = 0; k < 10; k++) fit.addSample(sample.raw);
+  EXPECT_EQ(fit.getSampleNumber(), 200u);
+}
+
+TEST(MagEllipsoidFitTest, NotEnoughRotation)
+{
+  Distortion distortion;
+  ap::Vector3f offset(1, 2, 3);
+  ap::Matrix3f soft_iron;
+  soft_iron.identity();
+
+  /* only the yaw rotation: no ellipsoid, the result is not changed */
+  MagEllipsoidFit fit;
+  Calibration calibration = calibrate(fit, generate(distortion, 6000, 5, true));
+  EXPECT_FALSE(calibration.ellipsoid_valid);
+  EXPECT_FALSE(fit.solve(offset, soft_iron));
+  EXPECT_EQ(offset.x, 1);
+  EXPECT_EQ(soft_iron.a.x, 1);
+
+  /* too few samples */
+  calibration = calibrate(fit, generate(distortion, MagEllipsoidFit::MIN_SAMPLE_NUMBER / 2, 6));
+  EXPECT_FALSE(calibration.ellipsoid_valid);
+}
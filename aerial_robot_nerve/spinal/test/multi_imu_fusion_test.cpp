@@ -0,0 +1,373 @@
+/*
+******************************************************************************
+* File Name          : multi_imu_fusion_test.cpp
+* Description        : fusion of the spinal and neuron imus on the synthetic articulated body:
+*                      hydrus-like chain of links with the yaw joints, rotating and accelerating body,
+*                      different vibration per link and the faulty imus
+******************************************************************************
+*/
+
+#include "state_estimate/attitude/multi_imu_fusion.h"
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+  const float SAMPLE_FREQ = 1000.0f; // [Hz], imu update
+  const int POSE_INTERVAL = 20; // [ms], link poses from the joint angles in ros
+  const int LINK_NUMBER = 4;
+  const int BASE_LINK = 1; // spinal
+  const double LINK_LENGTH = 0.6; // [m]
+  const int IMU_NUMBER = LINK_NUMBER + 1; // spinal + a neuron on each link
+
+  struct Vector
+  {
+    double x, y, z;
+    Vector(double x_ = 0, double y_ = 0, double z_ = 0): x(x_), y(y_), z(z_) {}
+    Vector operator+(const Vector& v) const { return Vector(x + v.x, y + v.y, z + v.z); }
+    Vector operator-(const Vector& v) const { return Vector(x - v.x, y - v.y, z - v.z); }
+    Vector operator*(double s) const { return Vector(x * s, y * s, z * s); }
+    Vector cross(const Vector& v) const { return Vector(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
+    ap::Vector3f toAp() const { return ap::Vector3f(x, y, z); }
+  };
+
+  /* pose of an imu in the body frame (board frame of the spinal) */
+  struct Pose
+  {
+    double yaw; // of the link
+    double board_roll; // mounting of the board on the link
+    Vector pos;
+  };
+
+  ap::Matrix3f rotation(const Pose& pose)
+  {
+    ap::Matrix3f rot;
+    rot.from_euler(pose.board_roll, 0, pose.yaw);
+    return rot;
+  }
+
+  Vector rotateTranspose(const Pose& pose, const Vector& v)
+  {
+    ap::Vector3f rotated = rotation(pose).mul_transpose(v.toAp());
+    return Vector(rotated.x, rotated.y, rotated.z);
+  }
+
+  struct ImuFault
+  {
+    int imu = -1;
+    double start = 0, end = 0; // [s]
+    Vector gyro_bias, acc_bias;
+  };
+
+  struct BodyConfig
+  {
+    double spin_rate = 3.0; // [rad/s], yaw rate of the body
+    double joint_amplitude = 0.3; // [rad]
+    double joint_freq = 0.1; // [Hz]
+    double gyro_noise[IMU_NUMBER] = {0.02, 0.01, 0.03, 0.05, 0.1}; // [rad/s], vibration differs by the link
+    double acc_noise[IMU_NUMBER] = {0.3, 0.2, 0.4, 0.6, 1.0}; // [m/s^2]
+    ImuFault fault;
+    unsigned int seed = 1;
+  };
+
+  /* hydrus-like chain: the links along x with the yaw joints, the spinal at the center of the base link */
+  class ArticulatedBody
+  {
+  public:
+    ArticulatedBody(const BodyConfig& config): config_(config), engine_(config.seed), tick_(0) {}
+
+    Pose pose(int imu, double t) const
+    {
+      Pose result;
+      result.board_roll = 0;
+      if(imu == 0)
+        {
+          result.yaw = 0;
+          return result;
+        }
+
+      int link = imu - 1;
+      double joint[LINK_NUMBER - 1];
+      for(int j = 0; j < LINK_NUMBER - 1; j++)
+        joint[j] = (j - 1) * 0.5 + config_.joint_amplitude * sin(2 * M_PI * config_.joint_freq * t + j);
+
+      /* walk from the base link */
+      double yaw = 0;
+      Vector end = Vector(LINK_LENGTH / 2, 0, 0) * (link >= BASE_LINK ? 1 : -1);
+      Vector center;
+      if(link > BASE_LINK)
+        for(int k = BASE_LINK + 1; k <= link; k++)
+          {
+            yaw += joint[k - 1];
+            Vector dir(cos(yaw), sin(yaw), 0);
+            center = end + dir * (LINK_LENGTH / 2);
+            end = end + dir * LINK_LENGTH;
+          }
+      else if(link < BASE_LINK)
+        for(int k = BASE_LINK - 1; k >= link; k--)
+          {
+            yaw -= joint[k];
+            Vector dir(cos(yaw), sin(yaw), 0);
+            center = end - dir * (LINK_LENGTH / 2);
+            end = end - dir * LINK_LENGTH;
+          }
+
+      result.yaw = yaw;
+      result.pos = center + Vector(0.03, 0.02, 0.04); // neuron board on the link
+      if(link % 2) result.board_roll = M_PI; // mounted upside down
+      return result;
+    }
+
+    /* body motion */
+    Vector angular(double t) const
+    {
+      return Vector(0.8 * sin(2 * M_PI * 0.7 * t), 0.6 * sin(2 * M_PI * 0.5 * t + 1), config_.spin_rate + 1.0 * sin(2 * M_PI * 0.3 * t));
+    }
+    Vector specificForce(double t) const // at the origin of the body frame
+    {
+      return Vector(1.5 * sin(2 * M_PI * 0.4 * t), 1.0 * cos(2 * M_PI * 0.6 * t), 9.8 + 0.5 * sin(2 * M_PI * t));
+    }
+
+    double time() const { return tick_ / SAMPLE_FREQ; }
+
+    /* gyro and acc in the board frame of each imu */
+    void next(ap::Vector3f* gyro, ap::Vector3f* acc)
+    {
+      const double h = 1e-4;
+      double t = time();
+      Vector w = angular(t);
+      Vector dw = (angular(t + h) - angular(t - h)) * (1 / (2 * h));
+      Vector f = specificForce(t);
+
+      for(int i = 0; i < IMU_NUMBER; i++)
+        {
+          Pose p = pose(i, t);
+          Pose prev = pose(i, t - h), post = pose(i, t + h);
+          Vector link_angular(0, 0, (post.yaw - prev.yaw) / (2 * h));
+          Vector vel = (post.pos - prev.pos) * (1 / (2 * h));
+          Vector linear_acc = (post.pos - p.pos * 2 + prev.pos) * (1 / (h * h));
+
+          Vector body_gyro = w + link_angular;
+          Vector body_acc = f + dw.cross(p.pos) + w.cross(w.cross(p.pos)) + w.cross(vel) * 2 + linear_acc;
+
+          std::normal_distribution<double> gyro_noise(0, config_.gyro_noise[i]), acc_noise(0, config_.acc_noise[i]);
+          Vector gyro_value = rotateTranspose(p, body_gyro) + Vector(gyro_noise(engine_), gyro_noise(engine_), gyro_noise(engine_));
+          Vector acc_value = rotateTranspose(p, body_acc) + Vector(acc_noise(engine_), acc_noise(engine_), acc_noise(engine_));
+          if(i == config_.fault.imu && t >= config_.fault.start && t < config_.fault.end)
+            {
+              gyro_value = gyro_value + config_.fault.gyro_bias;
+              acc_value = acc_value + config_.fault.acc_bias;
+            }
+          gyro[i] = gyro_value.toAp();
+          acc[i] = acc_value.toAp();
+        }
+      tick_++;
+    }
+
+  private:
+    BodyConfig config_;
+    std::mt19937 engine_;
+    long tick_;
+  };
+
+  struct Error
+  {
+    double gyro_rms, acc_rms; // after the settle
+    double spinal_gyro_rms, spinal_acc_rms; // spinal imu only
+    double naive_acc_rms; // mean of the rotated acc without the lever arm
+  };
+
+  /* run the fusion for duration [s], callback(fusion, time) after each update */
+  template<typename Callback> Error run(MultiImuFusion& fusion, ArticulatedBody& body, double duration, double settle, Callback callback)
+  {
+    Error error = {0, 0, 0, 0, 0};
+    int count = 0;
+    ap::Vector3f gyro[IMU_NUMBER], acc[IMU_NUMBER];
+    fusion.setImuNumber(IMU_NUMBER);
+
+    while(body.time() < duration)
+      {
+        double t = body.time();
+        uint32_t stamp = std::lround(t * 1000);
+        if(stamp % POSE_INTERVAL == 0)
+          for(int i = 1; i < IMU_NUMBER; i++)
+            {
+              Pose pose = body.pose(i, t);
+              fusion.setPose(i, rotation(pose), pose.pos.toAp(), stamp);
+            }
+
+        body.next(gyro, acc);
+        fusion.update(gyro, acc, 1 / SAMPLE_FREQ, stamp);
+        callback(fusion, t);
+
+        if(t < settle) continue;
+        Vector w = body.angular(t), f = body.specificForce(t);
+        ap::Vector3f naive_acc;
+        for(int i = 0; i < IMU_NUMBER; i++) naive_acc += rotation(body.pose(i, t)) * acc[i] / IMU_NUMBER;
+
+        error.gyro_rms += (fusion.getGyro() - w.toAp()).length_squared();
+        error.acc_rms += (fusion.getAcc() - f.toAp()).length_squared();
+        error.spinal_gyro_rms += (gyro[0] - w.toAp()).length_squared();
+        error.spinal_acc_rms += (acc[0] - f.toAp()).length_squared();
+        error.naive_acc_rms += (naive_acc - f.toAp()).length_squared();
+        count++;
+      }
+
+    error.gyro_rms = sqrt(error.gyro_rms / count);
+    error.acc_rms = sqrt(error.acc_rms / count);
+    error.spinal_gyro_rms = sqrt(error.spinal_gyro_rms / count);
+    error.spinal_acc_rms = sqrt(error.spinal_acc_rms / count);
+    error.naive_acc_rms = sqrt(error.naive_acc_rms / count);
+    return error;
+  }
+
+  void noCallback(const MultiImuFusion&, double) {}
+}
+
+TEST(MultiImuFusionTest, LeverArm)
+{
+  BodyConfig config;
+  ArticulatedBody body(config);
+  MultiImuFusion fusion;
+  Error error = run(fusion, body, 20.0, 2.0, noCallback);
+
+  /* the fused imus are better than the spinal imu */
+  EXPECT_LT(error.gyro_rms, 0.8 * error.spinal_gyro_rms);
+  EXPECT_LT(error.acc_rms, 0.8 * error.spinal_acc_rms);
+  /* the centripetal acc of the spinning links is compensated */
+  EXPECT_GT(error.naive_acc_rms, 5 * error.acc_rms);
+  EXPECT_EQ(fusion.getFusedNumber(), IMU_NUMBER);
+
+  RecordProperty("gyro_rms_mrad", static_cast<int>(error.gyro_rms * 1000));
+  RecordProperty("spinal_gyro_rms_mrad", static_cast<int>(error.spinal_gyro_rms * 1000));
+  RecordProperty("acc_rms_mm", static_cast<int>(error.acc_rms * 1000));
+  RecordProperty("spinal_acc_rms_mm", static_cast<int>(error.spinal_acc_rms * 1000));
+  RecordProperty("naive_acc_rms_mm", static_cast<int>(error.naive_acc_rms * 1000));
+}
+
+TEST(MultiImuFusionTest, NoiseWeight)
+{
+  BodyConfig config;
+  ArticulatedBody body(config);
+  MultiImuFusion fusion;
+  run(fusion, body, 10.0, 0, noCallback);
+
+  /* the noise estimate follows the vibration of each link, the noisy link is weighted down */
+  for(int i = 0; i < IMU_NUMBER; i++)
+    {
+      EXPECT_TRUE(fusion.getHealthy(i));
+      EXPECT_NEAR(fusion.getGyroNoise(i), config.gyro_noise[i], 0.5 * config.gyro_noise[i] + 0.01) << i;
+      EXPECT_NEAR(fusion.getAccNoise(i), config.acc_noise[i], 0.5 * config.acc_noise[i] + 0.1) << i;
+    }
+  EXPECT_LT(fusion.getGyroWeight(4), 0.05f);
+  EXPECT_LT(fusion.getAccWeight(4), 0.05f);
+  EXPECT_GT(fusion.getGyroWeight(1), fusion.getGyroWeight(0));
+}
+
+TEST(MultiImuFusionTest, FaultyImu)
+{
+  BodyConfig config;
+  config.fault.imu = 3;
+  config.fault.start = 5.0;
+  config.fault.end = 10.0;
+  config.fault.gyro_bias = Vector(0.0, 0.4, 0.0); // e.g. a broken sensor
+  ArticulatedBody body(config);
+  MultiImuFusion fusion;
+
+  double rejected_time = -1, recovered_time = -1, max_gyro_error = 0;
+  Error error = run(fusion, body, 15.0, 2.0, [&](const MultiImuFusion& f, double t)
+                    {
+                      if(!f.getHealthy(3) && rejected_time < 0) rejected_time = t;
+                      if(f.getHealthy(3) && rejected_time > 0 && recovered_time < 0) recovered_time = t;
+                      if(t > 2.0)
+                        {
+                          double e = (f.getGyro() - body.angular(t).toAp()).length();
+                          if(e > max_gyro_error) max_gyro_error = e;
+                        }
+                    });
+
+  EXPECT_GE(rejected_time, config.fault.start);
+  EXPECT_LT(rejected_time, config.fault.start + 0.05);
+  EXPECT_GT(recovered_time, config.fault.end);
+  EXPECT_LT(recovered_time, config.fault.end + 1.0);
+  /* the fault does not reach the fused gyro */
+  EXPECT_LT(max_gyro_error, 0.1);
+  EXPECT_LT(error.gyro_rms, 0.8 * error.spinal_gyro_rms);
+}
+
+TEST(MultiImuFusionTest, SpinalOnly)
+{
+  /* without the link poses from ros, the spinal imu as it is */
+  BodyConfig config;
+  ArticulatedBody body(config);
+  MultiImuFusion fusion;
+  fusion.setImuNumber(IMU_NUMBER);
+  ap::Vector3f gyro[IMU_NUMBER], acc[IMU_NUMBER];
+  for(int k = 0; k < 1000; k++)
+    {
+      body.next(gyro, acc);
+      fusion.update(gyro, acc, 1 / SAMPLE_FREQ, k);
+      ASSERT_EQ(fusion.getGyro(), gyro[0]);
+      ASSERT_EQ(fusion.getAcc(), acc[0]);
+    }
+  EXPECT_EQ(fusion.getFusedNumber(), 1);
+
+  /* the static weight 0 removes the imu from the fusion */
+  Pose pose = body.pose(2, 0);
+  fusion.setPose(2, rotation(pose), pose.pos.toAp(), 1000);
+  fusion.setWeight(2, 0);
+  body.next(gyro, acc);
+  fusion.update(gyro, acc, 1 / SAMPLE_FREQ, 1000);
+  EXPECT_EQ(fusion.getFusedNumber(), 1);
+  fusion.setWeight(2, 1);
+  fusion.update(gyro, acc, 1 / SAMPLE_FREQ, 1001);
+  EXPECT_EQ(fusion.getFusedNumber(), 2);
+}
+
+TEST(MultiImuFusionTest, PoseTimeout)
+{
+  /* the link poses from ros stop for a while (e.g. the joint states are lost), and come again */
+  const uint32_t stop = 3000, resume = 6000, end = 9000; // [ms]
+  BodyConfig config;
+  ArticulatedBody body(config);
+  MultiImuFusion fusion;
+  fusion.setImuNumber(IMU_NUMBER);
+  ap::Vector3f gyro[IMU_NUMBER], acc[IMU_NUMBER];
+
+  uint32_t expired_stamp = 0, fused_stamp = 0;
+  for(uint32_t stamp = 0; stamp < end; stamp++)
+    {
+      double t = body.time();
+      if(stamp % POSE_INTERVAL == 0 && (stamp < stop || stamp >= resume))
+        for(int i = 1; i < IMU_NUMBER; i++)
+          {
+            Pose pose = body.pose(i, t);
+            fusion.setPose(i, rotation(pose), pose.pos.toAp(), stamp);
+          }
+
+      body.next(gyro, acc);
+      fusion.update(gyro, acc, 1 / SAMPLE_FREQ, stamp);
+
+      if(stamp > stop && stamp < resume)
+        {
+          if(!fusion.getPoseValid(1) && expired_stamp == 0) expired_stamp = stamp;
+          if(expired_stamp > 0)
+            {
+              /* the stale poses give the wrong lever arm and link motion, spinal only */
+              ASSERT_EQ(fusion.getFusedNumber(), 1) << stamp;
+              ASSERT_EQ(fusion.getGyro(), gyro[0]) << stamp;
+              ASSERT_EQ(fusion.getAcc(), acc[0]) << stamp;
+            }
+        }
+      if(stamp >= resume && fusion.getFusedNumber() == IMU_NUMBER && fused_stamp == 0) fused_stamp = stamp;
+    }
+
+  /* the last pose is at stop - POSE_INTERVAL */
+  EXPECT_EQ(expired_stamp, stop - POSE_INTERVAL + 200 + 1);
+  for(int i = 1; i < IMU_NUMBER; i++) EXPECT_TRUE(fusion.getPoseValid(i)) << i;
+  EXPECT_EQ(fused_stamp, resume);
+  EXPECT_EQ(fusion.getFusedNumber(), IMU_NUMBER);
+}
@@ -0,0 +1,214 @@
+/*
+******************************************************************************
+* File Name          : gyro_vibration.h
+* Description        : synthetic gyro of a multirotor for the dynamic notch filters:
+*                      slow body motion, blade pass harmonics of the rotors and a frame resonance,
+*                      the phase delay and tone amplitude estimation and the cost per sample
+******************************************************************************
+*/
+
+#ifndef __GYRO_VIBRATION_H
+#define __GYRO_VIBRATION_H
+
+#include "sensors/imu/notch_filter.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GYRO_VIBRATION_RDTSC 1
+#endif
+
+namespace gyro_vibration
+{
+  struct VibrationConfig
+  {
+    float sample_freq = 1000.0f; // [Hz], imu update by systick
+    int motor_number = 4;
+    int blade_number = 2;
+    int harmonics = 2; // in the signal
+    float rps_per_pwm = 400.0f;
+    float pwm_offset = 0.5f; // IDLE_DUTY
+    float hover_pwm = 0.68f; // 72 rps, 144 Hz blade pass
+    float pwm_spread = 0.02f; // per motor, for the attitude control
+    float pwm_swing = 0.02f; // slow common change, e.g. climb
+    float pwm_swing_freq = 0.5f; // [Hz]
+    float vibration_amplitude = 0.3f; // [rad/s] of the first harmonic, 1 / h for the h-th
+    float motion_amplitude = 0.5f; // [rad/s]
+    float motion_freq = 2.0f; // [Hz]
+    float resonance_freq = 0; // [Hz], frame resonance independent of the rotors, 0: none
+    float resonance_amplitude = 0.2f; // [rad/s]
+    float noise = 0.0f; // [rad/s]
+    unsigned int seed = 1;
+  };
+
+  struct Sample
+  {
+    float pwm[NotchFilterBank::MAX_ROTOR_NUMBER];
+    ap::Vector3f motion;
+    ap::Vector3f vibration; // blade pass harmonics, resonance and noise
+  };
+
+  class VibrationSignal
+  {
+  public:
+    VibrationSignal(const VibrationConfig& config): config_(config), engine_(config.seed), tick_(0)
+    {
+      std::uniform_real_distribution<float> unit(-1, 1);
+      for(int i = 0; i < config_.motor_number; i++)
+        {
+          pwm_offset_[i] = config_.pwm_spread * unit(engine_);
+          phase_[i] = M_PI * unit(engine_);
+          /* the direction of the vibration on the board differs by the rotor position */
+          direction_[i] = ap::Vector3f(unit(engine_), unit(engine_), 0.3f * unit(engine_));
+          direction_[i].normalize();
+        }
+      resonance_phase_ = 0;
+    }
+
+    Sample next()
+    {
+      Sample sample;
+      float dt = 1.0f / config_.sample_freq;
+      double t = tick_ * dt;
+      float swing = config_.pwm_swing * sin(2 * M_PI * config_.pwm_swing_freq * t);
+
+      sample.vibration.zero();
+      for(int i = 0; i < config_.motor_number; i++)
+        {
+          sample.pwm[i] = config_.hover_pwm + pwm_offset_[i] + swing;
+          float blade_pass_freq = config_.blade_number * config_.rps_per_pwm * (sample.pwm[i] - config_.pwm_offset);
+          phase_[i] = fmod(phase_[i] + 2 * M_PI * blade_pass_freq * dt, 2 * M_PI);
+
+          float vibration = 0;
+          for(int h = 1; h <= config_.harmonics; h++)
+            vibration += config_.vibration_amplitude / h * sin(h * phase_[i]);
+          sample.vibration += direction_[i] * vibration;
+        }
+
+      if(config_.resonance_freq > 0)
+        {
+          resonance_phase_ = fmod(resonance_phase_ + 2 * M_PI * config_.resonance_freq * dt, 2 * M_PI);
+          sample.vibration += ap::Vector3f(1.0f, 0.7f, 0.4f) * (config_.resonance_amplitude * sin(resonance_phase_));
+        }
+
+      if(config_.noise > 0)
+        {
+          std::normal_distribution<float> noise(0, config_.noise);
+          sample.vibration += ap::Vector3f(noise(engine_), noise(engine_), noise(engine_));
+        }
+
+      float motion = config_.motion_amplitude * sin(2 * M_PI * config_.motion_freq * t);
+      sample.motion = ap::Vector3f(motion, 0.8f * motion, 0.3f * motion);
+
+      tick_++;
+      return sample;
+    }
+
+    NotchFilterBank::Config bankConfig() const
+    {
+      NotchFilterBank::Config config;
+      config.enable = true;
+      config.blade_number = config_.blade_number;
+      config.rps_per_pwm = config_.rps_per_pwm;
+      config.pwm_offset = config_.pwm_offset;
+      return config;
+    }
+
+  private:
+    VibrationConfig config_;
+    std::mt19937 engine_;
+    long tick_;
+    float pwm_offset_[NotchFilterBank::MAX_ROTOR_NUMBER];
+    double phase_[NotchFilterBank::MAX_ROTOR_NUMBER];
+    ap::Vector3f direction_[NotchFilterBank::MAX_ROTOR_NUMBER];
+    double resonance_phase_;
+  };
+
+  /* amplitude and phase of the tone of freq in the signal, over the whole periods of it */
+  struct Tone
+  {
+    double amplitude;
+    double phase; // [rad]
+  };
+
+  inline Tone tone(const std::vector<float>& signal, int start, float freq, float sample_freq)
+  {
+    int period_samples = std::lround(sample_freq / freq);
+    int length = (static_cast<int>(signal.size()) - start) / period_samples * period_samples;
+    double in_phase = 0, quadrature = 0;
+    for(int k = start; k < start + length; k++)
+      {
+        double omega_t = 2 * M_PI * freq * k / sample_freq;
+        in_phase += signal[k] * sin(omega_t);
+        quadrature += signal[k] * cos(omega_t);
+      }
+    Tone result;
+    result.amplitude = 2 * sqrt(in_phase * in_phase + quadrature * quadrature) / length;
+    result.phase = atan2(quadrature, in_phase);
+    return result;
+  }
+
+  inline double rms(const std::vector<float>& signal, int start)
+  {
+    double sum = 0;
+    for(size_t k = start; k < signal.size(); k++) sum += signal[k] * signal[k];
+    return sqrt(sum / (signal.size() - start));
+  }
+
+  inline uint64_t cycles()
+  {
+#ifdef GYRO_VIBRATION_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  struct Cost
+  {
+    double ns_per_sample;
+    double cycles_per_sample;
+    double max_cycles_per_sample; // the worst sample, e.g. with the fft of the peak tracker
+  };
+
+  /* cost of NotchFilterBank::setRotorPwm() and apply() per gyro sample, the samples are prepared beforehand,
+     the best of the repeats against the noise of the host */
+  inline Cost measure(const NotchFilterBank::Config& config, const std::vector<Sample>& samples, int motor_number, int repeat = 5)
+  {
+    Cost best;
+    volatile float sink = 0; // keep the results alive
+    for(int r = 0; r < repeat; r++)
+      {
+        NotchFilterBank bank;
+        bank.setConfig(config);
+
+        uint64_t max_cycles = 0;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t start_cycles = cycles();
+        for(const Sample& sample : samples)
+          {
+            uint64_t sample_start = cycles();
+            bank.setRotorPwm(sample.pwm, motor_number);
+            sink = bank.apply(sample.motion + sample.vibration).x;
+            uint64_t sample_cycles = cycles() - sample_start;
+            if(sample_cycles > max_cycles) max_cycles = sample_cycles;
+          }
+        uint64_t end_cycles = cycles();
+        auto end = std::chrono::steady_clock::now();
+
+        Cost cost;
+        cost.ns_per_sample = std::chrono::duration<double, std::nano>(end - start).count() / samples.size();
+        cost.cycles_per_sample = static_cast<double>(end_cycles - start_cycles) / samples.size();
+        cost.max_cycles_per_sample = max_cycles;
+        if(r == 0 || cost.ns_per_sample < best.ns_per_sample) best = cost;
+      }
+    (void)sink;
+    return best;
+  }
+}
+
+#endif
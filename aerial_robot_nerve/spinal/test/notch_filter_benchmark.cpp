@@ -0,0 +1,105 @@
+/*
+******************************************************************************
+* File Name          : notch_filter_benchmark.cpp
+* Description        : cost per gyro sample of the dynamic notch filters, with the attenuation
+*                      of the blade pass harmonics and the delay added to the body motion by q
+*                      usage: notch_filter_benchmark [samples]
+******************************************************************************
+*/
+
+#include "notch_filter/gyro_vibration.h"
+#include <cstdlib>
+#include <stdio.h>
+
+using namespace gyro_vibration;
+
+namespace
+{
+  const int SETTLE = 2000;
+
+  void printRow(int motor_number, int harmonics, float q, bool peak_tracking, int samples_number)
+  {
+    VibrationConfig config;
+    config.motor_number = motor_number;
+    config.harmonics = harmonics;
+    config.hover_pwm = 0.62f; // 96 Hz blade pass, up to the third harmonic in the range
+    config.resonance_freq = peak_tracking ? 173.0f : 0;
+    VibrationSignal signal(config);
+
+    NotchFilterBank::Config bank_config = signal.bankConfig();
+    bank_config.harmonics = harmonics;
+    bank_config.q = q;
+    bank_config.peak_tracking = peak_tracking;
+
+    /* the vibration and the motion separately, the bank is linear in the signal for the given pwm */
+    std::vector<Sample> samples;
+    std::vector<float> vibration, filtered_vibration, motion, filtered_motion;
+    NotchFilterBank vibration_bank, motion_bank;
+    vibration_bank.setConfig(bank_config);
+    motion_bank.setConfig(bank_config);
+    for(int k = 0; k < samples_number; k++)
+      {
+        Sample sample = signal.next();
+        samples.push_back(sample);
+        vibration_bank.setRotorPwm(sample.pwm, motor_number);
+        motion_bank.setRotorPwm(sample.pwm, motor_number);
+        vibration.push_back(sample.vibration.length());
+        filtered_vibration.push_back(vibration_bank.apply(sample.vibration).length());
+        motion.push_back(sample.motion.x);
+        filtered_motion.push_back(motion_bank.apply(sample.motion).x);
+      }
+
+    double attenuation = 20 * log10(rms(vibration, SETTLE) / rms(filtered_vibration, SETTLE));
+    Tone input = tone(motion, SETTLE, config.motion_freq, config.sample_freq);
+    Tone output = tone(filtered_motion, SETTLE, config.motion_freq, config.sample_freq);
+    double delay = (input.phase - output.phase) / (2 * M_PI * config.motion_freq);
+
+    Cost cost = measure(bank_config, samples, motor_number);
+    printf("%6d %9d %5.1f %5s | %8.1f %8.1f %8.0f | %8.1f %8.2f\n",
+           motor_number, harmonics, q, peak_tracking ? "on" : "off",
+           cost.ns_per_sample, cost.cycles_per_sample, cost.max_cycles_per_sample, attenuation, delay * 1000);
+  }
+
+  /* delay of the first order lpf of IMU::process (GYRO_LPF_FACTOR) for the reference */
+  void printLpfDelay(int samples_number)
+  {
+    const float GYRO_LPF_FACTOR = 12;
+    VibrationConfig config;
+    std::vector<float> motion, filtered_motion;
+    float p = 0;
+    for(int k = 0; k < samples_number; k++)
+      {
+        float value = config.motion_amplitude * sin(2 * M_PI * config.motion_freq * k / config.sample_freq);
+        p -= p / GYRO_LPF_FACTOR;
+        p += value;
+        motion.push_back(value);
+        filtered_motion.push_back(p / GYRO_LPF_FACTOR);
+      }
+    Tone input = tone(motion, SETTLE, config.motion_freq, config.sample_freq);
+    Tone output = tone(filtered_motion, SETTLE, config.motion_freq, config.sample_freq);
+    printf("reference: gyro lpf of IMU (factor %.0f), delay %.2f ms at %.0f Hz\n", GYRO_LPF_FACTOR,
+           (input.phase - output.phase) / (2 * M_PI * config.motion_freq) * 1000, config.motion_freq);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int samples_number = 20000;
+  if (argc > 1) samples_number = atoi(argv[1]);
+
+  printf("%d samples per row (best of 5), ns and cycles per gyro sample (mean / max), attenuation of the harmonics and delay at 2 Hz\n", samples_number);
+  printf("%6s %9s %5s %5s | %8s %8s %8s | %8s %8s\n", "motor", "harmonic", "q", "peak", "ns", "cycles", "max", "att[dB]", "delay[ms]");
+
+  for(int motor_number : {4, 6, 8})
+    for(int harmonics : {1, 2, 3})
+      printRow(motor_number, harmonics, 8.0f, false, samples_number);
+
+  for(float q : {3.0f, 5.0f, 12.0f})
+    printRow(4, 2, q, false, samples_number);
+
+  for(int motor_number : {4, 8})
+    printRow(motor_number, 2, 8.0f, true, samples_number);
+
+  printLpfDelay(samples_number);
+  return 0;
+}
@@ -0,0 +1,221 @@
+/*
+******************************************************************************
+* File Name          : notch_filter_test.cpp
+* Description        : dynamic notch filters of the spinal gyro on the synthetic blade pass harmonics:
+*                      attenuation, added group delay and cycles per sample
+******************************************************************************
+*/
+
+#include "notch_filter/gyro_vibration.h"
+#include <gtest/gtest.h>
+
+using namespace gyro_vibration;
+
+namespace
+{
+  const int SAMPLES = 10000; // 10 s
+  const int SETTLE = 2000;
+
+  struct Result
+  {
+    std::vector<float> vibration, filtered_vibration; // norm of the three axes
+    std::vector<float> motion, filtered_motion; // x axis
+    double attenuation; // [dB]
+    double delay; // [s] at motion_freq
+    double motion_gain;
+  };
+
+  /* the bank is linear in the signal for the given pwm, so the vibration and the motion are filtered separately */
+  Result run(const VibrationConfig& config, const NotchFilterBank::Config& bank_config)
+  {
+    VibrationSignal signal(config);
+    NotchFilterBank vibration_bank, motion_bank;
+    vibration_bank.setConfig(bank_config);
+    motion_bank.setConfig(bank_config);
+
+    Result result;
+    for(int k = 0; k < SAMPLES; k++)
+      {
+        Sample sample = signal.next();
+        vibration_bank.setRotorPwm(sample.pwm, config.motor_number);
+        motion_bank.setRotorPwm(sample.pwm, config.motor_number);
+
+        result.vibration.push_back(sample.vibration.length());
+        result.filtered_vibration.push_back(vibration_bank.apply(sample.vibration).length());
+        result.motion.push_back(sample.motion.x);
+        result.filtered_motion.push_back(motion_bank.apply(sample.motion).x);
+      }
+
+    result.attenuation = 20 * log10(rms(result.vibration, SETTLE) / rms(result.filtered_vibration, SETTLE));
+    Tone input = tone(result.motion, SETTLE, config.motion_freq, config.sample_freq);
+    Tone output = tone(result.filtered_motion, SETTLE, config.motion_freq, config.sample_freq);
+    result.delay = (input.phase - output.phase) / (2 * M_PI * config.motion_freq);
+    result.motion_gain = output.amplitude / input.amplitude;
+    return result;
+  }
+}
+
+TEST(NotchFilterTest, BladePassHarmonics)
+{
+  VibrationConfig config;
+  for(int motor_number : {4, 6, 8})
+    {
+      config.motor_number = motor_number;
+      config.seed = motor_number;
+      VibrationSignal signal(config);
+      Result result = run(config, signal.bankConfig());
+
+      EXPECT_GT(result.attenuation, 25.0) << motor_number << " motors";
+      /* the body motion passes as it is, within a small fraction of the 11 ms of the gyro lpf */
+      EXPECT_NEAR(result.motion_gain, 1.0, 0.01) << motor_number << " motors";
+      EXPECT_GT(result.delay, 0);
+      EXPECT_LT(result.delay, 0.002) << motor_number << " motors";
+    }
+}
+
+TEST(NotchFilterTest, ThirdHarmonic)
+{
+  VibrationConfig config;
+  config.harmonics = 3;
+  config.hover_pwm = 0.62f; // 96 Hz blade pass, the third harmonic below max_freq
+  VibrationSignal signal(config);
+  NotchFilterBank::Config bank_config = signal.bankConfig();
+
+  /* two notches per rotor leave the third harmonic */
+  Result two_notches = run(config, bank_config);
+  bank_config.harmonics = 3;
+  Result three_notches = run(config, bank_config);
+  EXPECT_LT(two_notches.attenuation, 15.0);
+  EXPECT_GT(three_notches.attenuation, 20.0);
+  EXPECT_LT(three_notches.delay, 0.002);
+
+  /* more than MAX_HARMONICS is clamped, the config is taken by the next apply() */
+  NotchFilterBank bank;
+  bank_config.harmonics = 10;
+  bank.setConfig(bank_config);
+  EXPECT_EQ(bank.getConfig().harmonics, NotchFilterBank::Config().harmonics);
+  bank.apply(ap::Vector3f());
+  EXPECT_EQ(bank.getConfig().harmonics, 3);
+}
+
+TEST(NotchFilterTest, DisabledPassThrough)
+{
+  VibrationConfig config;
+  VibrationSignal signal(config);
+  NotchFilterBank bank; // disabled by default, until the config from ros
+  for(int k = 0; k < 1000; k++)
+    {
+      Sample sample = signal.next();
+      ap::Vector3f gyro = sample.motion + sample.vibration;
+      bank.setRotorPwm(sample.pwm, config.motor_number);
+      ap::Vector3f filtered = bank.apply(gyro);
+      ASSERT_EQ(filtered.x, gyro.x);
+      ASSERT_EQ(filtered.y, gyro.y);
+      ASSERT_EQ(filtered.z, gyro.z);
+    }
+  EXPECT_EQ(bank.getActiveNotchNumber(), 0);
+}
+
+TEST(NotchFilterTest, MotorStop)
+{
+  VibrationConfig config;
+  VibrationSignal signal(config);
+  NotchFilterBank bank;
+  bank.setConfig(signal.bankConfig());
+
+  /* IDLE_DUTY before the arming: no notch, the gyro passes as it is */
+  float idle_pwm[4] = {0.5f, 0.5f, 0.5f, 0.5f};
+  bank.setRotorPwm(idle_pwm, 4);
+  ap::Vector3f gyro(0.1f, -0.2f, 0.3f);
+  ap::Vector3f filtered = bank.apply(gyro);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 0);
+  EXPECT_EQ(filtered.x, gyro.x);
+  EXPECT_EQ(filtered.z, gyro.z);
+
+  /* armed: two harmonics per rotor, the second harmonic of 72 rps is 288 Hz < max_freq */
+  Sample sample = signal.next();
+  bank.setRotorPwm(sample.pwm, 4);
+  bank.apply(gyro);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 8);
+  EXPECT_NEAR(bank.getRotorFreq(0), 144.0f, 20.0f);
+
+  /* one rotor less, e.g. the motor number from uav_info */
+  bank.setRotorPwm(sample.pwm, 3);
+  bank.apply(gyro);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 6);
+
+  /* back to idle */
+  bank.setRotorPwm(idle_pwm, 4);
+  bank.apply(gyro);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 0);
+}
+
+TEST(NotchFilterTest, PeakTracker)
+{
+  /* a frame resonance which does not follow the rotor speed */
+  VibrationConfig config;
+  config.resonance_freq = 173.0f;
+  config.noise = 0.01f;
+  VibrationSignal signal(config);
+  NotchFilterBank::Config bank_config = signal.bankConfig();
+  bank_config.peak_tracking = true;
+  NotchFilterBank bank;
+  bank.setConfig(bank_config);
+
+  std::vector<float> raw, filtered;
+  for(int k = 0; k < SAMPLES; k++)
+    {
+      Sample sample = signal.next();
+      ap::Vector3f gyro = sample.motion + sample.vibration;
+      bank.setRotorPwm(sample.pwm, config.motor_number);
+      raw.push_back(gyro.x);
+      filtered.push_back(bank.apply(gyro).x);
+    }
+
+  EXPECT_NEAR(bank.getPeakFreq(), config.resonance_freq, 2.0f);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 9);
+  double attenuation = 20 * log10(tone(raw, SETTLE, config.resonance_freq, config.sample_freq).amplitude /
+                                  tone(filtered, SETTLE, config.resonance_freq, config.sample_freq).amplitude);
+  EXPECT_GT(attenuation, 20.0);
+}
+
+TEST(NotchFilterTest, PeakTrackerNoPeak)
+{
+  /* only the noise after the rotor notches: no extra notch */
+  VibrationConfig config;
+  config.noise = 0.01f;
+  VibrationSignal signal(config);
+  NotchFilterBank::Config bank_config = signal.bankConfig();
+  bank_config.peak_tracking = true;
+  NotchFilterBank bank;
+  bank.setConfig(bank_config);
+
+  for(int k = 0; k < SAMPLES; k++)
+    {
+      Sample sample = signal.next();
+      bank.setRotorPwm(sample.pwm, config.motor_number);
+      bank.apply(sample.motion + sample.vibration);
+    }
+  EXPECT_EQ(bank.getPeakFreq(), 0);
+  EXPECT_EQ(bank.getActiveNotchNumber(), 8);
+}
+
+TEST(NotchFilterTest, CyclesPerSample)
+{
+  /* the whole bank in a 1 ms systick: loose bound on the host, the table is given by notch_filter_benchmark */
+  VibrationConfig config;
+  config.motor_number = 8;
+  config.resonance_freq = 173.0f;
+  VibrationSignal signal(config);
+  std::vector<Sample> samples;
+  for(int k = 0; k < SAMPLES; k++) samples.push_back(signal.next());
+
+  NotchFilterBank::Config bank_config = signal.bankConfig();
+  bank_config.harmonics = 3;
+  bank_config.peak_tracking = true;
+  Cost cost = measure(bank_config, samples, config.motor_number);
+  RecordProperty("ns_per_sample", static_cast<int>(cost.ns_per_sample));
+  RecordProperty("cycles_per_sample", static_cast<int>(cost.cycles_per_sample));
+  RecordProperty("max_cycles_per_sample", static_cast<int>(cost.max_cycles_per_sample));
+  EXPECT_LT(cost.ns_per_sample, 20000.0);
+}
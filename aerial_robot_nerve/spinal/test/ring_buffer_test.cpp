@@ -0,0 +1,234 @@
+/*
+******************************************************************************
+* File Name          : ring_buffer_test.cpp
+* Description        : single producer / single consumer FIFO of the spinal firmware:
+*                      overflow, bulk and span access, and the stress of two threads
+******************************************************************************
+*/
+
+#include "util/ring_buffer.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const uint32_t STRESS_COUNT = 2000000;
+
+  /* producer: sequential values in the chunks of 1 ~ 7, by push, bulk push or the push span */
+  template <size_t SIZE> void produce(RingBufferFiFo<uint32_t, SIZE>& buffer, bool retry)
+  {
+    uint32_t value = 0;
+    uint32_t chunk[7];
+    while (value < STRESS_COUNT)
+      {
+        if (buffer.length() == SIZE) std::this_thread::yield(); // also for the host with one core
+        size_t size = std::min<uint32_t>(1 + value % 7, STRESS_COUNT - value);
+        switch (value % 3)
+          {
+          case 0:
+            {
+              if (buffer.push(value) || !retry) value++;
+              break;
+            }
+          case 1:
+            {
+              for (size_t i = 0; i < size; i++) chunk[i] = value + i;
+              size_t pushed = buffer.push(chunk, size);
+              value += retry ? pushed : size;
+              break;
+            }
+          default:
+            {
+              uint32_t* span;
+              size_t span_size = std::min(buffer.getPushSpan(span), size);
+              for (size_t i = 0; i < span_size; i++) span[i] = value + i;
+              buffer.commitPush(span_size);
+              value += span_size;
+              break;
+            }
+          }
+      }
+  }
+
+  /* consumer: the received values in order */
+  template <size_t SIZE> std::vector<uint32_t> consume(RingBufferFiFo<uint32_t, SIZE>& buffer, const std::atomic<bool>& done)
+  {
+    std::vector<uint32_t> received;
+    received.reserve(STRESS_COUNT);
+    uint32_t chunk[5];
+    for (int i = 0; ; i++)
+      {
+        bool finished = done.load(); // before the last pop
+        size_t size = 0;
+        switch (i % 3)
+          {
+          case 0:
+            {
+              uint32_t value;
+              if (buffer.pop(value))
+                {
+                  received.push_back(value);
+                  size = 1;
+                }
+              break;
+            }
+          case 1:
+            {
+              size = buffer.pop(chunk, 5);
+              received.insert(received.end(), chunk, chunk + size);
+              break;
+            }
+          default:
+            {
+              const uint32_t* span;
+              size = buffer.getPopSpan(span);
+              received.insert(received.end(), span, span + size);
+              buffer.commitPop(size);
+              break;
+            }
+          }
+        if (size == 0)
+          {
+            if (finished && buffer.length() == 0) break;
+            std::this_thread::yield();
+          }
+      }
+    return received;
+  }
+}
+
+TEST(RingBufferTest, PushPop)
+{
+  RingBufferFiFo<int, 8> buffer;
+  EXPECT_EQ(buffer.capacity(), 8u);
+
+  int value;
+  EXPECT_FALSE(buffer.pop(value));
+
+  /* the whole size is usable */
+  for (int i = 0; i < 8; i++) EXPECT_TRUE(buffer.push(i));
+  EXPECT_EQ(buffer.length(), 8u);
+  EXPECT_EQ(buffer.getOverflowCount(), 0u);
+
+  for (int i = 0; i < 8; i++)
+    {
+      ASSERT_TRUE(buffer.pop(value));
+      EXPECT_EQ(value, i);
+    }
+  EXPECT_EQ(buffer.length(), 0u);
+  EXPECT_FALSE(buffer.pop(value));
+}
+
+TEST(RingBufferTest, Overflow)
+{
+  RingBufferFiFo<uint8_t, 4> buffer;
+  for (uint8_t i = 0; i < 4; i++) buffer.push(i);
+
+  /* the unread data is not overwritten by a burst */
+  EXPECT_FALSE(buffer.push(100));
+  EXPECT_FALSE(buffer.push(101));
+  EXPECT_EQ(buffer.getOverflowCount(), 2u);
+
+  uint8_t burst[3] = {10, 11, 12};
+  uint8_t value;
+  buffer.pop(value);
+  EXPECT_EQ(buffer.push(burst, 3), 1u);
+  EXPECT_EQ(buffer.getOverflowCount(), 4u);
+
+  uint8_t out[4];
+  ASSERT_EQ(buffer.pop(out, 4), 4u);
+  EXPECT_EQ(out[0], 1);
+  EXPECT_EQ(out[1], 2);
+  EXPECT_EQ(out[2], 3);
+  EXPECT_EQ(out[3], 10);
+
+  buffer.init();
+  EXPECT_EQ(buffer.getOverflowCount(), 0u);
+  EXPECT_EQ(buffer.length(), 0u);
+}
+
+TEST(RingBufferTest, BulkWrapAround)
+{
+  RingBufferFiFo<uint16_t, 16> buffer;
+  uint16_t in[11], out[11];
+  uint16_t next_in = 0, next_out = 0;
+
+  /* the bulk copies split at the end of the buffer */
+  for (int round = 0; round < 50; round++)
+    {
+      for (int i = 0; i < 11; i++) in[i] = next_in++;
+      ASSERT_EQ(buffer.push(in, 11), 11u);
+      ASSERT_EQ(buffer.pop(out, 11), 11u);
+      for (int i = 0; i < 11; i++) ASSERT_EQ(out[i], next_out++);
+    }
+  EXPECT_EQ(buffer.pop(out, 11), 0u);
+  EXPECT_EQ(buffer.getOverflowCount(), 0u);
+}
+
+TEST(RingBufferTest, Span)
+{
+  RingBufferFiFo<uint8_t, 8> buffer;
+  uint8_t* push_span;
+  const uint8_t* pop_span;
+
+  ASSERT_EQ(buffer.getPushSpan(push_span), 8u);
+  for (int i = 0; i < 6; i++) push_span[i] = i;
+  buffer.commitPush(6);
+
+  ASSERT_EQ(buffer.getPopSpan(pop_span), 6u);
+  EXPECT_EQ(pop_span[0], 0);
+  buffer.commitPop(5);
+
+  /* contiguous to the end of the buffer, then from the beginning */
+  ASSERT_EQ(buffer.getPushSpan(push_span), 2u);
+  push_span[0] = 6;
+  push_span[1] = 7;
+  buffer.commitPush(2);
+  ASSERT_EQ(buffer.getPushSpan(push_span), 5u);
+  for (int i = 0; i < 5; i++) push_span[i] = 8 + i;
+  buffer.commitPush(5);
+  EXPECT_EQ(buffer.getPushSpan(push_span), 0u);
+  EXPECT_EQ(buffer.length(), 8u);
+
+  ASSERT_EQ(buffer.getPopSpan(pop_span), 3u);
+  EXPECT_EQ(pop_span[0], 5);
+  EXPECT_EQ(pop_span[2], 7);
+  buffer.commitPop(3);
+  ASSERT_EQ(buffer.getPopSpan(pop_span), 5u);
+  EXPECT_EQ(pop_span[0], 8);
+  EXPECT_EQ(pop_span[4], 12);
+}
+
+TEST(RingBufferTest, StressLossless)
+{
+  /* the producer retries on the full buffer: every value in order */
+  RingBufferFiFo<uint32_t, 64> buffer;
+  std::atomic<bool> done(false);
+  std::vector<uint32_t> received;
+  std::thread consumer([&]() { received = consume(buffer, done); });
+  produce(buffer, true);
+  done.store(true);
+  consumer.join();
+
+  ASSERT_EQ(received.size(), STRESS_COUNT);
+  for (uint32_t i = 0; i < STRESS_COUNT; i++) ASSERT_EQ(received[i], i) << "at " << i;
+}
+
+TEST(RingBufferTest, StressOverflow)
+{
+  /* the producer drops on the full buffer as an rx interrupt: increasing values, no loss except the counted ones */
+  RingBufferFiFo<uint32_t, 16> buffer;
+  std::atomic<bool> done(false);
+  std::vector<uint32_t> received;
+  std::thread consumer([&]() { received = consume(buffer, done); });
+  produce(buffer, false);
+  done.store(true);
+  consumer.join();
+
+  for (size_t i = 1; i < received.size(); i++) ASSERT_LT(received[i - 1], received[i]) << "at " << i;
+  EXPECT_EQ(received.size() + buffer.getOverflowCount(), STRESS_COUNT);
+}
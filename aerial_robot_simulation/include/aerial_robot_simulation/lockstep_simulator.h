@@ -0,0 +1,151 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Author: Moju Zhao
+ Desc: Gazebo-free simulator which runs the physics, spinal and the ROS-side
+       estimator/navigator/controller in deterministic lockstep on simulated time.
+*/
+
+#ifndef LOCKSTEP_SIMULATOR_H
+#define LOCKSTEP_SIMULATOR_H
+
+#include <aerial_robot_control/control/control_base.h>
+#include <aerial_robot_control/flight_navigation.h>
+#include <aerial_robot_estimation/state_estimation.h>
+#include <aerial_robot_model/transformable_aerial_robot_model.h>
+#include <aerial_robot_model/transformable_aerial_robot_model_ros.h>
+#include <aerial_robot_simulation/rigid_body_dynamics.h>
+#include <aerial_robot_simulation/spinal_interface.h>
+#include <flight_control/flight_control.h>
+#include <functional>
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+
+namespace aerial_robot_simulation
+{
+
+class LockstepSimulator
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  LockstepSimulator(ros::NodeHandle nh, ros::NodeHandle nhp);
+  ~LockstepSimulator() {}
+
+  /* advance the whole system by one physics step */
+  void step();
+  void spinFor(double duration);
+  /* return false if the condition is not satisfied until timeout [sec] */
+  bool spinUntil(std::function<bool()> condition, double timeout);
+
+  /* simulated time since the start, and the ratio to the consumed wall time */
+  double getSimTime() const { return (now_ - start_time_).toSec(); }
+  double getRealTimeFactor() const;
+
+  const RigidBodyDynamics& getDynamics() const { return dynamics_; }
+  Eigen::Vector3d getTrueCogPos() const { return dynamics_.getState().pos; }
+  Eigen::Vector3d getTrueCogRPY() const;
+  const sensor_msgs::JointState& getJointState() const { return joint_state_; }
+
+  boost::shared_ptr<aerial_robot_estimation::StateEstimator> getEstimator() { return estimator_; }
+  boost::shared_ptr<aerial_robot_navigation::BaseNavigator> getNavigator() { return navigator_; }
+  boost::shared_ptr<aerial_robot_model::RobotModel> getRobotModel() { return robot_model_; }
+
+private:
+  ros::NodeHandle nh_;
+  ros::NodeHandle nhp_;
+
+  /* ROS-side components, same as aerial_robot_base */
+  boost::shared_ptr<aerial_robot_model::RobotModelRos> robot_model_ros_;
+  boost::shared_ptr<aerial_robot_estimation::StateEstimator>  estimator_;
+  pluginlib::ClassLoader<aerial_robot_navigation::BaseNavigator> navigator_loader_;
+  boost::shared_ptr<aerial_robot_navigation::BaseNavigator> navigator_;
+  pluginlib::ClassLoader<aerial_robot_control::ControlBase> controller_loader_;
+  boost::shared_ptr<aerial_robot_control::ControlBase> controller_;
+
+  /* spinal */
+  hardware_interface::SpinalInterface spinal_interface_;
+  FlightControl spinal_controller_;
+
+  /* physics: independent model to get the true rotor configuration */
+  boost::shared_ptr<aerial_robot_model::RobotModel> robot_model_;
+  RigidBodyDynamics dynamics_;
+  Eigen::Affine3d cog2baselink_;
+  Eigen::Vector3d magnetic_field_;
+
+  /* servo: first order lag model */
+  std::vector<ros::Subscriber> joint_ctrl_subs_;
+  ros::Publisher joint_state_pub_;
+  sensor_msgs::JointState joint_state_;
+  std::vector<double> target_joint_angles_;
+  std::vector<double> joint_upper_limits_;
+  std::vector<double> joint_lower_limits_;
+  std::map<std::string, int> joint_index_map_;
+  double servo_time_constant_;
+  bool joint_update_;
+
+  /* sensor outputs */
+  ros::Publisher ground_truth_pub_;
+  ros::Publisher mocap_pub_;
+  double ground_truth_pub_rate_;
+  double mocap_pub_rate_;
+  double ground_truth_pos_noise_, ground_truth_vel_noise_, ground_truth_rot_noise_, ground_truth_angular_noise_;
+  double mocap_pos_noise_, mocap_rot_noise_;
+  ros::Time last_ground_truth_time_, last_mocap_time_;
+
+  /* time */
+  double step_size_;
+  int control_step_interval_;
+  int state_publish_step_interval_;
+  uint64_t step_count_;
+  ros::Time start_time_;
+  ros::Time now_;
+  ros::WallTime wall_start_time_;
+
+  void servoInit();
+  void servoUpdate();
+  void updateRobotModel();
+  void spinalUpdate();
+  void publishSensors();
+
+  void jointCtrlCallback(const sensor_msgs::JointStateConstPtr& msg);
+};
+
+} // namespace
+
+#endif
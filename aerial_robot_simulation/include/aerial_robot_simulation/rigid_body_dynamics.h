@@ -0,0 +1,125 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Author: Moju Zhao
+ Desc: 6-DoF rigid body dynamics of the CoG frame with first-order rotor lag, integrated by fixed-step RK4
+*/
+
+#ifndef RIGID_BODY_DYNAMICS_H
+#define RIGID_BODY_DYNAMICS_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+
+namespace aerial_robot_simulation
+{
+
+class RigidBodyDynamics
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  struct State
+  {
+    Eigen::Vector3d pos;      // CoG position in world frame
+    Eigen::Vector3d vel;      // CoG velocity in world frame
+    Eigen::Quaterniond q;     // CoG frame -> world frame
+    Eigen::Vector3d omega;    // angular velocity in CoG frame
+    Eigen::VectorXd thrust;   // actual rotor thrust [N]
+  };
+
+  RigidBodyDynamics();
+  ~RigidBodyDynamics() {}
+
+  /* model: all vectors are described in the CoG frame */
+  void setMass(double mass) { mass_ = mass; }
+  void setInertia(const Eigen::Matrix3d& inertia);
+  void setGravity(double g) { gravity_ = g; }
+  void setRotors(const std::vector<Eigen::Vector3d>& origins, const std::vector<Eigen::Vector3d>& normals,
+                 const std::vector<int>& directions, double m_f_rate);
+  void setRotorTimeConstant(double tau) { rotor_tau_ = tau; }
+  void setThrustLimit(double lower, double upper) { thrust_min_ = lower; thrust_max_ = upper; }
+  void setGroundHeight(double z) { ground_height_ = z; }
+
+  void setState(const State& state) { state_ = state; }
+  void setTargetThrust(const Eigen::VectorXd& target);
+
+  /* integrate one fixed step with classic RK4 */
+  void step(double dt);
+
+  const State& getState() const { return state_; }
+  const Eigen::Vector3d& getLinearAcc() const { return acc_; }      // world frame, without gravity
+  const Eigen::Vector3d& getAngularAcc() const { return omega_dot_; } // CoG frame
+  const Eigen::VectorXd& getTargetThrust() const { return target_thrust_; }
+  int getRotorNum() const { return rotor_origins_.size(); }
+  bool onGround() const { return on_ground_; }
+  double getMass() const { return mass_; }
+  double getGravity() const { return gravity_; }
+
+  /* specific force and angular velocity sensed by an imu rigidly attached at offset (CoG frame) with orientation rot (sensor -> CoG) */
+  void getImuValue(const Eigen::Vector3d& offset, const Eigen::Matrix3d& rot, Eigen::Vector3d& acc, Eigen::Vector3d& gyro) const;
+
+private:
+  /* x = [p(3), v(3), q(4: w, x, y, z), omega(3), thrust(n)] */
+  Eigen::VectorXd derivative(const Eigen::VectorXd& x) const;
+  Eigen::VectorXd pack(const State& state) const;
+  void unpack(const Eigen::VectorXd& x, State& state) const;
+  void groundContact();
+
+  double mass_;
+  double gravity_;
+  Eigen::Matrix3d inertia_;
+  Eigen::Matrix3d inertia_inv_;
+
+  std::vector<Eigen::Vector3d> rotor_origins_;
+  std::vector<Eigen::Vector3d> rotor_normals_;
+  std::vector<int> rotor_directions_;
+  double m_f_rate_;
+  double rotor_tau_;
+  double thrust_min_;
+  double thrust_max_;
+  double ground_height_;
+
+  State state_;
+  Eigen::VectorXd target_thrust_;
+  Eigen::Vector3d acc_;
+  Eigen::Vector3d omega_dot_;
+  bool on_ground_;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,404 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Author: Moju Zhao
+ Desc: Gazebo-free simulator which runs the physics, spinal and the ROS-side
+       estimator/navigator/controller in deterministic lockstep on simulated time.
+*/
+
+#include <aerial_robot_simulation/lockstep_simulator.h>
+#include <ros/callback_queue.h>
+
+namespace aerial_robot_simulation
+{
+
+LockstepSimulator::LockstepSimulator(ros::NodeHandle nh, ros::NodeHandle nhp)
+  : nh_(nh), nhp_(nhp),
+    navigator_loader_("aerial_robot_control", "aerial_robot_navigation::BaseNavigator"),
+    controller_loader_("aerial_robot_control", "aerial_robot_control::ControlBase"),
+    joint_update_(false), step_count_(0)
+{
+  /* every component is driven by the simulated clock from here, no /clock is required */
+  start_time_ = ros::Time(1.0);
+  now_ = start_time_;
+  ros::Time::setNow(now_);
+
+  ros::NodeHandle simulation_nh = ros::NodeHandle(nh_, "simulation");
+  simulation_nh.param("step_size", step_size_, 0.001); // [sec], same with the gazebo physics and the spinal control loop
+  simulation_nh.param("servo_time_constant", servo_time_constant_, 0.1); // [sec]
+  std::vector<double> magnetic_field;
+  simulation_nh.param("magnetic_field", magnetic_field, std::vector<double>{0.23, 0.0, -0.42}); // world frame
+  magnetic_field_ = Eigen::Vector3d(magnetic_field.at(0), magnetic_field.at(1), magnetic_field.at(2));
+
+  /* physics */
+  robot_model_ = boost::make_shared<aerial_robot_model::RobotModel>();
+  servoInit();
+
+  ros::NodeHandle motor_nh(nh_, "motor_info");
+  double rotor_damping_rate;
+  motor_nh.param("rotor_damping_rate", rotor_damping_rate, 1.0);
+  /* convert the damping rate per gazebo step to the continuous time constant */
+  double rotor_time_constant = step_size_;
+  if(rotor_damping_rate > 0 && rotor_damping_rate < 1.0)
+    rotor_time_constant = std::max(step_size_, -step_size_ / std::log(1 - rotor_damping_rate));
+  dynamics_.setRotorTimeConstant(rotor_time_constant);
+  dynamics_.setGravity(aerial_robot_estimation::G);
+  dynamics_.setThrustLimit(robot_model_->getThrustLowerLimit(), robot_model_->getThrustUpperLimit());
+  dynamics_.setGroundHeight(0);
+  updateRobotModel();
+
+  /* spinal */
+  spinal_interface_.init(nh_, joint_state_.name.size());
+  spinal_controller_.init(&nh_, spinal_interface_.getEstimatorPtr());
+  int estimate_mode;
+  nh_.param("estimation/mode", estimate_mode, (int)aerial_robot_estimation::GROUND_TRUTH);
+  if(estimate_mode == aerial_robot_estimation::GROUND_TRUTH)
+    spinal_controller_.useGroundTruth(true);
+
+  /* sensors */
+  simulation_nh.param("ground_truth_pub_rate", ground_truth_pub_rate_, 0.01); // [sec]
+  simulation_nh.param("ground_truth_pos_noise", ground_truth_pos_noise_, 0.0); // m
+  simulation_nh.param("ground_truth_vel_noise", ground_truth_vel_noise_, 0.0); // m/s
+  simulation_nh.param("ground_truth_rot_noise", ground_truth_rot_noise_, 0.0); // rad
+  simulation_nh.param("ground_truth_angular_noise", ground_truth_angular_noise_, 0.0); // rad/s
+  simulation_nh.param("mocap_pub_rate", mocap_pub_rate_, 0.01); // [sec]
+  simulation_nh.param("mocap_pos_noise", mocap_pos_noise_, 0.001); // m
+  simulation_nh.param("mocap_rot_noise", mocap_rot_noise_, 0.001); // rad
+  ground_truth_pub_ = nh_.advertise<nav_msgs::Odometry>("ground_truth", 1);
+  mocap_pub_ = nh_.advertise<geometry_msgs::PoseStamped>("mocap/pose", 1);
+  last_ground_truth_time_ = now_;
+  last_mocap_time_ = now_;
+
+  /* ROS-side: same with aerial_robot_base */
+  robot_model_ros_ = boost::make_shared<aerial_robot_model::RobotModelRos>(nh_, nhp_);
+  auto robot_model = robot_model_ros_->getRobotModel();
+
+  /* the state is published on the simulated clock in step(), not by the update thread on the wall clock */
+  estimator_ = boost::make_shared<aerial_robot_estimation::StateEstimator>();
+  estimator_->setExternalUpdate(true);
+  estimator_->initialize(nh_, nhp_, robot_model);
+  double estimate_update_rate;
+  nh_.param("estimation/update_rate", estimate_update_rate, 100.0);
+  state_publish_step_interval_ = std::max(1, (int)std::round(1.0 / (estimate_update_rate * step_size_)));
+
+  std::string navi_plugin_name;
+  if(nh_.getParam("flight_navigation_plugin_name", navi_plugin_name))
+    {
+      try
+        {
+          navigator_ = navigator_loader_.createInstance(navi_plugin_name);
+        }
+      catch(pluginlib::PluginlibException& ex)
+        {
+          ROS_ERROR("The plugin failed to load for some reason. Error: %s", ex.what());
+        }
+    }
+  else
+    {
+      ROS_DEBUG("use default class for flight navigation: aerial_robot_navigation::BaseNavigator");
+      navigator_ = boost::make_shared<aerial_robot_navigation::BaseNavigator>();
+    }
+  navigator_->initialize(nh_, nhp_, robot_model, estimator_);
+
+  double main_rate;
+  nhp_.param("main_rate", main_rate, 40.0);
+  control_step_interval_ = std::max(1, (int)std::round(1.0 / (main_rate * step_size_)));
+
+  try
+    {
+      std::string aerial_robot_control_name;
+      nh_.param ("aerial_robot_control_name", aerial_robot_control_name, std::string("aerial_robot_control/flatness_pid"));
+      controller_ = controller_loader_.createInstance(aerial_robot_control_name);
+      controller_->initialize(nh_, nhp_, robot_model, estimator_, navigator_, 1.0 / (control_step_interval_ * step_size_));
+    }
+  catch(pluginlib::PluginlibException& ex)
+    {
+      ROS_ERROR("The plugin failed to load for some reason. Error: %s", ex.what());
+    }
+
+  /* deliver the initial joint state and the latched configurations (e.g. uav_info to spinal) */
+  joint_state_.header.stamp = now_;
+  joint_state_pub_.publish(joint_state_);
+  ros::getGlobalCallbackQueue()->callAvailable();
+
+  wall_start_time_ = ros::WallTime::now();
+}
+
+void LockstepSimulator::servoInit()
+{
+  /* follow the servo configuration of servo_bridge */
+  XmlRpc::XmlRpcValue all_servos_params;
+  if(nh_.getParam("servo_controller", all_servos_params))
+    {
+      const auto& urdf_model = robot_model_->getUrdfModel();
+      for(auto servo_group_params: all_servos_params)
+        {
+          ROS_ASSERT(servo_group_params.second.getType() == XmlRpc::XmlRpcValue::TypeStruct);
+
+          for(auto servo_params : servo_group_params.second)
+            {
+              if(servo_params.first.find("controller") == std::string::npos) continue;
+
+              std::string name = servo_params.second["name"];
+              double init_value = 0;
+              if(servo_params.second.hasMember("simulation") && servo_params.second["simulation"].hasMember("init_value"))
+                init_value = servo_params.second["simulation"]["init_value"];
+              else if(servo_group_params.second.hasMember("simulation") && servo_group_params.second["simulation"].hasMember("init_value"))
+                init_value = servo_group_params.second["simulation"]["init_value"];
+
+              joint_index_map_[name] = joint_state_.name.size();
+              joint_state_.name.push_back(name);
+              joint_state_.position.push_back(init_value);
+              joint_state_.velocity.push_back(0);
+              target_joint_angles_.push_back(init_value);
+              joint_upper_limits_.push_back(urdf_model.getJoint(name)->limits->upper);
+              joint_lower_limits_.push_back(urdf_model.getJoint(name)->limits->lower);
+            }
+
+          joint_ctrl_subs_.push_back(nh_.subscribe(servo_group_params.first + std::string("_ctrl"), 10, &LockstepSimulator::jointCtrlCallback, this));
+        }
+    }
+
+  joint_state_pub_ = nh_.advertise<sensor_msgs::JointState>("joint_states", 1, true);
+}
+
+void LockstepSimulator::jointCtrlCallback(const sensor_msgs::JointStateConstPtr& msg)
+{
+  for(int i = 0; i < msg->position.size(); i++)
+    {
+      int index = i;
+      if(msg->name.size() == msg->position.size())
+        {
+          auto it = joint_index_map_.find(msg->name.at(i));
+          if(it == joint_index_map_.end())
+            {
+              ROS_WARN_STREAM("lockstep simulator: no servo named " << msg->name.at(i));
+              continue;
+            }
+          index = it->second;
+        }
+      if(index >= target_joint_angles_.size()) break;
+
+      target_joint_angles_.at(index) = std::min(std::max(msg->position.at(i), joint_lower_limits_.at(index)), joint_upper_limits_.at(index));
+    }
+}
+
+void LockstepSimulator::servoUpdate()
+{
+  const double rate = std::exp(-step_size_ / servo_time_constant_);
+  for(int i = 0; i < target_joint_angles_.size(); i++)
+    {
+      const double prev_angle = joint_state_.position.at(i);
+      const double angle = target_joint_angles_.at(i) + (prev_angle - target_joint_angles_.at(i)) * rate;
+      joint_state_.position.at(i) = angle;
+      joint_state_.velocity.at(i) = (angle - prev_angle) / step_size_;
+      if(std::fabs(angle - prev_angle) > 1e-6) joint_update_ = true;
+    }
+}
+
+void LockstepSimulator::updateRobotModel()
+{
+  /* the momentum exchange between links is neglected, only the instantaneous configuration is updated */
+  robot_model_->updateRobotModel(joint_state_);
+
+  dynamics_.setMass(robot_model_->getMass());
+  dynamics_.setInertia(robot_model_->getInertia<Eigen::Matrix3d>());
+
+  const auto& rotor_direction = robot_model_->getRotorDirection();
+  std::vector<int> directions;
+  for(int i = 0; i < robot_model_->getRotorNum(); i++)
+    directions.push_back(rotor_direction.at(i + 1));
+  dynamics_.setRotors(robot_model_->getRotorsOriginFromCog<Eigen::Vector3d>(),
+                      robot_model_->getRotorsNormalFromCog<Eigen::Vector3d>(),
+                      directions, robot_model_->getMFRate());
+
+  cog2baselink_ = robot_model_->getCog2Baselink<Eigen::Affine3d>();
+}
+
+void LockstepSimulator::spinalUpdate()
+{
+  /* imu is mounted on the baselink (flight controller board) */
+  Eigen::Vector3d acc, gyro;
+  dynamics_.getImuValue(cog2baselink_.translation(), cog2baselink_.linear(), acc, gyro);
+  const Eigen::Quaterniond baselink_q(dynamics_.getState().q * cog2baselink_.linear());
+  const Eigen::Vector3d mag = baselink_q.conjugate() * magnetic_field_;
+
+  spinal_interface_.setImuValue(acc.x(), acc.y(), acc.z(), gyro.x(), gyro.y(), gyro.z());
+  spinal_interface_.setMagValue(mag.x(), mag.y(), mag.z());
+  spinal_interface_.setTrueBaselinkOrientation(baselink_q.x(), baselink_q.y(), baselink_q.z(), baselink_q.w());
+  spinal_interface_.setTrueBaselinkAngular(gyro.x(), gyro.y(), gyro.z());
+  spinal_interface_.stateEstimate();
+
+  /* same with SimulationAttitudeController::update */
+  auto true_cog_rpy = spinal_interface_.getTrueCogRPY();
+  spinal_controller_.getAttController().setTrueRPY(true_cog_rpy.x(), true_cog_rpy.y(), true_cog_rpy.z());
+  auto true_cog_angular = spinal_interface_.getTrueCogAngular();
+  spinal_controller_.getAttController().setTrueAngular(true_cog_angular.x(), true_cog_angular.y(), true_cog_angular.z());
+  spinal_interface_.onGround(!spinal_controller_.getAttController().getIntegrateFlag());
+
+  spinal_controller_.update();
+
+  Eigen::VectorXd target_thrust = Eigen::VectorXd::Zero(dynamics_.getRotorNum());
+  for(int i = 0; i < std::min((int)spinal_controller_.getAttController().getMotorNumber(), dynamics_.getRotorNum()); i++)
+    target_thrust(i) = spinal_controller_.getAttController().getForce(i);
+  dynamics_.setTargetThrust(target_thrust);
+}
+
+void LockstepSimulator::publishSensors()
+{
+  const RigidBodyDynamics::State& state = dynamics_.getState();
+  const Eigen::Vector3d baselink_pos = state.pos + state.q * cog2baselink_.translation();
+  const Eigen::Vector3d baselink_vel = state.vel + state.q * state.omega.cross(cog2baselink_.translation());
+  const Eigen::Quaterniond baselink_q(state.q * cog2baselink_.linear());
+  const Eigen::Vector3d baselink_omega = cog2baselink_.linear().transpose() * state.omega;
+
+  auto rotationNoise = [](const Eigen::Quaterniond& q, double sigma)
+    {
+      return Eigen::Quaterniond(q * Eigen::AngleAxisd(gazebo::gaussianKernel(sigma), Eigen::Vector3d::UnitZ())
+                                * Eigen::AngleAxisd(gazebo::gaussianKernel(sigma), Eigen::Vector3d::UnitY())
+                                * Eigen::AngleAxisd(gazebo::gaussianKernel(sigma), Eigen::Vector3d::UnitX()));
+    };
+
+  if(now_.toSec() - last_ground_truth_time_.toSec() > ground_truth_pub_rate_ - 0.5 * step_size_)
+    {
+      nav_msgs::Odometry odom_msg;
+      odom_msg.header.stamp = now_;
+      odom_msg.pose.pose.position.x = baselink_pos.x() + gazebo::gaussianKernel(ground_truth_pos_noise_);
+      odom_msg.pose.pose.position.y = baselink_pos.y() + gazebo::gaussianKernel(ground_truth_pos_noise_);
+      odom_msg.pose.pose.position.z = baselink_pos.z() + gazebo::gaussianKernel(ground_truth_pos_noise_);
+      const Eigen::Quaterniond q_noise = rotationNoise(baselink_q, ground_truth_rot_noise_);
+      odom_msg.pose.pose.orientation.x = q_noise.x();
+      odom_msg.pose.pose.orientation.y = q_noise.y();
+      odom_msg.pose.pose.orientation.z = q_noise.z();
+      odom_msg.pose.pose.orientation.w = q_noise.w();
+      odom_msg.twist.twist.linear.x = baselink_vel.x() + gazebo::gaussianKernel(ground_truth_vel_noise_);
+      odom_msg.twist.twist.linear.y = baselink_vel.y() + gazebo::gaussianKernel(ground_truth_vel_noise_);
+      odom_msg.twist.twist.linear.z = baselink_vel.z() + gazebo::gaussianKernel(ground_truth_vel_noise_);
+      /* CAUTION! the angular is describe in the fc frame */
+      odom_msg.twist.twist.angular.x = baselink_omega.x() + gazebo::gaussianKernel(ground_truth_angular_noise_);
+      odom_msg.twist.twist.angular.y = baselink_omega.y() + gazebo::gaussianKernel(ground_truth_angular_noise_);
+      odom_msg.twist.twist.angular.z = baselink_omega.z() + gazebo::gaussianKernel(ground_truth_angular_noise_);
+
+      ground_truth_pub_.publish(odom_msg);
+      last_ground_truth_time_ = now_;
+    }
+
+  if(now_.toSec() - last_mocap_time_.toSec() > mocap_pub_rate_ - 0.5 * step_size_)
+    {
+      geometry_msgs::PoseStamped pose_msg;
+      pose_msg.header.stamp = now_;
+      pose_msg.pose.position.x = baselink_pos.x() + gazebo::gaussianKernel(mocap_pos_noise_);
+      pose_msg.pose.position.y = baselink_pos.y() + gazebo::gaussianKernel(mocap_pos_noise_);
+      pose_msg.pose.position.z = baselink_pos.z() + gazebo::gaussianKernel(mocap_pos_noise_);
+      const Eigen::Quaterniond q_noise = rotationNoise(baselink_q, mocap_rot_noise_);
+      pose_msg.pose.orientation.x = q_noise.x();
+      pose_msg.pose.orientation.y = q_noise.y();
+      pose_msg.pose.orientation.z = q_noise.z();
+      pose_msg.pose.orientation.w = q_noise.w();
+
+      mocap_pub_.publish(pose_msg);
+      last_mocap_time_ = now_;
+    }
+}
+
+void LockstepSimulator::step()
+{
+  now_ += ros::Duration(step_size_);
+  ros::Time::setNow(now_);
+
+  /* commands from the previous step: spinal commands, teleop, joint control */
+  ros::getGlobalCallbackQueue()->callAvailable();
+
+  servoUpdate();
+  spinalUpdate();
+  dynamics_.step(step_size_);
+  publishSensors();
+
+  if(++step_count_ % control_step_interval_ == 0)
+    {
+      joint_state_.header.stamp = now_;
+      joint_state_pub_.publish(joint_state_);
+      if(joint_update_)
+        {
+          updateRobotModel();
+          joint_update_ = false;
+        }
+    }
+
+  /* the intra-process messages are already in the queue, so the estimator catches up in the same step */
+  ros::getGlobalCallbackQueue()->callAvailable();
+
+  if(step_count_ % state_publish_step_interval_ == 0) estimator_->statePublish();
+
+  if(step_count_ % control_step_interval_ == 0)
+    {
+      navigator_->update();
+      controller_->update();
+    }
+}
+
+void LockstepSimulator::spinFor(double duration)
+{
+  const uint64_t end_step = step_count_ + std::round(duration / step_size_);
+  while(step_count_ < end_step && ros::ok()) step();
+}
+
+bool LockstepSimulator::spinUntil(std::function<bool()> condition, double timeout)
+{
+  const uint64_t end_step = step_count_ + std::round(timeout / step_size_);
+  while(step_count_ < end_step && ros::ok())
+    {
+      step();
+      if(condition()) return true;
+    }
+  return false;
+}
+
+double LockstepSimulator::getRealTimeFactor() const
+{
+  double wall_time = (ros::WallTime::now() - wall_start_time_).toSec();
+  if(wall_time <= 0) return 0;
+  return getSimTime() / wall_time;
+}
+
+Eigen::Vector3d LockstepSimulator::getTrueCogRPY() const
+{
+  const Eigen::Quaterniond& q = dynamics_.getState().q;
+  double r, p, y;
+  tf::Matrix3x3(tf::Quaternion(q.x(), q.y(), q.z(), q.w())).getRPY(r, p, y);
+  return Eigen::Vector3d(r, p, y);
+}
+
+} // namespace
@@ -0,0 +1,37 @@
+#include <aerial_robot_simulation/lockstep_simulator.h>
+
+int main (int argc, char **argv)
+{
+  ros::init (argc, argv, "lockstep_simulator");
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_private("~");
+
+  /* 0: as fast as possible */
+  double real_time_factor;
+  nh_private.param("real_time_factor", real_time_factor, 0.0);
+  /* 0: infinite */
+  double duration;
+  nh_private.param("duration", duration, 0.0);
+
+  aerial_robot_simulation::LockstepSimulator* simulator = new aerial_robot_simulation::LockstepSimulator(nh, nh_private);
+
+  while(ros::ok())
+    {
+      simulator->step();
+
+      if(duration > 0 && simulator->getSimTime() > duration) break;
+
+      if(real_time_factor > 0)
+        {
+          double sleep_time = simulator->getSimTime() / real_time_factor - simulator->getSimTime() / simulator->getRealTimeFactor();
+          if(sleep_time > 0) ros::WallDuration(sleep_time).sleep();
+        }
+
+      ROS_INFO_THROTTLE(10.0, "lockstep simulator: sim time %f [sec], real time factor %f", simulator->getSimTime(), simulator->getRealTimeFactor());
+    }
+
+  ROS_INFO("lockstep simulator: finished %f [sec] in real time factor %f", simulator->getSimTime(), simulator->getRealTimeFactor());
+
+  delete simulator;
+  return 0;
+}
@@ -0,0 +1,200 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Author: Moju Zhao
+ Desc: 6-DoF rigid body dynamics of the CoG frame with first-order rotor lag, integrated by fixed-step RK4
+*/
+
+#include <aerial_robot_simulation/rigid_body_dynamics.h>
+#include <Eigen/LU>
+#include <cassert>
+#include <cmath>
+
+namespace aerial_robot_simulation
+{
+
+RigidBodyDynamics::RigidBodyDynamics():
+  mass_(1.0), gravity_(9.797),
+  m_f_rate_(0), rotor_tau_(0.02),
+  thrust_min_(0), thrust_max_(1e6),
+  ground_height_(0), on_ground_(true)
+{
+  setInertia(Eigen::Matrix3d::Identity());
+
+  state_.pos.setZero();
+  state_.vel.setZero();
+  state_.q.setIdentity();
+  state_.omega.setZero();
+  acc_.setZero();
+  omega_dot_.setZero();
+}
+
+void RigidBodyDynamics::setInertia(const Eigen::Matrix3d& inertia)
+{
+  inertia_ = inertia;
+  inertia_inv_ = inertia.inverse();
+}
+
+void RigidBodyDynamics::setRotors(const std::vector<Eigen::Vector3d>& origins, const std::vector<Eigen::Vector3d>& normals,
+                                  const std::vector<int>& directions, double m_f_rate)
+{
+  /* the rotor geometry changes during the transformation, but the number of rotors does not */
+  if(state_.thrust.size() != origins.size())
+    {
+      state_.thrust = Eigen::VectorXd::Zero(origins.size());
+      target_thrust_ = Eigen::VectorXd::Zero(origins.size());
+    }
+
+  rotor_origins_ = origins;
+  rotor_normals_ = normals;
+  rotor_directions_ = directions;
+  m_f_rate_ = m_f_rate;
+}
+
+void RigidBodyDynamics::setTargetThrust(const Eigen::VectorXd& target)
+{
+  assert(target.size() == target_thrust_.size());
+  target_thrust_ = target.cwiseMax(thrust_min_).cwiseMin(thrust_max_);
+}
+
+Eigen::VectorXd RigidBodyDynamics::pack(const State& state) const
+{
+  Eigen::VectorXd x(13 + state.thrust.size());
+  x.segment<3>(0) = state.pos;
+  x.segment<3>(3) = state.vel;
+  x(6) = state.q.w();
+  x.segment<3>(7) = state.q.vec();
+  x.segment<3>(10) = state.omega;
+  x.tail(state.thrust.size()) = state.thrust;
+  return x;
+}
+
+void RigidBodyDynamics::unpack(const Eigen::VectorXd& x, State& state) const
+{
+  state.pos = x.segment<3>(0);
+  state.vel = x.segment<3>(3);
+  state.q = Eigen::Quaterniond(x(6), x(7), x(8), x(9)).normalized();
+  state.omega = x.segment<3>(10);
+  state.thrust = x.tail(x.size() - 13);
+}
+
+Eigen::VectorXd RigidBodyDynamics::derivative(const Eigen::VectorXd& x) const
+{
+  const int n = rotor_origins_.size();
+  const Eigen::Quaterniond q(x(6), x(7), x(8), x(9));
+  const Eigen::Vector3d omega = x.segment<3>(10);
+  const Eigen::VectorXd thrust = x.tail(n);
+
+  /* wrench in CoG frame */
+  Eigen::Vector3d force = Eigen::Vector3d::Zero();
+  Eigen::Vector3d torque = Eigen::Vector3d::Zero();
+  for(int i = 0; i < n; i++)
+    {
+      const Eigen::Vector3d f = thrust(i) * rotor_normals_.at(i);
+      force += f;
+      torque += rotor_origins_.at(i).cross(f) + rotor_directions_.at(i) * m_f_rate_ * f;
+    }
+
+  Eigen::VectorXd dx(x.size());
+  dx.segment<3>(0) = x.segment<3>(3);
+  dx.segment<3>(3) = q.normalized() * force / mass_ - Eigen::Vector3d(0, 0, gravity_);
+
+  /* q_dot = 0.5 * q x [0, omega] */
+  const Eigen::Quaterniond q_dot = q * Eigen::Quaterniond(0, omega.x(), omega.y(), omega.z());
+  dx(6) = 0.5 * q_dot.w();
+  dx.segment<3>(7) = 0.5 * q_dot.vec();
+
+  dx.segment<3>(10) = inertia_inv_ * (torque - omega.cross(inertia_ * omega));
+
+  /* first-order lag of the rotor */
+  dx.tail(n) = (target_thrust_ - thrust) / rotor_tau_;
+
+  return dx;
+}
+
+void RigidBodyDynamics::step(double dt)
+{
+  const Eigen::VectorXd x = pack(state_);
+
+  const Eigen::VectorXd k1 = derivative(x);
+  const Eigen::VectorXd k2 = derivative(x + 0.5 * dt * k1);
+  const Eigen::VectorXd k3 = derivative(x + 0.5 * dt * k2);
+  const Eigen::VectorXd k4 = derivative(x + dt * k3);
+
+  unpack(x + dt / 6.0 * (k1 + 2 * k2 + 2 * k3 + k4), state_);
+
+  /* acceleration at the end of the step, used for the imu */
+  const Eigen::VectorXd dx = derivative(pack(state_));
+  acc_ = dx.segment<3>(3);
+  omega_dot_ = dx.segment<3>(10);
+
+  groundContact();
+}
+
+void RigidBodyDynamics::groundContact()
+{
+  if(state_.pos.z() > ground_height_)
+    {
+      on_ground_ = false;
+      return;
+    }
+
+  /* the ground only pushes, so the robot is lifted off once the thrust exceeds the gravity */
+  if(on_ground_ && acc_.z() > 0) return;
+
+  /* inelastic contact without sliding: keep only the yaw angle */
+  on_ground_ = true;
+  state_.pos.z() = ground_height_;
+  state_.vel.setZero();
+  state_.omega.setZero();
+  const Eigen::Vector3d x_axis = state_.q * Eigen::Vector3d::UnitX();
+  state_.q = Eigen::AngleAxisd(std::atan2(x_axis.y(), x_axis.x()), Eigen::Vector3d::UnitZ());
+  acc_.setZero();
+  omega_dot_.setZero();
+}
+
+void RigidBodyDynamics::getImuValue(const Eigen::Vector3d& offset, const Eigen::Matrix3d& rot, Eigen::Vector3d& acc, Eigen::Vector3d& gyro) const
+{
+  const Eigen::Vector3d& omega = state_.omega;
+
+  /* acceleration of the sensor point, including the lever-arm terms */
+  const Eigen::Vector3d point_acc = acc_ + state_.q * (omega_dot_.cross(offset) + omega.cross(omega.cross(offset)));
+  const Eigen::Vector3d specific_force = state_.q.conjugate() * (point_acc + Eigen::Vector3d(0, 0, gravity_));
+
+  acc = rot.transpose() * specific_force;
+  gyro = rot.transpose() * omega;
+}
+
+} // namespace
@@ -0,0 +1,242 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2017, JSK.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/*
+ Desc: scripted flight scenarios (hover, step, transformation while hovering) in the lockstep simulator.
+       The tracking error bounds of each scenario are given by rosparam, e.g.:
+
+       hover:
+         duration: 10.0
+         threshold: [0.05, 0.02, 0.05]       # max error of [xy, z, yaw]
+         rms_threshold: [0.02, 0.01, 0.02]   # rms error of [xy, z, yaw]
+
+       and the lower bound of the real time factor of the whole flight by ~min_real_time_factor.
+*/
+
+#include <aerial_robot_simulation/lockstep_simulator.h>
+#include <aerial_robot_msgs/FlightNav.h>
+#include <angles/angles.h>
+#include <gtest/gtest.h>
+#include <std_msgs/Empty.h>
+
+using namespace aerial_robot_simulation;
+
+namespace
+{
+  struct TrackingError
+  {
+    Eigen::Vector3d max; // [xy, z, yaw]
+    Eigen::Vector3d rms;
+  };
+
+  struct Scenario
+  {
+    double settle;
+    double duration;
+    Eigen::Vector3d threshold;
+    Eigen::Vector3d rms_threshold;
+  };
+}
+
+class LockstepScenarioTest : public ::testing::Test
+{
+protected:
+  /* one simulator for all scenarios, which are run in order in one test */
+  void SetUp()
+  {
+    ros::NodeHandle nh;
+    ros::NodeHandle nhp("~");
+    simulator_ = new LockstepSimulator(nh, nhp);
+
+    /* the publishers are connected intra-process, so the messages reach the navigator in the next step */
+    start_pub_ = nh.advertise<std_msgs::Empty>("teleop_command/start", 1);
+    takeoff_pub_ = nh.advertise<std_msgs::Empty>("teleop_command/takeoff", 1);
+    nav_pub_ = nh.advertise<aerial_robot_msgs::FlightNav>("uav/nav", 1);
+    joint_ctrl_pub_ = nh.advertise<sensor_msgs::JointState>("joints_ctrl", 1);
+
+    double init_form_duration;
+    nhp.param("init_form_duration", init_form_duration, 1.0);
+    simulator_->spinFor(init_form_duration);
+
+    start_pub_.publish(std_msgs::Empty());
+    simulator_->spinFor(0.5);
+    takeoff_pub_.publish(std_msgs::Empty());
+
+    double takeoff_timeout;
+    nhp.param("takeoff_timeout", takeoff_timeout, 30.0);
+    bool hovering = simulator_->spinUntil([this]()
+                                          {
+                                            return simulator_->getNavigator()->getNaviState() == aerial_robot_navigation::HOVER_STATE;
+                                          }, takeoff_timeout);
+    ASSERT_TRUE(hovering) << "can not reach the hovering state";
+  }
+
+  void TearDown()
+  {
+    ROS_INFO("lockstep simulation: %f [sec] in real time factor %f", simulator_->getSimTime(), simulator_->getRealTimeFactor());
+    delete simulator_;
+  }
+
+  Scenario getScenario(const std::string& name)
+  {
+    ros::NodeHandle nh("~" + name);
+    Scenario scenario;
+    nh.param("settle", scenario.settle, 0.0);
+    nh.param("duration", scenario.duration, 10.0);
+    std::vector<double> threshold, rms_threshold;
+    nh.param("threshold", threshold, std::vector<double>(3, 0.1));
+    nh.param("rms_threshold", rms_threshold, threshold);
+    scenario.threshold = Eigen::Vector3d(threshold.at(0), threshold.at(1), threshold.at(2));
+    scenario.rms_threshold = Eigen::Vector3d(rms_threshold.at(0), rms_threshold.at(1), rms_threshold.at(2));
+    return scenario;
+  }
+
+  /* tracking error between the navigation target and the true CoG state */
+  TrackingError track(const Scenario& scenario)
+  {
+    simulator_->spinFor(scenario.settle);
+
+    TrackingError error;
+    error.max.setZero();
+    error.rms.setZero();
+    int count = 0;
+    simulator_->spinUntil([&]()
+                          {
+                            tf::Vector3 target_pos = simulator_->getNavigator()->getTargetPos();
+                            Eigen::Vector3d delta = Eigen::Vector3d(target_pos.x(), target_pos.y(), target_pos.z()) - simulator_->getTrueCogPos();
+                            double yaw_err = angles::normalize_angle(simulator_->getNavigator()->getTargetRPY().z() - simulator_->getTrueCogRPY().z());
+
+                            Eigen::Vector3d err(delta.head<2>().norm(), std::fabs(delta.z()), std::fabs(yaw_err));
+                            error.max = error.max.cwiseMax(err);
+                            error.rms += err.cwiseProduct(err);
+                            count++;
+                            return false;
+                          }, scenario.duration);
+
+    if(count > 0) error.rms = (error.rms / count).cwiseSqrt();
+    ROS_INFO_STREAM("max errors in [xy, z, yaw]: " << error.max.transpose() << ", rms errors: " << error.rms.transpose());
+    return error;
+  }
+
+  void check(const Scenario& scenario, const TrackingError& error)
+  {
+    for(int i = 0; i < 3; i++)
+      {
+        EXPECT_LT(error.max(i), scenario.threshold(i)) << "axis " << i;
+        EXPECT_LT(error.rms(i), scenario.rms_threshold(i)) << "axis " << i;
+      }
+  }
+
+  void hover()
+  {
+    Scenario scenario = getScenario("hover");
+    check(scenario, track(scenario));
+  }
+
+  void step()
+  {
+    Scenario scenario = getScenario("step");
+
+    /* relative step of [x, y, z] in world frame */
+    std::vector<double> command;
+    ros::NodeHandle("~step").param("command", command, std::vector<double>{0.3, 0.0, 0.2});
+    tf::Vector3 target_pos = simulator_->getNavigator()->getTargetPos();
+
+    aerial_robot_msgs::FlightNav nav_msg;
+    nav_msg.header.stamp = ros::Time::now();
+    nav_msg.control_frame = aerial_robot_msgs::FlightNav::WORLD_FRAME;
+    nav_msg.target = aerial_robot_msgs::FlightNav::COG;
+    nav_msg.pos_xy_nav_mode = aerial_robot_msgs::FlightNav::POS_MODE;
+    nav_msg.target_pos_x = target_pos.x() + command.at(0);
+    nav_msg.target_pos_y = target_pos.y() + command.at(1);
+    nav_msg.pos_z_nav_mode = aerial_robot_msgs::FlightNav::POS_MODE;
+    nav_msg.target_pos_z = target_pos.z() + command.at(2);
+    nav_pub_.publish(nav_msg);
+
+    check(scenario, track(scenario));
+  }
+
+  void transform()
+  {
+    Scenario scenario = getScenario("transform");
+
+    std::vector<double> command;
+    ros::NodeHandle("~transform").param("command", command, std::vector<double>());
+    double angle_threshold;
+    ros::NodeHandle("~transform").param("angle_threshold", angle_threshold, 0.02);
+    ASSERT_EQ(command.size(), simulator_->getJointState().position.size());
+
+    sensor_msgs::JointState joint_ctrl_msg;
+    joint_ctrl_msg.header.stamp = ros::Time::now();
+    joint_ctrl_msg.position = command;
+    joint_ctrl_pub_.publish(joint_ctrl_msg);
+
+    /* the tracking error is evaluated during the transformation */
+    check(scenario, track(scenario));
+
+    for(int i = 0; i < command.size(); i++)
+      EXPECT_NEAR(simulator_->getJointState().position.at(i), command.at(i), angle_threshold);
+  }
+
+  LockstepSimulator* simulator_;
+  ros::Publisher start_pub_, takeoff_pub_, nav_pub_, joint_ctrl_pub_;
+};
+
+/* the step and the transformation start from the hovering after the previous scenario */
+TEST_F(LockstepScenarioTest, Scenarios)
+{
+  {
+    SCOPED_TRACE("hover");
+    hover();
+  }
+  {
+    SCOPED_TRACE("step");
+    step();
+  }
+  {
+    SCOPED_TRACE("transform");
+    transform();
+  }
+
+  double min_real_time_factor;
+  ros::NodeHandle("~").param("min_real_time_factor", min_real_time_factor, 1.0);
+  EXPECT_GT(simulator_->getRealTimeFactor(), min_real_time_factor);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "lockstep_scenario_test");
+  return RUN_ALL_TESTS();
+}